@@ -0,0 +1,426 @@
+/**
+ * @file   bench.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Microbenchmarks of the individual calls of the transactional libraries:
+ * empty transactions, single-word reads, writes and increments (also through
+ * 'tm_run' if exported, where the library may combine them), allocations and frees,
+ * and aborts as a function of the write set size (the rollback, then the
+ * retry until commit), each alone on one thread then with every thread on
+ * the same words, for each engine the libraries may run (see '--engines').
+**/
+
+// External headers
+#include <algorithm>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "transactional.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Word class alias.
+**/
+using Word = uint64_t;
+
+/** Write set sizes of the abort benchmark (in words).
+**/
+constexpr static size_t abort_sizes[] = {1, 10, 100, 1000, 10000};
+
+/** Longest wait of the victim of the abort benchmark for the conflicting commit, after which it goes on without (e.g. the library serializes the transactions).
+**/
+constexpr static auto abort_patience = ::std::chrono::microseconds{200};
+
+/** Run parameters.
+**/
+struct Parameters {
+    size_t nbthreads  = 0;      // Number of threads of the contended variants, 0 for the hardware concurrency
+    size_t iterations = 100000; // Iterations per thread and per repetition
+    size_t repeats    = 5;      // Number of repetitions (keep the median)
+    ::std::vector<::std::string> engines; // Engines to run each library with (through 'TM_ENGINE'), none for the library's default
+};
+
+/** Results of one variant of one benchmark.
+**/
+struct Result {
+    double latency = 0.;  // Median over the repetitions of the mean latency of one iteration (in ns)
+    double retry   = 0.;  // Median over the repetitions of the mean retry time of one iteration (in ns), for the aborts only
+    size_t counted = 0;   // Iterations counted, over every repetition and thread
+    size_t total   = 0;   // Iterations run, over every repetition and thread
+};
+
+/** Wait for a condition, pausing in between.
+ * @param cond Condition to wait for
+**/
+template<class Cond> static void wait_for(Cond&& cond) {
+    while (!cond()) {
+        short_pause();
+        ::std::this_thread::yield();
+    }
+}
+
+/** Run a benchmark on several threads, all starting at once.
+ * @param tm        Transactional memory to use
+ * @param nbthreads Number of threads
+ * @param repeats   Number of repetitions
+ * @param body      Body of each thread (thread index, counted iterations, run iterations, total retry time of the counted iterations in ns -> total time of the counted iterations in ns)
+ * @return Results, the latency and retry time being the means over the counted iterations of every thread
+**/
+template<class Body> static Result run(TransactionalMemory const& tm, size_t nbthreads, size_t repeats, Body&& body) {
+    Result res;
+    ::std::vector<double> latencies;
+    ::std::vector<double> retries;
+    for (size_t r = 0; r < repeats; ++r) {
+        ::std::atomic<size_t> ready{0};
+        ::std::vector<Chrono::Tick> ticks(nbthreads);
+        ::std::vector<Chrono::Tick> retry(nbthreads);
+        ::std::vector<size_t> counted(nbthreads);
+        ::std::vector<size_t> total(nbthreads);
+        ::std::vector<::std::thread> threads;
+        for (size_t i = 0; i < nbthreads; ++i) {
+            threads.emplace_back([&](size_t i) {
+                TransactionalThread registration{tm};
+                ready.fetch_add(1, ::std::memory_order_relaxed);
+                wait_for([&]() { return ready.load(::std::memory_order_relaxed) >= nbthreads; });
+                ticks[i] = body(i, counted[i], total[i], retry[i]);
+            }, i);
+        }
+        for (auto& thread: threads)
+            thread.join();
+        Chrono::Tick sum = 0;
+        Chrono::Tick retried = 0;
+        size_t count = 0;
+        for (size_t i = 0; i < nbthreads; ++i) {
+            sum += ticks[i];
+            retried += retry[i];
+            count += counted[i];
+            res.counted += counted[i];
+            res.total += total[i];
+        }
+        if (count > 0) {
+            latencies.push_back(static_cast<double>(sum) / static_cast<double>(count));
+            retries.push_back(static_cast<double>(retried) / static_cast<double>(count));
+        }
+    }
+    auto median = [](::std::vector<double>& values) {
+        ::std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        return values[values.size() / 2];
+    };
+    if (!latencies.empty()) {
+        res.latency = median(latencies);
+        res.retry = median(retries);
+    }
+    return res;
+}
+
+/** Run a transaction until it commits.
+ * @param tm   Transactional memory to use
+ * @param ro   Whether the transaction is read-only
+ * @param body Body of the transaction (TX -> whether it can continue)
+**/
+template<class Body> static void until_commit(TransactionalMemory const& tm, bool ro, Body&& body) {
+    while (true) {
+        auto tx = tm.begin(ro);
+        if (unlikely(tx == STM::invalid_tx))
+            throw Exception::TransactionBegin{};
+        if (likely(body(tx) && tm.end(tx)))
+            return;
+    }
+}
+
+/** Benchmark repeating one transaction, each iteration timed as a whole.
+ * @param tm         Transactional memory to use
+ * @param nbthreads  Number of threads
+ * @param params     Run parameters
+ * @param ro         Whether the transaction is read-only
+ * @param body       Body of the transaction (thread index, TX -> whether it can continue)
+ * @return Results
+**/
+template<class Body> static Result bench_tx(TransactionalMemory const& tm, size_t nbthreads, Parameters const& params, bool ro, Body&& body) {
+    return run(tm, nbthreads, params.repeats, [&](size_t i, size_t& counted, size_t& total, Chrono::Tick&) {
+        Chrono chrono;
+        chrono.start();
+        for (size_t n = 0; n < params.iterations; ++n)
+            until_commit(tm, ro, [&](TransactionalMemory::TX tx) { return body(i, tx); });
+        counted = total = params.iterations;
+        return chrono.delta();
+    });
+}
+
+/** Benchmark repeating one transaction through 'tm_run' if the library exports it (e.g. to combine the transactions of several threads), each
+ * iteration timed as a whole.
+ * @param tm        Transactional memory to use
+ * @param nbthreads Number of threads
+ * @param params    Run parameters
+ * @param ro        Whether the transaction is read-only
+ * @param body      Body of the transaction (thread index, TX -> whether it can continue)
+ * @return Results
+**/
+template<class Body> static Result bench_run(TransactionalMemory const& tm, size_t nbthreads, Parameters const& params, bool ro, Body&& body) {
+    return run(tm, nbthreads, params.repeats, [&](size_t i, size_t& counted, size_t& total, Chrono::Tick&) {
+        Chrono chrono;
+        chrono.start();
+        for (size_t n = 0; n < params.iterations; ++n) {
+            if (unlikely(!transactional_noexcept(tm, ro ? Transaction::Mode::read_only : Transaction::Mode::read_write, [&](TransactionalMemory::TX tx) { return body(i, tx); })))
+                throw Exception::TransactionBegin{};
+        }
+        counted = total = params.iterations;
+        return chrono.delta();
+    });
+}
+
+/** Benchmark allocating then freeing a segment, in two transactions.
+ * @param tm        Transactional memory to use
+ * @param nbthreads Number of threads
+ * @param params    Run parameters
+ * @return Results
+**/
+static Result bench_alloc(TransactionalMemory const& tm, size_t nbthreads, Parameters const& params) {
+    return run(tm, nbthreads, params.repeats, [&](size_t, size_t& counted, size_t& total, Chrono::Tick&) {
+        Chrono chrono;
+        chrono.start();
+        for (size_t n = 0; n < params.iterations; ++n) {
+            void* segment = nullptr;
+            until_commit(tm, false, [&](TransactionalMemory::TX tx) {
+                switch (tm.alloc(tx, 8 * sizeof(Word), &segment)) {
+                case STM::Alloc::success:
+                    return true;
+                case STM::Alloc::nomem:
+                    throw Exception::TransactionAlloc{};
+                default:
+                    return false;
+                }
+            });
+            until_commit(tm, false, [&](TransactionalMemory::TX tx) {
+                return tm.free(tx, segment);
+            });
+        }
+        counted = total = params.iterations;
+        return chrono.delta();
+    });
+}
+
+/** Benchmark of the abort of a transaction with a given write set, in pairs of threads: the victim reads a conflict word and writes its
+ * words, then the aggressor commits a write to the conflict word. The failing commit of the victim (its rollback) is timed, then its retry
+ * of the same transaction until it commits, without the aggressor; only the iterations that aborted are counted.
+ * @param tm      Transactional memory to use, with a conflict word then 'size' words per pair
+ * @param nbpairs Number of pairs of threads
+ * @param params  Run parameters
+ * @param size    Size of the write set (in words)
+ * @return Results
+**/
+static Result bench_abort(TransactionalMemory const& tm, size_t nbpairs, Parameters const& params, size_t size) {
+    auto iterations = ::std::min<size_t>(params.iterations, 2000);
+    auto words = reinterpret_cast<Word*>(tm.get_start());
+    ::std::vector<::std::atomic<size_t>> signals(nbpairs); // Iteration whose write set the victim wrote
+    ::std::vector<::std::atomic<size_t>> commits(nbpairs); // Iteration whose conflicting write the aggressor committed
+    for (size_t i = 0; i < nbpairs; ++i) {
+        signals[i].store(0, ::std::memory_order_relaxed);
+        commits[i].store(0, ::std::memory_order_relaxed);
+    }
+    return run(tm, 2 * nbpairs, params.repeats, [&](size_t i, size_t& counted, size_t& total, Chrono::Tick& retry) -> Chrono::Tick {
+        auto pair = i / 2;
+        auto& signal = signals[pair];
+        auto& commit = commits[pair];
+        if (i % 2 == 1) { // Aggressor
+            for (size_t n = 1; n <= iterations; ++n) {
+                wait_for([&]() { return signal.load(::std::memory_order_acquire) >= n; });
+                until_commit(tm, false, [&](TransactionalMemory::TX tx) {
+                    Word value = n;
+                    return tm.write(tx, &value, sizeof(Word), words);
+                });
+                commit.store(n, ::std::memory_order_release);
+            }
+            return 0;
+        }
+        // Victim
+        ::std::vector<Word> values(size, 1);
+        auto area = words + 1 + pair * size;
+        auto body = [&](TransactionalMemory::TX tx) {
+            Word value;
+            return tm.read(tx, words, sizeof(Word), &value) && tm.write(tx, values.data(), size * sizeof(Word), area);
+        };
+        Chrono::Tick res = 0;
+        for (size_t n = 1; n <= iterations; ++n) {
+            wait_for([&]() { return commit.load(::std::memory_order_acquire) >= n - 1; });
+            auto tx = tm.begin(false);
+            if (unlikely(tx == STM::invalid_tx))
+                throw Exception::TransactionBegin{};
+            ++total;
+            if (unlikely(!body(tx))) { // Aborted before the conflict
+                signal.store(n, ::std::memory_order_release);
+                continue;
+            }
+            signal.store(n, ::std::memory_order_release);
+            auto deadline = ::std::chrono::steady_clock::now() + abort_patience;
+            wait_for([&]() { return commit.load(::std::memory_order_acquire) >= n || ::std::chrono::steady_clock::now() >= deadline; });
+            Chrono chrono;
+            chrono.start();
+            if (!tm.end(tx)) {
+                res += chrono.delta();
+                ++counted;
+                chrono.start();
+                until_commit(tm, false, body);
+                retry += chrono.delta();
+            }
+        }
+        wait_for([&]() { return commit.load(::std::memory_order_acquire) >= iterations; });
+        signal.store(0, ::std::memory_order_relaxed); // For the next repetition, the aggressor being done
+        commit.store(0, ::std::memory_order_relaxed);
+        return res;
+    });
+}
+
+/** Print one line of results.
+ * @param name      Name of the benchmark
+ * @param single    Results of the single-threaded variant
+ * @param contended Results of the contended variant
+ * @param nbthreads Number of threads of the contended variant
+ * @param aborts    Whether the results are of aborts, to print their retry time and ratio of counted iterations
+**/
+static void print(::std::string const& name, Result const& single, Result const& contended, size_t nbthreads, bool aborts = false) {
+    auto show = [&](Result const& res) {
+        if (res.counted == 0) {
+            ::std::cout << "n/a";
+        } else if (aborts) {
+            ::std::cout << "rollback " << res.latency << " ns + retry " << res.retry << " ns";
+        } else {
+            ::std::cout << res.latency << " ns";
+        }
+        if (aborts)
+            ::std::cout << " (" << res.counted << "/" << res.total << " aborted)";
+    };
+    ::std::cout << "⎪ " << name << ":" << ::std::string(name.size() < 24 ? 24 - name.size() : 1, ' ') << "single ";
+    show(single);
+    ::std::cout << ", contended (" << nbthreads << " threads) ";
+    show(contended);
+    ::std::cout << ::std::endl;
+}
+
+/** Benchmark one library.
+ * @param path   Path to the library
+ * @param params Run parameters
+ * @param engine Engine to run the library with (through 'TM_ENGINE'), 'nullptr' for the library's default
+**/
+static void bench(char const* path, Parameters const& params, char const* engine) {
+    auto nbthreads = params.nbthreads;
+    auto nbpairs = ::std::max<size_t>(nbthreads / 2, 1);
+    if (engine) {
+        ::setenv("TM_ENGINE", engine, 1); // Read by the library when the shared memory is created
+        ::std::cout << "⎧ Benchmarking '" << path << "' (engine '" << engine << "')..." << ::std::endl;
+    } else {
+        ::std::cout << "⎧ Benchmarking '" << path << "'..." << ::std::endl;
+    }
+    TransactionalLibrary tl{path};
+    TransactionalMemory tm{tl, alignof(Word), (1 + nbpairs * abort_sizes[::std::size(abort_sizes) - 1]) * sizeof(Word)};
+    auto words = reinterpret_cast<Word*>(tm.get_start());
+    for (auto ro: {true, false}) {
+        auto empty = [&](size_t, TransactionalMemory::TX) { return true; };
+        print(ro ? "empty RO begin+end" : "empty RW begin+end", bench_tx(tm, 1, params, ro, empty), bench_tx(tm, nbthreads, params, ro, empty), nbthreads);
+    }
+    auto read = [&](size_t, TransactionalMemory::TX tx) {
+        Word value;
+        return tm.read(tx, words, sizeof(Word), &value);
+    };
+    print("RO TX, 1-word read", bench_tx(tm, 1, params, true, read), bench_tx(tm, nbthreads, params, true, read), nbthreads);
+    auto write = [&](size_t i, TransactionalMemory::TX tx) {
+        Word value = i;
+        return tm.write(tx, &value, sizeof(Word), words);
+    };
+    print("RW TX, 1-word write", bench_tx(tm, 1, params, false, write), bench_tx(tm, nbthreads, params, false, write), nbthreads);
+    auto increment = [&](size_t, TransactionalMemory::TX tx) {
+        Word value;
+        if (unlikely(!tm.read(tx, words, sizeof(Word), &value)))
+            return false;
+        ++value;
+        return tm.write(tx, &value, sizeof(Word), words);
+    };
+    print("RW TX, 1-word increment", bench_tx(tm, 1, params, false, increment), bench_tx(tm, nbthreads, params, false, increment), nbthreads);
+    print("tm_run 1-word increment", bench_run(tm, 1, params, false, increment), bench_run(tm, nbthreads, params, false, increment), nbthreads);
+    print("alloc TX + free TX", bench_alloc(tm, 1, params), bench_alloc(tm, nbthreads, params), nbthreads);
+    for (auto size: abort_sizes)
+        print("abort, " + ::std::to_string(size) + "-word write set", bench_abort(tm, 1, params, size), bench_abort(tm, nbpairs, params, size), 2 * nbpairs, true);
+    ::std::cout << "⎩ Latencies are medians over " << params.repeats << " repetitions of the mean per iteration; aborts time the failing commit, then the retries until commit" << ::std::endl;
+}
+
+// -------------------------------------------------------------------------- //
+
+/** Program entry point.
+ * @param argc Arguments count
+ * @param argv Arguments values
+ * @return Program return code
+**/
+int main(int argc, char** argv) {
+    try {
+        Parameters params;
+        int argi = 1;
+        while (argi + 1 < argc && ::std::string{argv[argi]}.rfind("--", 0) == 0) {
+            ::std::string name{argv[argi] + 2};
+            if (name == "engines") {
+                ::std::istringstream list{argv[argi + 1]};
+                for (::std::string engine; ::std::getline(list, engine, ',');) {
+                    if (!engine.empty())
+                        params.engines.push_back(engine);
+                }
+                argi += 2;
+                continue;
+            }
+            auto value = ::std::stoul(argv[argi + 1]);
+            if (unlikely(value == 0))
+                throw ::std::invalid_argument{"counts must be positive"};
+            if (name == "threads") {
+                params.nbthreads = value;
+            } else if (name == "iterations") {
+                params.iterations = value;
+            } else if (name == "repeats") {
+                params.repeats = value;
+            } else {
+                argi = argc; // Unknown option, print usage
+                break;
+            }
+            argi += 2;
+        }
+        if (argi >= argc) {
+            ::std::cout << "Usage: " << (argc > 0 ? argv[0] : "bench") << " [<option> <value>]... <library path>..." << ::std::endl;
+            ::std::cout << "Options:" << ::std::endl;
+            ::std::cout << "  --threads <count>     Threads of the contended variants, in pairs for the aborts (default: hardware concurrency)" << ::std::endl;
+            ::std::cout << "  --iterations <count>  Iterations per thread and per repetition, at most 2000 for the aborts (default: 100000)" << ::std::endl;
+            ::std::cout << "  --repeats <count>     Number of repetitions, the median is kept (default: 5)" << ::std::endl;
+            ::std::cout << "  --engines <list>      Comma-separated engines to run each library with, through 'TM_ENGINE' (default: the library's own)" << ::std::endl;
+            return 1;
+        }
+        if (params.nbthreads == 0) {
+            params.nbthreads = ::std::thread::hardware_concurrency();
+            if (unlikely(params.nbthreads == 0))
+                params.nbthreads = 16;
+        }
+        for (; argi < argc; ++argi) {
+            if (params.engines.empty()) {
+                bench(argv[argi], params, nullptr);
+                continue;
+            }
+            for (auto const& engine: params.engines)
+                bench(argv[argi], params, engine.c_str());
+        }
+        return 0;
+    } catch (::std::exception const& err) {
+        ::std::cerr << "⎧ *** EXCEPTION ***" << ::std::endl;
+        ::std::cerr << "⎩ " << err.what() << ::std::endl;
+        return 1;
+    }
+}
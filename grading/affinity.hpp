@@ -0,0 +1,151 @@
+/**
+ * @file   affinity.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Pinning of the worker threads to the CPUs of the machine, following its
+ * topology: compact fills one socket before the next, scatter alternates the
+ * sockets, cores takes one hardware thread per physical core before any of
+ * their siblings.
+**/
+
+#pragma once
+
+// External headers
+extern "C" {
+#include <pthread.h>
+#include <sched.h>
+}
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Thread pinning policy.
+**/
+enum class Pinning {
+    none,    // Threads float freely
+    compact, // Fill one socket, core after core, before the next one
+    scatter, // Alternate the sockets
+    cores    // One hardware thread per physical core, then their siblings
+};
+
+/** Parse a pinning policy.
+ * @param name Name of the policy
+ * @return Pinning policy
+**/
+static Pinning parse_pinning(::std::string const& name) {
+    if (name == "none")
+        return Pinning::none;
+    if (name == "compact")
+        return Pinning::compact;
+    if (name == "scatter")
+        return Pinning::scatter;
+    if (name == "cores")
+        return Pinning::cores;
+    throw ::std::invalid_argument{"pinning policy must be one of none, compact, scatter or cores"};
+}
+
+/** Get the name of a pinning policy.
+ * @param policy Pinning policy
+ * @return Name of the policy
+**/
+static char const* pinning_name(Pinning policy) noexcept {
+    switch (policy) {
+    case Pinning::compact:
+        return "compact";
+    case Pinning::scatter:
+        return "scatter";
+    case Pinning::cores:
+        return "cores";
+    default:
+        return "none";
+    }
+}
+
+/** Order the CPUs the process may run on, following a pinning policy.
+ * @param policy Pinning policy
+ * @return CPUs in the order the workers take them, empty if not pinning
+**/
+static ::std::vector<unsigned int> pinning_order(Pinning policy) {
+    ::std::vector<unsigned int> res;
+    if (policy == Pinning::none)
+        return res;
+    ::cpu_set_t allowed;
+    if (unlikely(::sched_getaffinity(0, sizeof(allowed), &allowed) != 0))
+        return res;
+    /** One hardware thread, as the topology in sysfs describes it (0 when not exposed).
+    **/
+    struct Cpu {
+        unsigned int id;
+        int package; // Socket
+        int core;    // Physical core in the socket
+        int sibling; // Rank among the hardware threads of the core
+        int turn;    // Rank among the CPUs of the socket, physical cores first
+    };
+    auto read = [](unsigned int cpu, char const* name) {
+        ::std::ifstream file{"/sys/devices/system/cpu/cpu" + ::std::to_string(cpu) + "/topology/" + name};
+        int value = 0;
+        file >> value;
+        return value;
+    };
+    ::std::vector<Cpu> cpus;
+    for (unsigned int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed))
+            cpus.push_back({cpu, read(cpu, "physical_package_id"), read(cpu, "core_id"), 0, 0});
+    }
+    // Ranks of the hardware threads in their core
+    ::std::sort(cpus.begin(), cpus.end(), [](Cpu const& a, Cpu const& b) {
+        return ::std::tie(a.package, a.core, a.id) < ::std::tie(b.package, b.core, b.id);
+    });
+    ::std::map<::std::pair<int, int>, int> siblings;
+    for (auto& cpu: cpus)
+        cpu.sibling = siblings[{cpu.package, cpu.core}]++;
+    switch (policy) {
+    case Pinning::scatter: { // Round-robin over the sockets, each giving its physical cores first
+        ::std::stable_sort(cpus.begin(), cpus.end(), [](Cpu const& a, Cpu const& b) {
+            return ::std::tie(a.package, a.sibling) < ::std::tie(b.package, b.sibling);
+        });
+        ::std::map<int, int> turns;
+        for (auto& cpu: cpus)
+            cpu.turn = turns[cpu.package]++;
+        ::std::stable_sort(cpus.begin(), cpus.end(), [](Cpu const& a, Cpu const& b) {
+            return ::std::tie(a.turn, a.package) < ::std::tie(b.turn, b.package);
+        });
+    } break;
+    case Pinning::cores:
+        ::std::stable_sort(cpus.begin(), cpus.end(), [](Cpu const& a, Cpu const& b) {
+            return a.sibling < b.sibling;
+        });
+        break;
+    default: // Already in compact order
+        break;
+    }
+    for (auto const& cpu: cpus)
+        res.push_back(cpu.id);
+    return res;
+}
+
+/** Pin the calling thread to one CPU.
+ * @param cpu CPU to run on
+ * @return Whether the thread was pinned
+**/
+static bool pin_self(unsigned int cpu) noexcept {
+    ::cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
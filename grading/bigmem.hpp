@@ -0,0 +1,241 @@
+/**
+ * @file   bigmem.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Big-memory workload: a region and a set of segments totalling a
+ * configurable size, up to tens of gigabytes, accessed at random, so that
+ * TLB misses, remote NUMA accesses and the footprint of the engine's
+ * metadata show. The resident set size is sampled once the data is touched
+ * and after each run, and reported per data byte.
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Resident set size of the process before anything else is built, as a base class constructed first.
+**/
+struct ResidentBaseline {
+    double baseline_kib = resident_kib(); // Resident set size before the construction (in KiB)
+};
+
+/** Big-memory workload class.
+ * The cells (words) are spread evenly over the first segment and the allocated ones. Transactions move an amount between two random cells,
+ * or read a few random cells; the sum of all the cells stays 0.
+**/
+class WorkloadBigMemory final: private ResidentBaseline, public Workload {
+public:
+    /** Cell class alias.
+    **/
+    using Cell = int64_t;
+    /** Size of a page, the stride at which the data is touched once initialized.
+    **/
+    constexpr static size_t page_size = 4096;
+private:
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram probe_tx;    // Probe transactions
+        Histogram transfer_tx; // Transfer transactions
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    size_t nbsegments;   // Number of segments, the first one included
+    size_t nbcells;      // Number of cells per segment
+    size_t probe_length; // Number of cells read per probe
+    float  prob_probe;   // Probability of a probe transaction
+    AccessPattern access; // Access pattern over the cells of each segment
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::atomic<bool> built; // Whether a worker already (re)built the segments
+    mutable ::std::vector<Cell*> bases; // First cell of each segment, set during initialization
+    mutable ::std::vector<double> rss_samples;  // Resident set size over time (in KiB)
+    mutable ::std::vector<double> meta_samples; // Resident bytes beyond the data per data byte, over time
+    mutable ::std::vector<WorkerState> states; // State of each worker
+private:
+    /** Get the offset of the cells in the first segment.
+     * @return Offset (in bytes), after the two counters of 'check_counters'
+    **/
+    constexpr static size_t offset() noexcept {
+        return 2 * sizeof(Cell);
+    }
+public:
+    /** Big-memory workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param size         Total size of the data (in bytes)
+     * @param nbsegments   Number of segments to spread the data over, the first one included
+     * @param probe_length Number of cells read per probe
+     * @param prob_probe   Probability of a probe transaction
+     * @param access       Access pattern over the cells of each segment
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadBigMemory(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t size, size_t nbsegments, size_t probe_length, float prob_probe, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): ResidentBaseline{}, Workload{library, alignof(Cell), offset() + ::std::max<size_t>(size / nbsegments / sizeof(Cell), 2) * sizeof(Cell)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbsegments{nbsegments}, nbcells{::std::max<size_t>(size / nbsegments / sizeof(Cell), 2)}, probe_length{probe_length}, prob_probe{prob_probe}, access{access}, arrival_rate{arrival_rate}, barrier(nbworkers), built{false}, states(nbworkers) {}
+private:
+    /** Get the size of the data.
+     * @return Size of all the cells (in bytes)
+    **/
+    size_t data_size() const noexcept {
+        return nbsegments * nbcells * sizeof(Cell);
+    }
+    /** Sample the resident set size, and the resident bytes beyond the data per data byte.
+    **/
+    void sample() const {
+        auto rss = resident_kib();
+        rss_samples.push_back(rss);
+        meta_samples.push_back(((rss - baseline_kib) * 1024. - static_cast<double>(data_size())) / static_cast<double>(data_size()));
+    }
+    /** Transfer transaction.
+     * @param from   Cell to withdraw from
+     * @param to     Cell to deposit to
+     * @param amount Amount to transfer
+    **/
+    void transfer_tx(Cell* from, Cell* to, Cell amount) const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            Shared<Cell> source{tx, from};
+            Shared<Cell> target{tx, to};
+            source = source.read() - amount;
+            target = target.read() + amount;
+        });
+    }
+    /** Probe transaction, reading a few cells.
+     * @param cells Cells to read
+     * @return Sum of the cells read
+    **/
+    Cell probe_tx(::std::vector<Cell*> const& cells) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            Cell res = 0;
+            for (auto cell: cells)
+                res += Shared<Cell>{tx, cell}.read();
+            return res;
+        });
+    }
+    /** Sum all the cells, in chunks of one transaction each, to call once the workers are quiescent.
+     * @return Sum of all the cells
+    **/
+    Cell sum_all() const {
+        constexpr size_t chunk = (1 << 20) / sizeof(Cell);
+        ::std::vector<Cell> buffer(chunk);
+        Cell res = 0;
+        for (auto base: bases) {
+            for (size_t first = 0; first < nbcells; first += chunk) {
+                auto count = ::std::min(chunk, nbcells - first);
+                res += transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                    tx.read(base + first, count * sizeof(Cell), buffer.data());
+                    Cell sum = 0;
+                    for (size_t i = 0; i < count; ++i)
+                        sum += buffer[i];
+                    return sum;
+                });
+            }
+        }
+        return res;
+    }
+public:
+    virtual char const* init() const {
+        if (built.exchange(true)) // Another worker (re)builds the segments, and the workers wait for each other before running
+            return nullptr;
+        for (size_t i = 1; i < bases.size(); ++i) { // Segments of a previous initialization, if any
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                tx.free(bases[i]);
+            });
+        }
+        bases.assign(1, reinterpret_cast<Cell*>(reinterpret_cast<uint8_t*>(tm.get_start()) + offset()));
+        for (size_t i = 1; i < nbsegments; ++i) {
+            bases.push_back(transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                return reinterpret_cast<Cell*>(tx.alloc(nbcells * sizeof(Cell)));
+            }));
+        }
+        // Zero one cell per page, in batches, so that the data is resident before the runs
+        constexpr size_t batch = 4096;
+        constexpr size_t stride = page_size / sizeof(Cell);
+        for (auto base: bases) {
+            for (size_t first = 0; first < nbcells; first += batch * stride) {
+                transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                    for (auto i = first; i < first + batch * stride && i < nbcells; i += stride)
+                        Shared<Cell>{tx, base + i} = 0;
+                });
+            }
+        }
+        sample();
+        if (unlikely(sum_all() != 0))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::bernoulli_distribution probe_dist{prob_probe};
+        ::std::uniform_int_distribution<size_t> segment_dist{0, nbsegments - 1};
+        ::std::uniform_int_distribution<size_t> uniform{0, nbcells - 1};
+        ::std::uniform_int_distribution<Cell> amount_dist{1, 100};
+        auto table = access.kind == AccessPattern::Kind::uniform ? ::std::optional<AliasTable>{} : ::std::optional<AliasTable>{::std::in_place, access, nbcells};
+        auto draw = [&]() { return bases[segment_dist(engine)] + (table ? (*table)(engine) : uniform(engine)); };
+        ::std::vector<Cell*> cells(probe_length);
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            if (probe_dist(engine)) {
+                for (auto& cell: cells)
+                    cell = draw();
+                pacer.start();
+                probe_tx(cells);
+                local.probe_tx.record(pacer.latency());
+            } else {
+                auto from = draw();
+                auto to = draw();
+                auto amount = amount_dist(engine);
+                pacer.start();
+                transfer_tx(from, to, amount);
+                local.transfer_tx.record(pacer.latency());
+            }
+        }
+        if (uid == 0)
+            sample();
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.probe_tx.merge(local.probe_tx);
+            res.transfer_tx.merge(local.transfer_tx);
+        }
+        return {{"probe", res.probe_tx}, {"transfer", res.transfer_tx}};
+    }
+    virtual ::std::vector<::std::pair<char const*, ::std::vector<double>>> get_series() const {
+        return {{"RSS KiB", rss_samples}, {"metadata bytes per data byte", meta_samples}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every transfer atomic, before the counters overwrite the first words
+            if (unlikely(sum_all() != 0))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
@@ -0,0 +1,250 @@
+/**
+ * @file   churn.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Allocation-churn workload: nearly every transaction allocates or frees
+ * segments of mixed sizes, so that the cost and the scalability of
+ * 'tm_alloc' and 'tm_free' dominate (segment bookkeeping, allocator
+ * contention, memory returned or not). The number of live segments and the
+ * resident set size are sampled over the run.
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Allocation-churn workload class.
+ * A table of slots in the first segment, each empty or holding a segment. Each transaction visits a few slots: an empty slot gets a new
+ * segment of a random size, a full slot gets its segment freed. Each segment starts with its size and its slot, checked when freed.
+**/
+class WorkloadChurn final: public Workload {
+public:
+    /** Word class alias.
+    **/
+    using Word = uint64_t;
+    /** Number of transactions of the first worker between two samples.
+    **/
+    constexpr static size_t sample_period = 1024;
+private:
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram churn_tx; // Churn transactions
+        ptrdiff_t delta = 0; // Segments allocated minus segments freed by the worker
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    size_t nbslots;      // Number of slots
+    size_t min_size;     // Minimum segment size (in bytes)
+    size_t max_size;     // Maximum segment size (in bytes)
+    size_t batch;        // Number of slots visited per transaction
+    AccessPattern access; // Access pattern over the slots
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::atomic<bool> built; // Whether a worker already (re)filled the slots
+    mutable ::std::atomic<ptrdiff_t> live; // Number of live segments, as of the last committed transactions
+    mutable ::std::vector<double> live_samples; // Live segments over time, sampled by the first worker
+    mutable ::std::vector<double> rss_samples;  // Resident set size over time (in KiB), sampled by the first worker
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Allocation-churn workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param nbslots      Number of slots, half of them initially holding a segment
+     * @param min_size     Minimum segment size (in bytes)
+     * @param max_size     Maximum segment size (in bytes), the sizes log-uniform in between
+     * @param batch        Number of slots visited per transaction
+     * @param access       Access pattern over the slots
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadChurn(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbslots, size_t min_size, size_t max_size, size_t batch, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): Workload{library, alignof(Word), (2 + nbslots) * sizeof(Word)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbslots{nbslots}, min_size{::std::max(min_size, 2 * sizeof(Word))}, max_size{::std::max(max_size, ::std::max(min_size, 2 * sizeof(Word)))}, batch{batch}, access{access}, arrival_rate{arrival_rate}, barrier(nbworkers), built{false}, live{0}, states(nbworkers) {}
+private:
+    /** Get the slots.
+     * @param tx Associated pending transaction
+     * @return Segment of each slot, 'nullptr' for none
+    **/
+    Shared<Word*[]> slots(Transaction& tx) const {
+        return Shared<Word*[]>{tx, reinterpret_cast<Word*>(tm.get_start()) + 2};
+    }
+    /** Draw a segment size, log-uniform between the bounds, rounded up to whole words.
+     * @param engine Random engine to use
+     * @return Segment size (in bytes)
+    **/
+    template<class Engine> size_t draw_size(Engine& engine) const {
+        ::std::uniform_real_distribution<double> exponent{::std::log2(static_cast<double>(min_size)), ::std::log2(static_cast<double>(max_size))};
+        auto size = static_cast<size_t>(::std::exp2(exponent(engine)));
+        return (::std::clamp(size, min_size, max_size) + sizeof(Word) - 1) / sizeof(Word) * sizeof(Word);
+    }
+    /** Fill or empty one slot.
+     * @param tx   Associated pending transaction
+     * @param slot Slot to visit
+     * @param size Size of the segment to allocate, if the slot is empty
+     * @return +1 if a segment was allocated, -1 if freed, 0 if the segment freed did not match its slot
+    **/
+    int visit(Transaction& tx, size_t slot, size_t size) const {
+        auto cell = slots(tx)[slot];
+        if (auto segment = cell.read(); segment) {
+            Word header[2];
+            tx.read(segment, sizeof(header), header);
+            if (unlikely(header[1] != slot || header[0] < min_size || header[0] > max_size))
+                return 0;
+            tx.free(segment);
+            cell = nullptr;
+            return -1;
+        }
+        auto fresh = reinterpret_cast<Word*>(tx.alloc(size));
+        Word header[2] = {size, slot};
+        tx.write(header, sizeof(header), fresh);
+        cell = fresh;
+        return 1;
+    }
+    /** Churn transaction, visiting several slots.
+     * @param visits Slot and segment size of each visit
+     * @return Net number of segments allocated, or 'nullopt' if a segment freed did not match its slot
+    **/
+    ::std::optional<ptrdiff_t> churn_tx(::std::vector<::std::pair<size_t, size_t>> const& visits) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) -> ::std::optional<ptrdiff_t> {
+            ptrdiff_t res = 0;
+            for (auto [slot, size]: visits) {
+                auto change = visit(tx, slot, size);
+                if (unlikely(change == 0))
+                    return ::std::nullopt;
+                res += change;
+            }
+            return res;
+        });
+    }
+    /** Count the segments, checking each matches its slot.
+     * @param count Set to the number of segments
+     * @return Whether every segment matched its slot
+    **/
+    bool count_tx(size_t& count) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto cells = slots(tx);
+            count = 0;
+            for (size_t slot = 0; slot < nbslots; ++slot) {
+                auto segment = cells.read(slot);
+                if (!segment)
+                    continue;
+                Word header[2];
+                tx.read(segment, sizeof(header), header);
+                if (unlikely(header[1] != slot || header[0] < min_size || header[0] > max_size))
+                    return false;
+                ++count;
+            }
+            return true;
+        });
+    }
+    /** Get the initial number of segments.
+     * @return Initial number of segments
+    **/
+    size_t initial_size() const noexcept {
+        return (nbslots + 1) / 2;
+    }
+public:
+    virtual char const* init() const {
+        if (built.exchange(true)) // Another worker (re)fills the slots, and the workers wait for each other before running
+            return nullptr;
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) { // Segments of a previous initialization, if any
+            auto cells = slots(tx);
+            for (size_t slot = 0; slot < nbslots; ++slot) {
+                if (auto segment = cells.read(slot); segment) {
+                    tx.free(segment);
+                    cells[slot] = nullptr;
+                }
+            }
+        });
+        // Every other slot, in batches, so that large tables do not need a huge transaction
+        constexpr size_t init_batch = 4096;
+        ::std::minstd_rand engine{static_cast<::std::minstd_rand::result_type>(nbslots)};
+        for (size_t first = 0; first < nbslots; first += 2 * init_batch) {
+            ::std::vector<::std::pair<size_t, size_t>> visits;
+            for (auto slot = first; slot < first + 2 * init_batch && slot < nbslots; slot += 2)
+                visits.emplace_back(slot, draw_size(engine));
+            if (unlikely(!churn_tx(visits)))
+                return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        }
+        live.store(static_cast<ptrdiff_t>(initial_size()), ::std::memory_order_relaxed);
+        size_t count;
+        if (unlikely(!count_tx(count) || count != initial_size()))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::uniform_int_distribution<size_t> uniform{0, nbslots - 1};
+        auto table = access.kind == AccessPattern::Kind::uniform ? ::std::optional<AliasTable>{} : ::std::optional<AliasTable>{::std::in_place, access, nbslots};
+        ::std::vector<::std::pair<size_t, size_t>> visits(batch);
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            visits.resize(batch);
+            for (auto& visit: visits) {
+                visit.first = table ? (*table)(engine) : uniform(engine);
+                visit.second = draw_size(engine);
+            }
+            ::std::sort(visits.begin(), visits.end()); // Each slot at most once
+            visits.erase(::std::unique(visits.begin(), visits.end(), [](auto const& a, auto const& b) { return a.first == b.first; }), visits.end());
+            pacer.start();
+            auto change = churn_tx(visits);
+            local.churn_tx.record(pacer.latency());
+            if (unlikely(!change))
+                return "Violated isolation or atomicity";
+            local.delta += *change;
+            auto now = live.fetch_add(*change, ::std::memory_order_relaxed) + *change;
+            if (uid == 0 && cntr % sample_period == 0) {
+                live_samples.push_back(static_cast<double>(now));
+                rss_samples.push_back(resident_kib());
+            }
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        Histogram res;
+        for (auto const& local: states)
+            res.merge(local.churn_tx);
+        return {{"churn", res}};
+    }
+    virtual ::std::vector<::std::pair<char const*, ::std::vector<double>>> get_series() const {
+        return {{"live segments", live_samples}, {"RSS KiB", rss_samples}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every allocation and free counted exactly once, before the counters overwrite the first words
+            auto expected = static_cast<ptrdiff_t>(initial_size());
+            for (auto const& local: states)
+                expected += local.delta;
+            size_t count;
+            if (unlikely(!count_tx(count) || static_cast<ptrdiff_t>(count) != expected || live.load(::std::memory_order_relaxed) != expected))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
@@ -0,0 +1,282 @@
+/**
+ * @file   clients.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Multiplexed-clients workload: each worker thread drives several logical
+ * clients, each with a transaction of its own in flight, switching from one
+ * client to another between their operations or when one aborts. This shows
+ * how an engine behaves with many more pending transactions than threads,
+ * and whether its transaction handles work when several of them are
+ * interleaved on one thread.
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Multiplexed-clients workload class.
+ * Clients transfer between two accounts, or audit all of them. Each client is a small state machine over the raw operations of the
+ * shared memory, resumed by its worker one step at a time; an aborted transaction is retried when the client is next resumed.
+**/
+class WorkloadClients final: public Workload {
+public:
+    /** Account balance class alias.
+    **/
+    using Balance = intptr_t;
+    /** When a worker switches to its next client.
+    **/
+    enum class Switching {
+        operation, // After every operation, so that every client has a transaction in flight (only for libraries that do not block in 'tm_begin' until the thread's other transactions end)
+        abort      // Only when the transaction of the client commits or aborts
+    };
+private:
+    /** Progress of one step of a client.
+    **/
+    enum class Outcome {
+        pending,   // Transaction still in flight
+        committed, // Transaction committed
+        aborted,   // Transaction aborted, to retry
+        refused    // Transaction could not begin while others of the worker are in flight, to retry
+    };
+    /** One logical client and its transaction in flight.
+    **/
+    struct Client {
+        bool active = false; // Whether the client has a transaction to complete
+        bool audit = false;  // Whether the transaction is an audit, a transfer otherwise
+        size_t step = 0;     // Next step of the transaction, 0 to begin it
+        TransactionalMemory::TX tx = STM::invalid_tx; // Transaction in flight
+        size_t from = 0;     // Account to withdraw from
+        size_t to = 0;       // Account to deposit to
+        Balance amount = 0;  // Amount to transfer, if available
+        Balance from_balance = 0; // Balance read from the account to withdraw from
+        Balance to_balance = 0;   // Balance read from the account to deposit to
+        ::std::vector<Balance> balances; // Balances read by an audit
+        FastChrono latency;  // Since the first attempt of the transaction
+        FastChrono attempt;  // Since the beginning of the current attempt
+    };
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram audit_tx;    // Audit transactions
+        Histogram transfer_tx; // Transfer transactions
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    size_t nbclients;    // Number of clients per worker
+    size_t nbaccounts;   // Number of accounts
+    Balance init_balance; // Initial balance of each account
+    float  prob_audit;   // Probability of an audit transaction
+    Switching switching; // When a worker switches to its next client
+    AccessPattern access; // Access pattern over the accounts
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::atomic<bool> built; // Whether a worker already (re)set the accounts
+    mutable ::std::atomic<uint_fast64_t> refused; // Begins refused so far, the library not taking another transaction on the thread
+    mutable ::std::vector<double> refused_samples; // Refused begins over time, sampled by the first worker
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Multiplexed-clients workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, over all its clients, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param nbclients    Number of clients per worker
+     * @param nbaccounts   Number of accounts
+     * @param init_balance Initial balance of each account
+     * @param prob_audit   Probability of an audit transaction
+     * @param switching    When a worker switches to its next client
+     * @param access       Access pattern over the accounts
+    **/
+    WorkloadClients(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbclients, size_t nbaccounts, Balance init_balance, float prob_audit, Switching switching, AccessPattern const& access = AccessPattern{}): Workload{library, alignof(Balance), (2 + nbaccounts) * sizeof(Balance)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbclients{nbclients}, nbaccounts{nbaccounts}, init_balance{init_balance}, prob_audit{prob_audit}, switching{switching}, access{access}, barrier(nbworkers), built{false}, refused{0}, states(nbworkers) {}
+private:
+    /** Get the address of an account.
+     * @param index Account index
+     * @return Address of the account
+    **/
+    Balance* account(size_t index) const noexcept {
+        return reinterpret_cast<Balance*>(tm.get_start()) + 2 + index;
+    }
+    /** Audit transaction, in one go.
+     * @return Whether the total balance is the initial one
+    **/
+    bool audit_tx() const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            ::std::vector<Balance> balances(nbaccounts);
+            tx.read(account(0), nbaccounts * sizeof(Balance), balances.data());
+            Balance total = 0;
+            for (auto balance: balances)
+                total += balance;
+            return total == static_cast<Balance>(nbaccounts) * init_balance;
+        });
+    }
+    /** Run one step of the transaction of a client.
+     * @param client   Client to resume
+     * @param inflight Number of other transactions of the worker in flight
+     * @param correct  Set to false if a committed audit saw a wrong total
+     * @return Outcome of the step
+    **/
+    Outcome advance(Client& client, size_t inflight, bool& correct) const {
+        auto mode = client.audit ? Transaction::Mode::read_only : Transaction::Mode::read_write;
+        auto done = [&](bool committed) {
+            client.step = 0;
+            return committed ? Outcome::committed : Outcome::aborted;
+        };
+        switch (client.step++) {
+        case 0:
+            client.tx = tm.begin(static_cast<bool>(mode));
+            if (unlikely(client.tx == STM::invalid_tx)) {
+                if (inflight == 0)
+                    throw Exception::TransactionBegin{};
+                client.step = 0;
+                return Outcome::refused;
+            }
+            RetryStats::attempt(mode);
+            client.attempt.start();
+            return Outcome::pending;
+        case 1:
+            if (client.audit) {
+                client.balances.resize(nbaccounts);
+                if (unlikely(!tm.read(client.tx, account(0), nbaccounts * sizeof(Balance), client.balances.data())))
+                    return done(false);
+                return Outcome::pending;
+            }
+            if (unlikely(!tm.read(client.tx, account(client.from), sizeof(Balance), &client.from_balance)))
+                return done(false);
+            if (client.from_balance < client.amount || client.from == client.to)
+                client.step = 5; // Nothing to write
+            return Outcome::pending;
+        case 2:
+            if (client.audit) {
+                if (unlikely(!tm.end(client.tx)))
+                    return done(false);
+                Balance total = 0;
+                for (auto balance: client.balances)
+                    total += balance;
+                if (unlikely(total != static_cast<Balance>(nbaccounts) * init_balance))
+                    correct = false;
+                return done(true);
+            }
+            if (unlikely(!tm.read(client.tx, account(client.to), sizeof(Balance), &client.to_balance)))
+                return done(false);
+            return Outcome::pending;
+        case 3: {
+            auto balance = client.from_balance - client.amount;
+            if (unlikely(!tm.write(client.tx, &balance, sizeof(Balance), account(client.from))))
+                return done(false);
+        } return Outcome::pending;
+        case 4: {
+            auto balance = client.to_balance + client.amount;
+            if (unlikely(!tm.write(client.tx, &balance, sizeof(Balance), account(client.to))))
+                return done(false);
+        } return Outcome::pending;
+        default:
+            return done(tm.end(client.tx));
+        }
+    }
+public:
+    virtual char const* init() const {
+        if (built.exchange(true)) // Another worker (re)sets the accounts, and the workers wait for each other before running
+            return nullptr;
+        constexpr size_t batch = 4096;
+        ::std::vector<Balance> balances(batch, init_balance);
+        for (size_t first = 0; first < nbaccounts; first += batch) {
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                tx.write(balances.data(), ::std::min(batch, nbaccounts - first) * sizeof(Balance), account(first));
+            });
+        }
+        if (unlikely(!audit_tx()))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::bernoulli_distribution audit_dist{prob_audit};
+        ::std::uniform_int_distribution<size_t> uniform{0, nbaccounts - 1};
+        ::std::uniform_int_distribution<Balance> amount_dist{1, init_balance};
+        auto table = access.kind == AccessPattern::Kind::uniform ? ::std::optional<AliasTable>{} : ::std::optional<AliasTable>{::std::in_place, access, nbaccounts};
+        auto draw = [&]() { return table ? (*table)(engine) : uniform(engine); };
+        ::std::vector<Client> clients(nbclients);
+        auto correct = true;
+        auto& local = states[uid];
+        size_t started = 0;
+        size_t inflight = 0; // Transactions of the worker begun and not ended
+        while (true) {
+            auto any = false;
+            for (auto& client: clients) {
+                if (!client.active) { // Next transaction of the client, if any left
+                    if (nbtxperwrk > 0 ? started >= nbtxperwrk : stopping.load(::std::memory_order_relaxed))
+                        continue;
+                    ++started;
+                    client.active = true;
+                    client.audit = audit_dist(engine);
+                    client.from = draw();
+                    client.to = draw();
+                    client.amount = amount_dist(engine);
+                    client.latency.start();
+                }
+                any = true;
+                auto begun = client.step != 0;
+                auto outcome = advance(client, inflight - (begun ? 1 : 0), correct);
+                while (switching == Switching::abort && outcome == Outcome::pending)
+                    outcome = advance(client, inflight - 1, correct);
+                inflight = inflight + (client.step != 0 ? 1 : 0) - (begun ? 1 : 0);
+                if (outcome == Outcome::committed) {
+                    client.active = false;
+                    (client.audit ? local.audit_tx : local.transfer_tx).record(client.latency.delta());
+                } else if (outcome == Outcome::aborted) {
+                    RetryStats::abort(client.audit ? Transaction::Mode::read_only : Transaction::Mode::read_write, client.attempt.delta());
+                } else if (outcome == Outcome::refused) {
+                    refused.fetch_add(1, ::std::memory_order_relaxed);
+                }
+            }
+            if (!any)
+                break;
+        }
+        if (uid == 0)
+            refused_samples.push_back(static_cast<double>(refused.load(::std::memory_order_relaxed)));
+        if (unlikely(!correct))
+            return "Violated isolation or atomicity";
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.audit_tx.merge(local.audit_tx);
+            res.transfer_tx.merge(local.transfer_tx);
+        }
+        return {{"audit", res.audit_tx}, {"transfer", res.transfer_tx}};
+    }
+    virtual ::std::vector<::std::pair<char const*, ::std::vector<double>>> get_series() const {
+        return {{"refused begins", refused_samples}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every transfer atomic, before the counters overwrite the first words
+            if (unlikely(!audit_tx()))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
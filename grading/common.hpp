@@ -24,17 +24,30 @@
 #pragma once
 
 // External headers
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <climits>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <fstream>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 extern "C" {
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 }
 
 // -------------------------------------------------------------------------- //
@@ -71,6 +84,9 @@ constexpr static auto assert_mode = false;
 // Maximum waiting time for initialization/clean-ups (in ms)
 constexpr static auto max_side_time = ::std::chrono::milliseconds{2000};
 
+// Number of checks a waiting thread spins for before parking in the kernel
+constexpr static auto futex_spins = size_t{1024};
+
 // -------------------------------------------------------------------------- //
 namespace Exception {
 
@@ -199,6 +215,108 @@ public:
     }
 };
 
+/** Fine-grained chronometer class, same interface and tick unit as 'Chrono', reading the timestamp counter rather than calling into the
+ * system: cheap enough to time every transaction. Once 'calibrate' found an invariant timestamp counter, cycles are converted with the
+ * calibrated period; otherwise (or before that) every call falls back to 'Chrono'.
+**/
+class FastChrono final {
+public:
+    /** Tick class (always 1 tick = 1 ns).
+    **/
+    using Tick = Chrono::Tick;
+private:
+    inline static double period = 0.; // Nanoseconds per cycle of the timestamp counter, 0 to fall back to 'Chrono'
+    Tick total;      // Total tick counter
+    uint64_t local;  // Segment start (in cycles)
+    Chrono fallback; // Used instead without an invariant timestamp counter
+public:
+    /** Tick constructor.
+     * @param tick Initial number of ticks (optional)
+    **/
+    FastChrono(Tick tick = 0) noexcept: total{tick}, local{0} {}
+private:
+    /** Read the timestamp counter, once every previous instruction executed.
+     * @return Current cycle count
+    **/
+    static uint64_t cycles() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int aux;
+        return __rdtscp(&aux);
+#else
+        return 0;
+#endif
+    }
+public:
+    /** Calibrate the timestamp counter against 'Chrono', to call once at startup before any measurement.
+     * @param duration Calibration duration (in ns)
+     * @return Whether the timestamp counter is invariant, i.e. used from now on
+    **/
+    static bool calibrate(Tick duration = 20000000ul) noexcept {
+        period = 0.;
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(0x80000000u, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007u)
+            return false;
+        __get_cpuid(0x80000007u, &eax, &ebx, &ecx, &edx);
+        if ((edx & (1u << 8)) == 0) // Counter not invariant: its rate follows frequency changes, or it stops in deep sleep states
+            return false;
+        Chrono chrono;
+        chrono.start();
+        auto first = cycles();
+        Tick elapsed;
+        while ((elapsed = chrono.delta()) < duration)
+            continue;
+        auto last = cycles();
+        if (last <= first)
+            return false;
+        period = static_cast<double>(elapsed) / static_cast<double>(last - first);
+        return true;
+#else
+        static_cast<void>(duration);
+        return false;
+#endif
+    }
+    /** Get the calibrated frequency of the timestamp counter.
+     * @return Frequency (in GHz), 0 if 'Chrono' is used instead
+    **/
+    static double get_frequency() noexcept {
+        return period > 0. ? 1. / period : 0.;
+    }
+public:
+    /** Start measuring a time segment.
+    **/
+    void start() noexcept {
+        if (likely(period > 0.)) {
+            local = cycles();
+        } else {
+            fallback.start();
+        }
+    }
+    /** Measure a time segment.
+    **/
+    Tick delta() noexcept {
+        if (likely(period > 0.))
+            return static_cast<Tick>(static_cast<double>(cycles() - local) * period);
+        return fallback.delta();
+    }
+    /** Stop measuring a time segment, and add it to the total.
+    **/
+    void stop() noexcept {
+        total += delta();
+    }
+    /** Reset the total tick counter.
+    **/
+    void reset() noexcept {
+        total = 0;
+    }
+    /** Get the total tick counter.
+     * @return Total tick counter
+    **/
+    auto get_tick() const noexcept {
+        return total;
+    }
+};
+
 /** Atomic waitable latch class.
 **/
 class Latch final {
@@ -250,6 +368,99 @@ public:
     }
 };
 
+/** Log-bucketed histogram of durations, HDR-style: each power of 2 is split in 16 buckets, so any value is known within 1/16.
+**/
+class Histogram final {
+private:
+    constexpr static unsigned int sub_bits = 4; // Bits kept below the leading one
+    constexpr static size_t nbbuckets = (64 - sub_bits + 1) << sub_bits; // Values below 2^sub_bits get one bucket each
+    ::std::array<uint_fast64_t, nbbuckets> buckets; // Number of values per bucket
+    uint_fast64_t count; // Number of values recorded
+    uint_fast64_t total; // Sum of the values recorded
+    Chrono::Tick  max;   // Largest value recorded
+private:
+    /** Get the bucket of a value.
+     * @param value Value to place
+     * @return Bucket index
+    **/
+    constexpr static size_t index_of(uint64_t value) noexcept {
+        if (value < (1ul << sub_bits))
+            return value;
+        auto shift = 63 - __builtin_clzll(value) - sub_bits;
+        return ((shift + 1) << sub_bits) + ((value >> shift) & ((1ul << sub_bits) - 1));
+    }
+    /** Get the largest value of a bucket.
+     * @param index Bucket index
+     * @return Largest value placed in that bucket
+    **/
+    constexpr static uint64_t upper_of(size_t index) noexcept {
+        if (index < (1ul << sub_bits))
+            return index;
+        auto shift = (index >> sub_bits) - 1;
+        return ((((1ul << sub_bits) + (index & ((1ul << sub_bits) - 1)) + 1) << shift) - 1);
+    }
+public:
+    /** Empty histogram constructor.
+    **/
+    Histogram() noexcept: buckets{}, count{0}, total{0}, max{0} {}
+public:
+    /** Record one value.
+     * @param value Value to record (in ns)
+    **/
+    void record(Chrono::Tick value) noexcept {
+        ++buckets[index_of(value)];
+        ++count;
+        total += value;
+        if (value > max)
+            max = value;
+    }
+    /** Add the values of another histogram.
+     * @param other Histogram to merge in
+    **/
+    void merge(Histogram const& other) noexcept {
+        for (size_t i = 0; i < nbbuckets; ++i)
+            buckets[i] += other.buckets[i];
+        count += other.count;
+        total += other.total;
+        if (other.max > max)
+            max = other.max;
+    }
+    /** Get the number of values recorded.
+     * @return Number of values
+    **/
+    auto get_count() const noexcept {
+        return count;
+    }
+    /** Get the sum of the values recorded.
+     * @return Sum (in ns)
+    **/
+    auto get_total() const noexcept {
+        return total;
+    }
+    /** Get the largest value recorded.
+     * @return Largest value (in ns), 0 if none
+    **/
+    auto get_max() const noexcept {
+        return max;
+    }
+    /** Get a percentile, rounded up to the largest value of its bucket.
+     * @param ratio Ratio of the values at or below the returned one, in [0, 1]
+     * @return Percentile (in ns), 0 if no value was recorded
+    **/
+    Chrono::Tick percentile(double ratio) const noexcept {
+        auto rank = static_cast<uint_fast64_t>(ratio * static_cast<double>(count));
+        if (rank == 0)
+            rank = 1;
+        uint_fast64_t seen = 0;
+        for (size_t i = 0; i < nbbuckets; ++i) {
+            seen += buckets[i];
+            if (seen >= rank)
+                return upper_of(i) < max ? upper_of(i) : max;
+        }
+        return max;
+    }
+};
+
 // -------------------------------------------------------------------------- //
 
 /** Pause execution for a "short" period of time.
@@ -262,6 +473,79 @@ static void short_pause() {
 #endif
 }
 
+/** Futex-backed wake-up word, for threads waiting on a condition to spin a bounded number of times then park in the kernel.
+**/
+class Futex final {
+private:
+    ::std::atomic<uint32_t> mutable word; // Generation, bumped on every wake-up
+public:
+    /** Deleted copy constructor/assignment.
+    **/
+    Futex(Futex const&) = delete;
+    Futex& operator=(Futex const&) = delete;
+    /** Default constructor.
+    **/
+    Futex(): word{0} {}
+public:
+    /** [thread-safe] Wake up every waiting thread, to call after making their condition true, release semantic.
+    **/
+    void wake() const noexcept {
+        word.fetch_add(1, ::std::memory_order_release);
+        ::syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+    /** [thread-safe] Wait for a condition, made true before a call to 'wake'.
+     * @param ready Condition to wait for, checked again after every wake-up
+     * @param spins Number of checks before parking
+    **/
+    template<class Ready> void wait(Ready&& ready, size_t spins = futex_spins) const noexcept {
+        for (size_t i = 0; i < spins; ++i) {
+            if (ready())
+                return;
+            short_pause();
+        }
+        while (true) {
+            auto seen = word.load(::std::memory_order_acquire); // Synchronize-with 'wake', any later one changing the word before the kernel compares it
+            if (ready())
+                return;
+            ::syscall(SYS_futex, &word, FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+        }
+    }
+};
+
+/** Get the resident set size of the process.
+ * @return Resident set size (in KiB), 0 if unknown
+**/
+static inline double resident_kib() {
+    ::std::ifstream statm{"/proc/self/statm"};
+    size_t total, resident;
+    if (!(statm >> total >> resident))
+        return 0.;
+    return static_cast<double>(resident) * static_cast<double>(::sysconf(_SC_PAGESIZE)) / 1024.;
+}
+
+/** Get the peak resident set size of the process, since its start or the last 'reset_peak_resident'.
+ * @return Peak resident set size (in KiB), 0 if unknown
+**/
+static inline double peak_resident_kib() {
+    ::std::ifstream status{"/proc/self/status"};
+    ::std::string field;
+    while (status >> field) {
+        if (field == "VmHWM:") {
+            double kib;
+            if (status >> kib)
+                return kib;
+            return 0.;
+        }
+    }
+    return 0.;
+}
+
+/** Reset the peak resident set size of the process to the current one, when the kernel allows it.
+**/
+static inline void reset_peak_resident() {
+    ::std::ofstream{"/proc/self/clear_refs"} << "5";
+}
+
 /** Run some function for some bounded time, throws 'Exception::BoundedOverrun' on overtime.
  * @param dur  Maximum execution duration
  * @param func Function to run (void -> void)
@@ -285,23 +569,31 @@ template<class Rep, class Period, class Func> static void bounded_run(::std::chr
     runner.join();
 }
 
-/** Spin barrier class.
+/** Combining-tree barrier class.
+ * Threads arrive at the leaf of their group of 'fanin' consecutive indices; the last one to arrive at a node goes on to its parent, and
+ * the last one at the root releases everybody by bumping the generation. No counter is shared by more than 'fanin' threads.
 **/
 class Barrier final {
 public:
     /** Counter class.
     **/
     using Counter = uint_fast32_t;
-    /** Mode enum class.
+    /** Number of children of a node.
+    **/
+    constexpr static Counter fanin = 4;
+private:
+    /** Tree node, on a cache line of its own.
     **/
-    enum class Mode {
-        enter,
-        leave
+    struct alignas(64) Node {
+        ::std::atomic<Counter> arrived; // Number of children arrived so far in the current generation
+        Counter expected; // Number of children
+        size_t   parent;  // Index of the parent node, the root being its own parent
     };
 private:
     Counter cardinal; // Total number of threads that synchronize
-    ::std::atomic<Counter> mutable step; // Step counters
-    ::std::atomic<Mode>    mutable mode; // Current mode
+    ::std::vector<Node> mutable nodes; // Leaves first, then each level up to the root, last
+    ::std::atomic<Counter> mutable generation; // Number of completed synchronizations
+    Futex                            released; // Woken on every completed synchronization
 public:
     /** Deleted copy constructor/assignment.
     **/
@@ -310,24 +602,49 @@ public:
     /** Number of threads constructor.
      * @param cardinal Non-null total number of threads synchronizing on this barrier
     **/
-    Barrier(Counter cardinal): cardinal{cardinal}, step{0}, mode{Mode::enter} {}
+    Barrier(Counter cardinal): cardinal{cardinal}, generation{0} {
+        // Size of each level, leaves first
+        ::std::vector<Counter> widths{(cardinal + fanin - 1) / fanin};
+        while (widths.back() > 1)
+            widths.push_back((widths.back() + fanin - 1) / fanin);
+        size_t total = 0;
+        for (auto width: widths)
+            total += width;
+        nodes = ::std::vector<Node>(total);
+        // Link the levels
+        size_t first = 0;    // First node of the level
+        Counter below = cardinal; // Number of threads or nodes arriving at the level
+        for (auto width: widths) {
+            for (Counter i = 0; i < width; ++i) {
+                auto& node = nodes[first + i];
+                node.arrived.store(0, ::std::memory_order_relaxed);
+                node.expected = ::std::min(fanin, below - i * fanin);
+                node.parent = width > 1 ? first + width + i / fanin : first + i;
+            }
+            first += width;
+            below = width;
+        }
+    }
 public:
     /** [thread-safe] Synchronize all the threads.
+     * @param index Index of the calling thread (between 0 to 'cardinal' - 1), distinct among the threads
     **/
-    void sync() const {
-        // Enter
-        if (step.fetch_add(1, ::std::memory_order_relaxed) + 1 == cardinal) { // Set leave mode
-            mode.store(Mode::leave, ::std::memory_order_release);
-        } else { // Wait for leave mode
-            while (unlikely(mode.load(::std::memory_order_acquire) != Mode::leave))
-                short_pause();
-        }
-        // Leave
-        if (step.fetch_sub(1, ::std::memory_order_relaxed) - 1 == 0) { // Set enter mode
-            mode.store(Mode::enter, ::std::memory_order_release);
-        } else { // Wait for enter mode
-            while (unlikely(mode.load(::std::memory_order_acquire) != Mode::enter))
-                short_pause();
+    void sync(Counter index) const {
+        auto seen = generation.load(::std::memory_order_relaxed);
+        size_t at = index / fanin;
+        while (true) {
+            auto& node = nodes[at];
+            if (node.arrived.fetch_add(1, ::std::memory_order_acq_rel) + 1 != node.expected) { // Not the last child, wait for the release
+                released.wait([&]() { return generation.load(::std::memory_order_acquire) != seen; });
+                return;
+            }
+            node.arrived.store(0, ::std::memory_order_relaxed); // Not arrived at again before the release
+            if (node.parent == at) { // Last thread overall, release
+                generation.store(seen + 1, ::std::memory_order_release);
+                released.wake();
+                return;
+            }
+            at = node.parent;
         }
     }
 };
@@ -0,0 +1,668 @@
+/**
+ * @file   containers.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Transactional containers over the helpers of 'transactional.hpp', bound to
+ * a transaction like 'Shared' and laid out for the engines: every node is a
+ * whole number of cache lines and is read with a single transactional read,
+ * and the root of a container (a few words anywhere in shared memory, zeroed
+ * for an empty container) is read once per binding. Sizes are maintained with
+ * commutative increments, and kept out of the part of the root the other
+ * operations read, so that concurrent insertions do not conflict on them.
+ *
+ * 'Container::Vector' stores its elements in chunks of CHUNK_LINES cache
+ * lines found through a directory, so that growing never copies elements.
+ * 'Container::HashMap' chains nodes of one cache line (or more for large
+ * entries) holding several entries each, a probe reading one line per node.
+ * 'Container::BTree' is a B+ tree of nodes of BTREE_LINES cache lines, split
+ * on the way down and never merged: erasures leave nodes partly empty.
+ *
+ * The elements, keys and values are trivial types, of sizes that are multiples
+ * of the alignment of the region, itself at most the size of a pointer.
+**/
+
+#pragma once
+
+// External headers
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "transactional.hpp"
+
+// -------------------------------------------------------------------------- //
+namespace Container {
+
+// Size of a cache line, the unit of the node sizes
+constexpr static auto cache_line = size_t{64};
+
+/** Round a size up to whole cache lines.
+ * @param size Size (in bytes)
+ * @return Rounded size (in bytes)
+**/
+constexpr static size_t cache_lines(size_t size) noexcept {
+    return (size + cache_line - 1) / cache_line * cache_line;
+}
+
+/** Check that fields of the given size can be accessed alone in the region of a transaction.
+ * @param tx   Bound transaction
+ * @param size Size of the field (in bytes)
+**/
+static inline void check_align(Transaction& tx, size_t size) {
+    auto align = tx.get_tm().get_align();
+    if (unlikely(assert_mode && (align > sizeof(void*) || size % align != 0)))
+        throw Exception::SharedAlign{};
+}
+
+// -------------------------------------------------------------------------- //
+
+/** Growable array, in chunks of cache lines.
+ * @param Type Element type
+**/
+template<class Type> class Vector final {
+    static_assert(::std::is_trivial<Type>::value, "elements must be trivial");
+public:
+    /** Root of a vector in shared memory, zeroed for an empty vector.
+    **/
+    struct Root {
+        size_t size;   // Number of elements
+        size_t slots;  // Capacity of the directory, in chunks
+        Type** chunks; // Directory of the chunks
+    };
+    constexpr static size_t chunk_lines = 8; // Cache lines per chunk
+    constexpr static size_t per_chunk = sizeof(Type) < chunk_lines * cache_line ? chunk_lines * cache_line / sizeof(Type) : 1; // Elements per chunk
+private:
+    Transaction& tx; // Bound transaction
+    Root* root;      // Root in shared memory
+    Root cache;      // Private copy of the root
+    bool loaded;     // Whether 'cache' was read
+public:
+    /** Binding constructor.
+     * @param tx      Bound transaction
+     * @param address Root of the vector
+    **/
+    Vector(Transaction& tx, void* address): tx{tx}, root{reinterpret_cast<Root*>(address)}, loaded{false} {
+        check_align(tx, sizeof(Type));
+    }
+private:
+    /** Read the root, once per binding.
+     * @return Private copy of the root
+    **/
+    Root& header() {
+        if (!loaded) {
+            tx.read(root, sizeof(Root), &cache);
+            loaded = true;
+        }
+        return cache;
+    }
+    /** Get the address of an element.
+     * @param index Index of the element, in a chunk allocated
+     * @return Address in shared memory
+    **/
+    Type* locate(size_t index) {
+        Type* chunk;
+        tx.read(header().chunks + index / per_chunk, sizeof(chunk), &chunk);
+        return chunk + index % per_chunk;
+    }
+public:
+    /** Get the number of elements.
+     * @return Number of elements
+    **/
+    size_t size() {
+        return header().size;
+    }
+    /** Read an element.
+     * @param index Index of the element
+     * @return Private copy of the element
+    **/
+    Type read(size_t index) {
+        if (unlikely(assert_mode && index >= size()))
+            throw Exception::SharedOverflow{};
+        Type res;
+        tx.read(locate(index), sizeof(Type), &res);
+        return res;
+    }
+    /** Read consecutive elements, with one read per chunk.
+     * @param first  Index of the first element
+     * @param count  Number of elements
+     * @param target Private array receiving the elements
+    **/
+    void read(size_t first, size_t count, Type* target) {
+        if (unlikely(assert_mode && first + count > size()))
+            throw Exception::SharedOverflow{};
+        while (count > 0) {
+            auto length = per_chunk - first % per_chunk;
+            if (length > count)
+                length = count;
+            tx.read(locate(first), length * sizeof(Type), target);
+            first += length;
+            target += length;
+            count -= length;
+        }
+    }
+    /** Write an element.
+     * @param index  Index of the element
+     * @param source Private content to write
+    **/
+    void write(size_t index, Type const& source) {
+        if (unlikely(assert_mode && index >= size()))
+            throw Exception::SharedOverflow{};
+        tx.write(&source, sizeof(Type), locate(index));
+    }
+    /** Append an element, allocating a chunk (and growing the directory) when the last one is full.
+     * @param source Private content to append
+    **/
+    void push_back(Type const& source) {
+        auto& head = header();
+        if (head.size % per_chunk == 0) {
+            auto slot = head.size / per_chunk;
+            if (slot == head.slots) {
+                // Only the chunk pointers move
+                auto slots = head.slots > 0 ? 2 * head.slots : cache_line / sizeof(Type*);
+                if (head.slots > 0)
+                    head.chunks = reinterpret_cast<Type**>(tx.realloc(head.chunks, cache_lines(head.slots * sizeof(Type*)), cache_lines(slots * sizeof(Type*))));
+                else
+                    head.chunks = reinterpret_cast<Type**>(tx.alloc(cache_lines(slots * sizeof(Type*))));
+                head.slots = slots;
+            }
+            auto chunk = reinterpret_cast<Type*>(tx.alloc(cache_lines(per_chunk * sizeof(Type))));
+            tx.write(&chunk, sizeof(chunk), head.chunks + slot);
+        }
+        tx.write(&source, sizeof(Type), locate(head.size));
+        ++head.size;
+        tx.write(&head, sizeof(Root), root);
+    }
+    /** Remove the last element, freeing its chunk when it empties.
+     * @return Private copy of the removed element
+    **/
+    Type pop_back() {
+        auto& head = header();
+        if (unlikely(assert_mode && head.size == 0))
+            throw Exception::SharedOverflow{};
+        auto res = read(head.size - 1);
+        --head.size;
+        if (head.size % per_chunk == 0) {
+            auto slot = head.chunks + head.size / per_chunk;
+            Type* chunk;
+            tx.read(slot, sizeof(chunk), &chunk);
+            tx.free(chunk);
+            chunk = nullptr;
+            tx.write(&chunk, sizeof(chunk), slot);
+        }
+        tx.write(&head.size, sizeof(head.size), &root->size);
+        return res;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Hash map chaining nodes of cache lines, several entries each.
+ * @param Key   Key type, compared with '=='
+ * @param Value Value type
+ * @param Hash  Hash of the keys
+**/
+template<class Key, class Value, class Hash = ::std::hash<Key>> class HashMap final {
+    static_assert(::std::is_trivial<Key>::value && ::std::is_trivial<Value>::value, "keys and values must be trivial");
+public:
+    /** Root of a map in shared memory, zeroed for an empty map.
+    **/
+    struct Root {
+        void** buckets; // First node of each bucket, allocated by the first insertion
+        size_t mask;    // Number of buckets minus one
+        size_t size;    // Number of entries, only read by 'size'
+    };
+    /** Entry of a node.
+    **/
+    struct Slot {
+        Key key;
+        Value value;
+    };
+    constexpr static size_t node_size = cache_lines(sizeof(size_t) + sizeof(void*) + sizeof(Slot)); // Bytes of a node
+    constexpr static size_t per_node = (node_size - sizeof(size_t) - sizeof(void*)) / sizeof(Slot); // Entries per node
+    /** Node of a bucket, laid out as in shared memory.
+    **/
+    struct alignas(cache_line) Node {
+        size_t count; // Entries used, first ones
+        void* next;   // Next node of the bucket
+        Slot slots[per_node];
+    };
+    static_assert(sizeof(Node) == node_size, "node does not span whole cache lines");
+private:
+    Transaction& tx; // Bound transaction
+    Root* root;      // Root in shared memory
+    size_t buckets;  // Number of buckets of a map the binding creates, a power of 2
+    Root cache;      // Private copy of the root, but its size
+    bool loaded;     // Whether 'cache' was read
+public:
+    /** Binding constructor.
+     * @param tx      Bound transaction
+     * @param address Root of the map
+     * @param buckets Number of buckets, if the first insertion is through this binding (rounded up to a power of 2)
+    **/
+    HashMap(Transaction& tx, void* address, size_t buckets = 1024): tx{tx}, root{reinterpret_cast<Root*>(address)}, buckets{1}, loaded{false} {
+        check_align(tx, sizeof(Slot));
+        while (this->buckets < buckets)
+            this->buckets <<= 1;
+    }
+private:
+    /** Read the root, but its size, once per binding.
+     * @return Private copy of the root
+    **/
+    Root& header() {
+        if (!loaded) {
+            tx.read(root, offsetof(Root, size), &cache);
+            loaded = true;
+        }
+        return cache;
+    }
+    /** Get the bucket of a key.
+     * @param key Key to look for
+     * @return Address of the first node pointer of the bucket
+    **/
+    void** bucket(Key const& key) {
+        auto hash = static_cast<uint64_t>(Hash{}(key)) * UINT64_C(0x9E3779B97F4A7C15);
+        return header().buckets + ((hash ^ (hash >> 32)) & header().mask);
+    }
+    /** Read a node.
+     * @param address Node in shared memory
+     * @param node    Private copy to fill
+    **/
+    void load(void* address, Node& node) {
+        tx.read(address, sizeof(Node), &node);
+    }
+public:
+    /** Get the number of entries, which conflicts with every insertion and erasure.
+     * @return Number of entries
+    **/
+    size_t size() {
+        size_t res;
+        tx.read(&root->size, sizeof(res), &res);
+        return res;
+    }
+    /** Find the value of a key.
+     * @param key Key to look for
+     * @return Private copy of the value, none if the key is absent
+    **/
+    ::std::optional<Value> find(Key const& key) {
+        if (header().buckets == nullptr)
+            return ::std::nullopt;
+        void* address;
+        tx.read(bucket(key), sizeof(address), &address);
+        Node node;
+        for (; address != nullptr; address = node.next) {
+            load(address, node);
+            for (size_t i = 0; i < node.count; ++i) {
+                if (node.slots[i].key == key)
+                    return node.slots[i].value;
+            }
+        }
+        return ::std::nullopt;
+    }
+    /** Insert an entry, or assign the value of the key if present.
+     * @param key   Key of the entry
+     * @param value Value of the entry
+     * @return Whether the key was absent
+    **/
+    bool insert(Key const& key, Value const& value) {
+        auto& head = header();
+        if (head.buckets == nullptr) {
+            head.buckets = reinterpret_cast<void**>(tx.alloc(cache_lines(buckets * sizeof(void*))));
+            head.mask = buckets - 1;
+            tx.write(&head, offsetof(Root, size), root);
+        }
+        auto first = bucket(key);
+        void* address;
+        tx.read(first, sizeof(address), &address);
+        void* room = nullptr; // First node with a free entry
+        size_t used = 0;      // Entries used in that node
+        Node node;
+        Slot slot{key, value};
+        for (; address != nullptr; address = node.next) {
+            load(address, node);
+            for (size_t i = 0; i < node.count; ++i) {
+                if (node.slots[i].key == key) {
+                    tx.write(&slot, sizeof(Slot), &reinterpret_cast<Node*>(address)->slots[i]);
+                    return false;
+                }
+            }
+            if (room == nullptr && node.count < per_node) {
+                room = address;
+                used = node.count;
+            }
+        }
+        if (room != nullptr) {
+            tx.write(&slot, sizeof(Slot), &reinterpret_cast<Node*>(room)->slots[used]);
+            ++used;
+            tx.write(&used, sizeof(used), &reinterpret_cast<Node*>(room)->count);
+        } else {
+            // New node in front of the bucket
+            tx.read(first, sizeof(node.next), &node.next);
+            node.count = 1;
+            node.slots[0] = slot;
+            room = tx.alloc(sizeof(Node));
+            tx.write(&node, sizeof(Node), room);
+            tx.write(&room, sizeof(room), first);
+        }
+        tx.add(&root->size, 1);
+        return true;
+    }
+    /** Erase the entry of a key, moving the last entry of its node in its place.
+     * @param key Key of the entry
+     * @return Whether the key was present
+    **/
+    bool erase(Key const& key) {
+        if (header().buckets == nullptr)
+            return false;
+        void* prev = nullptr;
+        void* address;
+        auto first = bucket(key);
+        tx.read(first, sizeof(address), &address);
+        Node node;
+        for (; address != nullptr; prev = address, address = node.next) {
+            load(address, node);
+            for (size_t i = 0; i < node.count; ++i) {
+                if (!(node.slots[i].key == key))
+                    continue;
+                auto shared = reinterpret_cast<Node*>(address);
+                auto used = node.count - 1;
+                if (used == 0) {
+                    // Unlink the empty node
+                    tx.write(&node.next, sizeof(node.next), prev != nullptr ? &reinterpret_cast<Node*>(prev)->next : first);
+                    tx.free(address);
+                } else {
+                    if (i != used)
+                        tx.write(&node.slots[used], sizeof(Slot), &shared->slots[i]);
+                    tx.write(&used, sizeof(used), &shared->count);
+                }
+                tx.add(&root->size, -1);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** B+ tree of nodes of cache lines, split on the way down.
+ * @param Key   Key type, ordered with '<'
+ * @param Value Value type
+**/
+template<class Key, class Value> class BTree final {
+    static_assert(::std::is_trivial<Key>::value && ::std::is_trivial<Value>::value, "keys and values must be trivial");
+public:
+    /** Root of a tree in shared memory, zeroed for an empty tree.
+    **/
+    struct Root {
+        void* node;    // Root node
+        size_t height; // Levels of inner nodes above the leaves
+        size_t size;   // Number of entries, only read by 'size'
+    };
+    constexpr static size_t node_lines = 4; // Cache lines per node
+    constexpr static size_t node_size = node_lines * cache_line;
+    constexpr static size_t leaf_order = (node_size - sizeof(size_t) - sizeof(void*)) / (sizeof(Key) + sizeof(Value)); // Entries per leaf
+    constexpr static size_t inner_order = (node_size - sizeof(size_t) - sizeof(void*)) / (sizeof(Key) + sizeof(void*)); // Keys per inner node
+    static_assert(leaf_order >= 3 && inner_order >= 3, "keys and values too large for the nodes");
+    /** Leaf, laid out as in shared memory.
+    **/
+    struct alignas(cache_line) Leaf {
+        size_t count; // Entries used, in key order
+        void* next;   // Next leaf in key order
+        Key keys[leaf_order];
+        Value values[leaf_order];
+    };
+    /** Inner node, laid out as in shared memory: 'children[i]' holds the keys below 'keys[i]', the last child the others.
+    **/
+    struct alignas(cache_line) Inner {
+        size_t count; // Keys used, in order
+        Key keys[inner_order];
+        void* children[inner_order + 1];
+    };
+    static_assert(sizeof(Leaf) <= node_size && sizeof(Inner) <= node_size, "node larger than its cache lines");
+private:
+    Transaction& tx; // Bound transaction
+    Root* root;      // Root in shared memory
+    Root cache;      // Private copy of the root, but its size
+    bool loaded;     // Whether 'cache' was read
+public:
+    /** Binding constructor.
+     * @param tx      Bound transaction
+     * @param address Root of the tree
+    **/
+    BTree(Transaction& tx, void* address): tx{tx}, root{reinterpret_cast<Root*>(address)}, loaded{false} {
+        check_align(tx, sizeof(Key));
+        check_align(tx, sizeof(Value));
+    }
+private:
+    /** Read the root, but its size, once per binding.
+     * @return Private copy of the root
+    **/
+    Root& header() {
+        if (!loaded) {
+            tx.read(root, offsetof(Root, size), &cache);
+            loaded = true;
+        }
+        return cache;
+    }
+    /** Get the index of the child of an inner node holding a key.
+     * @param node Inner node
+     * @param key  Key to look for
+     * @return Index of the child
+    **/
+    static size_t child(Inner const& node, Key const& key) noexcept {
+        size_t i = 0;
+        while (i < node.count && !(key < node.keys[i]))
+            ++i;
+        return i;
+    }
+    /** Get the index of the first entry of a leaf not below a key.
+     * @param leaf Leaf
+     * @param key  Key to look for
+     * @return Index of the entry, 'count' if none
+    **/
+    static size_t lower(Leaf const& leaf, Key const& key) noexcept {
+        size_t i = 0;
+        while (i < leaf.count && leaf.keys[i] < key)
+            ++i;
+        return i;
+    }
+    /** Find the leaf that holds a key.
+     * @param key  Key to look for
+     * @param leaf Private copy of the leaf
+     * @return Address of the leaf, null if the tree is empty
+    **/
+    void* descend(Key const& key, Leaf& leaf) {
+        auto address = header().node;
+        if (address == nullptr)
+            return nullptr;
+        Inner inner;
+        for (size_t level = header().height; level > 0; --level) {
+            tx.read(address, sizeof(Inner), &inner);
+            address = inner.children[child(inner, key)];
+        }
+        tx.read(address, sizeof(Leaf), &leaf);
+        return address;
+    }
+    /** Split a full child of an inner node in two, the parent having room for one more key.
+     * @param parent  Private copy of the parent, updated but not written
+     * @param index   Index of the child in the parent
+     * @param address Address of the child
+     * @param leaf    Whether the child is a leaf
+    **/
+    void split(Inner& parent, size_t index, void* address, bool leaf) {
+        Key separator;
+        auto right = tx.alloc(node_size);
+        if (leaf) {
+            Leaf left, fresh;
+            tx.read(address, sizeof(Leaf), &left);
+            auto mid = left.count / 2;
+            fresh.count = left.count - mid;
+            fresh.next = left.next;
+            ::std::memcpy(fresh.keys, left.keys + mid, fresh.count * sizeof(Key));
+            ::std::memcpy(fresh.values, left.values + mid, fresh.count * sizeof(Value));
+            left.count = mid;
+            left.next = right;
+            separator = fresh.keys[0];
+            tx.write(&fresh, sizeof(Leaf), right);
+            tx.write(&left, sizeof(Leaf), address);
+        } else {
+            Inner left, fresh;
+            tx.read(address, sizeof(Inner), &left);
+            auto mid = left.count / 2;
+            separator = left.keys[mid];
+            fresh.count = left.count - mid - 1;
+            ::std::memcpy(fresh.keys, left.keys + mid + 1, fresh.count * sizeof(Key));
+            ::std::memcpy(fresh.children, left.children + mid + 1, (fresh.count + 1) * sizeof(void*));
+            left.count = mid;
+            tx.write(&fresh, sizeof(Inner), right);
+            tx.write(&left, sizeof(Inner), address);
+        }
+        ::std::memmove(parent.keys + index + 1, parent.keys + index, (parent.count - index) * sizeof(Key));
+        ::std::memmove(parent.children + index + 2, parent.children + index + 1, (parent.count - index) * sizeof(void*));
+        parent.keys[index] = separator;
+        parent.children[index + 1] = right;
+        ++parent.count;
+    }
+public:
+    /** Get the number of entries, which conflicts with every insertion and erasure.
+     * @return Number of entries
+    **/
+    size_t size() {
+        size_t res;
+        tx.read(&root->size, sizeof(res), &res);
+        return res;
+    }
+    /** Find the value of a key.
+     * @param key Key to look for
+     * @return Private copy of the value, none if the key is absent
+    **/
+    ::std::optional<Value> find(Key const& key) {
+        Leaf leaf;
+        if (descend(key, leaf) == nullptr)
+            return ::std::nullopt;
+        auto i = lower(leaf, key);
+        if (i == leaf.count || key < leaf.keys[i])
+            return ::std::nullopt;
+        return leaf.values[i];
+    }
+    /** Read the entries from a key on, in key order.
+     * @param from   Smallest key to read
+     * @param count  Most entries to read
+     * @param keys   Private array receiving the keys
+     * @param values Private array receiving the values
+     * @return Number of entries read
+    **/
+    size_t scan(Key const& from, size_t count, Key* keys, Value* values) {
+        Leaf leaf;
+        if (descend(from, leaf) == nullptr)
+            return 0;
+        size_t res = 0;
+        for (auto i = lower(leaf, from); res < count;) {
+            for (; i < leaf.count && res < count; ++i, ++res) {
+                keys[res] = leaf.keys[i];
+                values[res] = leaf.values[i];
+            }
+            if (res == count || leaf.next == nullptr)
+                break;
+            tx.read(leaf.next, sizeof(Leaf), &leaf);
+            i = 0;
+        }
+        return res;
+    }
+    /** Insert an entry, or assign the value of the key if present, splitting the full nodes on the way down.
+     * @param key   Key of the entry
+     * @param value Value of the entry
+     * @return Whether the key was absent
+    **/
+    bool insert(Key const& key, Value const& value) {
+        auto& head = header();
+        if (head.node == nullptr) {
+            Leaf leaf;
+            leaf.count = 1;
+            leaf.next = nullptr;
+            leaf.keys[0] = key;
+            leaf.values[0] = value;
+            head.node = tx.alloc(node_size);
+            head.height = 0;
+            tx.write(&leaf, sizeof(Leaf), head.node);
+            tx.write(&head, offsetof(Root, size), root);
+            tx.add(&root->size, 1);
+            return true;
+        }
+        // A full root gets a parent first, the tree grows from the top
+        size_t count;
+        tx.read(head.node, sizeof(count), &count);
+        if (count == (head.height > 0 ? inner_order : leaf_order)) {
+            Inner parent;
+            parent.count = 0;
+            parent.children[0] = head.node;
+            split(parent, 0, head.node, head.height == 0);
+            head.node = tx.alloc(node_size);
+            ++head.height;
+            tx.write(&parent, sizeof(Inner), head.node);
+            tx.write(&head, offsetof(Root, size), root);
+        }
+        auto address = head.node;
+        Inner inner;
+        for (size_t level = head.height; level > 0; --level) {
+            tx.read(address, sizeof(Inner), &inner);
+            auto i = child(inner, key);
+            auto next = inner.children[i];
+            tx.read(next, sizeof(count), &count);
+            if (count == (level > 1 ? inner_order : leaf_order)) {
+                split(inner, i, next, level == 1);
+                tx.write(&inner, sizeof(Inner), address);
+                next = inner.children[child(inner, key)];
+            }
+            address = next;
+        }
+        Leaf leaf;
+        tx.read(address, sizeof(Leaf), &leaf);
+        auto i = lower(leaf, key);
+        if (i < leaf.count && !(key < leaf.keys[i])) {
+            tx.write(&value, sizeof(Value), &reinterpret_cast<Leaf*>(address)->values[i]);
+            return false;
+        }
+        ::std::memmove(leaf.keys + i + 1, leaf.keys + i, (leaf.count - i) * sizeof(Key));
+        ::std::memmove(leaf.values + i + 1, leaf.values + i, (leaf.count - i) * sizeof(Value));
+        leaf.keys[i] = key;
+        leaf.values[i] = value;
+        ++leaf.count;
+        tx.write(&leaf, sizeof(Leaf), address);
+        tx.add(&root->size, 1);
+        return true;
+    }
+    /** Erase the entry of a key, leaving its leaf partly empty.
+     * @param key Key of the entry
+     * @return Whether the key was present
+    **/
+    bool erase(Key const& key) {
+        Leaf leaf;
+        auto address = descend(key, leaf);
+        if (address == nullptr)
+            return false;
+        auto i = lower(leaf, key);
+        if (i == leaf.count || key < leaf.keys[i])
+            return false;
+        --leaf.count;
+        ::std::memmove(leaf.keys + i, leaf.keys + i + 1, (leaf.count - i) * sizeof(Key));
+        ::std::memmove(leaf.values + i, leaf.values + i + 1, (leaf.count - i) * sizeof(Value));
+        tx.write(&leaf, sizeof(Leaf), address);
+        tx.add(&root->size, -1);
+        return true;
+    }
+};
+
+}
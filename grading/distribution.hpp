@@ -0,0 +1,177 @@
+/**
+ * @file   distribution.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Skewed account selection for the workloads: uniform, Zipfian or hotspot
+ * access patterns, sampled in constant time with Vose's alias method so that
+ * the generator does not become the bottleneck. The hottest ranks are spread
+ * over the account indices, so that skew does not also favor the accounts
+ * found first in the segment chain.
+**/
+
+#pragma once
+
+// External headers
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Access pattern over the accounts.
+**/
+struct AccessPattern {
+    enum class Kind {
+        uniform, // Every account equally likely
+        zipf,    // Account of rank 'r' (from 0) with a weight proportional to 1 / (r + 1)^theta
+        hotspot  // A fraction of the accounts receives a fraction of the accesses, uniformly within each set
+    };
+    Kind   kind            = Kind::uniform;
+    double theta           = 0.;  // Skew of the Zipfian pattern
+    double hot_fraction    = 0.;  // Fraction of the accounts in the hot set
+    double hot_probability = 0.;  // Probability of accessing the hot set
+    /** Get the relative weight of each rank.
+     * @param count Number of accounts
+     * @return Weight of each rank, hottest first
+    **/
+    ::std::vector<double> weights(size_t count) const {
+        ::std::vector<double> res(count, 1.);
+        switch (kind) {
+        case Kind::zipf:
+            for (size_t i = 0; i < count; ++i)
+                res[i] = 1. / ::std::pow(static_cast<double>(i + 1), theta);
+            break;
+        case Kind::hotspot: {
+            auto hot = static_cast<size_t>(::std::ceil(hot_fraction * static_cast<double>(count)));
+            if (hot == 0 || hot >= count) // Degenerate, every account in the same set
+                break;
+            for (size_t i = 0; i < count; ++i)
+                res[i] = i < hot ? hot_probability / static_cast<double>(hot) : (1. - hot_probability) / static_cast<double>(count - hot);
+        } break;
+        default:
+            break;
+        }
+        return res;
+    }
+    /** Get a printable description.
+     * @return Description of the pattern
+    **/
+    ::std::string name() const {
+        ::std::ostringstream res;
+        switch (kind) {
+        case Kind::zipf:
+            res << "zipf (theta " << theta << ")";
+            break;
+        case Kind::hotspot:
+            res << "hotspot (" << (100. * hot_probability) << "% of the accesses to " << (100. * hot_fraction) << "% of the accounts)";
+            break;
+        default:
+            res << "uniform";
+            break;
+        }
+        return res.str();
+    }
+};
+
+/** Parse an access pattern.
+ * @param text "uniform", "zipf:<theta>" or "hotspot:<hot fraction>:<hot probability>"
+ * @return Access pattern
+**/
+static AccessPattern parse_access(::std::string const& text) {
+    AccessPattern res;
+    auto colon = text.find(':');
+    auto kind = text.substr(0, colon);
+    if (kind == "uniform" && colon == ::std::string::npos)
+        return res;
+    if (kind == "zipf" && colon != ::std::string::npos) {
+        res.kind = AccessPattern::Kind::zipf;
+        res.theta = ::std::stod(text.substr(colon + 1));
+        if (unlikely(!(res.theta >= 0.)))
+            throw ::std::invalid_argument{"Zipfian skew must be non-negative"};
+        return res;
+    }
+    if (kind == "hotspot" && colon != ::std::string::npos) {
+        auto second = text.find(':', colon + 1);
+        if (second != ::std::string::npos) {
+            res.kind = AccessPattern::Kind::hotspot;
+            res.hot_fraction = ::std::stod(text.substr(colon + 1, second - colon - 1));
+            res.hot_probability = ::std::stod(text.substr(second + 1));
+            if (unlikely(!(res.hot_fraction > 0. && res.hot_fraction < 1. && res.hot_probability >= 0. && res.hot_probability <= 1.)))
+                throw ::std::invalid_argument{"hot set fraction must be in (0, 1) and its probability in [0, 1]"};
+            return res;
+        }
+    }
+    throw ::std::invalid_argument{"access pattern must be uniform, zipf:<theta> or hotspot:<fraction>:<probability>"};
+}
+
+/** Constant-time sampler of account indices following an access pattern (Vose's alias method).
+**/
+class AliasTable final {
+private:
+    ::std::vector<double>   probs;   // Probability of keeping each column
+    ::std::vector<uint32_t> aliases; // Alternative of each column, as an account index
+    ::std::vector<uint32_t> ids;     // Account index of each column (i.e. rank)
+public:
+    /** Build constructor.
+     * @param pattern Access pattern to follow
+     * @param count   Number of accounts, positive
+     * @param spread  Whether to spread the ranks over the indices, else the index drawn is the rank
+    **/
+    AliasTable(AccessPattern const& pattern, size_t count, bool spread = true): probs(count), aliases(count), ids(count) {
+        // Spread the ranks over the indices with a stride coprime to the count
+        size_t stride = spread ? count / 2 + 1 : 1;
+        while (::std::gcd(stride, count) != 1)
+            ++stride;
+        for (size_t i = 0; i < count; ++i)
+            ids[i] = static_cast<uint32_t>((i * stride) % count);
+        // Split the scaled weights in the small and large ones, then pair them
+        auto weights = pattern.weights(count);
+        auto total = ::std::accumulate(weights.begin(), weights.end(), 0.);
+        ::std::vector<size_t> small, large;
+        for (size_t i = 0; i < count; ++i) {
+            weights[i] *= static_cast<double>(count) / total;
+            (weights[i] < 1. ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            auto less = small.back();
+            small.pop_back();
+            auto more = large.back();
+            probs[less] = weights[less];
+            aliases[less] = ids[more];
+            weights[more] -= 1. - weights[less];
+            if (weights[more] < 1.) {
+                large.pop_back();
+                small.push_back(more);
+            }
+        }
+        for (auto i: small) // Only rounding errors left
+            probs[i] = 1.;
+        for (auto i: large)
+            probs[i] = 1.;
+    }
+public:
+    /** Draw one account index.
+     * @param engine Random engine to use
+     * @return Account index, below the count
+    **/
+    template<class Engine> size_t operator()(Engine& engine) const {
+        ::std::uniform_int_distribution<size_t> column{0, probs.size() - 1};
+        ::std::uniform_real_distribution<double> coin{0., 1.};
+        auto i = column(engine);
+        return coin(engine) < probs[i] ? ids[i] : aliases[i];
+    }
+};
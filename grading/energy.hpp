@@ -0,0 +1,203 @@
+/**
+ * @file   energy.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Energy consumed by the processor packages and their DRAM, from the RAPL
+ * counters: through the 'powercap' sysfs interface if present, otherwise
+ * through the MSRs of the first CPU of each package ('msr' module, root).
+ * The counters are system-wide, so they also count whatever else runs, and
+ * they wrap around: reading them at least once per wrap (about a minute at
+ * full power) keeps the totals exact. Missing domains are reported as such.
+**/
+
+#pragma once
+
+// External headers
+extern "C" {
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+}
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Energy counters of the machine, for the lifetime of the instance.
+**/
+class EnergyCounters final: private NonCopyable {
+public:
+    /** Measured domains.
+    **/
+    enum Domain: size_t {
+        package, // Processor packages
+        dram,    // DRAM attached to the packages
+        nbdomains
+    };
+    /** Energy of every domain (in J), NaN where a domain is not measured.
+    **/
+    using Values = ::std::array<double, nbdomains>;
+    /** Printable names of the domains.
+    **/
+    constexpr static char const* names[nbdomains] = {"package", "DRAM"};
+private:
+    /** One counter of one package.
+    **/
+    struct Source {
+        Domain domain;  // Domain counted
+        ::std::string path; // File of the counter ('energy_uj'), empty for an MSR
+        int fd;         // Descriptor of the MSR device, -1 for a file
+        uint32_t msr;   // Address of the MSR
+        double unit;    // Joules per increment
+        uint64_t range; // Value at which the counter wraps around
+        uint64_t last;  // Value at the latest read
+        double total;   // Energy since the construction (in J)
+    };
+    constexpr static uint32_t msr_unit    = 0x606; // MSR_RAPL_POWER_UNIT
+    constexpr static uint32_t msr_package = 0x611; // MSR_PKG_ENERGY_STATUS
+    constexpr static uint32_t msr_dram    = 0x619; // MSR_DRAM_ENERGY_STATUS
+    ::std::vector<Source> sources; // Counters read
+private:
+    /** Read the first line of a file.
+     * @param path Path of the file
+     * @return First line, empty if unreadable
+    **/
+    static ::std::string read_line(::std::string const& path) {
+        ::std::ifstream file{path};
+        ::std::string res;
+        ::std::getline(file, res);
+        return res;
+    }
+    /** Read the raw value of a counter.
+     * @param source Counter to read
+     * @param value  Receives the raw value
+     * @return Whether the counter could be read
+    **/
+    static bool read_raw(Source const& source, uint64_t& value) {
+        if (source.fd < 0) {
+            auto line = read_line(source.path);
+            if (line.empty())
+                return false;
+            value = ::std::stoull(line);
+            return true;
+        }
+        uint64_t raw;
+        if (::pread(source.fd, &raw, sizeof(raw), source.msr) != sizeof(raw))
+            return false;
+        value = raw & 0xffffffffull; // Only the low 32 bits count
+        return true;
+    }
+    /** Add a counter if it can be read.
+     * @param source Counter, its 'last' and 'total' fields set here
+    **/
+    void add(Source source) {
+        source.total = 0.;
+        if (!read_raw(source, source.last)) {
+            if (source.fd >= 0)
+                ::close(source.fd);
+            return;
+        }
+        sources.push_back(::std::move(source));
+    }
+    /** Find the counters of the 'powercap' interface.
+    **/
+    void open_powercap() {
+        constexpr static char const* root = "/sys/class/powercap/";
+        auto dir = ::opendir(root);
+        if (dir == nullptr)
+            return;
+        while (auto entry = ::readdir(dir)) {
+            ::std::string name{entry->d_name};
+            if (name.compare(0, 10, "intel-rapl") != 0 || name.find(':') == ::std::string::npos)
+                continue;
+            auto path = root + name + "/";
+            auto zone = read_line(path + "name");
+            Domain domain;
+            if (zone.compare(0, 8, "package-") == 0) {
+                domain = package;
+            } else if (zone == "dram") {
+                domain = dram;
+            } else {
+                continue;
+            }
+            auto range = read_line(path + "max_energy_range_uj");
+            add(Source{domain, path + "energy_uj", -1, 0, 1e-6, range.empty() ? 0 : ::std::stoull(range) + 1, 0, 0.});
+        }
+        ::closedir(dir);
+    }
+    /** Find the counters of the MSRs, on the first CPU of each package.
+    **/
+    void open_msr() {
+        ::std::map<::std::string, unsigned int> packages; // First CPU of each package
+        for (unsigned int cpu = 0;; ++cpu) {
+            auto id = read_line("/sys/devices/system/cpu/cpu" + ::std::to_string(cpu) + "/topology/physical_package_id");
+            if (id.empty())
+                break;
+            packages.emplace(id, cpu);
+        }
+        for (auto const& [id, cpu]: packages) {
+            auto path = "/dev/cpu/" + ::std::to_string(cpu) + "/msr";
+            uint64_t units;
+            auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                continue;
+            if (::pread(fd, &units, sizeof(units), msr_unit) != sizeof(units)) {
+                ::close(fd);
+                continue;
+            }
+            auto unit = ::std::ldexp(1., -static_cast<int>((units >> 8) & 0x1f));
+            add(Source{package, path, fd, msr_package, unit, 1ull << 32, 0, 0.});
+            auto other = ::open(path.c_str(), O_RDONLY | O_CLOEXEC); // Each source owns its descriptor
+            if (other >= 0)
+                add(Source{dram, path, other, msr_dram, unit, 1ull << 32, 0, 0.});
+        }
+    }
+public:
+    /** Open constructor, finding the available counters.
+    **/
+    EnergyCounters() {
+        open_powercap();
+        if (sources.empty())
+            open_msr();
+    }
+    /** Close destructor.
+    **/
+    ~EnergyCounters() noexcept {
+        for (auto const& source: sources) {
+            if (source.fd >= 0)
+                ::close(source.fd);
+        }
+    }
+public:
+    /** Read the energy consumed since the construction, to call at least once per wrap around of the counters.
+     * @return Energy of every domain (in J), NaN where not measured
+    **/
+    Values read() {
+        Values res;
+        res.fill(::std::nan(""));
+        for (auto& source: sources) {
+            uint64_t value;
+            if (read_raw(source, value)) {
+                auto delta = value >= source.last || source.range == 0 ? value - source.last : value + source.range - source.last;
+                source.total += static_cast<double>(delta) * source.unit;
+                source.last = value;
+            }
+            res[source.domain] = (::std::isnan(res[source.domain]) ? 0. : res[source.domain]) + source.total;
+        }
+        return res;
+    }
+};
@@ -24,13 +24,26 @@
 // External headers
 #include <algorithm>
 #include <atomic>
+#include <cctype>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <random>
+#include <stdexcept>
+#include <string>
 #include <variant>
 
 // Internal headers
+#include "affinity.hpp"
 #include "common.hpp"
+#include "energy.hpp"
+#include "perfcount.hpp"
+#include "profiler.hpp"
+#include "registry.hpp"
+#include "report.hpp"
+#include "stats.hpp"
 #include "transactional.hpp"
 #include "workload.hpp"
 
@@ -56,7 +69,10 @@ private:
     ::std::atomic<Status>       status;  // Current synchronization status
     ::std::atomic<char const*>  errmsg;  // Any one of the error message(s)
     Chrono                      runtime; // Runtime between 'master_notify' and when the last worker finished
+    ::std::vector<Chrono::Tick> finished; // Time each worker finished its latest run at, since 'master_notify'
     Latch                     donelatch; // For synchronization last worker -> master
+    bool const                   parked; // Whether workers park between runs right away instead of spinning first
+    Futex                       changed; // Woken on every status change the workers wait for
 public:
     /** Deleted copy constructor/assignment.
     **/
@@ -64,19 +80,28 @@ public:
     Sync& operator=(Sync const&) = delete;
     /** Worker count constructor.
      * @param nbworkers Number of workers to support
+     * @param parked    Whether workers park between runs right away instead of spinning first, for when other threads run meanwhile
     **/
-    Sync(unsigned int nbworkers): nbworkers{nbworkers}, nbready{0}, status{Status::Done}, errmsg{nullptr} {}
+    Sync(unsigned int nbworkers, bool parked = false): nbworkers{nbworkers}, nbready{0}, status{Status::Done}, errmsg{nullptr}, finished(nbworkers), parked{parked} {}
+private:
+    /** Set a status the workers wait for, waking them all up at once.
+     * @param value Status to set
+    **/
+    void publish(Status value) noexcept {
+        status.store(value, ::std::memory_order_release); // Synchronize-with workers waiting for that state
+        changed.wake();
+    }
 public:
     /** Master trigger "synchronized" execution in all threads (instead of joining).
     **/
     void master_notify() noexcept {
-        status.store(Status::Wait, ::std::memory_order_relaxed);
         runtime.start();
+        publish(Status::Wait);
     }
     /** Master trigger termination in all threads (instead of notifying).
     **/
     void master_join() noexcept {
-        status.store(Status::Quit, ::std::memory_order_relaxed);
+        publish(Status::Quit);
     }
     /** Master wait for all workers to finish.
      * @param maxtick Maximum number of ticks to wait before exiting the process on an error (optional, 'invalid_tick' for none)
@@ -96,30 +121,40 @@ public:
             throw Exception::Unreachable{"Master woke after raised latch, no timeout, but unexpected status"};
         }
     }
-    /** Worker spin-wait until next run.
+    /** Worker wait until next run, spinning a bounded number of times then parking.
      * @return Whether the worker can proceed, or quit otherwise
     **/
     bool worker_wait() noexcept {
-        while (true) {
-            auto res = status.load(::std::memory_order_relaxed);
-            if (res == Status::Wait)
-                break;
-            if (res == Status::Quit)
-                return false;
-            short_pause();
-        }
-        auto res = nbready.fetch_add(1, ::std::memory_order_relaxed);
-        if (res + 1 == nbworkers) { // Latest worker, switch to run status
+        auto res = Status::Wait;
+        changed.wait([&]() {
+            res = status.load(::std::memory_order_acquire); // Synchronize-with master switching to wait state
+            return res == Status::Wait || res == Status::Quit;
+        }, parked ? 0 : futex_spins);
+        if (res == Status::Quit)
+            return false;
+        if (nbready.fetch_add(1, ::std::memory_order_relaxed) + 1 == nbworkers) { // Latest worker, switch to run status
             nbready.store(0, ::std::memory_order_relaxed);
-            status.store(Status::Run, ::std::memory_order_release); // Synchronize-with previous worker waiting for run/abort state
-        } else do { // Not latest worker, wait for run status
-            short_pause();
-            auto res = status.load(::std::memory_order_acquire); // Synchronize-with latest worker switching to run/abort state
-            if (res == Status::Run || res == Status::Abort)
-                break;
-        } while (true);
+            publish(Status::Run); // Synchronize-with previous worker waiting for run/abort state
+        } else { // Not latest worker, wait for run status
+            changed.wait([&]() {
+                auto res = status.load(::std::memory_order_acquire); // Synchronize-with latest worker switching to run/abort state
+                return res == Status::Run || res == Status::Abort;
+            });
+        }
         return true;
     }
+    /** Worker record the end of its run, before notifying it.
+     * @param uid Unique ID of the worker (between 0 to n-1)
+    **/
+    void worker_finish(unsigned int uid) noexcept {
+        finished[uid] = runtime.delta();
+    }
+    /** Master get the time each worker finished its latest run at, once they all notified it.
+     * @return Finish time of each worker since 'master_notify' (in ns)
+    **/
+    auto const& get_finished() const noexcept {
+        return finished;
+    }
     /** Worker notify termination of its run.
      * @param error Error constant null-terminated string ('nullptr' for none)
     **/
@@ -138,37 +173,199 @@ public:
     }
 };
 
-/** Measure the arithmetic mean of the execution time of the given workload with the given transaction library.
+/** Round-robin turns between the masters of concurrent measurements, so that only one runs a phase at a time.
+**/
+class Turns final {
+private:
+    ::std::mutex              lock;    // Local lock
+    ::std::condition_variable cv;      // For waiting/waking up
+    ::std::vector<bool>       active;  // Whether each participant still takes turns
+    size_t                    current; // Participant whose turn it is
+private:
+    /** Pass the turn to the next active participant, to call with the lock held.
+    **/
+    void advance() {
+        for (size_t i = 1; i <= active.size(); ++i) {
+            auto next = (current + i) % active.size();
+            if (active[next]) {
+                current = next;
+                break;
+            }
+        }
+        cv.notify_all();
+    }
+public:
+    /** Deleted copy constructor/assignment.
+    **/
+    Turns(Turns const&) = delete;
+    Turns& operator=(Turns const&) = delete;
+    /** Participant count constructor, the first participant taking the first turn.
+     * @param count Number of participants
+    **/
+    Turns(size_t count): active(count, true), current{0} {}
+public:
+    /** Wait for the turn of a participant.
+     * @param who Participant index
+    **/
+    void acquire(size_t who) {
+        ::std::unique_lock<decltype(lock)> guard{lock};
+        cv.wait(guard, [&]() { return current == who; });
+    }
+    /** End the turn of a participant.
+     * @param who Participant index, whose turn it is
+    **/
+    void release(size_t who) {
+        ::std::unique_lock<decltype(lock)> guard{lock};
+        if (current == who)
+            advance();
+    }
+    /** Stop taking turns, passing the turn if it was the one of the participant.
+     * @param who Participant index
+    **/
+    void leave(size_t who) {
+        ::std::unique_lock<decltype(lock)> guard{lock};
+        active[who] = false;
+        if (current == who)
+            advance();
+    }
+};
+
+/** One participant of some turns, or none.
+**/
+struct Turn {
+    Turns* turns; // Turns taken, 'nullptr' for none
+    size_t who;   // Participant index
+    /** Wait for the turn, if any.
+    **/
+    void acquire() {
+        if (turns)
+            turns->acquire(who);
+    }
+    /** End the turn, if any.
+    **/
+    void release() {
+        if (turns)
+            turns->release(who);
+    }
+    /** Stop taking turns, if any.
+    **/
+    void leave() {
+        if (turns)
+            turns->leave(who);
+    }
+};
+
+/** Sampler of the commit throughput of all the threads, from a thread of its own for the lifetime of the instance.
+**/
+class Sampler final {
+private:
+    ::std::atomic<bool>   stop;    // Whether the sampling thread must exit
+    ::std::vector<double>& rates;  // Throughput over each period (in transactions per second)
+    ::std::thread          thread; // Sampling thread, if sampling
+public:
+    /** Deleted copy constructor/assignment.
+    **/
+    Sampler(Sampler const&) = delete;
+    Sampler& operator=(Sampler const&) = delete;
+    /** Sampling constructor.
+     * @param period Sampling period (in ns), 0 for none
+     * @param rates  Receives the throughput over each period (in transactions per second)
+    **/
+    Sampler(Chrono::Tick period, ::std::vector<double>& rates): stop{false}, rates{rates} {
+        if (period == 0)
+            return;
+        thread = ::std::thread{[this, period]() {
+            auto last = RetryStats::commits();
+            Chrono chrono;
+            chrono.start();
+            while (!stop.load(::std::memory_order_relaxed)) {
+                ::std::this_thread::sleep_for(::std::chrono::nanoseconds{period});
+                if (stop.load(::std::memory_order_relaxed)) // Partly after the measurements
+                    break;
+                auto count = RetryStats::commits();
+                auto elapsed = chrono.delta();
+                chrono.start();
+                this->rates.push_back(static_cast<double>(count - last) * 1000000000. / static_cast<double>(elapsed));
+                last = count;
+            }
+        }};
+    }
+    /** Stop and join destructor.
+    **/
+    ~Sampler() noexcept {
+        stop.store(true, ::std::memory_order_relaxed);
+        if (thread.joinable())
+            thread.join();
+    }
+};
+
+/** Results of a measurement: error constant null-terminated string ('nullptr' for none), initialization, median performance and check times (in ns), read-write and read-only retry totals and hardware event totals of the performance measurements, execution time and committed transactions of each measured repetition (in ns), finish time (in ns, since the start of the repetition) and committed transactions of each worker summed over the measured repetitions, energy consumed by the measured repetitions (in J).
+**/
+using Measures = ::std::tuple<char const*, Chrono::Tick, Chrono::Tick, Chrono::Tick, RetryStats::Totals, RetryStats::Totals, PerfCounters::Values, ::std::vector<Chrono::Tick>, ::std::vector<uint_fast64_t>, ::std::vector<Chrono::Tick>, ::std::vector<uint_fast64_t>, EnergyCounters::Values>;
+
+/** Measure the median execution time of the given workload with the given transaction library.
  * @param workload     Workload instance to use
  * @param nbthreads    Number of concurrent threads to use
- * @param nbrepeats    Number of repetitions (keep the median)
+ * @param nbwarmups    Number of discarded repetitions before the measured ones
+ * @param nbrepeats    Number of measured repetitions (keep the median)
+ * @param maxrepeats   Maximum number of measured repetitions, when repeating until the confidence interval is narrow enough
+ * @param ci_width     Relative width of the confidence interval of the median to repeat until, 0 for exactly 'nbrepeats' repetitions
  * @param seed         Seed to use for performance measurements
+ * @param duration     Duration of each repetition (in ns), after which the workers are asked to stop, 0 for their fixed number of transactions
  * @param maxtick_init Timeout for (re)initialization ('Chrono::invalid_tick' for none)
  * @param maxtick_perf Timeout for performance measurements ('Chrono::invalid_tick' for none)
  * @param maxtick_chck Timeout for correctness check ('Chrono::invalid_tick' for none)
- * @return Error constant null-terminated string ('nullptr' for none), execution times (in ns) (undefined if inconsistency detected)
+ * @param period       Period of the throughput samples taken during the performance measurements (in ns), 0 for none
+ * @param rates        Receives the throughput over each sampling period (in transactions per second)
+ * @param cpus         CPU of each worker, worker 'i' taking the CPU 'i' modulo their number, empty for none
+ * @param profiler     Sampler of the workers during the measured repetitions, 'nullptr' for none
+ * @param order        Rounds ordering the commits of the performance measurements, 'nullptr' to let the transactions commit freely
+ * @param turn         Turn to take before each phase, for concurrent measurements of other libraries (none by default)
+ * @return Results of the measurement, the times being undefined if inconsistency detected
 **/
-static auto measure(Workload& workload, unsigned int const nbthreads, unsigned int const nbrepeats, Seed seed, Chrono::Tick maxtick_init, Chrono::Tick maxtick_perf, Chrono::Tick maxtick_chck) {
+static Measures measure(Workload& workload, unsigned int const nbthreads, unsigned int const nbwarmups, unsigned int const nbrepeats, unsigned int const maxrepeats, double ci_width, Seed seed, Chrono::Tick duration, Chrono::Tick maxtick_init, Chrono::Tick maxtick_perf, Chrono::Tick maxtick_chck, Chrono::Tick period, ::std::vector<double>& rates, ::std::vector<unsigned int> const& cpus, Profiler* profiler, CommitOrder* order, Turn turn = Turn{nullptr, 0}) {
     ::std::vector<::std::thread> threads(nbthreads);
     ::std::mutex  cerrlock;        // To avoid interleaving writes to 'cerr' in case more than one thread throw
-    Sync          sync{nbthreads}; // "As-synchronized-as-possible" starts so that threads interfere "as-much-as-possible"
+    Sync          sync{nbthreads, turn.turns != nullptr}; // "As-synchronized-as-possible" starts so that threads interfere "as-much-as-possible"
+    ::std::vector<PerfCounters const*> counters(nbthreads); // Hardware counters of each worker, set before its initialization
+    ::std::atomic<bool> measuring{false}; // Whether the next run is a performance one, set before notifying the workers
+    ::std::vector<uint_fast64_t> ran(nbthreads); // Transactions each worker committed in its latest run
+    Barrier loaded{nbthreads}; // For every worker to load its share of the shared memory before any transaction runs
     for (unsigned int i = 0; i < nbthreads; ++i) { // Start threads
         try {
             threads[i] = ::std::thread{[&](unsigned int i) {
+                if (!cpus.empty())
+                    pin_self(cpus[i % cpus.size()]);
+                TransactionalThread registration{workload.get_tm()}; // Per-thread state of the library, released before joining
+                PerfCounters local;
+                counters[i] = &local;
+                Profiler::Sampled sampled{profiler};
                 try {
                     // Initialization
                     if (!sync.worker_wait())
                         return;
-                    sync.worker_notify(workload.init());
-                    // Performance measurements
-                    for (unsigned int count = 0; count < nbrepeats; ++count) {
+                    workload.load(i, nbthreads);
+                    loaded.sync(i);
+                    auto init = workload.init();
+                    workload.get_tm().trace_mark();
+                    sync.worker_notify(init);
+                    // Performance measurements (as many as the master wants)
+                    for (unsigned int count = 0;; ++count) {
                         if (!sync.worker_wait())
                             return;
-                        sync.worker_notify(workload.run(i, seed + nbthreads * count + i));
+                        if (!measuring.load(::std::memory_order_relaxed))
+                            break;
+                        auto before = RetryStats::own_commits();
+                        auto run = [&]() {
+                            CommitOrder::Member member{order, i};
+                            return workload.run(i, seed + nbthreads * count + i);
+                        }();
+                        sync.worker_finish(i);
+                        ran[i] = RetryStats::own_commits() - before;
+                        workload.get_tm().trace_mark();
+                        sync.worker_notify(run);
                     }
                     // Correctness check
-                    if (!sync.worker_wait())
-                        return;
                     sync.worker_notify(workload.check(i, std::random_device{}())); // Random seed is wanted here
                     // Synchronized quit
                     if (!sync.worker_wait())
@@ -192,46 +389,137 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
     try {
         char const* error = nullptr;
         Chrono::Tick time_init = Chrono::invalid_tick;
-        Chrono::Tick times[nbrepeats];
+        Chrono::Tick time_perf = Chrono::invalid_tick;
         Chrono::Tick time_chck = Chrono::invalid_tick;
-        auto const posmedian = nbrepeats / 2;
+        Chrono::Tick elapsed   = 0; // The runtime accumulates over the runs
+        RetryStats::Totals retries[2] = {};
+        PerfCounters::Values events;
+        events.fill(0);
+        auto read_events = [&]() { // Workers are all waiting between the phases
+            PerfCounters::Values res;
+            res.fill(0);
+            for (auto local: counters) {
+                auto values = local->read();
+                for (size_t j = 0; j < PerfCounters::nbevents; ++j)
+                    res[j] = res[j] == PerfCounters::invalid || values[j] == PerfCounters::invalid ? PerfCounters::invalid : res[j] + values[j];
+            }
+            return res;
+        };
+        ::std::vector<Chrono::Tick> repetitions;
+        ::std::vector<uint_fast64_t> commits; // Committed transactions of each measured repetition
+        ::std::vector<Chrono::Tick> finishes(nbthreads); // Finish time of each worker, summed over the measured repetitions
+        ::std::vector<uint_fast64_t> worker_commits(nbthreads); // Committed transactions of each worker, summed over the measured repetitions
+        EnergyCounters energy; // System-wide, read by the master around each repetition
+        EnergyCounters::Values joules;
+        joules.fill(0.);
         { // Initialization (with cheap correctness test)
+            turn.acquire();
             sync.master_notify();
             auto res = sync.master_wait(maxtick_init);
+            turn.release();
             if (unlikely(::std::holds_alternative<char const*>(res))) {
                 error = ::std::get<char const*>(res);
                 goto join;
             }
             time_init = ::std::get<Chrono>(res).get_tick();
+            elapsed = time_init;
         }
         { // Performance measurements (with cheap correctness tests)
-            for (unsigned int i = 0; i < nbrepeats; ++i) {
+            ::std::optional<Sampler> sampler; // Started with the first measured repetition
+            for (unsigned int i = 0;; ++i) {
+                auto measured = i >= nbwarmups;
+                if (i == nbwarmups)
+                    sampler.emplace(period, rates);
+                if (measured && repetitions.size() >= nbrepeats) { // Stop, unless the median is not known precisely enough yet
+                    if (ci_width <= 0. || repetitions.size() >= maxrepeats)
+                        break;
+                    auto spread = spread_of(repetitions);
+                    if (duration > 0) { // Fixed times, the throughput varies instead
+                        ::std::vector<double> costs;
+                        for (size_t j = 0; j < repetitions.size(); ++j)
+                            costs.push_back(static_cast<double>(repetitions[j]) / static_cast<double>(commits[j] > 0 ? commits[j] : 1));
+                        spread = spread_of(costs);
+                    }
+                    if (spread.high - spread.low <= ci_width * spread.median)
+                        break;
+                }
+                turn.acquire();
+                auto before = read_events(); // Workers are all waiting, their counters are stable
+                auto before_joules = energy.read();
+                RetryStats::Totals before_retries[2];
+                for (auto mode = 0; mode < 2; ++mode)
+                    before_retries[mode] = RetryStats::snapshot(static_cast<Transaction::Mode>(mode));
+                measuring.store(true, ::std::memory_order_relaxed);
+                workload.set_stopping(false);
+                if (measured && profiler) // Workers are all waiting, none is sampled outside of the run
+                    profiler->arm(true);
+                if (order) // Same order for the same seed and repetition, warm-ups included
+                    order->start(nbthreads, seed + i);
                 sync.master_notify();
+                if (duration > 0) {
+                    ::std::this_thread::sleep_for(::std::chrono::nanoseconds{duration});
+                    workload.set_stopping(true);
+                }
                 auto res = sync.master_wait(maxtick_perf);
+                if (measured && profiler)
+                    profiler->arm(false);
                 if (unlikely(::std::holds_alternative<char const*>(res))) {
                     error = ::std::get<char const*>(res);
                     goto join;
                 }
-                times[i] = ::std::get<Chrono>(res).get_tick();
+                auto runtime = ::std::get<Chrono>(res).get_tick();
+                auto after_joules = energy.read();
+                if (measured) {
+                    repetitions.push_back(runtime - elapsed);
+                    for (size_t j = 0; j < EnergyCounters::nbdomains; ++j)
+                        joules[j] += after_joules[j] - before_joules[j]; // NaN where not measured
+                    auto after = read_events();
+                    for (size_t j = 0; j < PerfCounters::nbevents; ++j)
+                        events[j] = events[j] == PerfCounters::invalid || after[j] == PerfCounters::invalid ? PerfCounters::invalid : events[j] + (after[j] - before[j]);
+                    uint_fast64_t committed = 0;
+                    for (auto mode = 0; mode < 2; ++mode) { // Only the workers of this measurement ran meanwhile
+                        auto after = RetryStats::snapshot(static_cast<Transaction::Mode>(mode));
+                        retries[mode].attempts += after.attempts - before_retries[mode].attempts;
+                        retries[mode].aborts += after.aborts - before_retries[mode].aborts;
+                        retries[mode].wasted += after.wasted - before_retries[mode].wasted;
+                        committed += (after.attempts - after.aborts) - (before_retries[mode].attempts - before_retries[mode].aborts);
+                    }
+                    commits.push_back(committed);
+                    for (unsigned int j = 0; j < nbthreads; ++j) { // Written by the workers before they notified
+                        finishes[j] += sync.get_finished()[j];
+                        worker_commits[j] += ran[j];
+                    }
+                }
+                turn.release();
+                elapsed = runtime;
+            }
+            sampler.reset();
+            {
+                auto sorted = repetitions;
+                time_perf = median_of(sorted);
             }
-            ::std::nth_element(times, times + posmedian, times + nbrepeats); // Partition times around the median
         }
         { // Correctness check
+            measuring.store(false, ::std::memory_order_relaxed);
+            turn.acquire();
             sync.master_notify();
             auto res = sync.master_wait(maxtick_chck);
+            turn.release();
             if (unlikely(::std::holds_alternative<char const*>(res))) {
                 error = ::std::get<char const*>(res);
                 goto join;
             }
-            time_chck = ::std::get<Chrono>(res).get_tick();
+            time_chck = ::std::get<Chrono>(res).get_tick() - elapsed;
         }
         join: { // Joining
+            turn.leave();
             sync.master_join(); // Join with threads
             for (unsigned int i = 0; i < nbthreads; ++i)
                 threads[i].join();
         }
-        return ::std::make_tuple(error, time_init, times[posmedian], time_chck);
+        return ::std::make_tuple(error, time_init, time_perf, time_chck, retries[static_cast<bool>(Transaction::Mode::read_write)], retries[static_cast<bool>(Transaction::Mode::read_only)], events, repetitions, commits, finishes, worker_commits, joules);
     } catch (...) {
+        turn.leave();
         for (unsigned int i = 0; i < nbthreads; ++i) // Detach threads to avoid termination due to attached thread going out of scope
             threads[i].detach();
         throw;
@@ -240,6 +528,843 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
 
 // -------------------------------------------------------------------------- //
 
+/** Run parameters, settable from the command line or a configuration file.
+**/
+struct Parameters {
+    ::std::vector<size_t> threads; // Numbers of worker threads to evaluate, the hardware concurrency alone if empty
+    size_t nbtxperwrk    = 0;     // Number of transactions per worker, 0 for 200000 in total (over the fewest threads if weak scaling)
+    bool weak_scaling    = false; // Whether the default number of transactions per worker stays fixed as threads increase
+    size_t duration_ms   = 0;     // Duration of each repetition (in ms), 0 for a fixed number of transactions
+    ::std::string workload = "bank"; // Name of the workload to run (see 'workload_registry')
+    WorkloadOptions options;      // Options of the workload
+    ::std::string sweep_option;   // Name of the workload option to sweep, none if empty
+    ::std::vector<::std::string> sweep_values; // Values of the swept workload option
+    AccessPattern access;         // Access pattern of the transactions over the keys (e.g. the accounts of the transfers)
+    unsigned int nbwarmups = 1;   // Number of discarded repetitions before the measured ones
+    unsigned int nbrepeats = 7;   // Number of measured repetitions (keep the median)
+    unsigned int maxrepeats = 50; // Maximum number of measured repetitions when repeating until 'ci_width'
+    double ci_width      = 0.;    // Relative width of the confidence interval of the median to repeat until, 0 for none
+    size_t sample_ms     = 0;     // Period of the throughput samples (in ms), 0 for none
+    ::std::vector<double> arrival_rates; // Aggregate arrival rates to sweep (in TX/s), closed-loop workers if empty
+    Pinning pinning      = Pinning::none; // Policy placing the workers on the CPUs
+    Format format        = Format::text;  // Output format of the results
+    bool interleave      = false; // Whether the libraries take turns repetition after repetition, instead of one after the other
+    ::std::string deterministic;  // Commit order of the performance measurements, 'serial' or 'concurrent' rounds drawn from the seed, free if empty
+    size_t slow_factor   = 8;     // Factor of the reference times after which a library is considered too slow
+    ::std::string record;         // Path of the trace file of the first evaluation of the reference, none if empty
+    ::std::string profile;        // Path of the folded stacks of the workers during the measured repetitions, none if empty
+    ::std::string baseline;       // Path of the JSON results of an earlier run to compare with, none if empty
+    STM::tm_options knobs{};      // Knobs of the regions of the libraries exporting 'tm_create_ex', the strings set apart
+    ::std::string knob_engine;    // Engine of the regions, the library's default if empty
+    ::std::string knob_hugepages; // Backing of the large segments, the library's default if empty
+    bool configured      = false; // Whether a knob was set, otherwise the regions are created with 'tm_create'
+};
+
+/** Parse an on/off knob of the regions.
+ * @param value Value to parse, 0 or 1
+ * @return One of 'TM_OPTION_*'
+**/
+static auto parse_switch(::std::string const& value) {
+    if (value != "0" && value != "1")
+        throw ::std::invalid_argument{"region switches must be 0 or 1"};
+    return value == "1" ? TM_OPTION_ON : TM_OPTION_OFF;
+}
+
+/** Parse a comma-separated list of thread counts.
+ * @param list List to parse, e.g. "1,2,4,8"
+ * @return Thread counts, in the given order
+**/
+static auto parse_threads(::std::string const& list) {
+    ::std::vector<size_t> res;
+    size_t pos = 0;
+    while (true) {
+        auto end = list.find(',', pos);
+        auto count = ::std::stoul(list.substr(pos, end - pos));
+        if (unlikely(count == 0))
+            throw ::std::invalid_argument{"thread counts must be positive"};
+        res.push_back(count);
+        if (end == ::std::string::npos)
+            break;
+        pos = end + 1;
+    }
+    return res;
+}
+
+/** Parse a positive count.
+ * @param value Value to parse
+ * @return Count, positive
+**/
+static auto parse_positive(::std::string const& value) {
+    auto res = ::std::stoul(value);
+    if (unlikely(res == 0))
+        throw ::std::invalid_argument{"counts must be positive"};
+    return static_cast<size_t>(res);
+}
+
+/** Set one run parameter.
+ * @param params Run parameters to update
+ * @param name   Name of the parameter, as the command line option without its leading "--"
+ * @param value  Value to parse
+ * @return Whether the name is the one of a parameter
+**/
+static bool set_parameter(Parameters& params, ::std::string const& name, ::std::string const& value) {
+    if (name == "threads") {
+        params.threads = parse_threads(value);
+    } else if (name == "tx-per-worker") {
+        params.nbtxperwrk = parse_positive(value);
+    } else if (name == "accounts" || name == "expected-accounts" || name == "init-balance" || name == "prob-long" || name == "prob-alloc") { // Bank options, kept as options of their own
+        params.options.set(name, value);
+    } else if (name == "workload-option") {
+        auto equal = value.find('=');
+        if (unlikely(equal == ::std::string::npos || equal == 0))
+            throw ::std::invalid_argument{"workload options must be given as <name>=<value>"};
+        params.options.set(value.substr(0, equal), value.substr(equal + 1));
+    } else if (name == "arrival-rate") {
+        params.arrival_rates.clear();
+        size_t pos = 0;
+        while (true) {
+            auto end = value.find(',', pos);
+            auto rate = ::std::stod(value.substr(pos, end - pos));
+            if (unlikely(!(rate > 0.)))
+                throw ::std::invalid_argument{"arrival rates must be positive"};
+            params.arrival_rates.push_back(rate);
+            if (end == ::std::string::npos)
+                break;
+            pos = end + 1;
+        }
+    } else if (name == "workload") {
+        params.workload = find_workload(value).name;
+    } else if (name == "sweep") {
+        auto equal = value.find('=');
+        if (unlikely(equal == ::std::string::npos || equal == 0 || equal + 1 == value.size()))
+            throw ::std::invalid_argument{"sweeps must be given as <option>=<value>,..."};
+        params.sweep_option = value.substr(0, equal);
+        params.sweep_values.clear();
+        size_t pos = equal + 1;
+        while (true) {
+            auto end = value.find(',', pos);
+            params.sweep_values.push_back(value.substr(pos, end - pos));
+            if (end == ::std::string::npos)
+                break;
+            pos = end + 1;
+        }
+    } else if (name == "access") {
+        params.access = parse_access(value);
+    } else if (name == "warmups") {
+        params.nbwarmups = ::std::stoul(value);
+    } else if (name == "repeats") {
+        params.nbrepeats = parse_positive(value);
+    } else if (name == "max-repeats") {
+        params.maxrepeats = parse_positive(value);
+    } else if (name == "ci-width") {
+        params.ci_width = ::std::stod(value);
+        if (unlikely(!(params.ci_width >= 0.)))
+            throw ::std::invalid_argument{"confidence interval width must be non-negative"};
+    } else if (name == "scaling") {
+        if (value != "strong" && value != "weak")
+            throw ::std::invalid_argument{"scaling must be strong or weak"};
+        params.weak_scaling = value == "weak";
+    } else if (name == "duration-ms") {
+        params.duration_ms = ::std::stoul(value);
+    } else if (name == "interleave") {
+        if (value != "0" && value != "1")
+            throw ::std::invalid_argument{"interleave must be 0 or 1"};
+        params.interleave = value == "1";
+    } else if (name == "deterministic") {
+        if (value != "off" && value != "serial" && value != "concurrent")
+            throw ::std::invalid_argument{"deterministic must be off, serial or concurrent"};
+        params.deterministic = value == "off" ? "" : value;
+    } else if (name == "format") {
+        params.format = parse_format(value);
+    } else if (name == "pin") {
+        params.pinning = parse_pinning(value);
+    } else if (name == "sample-ms") {
+        params.sample_ms = ::std::stoul(value);
+    } else if (name == "slow-factor") {
+        params.slow_factor = parse_positive(value);
+    } else if (name == "record") {
+        params.record = value;
+    } else if (name == "profile") {
+        params.profile = value;
+    } else if (name == "baseline") {
+        params.baseline = value;
+    } else if (name == "tm-engine") {
+        params.knob_engine = value;
+        params.configured = true;
+    } else if (name == "tm-stripes") {
+        params.knobs.stripes = parse_positive(value);
+        params.configured = true;
+    } else if (name == "tm-hugepages") {
+        params.knob_hugepages = value;
+        params.configured = true;
+    } else if (name == "tm-numa") {
+        params.knobs.numa = parse_switch(value);
+        params.configured = true;
+    } else if (name == "tm-versions") {
+        params.knobs.versions = parse_positive(value);
+        params.configured = true;
+    } else if (name == "tm-reclaimer") {
+        params.knobs.reclaimer = parse_switch(value);
+        params.configured = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/** Load run parameters from a configuration file, one "<name> = <value>" per line, '#' starting a comment.
+ * @param params Run parameters to update
+ * @param path   Path of the configuration file
+**/
+static void load_parameters(Parameters& params, char const* path) {
+    ::std::ifstream file{path};
+    if (unlikely(!file))
+        throw ::std::invalid_argument{::std::string{"unable to open configuration file '"} + path + "'"};
+    auto trim = [](::std::string const& text) {
+        auto first = text.find_first_not_of(" \t\r");
+        if (first == ::std::string::npos)
+            return ::std::string{};
+        return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+    };
+    ::std::string line;
+    while (::std::getline(file, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+        auto equal = line.find('=');
+        if (unlikely(equal == ::std::string::npos || !set_parameter(params, trim(line.substr(0, equal)), trim(line.substr(equal + 1)))))
+            throw ::std::invalid_argument{"invalid configuration line '" + line + "'"};
+    }
+}
+
+/** Shortest timeout of the initialization and the check (in ns), their reference times being too short to scale reliably (e.g. first allocations).
+**/
+constexpr static Chrono::Tick min_timeout = 100000000ul;
+
+/** Evaluate the reference and the tested libraries with a given number of worker threads.
+ * @param nbworkers Number of concurrent threads
+ * @param arrival   Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+ * @param params    Run parameters
+ * @param seed      Seed to use for performance measurements
+ * @param paths     Paths of the libraries, the reference first
+ * @param nbpaths   Number of libraries
+ * @param rates     Receives the throughput of each library (in transactions per second)
+ * @param tails     Receives the 99th percentile latency of the short transactions of each library (in ns)
+ * @param records   Receives the results of each library
+ * @return Program return code, 0 if every library passed
+**/
+static int evaluate(size_t nbworkers, double arrival, Parameters const& params, Seed seed, char** paths, int nbpaths, ::std::vector<double>& rates, ::std::vector<Chrono::Tick>& tails, ::std::vector<Record>& records) {
+    // Get/set/compute run parameters
+    auto const nbtxperwrk    = params.nbtxperwrk > 0 ? params.nbtxperwrk : ::std::max(200000ul / (params.weak_scaling && !params.threads.empty() ? *::std::min_element(params.threads.begin(), params.threads.end()) : nbworkers), 1ul);
+    auto const duration      = static_cast<Chrono::Tick>(params.duration_ms) * 1000000ul;
+    auto const nbwarmups     = params.nbwarmups;
+    auto const nbrepeats     = params.nbrepeats;
+    auto const maxrepeats    = ::std::max(params.maxrepeats, params.nbrepeats);
+    auto const ci_width      = params.ci_width;
+    auto const clk_res       = Chrono::get_resolution();
+    auto const slow_factor   = params.slow_factor;
+    auto const& entry        = find_workload(params.workload);
+    auto options = params.options;
+    auto const build = entry.prepare(WorkloadSettings{nbworkers, duration > 0 ? 0 : nbtxperwrk, params.access, arrival}, options);
+    options.check_unused(entry.name);
+    // Knobs of the regions, only passed to the libraries exporting 'tm_create_ex'
+    auto knobs = params.knobs;
+    knobs.engine = params.knob_engine.empty() ? nullptr : params.knob_engine.c_str();
+    knobs.hugepages = params.knob_hugepages.empty() ? nullptr : params.knob_hugepages.c_str();
+    auto const configure = [&](TransactionalLibrary& tl) {
+        if (params.configured)
+            tl.configure(&knobs);
+    };
+    // Print run parameters
+    ::std::cout << "⎧ #worker threads:     " << nbworkers << ::std::endl;
+    if (duration > 0) {
+        ::std::cout << "⎪ Run duration:        " << params.duration_ms << " ms (throughput reported for " << nbtxperwrk << " TX per worker)" << ::std::endl;
+    } else {
+        ::std::cout << "⎪ #TX per worker:      " << nbtxperwrk << (params.weak_scaling ? " (weak scaling)" : "") << ::std::endl;
+    }
+    ::std::cout << "⎪ #repetitions:        " << nbrepeats;
+    if (ci_width > 0.)
+        ::std::cout << " to " << maxrepeats << ", until the " << (100. * bootstrap_level) << "% CI is within " << (100. * ci_width) << "%";
+    ::std::cout << " (+" << nbwarmups << " warm-up)" << ::std::endl;
+    ::std::cout << "⎪ Workload:            " << entry.name << " (" << entry.description << ")" << ::std::endl;
+    for (auto const& [name, value]: options.get_resolved())
+        ::std::cout << "⎪   " << name << ":" << ::std::string(name.size() < 18 ? 18 - name.size() : 1, ' ') << value << ::std::endl;
+    ::std::cout << "⎪ Access pattern:      " << params.access.name() << ::std::endl;
+    if (arrival > 0.)
+        ::std::cout << "⎪ Arrival rate:        " << arrival << " TX/s (open loop, latencies from the scheduled arrivals)" << ::std::endl;
+    ::std::cout << "⎪ Slow trigger factor: " << slow_factor << ::std::endl;
+    if (params.configured)
+        ::std::cout << "⎪ Region knobs:        engine " << (knobs.engine ? knobs.engine : "default") << ", stripes " << knobs.stripes << ", hugepages " << (knobs.hugepages ? knobs.hugepages : "default") << ", numa " << knobs.numa << ", versions " << knobs.versions << ", reclaimer " << knobs.reclaimer << " (0 for the defaults, 1 on, 2 off; with 'tm_create_ex' only)" << ::std::endl;
+    if (params.interleave)
+        ::std::cout << "⎪ Interleaved:         yes (no timeout, no sampling)" << ::std::endl;
+    if (params.sample_ms > 0 && !params.interleave)
+        ::std::cout << "⎪ Sampling period:     " << params.sample_ms << " ms" << ::std::endl;
+    if (!params.profile.empty())
+        ::std::cout << "⎪ Profiling:           " << Profiler::frequency << " stacks per second of worker CPU time, measured repetitions only" << ::std::endl;
+    if (!params.deterministic.empty())
+        ::std::cout << "⎪ Commit order:        " << params.deterministic << " rounds, drawn from the seed and the worker IDs" << ::std::endl;
+    auto const cpus = pinning_order(params.pinning);
+    ::std::cout << "⎪ Thread pinning:      " << pinning_name(params.pinning);
+    if (!cpus.empty()) {
+        ::std::cout << " (worker:CPU";
+        for (size_t i = 0; i < nbworkers; ++i)
+            ::std::cout << " " << i << ":" << cpus[i % cpus.size()];
+        ::std::cout << ")";
+    }
+    ::std::cout << ::std::endl;
+    ::std::cout << "⎪ Clock resolution:    ";
+    if (unlikely(clk_res == Chrono::invalid_tick)) {
+        ::std::cout << "<unknown>" << ::std::endl;
+    } else {
+        ::std::cout << clk_res << " ns" << ::std::endl;
+    }
+    ::std::cout << "⎪ TX latency clock:    ";
+    if (FastChrono::get_frequency() > 0.) {
+        ::std::cout << "invariant TSC at " << FastChrono::get_frequency() << " GHz" << ::std::endl;
+    } else {
+        ::std::cout << "system clock (no invariant TSC)" << ::std::endl;
+    }
+    ::std::cout << "⎩ Seed value:          " << seed << ::std::endl;
+    // Library evaluations
+    double reference = 0.; // Set to avoid irrelevant '-Wmaybe-uninitialized'
+    ::std::vector<Chrono::Tick> reference_times; // Measured repetitions of the reference
+    auto const pertxdiv = static_cast<double>(nbworkers) * static_cast<double>(nbtxperwrk);
+    auto maxtick_init = Chrono::invalid_tick;
+    auto maxtick_perf = Chrono::invalid_tick;
+    auto maxtick_chck = Chrono::invalid_tick;
+    rates.clear();
+    tails.clear();
+    // Record the transactions of the reference, if asked
+    ::std::optional<TraceRecorder> recorder;
+    auto record = [&](Workload& workload) {
+        if (params.record.empty())
+            return;
+        auto const& tm = workload.get_tm();
+        recorder.emplace(tm.get_start(), tm.get_size(), tm.get_align());
+        workload.set_recorder(&*recorder);
+    };
+    auto save = [&](Workload& workload) {
+        if (!recorder)
+            return;
+        workload.set_recorder(nullptr);
+        recorder->save(params.record.c_str());
+        recorder.reset();
+        ::std::cout << "⎪ Recorded trace:            " << params.record << ::std::endl;
+    };
+    // Write the stacks sampled during the measurements of one library, while it is still loaded
+    auto profile = [&](int i, Profiler& profiler) {
+        auto name = ::std::string{paths[i]};
+        auto slash = name.rfind('/');
+        if (slash != ::std::string::npos)
+            name = name.substr(slash + 1);
+        auto [samples, dropped] = profiler.write(params.profile, name + " (" + ::std::to_string(nbworkers) + " threads)");
+        ::std::cout << "⎪ Profile:                   " << samples << " samples";
+        if (dropped > 0)
+            ::std::cout << " (" << dropped << " dropped, out of room)";
+        ::std::cout << " appended to " << params.profile << ::std::endl;
+    };
+    // Print and record the results of one library, the reference first
+    auto report = [&](int i, Workload& workload, Measures const& res, ::std::vector<double> const& samples, double peak_kib) {
+        // Check false negative-free correctness
+        auto error = ::std::get<0>(res);
+        if (unlikely(error)) {
+            ::std::cout << "⎩ " << error << ::std::endl;
+            return false;
+        }
+        // Print results
+        auto tick_init = ::std::get<1>(res);
+        auto tick_perf = ::std::get<2>(res);
+        auto tick_chck = ::std::get<3>(res);
+        auto const& commits = ::std::get<8>(res);
+        ::std::vector<Chrono::Tick> times = ::std::get<7>(res);
+        auto const maxtick_base = tick_perf;
+        if (duration > 0) { // Time each repetition would have taken for the nominal number of transactions, at its throughput
+            for (size_t j = 0; j < times.size(); ++j)
+                times[j] = static_cast<Chrono::Tick>(static_cast<double>(times[j]) * pertxdiv / static_cast<double>(commits[j] > 0 ? commits[j] : 1));
+            auto sorted = times;
+            tick_perf = median_of(sorted);
+        }
+        auto perfdbl = static_cast<double>(tick_perf);
+        auto spread = spread_of(times);
+        auto speedup = 1.;
+        ::std::pair<double, double> speedup_ci{1., 1.};
+        rates.push_back(pertxdiv * 1000000000. / perfdbl);
+        if (duration > 0) {
+            ::std::cout << "⎪ Committed TX per second:   " << (pertxdiv * 1000000000. / perfdbl);
+        } else {
+            ::std::cout << "⎪ Total user execution time: " << (perfdbl / 1000000.) << " ms";
+        }
+        if (i == 0) { // Set reference performance
+            maxtick_init = ::std::max<Chrono::Tick>(slow_factor * tick_init, min_timeout);
+            if (unlikely(maxtick_init == Chrono::invalid_tick)) // Bad luck...
+                ++maxtick_init;
+            maxtick_perf = slow_factor * maxtick_base;
+            if (unlikely(maxtick_perf == Chrono::invalid_tick)) // Bad luck...
+                ++maxtick_perf;
+            maxtick_chck = ::std::max<Chrono::Tick>(slow_factor * tick_chck, min_timeout);
+            if (unlikely(maxtick_chck == Chrono::invalid_tick)) // Bad luck...
+                ++maxtick_chck;
+            reference = perfdbl;
+            reference_times = times;
+        } else { // Compare with reference performance
+            if (params.interleave) { // Paired repetitions, ran back-to-back
+                auto paired = paired_speedup(reference_times, times);
+                speedup = paired.median;
+                speedup_ci = {paired.low, paired.high};
+            } else {
+                speedup = reference / perfdbl;
+                speedup_ci = speedup_interval(reference_times, times);
+            }
+            ::std::cout << " -> " << speedup << " speedup [" << speedup_ci.first << ", " << speedup_ci.second << "]";
+            if (params.interleave)
+                ::std::cout << " (median of " << ::std::min(times.size(), reference_times.size()) << " paired repetitions)";
+        }
+        ::std::cout << ::std::endl;
+        ::std::cout << "⎪ " << (100. * bootstrap_level) << "% CI of the median:  [" << (spread.low / 1000000.) << ", " << (spread.high / 1000000.) << "] ms" << (duration > 0 ? " for the nominal TX" : "") << " over " << times.size() << " repetitions (CV " << (100. * spread.cv) << "%)" << ::std::endl;
+        struct STM::tm_stats stats;
+        if (workload.get_tm().stats(stats)) { // Optional, the library may not export 'tm_stats'
+            uint_fast64_t aborts = 0;
+            for (auto count: stats.aborts)
+                aborts += count;
+            ::std::cout << "⎪ Committed/aborted TX:  " << stats.commits << " / " << aborts << " (read " << stats.aborts[TM_ABORT_READ] << ", lock " << stats.aborts[TM_ABORT_LOCK] << ", validate " << stats.aborts[TM_ABORT_VALIDATE] << ", other " << stats.aborts[TM_ABORT_OTHER] << ")" << ::std::endl;
+            ::std::cout << "⎪ Extended/irrevocable:  " << stats.extensions << " / " << stats.irrevocable << ::std::endl;
+            ::std::cout << "⎪ Commits by retries:    ";
+            for (size_t i = 0; i < TM_RETRY_BUCKETS; ++i)
+                ::std::cout << (i == 0 ? "0" : i + 1 == TM_RETRY_BUCKETS ? ::std::to_string(1 << (i - 1)) + "+" : i == 1 ? "1" : ::std::to_string(1 << (i - 1)) + "-" + ::std::to_string((1 << i) - 1)) << ": " << stats.retries[i] << (i + 1 < TM_RETRY_BUCKETS ? ", " : "");
+            ::std::cout << " (max " << stats.max_retries << ")" << ::std::endl;
+            if (stats.stripes > 0)
+                ::std::cout << "⎪ Stripes/resizes:       " << stats.stripes << " / " << stats.resizes << ::std::endl;
+        }
+        { // Memory footprint at the end of the measurements, the library's share of it if it says
+            auto available = workload.get_tm().stats(stats) && stats.data_bytes > 0;
+            if (peak_kib > 0. || available) {
+                ::std::cout << "⎪ Memory:                ";
+                if (peak_kib > 0.)
+                    ::std::cout << "peak RSS " << (peak_kib / 1024.) << " MiB" << (params.interleave ? " (all libraries)" : "") << (available ? ", " : "");
+                if (available)
+                    ::std::cout << "data " << (static_cast<double>(stats.data_bytes) / 1048576.) << " MiB, metadata " << (static_cast<double>(stats.metadata_bytes) / 1048576.) << " MiB (" << (static_cast<double>(stats.metadata_bytes) / static_cast<double>(stats.data_bytes)) << " per data byte, " << (static_cast<double>(stats.descriptor_bytes) / static_cast<double>(nbworkers)) << " bytes of descriptor and logs per worker TX)";
+                ::std::cout << ::std::endl;
+            }
+        }
+        for (auto const& entry: {::std::make_pair("RW", ::std::get<4>(res)), ::std::make_pair("RO", ::std::get<5>(res))}) {
+            auto const& totals = entry.second;
+            if (totals.attempts == 0)
+                continue;
+            auto commits = totals.attempts - totals.aborts;
+            ::std::cout << "⎪ " << entry.first << " attempts/commit:    " << (static_cast<double>(totals.attempts) / static_cast<double>(commits > 0 ? commits : 1)) << " (abort ratio " << (100. * static_cast<double>(totals.aborts) / static_cast<double>(totals.attempts)) << "%, " << (static_cast<double>(totals.wasted) / 1000000.) << " ms in aborted attempts, summed over workers and repetitions)" << ::std::endl;
+        }
+        { // Spread of the workers, which the time of the slowest hides
+            auto const& finishes = ::std::get<9>(res);
+            auto const& worker_commits = ::std::get<10>(res);
+            if (finishes.size() > 1 && !times.empty()) {
+                auto sorted = finishes;
+                ::std::sort(sorted.begin(), sorted.end());
+                auto runs = static_cast<double>(times.size());
+                ::std::cout << "⎪ Worker finish times:   min " << (static_cast<double>(sorted.front()) / runs / 1000000.) << " ms, median " << (static_cast<double>(sorted[sorted.size() / 2]) / runs / 1000000.) << " ms, max " << (static_cast<double>(sorted.back()) / runs / 1000000.) << " ms (skew " << (sorted.back() > 0 ? 100. * static_cast<double>(sorted.back() - sorted.front()) / static_cast<double>(sorted.back()) : 0.) << "% of the slowest)" << ::std::endl;
+                ::std::vector<double> worker_rates;
+                for (size_t j = 0; j < finishes.size(); ++j)
+                    worker_rates.push_back(static_cast<double>(worker_commits[j]) * 1000000000. / static_cast<double>(finishes[j] > 0 ? finishes[j] : 1));
+                ::std::sort(worker_rates.begin(), worker_rates.end());
+                if (worker_rates.back() > 0.)
+                    ::std::cout << "⎪ Worker commit rates:   min " << worker_rates.front() << ", median " << worker_rates[worker_rates.size() / 2] << ", max " << worker_rates.back() << " TX/s" << ::std::endl;
+            }
+        }
+        if (!samples.empty()) {
+            ::std::cout << "⎪ Throughput every " << params.sample_ms << " ms (TX/s):";
+            for (size_t i = 0; i < samples.size(); ++i)
+                ::std::cout << (i == 0 ? " " : ", ") << samples[i];
+            ::std::cout << ::std::endl;
+        }
+        { // Hardware events per committed transaction, when the counters are available
+            auto const& events = ::std::get<6>(res);
+            auto commits = 0.;
+            for (auto const& totals: {::std::get<4>(res), ::std::get<5>(res)})
+                commits += static_cast<double>(totals.attempts - totals.aborts);
+            auto any = false;
+            for (size_t j = 0; j < PerfCounters::nbevents; ++j)
+                any |= events[j] != PerfCounters::invalid;
+            if (any && commits > 0) {
+                ::std::cout << "⎪ Per committed TX:     ";
+                for (size_t j = 0; j < PerfCounters::nbevents; ++j) {
+                    ::std::cout << (j == 0 ? " " : ", ");
+                    if (events[j] == PerfCounters::invalid) {
+                        ::std::cout << "n/a";
+                    } else {
+                        ::std::cout << (static_cast<double>(events[j]) / commits);
+                    }
+                    ::std::cout << " " << PerfCounters::names[j];
+                }
+                if (events[PerfCounters::cycles] != PerfCounters::invalid && events[PerfCounters::instructions] != PerfCounters::invalid && events[PerfCounters::cycles] > 0)
+                    ::std::cout << " (IPC " << (static_cast<double>(events[PerfCounters::instructions]) / static_cast<double>(events[PerfCounters::cycles])) << ")";
+                ::std::cout << ::std::endl;
+            }
+        }
+        { // Energy per committed transaction, when the counters are available
+            auto const& joules = ::std::get<11>(res);
+            auto total = 0.;
+            auto any = false;
+            for (auto value: joules) {
+                if (!::std::isnan(value)) {
+                    total += value;
+                    any = true;
+                }
+            }
+            uint_fast64_t committed = 0;
+            for (auto count: commits)
+                committed += count;
+            Chrono::Tick runtime = 0;
+            for (auto time: ::std::get<7>(res))
+                runtime += time;
+            if (any && committed > 0 && runtime > 0) {
+                ::std::cout << "⎪ Energy:                " << (total * 1000. / static_cast<double>(committed)) << " J per 1000 commits (";
+                for (size_t j = 0; j < EnergyCounters::nbdomains; ++j)
+                    ::std::cout << (j == 0 ? "" : ", ") << EnergyCounters::names[j] << " " << (::std::isnan(joules[j]) ? ::std::string{"n/a"} : ::std::to_string(joules[j] * 1000. / static_cast<double>(committed)));
+                ::std::cout << "), " << (total * 1000000000. / static_cast<double>(runtime)) << " W on average" << ::std::endl;
+            }
+        }
+        auto const bytes_per_tx = workload.get_bytes_per_tx();
+        if (bytes_per_tx > 0.)
+            ::std::cout << "⎪ Bandwidth:             " << (bytes_per_tx * pertxdiv * 1000. / perfdbl) << " MB/s (" << bytes_per_tx << " bytes read and written per TX)" << ::std::endl;
+        auto latencies = workload.get_latencies();
+        tails.push_back(latencies.empty() ? 0 : latencies.back().second.percentile(0.99));
+        for (auto const& [name, histogram]: latencies) {
+            if (histogram.get_count() == 0)
+                continue;
+            ::std::string title{name};
+            title[0] = static_cast<char>(::std::toupper(static_cast<unsigned char>(title[0])));
+            ::std::cout << "⎪ " << title << " TX latency (ns):" << ::std::string(title.size() < 7 ? 7 - title.size() : 1, ' ') << "p50 " << histogram.percentile(0.5) << ", p90 " << histogram.percentile(0.9) << ", p99 " << histogram.percentile(0.99) << ", p99.9 " << histogram.percentile(0.999) << ", max " << histogram.get_max() << " (" << histogram.get_count() << " TX)" << ::std::endl;
+        }
+        { // Share of the commits and of the time of each class of transactions, to tell which one dominates
+            uint_fast64_t count = 0;
+            uint_fast64_t total = 0;
+            size_t classes = 0;
+            for (auto const& [name, histogram]: latencies) {
+                count += histogram.get_count();
+                total += histogram.get_total();
+                classes += histogram.get_count() > 0 ? 1 : 0;
+            }
+            if (classes > 1 && total > 0) {
+                ::std::cout << "⎪ Share per TX class:    ";
+                auto first = true;
+                for (auto const& [name, histogram]: latencies) {
+                    if (histogram.get_count() == 0)
+                        continue;
+                    ::std::cout << (first ? " " : "; ") << name << " " << (100. * static_cast<double>(histogram.get_count()) / static_cast<double>(count)) << "% of commits, " << (100. * static_cast<double>(histogram.get_total()) / static_cast<double>(total)) << "% of time";
+                    first = false;
+                }
+                ::std::cout << ::std::endl;
+            }
+        }
+        auto const phases = workload.get_phases();
+        for (size_t j = 0; j < phases.size(); ++j) {
+            ::std::cout << "⎪ Phase " << (j + 1) << " (" << phases[j].name << "): " << phases[j].throughput << " TX/s";
+            if (!::std::isnan(phases[j].readapt_ms))
+                ::std::cout << ", settled " << phases[j].readapt_ms << " ms after each change";
+            ::std::cout << ::std::endl;
+        }
+        auto const series = workload.get_series();
+        for (auto const& [name, values]: series) {
+            if (values.empty())
+                continue;
+            ::std::string title{name};
+            title[0] = static_cast<char>(::std::toupper(static_cast<unsigned char>(title[0])));
+            auto [low, high] = ::std::minmax_element(values.begin(), values.end());
+            ::std::cout << "⎪ " << title << " over time: " << values.front() << " -> " << values.back() << " (min " << *low << ", max " << *high << ", " << values.size() << " samples)" << ::std::endl;
+        }
+        ::std::cout << "⎩ Average TX execution time: " << (perfdbl / pertxdiv) << " ns" << ::std::endl;
+        // Record results
+        Record record;
+        record.text("library", paths[i]);
+        record.number("reference", i == 0 ? 1 : 0);
+        record.number("threads", nbworkers);
+        record.number("tx_per_worker", nbtxperwrk);
+        record.text("scaling", params.weak_scaling ? "weak" : "strong");
+        record.number("duration_ms", params.duration_ms);
+        record.text("workload", entry.name);
+        for (auto const& [name, value]: options.get_resolved()) {
+            auto key = name;
+            ::std::replace(key.begin(), key.end(), '-', '_');
+            char* end;
+            ::std::strtod(value.c_str(), &end);
+            if (!value.empty() && *end == '\0') { // Numeric, kept as written
+                record.number(key, value);
+            } else {
+                record.text(key, value);
+            }
+        }
+        record.text("access", params.access.name());
+        record.number("arrival_rate", arrival);
+        record.number("warmups", nbwarmups);
+        record.number("repeats", nbrepeats);
+        record.number("max_repeats", maxrepeats);
+        record.number("ci_width", ci_width);
+        record.number("slow_factor", slow_factor);
+        record.number("interleave", params.interleave ? 1 : 0);
+        record.text("pinning", pinning_name(params.pinning));
+        record.number("seed", seed);
+        record.array("times_ns", ::std::get<7>(res));
+        record.array("commits", commits);
+        record.array("worker_finish_ns", ::std::get<9>(res));
+        if (!phases.empty()) {
+            ::std::vector<double> throughputs;
+            ::std::vector<double> readapts;
+            for (auto const& phase: phases) {
+                throughputs.push_back(phase.throughput);
+                readapts.push_back(phase.readapt_ms);
+            }
+            record.array("phase_throughputs", throughputs);
+            record.array("phase_settle_ms", readapts);
+        }
+        record.array("worker_commits", ::std::get<10>(res));
+        for (size_t j = 0; j < EnergyCounters::nbdomains; ++j) {
+            auto key = ::std::string{"energy_"} + EnergyCounters::names[j] + "_j";
+            for (auto& c: key)
+                c = static_cast<char>(::std::tolower(static_cast<unsigned char>(c)));
+            if (::std::isnan(::std::get<11>(res)[j])) {
+                record.missing(key);
+            } else {
+                record.number(key, ::std::get<11>(res)[j]);
+            }
+        }
+        record.number("median_ns", tick_perf);
+        record.number("median_ci_low_ns", spread.low);
+        record.number("median_ci_high_ns", spread.high);
+        record.number("cv", spread.cv);
+        record.number("speedup", speedup);
+        if (i == 0) {
+            record.missing("speedup_ci_low");
+            record.missing("speedup_ci_high");
+        } else {
+            record.number("speedup_ci_low", speedup_ci.first);
+            record.number("speedup_ci_high", speedup_ci.second);
+        }
+        record.number("tx_per_s", pertxdiv * 1000000000. / perfdbl);
+        record.number("avg_tx_ns", perfdbl / pertxdiv);
+        if (bytes_per_tx > 0.) {
+            record.number("bandwidth_mbps", bytes_per_tx * pertxdiv * 1000. / perfdbl);
+        } else {
+            record.missing("bandwidth_mbps");
+        }
+        {
+            struct STM::tm_stats stats;
+            auto available = workload.get_tm().stats(stats);
+            auto stat = [&](char const* key, uint_fast64_t value) {
+                if (available) {
+                    record.number(key, value);
+                } else {
+                    record.missing(key);
+                }
+            };
+            stat("stats_commits", stats.commits);
+            stat("stats_aborts_read", stats.aborts[TM_ABORT_READ]);
+            stat("stats_aborts_lock", stats.aborts[TM_ABORT_LOCK]);
+            stat("stats_aborts_validate", stats.aborts[TM_ABORT_VALIDATE]);
+            stat("stats_aborts_other", stats.aborts[TM_ABORT_OTHER]);
+            stat("stats_extensions", stats.extensions);
+            stat("stats_irrevocable", stats.irrevocable);
+            stat("stats_max_retries", stats.max_retries);
+            stat("stats_stripes", stats.stripes);
+            stat("stats_resizes", stats.resizes);
+            stat("stats_data_bytes", stats.data_bytes);
+            stat("stats_metadata_bytes", stats.metadata_bytes);
+            stat("stats_descriptor_bytes", stats.descriptor_bytes);
+        }
+        if (peak_kib > 0.) {
+            record.number("peak_rss_kib", peak_kib);
+        } else {
+            record.missing("peak_rss_kib");
+        }
+        for (auto const& entry: {::std::make_pair("rw", ::std::get<4>(res)), ::std::make_pair("ro", ::std::get<5>(res))}) {
+            record.number(::std::string{entry.first} + "_attempts", entry.second.attempts);
+            record.number(::std::string{entry.first} + "_aborts", entry.second.aborts);
+            record.number(::std::string{entry.first} + "_wasted_ns", entry.second.wasted);
+        }
+        {
+            char const* keys[PerfCounters::nbevents] = {"cycles", "instructions", "llc_misses", "hitm_loads", "tsx_aborts"};
+            auto const& events = ::std::get<6>(res);
+            for (size_t j = 0; j < PerfCounters::nbevents; ++j) {
+                if (events[j] == PerfCounters::invalid) {
+                    record.missing(keys[j]);
+                } else {
+                    record.number(keys[j], events[j]);
+                }
+            }
+        }
+        for (auto const& [name, values]: series) {
+            auto key = ::std::string{"series_"} + name;
+            for (auto& c: key)
+                c = c == ' ' ? '_' : static_cast<char>(::std::tolower(static_cast<unsigned char>(c)));
+            record.array(key, values);
+        }
+        for (auto const& [name, histogram]: latencies) {
+            auto prefix = ::std::string{"latency_"} + name;
+            record.number(prefix + "_count", histogram.get_count());
+            record.number(prefix + "_total_ns", histogram.get_total());
+            record.number(prefix + "_p50_ns", histogram.percentile(0.5));
+            record.number(prefix + "_p90_ns", histogram.percentile(0.9));
+            record.number(prefix + "_p99_ns", histogram.percentile(0.99));
+            record.number(prefix + "_p999_ns", histogram.percentile(0.999));
+            record.number(prefix + "_max_ns", histogram.get_max());
+        }
+        record.number("sample_ms", params.sample_ms);
+        record.array("samples_tx_per_s", samples);
+        records.push_back(::std::move(record));
+        return true;
+    };
+    if (!params.interleave) { // One library after the other
+        for (auto i = 0; i < nbpaths; ++i) {
+            ::std::cout << "⎧ Evaluating '" << paths[i] << "'" << (maxtick_init == Chrono::invalid_tick ? " (reference)" : "") << "..." << ::std::endl;
+            // Load TM library
+            TransactionalLibrary tl{paths[i]};
+            configure(tl);
+            // Initialize workload (shared memory lifetime bound to workload: created and destroyed at the same time)
+            auto workload = build(tl);
+            if (i == 0)
+                record(*workload);
+            try {
+                // Actual performance measurements and correctness check
+                ::std::vector<double> samples;
+                auto profiler = params.profile.empty() ? nullptr : ::std::make_unique<Profiler>();
+                auto order = params.deterministic.empty() ? nullptr : ::std::make_unique<CommitOrder>(params.deterministic == "concurrent");
+                reset_peak_resident();
+                auto res = measure(*workload, nbworkers, nbwarmups, nbrepeats, maxrepeats, ci_width, seed, duration, maxtick_init, maxtick_perf, maxtick_chck, params.sample_ms * 1000000ul, samples, cpus, profiler.get(), order.get());
+                auto peak_kib = peak_resident_kib();
+                save(*workload);
+                if (profiler)
+                    profile(i, *profiler);
+                if (unlikely(!report(i, *workload, res, samples, peak_kib)))
+                    return 1;
+            } catch (::std::exception const& err) { // Special case: cannot unload library with running threads, so print error and quick-exit
+                ::std::cerr << "⎪ *** EXCEPTION ***" << ::std::endl;
+                ::std::cerr << "⎩ " << err.what() << ::std::endl;
+                ::std::exit(2);
+            }
+        }
+        return 0;
+    }
+    // Every library loaded at once, their measurements taking turns phase after phase (workload lifetimes end before their library's)
+    ::std::vector<::std::unique_ptr<TransactionalLibrary>> libraries;
+    ::std::vector<::std::unique_ptr<Workload>> workloads;
+    for (auto i = 0; i < nbpaths; ++i) {
+        libraries.push_back(::std::make_unique<TransactionalLibrary>(paths[i]));
+        configure(*libraries.back());
+        workloads.push_back(build(*libraries.back()));
+    }
+    record(*workloads.front());
+    Turns turns{static_cast<size_t>(nbpaths)};
+    ::std::vector<Measures> results(nbpaths);
+    ::std::vector<::std::unique_ptr<Profiler>> profilers(nbpaths);
+    if (!params.profile.empty()) {
+        for (auto& profiler: profilers)
+            profiler = ::std::make_unique<Profiler>();
+    }
+    ::std::vector<::std::unique_ptr<CommitOrder>> orders(nbpaths);
+    if (!params.deterministic.empty()) {
+        for (auto& order: orders)
+            order = ::std::make_unique<CommitOrder>(params.deterministic == "concurrent");
+    }
+    ::std::vector<::std::thread> masters;
+    reset_peak_resident();
+    for (auto i = 0; i < nbpaths; ++i) {
+        masters.emplace_back([&](int i) {
+            try { // No timeout, the reference times being unknown; no sampling, the commit counters being shared by every library
+                ::std::vector<double> samples;
+                results[i] = measure(*workloads[i], nbworkers, nbwarmups, nbrepeats, maxrepeats, ci_width, seed, duration, Chrono::invalid_tick, Chrono::invalid_tick, Chrono::invalid_tick, 0, samples, cpus, profilers[i].get(), orders[i].get(), Turn{&turns, static_cast<size_t>(i)});
+            } catch (::std::exception const& err) { // Special case: cannot unload library with running threads, so print error and quick-exit
+                ::std::cerr << "⎪ *** EXCEPTION ***" << ::std::endl;
+                ::std::cerr << "⎩ " << err.what() << ::std::endl;
+                ::std::exit(2);
+            }
+        }, i);
+    }
+    for (auto& master: masters)
+        master.join();
+    auto peak_kib = peak_resident_kib(); // Of every library at once
+    save(*workloads.front());
+    for (auto i = 0; i < nbpaths; ++i) {
+        ::std::cout << "⎧ Evaluating '" << paths[i] << "'" << (i == 0 ? " (reference)" : "") << " (interleaved)..." << ::std::endl;
+        if (profilers[i])
+            profile(i, *profilers[i]);
+        if (unlikely(!report(i, *workloads[i], results[i], {}, peak_kib)))
+            return 1;
+    }
+    return 0;
+}
+
+/** Significance level of the comparisons with a baseline.
+**/
+constexpr static double baseline_alpha = 0.05;
+
+/** Compare the results of this run with the ones of an earlier run, matching the records of the same library, workload, option values, number of workers and arrival rate.
+ * The time per committed transaction of each repetition of both runs goes through a Mann-Whitney U test, which needs no assumption on their distribution.
+ * @param params  Run parameters, naming the baseline
+ * @param records Results of this run
+ * @return Program return code: 3 if a significant regression was found, 0 otherwise (or without baseline)
+**/
+static int against_baseline(Parameters const& params, ::std::vector<Record> const& records) {
+    if (params.baseline.empty())
+        return 0;
+    ::std::ifstream file{params.baseline};
+    if (unlikely(!file))
+        throw ::std::invalid_argument{"unable to open baseline '" + params.baseline + "'"};
+    auto baseline = Record::read_json(file);
+    auto key_of = [](Record const& record) { // Configuration fields, from the library to the arrival rate, as written
+        ::std::string res;
+        for (auto const& key: record.get_keys()) {
+            if (key != "reference")
+                res += key + "=" + *record.find(key) + "|";
+            if (key == "arrival_rate")
+                break;
+        }
+        return res;
+    };
+    auto costs_of = [](Record const& record) { // Time per committed transaction of each repetition (in ns)
+        auto times = record.get_array("times_ns");
+        auto commits = record.get_array("commits");
+        ::std::vector<double> res;
+        for (size_t i = 0; i < times.size() && i < commits.size(); ++i) {
+            if (commits[i] > 0.)
+                res.push_back(times[i] / commits[i]);
+        }
+        return res;
+    };
+    auto regressed = false;
+    ::std::cout << "⎧ Against the baseline '" << params.baseline << "' (median time per TX, Mann-Whitney U test at " << (100. * baseline_alpha) << "%):" << ::std::endl;
+    for (size_t i = 0; i < records.size(); ++i) {
+        auto const& record = records[i];
+        ::std::cout << (i + 1 < records.size() ? "⎪ " : "⎩ ") << record.get_text("workload");
+        if (!params.sweep_option.empty()) {
+            auto key = params.sweep_option;
+            ::std::replace(key.begin(), key.end(), '-', '_');
+            auto json = record.find(key);
+            ::std::cout << ", " << params.sweep_option << " " << (json != nullptr ? *json : "-");
+        }
+        ::std::cout << ", " << record.get_number("threads") << " thread(s)";
+        if (record.get_number("arrival_rate") > 0.)
+            ::std::cout << ", " << record.get_number("arrival_rate") << " TX/s offered";
+        ::std::cout << ", " << record.get_text("library") << ": ";
+        auto key = key_of(record);
+        auto match = ::std::find_if(baseline.begin(), baseline.end(), [&](Record const& other) { return key_of(other) == key; });
+        auto current = costs_of(record);
+        auto before = match != baseline.end() ? costs_of(*match) : ::std::vector<double>{};
+        if (before.empty() || current.empty()) {
+            ::std::cout << "not in the baseline" << ::std::endl;
+            continue;
+        }
+        auto p = mann_whitney(before, current);
+        auto old_median = spread_of(before).median;
+        auto new_median = spread_of(current).median;
+        auto change = 100. * (new_median - old_median) / old_median;
+        ::std::cout << old_median << " -> " << new_median << " ns (" << (change > 0. ? "+" : "") << change << "%), p " << p;
+        if (p < baseline_alpha) {
+            ::std::cout << (new_median > old_median ? ": REGRESSION" : ": improvement");
+            regressed |= new_median > old_median;
+        }
+        ::std::cout << ::std::endl;
+    }
+    return regressed ? 3 : 0;
+}
+
 /** Program entry point.
  * @param argc Arguments count
  * @param argv Arguments values
@@ -248,94 +1373,133 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
 int main(int argc, char** argv) {
     try {
         // Parse command line option(s)
-        if (argc < 3) {
-            ::std::cout << "Usage: " << (argc > 0 ? argv[0] : "grading") << " <seed> <reference library path> <tested library path>..." << ::std::endl;
+        Parameters params;
+        auto argi = 1;
+        while (argi + 1 < argc && ::std::strncmp(argv[argi], "--", 2) == 0) {
+            if (::std::strcmp(argv[argi], "--config") == 0) {
+                load_parameters(params, argv[argi + 1]);
+            } else if (!set_parameter(params, argv[argi] + 2, argv[argi + 1])) {
+                argi = argc; // Unknown option, print usage
+                break;
+            }
+            argi += 2;
+        }
+        if (argc - argi < 2) {
+            ::std::cout << "Usage: " << (argc > 0 ? argv[0] : "grading") << " [<option> <value>]... <seed> <reference library path> <tested library path>..." << ::std::endl;
+            ::std::cout << "Options (later ones override earlier ones):" << ::std::endl;
+            ::std::cout << "  --config <path>              Read options from a file, one '<name> = <value>' per line (name without '--')" << ::std::endl;
+            ::std::cout << "  --threads <count>,...        Numbers of worker threads to sweep (default: hardware concurrency)" << ::std::endl;
+            ::std::cout << "  --tx-per-worker <count>      Transactions per worker (default: 200000 in total)" << ::std::endl;
+            ::std::cout << "  --scaling <strong|weak>      Whether the default transactions per worker shrink as threads increase, or stay at the ones of the fewest threads (default: strong)" << ::std::endl;
+            ::std::cout << "  --duration-ms <duration>     Run each repetition for this long instead, and compare the committed TX per second (default: 0, fixed transaction counts)" << ::std::endl;
+            ::std::cout << "  --workload <name>            Workload to run (default: " << workload_registry().front().name << "):" << ::std::endl;
+            for (auto const& entry: workload_registry())
+                ::std::cout << "                                 " << entry.name << ": " << entry.description << ::std::endl;
+            ::std::cout << "  --workload-option <name>=<value>  Set an option of the workload (later ones override earlier ones)" << ::std::endl;
+            ::std::cout << "  --sweep <name>=<value>,...   Sweep a workload option over these values (default: none)" << ::std::endl;
+            ::std::cout << "  --accounts <count>           Bank option: initial number of accounts and accounts per segment (default: 32 per worker)" << ::std::endl;
+            ::std::cout << "  --expected-accounts <count>  Bank option: expected total number of accounts (default: 256 per worker)" << ::std::endl;
+            ::std::cout << "  --init-balance <amount>      Bank option: initial account balance (default: 100)" << ::std::endl;
+            ::std::cout << "  --prob-long <probability>    Bank option: probability of a long, read-only transaction (default: 0.5)" << ::std::endl;
+            ::std::cout << "  --prob-alloc <probability>   Bank option: probability of an allocation transaction otherwise (default: 0.01)" << ::std::endl;
+            ::std::cout << "  --arrival-rate <TX/s>,...    Open loop at these aggregate Poisson arrival rates, to sweep (default: closed loop)" << ::std::endl;
+            ::std::cout << "  --access <pattern>           Keys of the transactions: uniform, zipf:<theta> or hotspot:<fraction>:<probability> (default: uniform)" << ::std::endl;
+            ::std::cout << "  --warmups <count>            Discarded repetitions before the measured ones (default: 1)" << ::std::endl;
+            ::std::cout << "  --repeats <count>            Number of measured repetitions, the median is kept (default: 7)" << ::std::endl;
+            ::std::cout << "  --ci-width <ratio>           Repeat until the 95% confidence interval of the median is within this ratio of it, e.g. 0.02 (default: 0, never)" << ::std::endl;
+            ::std::cout << "  --max-repeats <count>        Maximum number of measured repetitions with --ci-width (default: 50)" << ::std::endl;
+            ::std::cout << "  --slow-factor <factor>       Timeout, as a factor of the reference times (default: 8)" << ::std::endl;
+            ::std::cout << "  --pin <policy>               Pin the workers: none, compact (socket by socket), scatter (alternate sockets), cores (physical cores first) (default: none)" << ::std::endl;
+            ::std::cout << "  --sample-ms <period>         Print the throughput over each period of the measurements (default: 0, none)" << ::std::endl;
+            ::std::cout << "  --interleave <0|1>           Alternate the repetitions of the libraries, the speedup coming from paired repetitions (default: 0)" << ::std::endl;
+            ::std::cout << "  --deterministic <mode>       Run the transactions in rounds ending in an order fixed by the seed and the worker IDs, reproducible runs: off, serial (one at a time), or concurrent (executing at once, for libraries that never block in a transaction) (default: off)" << ::std::endl;
+            ::std::cout << "  --format <format>            Results as text, json or csv; the last two on the standard output, the text on the standard error (default: text)" << ::std::endl;
+            ::std::cout << "  --record <path>              Record the transactions of the first evaluation of the reference into a trace file, for the replay workload (default: none)" << ::std::endl;
+            ::std::cout << "  --profile <path>             Sample the call stacks of the workers during the measured repetitions, appended to a file as folded stacks for flame graphs (default: none)" << ::std::endl;
+            ::std::cout << "  --baseline <path>            Compare the time per TX with the results of an earlier '--format json' run, exiting with 3 on a significant regression (default: none)" << ::std::endl;
+            ::std::cout << "Region knobs, passed to the libraries exporting 'tm_create_ex' (default: as 'tm_create'):" << ::std::endl;
+            ::std::cout << "  --tm-engine <name>           Engine of the regions" << ::std::endl;
+            ::std::cout << "  --tm-stripes <count>         Stripes of the lock table, which then keeps that size" << ::std::endl;
+            ::std::cout << "  --tm-hugepages <backing>     Backing of the large segments: none, thp, 2M or 1G" << ::std::endl;
+            ::std::cout << "  --tm-numa <0|1>              Placement of the memory on the NUMA nodes" << ::std::endl;
+            ::std::cout << "  --tm-versions <count>        Values kept per stripe by multiversioning engines" << ::std::endl;
+            ::std::cout << "  --tm-reclaimer <0|1>         Service thread of the regions" << ::std::endl;
             return 1;
         }
-        // Get/set/compute run parameters
-        auto const nbworkers = []() {
+        auto const seed = static_cast<Seed>(::std::stoul(argv[argi]));
+        auto const paths = argv + argi + 1;
+        auto const nbpaths = argc - argi - 1;
+        // Machine-readable results on the standard output, the text moves to the standard error
+        ::std::ostream results{::std::cout.rdbuf()};
+        ::std::vector<Record> records;
+        if (params.format != Format::text)
+            ::std::cout.rdbuf(::std::cerr.rdbuf());
+        auto write = [&](int code) {
+            if (params.format == Format::json)
+                Record::write_json(results, records);
+            else if (params.format == Format::csv)
+                Record::write_csv(results, records);
+            return code;
+        };
+        FastChrono::calibrate(); // Per-transaction latencies read the timestamp counter if invariant
+        if (!params.profile.empty()) { // Every evaluation appends its stacks
+            ::std::ofstream truncate{params.profile, ::std::ios::trunc};
+            if (unlikely(!truncate))
+                throw ::std::invalid_argument{"unable to open profile file '" + params.profile + "'"};
+        }
+        auto sweep = params.threads;
+        if (sweep.empty()) {
             auto res = ::std::thread::hardware_concurrency();
             if (unlikely(res == 0))
                 res = 16;
-            return static_cast<size_t>(res);
-        }();
-        auto const nbtxperwrk    = 200000ul / nbworkers;
-        auto const nbaccounts    = 32 * nbworkers;
-        auto const expnbaccounts = 256 * nbworkers;
-        auto const init_balance  = 100ul;
-        auto const prob_long     = 0.5f;
-        auto const prob_alloc    = 0.01f;
-        auto const nbrepeats     = 7;
-        auto const seed          = static_cast<Seed>(::std::stoul(argv[1]));
-        auto const clk_res       = Chrono::get_resolution();
-        auto const slow_factor   = 8ul;
-        // Print run parameters
-        ::std::cout << "⎧ #worker threads:     " << nbworkers << ::std::endl;
-        ::std::cout << "⎪ #TX per worker:      " << nbtxperwrk << ::std::endl;
-        ::std::cout << "⎪ #repetitions:        " << nbrepeats << ::std::endl;
-        ::std::cout << "⎪ Initial #accounts:   " << nbaccounts << ::std::endl;
-        ::std::cout << "⎪ Expected #accounts:  " << expnbaccounts << ::std::endl;
-        ::std::cout << "⎪ Initial balance:     " << init_balance << ::std::endl;
-        ::std::cout << "⎪ Long TX probability: " << prob_long << ::std::endl;
-        ::std::cout << "⎪ Allocation TX prob.: " << prob_alloc << ::std::endl;
-        ::std::cout << "⎪ Slow trigger factor: " << slow_factor << ::std::endl;
-        ::std::cout << "⎪ Clock resolution:    ";
-        if (unlikely(clk_res == Chrono::invalid_tick)) {
-            ::std::cout << "<unknown>" << ::std::endl;
-        } else {
-            ::std::cout << clk_res << " ns" << ::std::endl;
-        }
-        ::std::cout << "⎩ Seed value:          " << seed << ::std::endl;
-        // Library evaluations
-        double reference = 0.; // Set to avoid irrelevant '-Wmaybe-uninitialized'
-        auto const pertxdiv = static_cast<double>(nbworkers) * static_cast<double>(nbtxperwrk);
-        auto maxtick_init = Chrono::invalid_tick;
-        auto maxtick_perf = Chrono::invalid_tick;
-        auto maxtick_chck = Chrono::invalid_tick;
-        for (auto i = 2; i < argc; ++i) {
-            ::std::cout << "⎧ Evaluating '" << argv[i] << "'" << (maxtick_init == Chrono::invalid_tick ? " (reference)" : "") << "..." << ::std::endl;
-            // Load TM library
-            TransactionalLibrary tl{argv[i]};
-            // Initialize workload (shared memory lifetime bound to workload: created and destroyed at the same time)
-            WorkloadBank bank{tl, nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc};
-            try {
-                // Actual performance measurements and correctness check
-                auto res = measure(bank, nbworkers, nbrepeats, seed, maxtick_init, maxtick_perf, maxtick_chck);
-                // Check false negative-free correctness
-                auto error = ::std::get<0>(res);
-                if (unlikely(error)) {
-                    ::std::cout << "⎩ " << error << ::std::endl;
-                    return 1;
-                }
-                // Print results
-                auto tick_init = ::std::get<1>(res);
-                auto tick_perf = ::std::get<2>(res);
-                auto tick_chck = ::std::get<3>(res);
-                auto perfdbl = static_cast<double>(tick_perf);
-                ::std::cout << "⎪ Total user execution time: " << (perfdbl / 1000000.) << " ms";
-                if (maxtick_init == Chrono::invalid_tick) { // Set reference performance
-                    maxtick_init = slow_factor * tick_init;
-                    if (unlikely(maxtick_init == Chrono::invalid_tick)) // Bad luck...
-                        ++maxtick_init;
-                    maxtick_perf = slow_factor * tick_perf;
-                    if (unlikely(maxtick_perf == Chrono::invalid_tick)) // Bad luck...
-                        ++maxtick_perf;
-                    maxtick_chck = slow_factor * tick_chck;
-                    if (unlikely(maxtick_chck == Chrono::invalid_tick)) // Bad luck...
-                        ++maxtick_chck;
-                    reference = perfdbl;
-                } else { // Compare with reference performance
-                    ::std::cout << " -> " << (reference / perfdbl) << " speedup";
+            sweep.push_back(static_cast<size_t>(res));
+        }
+        auto arrivals = params.arrival_rates;
+        if (arrivals.empty())
+            arrivals.push_back(0.);
+        auto values = params.sweep_values;
+        if (values.empty())
+            values.emplace_back();
+        // One evaluation per swept option value, number of worker threads and arrival rate, then the curve of every library if more than one
+        ::std::vector<::std::tuple<size_t, double, ::std::vector<double>, ::std::vector<Chrono::Tick>, ::std::string>> curves;
+        for (auto const& value: values) {
+            auto point = params;
+            if (!params.sweep_option.empty())
+                point.options.set(params.sweep_option, value);
+            for (auto nbworkers: sweep) {
+                for (auto arrival: arrivals) {
+                    curves.emplace_back(nbworkers, arrival, ::std::vector<double>{}, ::std::vector<Chrono::Tick>{}, value);
+                    auto res = evaluate(nbworkers, arrival, point, seed, paths, nbpaths, ::std::get<2>(curves.back()), ::std::get<3>(curves.back()), records);
+                    point.record.clear(); // Only the first evaluation recorded
+                    params.record.clear();
+                    if (unlikely(res != 0))
+                        return write(res);
                 }
-                ::std::cout << ::std::endl;
-                ::std::cout << "⎩ Average TX execution time: " << (perfdbl / pertxdiv) << " ns" << ::std::endl;
-            } catch (::std::exception const& err) { // Special case: cannot unload library with running threads, so print error and quick-exit
-                ::std::cerr << "⎪ *** EXCEPTION ***" << ::std::endl;
-                ::std::cerr << "⎩ " << err.what() << ::std::endl;
-                ::std::exit(2);
             }
         }
-        return 0;
+        if (curves.size() < 2)
+            return write(against_baseline(params, records));
+        auto const open = !params.arrival_rates.empty();
+        ::std::cout << "⎧ " << (open ? "Latency vs throughput (TX/s, speedup over the reference, short TX p99 latency)" : "Scaling (TX/s, speedup over the reference)") << ":" << ::std::endl;
+        for (size_t i = 0; i < curves.size(); ++i) {
+            auto const& [nbworkers, arrival, rates, tails, value] = curves[i];
+            ::std::cout << (i + 1 < curves.size() ? "⎪ " : "⎩ ");
+            if (!params.sweep_option.empty())
+                ::std::cout << params.sweep_option << " " << value << ", ";
+            ::std::cout << nbworkers << " thread(s)";
+            if (open)
+                ::std::cout << ", " << arrival << " TX/s offered";
+            ::std::cout << ":";
+            for (auto j = 0; j < nbpaths; ++j) {
+                ::std::cout << (j == 0 ? " " : " | ") << rates[j];
+                if (j > 0)
+                    ::std::cout << " (" << (rates[j] / rates[0]) << "x)";
+                if (open)
+                    ::std::cout << " p99 " << tails[j] << " ns";
+            }
+            ::std::cout << ::std::endl;
+        }
+        return write(against_baseline(params, records));
     } catch (::std::exception const& err) {
         ::std::cerr << "⎧ *** EXCEPTION ***" << ::std::endl;
         ::std::cerr << "⎩ " << err.what() << ::std::endl;
@@ -0,0 +1,347 @@
+/**
+ * @file   graph.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Graph-analytics workload, in the spirit of the STAMP ssca2 kernel: a large
+ * random undirected graph, each vertex with an adjacency segment of its own,
+ * updated by transactions adding and removing edges while read-only
+ * transactions run breadth-first searches from random roots. The searches
+ * read thousands of small ranges scattered over the segments in an order
+ * only known as they go, which stresses read-set compaction, prefetching and
+ * snapshot scans in a way the bank's linear segment chain cannot.
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Graph-analytics workload class.
+ * The first segment holds the address of the adjacency segment of each vertex; an adjacency segment holds the degree of its vertex then
+ * its neighbors, up to a fixed maximum degree. Each edge is in the lists of both its ends, which the searches check among the vertices
+ * they reached.
+**/
+class WorkloadGraph final: public Workload {
+public:
+    /** Word class alias, for degrees and vertex numbers.
+    **/
+    using Word = uint64_t;
+private:
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram search_tx; // Breadth-first search transactions
+        Histogram update_tx; // Edge addition and removal transactions
+        ptrdiff_t delta = 0; // Edges added minus edges removed by the worker
+    };
+    /** Adjacency list of a vertex, as read by a transaction.
+    **/
+    struct Adjacency {
+        Word degree;                // Number of neighbors
+        ::std::vector<Word> others; // Neighbors
+    };
+private:
+    size_t nbworkers;     // Number of concurrent workers
+    size_t nbtxperwrk;    // Number of transactions per worker, 0 for as many as possible until asked to stop
+    size_t nbvertices;    // Number of vertices
+    size_t max_degree;    // Maximum degree of a vertex
+    size_t init_degree;   // Average degree of the initial graph
+    size_t search_limit;  // Maximum number of vertices a search reaches
+    float  prob_update;   // Probability of an update instead of a search
+    AccessPattern access; // Access pattern over the vertices (roots and ends of the edges)
+    double arrival_rate;  // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;      // Barrier for thread synchronization during 'check'
+    mutable ::std::atomic<bool> built; // Whether a worker already (re)built the graph
+    mutable size_t nbinitial;          // Number of edges of the initial graph, once built
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Graph workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param nbvertices   Number of vertices
+     * @param max_degree   Maximum degree of a vertex
+     * @param init_degree  Average degree of the initial graph
+     * @param search_limit Maximum number of vertices a search reaches
+     * @param prob_update  Probability of an edge addition or removal, each equally likely, instead of a search
+     * @param access       Access pattern over the vertices
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadGraph(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbvertices, size_t max_degree, size_t init_degree, size_t search_limit, float prob_update, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): Workload{library, alignof(Word), (2 + nbvertices) * sizeof(Word)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbvertices{nbvertices}, max_degree{max_degree}, init_degree{::std::min(init_degree, max_degree)}, search_limit{search_limit}, prob_update{prob_update}, access{access}, arrival_rate{arrival_rate}, barrier(nbworkers), built{false}, nbinitial{0}, states(nbworkers) {}
+private:
+    /** Get the directory of the adjacency segments.
+     * @param tx Associated pending transaction
+     * @return Adjacency segment of each vertex
+    **/
+    Shared<Word*[]> directory(Transaction& tx) const {
+        return Shared<Word*[]>{tx, reinterpret_cast<Word*>(tm.get_start()) + 2};
+    }
+    /** Read the adjacency list of a vertex.
+     * @param tx      Associated pending transaction
+     * @param segment Adjacency segment of the vertex
+     * @param res     Set to the adjacency list
+     * @return Whether the list is well-formed
+    **/
+    bool adjacency(Transaction& tx, Word* segment, Adjacency& res) const {
+        Shared<Word[]> words{tx, segment};
+        res.degree = words.read(0);
+        if (unlikely(res.degree > max_degree))
+            return false;
+        res.others.resize(res.degree);
+        if (res.degree > 0)
+            words.read_range(1, res.degree, res.others.data());
+        for (auto other: res.others) {
+            if (unlikely(other >= nbvertices))
+                return false;
+        }
+        return true;
+    }
+    /** Edge addition transaction.
+     * @param first  One end of the edge
+     * @param second Other end of the edge
+     * @return Whether the edge was added (and not already there nor an end full), or 'nullopt' if a list was malformed
+    **/
+    ::std::optional<bool> add_tx(Word first, Word second) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) -> ::std::optional<bool> {
+            if (first == second)
+                return false;
+            auto dir = directory(tx);
+            Word* segments[2] = {dir.read(first), dir.read(second)};
+            thread_local Adjacency lists[2];
+            for (size_t i = 0; i < 2; ++i) {
+                if (unlikely(!adjacency(tx, segments[i], lists[i])))
+                    return ::std::nullopt;
+            }
+            if (lists[0].degree >= max_degree || lists[1].degree >= max_degree || ::std::find(lists[0].others.begin(), lists[0].others.end(), second) != lists[0].others.end())
+                return false;
+            Word const ends[2] = {second, first};
+            for (size_t i = 0; i < 2; ++i) {
+                Shared<Word[]> words{tx, segments[i]};
+                words[1 + lists[i].degree] = ends[i];
+                words[0] = lists[i].degree + 1;
+            }
+            return true;
+        });
+    }
+    /** Edge removal transaction, of a random edge of a vertex.
+     * @param vertex Vertex to remove an edge of
+     * @param pick   Random number choosing the edge
+     * @return Whether an edge was removed (the vertex had any), or 'nullopt' if a list was malformed or the edge was not in both lists
+    **/
+    ::std::optional<bool> remove_tx(Word vertex, size_t pick) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) -> ::std::optional<bool> {
+            auto dir = directory(tx);
+            thread_local Adjacency lists[2];
+            Word* segments[2] = {dir.read(vertex), nullptr};
+            if (unlikely(!adjacency(tx, segments[0], lists[0])))
+                return ::std::nullopt;
+            if (lists[0].degree == 0)
+                return false;
+            auto other = lists[0].others[pick % lists[0].degree];
+            segments[1] = dir.read(other);
+            if (unlikely(!adjacency(tx, segments[1], lists[1])))
+                return ::std::nullopt;
+            Word const ends[2] = {other, vertex};
+            for (size_t i = 0; i < 2; ++i) { // Move the last neighbor in place of the removed one
+                auto& list = lists[i];
+                auto pos = ::std::find(list.others.begin(), list.others.end(), ends[i]);
+                if (unlikely(pos == list.others.end()))
+                    return ::std::nullopt;
+                Shared<Word[]> words{tx, segments[i]};
+                words[1 + static_cast<size_t>(pos - list.others.begin())] = list.others.back();
+                words[0] = list.degree - 1;
+            }
+            return true;
+        });
+    }
+    /** Breadth-first search transaction, checking that each edge between the vertices reached is in the lists of both its ends.
+     * @param root Vertex to start from
+     * @return Number of vertices reached, 0 if an inconsistency was found
+    **/
+    size_t search_tx(Word root) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) -> size_t {
+            thread_local ::std::vector<uint32_t> order;  // Rank of each vertex in the search plus 1, 0 if not reached
+            thread_local ::std::vector<Word> reached;    // Vertices reached, in search order
+            thread_local ::std::vector<Adjacency> lists; // Adjacency list of each vertex reached, in search order
+            order.assign(nbvertices, 0);
+            reached.assign(1, root);
+            order[root] = 1;
+            auto dir = directory(tx);
+            for (size_t next = 0; next < reached.size(); ++next) { // Each reached vertex once, the next ones only known from the lists read
+                if (lists.size() <= next)
+                    lists.resize(next + 1);
+                if (unlikely(!adjacency(tx, dir.read(reached[next]), lists[next])))
+                    return 0;
+                for (auto other: lists[next].others) {
+                    if (order[other] == 0 && (search_limit == 0 || reached.size() < search_limit)) {
+                        reached.push_back(other);
+                        order[other] = static_cast<uint32_t>(reached.size());
+                    }
+                }
+            }
+            for (size_t i = 0; i < reached.size(); ++i) {
+                for (auto other: lists[i].others) {
+                    auto rank = order[other];
+                    if (rank == 0) // List not read
+                        continue;
+                    auto const& back = lists[rank - 1].others;
+                    if (unlikely(::std::find(back.begin(), back.end(), reached[i]) == back.end()))
+                        return 0;
+                }
+            }
+            return reached.size();
+        });
+    }
+    /** Count the edges of the whole graph, checking each is in the lists of both its ends and none is there twice.
+     * @param count Set to the number of edges, if consistent
+     * @return Whether no inconsistency has been found
+    **/
+    bool count_tx(size_t& count) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            ::std::vector<Adjacency> lists(nbvertices);
+            auto dir = directory(tx);
+            size_t total = 0;
+            for (Word vertex = 0; vertex < nbvertices; ++vertex) {
+                if (unlikely(!adjacency(tx, dir.read(vertex), lists[vertex])))
+                    return false;
+                total += lists[vertex].degree;
+            }
+            for (Word vertex = 0; vertex < nbvertices; ++vertex) {
+                auto const& others = lists[vertex].others;
+                for (auto other: others) {
+                    auto const& back = lists[other].others;
+                    if (unlikely(other == vertex || ::std::count(others.begin(), others.end(), other) != 1 || ::std::find(back.begin(), back.end(), vertex) == back.end()))
+                        return false;
+                }
+            }
+            count = total / 2;
+            return true;
+        });
+    }
+public:
+    virtual char const* init() const {
+        if (built.exchange(true)) // Another worker (re)builds the graph, and the workers wait for each other before running
+            return nullptr;
+        // Random graph built privately, from a fixed seed so that every library gets the same one
+        ::std::vector<::std::vector<Word>> graph(nbvertices);
+        ::std::minstd_rand engine{static_cast<::std::minstd_rand::result_type>(nbvertices)};
+        ::std::uniform_int_distribution<Word> uniform{0, nbvertices - 1};
+        nbinitial = 0;
+        for (size_t i = 0; i < nbvertices * init_degree / 2; ++i) {
+            auto first = uniform(engine);
+            auto second = uniform(engine);
+            auto& list = graph[first];
+            if (first == second || list.size() >= max_degree || graph[second].size() >= max_degree || ::std::find(list.begin(), list.end(), second) != list.end())
+                continue;
+            list.push_back(second);
+            graph[second].push_back(first);
+            ++nbinitial;
+        }
+        // Written in batches of vertices, so that large graphs do not need a huge transaction
+        constexpr size_t init_batch = 1024;
+        for (size_t first = 0; first < nbvertices; first += init_batch) {
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                auto dir = directory(tx);
+                for (auto vertex = first; vertex < first + init_batch && vertex < nbvertices; ++vertex) {
+                    auto cell = dir[vertex];
+                    auto segment = cell.read();
+                    if (!segment) { // Else the segment of a previous initialization
+                        segment = reinterpret_cast<Word*>(tx.alloc((1 + max_degree) * sizeof(Word)));
+                        cell = segment;
+                    }
+                    auto const& list = graph[vertex];
+                    Shared<Word[]> words{tx, segment};
+                    words[0] = list.size();
+                    if (!list.empty())
+                        tx.write(list.data(), list.size() * sizeof(Word), segment + 1);
+                }
+            });
+        }
+        size_t count;
+        if (unlikely(!count_tx(count) || count != nbinitial))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::uniform_int_distribution<Word> uniform{0, nbvertices - 1};
+        ::std::uniform_real_distribution<float> kind{0.f, 1.f};
+        auto table = access.kind == AccessPattern::Kind::uniform ? ::std::optional<AliasTable>{} : ::std::optional<AliasTable>{::std::in_place, access, nbvertices};
+        auto vertex = [&]() -> Word { return table ? (*table)(engine) : uniform(engine); };
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            auto draw = kind(engine);
+            if (draw >= prob_update) { // Do a search
+                auto root = vertex();
+                pacer.start();
+                auto reached = search_tx(root);
+                local.search_tx.record(pacer.latency());
+                if (unlikely(reached == 0))
+                    return "Violated isolation or atomicity";
+            } else if (draw < prob_update / 2) { // Do an edge addition
+                auto first = vertex();
+                auto second = vertex();
+                pacer.start();
+                auto added = add_tx(first, second);
+                local.update_tx.record(pacer.latency());
+                if (unlikely(!added))
+                    return "Violated isolation or atomicity";
+                local.delta += *added;
+            } else { // Do an edge removal
+                auto first = vertex();
+                auto pick = static_cast<size_t>(engine());
+                pacer.start();
+                auto removed = remove_tx(first, pick);
+                local.update_tx.record(pacer.latency());
+                if (unlikely(!removed))
+                    return "Violated isolation or atomicity";
+                local.delta -= *removed;
+            }
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.search_tx.merge(local.search_tx);
+            res.update_tx.merge(local.update_tx);
+        }
+        return {{"search", res.search_tx}, {"update", res.update_tx}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every addition and removal counted exactly once, before the counters overwrite the first words
+            auto expected = static_cast<ptrdiff_t>(nbinitial);
+            for (auto const& local: states)
+                expected += local.delta;
+            size_t count;
+            if (unlikely(!count_tx(count) || static_cast<ptrdiff_t>(count) != expected))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
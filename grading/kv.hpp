@@ -0,0 +1,423 @@
+/**
+ * @file   kv.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Key-value store workload following the YCSB core workloads A to F: fixed
+ * size records, each a key and several fields, in segments allocated by
+ * transactions and found through a directory in the first segment. Inserted
+ * keys are sequential; the directory keeps the latest keys and an insertion
+ * evicts (frees) the oldest record, as a cache would. Reads, updates and
+ * read-modify-writes pick their key among the latest records, uniformly,
+ * following a scrambled Zipfian distribution or favoring the latest keys.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** YCSB-style key-value store workload class.
+**/
+class WorkloadKV final: public Workload {
+public:
+    /** Word class alias.
+    **/
+    using Word = uint64_t;
+    /** Operation mix, as the YCSB core workloads.
+    **/
+    enum class Mix {
+        a, // 50% reads, 50% updates
+        b, // 95% reads, 5% updates
+        c, // Only reads
+        d, // 95% reads, 5% insertions
+        e, // 95% scans, 5% insertions
+        f  // 50% reads, 50% read-modify-writes
+    };
+    /** Request distribution over the latest records.
+    **/
+    enum class Request {
+        uniform, // Every record equally likely
+        zipfian, // Zipfian (theta 0.99), the popular records spread over the keys
+        latest   // Zipfian (theta 0.99), the most recent records the most popular
+    };
+    /** Skew of the Zipfian distributions, as in YCSB.
+    **/
+    constexpr static double zipf_theta = 0.99;
+private:
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram insert_tx; // Insertion transactions
+        Histogram rmw_tx;    // Read-modify-write transactions
+        Histogram update_tx; // Update transactions
+        Histogram scan_tx;   // Scan transactions
+        Histogram read_tx;   // Read transactions
+        size_t inserted = 0; // Number of committed insertions
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    Mix mix;             // Operation mix
+    Request request;     // Request distribution
+    size_t nbrecords;    // Number of records loaded, and of latest records requests pick from
+    size_t capacity;     // Number of records kept before the oldest is evicted
+    size_t nbfields;     // Number of fields per record
+    size_t fieldwords;   // Number of words per field
+    size_t scan_length;  // Maximum number of records per scan
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::atomic<bool> built; // Whether a worker already (re)loaded the records
+    mutable ::std::atomic<Word> acknowledged; // Number of insertions committed, every key below 'nbrecords' plus this number exists
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Key-value store workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param mix          Operation mix
+     * @param request      Request distribution
+     * @param nbrecords    Number of records loaded, and of latest records requests pick from
+     * @param capacity     Number of records kept before the oldest is evicted, at least the number of records loaded
+     * @param nbfields     Number of fields per record
+     * @param field_length Length of a field (in bytes, rounded up to whole words)
+     * @param scan_length  Maximum number of records per scan
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadKV(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, Mix mix, Request request, size_t nbrecords, size_t capacity, size_t nbfields, size_t field_length, size_t scan_length, double arrival_rate = 0.): Workload{library, alignof(Word), (3 + ::std::max(capacity, nbrecords)) * sizeof(Word)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, mix{mix}, request{request}, nbrecords{nbrecords}, capacity{::std::max(capacity, nbrecords)}, nbfields{nbfields}, fieldwords{(field_length + sizeof(Word) - 1) / sizeof(Word)}, scan_length{scan_length}, arrival_rate{arrival_rate}, barrier(nbworkers), built{false}, acknowledged{0}, states(nbworkers) {}
+private:
+    /** Get the number of keys inserted so far, loaded records included; the next key to insert.
+     * @param tx Associated pending transaction
+     * @return Number of keys inserted
+    **/
+    Shared<Word> next_key(Transaction& tx) const {
+        return Shared<Word>{tx, reinterpret_cast<Word*>(tm.get_start()) + 2};
+    }
+    /** Get the directory, the record of each key at the slot of the key modulo the capacity.
+     * @param tx Associated pending transaction
+     * @return Record of each slot, 'nullptr' for none
+    **/
+    Shared<Word*[]> directory(Transaction& tx) const {
+        return Shared<Word*[]>{tx, next_key(tx).after()};
+    }
+    /** Get the size of a record.
+     * @return Number of words of a record, its key included
+    **/
+    size_t record_words() const noexcept {
+        return 1 + nbfields * fieldwords;
+    }
+    /** Fill a private record, every word of a field holding the same stamp.
+     * @param record Private record to fill
+     * @param key    Key of the record
+     * @param stamp  Stamp of every field
+    **/
+    void fill(Word* record, Word key, Word stamp) const noexcept {
+        record[0] = key;
+        for (size_t i = 1; i < record_words(); ++i)
+            record[i] = stamp;
+    }
+    /** Check that each field of a private record was written as a whole.
+     * @param record Private record to check
+     * @return Whether every word of each field holds the same stamp
+    **/
+    bool intact(Word const* record) const noexcept {
+        for (size_t field = 0; field < nbfields; ++field) {
+            auto words = record + 1 + field * fieldwords;
+            for (size_t i = 1; i < fieldwords; ++i) {
+                if (unlikely(words[i] != words[0]))
+                    return false;
+            }
+        }
+        return true;
+    }
+    /** Read the record of a key, if still present.
+     * @param tx     Associated pending transaction
+     * @param key    Key to look up
+     * @param record Private record receiving the record
+     * @return Whether the key was found
+    **/
+    bool fetch(Transaction& tx, Word key, Word* record) const {
+        auto address = directory(tx).read(key % capacity);
+        if (!address)
+            return false;
+        tx.read(address, record_words() * sizeof(Word), record);
+        return record[0] == key;
+    }
+    /** Overwrite one field of a record.
+     * @param tx      Associated pending transaction
+     * @param address Record in shared memory
+     * @param field   Field to overwrite
+     * @param stamp   Stamp to write in every word of the field
+    **/
+    void write_field(Transaction& tx, Word* address, size_t field, Word stamp) const {
+        thread_local ::std::vector<Word> words;
+        words.assign(fieldwords, stamp);
+        tx.write(words.data(), fieldwords * sizeof(Word), address + 1 + field * fieldwords);
+    }
+    /** Read transaction.
+     * @param key Key to read
+     * @return Whether the record read, if any, was consistent
+    **/
+    bool read_tx(Word key) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            thread_local ::std::vector<Word> record;
+            record.resize(record_words());
+            return !fetch(tx, key, record.data()) || intact(record.data());
+        });
+    }
+    /** Update transaction, overwriting one field.
+     * @param key   Key to update
+     * @param field Field to overwrite
+     * @param stamp Stamp to write in every word of the field
+     * @return Whether the key was found
+    **/
+    bool update_tx(Word key, size_t field, Word stamp) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto address = directory(tx).read(key % capacity);
+            if (!address || Shared<Word>{tx, address}.read() != key)
+                return false;
+            write_field(tx, address, field, stamp);
+            return true;
+        });
+    }
+    /** Read-modify-write transaction, reading the whole record then incrementing the stamp of one field.
+     * @param key   Key to update
+     * @param field Field to overwrite
+     * @return Whether the record read, if any, was consistent
+    **/
+    bool rmw_tx(Word key, size_t field) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            thread_local ::std::vector<Word> record;
+            record.resize(record_words());
+            if (!fetch(tx, key, record.data()))
+                return true;
+            if (unlikely(!intact(record.data())))
+                return false;
+            write_field(tx, directory(tx).read(key % capacity), field, record[1 + field * fieldwords] + 1);
+            return true;
+        });
+    }
+    /** Scan transaction, reading the records of consecutive keys.
+     * @param key    First key to read
+     * @param length Number of keys to read
+     * @return Whether every record read was consistent
+    **/
+    bool scan_tx(Word key, size_t length) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            thread_local ::std::vector<Word> record;
+            record.resize(record_words());
+            for (size_t i = 0; i < length; ++i) {
+                if (fetch(tx, key + i, record.data()) && unlikely(!intact(record.data())))
+                    return false;
+            }
+            return true;
+        });
+    }
+    /** Insertion transaction, of the next key, evicting the oldest record if full.
+    **/
+    void insert_tx() const {
+        thread_local ::std::vector<Word> record;
+        record.resize(record_words());
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto next = next_key(tx);
+            auto key = next.read();
+            auto slot = directory(tx)[key % capacity];
+            if (auto evicted = slot.read(); evicted)
+                tx.free(evicted);
+            auto fresh = reinterpret_cast<Word*>(tx.alloc(record_words() * sizeof(Word)));
+            fill(record.data(), key, key);
+            tx.write(record.data(), record_words() * sizeof(Word), fresh);
+            slot = fresh;
+            next = key + 1;
+        });
+    }
+    /** Draw the next operation of the mix.
+     * @param engine Random engine to use
+     * @return 0 for a read, 1 for an update, 2 for a read-modify-write, 3 for a scan, 4 for an insertion
+    **/
+    template<class Engine> int draw_operation(Engine& engine) const {
+        ::std::uniform_int_distribution<int> percent{0, 99};
+        auto roll = percent(engine);
+        switch (mix) {
+        case Mix::a:
+            return roll < 50 ? 0 : 1;
+        case Mix::b:
+            return roll < 95 ? 0 : 1;
+        case Mix::d:
+            return roll < 95 ? 0 : 4;
+        case Mix::e:
+            return roll < 95 ? 3 : 4;
+        case Mix::f:
+            return roll < 50 ? 0 : 2;
+        default:
+            return 0;
+        }
+    }
+public:
+    virtual char const* init() const {
+        if (built.exchange(true)) // Another worker (re)loads the records, and the workers wait for each other before running
+            return nullptr;
+        acknowledged.store(0, ::std::memory_order_relaxed);
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) { // Records of a previous initialization, if any
+            auto slots = directory(tx);
+            for (size_t i = 0; i < capacity; ++i) {
+                if (auto address = slots.read(i); address) {
+                    tx.free(address);
+                    slots[i] = nullptr;
+                }
+            }
+            next_key(tx) = nbrecords;
+        });
+        // Every record in key order and in batches, so that large stores do not need a huge transaction
+        constexpr size_t batch = 4096;
+        ::std::vector<Word> record(record_words());
+        for (size_t first = 0; first < nbrecords; first += batch) {
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                auto slots = directory(tx);
+                for (auto key = first; key < first + batch && key < nbrecords; ++key) {
+                    auto fresh = reinterpret_cast<Word*>(tx.alloc(record_words() * sizeof(Word)));
+                    fill(record.data(), key, key);
+                    tx.write(record.data(), record_words() * sizeof(Word), fresh);
+                    slots[key] = fresh;
+                }
+            });
+        }
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            ::std::vector<Word> first(record_words());
+            return next_key(tx).read() == nbrecords && fetch(tx, 0, first.data());
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::uniform_int_distribution<size_t> uniform{0, nbrecords - 1};
+        ::std::uniform_int_distribution<size_t> field_dist{0, nbfields - 1};
+        ::std::uniform_int_distribution<size_t> length_dist{1, scan_length};
+        AccessPattern zipf;
+        zipf.kind = AccessPattern::Kind::zipf;
+        zipf.theta = zipf_theta;
+        auto table = request == Request::uniform ? ::std::optional<AliasTable>{} : ::std::optional<AliasTable>{::std::in_place, zipf, nbrecords, request == Request::zipfian};
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            auto operation = draw_operation(engine);
+            // Key among the latest records, all present unless evicted meanwhile
+            auto count = nbrecords + acknowledged.load(::std::memory_order_acquire);
+            auto index = table ? (*table)(engine) : uniform(engine);
+            Word key = request == Request::latest ? count - 1 - index : count - nbrecords + index;
+            bool consistent = true;
+            switch (operation) {
+            case 0:
+                pacer.start();
+                consistent = read_tx(key);
+                local.read_tx.record(pacer.latency());
+                break;
+            case 1: {
+                auto field = field_dist(engine);
+                auto stamp = static_cast<Word>(engine());
+                pacer.start();
+                update_tx(key, field, stamp);
+                local.update_tx.record(pacer.latency());
+            } break;
+            case 2: {
+                auto field = field_dist(engine);
+                pacer.start();
+                consistent = rmw_tx(key, field);
+                local.rmw_tx.record(pacer.latency());
+            } break;
+            case 3: {
+                auto length = length_dist(engine);
+                pacer.start();
+                consistent = scan_tx(key, length);
+                local.scan_tx.record(pacer.latency());
+            } break;
+            default:
+                pacer.start();
+                insert_tx();
+                local.insert_tx.record(pacer.latency());
+                ++local.inserted;
+                acknowledged.fetch_add(1, ::std::memory_order_release);
+                break;
+            }
+            if (unlikely(!consistent))
+                return "Violated isolation or atomicity";
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.insert_tx.merge(local.insert_tx);
+            res.rmw_tx.merge(local.rmw_tx);
+            res.update_tx.merge(local.update_tx);
+            res.scan_tx.merge(local.scan_tx);
+            res.read_tx.merge(local.read_tx);
+        }
+        switch (mix) { // The dominant operation last
+        case Mix::e:
+            return {{"insert", res.insert_tx}, {"scan", res.scan_tx}};
+        case Mix::d:
+            return {{"insert", res.insert_tx}, {"read", res.read_tx}};
+        case Mix::f:
+            return {{"rmw", res.rmw_tx}, {"read", res.read_tx}};
+        case Mix::c:
+            return {{"read", res.read_tx}};
+        default:
+            return {{"update", res.update_tx}, {"read", res.read_tx}};
+        }
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every insertion counted exactly once and every latest key present and intact, before the counters overwrite the first words
+            Word expected = nbrecords;
+            for (auto const& local: states)
+                expected += local.inserted;
+            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                auto count = next_key(tx).read();
+                if (unlikely(count != expected))
+                    return false;
+                ::std::vector<Word> record(record_words());
+                auto oldest = count > capacity ? count - capacity : 0;
+                for (auto key = oldest; key < count; ++key) {
+                    if (unlikely(!fetch(tx, key, record.data()) || !intact(record.data())))
+                        return false;
+                }
+                if (count < capacity) { // Slots never used
+                    auto slots = directory(tx);
+                    for (auto slot = count; slot < capacity; ++slot) {
+                        if (unlikely(slots.read(slot) != nullptr))
+                            return false;
+                    }
+                }
+                return true;
+            });
+            if (unlikely(!correct))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
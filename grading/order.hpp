@@ -0,0 +1,224 @@
+/**
+ * @file   order.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Deterministic commit order, for '--deterministic'. The workers run their
+ * transactions in rounds: every worker still running takes part with one
+ * attempt, and the attempts end one after the other in an order drawn from the
+ * seed, the round and the worker IDs. In the serial mode an attempt also runs
+ * alone, from its begin to its end, which any library reproduces (blocking ones
+ * included). In the concurrent mode the attempts of a round execute at once and
+ * only their ends are ordered: no commit happens while attempts execute, so
+ * with a library detecting the conflicts at commit (e.g. 'tl2' or 'norec') what
+ * an attempt reads, and whether it commits, only depends on the attempts ended
+ * before it; a library blocking in an attempt on another one (e.g. a global
+ * lock) deadlocks instead. Either way, with the same seed, runs commit the same
+ * transactions in the same order. Workers that aborted in a round end first in
+ * the next one, the most aborted first, so that no worker aborts more than once
+ * per other worker in a row (and the libraries never resort to their
+ * irrevocable mode).
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Rounds of the workers of one measurement.
+**/
+class CommitOrder final {
+private:
+    /** Phase of the current round.
+    **/
+    enum class Phase {
+        gather,  // Workers arriving to begin an attempt
+        execute, // Every worker of the round executing its attempt
+        end,     // Workers ending their attempts, in order
+    };
+    /** Worker taking part in the current round.
+    **/
+    struct Entry {
+        uint64_t key; // Rank in the order: consecutive aborts in the high bits, then a hash of the seed, round and worker
+        size_t uid;   // ID of the worker
+    };
+private:
+    inline static thread_local CommitOrder* current = nullptr; // Rounds the calling worker takes part in, 'nullptr' if none
+    inline static thread_local size_t self = 0;                // ID of the calling worker
+    bool const concurrent; // Whether the attempts of a round execute at once, otherwise one after the other
+    ::std::mutex lock;
+    ::std::condition_variable wake; // Signaled whenever the phase or the next worker to end changes
+    Phase phase = Phase::gather;
+    uint64_t seed = 0;
+    uint64_t round = 0;
+    size_t active = 0;   // Workers still running transactions
+    size_t executed = 0; // Workers of the round done executing their attempt
+    size_t next = 0;     // Index in 'entries' of the next worker to end its attempt
+    ::std::vector<Entry> entries;  // Workers of the round, in order once it executes
+    ::std::vector<size_t> aborts;  // Consecutive aborts of each worker
+private:
+    /** Mix the seed, the round and a worker ID (splitmix64 finalizer).
+     * @param uid ID of the worker
+     * @return Hash, on 48 bits
+    **/
+    uint64_t mix(size_t uid) const noexcept {
+        auto x = seed ^ (round * UINT64_C(0x9e3779b97f4a7c15)) ^ (static_cast<uint64_t>(uid) * UINT64_C(0xbf58476d1ce4e5b9));
+        x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+        x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+        return (x ^ (x >> 31)) >> 16;
+    }
+    /** Start executing the gathered round if every running worker arrived, under 'lock'.
+    **/
+    void try_execute() {
+        if (phase != Phase::gather || entries.empty() || entries.size() < active)
+            return;
+        for (auto& entry: entries)
+            entry.key = (static_cast<uint64_t>(::std::min<size_t>(aborts[entry.uid], 0xffff)) << 48) | mix(entry.uid);
+        ::std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) { return a.key > b.key || (a.key == b.key && a.uid < b.uid); });
+        phase = concurrent ? Phase::execute : Phase::end;
+        executed = 0;
+        next = 0;
+        wake.notify_all();
+    }
+public:
+    /** Deleted copy constructor/assignment.
+    **/
+    CommitOrder(CommitOrder const&) = delete;
+    CommitOrder& operator=(CommitOrder const&) = delete;
+    /** Mode constructor.
+     * @param concurrent Whether the attempts of a round execute at once, only their ends being ordered
+    **/
+    CommitOrder(bool concurrent): concurrent{concurrent} {}
+public:
+    /** Start the rounds of a run, while no worker runs.
+     * @param nbworkers Number of workers about to run
+     * @param seed      Seed of the order
+    **/
+    void start(size_t nbworkers, uint64_t seed) {
+        ::std::unique_lock<decltype(lock)> guard{lock};
+        this->seed = seed;
+        round = 0;
+        active = nbworkers;
+        phase = Phase::gather;
+        entries.clear();
+        aborts.assign(nbworkers, 0);
+    }
+    /** Take part in the rounds from the calling worker, until 'leave'.
+     * @param uid ID of the worker
+    **/
+    void join(size_t uid) noexcept {
+        current = this;
+        self = uid;
+    }
+    /** Stop taking part in the rounds, once the calling worker ran its last transaction.
+    **/
+    void leave() {
+        current = nullptr;
+        ::std::unique_lock<decltype(lock)> guard{lock};
+        --active;
+        try_execute();
+    }
+public:
+    /** Membership of the calling worker in the rounds, for the lifetime of one run.
+    **/
+    class Member final {
+    private:
+        CommitOrder* order; // Rounds taken part in, 'nullptr' if none
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        Member(Member const&) = delete;
+        Member& operator=(Member const&) = delete;
+        /** Join constructor.
+         * @param order Rounds to take part in, 'nullptr' for none
+         * @param uid   ID of the calling worker
+        **/
+        Member(CommitOrder* order, size_t uid) noexcept: order{order} {
+            if (order)
+                order->join(uid);
+        }
+        /** Leave destructor, also when the run throws so that the other workers do not wait for the calling one.
+        **/
+        ~Member() noexcept {
+            if (order)
+                order->leave();
+        }
+    };
+    /** Turn of the calling worker in a round, for the lifetime of one attempt.
+    **/
+    class Turn final {
+    private:
+        CommitOrder* order; // Rounds taken part in, 'nullptr' if none
+        bool ended;         // Whether the turn to end came
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        Turn(Turn const&) = delete;
+        Turn& operator=(Turn const&) = delete;
+        /** Wait for the round of the attempt the calling worker is about to begin, and for its turn in the serial mode, if it takes part in rounds.
+        **/
+        Turn(): order{current}, ended{false} {
+            if (!order)
+                return;
+            ::std::unique_lock<decltype(order->lock)> guard{order->lock};
+            order->wake.wait(guard, [&]() { return order->phase == Phase::gather; });
+            order->entries.push_back(Entry{0, self});
+            order->try_execute();
+            if (order->concurrent) {
+                order->wake.wait(guard, [&]() { return order->phase == Phase::execute; });
+            } else {
+                order->wake.wait(guard, [&]() { return order->phase == Phase::end && order->entries[order->next].uid == self; });
+                ended = true;
+            }
+        }
+        /** Wait for every attempt of the round to be executed and for the ones ordered before, before the attempt ends (concurrent mode).
+        **/
+        void wait() {
+            if (!order || ended)
+                return;
+            ::std::unique_lock<decltype(order->lock)> guard{order->lock};
+            if (++order->executed == order->entries.size()) {
+                order->phase = Phase::end;
+                order->wake.notify_all();
+            }
+            order->wake.wait(guard, [&]() { return order->phase == Phase::end && order->entries[order->next].uid == self; });
+            ended = true;
+        }
+        /** Pass the turn to the next worker of the round once the attempt ended, starting the next round after the last one.
+         * @param committed Whether the attempt committed
+        **/
+        void pass(bool committed) {
+            if (!order)
+                return;
+            wait();
+            ::std::unique_lock<decltype(order->lock)> guard{order->lock};
+            order->aborts[self] = committed ? 0 : order->aborts[self] + 1;
+            if (++order->next == order->entries.size()) {
+                ++order->round;
+                order->entries.clear();
+                order->phase = Phase::gather;
+            }
+            order->wake.notify_all();
+            order = nullptr;
+        }
+        /** Pass destructor, for an attempt that aborted or did not commit.
+        **/
+        ~Turn() noexcept {
+            pass(false);
+        }
+    };
+};
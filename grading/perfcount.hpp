@@ -0,0 +1,131 @@
+/**
+ * @file   perfcount.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Hardware performance counters of one thread, through 'perf_event_open'.
+ * Each event is opened on its own, so that the available ones are counted
+ * even when the others are not (unsupported CPU, virtual machine without
+ * PMU, restrictive 'perf_event_paranoid'). Only user-space is counted.
+**/
+
+#pragma once
+
+// External headers
+extern "C" {
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Hardware performance counters of the thread that built the instance, for its lifetime.
+**/
+class PerfCounters final {
+public:
+    /** Counted events.
+    **/
+    enum Event: size_t {
+        cycles,       // Core cycles
+        instructions, // Retired instructions
+        llc_misses,   // Last-level cache misses
+        hitm,         // Loads hitting a modified line in another core's cache (Intel only)
+        tsx_aborts,   // Aborted RTM transactions (Intel only)
+        nbevents
+    };
+    /** Values of every event, 'invalid' where an event could not be counted.
+    **/
+    using Values = ::std::array<uint64_t, nbevents>;
+    constexpr static uint64_t invalid = UINT64_MAX;
+    /** Printable names of the events.
+    **/
+    constexpr static char const* names[nbevents] = {"cycles", "instructions", "LLC misses", "HITM loads", "TSX aborts"};
+private:
+    ::std::array<int, nbevents> fds; // Descriptor of each event, -1 if not counted
+private:
+    /** Check whether the raw Intel events can be used, their codes being the ones of the Haswell to Ice Lake cores.
+     * @return Whether the CPU is an Intel one
+    **/
+    static bool is_intel() {
+        ::std::ifstream cpuinfo{"/proc/cpuinfo"};
+        ::std::string line;
+        while (::std::getline(cpuinfo, line)) {
+            if (line.compare(0, 9, "vendor_id") == 0)
+                return line.find("GenuineIntel") != ::std::string::npos;
+        }
+        return false;
+    }
+    /** Open one event for the calling thread, on any CPU.
+     * @param type   Event type ('PERF_TYPE_*')
+     * @param config Event configuration
+     * @return Event descriptor, -1 on failure
+    **/
+    static int open(uint32_t type, uint64_t config) noexcept {
+        struct ::perf_event_attr attr;
+        ::std::memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = type;
+        attr.config         = config;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+public:
+    /** Deleted copy constructor/assignment.
+    **/
+    PerfCounters(PerfCounters const&) = delete;
+    PerfCounters& operator=(PerfCounters const&) = delete;
+    /** Open constructor, the events start counting right away.
+    **/
+    PerfCounters() {
+        static bool const intel = is_intel();
+        fds[cycles]       = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds[instructions] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[llc_misses]   = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[hitm]         = intel ? open(PERF_TYPE_RAW, 0x04d2) : -1; // MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM
+        fds[tsx_aborts]   = intel ? open(PERF_TYPE_RAW, 0x04c9) : -1; // RTM_RETIRED.ABORTED
+    }
+    /** Close destructor.
+    **/
+    ~PerfCounters() noexcept {
+        for (auto fd: fds) {
+            if (fd >= 0)
+                ::close(fd);
+        }
+    }
+public:
+    /** [thread-safe] Read the events, from any thread, scaled up if the kernel multiplexed them.
+     * @return Value of each event since construction
+    **/
+    Values read() const noexcept {
+        Values res;
+        for (size_t i = 0; i < nbevents; ++i) {
+            uint64_t buffer[3]; // Value, time enabled, time running
+            if (fds[i] < 0 || ::read(fds[i], buffer, sizeof(buffer)) != sizeof(buffer)) {
+                res[i] = invalid;
+                continue;
+            }
+            if (buffer[2] == 0) { // Never scheduled on the PMU, known only if never enabled either
+                res[i] = buffer[1] == 0 ? 0 : invalid;
+                continue;
+            }
+            res[i] = buffer[2] < buffer[1] ? static_cast<uint64_t>(static_cast<double>(buffer[0]) * static_cast<double>(buffer[1]) / static_cast<double>(buffer[2])) : buffer[0];
+        }
+        return res;
+    }
+};
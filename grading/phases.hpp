@@ -0,0 +1,225 @@
+/**
+ * @file   phases.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Phase-changing bank workload: the mix of transactions (probabilities of the
+ * long and allocation transactions, access pattern of the transfers) follows
+ * a schedule within each run, as load shifting between read-heavy hours and
+ * write-heavy batch windows. The committed transactions are counted per time
+ * window, giving the throughput of each phase and how long the throughput
+ * takes to settle after each change, i.e. how fast an adaptive engine or an
+ * auto-tuner follows. Meant to run with '--duration-ms', so that each run
+ * spans several phases.
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Phase-changing bank workload class, on the chained layout.
+ * Each worker follows the schedule from the start of its own run, the workers starting as synchronized as possible.
+**/
+class WorkloadPhases final: public WorkloadBank {
+public:
+    /** Mix of transactions of one phase.
+    **/
+    struct Mix {
+        float prob_long;      // Probability of running a long, read-only control transaction
+        float prob_alloc;     // Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+        AccessPattern access; // Access pattern of the short transactions over the accounts
+    };
+    constexpr static size_t windows_per_phase = 20;  // Throughput samples per phase
+    constexpr static double settled_tolerance = 0.1; // Relative distance to the steady throughput of a phase within which it settled
+private:
+    /** Committed transactions per window of a worker, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerWindows {
+        ::std::vector<uint_fast64_t> commits; // Commits in each window since the start of the runs, over the runs
+        ::std::vector<uint_fast64_t> runs;    // Runs that lasted the whole window
+    };
+    ::std::vector<Mix> mixes; // Mix of each phase, in schedule order, the schedule then repeating
+    Chrono::Tick phase_ns;    // Duration of each phase (in ns)
+    Chrono::Tick window_ns;   // Duration of each window (in ns)
+    mutable ::std::vector<WorkerWindows> windows; // Windows counted by each worker in 'run'
+public:
+    /** Phase-changing bank workload constructor, same parameters as the chained one but the mix, given per phase.
+     * @param mixes    Mix of each phase, in schedule order, non-empty
+     * @param phase_ms Duration of each phase (in ms)
+    **/
+    WorkloadPhases(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, ::std::vector<Mix> const& mixes, size_t phase_ms, double arrival_rate = 0.): WorkloadBank{library, nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, mixes.front().prob_long, mixes.front().prob_alloc, mixes.front().access, arrival_rate}, mixes{mixes}, phase_ns{static_cast<Chrono::Tick>(phase_ms) * 1000000ul}, window_ns{phase_ns / windows_per_phase > 0 ? phase_ns / windows_per_phase : 1}, windows(nbworkers) {}
+public:
+    /** Parse a schedule.
+     * @param text Phases separated by '+', each "<prob long>/<prob alloc>/<access pattern>"
+     * @return Mix of each phase
+    **/
+    static ::std::vector<Mix> parse_schedule(::std::string const& text) {
+        ::std::vector<Mix> res;
+        size_t pos = 0;
+        while (true) {
+            auto end = text.find('+', pos);
+            auto phase = text.substr(pos, end - pos);
+            auto first = phase.find('/');
+            auto second = first == ::std::string::npos ? first : phase.find('/', first + 1);
+            if (unlikely(second == ::std::string::npos))
+                throw ::std::invalid_argument{"phases must be given as <prob long>/<prob alloc>/<access pattern>, separated by '+'"};
+            Mix mix{::std::stof(phase.substr(0, first)), ::std::stof(phase.substr(first + 1, second - first - 1)), parse_access(phase.substr(second + 1))};
+            if (unlikely(!(mix.prob_long >= 0.f && mix.prob_long <= 1.f && mix.prob_alloc >= 0.f && mix.prob_alloc <= 1.f)))
+                throw ::std::invalid_argument{"phase probabilities must be between 0 and 1"};
+            res.push_back(mix);
+            if (end == ::std::string::npos)
+                break;
+            pos = end + 1;
+        }
+        return res;
+    }
+    /** Get a printable description of a mix.
+     * @param mix Mix to describe
+     * @return Description of the mix
+    **/
+    static ::std::string describe(Mix const& mix) {
+        ::std::ostringstream res;
+        res << "long " << mix.prob_long << ", alloc " << mix.prob_alloc << ", " << mix.access.name();
+        return res.str();
+    }
+public:
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::gamma_distribution<float> alloc_trigger(expnbaccounts, 1);
+        size_t count = nbaccounts;
+        auto& local = latencies[uid];
+        ::std::vector<::std::map<size_t, AliasTable>> tables(mixes.size()); // Account samplers of each phase by number of accounts, if not uniform
+        ::std::vector<uint_fast64_t> counted; // Commits in each window of this run
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        Chrono clock;
+        clock.start();
+        uint_fast64_t committed = 0; // Commits of the previous iteration, counted in the window it ended in
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            auto now = clock.delta();
+            auto window = static_cast<size_t>(now / window_ns);
+            if (window >= counted.size())
+                counted.resize(window + 1, 0);
+            counted[window] += committed;
+            auto phase = static_cast<size_t>(now / phase_ns) % mixes.size();
+            auto const& mix = mixes[phase];
+            committed = 1;
+            if (::std::bernoulli_distribution{mix.prob_long}(engine)) { // Do a long transaction
+                pacer.start();
+                auto consistent = long_tx(count);
+                local.long_tx.record(pacer.latency());
+                if (unlikely(!consistent))
+                    return "Violated isolation or atomicity";
+            } else if (::std::bernoulli_distribution{mix.prob_alloc}(engine)) { // Do an allocation transaction
+                auto trigger = alloc_trigger(engine);
+                pacer.start();
+                alloc_tx(trigger);
+                local.alloc_tx.record(pacer.latency());
+            } else { // Do a short transaction
+                ::std::uniform_int_distribution<size_t> uniform{0, count - 1};
+                auto table = mix.access.kind == AccessPattern::Kind::uniform ? nullptr : &tables[phase].try_emplace(count, mix.access, count).first->second;
+                auto account = [&]() { return table ? (*table)(engine) : uniform(engine); };
+                while (true) {
+                    auto send_id = account();
+                    auto recv_id = account();
+                    pacer.start();
+                    auto done = short_tx(send_id, recv_id);
+                    if (!pacer.is_open()) // Else once for the arrival, whatever the number of tries
+                        local.short_tx.record(pacer.attempt());
+                    if (likely(done))
+                        break;
+                }
+                if (pacer.is_open())
+                    local.short_tx.record(pacer.latency());
+            }
+        }
+        { // Only the windows the run lasted through are counted
+            auto& own = windows[uid];
+            auto complete = static_cast<size_t>(clock.delta() / window_ns);
+            if (complete < counted.size())
+                counted[complete] += committed;
+            if (complete > counted.size())
+                complete = counted.size();
+            if (own.commits.size() < complete) {
+                own.commits.resize(complete, 0);
+                own.runs.resize(complete, 0);
+            }
+            for (size_t i = 0; i < complete; ++i) {
+                own.commits[i] += counted[i];
+                ++own.runs[i];
+            }
+        }
+        { // Last long transaction
+            size_t dummy;
+            if (!long_tx(dummy))
+                return "Violated isolation or atomicity";
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<Phase> get_phases() const {
+        // Aggregate throughput of each window, over the runs that lasted through it
+        ::std::vector<double> rates;
+        for (size_t i = 0;; ++i) {
+            uint_fast64_t commits = 0;
+            uint_fast64_t runs = 0;
+            for (auto const& own: windows) {
+                if (i < own.commits.size()) {
+                    commits += own.commits[i];
+                    runs = ::std::max(runs, own.runs[i]);
+                }
+            }
+            if (runs == 0)
+                break;
+            rates.push_back(static_cast<double>(commits) / static_cast<double>(runs) * 1000000000. / static_cast<double>(window_ns));
+        }
+        ::std::vector<Phase> res;
+        ::std::vector<double> sums(mixes.size(), 0.);    // Sum of the window throughputs of each phase
+        ::std::vector<size_t> counts(mixes.size(), 0);   // Number of windows of each phase
+        ::std::vector<double> readapts(mixes.size(), 0.); // Sum of the times to settle after a change to each phase (in ms)
+        ::std::vector<size_t> changes(mixes.size(), 0);  // Number of changes to each phase measured
+        auto per = static_cast<size_t>(phase_ns / window_ns);
+        for (size_t start = 0; per > 0 && start + per <= rates.size(); start += per) { // Each whole instance of a phase
+            auto phase = (start / per) % mixes.size();
+            for (size_t i = start; i < start + per; ++i)
+                sums[phase] += rates[i];
+            counts[phase] += per;
+            if (start == 0 || mixes.size() < 2)
+                continue;
+            ::std::vector<double> tail(rates.begin() + static_cast<ptrdiff_t>(start + per / 2), rates.begin() + static_cast<ptrdiff_t>(start + per));
+            ::std::nth_element(tail.begin(), tail.begin() + static_cast<ptrdiff_t>(tail.size() / 2), tail.end());
+            auto steady = tail[tail.size() / 2];
+            auto settled = start;
+            while (settled < start + per && ::std::fabs(rates[settled] - steady) > settled_tolerance * steady)
+                ++settled;
+            readapts[phase] += static_cast<double>((settled - start) * window_ns) / 1000000.;
+            ++changes[phase];
+        }
+        for (size_t phase = 0; phase < mixes.size(); ++phase) {
+            if (counts[phase] == 0)
+                continue;
+            res.push_back(Phase{describe(mixes[phase]), sums[phase] / static_cast<double>(counts[phase]), changes[phase] > 0 ? readapts[phase] / static_cast<double>(changes[phase]) : ::std::nan("")});
+        }
+        return res;
+    }
+};
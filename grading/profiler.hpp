@@ -0,0 +1,316 @@
+/**
+ * @file   profiler.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Sampling profiler of the workers, for '--profile'. Each worker has a timer
+ * on its own CPU time, which the master only arms for the measured
+ * repetitions: every expiry delivers 'SIGPROF' to the worker, whose handler
+ * records the call stack into a buffer allocated beforehand. The stacks are
+ * symbolized afterwards, with 'dladdr' to find the module (grading, the
+ * tested library, the C library...) and the symbol table of its file, so that
+ * static functions get their names too, then written as folded stacks for
+ * flame graphs. The service threads of the libraries are not sampled.
+**/
+
+#pragma once
+
+// External headers
+extern "C" {
+#include <dlfcn.h>
+#include <elf.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+}
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Sampler of the call stacks of the workers of one measurement.
+**/
+class Profiler final {
+public:
+    constexpr static long frequency    = 997;      // Samples per second of CPU time of each worker, prime so as not to beat with periodic work
+    constexpr static size_t max_depth  = 64;       // Deepest stack recorded, the outermost frames being cut
+    constexpr static size_t capacity   = 1ul << 18; // Words of the stack buffer of each worker
+    constexpr static size_t skipped    = 2;        // Frames of the handler and of the signal trampoline, on top of every recorded stack
+private:
+    /** Recorded stacks of one worker, each as its depth followed by its frames, innermost first.
+    **/
+    struct Buffer {
+        ::std::vector<void*> words;
+        size_t used = 0;
+        size_t samples = 0;
+        size_t dropped = 0; // Samples that did not fit
+    };
+    /** Timer of one worker, 'buffer' being kept once the worker left.
+    **/
+    struct Worker {
+        ::timer_t timer;
+        bool live;
+        ::std::unique_ptr<Buffer> buffer;
+    };
+    /** Function symbols of one loaded file, by address relative to its load bias.
+    **/
+    struct Module {
+        ::std::string name; // Base name of the file
+        uintptr_t bias;     // Added to the symbol values to get addresses
+        ::std::vector<::std::tuple<uintptr_t, uintptr_t, ::std::string>> symbols; // Start, size and name, by start
+    };
+    inline static thread_local Buffer* current = nullptr; // Buffer of the calling worker while it may be sampled
+    ::std::mutex lock; // Protects 'workers'
+    ::std::vector<Worker> workers;
+private:
+    /** Record the call stack of the interrupted worker, async-signal-safe once 'backtrace' was called outside the handler.
+    **/
+    static void on_signal(int) noexcept {
+        auto buffer = current;
+        if (!buffer)
+            return;
+        auto saved = errno;
+        void* frames[max_depth + skipped];
+        auto depth = ::backtrace(frames, max_depth + skipped);
+        auto kept = depth > static_cast<int>(skipped) ? static_cast<size_t>(depth) - skipped : 0;
+        if (buffer->used + kept + 1 > buffer->words.size()) {
+            ++buffer->dropped;
+        } else {
+            buffer->words[buffer->used++] = reinterpret_cast<void*>(kept);
+            for (size_t i = 0; i < kept; ++i)
+                buffer->words[buffer->used++] = frames[skipped + i];
+            ++buffer->samples;
+        }
+        errno = saved;
+    }
+    /** Read the function symbols of a loaded file, from its full symbol table or else its dynamic one.
+     * @param path Path of the file
+     * @param base Address the file was loaded at
+     * @return Symbols, none if the file cannot be read
+    **/
+    static Module load_module(char const* path, uintptr_t base) {
+        Module res;
+        auto slash = ::std::strrchr(path, '/');
+        res.name = slash ? slash + 1 : path;
+        res.bias = base;
+        ::std::ifstream file{path, ::std::ios::binary};
+        ::std::vector<char> image{::std::istreambuf_iterator<char>{file}, ::std::istreambuf_iterator<char>{}};
+        if (image.size() < sizeof(Elf64_Ehdr) || ::std::memcmp(image.data(), ELFMAG, SELFMAG) != 0 || image[EI_CLASS] != ELFCLASS64)
+            return res;
+        auto const& header = *reinterpret_cast<Elf64_Ehdr const*>(image.data());
+        if (header.e_type == ET_EXEC) // Absolute addresses
+            res.bias = 0;
+        if (header.e_shoff == 0 || header.e_shoff + header.e_shnum * sizeof(Elf64_Shdr) > image.size())
+            return res;
+        auto sections = reinterpret_cast<Elf64_Shdr const*>(image.data() + header.e_shoff);
+        Elf64_Word const types[] = {SHT_SYMTAB, SHT_DYNSYM};
+        for (auto type: types) {
+            for (size_t i = 0; i < header.e_shnum; ++i) {
+                auto const& table = sections[i];
+                if (table.sh_type != type || table.sh_link >= header.e_shnum)
+                    continue;
+                auto const& strings = sections[table.sh_link];
+                if (table.sh_offset + table.sh_size > image.size() || strings.sh_offset + strings.sh_size > image.size())
+                    continue;
+                auto symbols = reinterpret_cast<Elf64_Sym const*>(image.data() + table.sh_offset);
+                for (size_t j = 0; j < table.sh_size / sizeof(Elf64_Sym); ++j) {
+                    auto const& symbol = symbols[j];
+                    if (ELF64_ST_TYPE(symbol.st_info) != STT_FUNC || symbol.st_value == 0 || symbol.st_name >= strings.sh_size)
+                        continue;
+                    res.symbols.emplace_back(symbol.st_value, symbol.st_size, demangle(image.data() + strings.sh_offset + symbol.st_name));
+                }
+            }
+            if (!res.symbols.empty())
+                break;
+        }
+        ::std::sort(res.symbols.begin(), res.symbols.end());
+        return res;
+    }
+    /** Demangle a symbol name, with no ';' left in it (the separator of the folded stacks).
+     * @param name Symbol name
+     * @return Demangled name, or the name itself
+    **/
+    static ::std::string demangle(char const* name) {
+        int status = 0;
+        auto demangled = ::abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        ::std::string res{status == 0 && demangled ? demangled : name};
+        ::std::free(demangled);
+        ::std::replace(res.begin(), res.end(), ';', ':');
+        return res;
+    }
+    /** Name the function holding an address, as "<module>`<function>", or "<module>+<offset>" if it has no symbol.
+     * @param address Address to name
+     * @param modules Modules read so far, by load address
+     * @return Name of the frame
+    **/
+    static ::std::string frame_name(uintptr_t address, ::std::map<uintptr_t, Module>& modules) {
+        ::Dl_info info;
+        if (::dladdr(reinterpret_cast<void*>(address), &info) == 0 || !info.dli_fname)
+            return "[unknown]";
+        auto base = reinterpret_cast<uintptr_t>(info.dli_fbase);
+        auto found = modules.find(base);
+        if (found == modules.end())
+            found = modules.emplace(base, load_module(info.dli_fname, base)).first;
+        auto const& module = found->second;
+        auto offset = address - module.bias;
+        auto const& symbols = module.symbols;
+        auto after = ::std::upper_bound(symbols.begin(), symbols.end(), offset, [](uintptr_t offset, auto const& symbol) { return offset < ::std::get<0>(symbol); });
+        if (after != symbols.begin()) {
+            auto const& [start, size, name] = *(after - 1);
+            if (offset < start + size)
+                return module.name + "`" + name;
+        }
+        if (info.dli_sname)
+            return module.name + "`" + demangle(info.dli_sname);
+        char text[32];
+        ::std::snprintf(text, sizeof(text), "+%#lx", static_cast<unsigned long>(address - base));
+        return module.name + text;
+    }
+public:
+    /** Per-worker registration, for the lifetime of the worker.
+    **/
+    class Sampled final {
+    private:
+        Profiler* profiler; // Profiler registered with, 'nullptr' if none
+        size_t index;       // Index of the worker in the profiler
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        Sampled(Sampled const&) = delete;
+        Sampled& operator=(Sampled const&) = delete;
+        /** Register the calling worker, with a disarmed timer.
+         * @param profiler Profiler to register with, 'nullptr' for none
+        **/
+        Sampled(Profiler* profiler): profiler{profiler}, index{0} {
+            if (!profiler)
+                return;
+            void* warmup[1];
+            ::backtrace(warmup, 1); // Loads the unwinder now, rather than in the handler
+            auto buffer = ::std::make_unique<Buffer>();
+            buffer->words.resize(capacity);
+            struct ::sigevent event;
+            ::std::memset(&event, 0, sizeof(event));
+            event.sigev_notify = SIGEV_THREAD_ID;
+            event.sigev_signo = SIGPROF;
+            event._sigev_un._tid = static_cast<pid_t>(::syscall(SYS_gettid));
+            ::timer_t timer;
+            if (unlikely(::timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer) != 0)) {
+                this->profiler = nullptr;
+                return;
+            }
+            current = buffer.get();
+            ::std::unique_lock<decltype(profiler->lock)> guard{profiler->lock};
+            index = profiler->workers.size();
+            profiler->workers.push_back(Worker{timer, true, ::std::move(buffer)});
+        }
+        /** Unregister destructor, the recorded stacks staying with the profiler.
+        **/
+        ~Sampled() noexcept {
+            if (!profiler)
+                return;
+            current = nullptr;
+            ::std::unique_lock<decltype(profiler->lock)> guard{profiler->lock};
+            auto& worker = profiler->workers[index];
+            ::timer_delete(worker.timer);
+            worker.live = false;
+        }
+    };
+public:
+    /** Deleted copy constructor/assignment.
+    **/
+    Profiler(Profiler const&) = delete;
+    Profiler& operator=(Profiler const&) = delete;
+    /** Install the signal handler, once for the process.
+    **/
+    Profiler() {
+        static ::std::once_flag installed;
+        ::std::call_once(installed, []() {
+            struct ::sigaction action;
+            ::std::memset(&action, 0, sizeof(action));
+            action.sa_handler = on_signal;
+            action.sa_flags = SA_RESTART; // The waits of the workers are not interrupted
+            ::sigemptyset(&action.sa_mask);
+            if (unlikely(::sigaction(SIGPROF, &action, nullptr) != 0))
+                throw ::std::runtime_error{"unable to install the profiling signal handler"};
+        });
+    }
+public:
+    /** [thread-safe] Start or stop sampling every registered worker, called while they all wait.
+     * @param on Whether to start sampling
+    **/
+    void arm(bool on) {
+        struct ::itimerspec period;
+        ::std::memset(&period, 0, sizeof(period));
+        if (on) {
+            period.it_interval.tv_nsec = 1000000000l / frequency;
+            period.it_value = period.it_interval;
+        }
+        ::std::unique_lock<decltype(lock)> guard{lock};
+        for (auto& worker: workers) {
+            if (worker.live)
+                ::timer_settime(worker.timer, 0, &period, nullptr);
+        }
+    }
+    /** Append the recorded stacks as folded stacks, one line per distinct stack with its number of samples, the outermost frame first.
+     * @param path Path of the file to append to
+     * @param root Name of the frame put below every stack, e.g. the library and number of workers
+     * @return Number of samples written and of samples dropped for lack of room
+    **/
+    ::std::pair<size_t, size_t> write(::std::string const& path, ::std::string const& root) {
+        ::std::unique_lock<decltype(lock)> guard{lock};
+        ::std::map<uintptr_t, Module> modules;
+        ::std::unordered_map<uintptr_t, ::std::string> names; // Frame names by address
+        ::std::map<::std::string, size_t> stacks;
+        size_t samples = 0;
+        size_t dropped = 0;
+        for (auto const& worker: workers) {
+            auto const& buffer = *worker.buffer;
+            samples += buffer.samples;
+            dropped += buffer.dropped;
+            for (size_t at = 0; at < buffer.used;) {
+                auto depth = reinterpret_cast<size_t>(buffer.words[at]);
+                ::std::string stack = root;
+                for (size_t i = depth; i > 0; --i) {
+                    // The interrupted frame has its own address, the callers the one after their call
+                    auto address = reinterpret_cast<uintptr_t>(buffer.words[at + i]) - (i > 1 ? 1 : 0);
+                    auto found = names.find(address);
+                    if (found == names.end())
+                        found = names.emplace(address, frame_name(address, modules)).first;
+                    stack += ";" + found->second;
+                }
+                ++stacks[stack];
+                at += depth + 1;
+            }
+        }
+        ::std::ofstream file{path, ::std::ios::app};
+        for (auto const& [stack, count]: stacks)
+            file << stack << " " << count << '\n';
+        if (unlikely(!file))
+            throw ::std::runtime_error{"unable to write the profile to '" + path + "'"};
+        return {samples, dropped};
+    }
+};
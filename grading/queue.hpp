@@ -0,0 +1,318 @@
+/**
+ * @file   queue.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Producer/consumer queue workload: a transactional FIFO linked queue, its
+ * head and tail pointers in the first segment. Producers allocate and link
+ * nodes at the tail, consumers unlink and free them at the head, as a job
+ * dispatch service. Every transaction writes one of two single hot words, the
+ * worst case for contention managers and for any support of commutative
+ * operations, and allocates or frees a node.
+**/
+
+#pragma once
+
+// External headers
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Producer/consumer queue workload class.
+ * Each node holds an item naming its producer and its rank among the items of that producer; a consumer must dequeue the items of any one
+ * producer in increasing rank, which the FIFO order guarantees.
+**/
+class WorkloadQueue final: public Workload {
+public:
+    /** Item class alias, the producer (0 for the initial items, the worker ID plus 1 otherwise) in the upper bits, the rank in the others.
+    **/
+    using Item = uint64_t;
+    constexpr static unsigned int rank_bits = 40; // Bits of the rank in an item
+private:
+    /** Shared queue node class.
+    **/
+    class QueueNode final {
+    private:
+        /** Dummy structure for size and alignment retrieval.
+        **/
+        struct Dummy {
+            Item  dummy0;
+            void* dummy1;
+        };
+    public:
+        /** Get the node size.
+         * @return Node size (in bytes)
+        **/
+        constexpr static auto size() noexcept {
+            return sizeof(Dummy);
+        }
+    public:
+        /** Private copy of the node, laid out as in shared memory.
+        **/
+        struct Header {
+            Item       item; // Item of the node
+            QueueNode* next; // Next node toward the tail, 'nullptr' for none
+        };
+        static_assert(sizeof(Header) == sizeof(Dummy), "Header does not match the node layout");
+    private:
+        Transaction& tx; // Associated pending transaction
+    public:
+        Shared<Item>        item; // Item of the node
+        Shared<QueueNode*>  next; // Next node toward the tail, 'nullptr' for none
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        QueueNode(QueueNode const&) = delete;
+        QueueNode& operator=(QueueNode const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Block base address
+        **/
+        QueueNode(Transaction& tx, void* address): tx{tx}, item{tx, address}, next{tx, item.after()} {}
+    public:
+        /** Read the whole node with a single transactional read.
+         * @return Private copy of the node
+        **/
+        Header header() const {
+            Header res;
+            tx.read(item.get(), sizeof(Header), &res);
+            return res;
+        }
+    };
+    /** Shared first segment class.
+    **/
+    class QueueRoot final {
+    private:
+        /** Dummy structure for size and alignment retrieval, the two first words for 'check_counters'.
+        **/
+        struct Dummy {
+            size_t dummy0;
+            size_t dummy1;
+            void*  dummy2;
+            void*  dummy3;
+        };
+    public:
+        /** Get the segment size.
+         * @return Segment size (in bytes)
+        **/
+        constexpr static auto size() noexcept {
+            return sizeof(Dummy);
+        }
+        /** Get the segment alignment.
+         * @return Segment alignment (in bytes)
+        **/
+        constexpr static auto align() noexcept {
+            return alignof(Dummy);
+        }
+    public:
+        Shared<QueueNode*> head; // Oldest node, 'nullptr' if empty
+        Shared<QueueNode*> tail; // Newest node, 'nullptr' if empty
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        QueueRoot(QueueRoot const&) = delete;
+        QueueRoot& operator=(QueueRoot const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Segment base address
+        **/
+        QueueRoot(Transaction& tx, void* address): head{tx, reinterpret_cast<uint8_t*>(address) + offsetof(Dummy, dummy2)}, tail{tx, head.after()} {}
+    };
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram enqueue_tx; // Enqueue transactions
+        Histogram dequeue_tx; // Dequeue transactions, the empty ones included
+        ptrdiff_t delta = 0;  // Items enqueued minus items dequeued by the worker
+        Item rank = 0;        // Rank of the latest item the worker produced
+        ::std::vector<Item> seen; // Rank of the latest item the worker dequeued from each producer
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    size_t nbinitial;    // Number of items initially in the queue
+    float  prob_enqueue; // Probability of an enqueue instead of a dequeue, for the workers of both roles
+    bool   split;        // Whether the even workers only produce and the odd ones only consume (with two workers or more)
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Queue workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param nbinitial    Number of items initially in the queue
+     * @param prob_enqueue Probability of an enqueue instead of a dequeue, for the workers of both roles
+     * @param split        Whether the even workers only produce and the odd ones only consume (with two workers or more)
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadQueue(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbinitial, float prob_enqueue, bool split, double arrival_rate = 0.): Workload{library, QueueRoot::align(), QueueRoot::size()}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbinitial{nbinitial}, prob_enqueue{prob_enqueue}, split{split}, arrival_rate{arrival_rate}, barrier(nbworkers), states(nbworkers) {
+        for (auto& local: states)
+            local.seen.resize(nbworkers + 1, 0);
+    }
+private:
+    /** Enqueue transaction.
+     * @param item Item to enqueue
+    **/
+    void enqueue_tx(Item item) const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            QueueRoot root{tx, tm.get_start()};
+            auto last = root.tail.read();
+            auto fresh = last ? QueueNode{tx, last}.next.alloc(QueueNode::size()) : root.head.alloc(QueueNode::size());
+            QueueNode node{tx, fresh};
+            node.item = item;
+            node.next = nullptr;
+            root.tail = fresh;
+        });
+    }
+    /** Dequeue transaction.
+     * @param item Set to the item dequeued, if any
+     * @return Whether the queue was not empty
+    **/
+    bool dequeue_tx(Item& item) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            QueueRoot root{tx, tm.get_start()};
+            auto first = root.head.read();
+            if (!first)
+                return false;
+            auto header = QueueNode{tx, first}.header();
+            root.head.free();
+            root.head = header.next;
+            if (!header.next)
+                root.tail = nullptr;
+            item = header.item;
+            return true;
+        });
+    }
+    /** Whole-queue transaction, checking the links and the order of the items of each producer.
+     * @param size Set to the number of items in the queue, if consistent
+     * @return Whether no inconsistency has been found
+    **/
+    bool walk_tx(size_t& size) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            QueueRoot root{tx, tm.get_start()};
+            ::std::vector<Item> ranks(nbworkers + 1, 0);
+            size_t count = 0;
+            QueueNode* last = nullptr;
+            for (auto node = root.head.read(); node;) {
+                auto header = QueueNode{tx, node}.header();
+                auto producer = static_cast<size_t>(header.item >> rank_bits);
+                auto rank = header.item & ((Item{1} << rank_bits) - 1);
+                if (unlikely(producer > nbworkers || rank <= ranks[producer]))
+                    return false;
+                ranks[producer] = rank;
+                ++count;
+                last = node;
+                node = header.next;
+            }
+            if (unlikely(root.tail.read() != last))
+                return false;
+            size = count;
+            return true;
+        });
+    }
+public:
+    virtual char const* init() const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            QueueRoot root{tx, tm.get_start()};
+            for (auto node = root.head.read(); node;) { // Nodes of a previous initialization, if any
+                auto next = QueueNode{tx, node}.next.read();
+                tx.free(node);
+                node = next;
+            }
+            QueueNode* next = nullptr;
+            for (auto i = nbinitial; i > 0; --i) { // Ranks 1 to 'nbinitial' of the producer 0, from the last
+                auto fresh = reinterpret_cast<QueueNode*>(tx.alloc(QueueNode::size()));
+                QueueNode node{tx, fresh};
+                node.item = i;
+                node.next = next;
+                if (!next)
+                    root.tail = fresh;
+                next = fresh;
+            }
+            root.head = next;
+            if (!next)
+                root.tail = nullptr;
+        });
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto head = QueueRoot{tx, tm.get_start()}.head.read();
+            return nbinitial == 0 ? head == nullptr : head && QueueNode{tx, head}.item == 1;
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::bernoulli_distribution enqueue_dist{prob_enqueue};
+        auto role = split && nbworkers > 1 ? (uid % 2 == 0 ? 1 : -1) : 0; // Producer, consumer or both
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            if (role > 0 || (role == 0 && enqueue_dist(engine))) { // Do an enqueue
+                auto item = (static_cast<Item>(uid + 1) << rank_bits) | ++local.rank;
+                pacer.start();
+                enqueue_tx(item);
+                local.enqueue_tx.record(pacer.latency());
+                ++local.delta;
+            } else { // Do a dequeue
+                Item item;
+                pacer.start();
+                auto found = dequeue_tx(item);
+                local.dequeue_tx.record(pacer.latency());
+                if (found) {
+                    --local.delta;
+                    auto producer = static_cast<size_t>(item >> rank_bits);
+                    auto rank = item & ((Item{1} << rank_bits) - 1);
+                    if (unlikely(producer > nbworkers || rank <= local.seen[producer]))
+                        return "Violated isolation or atomicity (items of a producer dequeued out of order)";
+                    local.seen[producer] = rank;
+                }
+            }
+        }
+        { // Last whole-queue transaction
+            size_t dummy;
+            if (!walk_tx(dummy))
+                return "Violated isolation or atomicity";
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.enqueue_tx.merge(local.enqueue_tx);
+            res.dequeue_tx.merge(local.dequeue_tx);
+        }
+        return {{"enqueue", res.enqueue_tx}, {"dequeue", res.dequeue_tx}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every enqueue and dequeue counted exactly once, before the counters overwrite the first words
+            auto expected = static_cast<ptrdiff_t>(nbinitial);
+            for (auto const& local: states)
+                expected += local.delta;
+            size_t size;
+            if (unlikely(!walk_tx(size) || static_cast<ptrdiff_t>(size) != expected))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
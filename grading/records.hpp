@@ -0,0 +1,230 @@
+/**
+ * @file   records.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Large-record workload: records of a configurable size, from a few words
+ * to tens of kilobytes, each read or written with a single call, so that the
+ * per-byte costs of the engines (metadata per word, log growth, copies) show
+ * instead of their per-access costs. With 'view', the read transactions check
+ * the record in place through 'tm_read_view' when the library exports it,
+ * instead of copying it out; with 'reserve', the write transactions stamp the
+ * record in the room 'tm_write_reserve' lends instead of in a private copy.
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Large-record workload class.
+ * Read transactions read one record; write transactions read one record then overwrite another with a new stamp. Every word of a record
+ * holds the same stamp, so that a record read partially before and partially after a write shows.
+**/
+class WorkloadRecords final: public Workload {
+public:
+    /** Word class alias.
+    **/
+    using Word = uint64_t;
+private:
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram write_tx; // Write transactions
+        Histogram read_tx;  // Read transactions
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    size_t nbrecords;    // Number of records
+    size_t record_size;  // Size of a record (in bytes), a multiple of the alignment
+    size_t offset;       // Offset of the first record, after the two counters of 'check_counters'
+    float  prob_write;   // Probability of a write transaction
+    bool   view;         // Whether the read transactions view the record in place rather than copy it
+    bool   reserve;      // Whether the write transactions stamp the record in the room the library lends rather than copy it
+    AccessPattern access; // Access pattern over the records
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::vector<WorkerState> states; // State of each worker
+private:
+    /** Round a size up to a multiple of the alignment, itself at least a word.
+     * @param size  Size to round
+     * @param align Alignment
+     * @return Rounded size
+    **/
+    constexpr static size_t round_up(size_t size, size_t align) noexcept {
+        auto unit = align < sizeof(Word) ? sizeof(Word) : align;
+        return (size + unit - 1) / unit * unit;
+    }
+public:
+    /** Large-record workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param nbrecords    Number of records
+     * @param record_size  Size of a record (in bytes, rounded up to a multiple of the alignment)
+     * @param align        Alignment of the shared memory, of every record and of every access
+     * @param prob_write   Probability of a write transaction
+     * @param view         Whether the read transactions view the record in place, if the library exports 'tm_read_view'
+     * @param reserve      Whether the write transactions stamp the record in place, if the library exports 'tm_write_reserve'
+     * @param access       Access pattern over the records
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadRecords(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbrecords, size_t record_size, size_t align, float prob_write, bool view, bool reserve, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): Workload{library, align, round_up(2 * sizeof(size_t), align) + nbrecords * round_up(record_size, align)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbrecords{nbrecords}, record_size{round_up(record_size, align)}, offset{round_up(2 * sizeof(size_t), align)}, prob_write{prob_write}, view{view}, reserve{reserve}, access{access}, arrival_rate{arrival_rate}, barrier(nbworkers), states(nbworkers) {}
+private:
+    /** Get the address of a record.
+     * @param index Record index
+     * @return Address of the record
+    **/
+    void* record_at(size_t index) const noexcept {
+        return reinterpret_cast<uint8_t*>(tm.get_start()) + offset + index * record_size;
+    }
+    /** Check that a record was written as a whole.
+     * @param record Words of the record, in a private copy or in place
+     * @param count  Number of words
+     * @return Whether every word holds the same stamp
+    **/
+    static bool intact(Word const* record, size_t count) noexcept {
+        for (size_t i = 0; i < count; ++i) {
+            if (unlikely(record[i] != record[0]))
+                return false;
+        }
+        return true;
+    }
+    bool intact(::std::vector<Word> const& record) const noexcept {
+        return intact(record.data(), record.size());
+    }
+    /** Read transaction.
+     * @param index  Record to read
+     * @param record Private copy receiving the record, unless viewed in place
+     * @return Whether the record read was written as a whole
+    **/
+    bool read_tx(size_t index, ::std::vector<Word>& record) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            if (view) { // What the view shows only counts once committed, the commit failing if it changed meanwhile
+                auto shown = static_cast<Word const*>(tx.read_view(record_at(index), record_size));
+                if (shown)
+                    return intact(shown, record.size());
+            }
+            tx.read(record_at(index), record_size, record.data());
+            return intact(record);
+        });
+    }
+    /** Write transaction, reading one record then overwriting another.
+     * @param source  Record to read
+     * @param target  Record to overwrite
+     * @param record  Private copy receiving the record read
+     * @param stamp   New stamp, for every word of the record written
+     * @param scratch Private record stamped then written, unless stamped in place
+    **/
+    void write_tx(size_t source, size_t target, ::std::vector<Word>& record, Word stamp, ::std::vector<Word>& scratch) const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            tx.read(record_at(source), record_size, record.data());
+            if (reserve) {
+                auto room = static_cast<Word*>(tx.write_reserve(record_at(target), record_size));
+                if (room) {
+                    ::std::fill(room, room + scratch.size(), stamp);
+                    return;
+                }
+            }
+            ::std::fill(scratch.begin(), scratch.end(), stamp);
+            tx.write(scratch.data(), record_size, record_at(target));
+        });
+    }
+public:
+    virtual char const* init() const {
+        ::std::vector<Word> zeros(record_size / sizeof(Word), 0);
+        for (size_t i = 0; i < nbrecords; ++i) { // One record per transaction, so that large records do not need a huge transaction
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                tx.write(zeros.data(), record_size, record_at(i));
+            });
+        }
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            ::std::vector<Word> record(record_size / sizeof(Word));
+            tx.read(record_at(nbrecords - 1), record_size, record.data());
+            return record[0] == 0 && intact(record);
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::bernoulli_distribution write_dist{prob_write};
+        ::std::uniform_int_distribution<size_t> uniform{0, nbrecords - 1};
+        auto table = access.kind == AccessPattern::Kind::uniform ? ::std::optional<AliasTable>{} : ::std::optional<AliasTable>{::std::in_place, access, nbrecords};
+        auto draw = [&]() { return table ? (*table)(engine) : uniform(engine); };
+        ::std::vector<Word> record(record_size / sizeof(Word));
+        ::std::vector<Word> stamp(record_size / sizeof(Word));
+        Word sequence = 0;
+        auto& local = states[uid];
+        auto correct = true;
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            auto source = draw();
+            if (write_dist(engine)) {
+                auto target = draw();
+                pacer.start();
+                write_tx(source, target, record, (static_cast<Word>(uid) + 1) << 40 | ++sequence, stamp);
+                local.write_tx.record(pacer.latency());
+                correct = intact(record); // Checked once committed, the copy out of the timed transaction
+            } else {
+                pacer.start();
+                correct = read_tx(source, record);
+                local.read_tx.record(pacer.latency());
+            }
+            if (unlikely(!correct))
+                return "Violated isolation or atomicity";
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.write_tx.merge(local.write_tx);
+            res.read_tx.merge(local.read_tx);
+        }
+        return {{"write", res.write_tx}, {"read", res.read_tx}};
+    }
+    virtual double get_bytes_per_tx() const {
+        return static_cast<double>(record_size) * (1. + prob_write);
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every record written as a whole, before the counters overwrite the first words
+            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                ::std::vector<Word> record(record_size / sizeof(Word));
+                for (size_t i = 0; i < nbrecords; ++i) {
+                    tx.read(record_at(i), record_size, record.data());
+                    if (unlikely(!intact(record)))
+                        return false;
+                }
+                return true;
+            });
+            if (unlikely(!correct))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
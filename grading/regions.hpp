@@ -0,0 +1,219 @@
+/**
+ * @file   regions.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Multi-region workload: several independent shared memory regions, as one
+ * per tenant, with the transactions routed across them. Transactions on
+ * different regions never share data, so any slowdown when adding regions
+ * (e.g. sweeping the number of regions with workers pinned to them) comes
+ * from state the engine shares between regions (global clock, lock table,
+ * allocator, statistics).
+**/
+
+#pragma once
+
+// External headers
+#include <deque>
+#include <memory>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Multi-region workload class.
+ * Each region holds its own accounts; transactions transfer between two accounts of one region, or audit all the accounts of one region.
+ * The first region is the one of the workload, the others are created alongside.
+**/
+class WorkloadRegions final: public Workload {
+public:
+    /** Account balance class alias.
+    **/
+    using Balance = intptr_t;
+    /** Routing of the transactions to the regions.
+    **/
+    enum class Routing {
+        pinned, // Each worker on one region, the workers spread over the regions
+        random  // Each transaction on a random region
+    };
+private:
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram audit_tx;    // Audit transactions
+        Histogram transfer_tx; // Transfer transactions
+    };
+    /** Registration of the calling thread with the other regions, for the duration of a call.
+    **/
+    class Registrations final {
+    private:
+        ::std::deque<TransactionalThread> threads; // Registration with each other region
+    public:
+        /** Register constructor.
+         * @param others Regions to register with
+        **/
+        Registrations(::std::vector<::std::unique_ptr<TransactionalMemory>> const& others) {
+            for (auto const& region: others)
+                threads.emplace_back(*region);
+        }
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    size_t nbaccounts;   // Number of accounts per region
+    Balance init_balance; // Initial balance of each account
+    float  prob_audit;   // Probability of an audit transaction
+    Routing routing;     // Routing of the transactions to the regions
+    AccessPattern access; // Access pattern over the accounts of a region
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    ::std::vector<::std::unique_ptr<TransactionalMemory>> others; // Regions besides the one of the workload
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Multi-region workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param nbregions    Number of regions, each created with 'tm_create'
+     * @param nbaccounts   Number of accounts per region
+     * @param init_balance Initial balance of each account
+     * @param prob_audit   Probability of an audit transaction
+     * @param routing      Routing of the transactions to the regions
+     * @param access       Access pattern over the accounts of a region
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadRegions(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbregions, size_t nbaccounts, Balance init_balance, float prob_audit, Routing routing, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): Workload{library, alignof(Balance), (2 + nbaccounts) * sizeof(Balance)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbaccounts{nbaccounts}, init_balance{init_balance}, prob_audit{prob_audit}, routing{routing}, access{access}, arrival_rate{arrival_rate}, barrier(nbworkers), states(nbworkers) {
+        for (size_t i = 1; i < nbregions; ++i)
+            others.push_back(::std::make_unique<TransactionalMemory>(library, alignof(Balance), (2 + nbaccounts) * sizeof(Balance)));
+    }
+private:
+    /** Get a region.
+     * @param index Region index
+     * @return Transactional memory of the region
+    **/
+    TransactionalMemory const& region(size_t index) const noexcept {
+        return index == 0 ? tm : *others[index - 1];
+    }
+    /** Get the accounts of a region.
+     * @param memory Transactional memory of the region
+     * @param tx     Associated pending transaction
+     * @return Accounts of the region
+    **/
+    static Shared<Balance[]> accounts(TransactionalMemory const& memory, Transaction& tx) {
+        return Shared<Balance[]>{tx, reinterpret_cast<Balance*>(memory.get_start()) + 2};
+    }
+    /** Transfer transaction.
+     * @param index  Region of the accounts
+     * @param from   Account to withdraw from
+     * @param to     Account to deposit to
+     * @param amount Amount to transfer, if available
+    **/
+    void transfer_tx(size_t index, size_t from, size_t to, Balance amount) const {
+        auto const& memory = region(index);
+        transactional(memory, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto balances = accounts(memory, tx);
+            auto balance = balances.read(from);
+            if (balance < amount || from == to)
+                return;
+            balances[from] = balance - amount;
+            balances[to] = balances.read(to) + amount;
+        });
+    }
+    /** Audit transaction.
+     * @param index Region to audit
+     * @return Whether the total balance of the region is the initial one
+    **/
+    bool audit_tx(size_t index) const {
+        auto const& memory = region(index);
+        return transactional(memory, Transaction::Mode::read_only, [&](Transaction& tx) {
+            thread_local ::std::vector<Balance> balances;
+            balances.resize(nbaccounts);
+            accounts(memory, tx).read_range(0, nbaccounts, balances.data());
+            Balance total = 0;
+            for (auto balance: balances)
+                total += balance;
+            return total == static_cast<Balance>(nbaccounts) * init_balance;
+        });
+    }
+public:
+    virtual char const* init() const {
+        Registrations registrations{others};
+        for (size_t index = 0; index <= others.size(); ++index) {
+            auto const& memory = region(index);
+            transactional(memory, Transaction::Mode::read_write, [&](Transaction& tx) {
+                auto balances = accounts(memory, tx);
+                for (size_t i = 0; i < nbaccounts; ++i)
+                    balances[i] = init_balance;
+            });
+            if (unlikely(!audit_tx(index)))
+                return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        }
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        Registrations registrations{others};
+        auto nbregions = others.size() + 1;
+        ::std::minstd_rand engine{seed};
+        ::std::bernoulli_distribution audit_dist{prob_audit};
+        ::std::uniform_int_distribution<size_t> region_dist{0, nbregions - 1};
+        ::std::uniform_int_distribution<size_t> uniform{0, nbaccounts - 1};
+        ::std::uniform_int_distribution<Balance> amount_dist{1, init_balance};
+        auto table = access.kind == AccessPattern::Kind::uniform ? ::std::optional<AliasTable>{} : ::std::optional<AliasTable>{::std::in_place, access, nbaccounts};
+        auto draw = [&]() { return table ? (*table)(engine) : uniform(engine); };
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            auto index = routing == Routing::pinned ? uid % nbregions : region_dist(engine);
+            if (audit_dist(engine)) {
+                pacer.start();
+                auto consistent = audit_tx(index);
+                local.audit_tx.record(pacer.latency());
+                if (unlikely(!consistent))
+                    return "Violated isolation or atomicity";
+            } else {
+                auto from = draw();
+                auto to = draw();
+                auto amount = amount_dist(engine);
+                pacer.start();
+                transfer_tx(index, from, to, amount);
+                local.transfer_tx.record(pacer.latency());
+            }
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.audit_tx.merge(local.audit_tx);
+            res.transfer_tx.merge(local.transfer_tx);
+        }
+        return {{"audit", res.audit_tx}, {"transfer", res.transfer_tx}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every region kept its total balance, before the counters overwrite the first words of the first region
+            Registrations registrations{others};
+            for (size_t index = 0; index <= others.size(); ++index) {
+                if (unlikely(!audit_tx(index)))
+                    error = "Violated isolation or atomicity";
+            }
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
@@ -0,0 +1,541 @@
+/**
+ * @file   registry.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Registry of the workloads the grading can run, selected by name. Every
+ * workload shares the common settings (workers, transactions, arrivals and
+ * access pattern) and reads its own named options; the options it read, with
+ * their defaults resolved, are kept in order for the report. Each workload
+ * keeps its own isolation checks in its 'check'.
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+#include "stamp.hpp"
+#include "kv.hpp"
+#include "records.hpp"
+#include "churn.hpp"
+#include "regions.hpp"
+#include "bigmem.hpp"
+#include "replay.hpp"
+#include "clients.hpp"
+#include "phases.hpp"
+#include "summed.hpp"
+#include "queue.hpp"
+#include "graph.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Settings common to every workload.
+**/
+struct WorkloadSettings {
+    size_t nbworkers;     // Number of concurrent workers
+    size_t nbtxperwrk;    // Number of transactions per worker, 0 for as many as possible until asked to stop
+    AccessPattern access; // Access pattern over the keys (e.g. accounts)
+    double arrival_rate;  // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+};
+
+/** Named options of one workload, as given then as resolved.
+**/
+class WorkloadOptions final {
+private:
+    ::std::map<::std::string, ::std::string> given; // Given value of each option
+    ::std::set<::std::string> read; // Options read so far
+    ::std::vector<::std::pair<::std::string, ::std::string>> resolved; // Options read so far with their value, default included, in read order
+private:
+    /** Get the given value of an option, and note the value in use.
+     * @param name     Name of the option
+     * @param fallback Default value
+     * @return Given value, the empty string if none
+    **/
+    template<class Type> ::std::string lookup(char const* name, Type fallback) {
+        read.insert(name);
+        auto iter = given.find(name);
+        ::std::ostringstream value;
+        if (iter == given.end()) {
+            value << fallback;
+        } else {
+            value << iter->second;
+        }
+        resolved.emplace_back(name, value.str());
+        return iter == given.end() ? ::std::string{} : iter->second;
+    }
+public:
+    /** Set one option, overriding any previous value.
+     * @param name  Name of the option
+     * @param value Value of the option, parsed by the workload
+    **/
+    void set(::std::string const& name, ::std::string const& value) {
+        given[name] = value;
+    }
+    /** Get a positive count option.
+     * @param name     Name of the option
+     * @param fallback Default value
+     * @return Value of the option
+    **/
+    size_t count(char const* name, size_t fallback) {
+        auto value = lookup(name, fallback);
+        if (value.empty())
+            return fallback;
+        auto res = ::std::stoul(value);
+        if (unlikely(res == 0))
+            throw ::std::invalid_argument{::std::string{"option '"} + name + "' must be a positive count"};
+        return static_cast<size_t>(res);
+    }
+    /** Get a probability option.
+     * @param name     Name of the option
+     * @param fallback Default value
+     * @return Value of the option, between 0 and 1
+    **/
+    float probability(char const* name, float fallback) {
+        auto value = lookup(name, fallback);
+        if (value.empty())
+            return fallback;
+        auto res = ::std::stof(value);
+        if (unlikely(!(res >= 0.f && res <= 1.f)))
+            throw ::std::invalid_argument{::std::string{"option '"} + name + "' must be a probability between 0 and 1"};
+        return res;
+    }
+    /** Get a boolean option, given as 0 or 1.
+     * @param name     Name of the option
+     * @param fallback Default value
+     * @return Value of the option
+    **/
+    bool flag(char const* name, bool fallback) {
+        auto value = lookup(name, fallback ? 1 : 0);
+        if (value.empty())
+            return fallback;
+        if (unlikely(value != "0" && value != "1"))
+            throw ::std::invalid_argument{::std::string{"option '"} + name + "' must be 0 or 1"};
+        return value == "1";
+    }
+    /** Get an option among a fixed set of values.
+     * @param name     Name of the option
+     * @param fallback Default value
+     * @param allowed  Allowed values
+     * @return Value of the option, one of the allowed values
+    **/
+    ::std::string choice(char const* name, ::std::string const& fallback, ::std::vector<::std::string> const& allowed) {
+        auto value = lookup(name, fallback);
+        if (value.empty())
+            return fallback;
+        if (unlikely(::std::find(allowed.begin(), allowed.end(), value) == allowed.end())) {
+            ::std::string names;
+            for (auto const& entry: allowed)
+                names += (names.empty() ? "" : ", ") + entry;
+            throw ::std::invalid_argument{::std::string{"option '"} + name + "' must be one of " + names};
+        }
+        return value;
+    }
+    /** Get a free-form text option (e.g. a path).
+     * @param name     Name of the option
+     * @param fallback Default value
+     * @return Value of the option
+    **/
+    ::std::string text(char const* name, ::std::string const& fallback) {
+        auto value = lookup(name, fallback);
+        return value.empty() ? fallback : value;
+    }
+    /** Check that every given option was read by the workload.
+     * @param workload Name of the workload, for the error message
+    **/
+    void check_unused(::std::string const& workload) const {
+        for (auto const& entry: given) {
+            if (unlikely(read.count(entry.first) == 0))
+                throw ::std::invalid_argument{"workload '" + workload + "' has no option '" + entry.first + "'"};
+        }
+    }
+    /** Get the options read so far, with their value.
+     * @return Name and value of each option, in read order
+    **/
+    auto const& get_resolved() const noexcept {
+        return resolved;
+    }
+};
+
+/** Builder of a workload on a given library, its options already resolved.
+**/
+using WorkloadBuilder = ::std::function<::std::unique_ptr<Workload>(TransactionalLibrary const&)>;
+
+/** Registered workload.
+**/
+struct WorkloadEntry {
+    char const* name;        // Name, as given to '--workload'
+    char const* description; // One-line description
+    WorkloadBuilder (*prepare)(WorkloadSettings const&, WorkloadOptions&); // Resolve the options, and get the builder
+};
+
+/** Prepare a bank workload, of the chained or indexed variant.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+template<class Bank> static WorkloadBuilder prepare_bank(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbaccounts    = options.count("accounts", 32 * settings.nbworkers);
+    auto expnbaccounts = options.count("expected-accounts", 256 * settings.nbworkers);
+    auto init_balance  = static_cast<WorkloadBank::Balance>(options.count("init-balance", 100));
+    auto prob_long     = options.probability("prob-long", 0.5f);
+    auto prob_alloc    = options.probability("prob-alloc", 0.01f);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<Bank>(tl, settings.nbworkers, settings.nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc, settings.access, settings.arrival_rate);
+    };
+}
+
+/** Prepare a multi-account bank workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_multi_bank(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbaccounts    = options.count("accounts", 32 * settings.nbworkers);
+    auto expnbaccounts = options.count("expected-accounts", 256 * settings.nbworkers);
+    auto init_balance  = static_cast<WorkloadBank::Balance>(options.count("init-balance", 100));
+    auto prob_long     = options.probability("prob-long", 0.5f);
+    auto prob_alloc    = options.probability("prob-alloc", 0.01f);
+    auto width_min     = options.count("width-min", 1);
+    auto width_max     = options.count("width-max", WorkloadBank::max_width);
+    auto width_dist    = options.choice("width-dist", "uniform", {"uniform", "geometric"}) == "uniform" ? WorkloadBankMulti::Width::uniform : WorkloadBankMulti::Width::geometric;
+    if (unlikely(width_max > WorkloadBank::max_width || width_min > width_max))
+        throw ::std::invalid_argument{"options 'width-min' and 'width-max' must be ordered, and at most " + ::std::to_string(WorkloadBank::max_width)};
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadBankMulti>(tl, settings.nbworkers, settings.nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc, width_min, width_max, width_dist, settings.access, settings.arrival_rate);
+    };
+}
+
+/** Prepare a phase-changing bank workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_phases(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbaccounts    = options.count("accounts", 32 * settings.nbworkers);
+    auto expnbaccounts = options.count("expected-accounts", 256 * settings.nbworkers);
+    auto init_balance  = static_cast<WorkloadBank::Balance>(options.count("init-balance", 100));
+    auto mixes         = WorkloadPhases::parse_schedule(options.text("phases", "0.8/0.01/uniform+0.1/0.05/zipf:0.99"));
+    auto phase_ms      = options.count("phase-ms", 2000);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadPhases>(tl, settings.nbworkers, settings.nbtxperwrk, nbaccounts, expnbaccounts, init_balance, mixes, phase_ms, settings.arrival_rate);
+    };
+}
+
+/** Prepare a sorted linked-list set workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_linked_list(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto key_range   = options.count("key-range", 512);
+    auto prob_update = options.probability("update-ratio", 0.2f);
+    auto release     = options.flag("early-release", true);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadLinkedList>(tl, settings.nbworkers, settings.nbtxperwrk, key_range, prob_update, release, settings.access, settings.arrival_rate);
+    };
+}
+
+/** Prepare a producer/consumer queue workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_queue(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbinitial    = options.count("initial-items", 64);
+    auto prob_enqueue = options.probability("enqueue-ratio", 0.5f);
+    auto split        = options.flag("split-roles", false);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadQueue>(tl, settings.nbworkers, settings.nbtxperwrk, nbinitial, prob_enqueue, split, settings.arrival_rate);
+    };
+}
+
+/** Prepare a graph-analytics workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_graph(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbvertices   = options.count("vertices", 4096);
+    auto init_degree  = options.count("degree", 6);
+    auto max_degree   = options.count("max-degree", 16);
+    auto search_limit = options.count("search-limit", 512);
+    auto prob_update  = options.probability("update-ratio", 0.2f);
+    if (unlikely(nbvertices < 2 || max_degree < 1))
+        throw ::std::invalid_argument{"options 'vertices' and 'max-degree' must be at least 2 and 1"};
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadGraph>(tl, settings.nbworkers, settings.nbtxperwrk, nbvertices, max_degree, init_degree, search_limit, prob_update, settings.access, settings.arrival_rate);
+    };
+}
+
+/** Prepare a hash table workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_hash_map(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto key_range   = options.count("key-range", 4096);
+    auto nbbuckets   = options.count("buckets", 256);
+    auto prob_update = options.probability("update-ratio", 0.2f);
+    auto prob_resize = options.probability("resize-ratio", 0.0005f);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadHashMap>(tl, settings.nbworkers, settings.nbtxperwrk, key_range, nbbuckets, prob_update, prob_resize, settings.access, settings.arrival_rate);
+    };
+}
+
+/** Prepare a skip list set workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_skip_list(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto key_range   = options.count("key-range", 4096);
+    auto prob_update = options.probability("update-ratio", 0.2f);
+    auto prob_scan   = options.probability("scan-ratio", 0.1f);
+    auto scan_length = options.count("scan-length", 64);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadSkipList>(tl, settings.nbworkers, settings.nbtxperwrk, key_range, prob_update, prob_scan, scan_length, settings.access, settings.arrival_rate);
+    };
+}
+
+/** Prepare a k-means kernel.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_kmeans(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbclusters = options.count("clusters", 16);
+    auto nbdims     = options.count("dims", 32);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadKmeans>(tl, settings.nbworkers, settings.nbtxperwrk, nbclusters, nbdims, settings.arrival_rate);
+    };
+}
+
+/** Prepare a vacation kernel.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_vacation(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbrelations = options.count("relations", 4096);
+    auto nbqueries   = options.count("queries", 4);
+    auto query_ratio = options.probability("query-range", 0.6f);
+    auto prob_user   = options.probability("user-ratio", 0.9f);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadVacation>(tl, settings.nbworkers, settings.nbtxperwrk, nbrelations, nbqueries, query_ratio, prob_user, settings.arrival_rate);
+    };
+}
+
+/** Prepare an intruder kernel.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_intruder(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbflows     = options.count("flows", 256);
+    auto nbfragments = options.count("fragments", 8);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadIntruder>(tl, settings.nbworkers, settings.nbtxperwrk, nbflows, nbfragments, settings.arrival_rate);
+    };
+}
+
+/** Prepare a labyrinth kernel.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_labyrinth(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto side     = options.count("grid", 128);
+    auto distance = options.count("max-distance", 32);
+    auto maxpaths = options.count("paths", 16);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadLabyrinth>(tl, settings.nbworkers, settings.nbtxperwrk, side, distance, maxpaths, settings.arrival_rate);
+    };
+}
+
+/** Prepare a YCSB-style key-value store workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_kv(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto mix          = options.choice("mix", "a", {"a", "b", "c", "d", "e", "f"});
+    auto request      = options.choice("request", mix == "d" ? "latest" : "zipfian", {"uniform", "zipfian", "latest"});
+    auto nbrecords    = options.count("records", 10000);
+    auto capacity     = options.count("capacity", 2 * nbrecords);
+    auto nbfields     = options.count("fields", 10);
+    auto field_length = options.count("field-length", 100);
+    auto scan_length  = options.count("scan-length", 100);
+    if (unlikely(capacity < nbrecords))
+        throw ::std::invalid_argument{"option 'capacity' must be at least the number of records"};
+    auto kind = static_cast<WorkloadKV::Mix>(mix[0] - 'a');
+    auto dist = request == "uniform" ? WorkloadKV::Request::uniform : request == "zipfian" ? WorkloadKV::Request::zipfian : WorkloadKV::Request::latest;
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadKV>(tl, settings.nbworkers, settings.nbtxperwrk, kind, dist, nbrecords, capacity, nbfields, field_length, scan_length, settings.arrival_rate);
+    };
+}
+
+/** Prepare a large-record workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_records(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbrecords   = options.count("records", 256);
+    auto record_size = options.count("record-size", 4096);
+    auto align       = options.count("align", sizeof(void*));
+    auto prob_write  = options.probability("write-ratio", 0.5f);
+    auto view        = options.flag("view", false);
+    auto reserve     = options.flag("reserve", false);
+    if (unlikely((align & (align - 1)) != 0))
+        throw ::std::invalid_argument{"option 'align' must be a power of 2"};
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadRecords>(tl, settings.nbworkers, settings.nbtxperwrk, nbrecords, record_size, align, prob_write, view, reserve, settings.access, settings.arrival_rate);
+    };
+}
+
+/** Prepare an allocation-churn workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_churn(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbslots  = options.count("slots", 4096);
+    auto min_size = options.count("min-size", 16);
+    auto max_size = options.count("max-size", 16384);
+    auto batch    = options.count("batch", 2);
+    if (unlikely(max_size < min_size))
+        throw ::std::invalid_argument{"option 'max-size' must be at least 'min-size'"};
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadChurn>(tl, settings.nbworkers, settings.nbtxperwrk, nbslots, min_size, max_size, batch, settings.access, settings.arrival_rate);
+    };
+}
+
+/** Prepare a multi-region workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_regions(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbregions    = options.count("regions", 4);
+    auto nbaccounts   = options.count("accounts", 64);
+    auto init_balance = static_cast<WorkloadRegions::Balance>(options.count("init-balance", 100));
+    auto prob_audit   = options.probability("audit-ratio", 0.1f);
+    auto routing      = options.choice("routing", "pinned", {"pinned", "random"}) == "pinned" ? WorkloadRegions::Routing::pinned : WorkloadRegions::Routing::random;
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadRegions>(tl, settings.nbworkers, settings.nbtxperwrk, nbregions, nbaccounts, init_balance, prob_audit, routing, settings.access, settings.arrival_rate);
+    };
+}
+
+/** Prepare a big-memory workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_big_memory(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto size_mib     = options.count("size-mib", 256);
+    auto nbsegments   = options.count("segments", 16);
+    auto probe_length = options.count("probe-length", 8);
+    auto prob_probe   = options.probability("probe-ratio", 0.2f);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadBigMemory>(tl, settings.nbworkers, settings.nbtxperwrk, size_mib << 20, nbsegments, probe_length, prob_probe, settings.access, settings.arrival_rate);
+    };
+}
+
+/** Prepare a replay workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_replay(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto path  = options.text("trace", "");
+    auto think = options.flag("think", false);
+    if (unlikely(path.empty()))
+        throw ::std::invalid_argument{"option 'trace' must give the path of a trace file (see --record)"};
+    auto trace = ::std::make_shared<Trace const>(path);
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadReplay>(tl, settings.nbworkers, settings.nbtxperwrk, trace, think, settings.arrival_rate);
+    };
+}
+
+/** Prepare a multiplexed-clients workload.
+ * @param settings Common settings
+ * @param options  Options to resolve
+ * @return Builder of the workload
+**/
+static WorkloadBuilder prepare_clients(WorkloadSettings const& settings, WorkloadOptions& options) {
+    auto nbclients    = options.count("clients", 8);
+    auto nbaccounts   = options.count("accounts", 1024);
+    auto init_balance = static_cast<WorkloadClients::Balance>(options.count("init-balance", 100));
+    auto prob_audit   = options.probability("audit-ratio", 0.1f);
+    auto switching    = options.choice("switch", "abort", {"abort", "operation"}) == "operation" ? WorkloadClients::Switching::operation : WorkloadClients::Switching::abort;
+    if (unlikely(settings.arrival_rate > 0.))
+        throw ::std::invalid_argument{"workload 'clients' only runs in closed loop"};
+    return [=](TransactionalLibrary const& tl) -> ::std::unique_ptr<Workload> {
+        return ::std::make_unique<WorkloadClients>(tl, settings.nbworkers, settings.nbtxperwrk, nbclients, nbaccounts, init_balance, prob_audit, switching, settings.access);
+    };
+}
+
+/** Get the registered workloads.
+ * @return Registered workloads, the default one first
+**/
+static auto const& workload_registry() {
+    static ::std::vector<WorkloadEntry> const registry = {
+        {"bank", "Transfers between accounts found by walking the segment chain", prepare_bank<WorkloadBank>},
+        {"indexed", "Transfers between accounts found through a directory in the first segment", prepare_bank<WorkloadBankIndexed>},
+        {"summed", "Transfers between accounts of the segment chain, each segment header keeping the sum of its balances for audits reading only the headers", prepare_bank<WorkloadBankSummed>},
+        {"phases", "Bank transfers whose mix follows a schedule (phases, phase-ms), read-heavy then write-heavy and skewed by default, for --duration-ms runs", prepare_phases},
+        {"multi", "Transfers among 1 to 64 accounts found through the directory (width-min, width-max, width-dist), to sweep the write-set size", prepare_multi_bank},
+        {"linkedlist", "Lookups, insertions and removals of keys in a sorted linked list", prepare_linked_list},
+        {"queue", "Enqueues and dequeues of allocated nodes in a FIFO linked queue, its head and tail two hot words (split-roles for producers and consumers)", prepare_queue},
+        {"graph", "Edge additions and removals in a random graph, with read-only breadth-first searches from random roots (search-limit 0 for whole components)", prepare_graph},
+        {"hashmap", "Gets, puts and deletes of keys in a chained hash table, occasionally resized as a whole", prepare_hash_map},
+        {"skiplist", "Lookups, insertions, removals and range scans of keys in a skip list", prepare_skip_list},
+        {"kmeans", "Points accumulated into their nearest cluster (STAMP kmeans)", prepare_kmeans},
+        {"vacation", "Reservations, customer deletions and table updates of a travel system (STAMP vacation)", prepare_vacation},
+        {"intruder", "Fragments taken from a shared stream and reassembled into flows (STAMP intruder)", prepare_intruder},
+        {"labyrinth", "Shortest free paths routed and ripped up in a grid (STAMP labyrinth)", prepare_labyrinth},
+        {"kv", "Reads, updates, read-modify-writes, scans and insertions of records in a key-value store (YCSB A to F)", prepare_kv},
+        {"records", "Whole-record reads and copies of large records, each a single read or write call", prepare_records},
+        {"churn", "Allocations and frees of segments of mixed sizes in nearly every transaction", prepare_churn},
+        {"regions", "Transfers and audits in several independent regions, one per tenant", prepare_regions},
+        {"bigmem", "Transfers and probes at random over a region and segments of up to tens of gigabytes", prepare_big_memory},
+        {"replay", "Transactions of a trace file recorded with --record, replayed operation by operation", prepare_replay},
+        {"clients", "Transfers and audits of several logical clients per worker, each with a transaction in flight, interleaved", prepare_clients}
+    };
+    return registry;
+}
+
+/** Find a registered workload.
+ * @param name Name of the workload
+ * @return Registered workload
+**/
+static WorkloadEntry const& find_workload(::std::string const& name) {
+    for (auto const& entry: workload_registry()) {
+        if (name == entry.name)
+            return entry;
+    }
+    ::std::string names;
+    for (auto const& entry: workload_registry())
+        names += (names.empty() ? "" : ", ") + ::std::string{entry.name};
+    throw ::std::invalid_argument{"workload must be one of " + names};
+}
@@ -0,0 +1,265 @@
+/**
+ * @file   replay.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Replay workload: the transactions of a trace file (see '--record') issued
+ * again, operation by operation, one recorded thread per worker, so that
+ * traffic captured with one library can be run offline against others with
+ * the same mix of operations and the same number of concurrent threads.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "trace.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Replay workload class.
+ * Each worker replays the initialization of its recorded thread(s) in 'init', then cycles through their run transactions. Allocated segments
+ * are mapped from their recorded identifier once their transaction commits; an operation on a segment the replay does not hold (e.g. not
+ * allocated yet in this interleaving) is skipped and counted. Freed segments are only unmapped, and freed for real once the workers are
+ * quiescent, since a replayed transaction does not read the pointers that would make it abort on a concurrently freed segment.
+**/
+class WorkloadReplay final: public Workload {
+private:
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram ro_tx; // Read-only transactions
+        Histogram rw_tx; // Read-write transactions
+        size_t stream = 0; // Position of the next run transaction: index of the stream among the worker's ones
+        size_t next   = 0; // Position of the next run transaction: index of the transaction in the stream
+    };
+    /** Replayed segment.
+    **/
+    struct Segment {
+        uint8_t* base = nullptr; // Start address, 'nullptr' if not held
+        size_t   size = 0;       // Size (in bytes)
+    };
+private:
+    ::std::shared_ptr<Trace const> trace; // Trace to replay
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    bool   think;        // Whether to wait the recorded time between the transactions of a thread
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::atomic<size_t> entered; // Number of calls to 'init' so far, giving each worker its recorded threads
+    mutable ::std::atomic<uint_fast64_t> skipped; // Operations skipped so far
+    mutable ::std::shared_mutex table_lock; // Protects the mapped segments
+    mutable ::std::vector<Segment> table;   // Replayed segment of each recorded identifier
+    mutable ::std::mutex retired_lock;      // Protects the retired segments
+    mutable ::std::vector<void*> retired;   // Segments freed or replaced by the trace, to free once the workers are quiescent
+    mutable ::std::vector<double> skipped_samples; // Skipped operations over time, sampled by the first worker
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Replay workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param trace        Trace to replay, the shared memory being created with its alignment and first segment size
+     * @param think        Whether to wait the recorded time between the transactions of a thread
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadReplay(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, ::std::shared_ptr<Trace const> trace, bool think, double arrival_rate = 0.): Workload{library, trace->alignment, trace->first_size}, trace{trace}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, think{think}, arrival_rate{arrival_rate}, barrier(nbworkers), entered{0}, skipped{0}, table(1, Segment{reinterpret_cast<uint8_t*>(tm.get_start()), tm.get_size()}), states(nbworkers) {}
+private:
+    /** Get the recorded threads a worker replays: one each if there are enough workers, several in turn otherwise.
+     * @param index Index of the worker
+     * @return Indices of the recorded threads
+    **/
+    ::std::vector<size_t> streams_of(size_t index) const {
+        auto nbstreams = trace->streams.size();
+        if (nbstreams == 0)
+            return {};
+        if (nbworkers >= nbstreams)
+            return {index % nbstreams};
+        ::std::vector<size_t> res;
+        for (auto i = index; i < nbstreams; i += nbworkers)
+            res.push_back(i);
+        return res;
+    }
+    /** Resolve a recorded range to the replayed address.
+     * @param pending Segments allocated by the pending transaction, with their identifier
+     * @param op      Operation on the range
+     * @param size    Size of the range (in bytes)
+     * @return Replayed address, 'nullptr' if the segment is not held or the range does not fit in it
+    **/
+    void* resolve(::std::vector<::std::pair<uint64_t, Segment>> const& pending, Trace::Op const& op, size_t size) const {
+        Segment segment;
+        for (auto const& [id, allocated]: pending) {
+            if (id == op.segment)
+                segment = allocated;
+        }
+        if (!segment.base) {
+            ::std::shared_lock<::std::shared_mutex> guard{table_lock};
+            if (op.segment < table.size())
+                segment = table[op.segment];
+        }
+        if (unlikely(!segment.base || op.offset > segment.size || size > segment.size - op.offset))
+            return nullptr;
+        return segment.base + op.offset;
+    }
+    /** Replay one recorded transaction until it commits.
+     * @param stream Recorded thread of the transaction
+     * @param tx     Recorded transaction
+     * @param buffer Private buffer of the reads
+    **/
+    void replay_tx(Trace::Stream const& stream, Trace::Tx const& tx, ::std::vector<uint8_t>& buffer) const {
+        ::std::vector<::std::pair<uint64_t, Segment>> pending; // Segments allocated by the attempt
+        ::std::vector<uint64_t> freed; // Segments freed by the attempt
+        uint_fast64_t missed = 0;      // Operations skipped by the attempt
+        transactional(tm, tx.ro ? Transaction::Mode::read_only : Transaction::Mode::read_write, [&](Transaction& t) {
+            pending.clear();
+            freed.clear();
+            missed = 0;
+            for (auto i = tx.first; i < tx.last; ++i) {
+                auto const& op = stream.ops[i];
+                switch (op.kind) {
+                case TraceKind::alloc:
+                    pending.emplace_back(op.segment, Segment{reinterpret_cast<uint8_t*>(t.alloc(op.size)), op.size});
+                    continue;
+                case TraceKind::free:
+                    if (unlikely(!resolve(pending, op, 0))) {
+                        ++missed;
+                    } else {
+                        freed.push_back(op.segment);
+                    }
+                    continue;
+                default:
+                    break;
+                }
+                auto size = op.kind == TraceKind::add ? sizeof(int64_t) : op.size;
+                auto address = resolve(pending, op, size);
+                if (unlikely(!address)) {
+                    ++missed;
+                    continue;
+                }
+                switch (op.kind) {
+                case TraceKind::read:
+                    buffer.resize(size);
+                    t.read(address, size, buffer.data());
+                    break;
+                case TraceKind::update:
+                    buffer.resize(size);
+                    t.read_for_update(address, size, buffer.data());
+                    break;
+                case TraceKind::write:
+                    t.write(stream.bytes.data() + op.data, size, address);
+                    break;
+                case TraceKind::add:
+                    t.add(address, op.delta);
+                    break;
+                case TraceKind::release:
+                    t.release(address, size);
+                    break;
+                default:
+                    break;
+                }
+            }
+        });
+        if (missed > 0)
+            skipped.fetch_add(missed, ::std::memory_order_relaxed);
+        if (pending.empty() && freed.empty())
+            return;
+        ::std::unique_lock<::std::shared_mutex> guard{table_lock};
+        ::std::unique_lock<::std::mutex> retire{retired_lock};
+        for (auto const& [id, segment]: pending) {
+            if (id >= table.size())
+                table.resize(id + 1);
+            if (table[id].base) // Allocated again when cycling through the run transactions
+                retired.push_back(table[id].base);
+            table[id] = segment;
+        }
+        for (auto id: freed) {
+            if (id == 0 || id >= table.size() || !table[id].base)
+                continue;
+            retired.push_back(table[id].base);
+            table[id] = Segment{};
+        }
+    }
+public:
+    virtual char const* init() const {
+        auto index = entered.fetch_add(1, ::std::memory_order_relaxed) % nbworkers;
+        ::std::vector<uint8_t> buffer;
+        for (auto s: streams_of(index)) {
+            auto const& stream = trace->streams[s];
+            for (auto const& tx: stream.init)
+                replay_tx(stream, tx, buffer);
+        }
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        auto streams = streams_of(uid);
+        size_t total = 0;
+        for (auto s: streams)
+            total += trace->streams[s].run.size();
+        if (unlikely(total == 0)) // Nothing recorded to replay
+            return nullptr;
+        ::std::vector<uint8_t> buffer;
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            while (local.next >= trace->streams[streams[local.stream % streams.size()]].run.size()) { // Next recorded thread, cycling
+                local.stream = (local.stream + 1) % streams.size();
+                local.next = 0;
+            }
+            auto const& stream = trace->streams[streams[local.stream]];
+            auto const& tx = stream.run[local.next++];
+            if (think) {
+                auto until = ::std::chrono::steady_clock::now() + ::std::chrono::nanoseconds{tx.gap};
+                while (::std::chrono::steady_clock::now() < until)
+                    short_pause();
+            }
+            pacer.wait();
+            pacer.start();
+            replay_tx(stream, tx, buffer);
+            (tx.ro ? local.ro_tx : local.rw_tx).record(pacer.latency());
+        }
+        if (uid == 0)
+            skipped_samples.push_back(static_cast<double>(skipped.load(::std::memory_order_relaxed)));
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.ro_tx.merge(local.ro_tx);
+            res.rw_tx.merge(local.rw_tx);
+        }
+        return {{"read-only", res.ro_tx}, {"read-write", res.rw_tx}};
+    }
+    virtual ::std::vector<::std::pair<char const*, ::std::vector<double>>> get_series() const {
+        return {{"skipped operations", skipped_samples}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        barrier.sync(uid);
+        if (uid == 0) { // Retired segments freed while the other workers wait, before the counters overwrite the first words
+            for (auto segment: retired) {
+                transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                    tx.free(segment);
+                });
+            }
+            retired.clear();
+        }
+        return check_counters(uid, nbworkers, barrier);
+    }
+};
@@ -0,0 +1,333 @@
+/**
+ * @file   report.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Machine-readable results of the grading: one record per evaluated library
+ * (and number of worker threads), written as JSON or CSV. A record is a flat
+ * list of named fields, always the same ones in the same order, so that two
+ * outputs can be diffed and every CSV row has the same columns. The JSON
+ * written can be read back, e.g. to compare a run with a stored baseline.
+**/
+
+#pragma once
+
+// External headers
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// -------------------------------------------------------------------------- //
+
+/** Output format of the results.
+**/
+enum class Format {
+    text, // Decorated text, for humans
+    json, // One JSON document, the decorated text going to the standard error
+    csv   // One CSV row per record, the decorated text going to the standard error
+};
+
+/** Parse an output format.
+ * @param name Name of the format
+ * @return Output format
+**/
+static Format parse_format(::std::string const& name) {
+    if (name == "text")
+        return Format::text;
+    if (name == "json")
+        return Format::json;
+    if (name == "csv")
+        return Format::csv;
+    throw ::std::invalid_argument{"output format must be one of text, json or csv"};
+}
+
+/** Results of one evaluation, as named fields.
+**/
+class Record final {
+private:
+    /** One field, rendered for both formats.
+    **/
+    struct Field {
+        ::std::string key;  // Name of the field
+        ::std::string json; // JSON value
+        ::std::string csv;  // CSV cell
+    };
+    ::std::vector<Field> fields; // Fields, in insertion order
+private:
+    /** Render a number.
+     * @param value Number to render
+     * @return Text of the number, with all its significant digits
+    **/
+    template<class Type> static ::std::string render(Type value) {
+        ::std::ostringstream res;
+        res.precision(17);
+        res << value;
+        return res.str();
+    }
+    /** Quote a string for JSON.
+     * @param text String to quote
+     * @return JSON string literal
+    **/
+    static ::std::string quote_json(::std::string const& text) {
+        ::std::string res{"\""};
+        for (auto c: text) {
+            if (c == '"' || c == '\\') {
+                res.push_back('\\');
+                res.push_back(c);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char buffer[8];
+                ::std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned int>(c));
+                res += buffer;
+            } else {
+                res.push_back(c);
+            }
+        }
+        return res + "\"";
+    }
+    /** Quote a string for CSV, if needed.
+     * @param text String to quote
+     * @return CSV cell
+    **/
+    static ::std::string quote_csv(::std::string const& text) {
+        if (text.find_first_of(",\"\n") == ::std::string::npos)
+            return text;
+        ::std::string res{"\""};
+        for (auto c: text) {
+            if (c == '"')
+                res.push_back('"');
+            res.push_back(c);
+        }
+        return res + "\"";
+    }
+public:
+    /** Add a number.
+     * @param key   Name of the field
+     * @param value Value of the field
+    **/
+    template<class Type> void number(::std::string key, Type value) {
+        auto text = render(value);
+        fields.push_back({::std::move(key), text, text});
+    }
+    /** Add a string.
+     * @param key   Name of the field
+     * @param value Value of the field
+    **/
+    void text(::std::string key, ::std::string const& value) {
+        fields.push_back({::std::move(key), quote_json(value), quote_csv(value)});
+    }
+    /** Add a field without value (e.g. a statistic the library does not provide).
+     * @param key Name of the field
+    **/
+    void missing(::std::string key) {
+        fields.push_back({::std::move(key), "null", ""});
+    }
+    /** Add an array of numbers, its items separated by ';' in CSV.
+     * @param key    Name of the field
+     * @param values Values of the field, NaN items rendered as missing
+    **/
+    template<class Type> void array(::std::string key, ::std::vector<Type> const& values) {
+        ::std::string json{"["};
+        ::std::string csv;
+        for (size_t i = 0; i < values.size(); ++i) {
+            auto missing = ::std::isnan(static_cast<double>(values[i]));
+            auto text = missing ? ::std::string{} : render(values[i]);
+            json += (i > 0 ? ", " : "") + (missing ? ::std::string{"null"} : text);
+            csv += (i > 0 ? ";" : "") + text;
+        }
+        fields.push_back({::std::move(key), json + "]", csv});
+    }
+public:
+    /** Get the names of the fields.
+     * @return Name of each field, in insertion order
+    **/
+    ::std::vector<::std::string> get_keys() const {
+        ::std::vector<::std::string> res;
+        for (auto const& field: fields)
+            res.push_back(field.key);
+        return res;
+    }
+    /** Get the JSON value of a field.
+     * @param key Name of the field
+     * @return JSON value, null if the record has no such field
+    **/
+    ::std::string const* find(::std::string const& key) const {
+        for (auto const& field: fields) {
+            if (field.key == key)
+                return &field.json;
+        }
+        return nullptr;
+    }
+    /** Get a number field.
+     * @param key Name of the field
+     * @return Value of the field, NaN if absent or missing
+    **/
+    double get_number(::std::string const& key) const {
+        auto json = find(key);
+        return json != nullptr && *json != "null" ? ::std::strtod(json->c_str(), nullptr) : ::std::nan("");
+    }
+    /** Get a string field.
+     * @param key Name of the field
+     * @return Value of the field, empty if absent
+    **/
+    ::std::string get_text(::std::string const& key) const {
+        auto json = find(key);
+        if (json == nullptr || json->size() < 2 || json->front() != '"')
+            return {};
+        ::std::string res;
+        for (size_t i = 1; i + 1 < json->size(); ++i) {
+            if ((*json)[i] == '\\' && i + 2 < json->size()) {
+                ++i;
+                if ((*json)[i] == 'u') { // Only control characters are escaped that way
+                    res.push_back(static_cast<char>(::std::strtol(json->substr(i + 1, 4).c_str(), nullptr, 16)));
+                    i += 4;
+                    continue;
+                }
+            }
+            res.push_back((*json)[i]);
+        }
+        return res;
+    }
+    /** Get an array of numbers field.
+     * @param key Name of the field
+     * @return Values of the field, none if absent
+    **/
+    ::std::vector<double> get_array(::std::string const& key) const {
+        ::std::vector<double> res;
+        auto json = find(key);
+        if (json == nullptr || json->empty() || json->front() != '[')
+            return res;
+        auto cursor = json->c_str() + 1;
+        while (true) {
+            char* end;
+            auto value = ::std::strtod(cursor, &end);
+            if (end == cursor)
+                break;
+            res.push_back(value);
+            cursor = end;
+            while (*cursor == ',' || *cursor == ' ')
+                ++cursor;
+        }
+        return res;
+    }
+public:
+    /** Read the records of a JSON document written by 'write_json'.
+     * @param in Stream to read from
+     * @return Records read
+    **/
+    static ::std::vector<Record> read_json(::std::istream& in) {
+        ::std::string text{::std::istreambuf_iterator<char>{in}, ::std::istreambuf_iterator<char>{}};
+        size_t at = 0;
+        auto fail = []() {
+            throw ::std::invalid_argument{"malformed results document"};
+        };
+        auto skip = [&]() {
+            while (at < text.size() && (text[at] == ' ' || text[at] == '\n' || text[at] == '\r' || text[at] == '\t'))
+                ++at;
+        };
+        auto scan = [&]() { // One value, returned as written
+            skip();
+            auto start = at;
+            if (at < text.size() && text[at] == '"') {
+                for (++at; at < text.size() && text[at] != '"'; ++at) {
+                    if (text[at] == '\\')
+                        ++at;
+                }
+                ++at;
+            } else if (at < text.size() && text[at] == '[') {
+                at = text.find(']', at);
+                if (at == ::std::string::npos)
+                    fail();
+                ++at;
+            } else {
+                while (at < text.size() && text[at] != ',' && text[at] != '}' && text[at] != ']')
+                    ++at;
+            }
+            if (at > text.size() || at == start)
+                fail();
+            auto res = text.substr(start, at - start);
+            while (!res.empty() && (res.back() == ' ' || res.back() == '\n'))
+                res.pop_back();
+            return res;
+        };
+        ::std::vector<Record> res;
+        at = text.find('[');
+        if (at == ::std::string::npos)
+            fail();
+        ++at;
+        while (true) {
+            skip();
+            if (at < text.size() && text[at] == ']')
+                break;
+            if (at >= text.size() || text[at] != '{')
+                fail();
+            ++at;
+            Record record;
+            while (true) {
+                skip();
+                if (at < text.size() && text[at] == '}') {
+                    ++at;
+                    break;
+                }
+                auto key = scan();
+                skip();
+                if (key.size() < 2 || at >= text.size() || text[at] != ':')
+                    fail();
+                ++at;
+                auto value = scan();
+                record.fields.push_back({key.substr(1, key.size() - 2), value, {}});
+                skip();
+                if (at < text.size() && text[at] == ',')
+                    ++at;
+            }
+            res.push_back(::std::move(record));
+            skip();
+            if (at < text.size() && text[at] == ',')
+                ++at;
+        }
+        return res;
+    }
+    /** Write records as one JSON document.
+     * @param out     Stream to write to
+     * @param records Records to write
+    **/
+    static void write_json(::std::ostream& out, ::std::vector<Record> const& records) {
+        out << "{\"results\": [";
+        for (size_t i = 0; i < records.size(); ++i) {
+            out << (i > 0 ? ",\n  {" : "\n  {");
+            auto const& fields = records[i].fields;
+            for (size_t j = 0; j < fields.size(); ++j)
+                out << (j > 0 ? ", " : "") << quote_json(fields[j].key) << ": " << fields[j].json;
+            out << "}";
+        }
+        out << "\n]}" << ::std::endl;
+    }
+    /** Write records as CSV, with a header row taken from the first record.
+     * @param out     Stream to write to
+     * @param records Records to write
+    **/
+    static void write_csv(::std::ostream& out, ::std::vector<Record> const& records) {
+        if (records.empty())
+            return;
+        auto const& header = records.front().fields;
+        for (size_t j = 0; j < header.size(); ++j)
+            out << (j > 0 ? "," : "") << quote_csv(header[j].key);
+        out << ::std::endl;
+        for (auto const& record: records) {
+            for (size_t j = 0; j < record.fields.size(); ++j)
+                out << (j > 0 ? "," : "") << record.fields[j].csv;
+            out << ::std::endl;
+        }
+    }
+};
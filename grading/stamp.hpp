@@ -0,0 +1,1028 @@
+/**
+ * @file   stamp.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Application kernels in the spirit of the STAMP benchmark suite, on the
+ * workload interface: kmeans (short, contended accumulations), vacation
+ * (medium transactions over reservation tables and allocated customer
+ * lists), intruder (a contended fragment queue, then flow reassembly in a
+ * hash map) and labyrinth (long transactions reading a region of a grid and
+ * writing a path). The data structures are simplified (arrays and chained
+ * buckets instead of red-black trees), the transaction lengths and
+ * contention profiles are kept. Each kernel checks its own invariants.
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "distribution.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Offset of the kernel data in the first segment, after the two words of 'check_counters'.
+**/
+constexpr static size_t stamp_offset = 2 * sizeof(size_t);
+
+/** K-means kernel class.
+ * Each transaction adds one point to the accumulators of its nearest cluster, the nearest cluster being found outside of the transaction
+ * against fixed centers: short transactions, all the more contended that there are few clusters.
+**/
+class WorkloadKmeans final: public Workload {
+public:
+    /** Coordinate class alias.
+    **/
+    using Coord = int64_t;
+private:
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram assign_tx; // Accumulation transactions
+        ::std::vector<Coord> added; // What the worker added to each accumulator
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    size_t nbclusters;   // Number of clusters
+    size_t nbdims;       // Number of dimensions
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    ::std::vector<Coord> centers; // Center of each cluster, fixed
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** K-means kernel constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param nbclusters   Number of clusters
+     * @param nbdims       Number of dimensions
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadKmeans(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbclusters, size_t nbdims, double arrival_rate = 0.): Workload{library, alignof(Coord), stamp_offset + nbclusters * (nbdims + 1) * sizeof(Coord)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbclusters{nbclusters}, nbdims{nbdims}, arrival_rate{arrival_rate}, barrier(nbworkers), centers(nbclusters * nbdims), states(nbworkers) {
+        ::std::minstd_rand engine{static_cast<::std::minstd_rand::result_type>(nbclusters * nbdims)};
+        ::std::uniform_int_distribution<Coord> coord{0, 999};
+        for (auto& value: centers)
+            value = coord(engine);
+        for (auto& local: states)
+            local.added.assign(nbclusters * (nbdims + 1), 0);
+    }
+private:
+    /** Get the accumulators, for each cluster its point count then its coordinate sums.
+     * @param tx Associated pending transaction
+     * @return Accumulators
+    **/
+    Shared<Coord[]> accumulators(Transaction& tx) const {
+        return Shared<Coord[]>{tx, reinterpret_cast<uint8_t*>(tm.get_start()) + stamp_offset};
+    }
+    /** Accumulation transaction.
+     * @param cluster Cluster of the point
+     * @param point   Coordinates of the point
+    **/
+    void assign_tx(size_t cluster, Coord const* point) const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto accs = accumulators(tx);
+            auto first = cluster * (nbdims + 1);
+            thread_local ::std::vector<Coord> values;
+            values.resize(nbdims + 1);
+            accs.read_range(first, nbdims + 1, values.data());
+            accs[first] = values[0] + 1;
+            for (size_t i = 0; i < nbdims; ++i)
+                accs[first + 1 + i] = values[1 + i] + point[i];
+        });
+    }
+public:
+    virtual char const* init() const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto accs = accumulators(tx);
+            for (size_t i = 0; i < nbclusters * (nbdims + 1); ++i)
+                accs[i] = 0;
+        });
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            return accumulators(tx).read(0) == 0;
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::uniform_int_distribution<size_t> around{0, nbclusters - 1};
+        ::std::uniform_int_distribution<Coord> noise{-200, 200};
+        ::std::vector<Coord> point(nbdims);
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            // Draw a point around some center, then find its nearest center (outside of the transaction)
+            auto origin = around(engine);
+            for (size_t i = 0; i < nbdims; ++i)
+                point[i] = centers[origin * nbdims + i] + noise(engine);
+            size_t nearest = 0;
+            auto best = INT64_MAX;
+            for (size_t k = 0; k < nbclusters; ++k) {
+                Coord distance = 0;
+                for (size_t i = 0; i < nbdims; ++i) {
+                    auto delta = point[i] - centers[k * nbdims + i];
+                    distance += delta * delta;
+                }
+                if (distance < best) {
+                    best = distance;
+                    nearest = k;
+                }
+            }
+            pacer.start();
+            assign_tx(nearest, point.data());
+            local.assign_tx.record(pacer.latency());
+            local.added[nearest * (nbdims + 1)] += 1;
+            for (size_t i = 0; i < nbdims; ++i)
+                local.added[nearest * (nbdims + 1) + 1 + i] += point[i];
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        Histogram res;
+        for (auto const& local: states)
+            res.merge(local.assign_tx);
+        return {{"assign", res}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every point accumulated exactly once, before the counters overwrite the first words
+            ::std::vector<Coord> expected(nbclusters * (nbdims + 1), 0);
+            for (auto const& local: states) {
+                for (size_t i = 0; i < expected.size(); ++i)
+                    expected[i] += local.added[i];
+            }
+            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                ::std::vector<Coord> actual(expected.size());
+                accumulators(tx).read_range(0, actual.size(), actual.data());
+                return actual == expected;
+            });
+            if (unlikely(!correct))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Vacation kernel class.
+ * A travel reservation system: tables of cars, flights and rooms, and customers each with a list of reservations allocated in shared
+ * memory. Most transactions query a few resources and reserve the most expensive available of each kind; the others delete a customer
+ * (releasing its reservations) or update the tables.
+**/
+class WorkloadVacation final: public Workload {
+public:
+    /** Word class alias.
+    **/
+    using Word = int64_t;
+    /** Number of resource kinds (cars, flights, rooms).
+    **/
+    constexpr static size_t nbkinds = 3;
+private:
+    /** Shared reservation class.
+    **/
+    class Reservation final {
+    private:
+        /** Dummy structure for size and alignment retrieval.
+        **/
+        struct Dummy {
+            Word  dummy0;
+            Word  dummy1;
+            void* dummy2;
+        };
+    public:
+        /** Get the reservation size.
+         * @return Reservation size (in bytes)
+        **/
+        constexpr static auto size() noexcept {
+            return sizeof(Dummy);
+        }
+    public:
+        /** Private copy of the reservation, laid out as in shared memory.
+        **/
+        struct Header {
+            Word         resource; // Reserved resource (kind times the number of relations, plus its index)
+            Word         price;    // Price paid
+            Reservation* next;     // Next reservation of the customer, 'nullptr' for none
+        };
+        static_assert(sizeof(Header) == sizeof(Dummy), "Header does not match the reservation layout");
+    private:
+        Transaction& tx; // Associated pending transaction
+    public:
+        Shared<Word>           resource; // Reserved resource
+        Shared<Word>              price; // Price paid
+        Shared<Reservation*>       next; // Next reservation of the customer
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        Reservation(Reservation const&) = delete;
+        Reservation& operator=(Reservation const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Block base address
+        **/
+        Reservation(Transaction& tx, void* address): tx{tx}, resource{tx, address}, price{tx, resource.after()}, next{tx, price.after()} {}
+    public:
+        /** Read the whole reservation with a single transactional read.
+         * @return Private copy of the reservation
+        **/
+        Header header() const {
+            Header res;
+            tx.read(resource.get(), sizeof(Header), &res);
+            return res;
+        }
+    };
+    /** Private copy of a resource, laid out as in shared memory.
+    **/
+    struct Resource {
+        Word total; // Number of units
+        Word used;  // Number of reserved units
+        Word price; // Price of a unit
+    };
+    /** Private copy of a customer, laid out as in shared memory.
+    **/
+    struct Customer {
+        Word         bill; // Sum of the prices of the reservations
+        Reservation* list; // Reservations, 'nullptr' for none
+    };
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram delete_tx;  // Customer deletion transactions
+        Histogram update_tx;  // Table update transactions
+        Histogram reserve_tx; // Reservation transactions
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    size_t nbrelations;  // Number of resources of each kind, and of customers
+    size_t nbqueries;    // Number of resources queried per transaction
+    size_t query_range;  // Resources and customers queried among the first ones
+    float  prob_user;    // Probability of a reservation, instead of a deletion or an update (each equally likely)
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Vacation kernel constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param nbrelations  Number of resources of each kind, and of customers
+     * @param nbqueries    Number of resources queried per transaction
+     * @param query_ratio  Fraction of the resources and customers queried
+     * @param prob_user    Probability of a reservation, instead of a deletion or an update
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadVacation(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbrelations, size_t nbqueries, float query_ratio, float prob_user, double arrival_rate = 0.): Workload{library, alignof(Word), stamp_offset + nbkinds * nbrelations * sizeof(Resource) + nbrelations * sizeof(Customer)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbrelations{nbrelations}, nbqueries{nbqueries}, query_range{::std::max<size_t>(static_cast<size_t>(query_ratio * static_cast<float>(nbrelations)), 1)}, prob_user{prob_user}, arrival_rate{arrival_rate}, barrier(nbworkers), states(nbworkers) {}
+private:
+    /** Get the address of a resource.
+     * @param resource Resource (kind times the number of relations, plus its index)
+     * @return Address of the resource
+    **/
+    Word* resource_at(size_t resource) const noexcept {
+        return reinterpret_cast<Word*>(reinterpret_cast<uint8_t*>(tm.get_start()) + stamp_offset) + 3 * resource;
+    }
+    /** Get the address of a customer.
+     * @param customer Customer index
+     * @return Address of the customer
+    **/
+    Word* customer_at(size_t customer) const noexcept {
+        return resource_at(nbkinds * nbrelations) + 2 * customer;
+    }
+    /** Read a resource with a single transactional read.
+     * @param tx       Associated pending transaction
+     * @param resource Resource to read
+     * @return Private copy of the resource
+    **/
+    static Resource read_resource(Transaction& tx, Word* address) {
+        Resource res;
+        tx.read(address, sizeof(Resource), &res);
+        return res;
+    }
+    /** Reservation transaction.
+     * @param customer Customer making the reservations
+     * @param queries  Resources to query
+     * @return Number of reservations made
+    **/
+    size_t reserve_tx(size_t customer, ::std::vector<size_t> const& queries) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            size_t best[nbkinds];
+            Word prices[nbkinds];
+            for (size_t kind = 0; kind < nbkinds; ++kind)
+                prices[kind] = -1;
+            for (auto resource: queries) { // The most expensive available resource of each kind
+                auto current = read_resource(tx, resource_at(resource));
+                auto kind = resource / nbrelations;
+                if (current.used < current.total && current.price > prices[kind]) {
+                    prices[kind] = current.price;
+                    best[kind] = resource;
+                }
+            }
+            auto address = customer_at(customer);
+            Shared<Word> bill{tx, address};
+            Shared<Reservation*> list{tx, address + 1};
+            size_t count = 0;
+            for (size_t kind = 0; kind < nbkinds; ++kind) {
+                if (prices[kind] < 0)
+                    continue;
+                Shared<Word> used{tx, resource_at(best[kind]) + 1};
+                used = used.read() + 1;
+                auto fresh = reinterpret_cast<Reservation*>(tx.alloc(Reservation::size()));
+                Reservation reservation{tx, fresh};
+                reservation.resource = static_cast<Word>(best[kind]);
+                reservation.price = prices[kind];
+                reservation.next = list.read();
+                list = fresh;
+                bill = bill.read() + prices[kind];
+                ++count;
+            }
+            return count;
+        });
+    }
+    /** Customer deletion transaction, releasing its reservations.
+     * @param customer Customer to delete
+     * @return Whether the bill of the customer matched its reservations
+    **/
+    bool delete_tx(size_t customer) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto address = customer_at(customer);
+            Shared<Word> bill{tx, address};
+            Shared<Reservation*> list{tx, address + 1};
+            Word total = 0;
+            for (auto current = list.read(); current;) {
+                auto reservation = Reservation{tx, current}.header();
+                Shared<Word> used{tx, resource_at(static_cast<size_t>(reservation.resource)) + 1};
+                used = used.read() - 1;
+                total += reservation.price;
+                tx.free(current);
+                current = reservation.next;
+            }
+            auto correct = bill.read() == total;
+            bill = 0;
+            list = nullptr;
+            return correct;
+        });
+    }
+    /** Table update transaction, adding units at a new price or removing units not reserved.
+     * @param queries Resources to update
+     * @param adds    Whether to add units to each resource, or remove some
+     * @param prices  New price of each resource, if adding
+    **/
+    void update_tx(::std::vector<size_t> const& queries, ::std::vector<bool> const& adds, ::std::vector<Word> const& prices) const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                auto address = resource_at(queries[i]);
+                auto current = read_resource(tx, address);
+                if (adds[i]) {
+                    Shared<Word>{tx, address} = current.total + 100;
+                    Shared<Word>{tx, address + 2} = prices[i];
+                } else {
+                    Shared<Word>{tx, address} = ::std::max(current.used, current.total - 100);
+                }
+            }
+        });
+    }
+public:
+    virtual char const* init() const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            ::std::minstd_rand engine{static_cast<::std::minstd_rand::result_type>(nbrelations)};
+            for (size_t customer = 0; customer < nbrelations; ++customer) { // Reservations of a previous initialization, if any
+                auto address = customer_at(customer);
+                for (auto current = Shared<Reservation*>{tx, address + 1}.read(); current;) {
+                    auto next = Reservation{tx, current}.next.read();
+                    tx.free(current);
+                    current = next;
+                }
+                Shared<Word>{tx, address} = 0;
+                Shared<Reservation*>{tx, address + 1} = nullptr;
+            }
+            for (size_t resource = 0; resource < nbkinds * nbrelations; ++resource) {
+                auto address = resource_at(resource);
+                Shared<Word>{tx, address} = static_cast<Word>((engine() % 5 + 1) * 100);
+                Shared<Word>{tx, address + 1} = 0;
+                Shared<Word>{tx, address + 2} = static_cast<Word>((engine() % 5) * 10 + 50);
+            }
+        });
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            return read_resource(tx, resource_at(0)).total >= 100;
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::bernoulli_distribution user_dist{prob_user};
+        ::std::bernoulli_distribution coin{0.5};
+        ::std::uniform_int_distribution<size_t> kind_dist{0, nbkinds - 1};
+        ::std::uniform_int_distribution<size_t> id_dist{0, query_range - 1};
+        ::std::uniform_int_distribution<Word> price_dist{50, 549};
+        ::std::vector<size_t> queries(nbqueries);
+        ::std::vector<bool> adds(nbqueries);
+        ::std::vector<Word> prices(nbqueries);
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            for (auto& query: queries)
+                query = kind_dist(engine) * nbrelations + id_dist(engine);
+            if (user_dist(engine)) { // Make reservations
+                auto customer = id_dist(engine);
+                pacer.start();
+                reserve_tx(customer, queries);
+                local.reserve_tx.record(pacer.latency());
+            } else if (coin(engine)) { // Delete a customer
+                auto customer = id_dist(engine);
+                pacer.start();
+                auto consistent = delete_tx(customer);
+                local.delete_tx.record(pacer.latency());
+                if (unlikely(!consistent))
+                    return "Violated isolation or atomicity";
+            } else { // Update the tables
+                for (size_t i = 0; i < nbqueries; ++i) {
+                    adds[i] = coin(engine);
+                    prices[i] = price_dist(engine);
+                }
+                pacer.start();
+                update_tx(queries, adds, prices);
+                local.update_tx.record(pacer.latency());
+            }
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.delete_tx.merge(local.delete_tx);
+            res.update_tx.merge(local.update_tx);
+            res.reserve_tx.merge(local.reserve_tx);
+        }
+        return {{"delete", res.delete_tx}, {"update", res.update_tx}, {"reserve", res.reserve_tx}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every bill matches the reservations of its customer, every resource its reservations, before the counters overwrite the first words
+            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                ::std::vector<Word> reserved(nbkinds * nbrelations, 0);
+                for (size_t customer = 0; customer < nbrelations; ++customer) {
+                    auto address = customer_at(customer);
+                    Word total = 0;
+                    for (auto current = Shared<Reservation*>{tx, address + 1}.read(); current;) {
+                        auto reservation = Reservation{tx, current}.header();
+                        if (unlikely(reservation.resource < 0 || static_cast<size_t>(reservation.resource) >= reserved.size()))
+                            return false;
+                        ++reserved[static_cast<size_t>(reservation.resource)];
+                        total += reservation.price;
+                        current = reservation.next;
+                    }
+                    if (unlikely((Shared<Word>{tx, address}.read() != total)))
+                        return false;
+                }
+                for (size_t resource = 0; resource < reserved.size(); ++resource) {
+                    auto current = read_resource(tx, resource_at(resource));
+                    if (unlikely(current.used != reserved[resource] || current.used > current.total))
+                        return false;
+                }
+                return true;
+            });
+            if (unlikely(!correct))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Intruder kernel class.
+ * A network intrusion detector: each worker takes the next fragment from a shared stream (a short transaction on one contended counter),
+ * adds it to its flow in a hash map of partially reassembled flows (allocating the flow on its first fragment, freeing it on its last),
+ * then scans the completed flows for an attack signature outside of the transactions.
+**/
+class WorkloadIntruder final: public Workload {
+public:
+    /** Word class alias.
+    **/
+    using Word = uint64_t;
+    /** Number of buckets of the map of the flows.
+    **/
+    constexpr static size_t nbbuckets = 1024;
+private:
+    /** Shared flow class.
+    **/
+    class Flow final {
+    private:
+        /** Dummy structure for size and alignment retrieval.
+        **/
+        struct Dummy {
+            Word  dummy0;
+            Word  dummy1;
+            Word  dummy2;
+            void* dummy3;
+        };
+    public:
+        /** Get the flow size.
+         * @return Flow size (in bytes)
+        **/
+        constexpr static auto size() noexcept {
+            return sizeof(Dummy);
+        }
+    public:
+        /** Private copy of the flow, laid out as in shared memory.
+        **/
+        struct Header {
+            Word  id;       // Flow identifier
+            Word  received; // Number of fragments received
+            Word  checksum; // Sum of the payloads received
+            Flow* next;     // Next flow in the bucket, 'nullptr' for none
+        };
+        static_assert(sizeof(Header) == sizeof(Dummy), "Header does not match the flow layout");
+    private:
+        Transaction& tx; // Associated pending transaction
+    public:
+        Shared<Word>        id; // Flow identifier
+        Shared<Word>  received; // Number of fragments received
+        Shared<Word>  checksum; // Sum of the payloads received
+        Shared<Flow*>     next; // Next flow in the bucket
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        Flow(Flow const&) = delete;
+        Flow& operator=(Flow const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Block base address
+        **/
+        Flow(Transaction& tx, void* address): tx{tx}, id{tx, address}, received{tx, id.after()}, checksum{tx, received.after()}, next{tx, checksum.after()} {}
+    public:
+        /** Read the whole flow with a single transactional read.
+         * @return Private copy of the flow
+        **/
+        Header header() const {
+            Header res;
+            tx.read(id.get(), sizeof(Header), &res);
+            return res;
+        }
+    };
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram pop_tx;        // Stream transactions
+        Histogram reassemble_tx; // Reassembly transactions
+        uint_fast64_t attacks = 0; // Attacks detected in the flows completed by the worker
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of fragments per worker, 0 for as many as possible until asked to stop
+    size_t nbflows;      // Number of flows interleaved in the stream
+    size_t nbfragments;  // Number of fragments per flow
+    double arrival_rate; // Aggregate arrival rate of the fragments (in fragments/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Intruder kernel constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of fragments per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param nbflows      Number of flows interleaved in the stream
+     * @param nbfragments  Number of fragments per flow
+     * @param arrival_rate Aggregate arrival rate of the fragments (in fragments/s), 0 for closed-loop workers
+    **/
+    WorkloadIntruder(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbflows, size_t nbfragments, double arrival_rate = 0.): Workload{library, alignof(Word), stamp_offset + 2 * sizeof(Word) + nbbuckets * sizeof(Flow*)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbflows{nbflows}, nbfragments{nbfragments}, arrival_rate{arrival_rate}, barrier(nbworkers), states(nbworkers) {}
+private:
+    /** Get the stream position, i.e. the number of fragments taken so far.
+     * @param tx Associated pending transaction
+     * @return Stream position
+    **/
+    Shared<Word> stream(Transaction& tx) const {
+        return Shared<Word>{tx, reinterpret_cast<uint8_t*>(tm.get_start()) + stamp_offset};
+    }
+    /** Get the number of completed flows.
+     * @param tx Associated pending transaction
+     * @return Number of completed flows
+    **/
+    Shared<Word> completed(Transaction& tx) const {
+        return Shared<Word>{tx, stream(tx).after()};
+    }
+    /** Get the buckets of the map of the flows.
+     * @param tx Associated pending transaction
+     * @return Head of each bucket
+    **/
+    Shared<Flow*[]> buckets(Transaction& tx) const {
+        return Shared<Flow*[]>{tx, completed(tx).after()};
+    }
+    /** Get the fragment at a position of the stream, the flows of each block of the stream interleaved.
+     * @param position Stream position
+     * @return Flow identifier and fragment index
+    **/
+    ::std::pair<Word, Word> fragment_at(Word position) const noexcept {
+        Word block = nbflows * nbfragments;
+        Word stride = block / 2 + 1;
+        while (::std::gcd(stride, block) != 1)
+            ++stride;
+        auto shuffled = (position % block) * stride % block;
+        return {position / block * nbflows + shuffled / nbfragments, shuffled % nbfragments};
+    }
+    /** Get the payload of a fragment.
+     * @param flow     Flow identifier
+     * @param fragment Fragment index
+     * @return Payload
+    **/
+    static Word payload_of(Word flow, Word fragment) noexcept {
+        auto res = (flow * 0x9e3779b97f4a7c15ull) ^ (fragment * 0xbf58476d1ce4e5b9ull);
+        res ^= res >> 31;
+        return res * 0x94d049bb133111ebull;
+    }
+    /** Stream transaction, taking the next fragment.
+     * @return Stream position of the fragment
+    **/
+    Word pop_tx() const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto position = stream(tx);
+            auto res = position.read();
+            position = res + 1;
+            return res;
+        });
+    }
+    /** Reassembly transaction, adding a fragment to its flow.
+     * @param flow    Flow identifier
+     * @param payload Payload of the fragment
+     * @return Checksum of the flow if completed by this fragment
+    **/
+    ::std::optional<Word> reassemble_tx(Word flow, Word payload) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) -> ::std::optional<Word> {
+            auto link = buckets(tx)[flow % nbbuckets].get();
+            auto current = Shared<Flow*>{tx, link}.read();
+            Flow::Header header{};
+            while (current) {
+                Flow node{tx, current};
+                header = node.header();
+                if (header.id == flow)
+                    break;
+                link = node.next.get();
+                current = header.next;
+            }
+            if (!current) { // First fragment
+                if (nbfragments == 1) {
+                    auto done = completed(tx);
+                    done = done.read() + 1;
+                    return payload;
+                }
+                auto fresh = reinterpret_cast<Flow*>(tx.alloc(Flow::size()));
+                Flow node{tx, fresh};
+                node.id = flow;
+                node.received = 1;
+                node.checksum = payload;
+                node.next = nullptr;
+                Shared<Flow*>{tx, link} = fresh; // Appended at the end of the bucket
+                return ::std::nullopt;
+            }
+            Flow node{tx, current};
+            if (header.received + 1 < nbfragments) { // Not complete yet
+                node.received = header.received + 1;
+                node.checksum = header.checksum + payload;
+                return ::std::nullopt;
+            }
+            // Last fragment
+            Shared<Flow*>{tx, link} = header.next;
+            tx.free(current);
+            auto done = completed(tx);
+            done = done.read() + 1;
+            return header.checksum + payload;
+        });
+    }
+public:
+    virtual char const* init() const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto heads = buckets(tx);
+            for (size_t i = 0; i < nbbuckets; ++i) { // Flows of a previous initialization, if any
+                for (auto current = heads.read(i); current;) {
+                    auto next = Flow{tx, current}.next.read();
+                    tx.free(current);
+                    current = next;
+                }
+                heads[i] = nullptr;
+            }
+            stream(tx) = 0;
+            completed(tx) = 0;
+        });
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            return stream(tx).read() == 0 && buckets(tx).read(0) == nullptr;
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            pacer.start();
+            auto position = pop_tx();
+            local.pop_tx.record(pacer.attempt());
+            auto [flow, fragment] = fragment_at(position);
+            pacer.start();
+            auto checksum = reassemble_tx(flow, payload_of(flow, fragment));
+            local.reassemble_tx.record(pacer.latency());
+            if (!checksum)
+                continue;
+            // Rebuild and scan the completed flow, outside of the transactions
+            Word expected = 0;
+            Word signature = 0;
+            for (Word i = 0; i < nbfragments; ++i) {
+                auto payload = payload_of(flow, i);
+                expected += payload;
+                signature = (signature ^ payload) * 0x100000001b3ull;
+            }
+            if (unlikely(*checksum != expected))
+                return "Violated isolation or atomicity";
+            if ((signature & 0xff) == 0)
+                ++local.attacks;
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.pop_tx.merge(local.pop_tx);
+            res.reassemble_tx.merge(local.reassemble_tx);
+        }
+        return {{"pop", res.pop_tx}, {"reassemble", res.reassemble_tx}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every fragment taken exactly once and reassembled, before the counters overwrite the first words
+            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                Word pending = 0;
+                auto heads = buckets(tx);
+                for (size_t i = 0; i < nbbuckets; ++i) {
+                    for (auto current = heads.read(i); current;) {
+                        auto header = Flow{tx, current}.header();
+                        if (unlikely(header.received == 0 || header.received >= nbfragments || header.id % nbbuckets != i))
+                            return false;
+                        pending += header.received;
+                        current = header.next;
+                    }
+                }
+                return stream(tx).read() == completed(tx).read() * nbfragments + pending;
+            });
+            if (unlikely(!correct))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Labyrinth kernel class.
+ * A maze router: each transaction reads the region of a grid around two random points, finds a shortest free path between them
+ * (breadth-first, outside of any shared access) and claims its cells; long transactions with large read sets. To keep running, each
+ * worker rips up its oldest path once it holds enough of them, checking that its cells were not claimed by another path meanwhile.
+**/
+class WorkloadLabyrinth final: public Workload {
+public:
+    /** Cell class alias, 0 for free, else the identifier of the path.
+    **/
+    using Cell = uint64_t;
+private:
+    /** Routed path.
+    **/
+    struct Path {
+        Cell id; // Identifier of the path
+        ::std::vector<size_t> cells; // Index of each cell of the path
+    };
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram ripup_tx; // Rip-up transactions
+        Histogram route_tx; // Routing transactions
+        ::std::deque<Path> paths; // Paths held, oldest first
+        Cell sequence = 0; // Number of paths routed so far
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    size_t side;         // Side of the square grid
+    size_t distance;     // Maximum distance between the two ends of a path, along each axis
+    size_t margin;       // Margin around the two ends of the region read
+    size_t maxpaths;     // Number of paths held by a worker before it rips up its oldest
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Labyrinth kernel constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param side         Side of the square grid
+     * @param distance     Maximum distance between the two ends of a path, along each axis
+     * @param maxpaths     Number of paths held by a worker before it rips up its oldest
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadLabyrinth(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t side, size_t distance, size_t maxpaths, double arrival_rate = 0.): Workload{library, alignof(Cell), stamp_offset + side * side * sizeof(Cell)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, side{side}, distance{::std::min(distance, side - 1)}, margin{4}, maxpaths{maxpaths}, arrival_rate{arrival_rate}, barrier(nbworkers), states(nbworkers) {}
+private:
+    /** Get the grid, row after row.
+     * @param tx Associated pending transaction
+     * @return Grid cells
+    **/
+    Shared<Cell[]> grid(Transaction& tx) const {
+        return Shared<Cell[]>{tx, reinterpret_cast<uint8_t*>(tm.get_start()) + stamp_offset};
+    }
+    /** Routing transaction.
+     * @param id     Identifier of the path
+     * @param source First end of the path
+     * @param target Last end of the path
+     * @param cells  Set to the cells of the path, if routed
+     * @return Whether a free path was found
+    **/
+    bool route_tx(Cell id, size_t source, size_t target, ::std::vector<size_t>& cells) const {
+        auto sx = source % side, sy = source / side, tx_ = target % side, ty = target / side;
+        auto x0 = ::std::min(sx, tx_) >= margin ? ::std::min(sx, tx_) - margin : 0;
+        auto y0 = ::std::min(sy, ty) >= margin ? ::std::min(sy, ty) - margin : 0;
+        auto x1 = ::std::min(::std::max(sx, tx_) + margin, side - 1);
+        auto y1 = ::std::min(::std::max(sy, ty) + margin, side - 1);
+        auto width = x1 - x0 + 1, height = y1 - y0 + 1;
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto cells_shared = grid(tx);
+            thread_local ::std::vector<Cell> region;
+            thread_local ::std::vector<size_t> parents;
+            region.resize(width * height);
+            for (size_t y = 0; y < height; ++y) // Private copy of the region
+                cells_shared.read_range((y0 + y) * side + x0, width, region.data() + y * width);
+            auto local = [&](size_t cell) { return (cell / side - y0) * width + (cell % side - x0); };
+            auto global = [&](size_t cell) { return (y0 + cell / width) * side + x0 + cell % width; };
+            auto from = local(source), to = local(target);
+            if (region[from] != 0 || region[to] != 0)
+                return false;
+            // Breadth-first expansion from the source
+            constexpr auto unvisited = SIZE_MAX;
+            parents.assign(width * height, unvisited);
+            ::std::queue<size_t> frontier;
+            parents[from] = from;
+            frontier.push(from);
+            while (!frontier.empty() && parents[to] == unvisited) {
+                auto cell = frontier.front();
+                frontier.pop();
+                auto x = cell % width, y = cell / width;
+                size_t neighbors[4];
+                size_t count = 0;
+                if (x > 0)
+                    neighbors[count++] = cell - 1;
+                if (x + 1 < width)
+                    neighbors[count++] = cell + 1;
+                if (y > 0)
+                    neighbors[count++] = cell - width;
+                if (y + 1 < height)
+                    neighbors[count++] = cell + width;
+                for (size_t i = 0; i < count; ++i) {
+                    auto next = neighbors[i];
+                    if (parents[next] == unvisited && region[next] == 0) {
+                        parents[next] = cell;
+                        frontier.push(next);
+                    }
+                }
+            }
+            if (parents[to] == unvisited)
+                return false;
+            // Claim the cells of the path, from the target back to the source
+            cells.clear();
+            for (auto cell = to;; cell = parents[cell]) {
+                cells.push_back(global(cell));
+                cells_shared[global(cell)] = id;
+                if (cell == from)
+                    break;
+            }
+            return true;
+        });
+    }
+    /** Rip-up transaction, freeing the cells of a path.
+     * @param path Path to rip up
+     * @return Whether every cell of the path was still claimed by it
+    **/
+    bool ripup_tx(Path const& path) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto cells = grid(tx);
+            for (auto cell: path.cells) {
+                if (unlikely(cells.read(cell) != path.id))
+                    return false;
+                cells[cell] = 0;
+            }
+            return true;
+        });
+    }
+public:
+    virtual char const* init() const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto cells = grid(tx);
+            for (size_t i = 0; i < side * side; ++i)
+                cells[i] = 0;
+        });
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            return grid(tx).read(side * side - 1) == 0;
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::uniform_int_distribution<size_t> coord{0, side - 1};
+        ::std::uniform_int_distribution<size_t> offset{0, 2 * distance};
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            if (local.paths.size() >= maxpaths) { // Rip up the oldest path
+                pacer.start();
+                auto consistent = ripup_tx(local.paths.front());
+                local.ripup_tx.record(pacer.latency());
+                if (unlikely(!consistent))
+                    return "Violated isolation or atomicity";
+                local.paths.pop_front();
+                continue;
+            }
+            // Route a new path between two points close enough
+            auto sx = coord(engine), sy = coord(engine);
+            auto shift = [&](size_t value) { // Within 'distance' and the grid
+                auto res = static_cast<ptrdiff_t>(value) + static_cast<ptrdiff_t>(offset(engine)) - static_cast<ptrdiff_t>(distance);
+                return static_cast<size_t>(::std::clamp<ptrdiff_t>(res, 0, static_cast<ptrdiff_t>(side) - 1));
+            };
+            auto tx_ = shift(sx), ty = shift(sy);
+            if (tx_ == sx && ty == sy)
+                tx_ = sx > 0 ? sx - 1 : sx + 1;
+            Path path{(static_cast<Cell>(uid) + 1) << 40 | ++local.sequence, {}};
+            pacer.start();
+            auto routed = route_tx(path.id, sy * side + sx, ty * side + tx_, path.cells);
+            local.route_tx.record(pacer.latency());
+            if (routed)
+                local.paths.push_back(::std::move(path));
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.ripup_tx.merge(local.ripup_tx);
+            res.route_tx.merge(local.route_tx);
+        }
+        return {{"ripup", res.ripup_tx}, {"route", res.route_tx}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every claimed cell belongs to exactly one held path, before the counters overwrite the first words
+            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                ::std::vector<Cell> cells(side * side);
+                grid(tx).read_range(0, cells.size(), cells.data());
+                size_t claimed = 0;
+                for (auto cell: cells) {
+                    if (cell != 0)
+                        ++claimed;
+                }
+                size_t held = 0;
+                for (auto const& local: states) {
+                    for (auto const& path: local.paths) {
+                        for (auto cell: path.cells) {
+                            if (unlikely(cells[cell] != path.id))
+                                return false;
+                        }
+                        held += path.cells.size();
+                    }
+                }
+                return claimed == held;
+            });
+            if (unlikely(!correct))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
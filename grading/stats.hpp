@@ -0,0 +1,177 @@
+/**
+ * @file   stats.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Spread of the repeated time measurements: median, coefficient of variation
+ * and percentile bootstrap confidence intervals, for the median of one
+ * library and for the speedup between two libraries (ratio of their medians,
+ * or median of the ratios of paired repetitions when interleaved). The
+ * bootstrap makes no assumption on the distribution of the times, which is
+ * usually skewed by the occasional preemption or frequency change. For the
+ * same reason, two runs are compared with a rank test (Mann-Whitney U).
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Bootstrap parameters.
+**/
+constexpr static size_t bootstrap_resamples = 2000; // Number of resamples per interval
+constexpr static double bootstrap_level     = 0.95; // Confidence level of the intervals
+
+/** Spread of repeated measurements.
+**/
+struct Spread {
+    double median; // Median
+    double low;    // Lower bound of the confidence interval of the median
+    double high;   // Upper bound of the confidence interval of the median
+    double cv;     // Coefficient of variation (standard deviation over mean)
+};
+
+/** Get the median of some values, the upper one for an even count.
+ * @param values Values to consider, reordered, non-empty
+ * @return Median value
+**/
+template<class Type> static Type median_of(::std::vector<Type>& values) {
+    auto middle = values.begin() + values.size() / 2;
+    ::std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+/** Resample some measurements with replacement, and get the median of the resample.
+ * @param times   Measurements to resample, non-empty
+ * @param engine  Random engine to use
+ * @param scratch Scratch space, resized as needed
+ * @return Median of the resample
+**/
+template<class Type> static double resampled_median(::std::vector<Type> const& times, ::std::mt19937_64& engine, ::std::vector<Type>& scratch) {
+    ::std::uniform_int_distribution<size_t> pick{0, times.size() - 1};
+    scratch.resize(times.size());
+    for (auto& time: scratch)
+        time = times[pick(engine)];
+    return static_cast<double>(median_of(scratch));
+}
+
+/** Get the two-sided percentile interval of bootstrap estimates.
+ * @param estimates Bootstrap estimates, reordered
+ * @return Lower and upper bounds
+**/
+static ::std::pair<double, double> percentile_interval(::std::vector<double>& estimates) {
+    ::std::sort(estimates.begin(), estimates.end());
+    auto tail = (1. - bootstrap_level) / 2.;
+    auto last = static_cast<double>(estimates.size() - 1);
+    return {estimates[static_cast<size_t>(::std::floor(tail * last))], estimates[static_cast<size_t>(::std::ceil((1. - tail) * last))]};
+}
+
+/** Compute the spread of repeated measurements, deterministically.
+ * @param times Measurements, non-empty
+ * @return Spread of the measurements
+**/
+template<class Type> static Spread spread_of(::std::vector<Type> const& times) {
+    Spread res;
+    { // Median
+        auto sorted = times;
+        res.median = static_cast<double>(median_of(sorted));
+    }
+    { // Coefficient of variation
+        auto sum = 0.;
+        for (auto time: times)
+            sum += static_cast<double>(time);
+        auto mean = sum / static_cast<double>(times.size());
+        auto var = 0.;
+        for (auto time: times)
+            var += (static_cast<double>(time) - mean) * (static_cast<double>(time) - mean);
+        res.cv = times.size() > 1 ? ::std::sqrt(var / static_cast<double>(times.size() - 1)) / mean : 0.;
+    }
+    { // Confidence interval of the median
+        ::std::mt19937_64 engine{times.size()};
+        ::std::vector<Type> scratch;
+        ::std::vector<double> estimates(bootstrap_resamples);
+        for (auto& estimate: estimates)
+            estimate = resampled_median(times, engine, scratch);
+        ::std::tie(res.low, res.high) = percentile_interval(estimates);
+    }
+    return res;
+}
+
+/** Compute the confidence interval of the speedup of a library over the reference, deterministically.
+ * @param reference Measurements of the reference (in ns), non-empty
+ * @param times     Measurements of the library (in ns), non-empty
+ * @return Lower and upper bounds of the ratio of the reference median over the library median
+**/
+static ::std::pair<double, double> speedup_interval(::std::vector<Chrono::Tick> const& reference, ::std::vector<Chrono::Tick> const& times) {
+    ::std::mt19937_64 engine{reference.size() * times.size()};
+    ::std::vector<Chrono::Tick> scratch;
+    ::std::vector<double> estimates(bootstrap_resamples);
+    for (auto& estimate: estimates) {
+        auto numerator = resampled_median(reference, engine, scratch);
+        estimate = numerator / resampled_median(times, engine, scratch);
+    }
+    return percentile_interval(estimates);
+}
+
+/** Compute the speedup of a library over the reference from paired measurements, deterministically.
+ * @param reference Measurements of the reference (in ns), non-empty
+ * @param times     Measurements of the library, each one paired with the reference one of same index (in ns), non-empty
+ * @return Spread of the ratios of the reference measurement over the paired library one, the extra measurements of either unpaired
+**/
+static Spread paired_speedup(::std::vector<Chrono::Tick> const& reference, ::std::vector<Chrono::Tick> const& times) {
+    ::std::vector<double> ratios;
+    for (size_t i = 0; i < reference.size() && i < times.size(); ++i)
+        ratios.push_back(static_cast<double>(reference[i]) / static_cast<double>(times[i]));
+    return spread_of(ratios);
+}
+
+/** Compute the two-sided p-value of the Mann-Whitney U test, with the normal approximation (corrected for ties and continuity).
+ * @param first  Measurements of one run, non-empty
+ * @param second Measurements of the other run, non-empty
+ * @return Probability of ranks at least that far apart if both runs had the same distribution
+**/
+template<class Type> static double mann_whitney(::std::vector<Type> const& first, ::std::vector<Type> const& second) {
+    ::std::vector<::std::pair<Type, bool>> pooled; // Measurement, whether from the first run
+    for (auto value: first)
+        pooled.emplace_back(value, true);
+    for (auto value: second)
+        pooled.emplace_back(value, false);
+    ::std::sort(pooled.begin(), pooled.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+    auto n1 = static_cast<double>(first.size());
+    auto n2 = static_cast<double>(second.size());
+    auto n = n1 + n2;
+    auto ranks = 0.; // Sum of the ranks of the first run, ties sharing their average rank
+    auto ties = 0.;  // Sum of t^3 - t over the groups of t tied measurements
+    for (size_t i = 0; i < pooled.size();) {
+        auto j = i;
+        while (j < pooled.size() && !(pooled[i].first < pooled[j].first))
+            ++j;
+        auto t = static_cast<double>(j - i);
+        auto rank = static_cast<double>(i + j + 1) / 2.;
+        for (auto k = i; k < j; ++k)
+            ranks += pooled[k].second ? rank : 0.;
+        ties += t * t * t - t;
+        i = j;
+    }
+    auto u = ranks - n1 * (n1 + 1.) / 2.;
+    auto sigma = ::std::sqrt(n1 * n2 / 12. * ((n + 1.) - ties / (n * (n - 1.))));
+    if (!(sigma > 0.))
+        return 1.;
+    auto z = (::std::fabs(u - n1 * n2 / 2.) - 0.5) / sigma;
+    return z > 0. ? ::std::erfc(z / ::std::sqrt(2.)) : 1.;
+}
@@ -0,0 +1,301 @@
+/**
+ * @file   summed.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Bank workload with incrementally maintained aggregates: each segment of the
+ * chain keeps the sum of its balances in its header, updated by the same
+ * transaction as every transfer between two segments. The long transaction
+ * then audits the bank from the headers alone instead of reading every
+ * account. Against the chained bank, this shows what maintaining the sums
+ * costs the transfers (a hot word per segment, written by every transfer
+ * across segments) and what it saves the audits, on each engine.
+**/
+
+#pragma once
+
+// External headers
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Bank workload class, on the chained layout with a running sum of the balances in each segment header.
+ * The audit sums the headers, and 'check' verifies each running sum against a full scan of its segment.
+**/
+class WorkloadBankSummed final: public WorkloadBank {
+private:
+    /** Shared segment class, the chained segment with a running sum after the balance correction.
+    **/
+    class SummedSegment final {
+    private:
+        /** Dummy structure for size and alignment retrieval.
+        **/
+        struct Dummy {
+            size_t  dummy0;
+            void*   dummy1;
+            Balance dummy2;
+            Balance dummy3;
+            Balance dummy4[];
+        };
+    public:
+        /** Get the segment size for a given number of accounts.
+         * @param nbaccounts Number of accounts per segment
+         * @return Segment size (in bytes)
+        **/
+        constexpr static auto size(size_t nbaccounts) noexcept {
+            return sizeof(Dummy) + nbaccounts * sizeof(Balance);
+        }
+        /** Get the segment alignment.
+         * @return Segment alignment (in bytes)
+        **/
+        constexpr static auto align() noexcept {
+            return alignof(Dummy);
+        }
+    public:
+        /** Private copy of the fields in front of the accounts, laid out as in shared memory.
+        **/
+        struct Header {
+            size_t  count;  // Number of allocated accounts in this segment
+            void*   next;   // Next allocated segment
+            Balance parity; // Segment balance correction for when deleting an account
+            Balance sum;    // Sum of the balances of the allocated accounts in this segment
+        };
+        static_assert(sizeof(Header) == offsetof(Dummy, dummy4), "Header does not match the segment layout");
+    private:
+        Transaction& tx; // Associated pending transaction
+    public:
+        Shared<size_t>         count; // Number of allocated accounts in this segment
+        Shared<SummedSegment*>  next; // Next allocated segment
+        Shared<Balance>       parity; // Segment balance correction for when deleting an account
+        Shared<Balance>          sum; // Sum of the balances of the allocated accounts in this segment
+        Shared<Balance[]>   accounts; // Amount of money on the accounts (undefined if not allocated)
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        SummedSegment(SummedSegment const&) = delete;
+        SummedSegment& operator=(SummedSegment const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Block base address
+        **/
+        SummedSegment(Transaction& tx, void* address): tx{tx}, count{tx, address}, next{tx, count.after()}, parity{tx, next.after()}, sum{tx, parity.after()}, accounts{tx, sum.after()} {}
+    public:
+        /** Read the header with a single transactional read.
+         * @param whole Whether to read 'parity' and 'sum' too, or only 'count' and 'next'
+         * @return Private copy of the header ('parity' and 'sum' undefined if not read)
+        **/
+        Header header(bool whole = true) const {
+            Header res;
+            tx.read(count.get(), whole ? sizeof(Header) : offsetof(Header, parity), &res);
+            return res;
+        }
+        /** Early release of the traversal reads ('count' and 'next'), once two segments behind, see 'AccountSegment::release'.
+        **/
+        void release() const noexcept {
+            count.release();
+            next.release();
+        }
+    };
+public:
+    /** Summed bank workload constructor, same parameters as the chained one.
+    **/
+    WorkloadBankSummed(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): WorkloadBank{library, SummedSegment::align(), SummedSegment::size(nbaccounts), nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc, access, arrival_rate} {}
+private:
+    /** Full scan transaction, checking the running sum of each segment against its accounts.
+     * @return Whether no inconsistency has been found
+    **/
+    bool scan_tx() const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto count = 0ul;
+            auto total = Balance{0};
+            thread_local ::std::vector<Balance> balances;
+            for (auto start = tm.get_start(); start;) {
+                SummedSegment segment{tx, start};
+                auto header = segment.header();
+                decltype(count) segment_count = header.count;
+                balances.resize(segment_count);
+                segment.accounts.read_range(0, segment_count, balances.data());
+                auto sum = Balance{0};
+                for (auto local: balances) {
+                    if (unlikely(local < 0))
+                        return false;
+                    sum += local;
+                }
+                if (unlikely(sum != header.sum))
+                    return false;
+                count += segment_count;
+                total += header.parity + sum;
+                start = header.next;
+            }
+            return total == static_cast<Balance>(init_balance * count);
+        });
+    }
+protected:
+    virtual bool long_tx(size_t& nbaccounts) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto count = 0ul;
+            auto total = Balance{0};
+            for (auto start = tm.get_start(); start;) {
+                auto header = SummedSegment{tx, start}.header();
+                count += header.count;
+                total += header.parity + header.sum;
+                start = header.next;
+            }
+            nbaccounts = count;
+            return total == static_cast<Balance>(init_balance * count);
+        });
+    }
+    virtual void alloc_tx(size_t trigger) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto count = 0ul;
+            void* prev = nullptr;
+            void* prev_prev = nullptr;
+            auto start = tm.get_start();
+            while (true) {
+                SummedSegment segment{tx, start};
+                auto header = segment.header(false);
+                decltype(count) segment_count = header.count;
+                count += segment_count;
+                decltype(start) segment_next = header.next;
+                if (!segment_next) { // Currently at the last segment
+                    if (count > trigger && likely(count > 2)) { // Deallocate
+                        --segment_count;
+                        Balance last = segment.accounts[segment_count];
+                        auto new_parity = segment.parity.read() + last - init_balance;
+                        if (segment_count > 0) { // Just "deallocate" account, its balance moving from the sum to the correction
+                            segment.count = segment_count;
+                            segment.parity = new_parity;
+                            segment.sum = segment.sum.read() - last;
+                        } else { // Deallocate segment
+                            if (unlikely(assert_mode && prev == nullptr))
+                                throw Exception::TransactionNotLastSegment{};
+                            SummedSegment prev_segment{tx, prev};
+                            prev_segment.next.free();
+                            prev_segment.parity = prev_segment.parity.read() + new_parity;
+                        }
+                    } else { // Allocate
+                        if (segment_count < nbaccounts) { // Just "allocate" account
+                            segment.accounts[segment_count] = init_balance;
+                            segment.count = segment_count + 1;
+                            segment.sum = segment.sum.read() + init_balance;
+                        } else {
+                            SummedSegment next_segment{tx, segment.next.alloc(SummedSegment::size(nbaccounts))};
+                            next_segment.count = 1;
+                            next_segment.sum = init_balance;
+                            next_segment.accounts[0] = init_balance;
+                        }
+                    }
+                    return;
+                }
+                if (prev_prev)
+                    SummedSegment{tx, prev_prev}.release();
+                prev_prev = prev;
+                prev  = start;
+                start = segment_next;
+            }
+        });
+    }
+    virtual bool short_tx(size_t send_id, size_t recv_id) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            void* send_ptr = nullptr;
+            void* recv_ptr = nullptr;
+            void* send_seg = nullptr; // Segment of the sender account
+            void* recv_seg = nullptr; // Segment of the receiver account
+            void* prev = nullptr; // Previous segment, if it holds none of the accounts
+            void* prev_prev = nullptr;
+            // Get the account pointers in shared memory
+            auto start = tm.get_start();
+            while (true) {
+                SummedSegment segment{tx, start};
+                auto header = segment.header(false);
+                size_t segment_count = header.count;
+                auto found = false;
+                if (!send_ptr) {
+                    if (send_id < segment_count) {
+                        send_ptr = segment.accounts[send_id].get();
+                        send_seg = start;
+                        found = true;
+                    } else {
+                        send_id -= segment_count;
+                    }
+                }
+                if (!recv_ptr) {
+                    if (recv_id < segment_count) {
+                        recv_ptr = segment.accounts[recv_id].get();
+                        recv_seg = start;
+                        found = true;
+                    } else {
+                        recv_id -= segment_count;
+                    }
+                }
+                if (send_ptr && recv_ptr)
+                    break;
+                auto segment_next = header.next;
+                if (!segment_next) // Current segment is the last segment
+                    return false; // At least one account does not exist => do nothing
+                if (prev_prev)
+                    SummedSegment{tx, prev_prev}.release();
+                prev_prev = prev;
+                prev  = found ? nullptr : start;
+                start = segment_next;
+            }
+            // Transfer the money if enough fund, moving the unit between the running sums too if across segments
+            void const* const accounts[] = {send_ptr, recv_ptr};
+            tx.hint(accounts, 2, 0b11);
+            Shared<Balance> sender{tx, send_ptr};
+            Shared<Balance> recver{tx, recv_ptr};
+            auto send_val = sender.read_for_update();
+            if (send_val > 0) {
+                sender = send_val - 1;
+                recver = recver.read_for_update() + 1;
+                if (send_seg != recv_seg) {
+                    SummedSegment from{tx, send_seg};
+                    SummedSegment to{tx, recv_seg};
+                    from.sum = from.sum.read_for_update() - 1;
+                    to.sum = to.sum.read_for_update() + 1;
+                }
+            }
+            return true;
+        });
+    }
+public:
+    virtual void load(Uid uid, size_t nbloaders) const {
+        auto start = reinterpret_cast<uint8_t*>(tm.get_start());
+        SummedSegment::Header header{nbaccounts, nullptr, 0, static_cast<Balance>(init_balance * nbaccounts)};
+        loaded[uid] = load_accounts(uid, nbloaders, reinterpret_cast<Balance*>(start + sizeof(header))) && (uid != 0 || tm.bulk_write(&header, sizeof(header), start));
+    }
+    virtual char const* init() const {
+        if (!is_loaded()) {
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                SummedSegment segment{tx, tm.get_start()};
+                segment.count = nbaccounts;
+                segment.sum = static_cast<Balance>(init_balance * nbaccounts);
+                for (size_t i = 0; i < nbaccounts; ++i)
+                    segment.accounts[i] = init_balance;
+            });
+        }
+        if (unlikely(!scan_tx()))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0 && unlikely(!scan_tx())) // Every running sum up to date, before the counters overwrite the first words
+            error = "Violated isolation or atomicity (a running sum does not match its segment)";
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
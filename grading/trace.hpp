@@ -0,0 +1,413 @@
+/**
+ * @file   trace.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Transaction traces: a recorder logging the committed transactions of each
+ * thread on a shared memory region (operations, addresses relative to their
+ * segment, sizes and written values) into a compact binary file, and the
+ * reader of such files, for the replay workload.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Kind of a traced operation, as encoded in the trace files.
+**/
+enum class TraceKind: uint8_t {
+    begin_rw, // Beginning of a read-write transaction, then the time since the previous transaction of the thread (in ns)
+    begin_ro, // Beginning of a read-only transaction, then the time since the previous transaction of the thread (in ns)
+    read,     // Read of a range: segment, offset, size
+    update,   // Read of a range about to be written: segment, offset, size
+    write,    // Write of a range: segment, offset, size, then the bytes written
+    add,      // Increment of a 64-bit integer: segment, offset, increment (zigzag-encoded)
+    release,  // Early release of a range: segment, offset, size
+    alloc,    // Allocation of a segment: size, identifier given to the segment
+    free,     // Freeing of a segment: segment
+    commit,   // Commit of the transaction
+    mark      // Phase boundary (e.g. end of the initialization, end of a run), outside of any transaction
+};
+
+/** Magic bytes at the start of every trace file.
+**/
+constexpr static char trace_magic[8] = {'T', 'M', 'T', 'R', 'A', 'C', 'E', '1'};
+
+/** Segment identifier of the addresses outside of every known segment, skipped when replayed.
+**/
+constexpr static uint64_t trace_unknown = ~uint64_t{0};
+
+/** Append an unsigned integer as a LEB128 variable-length integer.
+ * @param buffer Buffer to append to
+ * @param value  Value to append
+**/
+static void trace_put(::std::vector<uint8_t>& buffer, uint64_t value) {
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<uint8_t>(value));
+}
+
+/** Recorder of the committed transactions of each thread on one shared memory region.
+ * Each thread appends to a stream of its own; the operations of an attempt are kept aside until it commits, an aborted attempt being
+ * dropped. Addresses are stored as a segment identifier and an offset: 0 for the first segment, then the identifier given to each
+ * allocation, so that a replay can map them to the segments it allocates itself.
+**/
+class TraceRecorder final: private NonCopyable {
+private:
+    /** Per-thread stream.
+    **/
+    struct Stream {
+        ::std::vector<uint8_t> committed; // Encoded operations of the committed transactions and the marks
+        ::std::vector<uint8_t> attempt;   // Encoded operations of the pending attempt
+        ::std::chrono::steady_clock::time_point last; // End of the previous transaction of the thread
+    };
+    /** Known segment.
+    **/
+    struct Segment {
+        uint64_t id;   // Segment identifier
+        size_t   size; // Size of the segment (in bytes)
+    };
+private:
+    uint64_t const instance;  // Unique instance number, to invalidate the per-thread caches of a previous recorder
+    size_t   const alignment; // Alignment of the shared memory region (in bytes)
+    size_t   const first_size; // Size of the first segment (in bytes)
+    ::std::mutex streams_lock; // Protects the list of streams
+    ::std::deque<Stream> streams; // Stream of each thread, in registration order
+    ::std::shared_mutex segments_lock; // Protects the map of the segments
+    ::std::map<uintptr_t, Segment> segments; // Known segments by start address, freed ones kept until their address is reused
+    ::std::atomic<uint64_t> next_id; // Next segment identifier
+private:
+    /** Get the stream of the calling thread, registering it on its first call.
+     * @return Stream of the calling thread
+    **/
+    Stream& local() {
+        thread_local ::std::pair<uint64_t, Stream*> cache{0, nullptr};
+        if (unlikely(cache.first != instance)) {
+            ::std::unique_lock<::std::mutex> guard{streams_lock};
+            auto& stream = streams.emplace_back();
+            stream.last = ::std::chrono::steady_clock::now();
+            cache = {instance, &stream};
+        }
+        return *cache.second;
+    }
+    /** Translate an address to its segment and offset.
+     * @param address Address to translate
+     * @return Segment identifier ('trace_unknown' if none) and offset in the segment
+    **/
+    ::std::pair<uint64_t, uint64_t> locate(void const* address) {
+        auto addr = reinterpret_cast<uintptr_t>(address);
+        ::std::shared_lock<::std::shared_mutex> guard{segments_lock};
+        auto iter = segments.upper_bound(addr);
+        if (unlikely(iter == segments.begin()))
+            return {trace_unknown, 0};
+        --iter;
+        if (unlikely(addr - iter->first >= iter->second.size))
+            return {trace_unknown, 0};
+        return {iter->second.id, addr - iter->first};
+    }
+    /** Append a ranged operation to the pending attempt of the calling thread.
+     * @param kind    Kind of the operation
+     * @param address Start address of the range
+     * @param size    Size of the range (in bytes)
+     * @return Attempt buffer of the calling thread, to append more to
+    **/
+    ::std::vector<uint8_t>& ranged(TraceKind kind, void const* address, size_t size) {
+        auto [segment, offset] = locate(address);
+        auto& attempt = local().attempt;
+        attempt.push_back(static_cast<uint8_t>(kind));
+        trace_put(attempt, segment + 1); // 0 for unknown
+        trace_put(attempt, offset);
+        trace_put(attempt, size);
+        return attempt;
+    }
+public:
+    /** Region constructor.
+     * @param start Start address of the first segment
+     * @param size  Size of the first segment (in bytes)
+     * @param align Alignment of the shared memory region (in bytes)
+    **/
+    TraceRecorder(void const* start, size_t size, size_t align): instance{[]() { static ::std::atomic<uint64_t> counter{0}; return ++counter; }()}, alignment{align}, first_size{size}, next_id{1} {
+        segments[reinterpret_cast<uintptr_t>(start)] = Segment{0, size};
+    }
+public:
+    /** [thread-safe] Note the beginning of a transaction, dropping any pending attempt that did not end.
+     * @param ro Whether the transaction is read-only
+    **/
+    void begin(bool ro) {
+        auto& stream = local();
+        auto gap = ::std::chrono::duration_cast<::std::chrono::nanoseconds>(::std::chrono::steady_clock::now() - stream.last).count();
+        stream.attempt.clear();
+        stream.attempt.push_back(static_cast<uint8_t>(ro ? TraceKind::begin_ro : TraceKind::begin_rw));
+        trace_put(stream.attempt, static_cast<uint64_t>(gap > 0 ? gap : 0));
+    }
+    /** [thread-safe] Note the end of a transaction, keeping its operations if it committed.
+     * @param committed Whether the transaction committed
+    **/
+    void end(bool committed) {
+        auto& stream = local();
+        if (committed) {
+            stream.attempt.push_back(static_cast<uint8_t>(TraceKind::commit));
+            stream.committed.insert(stream.committed.end(), stream.attempt.begin(), stream.attempt.end());
+        }
+        stream.attempt.clear();
+        stream.last = ::std::chrono::steady_clock::now();
+    }
+    /** [thread-safe] Note a read.
+     * @param source Source start address
+     * @param size   Size of the range (in bytes)
+     * @param update Whether the range is about to be written
+    **/
+    void read(void const* source, size_t size, bool update = false) {
+        ranged(update ? TraceKind::update : TraceKind::read, source, size);
+    }
+    /** [thread-safe] Note a write, with the bytes written.
+     * @param source Private source start address
+     * @param size   Size of the range (in bytes)
+     * @param target Shared target start address
+    **/
+    void write(void const* source, size_t size, void const* target) {
+        auto& attempt = ranged(TraceKind::write, target, size);
+        auto bytes = static_cast<uint8_t const*>(source);
+        attempt.insert(attempt.end(), bytes, bytes + size);
+    }
+    /** [thread-safe] Note an increment.
+     * @param target Integer to increment
+     * @param delta  Increment
+    **/
+    void add(void const* target, int64_t delta) {
+        auto [segment, offset] = locate(target);
+        auto& attempt = local().attempt;
+        attempt.push_back(static_cast<uint8_t>(TraceKind::add));
+        trace_put(attempt, segment + 1);
+        trace_put(attempt, offset);
+        trace_put(attempt, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+    }
+    /** [thread-safe] Note an early release.
+     * @param source Source start address
+     * @param size   Size of the range (in bytes)
+    **/
+    void release(void const* source, size_t size) {
+        ranged(TraceKind::release, source, size);
+    }
+    /** [thread-safe] Note a successful allocation, giving the new segment its identifier.
+     * @param size   Size of the segment (in bytes)
+     * @param target Start address of the segment
+    **/
+    void alloc(size_t size, void const* target) {
+        auto id = next_id.fetch_add(1, ::std::memory_order_relaxed);
+        {
+            ::std::unique_lock<::std::shared_mutex> guard{segments_lock};
+            segments[reinterpret_cast<uintptr_t>(target)] = Segment{id, size};
+        }
+        auto& attempt = local().attempt;
+        attempt.push_back(static_cast<uint8_t>(TraceKind::alloc));
+        trace_put(attempt, size);
+        trace_put(attempt, id);
+    }
+    /** [thread-safe] Note a freeing.
+     * @param target Start address of the segment
+    **/
+    void free(void const* target) {
+        auto segment = locate(target).first;
+        auto& attempt = local().attempt;
+        attempt.push_back(static_cast<uint8_t>(TraceKind::free));
+        trace_put(attempt, segment + 1);
+    }
+    /** [thread-safe] Note a phase boundary of the calling thread, outside of any transaction.
+    **/
+    void mark() {
+        local().committed.push_back(static_cast<uint8_t>(TraceKind::mark));
+    }
+    /** Write the trace to a file, once every thread stopped recording.
+     * @param path Path of the file to write
+    **/
+    void save(char const* path) {
+        ::std::ofstream file{path, ::std::ios::binary | ::std::ios::trunc};
+        if (unlikely(!file))
+            throw ::std::runtime_error{::std::string{"unable to open trace file '"} + path + "'"};
+        ::std::vector<uint8_t> header;
+        trace_put(header, alignment);
+        trace_put(header, first_size);
+        trace_put(header, streams.size());
+        file.write(trace_magic, sizeof(trace_magic));
+        file.write(reinterpret_cast<char const*>(header.data()), static_cast<::std::streamsize>(header.size()));
+        for (auto const& stream: streams) {
+            header.clear();
+            trace_put(header, stream.committed.size());
+            file.write(reinterpret_cast<char const*>(header.data()), static_cast<::std::streamsize>(header.size()));
+            file.write(reinterpret_cast<char const*>(stream.committed.data()), static_cast<::std::streamsize>(stream.committed.size()));
+        }
+        if (unlikely(!file))
+            throw ::std::runtime_error{::std::string{"unable to write trace file '"} + path + "'"};
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Decoded trace file.
+**/
+class Trace final {
+public:
+    /** One decoded operation.
+    **/
+    struct Op {
+        TraceKind kind;   // Kind of the operation
+        uint64_t segment; // Segment identifier ('trace_unknown' if none), or identifier given to an allocated segment
+        uint64_t offset;  // Offset in the segment (in bytes)
+        uint64_t size;    // Size of the range or of the allocated segment (in bytes)
+        int64_t  delta;   // Increment, for 'TraceKind::add'
+        size_t   data;    // Offset of the bytes written in the stream's byte pool, for 'TraceKind::write'
+    };
+    /** One decoded committed transaction.
+    **/
+    struct Tx {
+        bool     ro;    // Whether the transaction is read-only
+        uint64_t gap;   // Time since the previous transaction of the thread (in ns)
+        size_t   first; // Index of the first operation in the stream
+        size_t   last;  // Index past the last operation in the stream
+    };
+    /** One decoded thread stream.
+    **/
+    struct Stream {
+        ::std::vector<Op> ops;     // Operations of every transaction
+        ::std::vector<uint8_t> bytes; // Byte pool of the written values
+        ::std::vector<Tx> init;    // Transactions before the first mark
+        ::std::vector<Tx> run;     // Transactions between the first and the last marks
+    };
+public:
+    size_t alignment;  // Alignment of the recorded shared memory region (in bytes)
+    size_t first_size; // Size of the recorded first segment (in bytes)
+    ::std::vector<Stream> streams; // Stream of each recorded thread
+private:
+    /** Read a LEB128 variable-length integer.
+     * @param data Buffer to read from
+     * @param pos  Position to read at, advanced past the integer
+     * @return Value read
+    **/
+    static uint64_t get(::std::vector<uint8_t> const& data, size_t& pos) {
+        uint64_t res = 0;
+        for (unsigned int shift = 0; shift < 64; shift += 7) {
+            if (unlikely(pos >= data.size()))
+                throw ::std::invalid_argument{"truncated trace file"};
+            auto byte = data[pos++];
+            res |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return res;
+        }
+        throw ::std::invalid_argument{"corrupted trace file"};
+    }
+    /** Decode one stream.
+     * @param data  File contents
+     * @param pos   Position of the stream, advanced past it
+     * @param limit Position past the stream
+     * @return Decoded stream
+    **/
+    static Stream decode(::std::vector<uint8_t> const& data, size_t& pos, size_t limit) {
+        Stream res;
+        ::std::vector<Tx> pending; // Transactions since the last mark
+        size_t nbmarks = 0;
+        Tx tx{false, 0, 0, 0};
+        while (pos < limit) {
+            auto kind = static_cast<TraceKind>(data[pos++]);
+            Op op{kind, trace_unknown, 0, 0, 0, 0};
+            switch (kind) {
+            case TraceKind::begin_rw:
+            case TraceKind::begin_ro:
+                tx = Tx{kind == TraceKind::begin_ro, get(data, pos), res.ops.size(), 0};
+                continue;
+            case TraceKind::commit:
+                tx.last = res.ops.size();
+                pending.push_back(tx);
+                continue;
+            case TraceKind::mark:
+                if (nbmarks++ == 0) {
+                    res.init = ::std::move(pending);
+                } else {
+                    res.run.insert(res.run.end(), pending.begin(), pending.end());
+                }
+                pending.clear();
+                continue;
+            case TraceKind::read:
+            case TraceKind::update:
+            case TraceKind::release:
+            case TraceKind::write:
+                op.segment = get(data, pos) - 1;
+                op.offset = get(data, pos);
+                op.size = get(data, pos);
+                if (kind == TraceKind::write) {
+                    if (unlikely(op.size > limit - pos))
+                        throw ::std::invalid_argument{"truncated trace file"};
+                    op.data = res.bytes.size();
+                    res.bytes.insert(res.bytes.end(), data.begin() + static_cast<ptrdiff_t>(pos), data.begin() + static_cast<ptrdiff_t>(pos + op.size));
+                    pos += op.size;
+                }
+                break;
+            case TraceKind::add: {
+                op.segment = get(data, pos) - 1;
+                op.offset = get(data, pos);
+                auto zigzag = get(data, pos);
+                op.delta = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+            } break;
+            case TraceKind::alloc:
+                op.size = get(data, pos);
+                op.segment = get(data, pos);
+                break;
+            case TraceKind::free:
+                op.segment = get(data, pos) - 1;
+                break;
+            default:
+                throw ::std::invalid_argument{"corrupted trace file"};
+            }
+            res.ops.push_back(op);
+        }
+        return res; // Transactions after the last mark (e.g. the checks) dropped
+    }
+public:
+    /** Load constructor.
+     * @param path Path of the trace file to read
+    **/
+    Trace(::std::string const& path) {
+        ::std::ifstream file{path, ::std::ios::binary};
+        if (unlikely(!file))
+            throw ::std::invalid_argument{"unable to open trace file '" + path + "'"};
+        ::std::vector<uint8_t> data{::std::istreambuf_iterator<char>{file}, ::std::istreambuf_iterator<char>{}};
+        if (unlikely(data.size() < sizeof(trace_magic) || ::std::memcmp(data.data(), trace_magic, sizeof(trace_magic)) != 0))
+            throw ::std::invalid_argument{"'" + path + "' is not a trace file"};
+        size_t pos = sizeof(trace_magic);
+        alignment = get(data, pos);
+        first_size = get(data, pos);
+        auto nbstreams = get(data, pos);
+        for (uint64_t i = 0; i < nbstreams; ++i) {
+            auto length = get(data, pos);
+            if (unlikely(length > data.size() - pos))
+                throw ::std::invalid_argument{"truncated trace file"};
+            streams.push_back(decode(data, pos, pos + length));
+        }
+    }
+};
@@ -28,12 +28,86 @@ extern "C" {
 #include <dlfcn.h>
 #include <limits.h>
 }
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <vector>
 
 // Internal headers
+#ifdef GRADING_STATIC
+// The engine linked in declares the interface at global scope: use the very same types (see 'make static')
+#include <tm.hpp>
+#include <tm_ext.hpp>
+extern "C" { // Optional functions, null if the engine does not define them
+    [[gnu::weak]] bool tm_stats(shared_t, struct tm_stats*) noexcept;
+    [[gnu::weak]] bool tm_read_batch(shared_t, tx_t, struct tm_access const*, size_t) noexcept;
+    [[gnu::weak]] bool tm_write_batch(shared_t, tx_t, struct tm_access const*, size_t) noexcept;
+    [[gnu::weak]] bool tm_read_for_update(shared_t, tx_t, void const*, size_t, void*) noexcept;
+    [[gnu::weak]] bool tm_add(shared_t, tx_t, void*, int64_t) noexcept;
+    [[gnu::weak]] void tm_release(shared_t, tx_t, void const*, size_t) noexcept;
+    [[gnu::weak]] bool tm_thread_enter(shared_t) noexcept;
+    [[gnu::weak]] void tm_thread_leave(shared_t) noexcept;
+    [[gnu::weak]] bool tm_run(shared_t, bool, bool (*)(shared_t, tx_t, void*), void*) noexcept;
+    [[gnu::weak]] bool tm_read_word(shared_t, tx_t, void const*, void*) noexcept;
+    [[gnu::weak]] bool tm_write_word(shared_t, tx_t, void const*, void*) noexcept;
+    [[gnu::weak]] bool tm_hint(shared_t, tx_t, void const* const*, size_t, uint64_t) noexcept;
+    [[gnu::weak]] shared_t tm_create_ex(size_t, size_t, struct tm_options const*) noexcept;
+    [[gnu::weak]] bool tm_bulk_write(shared_t, void const*, size_t, void*) noexcept;
+    [[gnu::weak]] bool tm_read_view(shared_t, tx_t, void const*, size_t, void const**) noexcept;
+    [[gnu::weak]] bool tm_write_reserve(shared_t, tx_t, void*, size_t, void**) noexcept;
+    [[gnu::weak]] Alloc tm_realloc(shared_t, tx_t, void*, size_t, size_t, void**) noexcept;
+}
+namespace STM {
+    using ::shared_t;
+    using ::invalid_shared;
+    using ::tx_t;
+    using ::invalid_tx;
+    using ::Alloc;
+    using ::tm_access;
+    using ::tm_stats;
+    using ::tm_create;
+    using ::tm_destroy;
+    using ::tm_start;
+    using ::tm_size;
+    using ::tm_align;
+    using ::tm_begin;
+    using ::tm_end;
+    using ::tm_read;
+    using ::tm_write;
+    using ::tm_alloc;
+    using ::tm_free;
+    using ::tm_read_batch;
+    using ::tm_write_batch;
+    using ::tm_read_for_update;
+    using ::tm_add;
+    using ::tm_release;
+    using ::tm_thread_enter;
+    using ::tm_thread_leave;
+    using ::tm_run;
+    using ::tm_read_word;
+    using ::tm_write_word;
+    using ::tm_hint;
+    using ::tm_options;
+    using ::tm_create_ex;
+    using ::tm_bulk_write;
+    using ::tm_read_view;
+    using ::tm_write_reserve;
+    using ::tm_realloc;
+}
+#else
 namespace STM {
 #include <tm.hpp>
+#include <tm_ext.hpp>
 }
+#endif
 #include "common.hpp"
+#include "order.hpp"
+#include "trace.hpp"
 
 // -------------------------------------------------------------------------- //
 namespace Exception {
@@ -80,6 +154,70 @@ private:
     using FnWrite   = decltype(&STM::tm_write);
     using FnAlloc   = decltype(&STM::tm_alloc);
     using FnFree    = decltype(&STM::tm_free);
+    using FnStats   = decltype(&STM::tm_stats);
+    using FnReadBatch  = decltype(&STM::tm_read_batch);
+    using FnWriteBatch = decltype(&STM::tm_write_batch);
+    using FnReadForUpdate = decltype(&STM::tm_read_for_update);
+    using FnAdd = decltype(&STM::tm_add);
+    using FnRelease = decltype(&STM::tm_release);
+    using FnThreadEnter = decltype(&STM::tm_thread_enter);
+    using FnThreadLeave = decltype(&STM::tm_thread_leave);
+    using FnRun = decltype(&STM::tm_run);
+    using FnReadWord  = decltype(&STM::tm_read_word);
+    using FnWriteWord = decltype(&STM::tm_write_word);
+    using FnHint = decltype(&STM::tm_hint);
+    using FnCreateEx = decltype(&STM::tm_create_ex);
+    using FnBulkWrite = decltype(&STM::tm_bulk_write);
+    using FnReadView = decltype(&STM::tm_read_view);
+    using FnWriteReserve = decltype(&STM::tm_write_reserve);
+    using FnRealloc = decltype(&STM::tm_realloc);
+    /** Knobs of the regions to create, 'nullptr' for the defaults.
+    **/
+    STM::tm_options const* options = nullptr;
+public:
+    /** Create the regions with the given knobs from now on, if the library exports 'tm_create_ex'.
+     * @param knobs Knobs of the regions, outliving the library, 'nullptr' for the defaults
+    **/
+    void configure(STM::tm_options const* knobs) noexcept {
+        options = knobs;
+    }
+#ifdef GRADING_STATIC
+private:
+    // Engine linked into the binary (see 'make static'): the mandatory functions are called directly, so that link-time optimization can inline them in the workloads
+    static constexpr FnCreate  tm_create  = &STM::tm_create;
+    static constexpr FnDestroy tm_destroy = &STM::tm_destroy;
+    static constexpr FnStart   tm_start   = &STM::tm_start;
+    static constexpr FnSize    tm_size    = &STM::tm_size;
+    static constexpr FnAlign   tm_align   = &STM::tm_align;
+    static constexpr FnBegin   tm_begin   = &STM::tm_begin;
+    static constexpr FnEnd     tm_end     = &STM::tm_end;
+    static constexpr FnRead    tm_read    = &STM::tm_read;
+    static constexpr FnWrite   tm_write   = &STM::tm_write;
+    static constexpr FnAlloc   tm_alloc   = &STM::tm_alloc;
+    static constexpr FnFree    tm_free    = &STM::tm_free;
+    static inline FnStats const tm_stats = &STM::tm_stats;
+    static inline FnReadBatch const  tm_read_batch  = &STM::tm_read_batch;
+    static inline FnWriteBatch const tm_write_batch = &STM::tm_write_batch;
+    static inline FnReadForUpdate const tm_read_for_update = &STM::tm_read_for_update;
+    static inline FnAdd const tm_add = &STM::tm_add;
+    static inline FnRelease const tm_release = &STM::tm_release;
+    static inline FnThreadEnter const tm_thread_enter = &STM::tm_thread_enter;
+    static inline FnThreadLeave const tm_thread_leave = &STM::tm_thread_leave;
+    static inline FnRun const tm_run = &STM::tm_run;
+    static inline FnReadWord const  tm_read_word  = &STM::tm_read_word;
+    static inline FnWriteWord const tm_write_word = &STM::tm_write_word;
+    static inline FnHint const tm_hint = &STM::tm_hint;
+    static inline FnCreateEx const tm_create_ex = &STM::tm_create_ex;
+    static inline FnBulkWrite const tm_bulk_write = &STM::tm_bulk_write;
+    static inline FnReadView const tm_read_view = &STM::tm_read_view;
+    static inline FnWriteReserve const tm_write_reserve = &STM::tm_write_reserve;
+    static inline FnRealloc const tm_realloc = &STM::tm_realloc;
+public:
+    /** Linked engine constructor.
+     * @param path Name of the library, only for display (the engine is the one linked in)
+    **/
+    TransactionalLibrary(char const* path [[gnu::unused]]) {}
+#else
 private:
     void*     module;     // Module opaque handler
     FnCreate  tm_create;  // Module's initialization function
@@ -93,6 +231,23 @@ private:
     FnWrite   tm_write;   // Module's shared memory write function
     FnAlloc   tm_alloc;   // Module's shared memory allocation function
     FnFree    tm_free;    // Module's shared memory freeing function
+    FnStats   tm_stats;   // Module's statistics query function (optional, 'nullptr' if not exported)
+    FnReadBatch  tm_read_batch;  // Module's batched read function (optional, 'nullptr' if not exported)
+    FnWriteBatch tm_write_batch; // Module's batched write function (optional, 'nullptr' if not exported)
+    FnReadForUpdate tm_read_for_update; // Module's read-for-update function (optional, 'nullptr' if not exported)
+    FnAdd tm_add; // Module's commutative increment function (optional, 'nullptr' if not exported)
+    FnRelease tm_release; // Module's early release function (optional, 'nullptr' if not exported)
+    FnThreadEnter tm_thread_enter; // Module's thread registration function (optional, 'nullptr' if not exported)
+    FnThreadLeave tm_thread_leave; // Module's thread unregistration function (optional, 'nullptr' if not exported)
+    FnRun tm_run; // Module's retrying transaction function (optional, 'nullptr' if not exported)
+    FnReadWord  tm_read_word;  // Module's 8-byte word read function (optional, 'nullptr' if not exported)
+    FnWriteWord tm_write_word; // Module's 8-byte word write function (optional, 'nullptr' if not exported)
+    FnHint tm_hint; // Module's access declaration function (optional, 'nullptr' if not exported)
+    FnCreateEx tm_create_ex; // Module's initialization function with knobs (optional, 'nullptr' if not exported)
+    FnBulkWrite tm_bulk_write; // Module's non-transactional loading function (optional, 'nullptr' if not exported)
+    FnReadView tm_read_view; // Module's in-place read function (optional, 'nullptr' if not exported)
+    FnWriteReserve tm_write_reserve; // Module's in-place write function (optional, 'nullptr' if not exported)
+    FnRealloc tm_realloc; // Module's shared memory resizing function (optional, 'nullptr' if not exported)
 private:
     /** Solve a symbol from its name, and bind it to the given function.
      * @param name Name of the symbol to resolve
@@ -107,6 +262,14 @@ private:
     template<class Signature> void solve(char const* name, Signature& func) const {
         func = solve<Signature>(name);
     }
+    /** Solve an optional symbol from its name, and bind it to the given function.
+     * @param name Name of the symbol to resolve
+     * @param func Target function to bind, set to 'nullptr' if the symbol is missing
+    **/
+    template<class Signature> void solve_optional(char const* name, Signature& func) const {
+        auto res = ::dlsym(module, name);
+        func = res ? *reinterpret_cast<Signature*>(&res) : nullptr;
+    }
 public:
     /** Loader constructor.
      * @param path  Path to the library to load
@@ -133,12 +296,32 @@ public:
             solve("tm_alloc", tm_alloc);
             solve("tm_free", tm_free);
         }
+        { // Bind module's optional 'tm_*' symbols
+            solve_optional("tm_stats", tm_stats);
+            solve_optional("tm_read_batch", tm_read_batch);
+            solve_optional("tm_write_batch", tm_write_batch);
+            solve_optional("tm_read_for_update", tm_read_for_update);
+            solve_optional("tm_add", tm_add);
+            solve_optional("tm_release", tm_release);
+            solve_optional("tm_thread_enter", tm_thread_enter);
+            solve_optional("tm_thread_leave", tm_thread_leave);
+            solve_optional("tm_run", tm_run);
+            solve_optional("tm_read_word", tm_read_word);
+            solve_optional("tm_write_word", tm_write_word);
+            solve_optional("tm_hint", tm_hint);
+            solve_optional("tm_create_ex", tm_create_ex);
+            solve_optional("tm_bulk_write", tm_bulk_write);
+            solve_optional("tm_read_view", tm_read_view);
+            solve_optional("tm_write_reserve", tm_write_reserve);
+            solve_optional("tm_realloc", tm_realloc);
+        }
     }
     /** Unloader destructor.
     **/
     ~TransactionalLibrary() noexcept {
         ::dlclose(module); // Close loaded module
     }
+#endif
 };
 
 /** One shared memory region management class.
@@ -163,17 +346,18 @@ private:
     void*  start_addr; // Shared memory region first segment's start address
     size_t start_size; // Shared memory region first segment's size (in bytes)
     size_t alignment;  // Shared memory region alignment (in bytes)
+    TraceRecorder* recorder; // Recorder of the committed transactions, 'nullptr' for none
 public:
     /** Bind constructor.
      * @param library Transactional library to use
      * @param align   Shared memory region required alignment
      * @param size    Size of the shared memory region to allocate
     **/
-    TransactionalMemory(TransactionalLibrary const& library, size_t align, size_t size): tl{library}, start_size{size}, alignment{align} {
+    TransactionalMemory(TransactionalLibrary const& library, size_t align, size_t size): tl{library}, start_size{size}, alignment{align}, recorder{nullptr} {
         if (unlikely(assert_mode && (!is_power_of_two(align) || size % align != 0)))
             throw Exception::TransactionAlign{};
         bounded_run(max_side_time, [&]() {
-            shared = tl.tm_create(size, align);
+            shared = tl.options && tl.tm_create_ex ? tl.tm_create_ex(size, align, tl.options) : tl.tm_create(size, align);
             if (unlikely(shared == STM::invalid_shared))
                 throw Exception::TransactionCreate{};
             start_addr = tl.tm_start(shared);
@@ -205,20 +389,38 @@ public:
     auto get_align() const noexcept {
         return alignment;
     }
+    /** Attach a recorder of the committed transactions, while no transaction runs.
+     * @param trace Recorder to attach, 'nullptr' to detach
+    **/
+    void set_recorder(TraceRecorder* trace) noexcept {
+        recorder = trace;
+    }
+    /** [thread-safe] Note a phase boundary of the calling thread in the attached recorder, if any, outside of any transaction.
+    **/
+    void trace_mark() const {
+        if (recorder)
+            recorder->mark();
+    }
 public:
     /** [thread-safe] Begin a new transaction on the shared memory region.
      * @param ro Whether the transaction is read-only
      * @return Opaque transaction ID, 'STM::invalid_tx' on failure
     **/
     auto begin(bool ro) const noexcept {
-        return tl.tm_begin(shared, ro);
+        auto tx = tl.tm_begin(shared, ro);
+        if (unlikely(recorder) && tx != STM::invalid_tx)
+            recorder->begin(ro);
+        return tx;
     }
     /** [thread-safe] End the given transaction.
      * @param tx Opaque transaction ID
      * @return Whether the whole transaction is a success
     **/
     auto end(TX tx) const noexcept {
-        return tl.tm_end(shared, tx);
+        auto res = tl.tm_end(shared, tx);
+        if (unlikely(recorder))
+            recorder->end(res);
+        return res;
     }
     /** [thread-safe] Read operation in the given transaction, source in the shared region and target in a private region.
      * @param tx     Transaction to use
@@ -228,8 +430,39 @@ public:
      * @return Whether the whole transaction can continue
     **/
     auto read(TX tx, void const* source, size_t size, void* target) const noexcept {
+        if (unlikely(recorder))
+            recorder->read(source, size);
+        return tl.tm_read(shared, tx, source, size, target);
+    }
+    /** [thread-safe] Read operation of a range the given transaction is about to write, a plain read if the library does not export 'tm_read_for_update'.
+     * @param tx     Transaction to use
+     * @param source Source start address
+     * @param size   Source/target range
+     * @param target Target start address
+     * @return Whether the whole transaction can continue
+    **/
+    auto read_for_update(TX tx, void const* source, size_t size, void* target) const noexcept {
+        if (unlikely(recorder))
+            recorder->read(source, size, true);
+        if (tl.tm_read_for_update)
+            return tl.tm_read_for_update(shared, tx, source, size, target);
         return tl.tm_read(shared, tx, source, size, target);
     }
+    /** [thread-safe] Read operation in the given transaction without a copy, if the library exports 'tm_read_view'.
+     * Never done while a recorder is attached, so that the trace holds a plain read instead.
+     * @param tx     Transaction to use
+     * @param source Source start address
+     * @param size   Source range
+     * @param view   Receives the range in place, valid until the transaction ends, 'nullptr' if it must be read with 'read' instead
+     * @return Whether the whole transaction can continue
+    **/
+    auto read_view(TX tx, void const* source, size_t size, void const** view) const noexcept {
+        if (!tl.tm_read_view || recorder) {
+            *view = nullptr;
+            return true;
+        }
+        return tl.tm_read_view(shared, tx, source, size, view);
+    }
     /** [thread-safe] Write operation in the given transaction, source in a private region and target in the shared region.
      * @param tx     Transaction to use
      * @param source Source start address
@@ -238,8 +471,147 @@ public:
      * @return Whether the whole transaction can continue
     **/
     auto write(TX tx, void const* source, size_t size, void* target) const noexcept {
+        if (unlikely(recorder))
+            recorder->write(source, size, target);
         return tl.tm_write(shared, tx, source, size, target);
     }
+    /** [thread-safe] Write operation in the given transaction without a copy, if the library exports 'tm_write_reserve'.
+     * Never done while a recorder is attached, as the trace holds the content of every write.
+     * @param tx     Transaction to use
+     * @param target Target start address
+     * @param size   Target range
+     * @param buffer Receives the room to fill with the whole new content before the next operation, 'nullptr' if it must be written with 'write' instead
+     * @return Whether the whole transaction can continue
+    **/
+    auto write_reserve(TX tx, void* target, size_t size, void** buffer) const noexcept {
+        if (!tl.tm_write_reserve || recorder) {
+            *buffer = nullptr;
+            return true;
+        }
+        return tl.tm_write_reserve(shared, tx, target, size, buffer);
+    }
+    /** [thread-safe] Read operation of one 8-byte word in the given transaction, through 'tm_read_word' if the library exports it and the alignment is 8.
+     * @param tx     Transaction to use
+     * @param source Source word address
+     * @param target Target word address
+     * @return Whether the whole transaction can continue
+    **/
+    auto read_word(TX tx, void const* source, void* target) const noexcept {
+        if (unlikely(recorder))
+            recorder->read(source, sizeof(uint64_t));
+        if (tl.tm_read_word && alignment == sizeof(uint64_t))
+            return tl.tm_read_word(shared, tx, source, target);
+        return tl.tm_read(shared, tx, source, sizeof(uint64_t), target);
+    }
+    /** [thread-safe] Write operation of one 8-byte word in the given transaction, through 'tm_write_word' if the library exports it and the alignment is 8.
+     * @param tx     Transaction to use
+     * @param source Source word address
+     * @param target Target word address
+     * @return Whether the whole transaction can continue
+    **/
+    auto write_word(TX tx, void const* source, void* target) const noexcept {
+        if (unlikely(recorder))
+            recorder->write(source, sizeof(uint64_t), target);
+        if (tl.tm_write_word && alignment == sizeof(uint64_t))
+            return tl.tm_write_word(shared, tx, source, target);
+        return tl.tm_write(shared, tx, source, sizeof(uint64_t), target);
+    }
+    /** [thread-safe] Add to a 64-bit integer in the given transaction, with a read and a write if the library does not export 'tm_add'.
+     * @param tx     Transaction to use
+     * @param target Integer to increment, aligned on the shared memory region alignment
+     * @param delta  Increment
+     * @return Whether the whole transaction can continue
+    **/
+    auto add(TX tx, void* target, int64_t delta) const noexcept {
+        if (unlikely(recorder))
+            recorder->add(target, delta);
+        if (tl.tm_add)
+            return tl.tm_add(shared, tx, target, delta);
+        // Whole words holding the integer
+        auto size = alignment < sizeof(uint64_t) ? sizeof(uint64_t) : alignment;
+        thread_local ::std::vector<uint8_t> buffer;
+        buffer.resize(size);
+        if (unlikely(!tl.tm_read(shared, tx, target, size, buffer.data())))
+            return false;
+        uint64_t value;
+        ::std::memcpy(&value, buffer.data(), sizeof(value));
+        value += static_cast<uint64_t>(delta);
+        ::std::memcpy(buffer.data(), &value, sizeof(value));
+        return tl.tm_write(shared, tx, buffer.data(), size, target);
+    }
+    /** [thread-safe] Early release of a range read by the given transaction, nothing if the library does not export 'tm_release'.
+     * @param tx     Transaction to use
+     * @param source Source start address
+     * @param size   Source range
+    **/
+    void release(TX tx, void const* source, size_t size) const noexcept {
+        if (unlikely(recorder))
+            recorder->release(source, size);
+        if (tl.tm_release)
+            tl.tm_release(shared, tx, source, size);
+    }
+    /** [thread-safe] Declare words the given transaction is about to access, nothing if the library does not export 'tm_hint'.
+     * @param tx         Transaction to use
+     * @param addresses  Start addresses of the words
+     * @param count      Number of addresses, at most 'TM_HINT_MAX'
+     * @param write_mask Bit 'i' set if the word at 'addresses[i]' will be written
+     * @return Whether the whole transaction can continue
+    **/
+    bool hint(TX tx, void const* const* addresses, size_t count, uint64_t write_mask) const noexcept {
+        if (tl.tm_hint)
+            return tl.tm_hint(shared, tx, addresses, count, write_mask);
+        return true;
+    }
+    /** [thread-safe] Write to the shared memory outside of any transaction, only while none runs, if the library exports 'tm_bulk_write'.
+     * Never done while a recorder is attached, so that the trace holds every write.
+     * @param source Private source
+     * @param size   Number of bytes to write, a positive multiple of the alignment
+     * @param target Shared target
+     * @return Whether the memory was written, else it must be written in transactions
+    **/
+    bool bulk_write(void const* source, size_t size, void* target) const noexcept {
+        if (!tl.tm_bulk_write || recorder)
+            return false;
+        return tl.tm_bulk_write(shared, source, size, target);
+    }
+    /** [thread-safe] Read several ranges in the given transaction, in one call if the library exports 'tm_read_batch'.
+     * @param tx       Transaction to use
+     * @param accesses Ranges to read, from shared 'address' to private 'buffer'
+     * @param count    Number of ranges
+     * @return Whether the whole transaction can continue
+    **/
+    auto read_batch(TX tx, struct STM::tm_access const* accesses, size_t count) const noexcept {
+        if (unlikely(recorder)) {
+            for (size_t i = 0; i < count; ++i)
+                recorder->read(accesses[i].address, accesses[i].size);
+        }
+        if (tl.tm_read_batch)
+            return tl.tm_read_batch(shared, tx, accesses, count);
+        for (size_t i = 0; i < count; ++i) {
+            if (unlikely(!tl.tm_read(shared, tx, accesses[i].address, accesses[i].size, accesses[i].buffer)))
+                return false;
+        }
+        return true;
+    }
+    /** [thread-safe] Write several ranges in the given transaction, in one call if the library exports 'tm_write_batch'.
+     * @param tx       Transaction to use
+     * @param accesses Ranges to write, from private 'buffer' to shared 'address'
+     * @param count    Number of ranges
+     * @return Whether the whole transaction can continue
+    **/
+    auto write_batch(TX tx, struct STM::tm_access const* accesses, size_t count) const noexcept {
+        if (unlikely(recorder)) {
+            for (size_t i = 0; i < count; ++i)
+                recorder->write(accesses[i].buffer, accesses[i].size, accesses[i].address);
+        }
+        if (tl.tm_write_batch)
+            return tl.tm_write_batch(shared, tx, accesses, count);
+        for (size_t i = 0; i < count; ++i) {
+            if (unlikely(!tl.tm_write(shared, tx, accesses[i].buffer, accesses[i].size, accesses[i].address)))
+                return false;
+        }
+        return true;
+    }
     /** [thread-safe] Memory allocation operation in the given transaction, throw if no memory available.
      * @param tx     Transaction to use
      * @param size   Size to allocate
@@ -247,7 +619,10 @@ public:
      * @return Allocation status
     **/
     auto alloc(TX tx, size_t size, void** target) const noexcept {
-        return tl.tm_alloc(shared, tx, size, target);
+        auto res = tl.tm_alloc(shared, tx, size, target);
+        if (unlikely(recorder) && res == STM::Alloc::success)
+            recorder->alloc(size, *target);
+        return res;
     }
     /** [thread-safe] Memory freeing operation in the given transaction.
      * @param tx     Transaction to use
@@ -255,8 +630,87 @@ public:
      * @return Whether the whole transaction can continue
     **/
     auto free(TX tx, void* target) const noexcept {
+        if (unlikely(recorder))
+            recorder->free(target);
         return tl.tm_free(shared, tx, target);
     }
+    /** [thread-safe] Memory resizing operation in the given transaction, with an allocation, a copy and a free if the library does not export 'tm_realloc'.
+     * Always moved while a recorder is attached, so that the trace holds operations any library replays.
+     * @param tx       Transaction to use
+     * @param segment  Start address of the segment to resize
+     * @param old_size Size of the segment
+     * @param size     New size
+     * @param target   Target start address, of the resized segment
+     * @return Allocation status
+    **/
+    auto realloc(TX tx, void* segment, size_t old_size, size_t size, void** target) const noexcept {
+        if (tl.tm_realloc && !recorder)
+            return tl.tm_realloc(shared, tx, segment, old_size, size, target);
+        auto res = alloc(tx, size, target);
+        if (res != STM::Alloc::success)
+            return res;
+        auto length = old_size < size ? old_size : size;
+        thread_local ::std::vector<uint8_t> buffer;
+        buffer.resize(length);
+        if (unlikely(!read(tx, segment, length, buffer.data()) || !write(tx, buffer.data(), length, *target) || !free(tx, segment)))
+            return STM::Alloc::abort;
+        return STM::Alloc::success;
+    }
+    /** [thread-safe] Run a transaction until it commits, retrying in the library if it exports 'tm_run' and no recorder is attached, here otherwise.
+     * @param ro   Whether the transaction is read-only
+     * @param body Body of the transaction, returning false as soon as one of its operations failed
+     * @param ctx  Argument passed to the body
+     * @return Whether the transaction committed, false only if it could not begin
+    **/
+    auto run(bool ro, bool (*body)(Shared, TX, void*), void* ctx) const noexcept {
+        if (tl.tm_run && !recorder)
+            return tl.tm_run(shared, ro, body, ctx);
+        while (true) {
+            auto tx = begin(ro);
+            if (unlikely(tx == STM::invalid_tx))
+                return false;
+            if (likely(body(shared, tx, ctx) && end(tx)))
+                return true;
+        }
+    }
+    /** [thread-safe] Register the calling thread before its first transaction, nothing if the library does not export 'tm_thread_enter'.
+    **/
+    void thread_enter() const noexcept {
+        if (tl.tm_thread_enter && tl.tm_thread_leave)
+            tl.tm_thread_enter(shared);
+    }
+    /** [thread-safe] Unregister the calling thread after its last transaction, nothing if the library does not export 'tm_thread_leave'.
+    **/
+    void thread_leave() const noexcept {
+        if (tl.tm_thread_enter && tl.tm_thread_leave)
+            tl.tm_thread_leave(shared);
+    }
+    /** [thread-safe] Query the statistics of the shared memory region, if the library keeps some.
+     * @param stats Statistics to fill
+     * @return Whether the statistics were filled
+    **/
+    auto stats(struct STM::tm_stats& stats) const noexcept {
+        return tl.tm_stats && tl.tm_stats(shared, &stats);
+    }
+};
+
+/** Registration of the calling thread with a shared memory region, for the lifetime of the instance.
+**/
+class TransactionalThread final: private NonCopyable {
+private:
+    TransactionalMemory const& tm; // Bound transactional memory
+public:
+    /** Register constructor.
+     * @param tm Transactional memory to bind
+    **/
+    TransactionalThread(TransactionalMemory const& tm): tm{tm} {
+        tm.thread_enter();
+    }
+    /** Unregister destructor.
+    **/
+    ~TransactionalThread() noexcept {
+        tm.thread_leave();
+    }
 };
 
 /** One transaction over a shared memory region management class.
@@ -271,6 +725,7 @@ public:
     };
 private:
     TransactionalMemory const& tm; // Bound transactional memory
+    CommitOrder::Turn turn; // Turn in the deterministic commit order, before the handle so the round begins first
     STM::tx_t tx; // Opaque transaction handle
     bool aborted; // Transaction was aborted
     bool is_ro;   // Whether the transaction is read-only (solely for assertion)
@@ -283,7 +738,7 @@ public:
      * @param tm Transactional memory to bind
      * @param ro Whether the transaction is read-only
     **/
-    Transaction(TransactionalMemory const& tm, Mode ro): tm{tm}, tx{tm.begin(static_cast<bool>(ro))}, aborted{false}, is_ro{static_cast<bool>(ro)} {
+    Transaction(TransactionalMemory const& tm, Mode ro): tm{tm}, turn{}, tx{tm.begin(static_cast<bool>(ro))}, aborted{false}, is_ro{static_cast<bool>(ro)} {
         if (unlikely(tx == STM::invalid_tx))
             throw Exception::TransactionBegin{};
     }
@@ -291,8 +746,10 @@ public:
     **/
     ~Transaction() noexcept(false) {
         if (likely(!aborted)) {
+            turn.wait();
             if (unlikely(!tm.end(tx)))
                 throw Exception::TransactionRetry{};
+            turn.pass(true);
         }
     }
 public:
@@ -314,6 +771,44 @@ public:
             throw Exception::TransactionRetry{};
         }
     }
+    /** [thread-safe] Read operation in the bound transaction, of a range it is about to write.
+     * @param source Source start address
+     * @param size   Source/target range
+     * @param target Target start address
+    **/
+    void read_for_update(void const* source, size_t size, void* target) {
+        if (unlikely(!tm.read_for_update(tx, source, size, target))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
+    /** [thread-safe] Read operation in the bound transaction without a copy, see 'TransactionalMemory::read_view'.
+     * The view is not opaque: what it shows may change until the transaction ends, which then aborts.
+     * @param source Source start address
+     * @param size   Source range
+     * @return Range in place, valid until the transaction ends, 'nullptr' if it must be read with 'read' instead
+    **/
+    void const* read_view(void const* source, size_t size) {
+        void const* view;
+        if (unlikely(!tm.read_view(tx, source, size, &view))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+        return view;
+    }
+    /** [thread-safe] Write operation in the bound transaction without a copy, see 'TransactionalMemory::write_reserve'.
+     * @param target Target start address
+     * @param size   Target range
+     * @return Room to fill with the whole new content before the next operation, 'nullptr' if it must be written with 'write' instead
+    **/
+    void* write_reserve(void* target, size_t size) {
+        void* buffer;
+        if (unlikely(!tm.write_reserve(tx, target, size, &buffer))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+        return buffer;
+    }
     /** [thread-safe] Write operation in the bound transaction, source in a private region and target in the shared region.
      * @param source Source start address
      * @param size   Source/target range
@@ -327,6 +822,80 @@ public:
             throw Exception::TransactionRetry{};
         }
     }
+    /** [thread-safe] Read operation of one 8-byte word in the bound transaction.
+     * @param source Source word address
+     * @param target Target word address
+    **/
+    void read_word(void const* source, void* target) {
+        if (unlikely(!tm.read_word(tx, source, target))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
+    /** [thread-safe] Write operation of one 8-byte word in the bound transaction.
+     * @param source Source word address
+     * @param target Target word address
+    **/
+    void write_word(void const* source, void* target) {
+        if (unlikely(assert_mode && is_ro))
+            throw Exception::TransactionReadOnly{};
+        if (unlikely(!tm.write_word(tx, source, target))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
+    /** [thread-safe] Early release of a range read by the bound transaction, which does not depend on it anymore.
+     * @param source Source start address
+     * @param size   Source range
+    **/
+    void release(void const* source, size_t size) noexcept {
+        tm.release(tx, source, size);
+    }
+    /** [thread-safe] Add to a 64-bit integer in the bound transaction, commutatively with the other increments.
+     * @param target Integer to increment
+     * @param delta  Increment
+    **/
+    void add(void* target, int64_t delta) {
+        if (unlikely(assert_mode && is_ro))
+            throw Exception::TransactionReadOnly{};
+        if (unlikely(!tm.add(tx, target, delta))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
+    /** [thread-safe] Declare words the bound transaction is about to access, e.g. right after it began.
+     * @param addresses  Start addresses of the words
+     * @param count      Number of addresses, at most 'TM_HINT_MAX'
+     * @param write_mask Bit 'i' set if the word at 'addresses[i]' will be written
+    **/
+    void hint(void const* const* addresses, size_t count, uint64_t write_mask) {
+        if (unlikely(!tm.hint(tx, addresses, count, write_mask))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
+    /** [thread-safe] Read several ranges in the bound transaction.
+     * @param accesses Ranges to read, from shared 'address' to private 'buffer'
+     * @param count    Number of ranges
+    **/
+    void read_batch(struct STM::tm_access const* accesses, size_t count) {
+        if (unlikely(!tm.read_batch(tx, accesses, count))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
+    /** [thread-safe] Write several ranges in the bound transaction.
+     * @param accesses Ranges to write, from private 'buffer' to shared 'address'
+     * @param count    Number of ranges
+    **/
+    void write_batch(struct STM::tm_access const* accesses, size_t count) {
+        if (unlikely(assert_mode && is_ro))
+            throw Exception::TransactionReadOnly{};
+        if (unlikely(!tm.write_batch(tx, accesses, count))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
     /** [thread-safe] Memory allocation operation in the bound transaction, throw if no memory available.
      * @param size Size to allocate
      * @return Target start address
@@ -345,6 +914,26 @@ public:
             throw Exception::TransactionRetry{};
         }
     }
+    /** [thread-safe] Memory resizing operation in the bound transaction, throw if no memory available.
+     * @param segment  Start address of the segment to resize
+     * @param old_size Size of the segment
+     * @param size     New size
+     * @return Start address of the resized segment, 'segment' if resized in place
+    **/
+    void* realloc(void* segment, size_t old_size, size_t size) {
+        if (unlikely(assert_mode && is_ro))
+            throw Exception::TransactionReadOnly{};
+        void* target;
+        switch (tm.realloc(tx, segment, old_size, size, &target)) {
+        case STM::Alloc::success:
+            return target;
+        case STM::Alloc::nomem:
+            throw Exception::TransactionAlloc{};
+        default: // STM::Alloc::abort
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
     /** [thread-safe] Memory freeing operation in the bound transaction.
      * @param target Target start address
     **/
@@ -391,21 +980,47 @@ public:
     **/
     Type read() const {
         Type res;
-        tx.read(address, sizeof(Type), &res);
+        if constexpr (sizeof(Type) == sizeof(uint64_t))
+            tx.read_word(address, &res);
+        else
+            tx.read(address, sizeof(Type), &res);
         return res;
     }
     operator Type() const {
         return read();
     }
+    /** Read operation, of a content about to be written.
+     * @return Private copy of the content at the shared address
+    **/
+    Type read_for_update() const {
+        Type res;
+        tx.read_for_update(address, sizeof(Type), &res);
+        return res;
+    }
     /** Write operation.
      * @param source Private content to write at the shared address
     **/
     void write(Type const& source) const {
-        tx.write(&source, sizeof(Type), address);
+        if constexpr (sizeof(Type) == sizeof(uint64_t))
+            tx.write_word(&source, address);
+        else
+            tx.write(&source, sizeof(Type), address);
     }
     void operator=(Type const& source) const {
         return write(source);
     }
+    /** Commutative increment, without reading the content.
+     * @param delta Increment
+    **/
+    void add(int64_t delta) const {
+        static_assert(sizeof(Type) == sizeof(uint64_t) && ::std::is_integral<Type>::value, "only 64-bit integers can be incremented");
+        tx.add(address, delta);
+    }
+    /** Early release, the transaction does not depend on the content read anymore.
+    **/
+    void release() const noexcept {
+        tx.release(address, sizeof(Type));
+    }
 public:
     /** Address of the first byte after the entry.
      * @return First byte after the entry
@@ -442,7 +1057,10 @@ public:
     **/
     Type* read() const {
         Type* res;
-        tx.read(address, sizeof(Type*), &res);
+        if constexpr (sizeof(Type*) == sizeof(uint64_t))
+            tx.read_word(address, &res);
+        else
+            tx.read(address, sizeof(Type*), &res);
         return res;
     }
     operator Type*() const {
@@ -452,11 +1070,19 @@ public:
      * @param source Private content to write at the shared address
     **/
     void write(Type* source) const {
-        tx.write(&source, sizeof(Type*), address);
+        if constexpr (sizeof(Type*) == sizeof(uint64_t))
+            tx.write_word(&source, address);
+        else
+            tx.write(&source, sizeof(Type*), address);
     }
     void operator=(Type* source) const {
         return write(source);
     }
+    /** Early release, the transaction does not depend on the content read anymore.
+    **/
+    void release() const noexcept {
+        tx.release(address, sizeof(Type*));
+    }
     /** Allocate and write operation.
      * @param size Size to allocate (defaults to size of the underlying class)
      * @return Private copy of the just-written content at the shared address
@@ -484,6 +1110,110 @@ public:
         return address + 1;
     }
 };
+/** Pointer as stored in shared memory: the offset of the target from the start of the first shared segment, so that the region may be mapped anywhere.
+ * The offset is biased by one, so that zeroed shared memory (e.g. a freshly allocated segment) holds 'nullptr'.
+ * @param Type Pointed type
+**/
+template<class Type> class Relative final {
+private:
+    uint64_t word; // Offset of the target from the start of the first shared segment plus one, 0 for 'nullptr'
+public:
+    /** Encode a pointer into shared memory.
+     * @param base   Start of the first shared segment
+     * @param target Target of the pointer, 'nullptr' for none
+     * @return Relative pointer
+    **/
+    static Relative encode(void const* base, Type const* target) noexcept {
+        Relative res;
+        res.word = target ? reinterpret_cast<uintptr_t>(target) - reinterpret_cast<uintptr_t>(base) + 1 : 0;
+        return res;
+    }
+    /** Decode into a pointer in the current mapping of the region.
+     * @param base Start of the first shared segment
+     * @return Target of the pointer, 'nullptr' for none
+    **/
+    Type* decode(void const* base) const noexcept {
+        return word != 0 ? reinterpret_cast<Type*>(reinterpret_cast<uintptr_t>(base) + word - 1) : nullptr;
+    }
+};
+template<class Type> class Shared<Relative<Type>> {
+protected:
+    Transaction& tx; // Bound transaction
+    Relative<Type>* address; // Address in shared memory
+    void const* base; // Start of the first shared segment, the origin of the offsets
+public:
+    /** Binding constructor.
+     * @param tx      Bound transaction
+     * @param address Address to bind to
+    **/
+    Shared(Transaction& tx, void* address): tx{tx}, address{reinterpret_cast<Relative<Type>*>(address)}, base{tx.get_tm().get_start()} {
+        if (unlikely(assert_mode && reinterpret_cast<uintptr_t>(address) % tx.get_tm().get_align() != 0))
+            throw Exception::SharedAlign{};
+        if (unlikely(assert_mode && reinterpret_cast<uintptr_t>(address) % alignof(Relative<Type>) != 0))
+            throw Exception::SharedAlign{};
+    }
+public:
+    /** Get the address in shared memory.
+     * @return Address in shared memory
+    **/
+    auto get() const noexcept {
+        return address;
+    }
+public:
+    /** Read operation.
+     * @return Target of the pointer at the shared address
+    **/
+    Type* read() const {
+        Relative<Type> res;
+        tx.read_word(address, &res);
+        return res.decode(base);
+    }
+    operator Type*() const {
+        return read();
+    }
+    /** Write operation.
+     * @param target Target of the pointer to write at the shared address
+    **/
+    void write(Type* target) const {
+        auto source = Relative<Type>::encode(base, target);
+        tx.write_word(&source, address);
+    }
+    void operator=(Type* target) const {
+        return write(target);
+    }
+    /** Early release, the transaction does not depend on the content read anymore.
+    **/
+    void release() const noexcept {
+        tx.release(address, sizeof(Relative<Type>));
+    }
+    /** Allocate and write operation.
+     * @param size Size to allocate (defaults to size of the underlying class)
+     * @return Target of the just-written pointer
+    **/
+    Type* alloc(size_t size = 0) const {
+        if (unlikely(assert_mode && read() != nullptr))
+            throw Exception::SharedDoubleAlloc{};
+        auto addr = reinterpret_cast<Type*>(tx.alloc(size > 0 ? size: sizeof(Type)));
+        write(addr);
+        return addr;
+    }
+    /** Free and write operation.
+    **/
+    void free() const {
+        auto target = read();
+        if (unlikely(assert_mode && target == nullptr))
+            throw Exception::SharedDoubleFree{};
+        tx.free(target);
+        write(nullptr);
+    }
+public:
+    /** Address of the first byte after the entry.
+     * @return First byte after the entry
+    **/
+    void* after() const noexcept {
+        return address + 1;
+    }
+};
 template<class Type> class Shared<Type[]> {
 protected:
     Transaction& tx; // Bound transaction
@@ -516,6 +1246,27 @@ public:
         tx.read(address + index, sizeof(Type), &res);
         return res;
     }
+    /** Batched read operation, one access per cell.
+     * @param index  Index of the first cell to read
+     * @param length Number of cells to read
+     * @param target Private array receiving the cells
+    **/
+    void read(size_t index, size_t length, Type* target) const {
+        thread_local ::std::vector<struct STM::tm_access> accesses;
+        accesses.resize(length);
+        for (size_t i = 0; i < length; ++i)
+            accesses[i] = {address + index + i, sizeof(Type), target + i};
+        tx.read_batch(accesses.data(), length);
+    }
+    /** Range read operation, a single read of the contiguous cells.
+     * @param first  Index of the first cell to read
+     * @param count  Number of cells to read
+     * @param target Private array receiving the cells
+    **/
+    void read_range(size_t first, size_t count, Type* target) const {
+        if (count > 0)
+            tx.read(address + first, count * sizeof(Type), target);
+    }
     /** Write operation.
      * @param index  Index to write
      * @param source Private content to write at the shared address
@@ -602,6 +1353,114 @@ public:
 
 // -------------------------------------------------------------------------- //
 
+/** Attempts and aborts of the 'transactional' loops, per transaction mode, summed over all the threads.
+**/
+class RetryStats final {
+public:
+    /** Totals of one transaction mode.
+    **/
+    struct Totals {
+        uint_fast64_t attempts; // Attempts, committed ones included
+        uint_fast64_t aborts;   // Attempts that aborted
+        Chrono::Tick  wasted;   // Time spent in the aborted attempts (in ns)
+    };
+private:
+    /** Counters of one thread, only written by that thread.
+    **/
+    struct alignas(64) Local final: private NonCopyable {
+        ::std::atomic<uint_fast64_t> attempts[2];
+        ::std::atomic<uint_fast64_t> aborts[2];
+        ::std::atomic<Chrono::Tick>  wasted[2];
+        /** Registration constructor.
+        **/
+        Local() noexcept: attempts{}, aborts{}, wasted{} {
+            ::std::unique_lock<decltype(lock)> guard{lock};
+            locals.push_back(this);
+        }
+        /** Unregistration destructor, the counts go to the retired totals.
+        **/
+        ~Local() noexcept {
+            ::std::unique_lock<decltype(lock)> guard{lock};
+            for (auto mode = 0; mode < 2; ++mode) {
+                retired[mode].attempts += attempts[mode].load(::std::memory_order_relaxed);
+                retired[mode].aborts += aborts[mode].load(::std::memory_order_relaxed);
+                retired[mode].wasted += wasted[mode].load(::std::memory_order_relaxed);
+            }
+            locals.erase(::std::find(locals.begin(), locals.end(), this));
+        }
+    };
+private:
+    inline static ::std::mutex         lock;       // Lock of 'locals' and 'retired'
+    inline static ::std::vector<Local*> locals;    // Counters of the live threads
+    inline static Totals               retired[2]; // Counts of the threads that exited
+    /** Get the counters of the calling thread.
+     * @return Counters of the calling thread
+    **/
+    static Local& local() {
+        thread_local Local res;
+        return res;
+    }
+    /** Add to a counter of the calling thread.
+     * @param counter Counter to increment
+     * @param delta   Increment
+    **/
+    template<class Type> static void bump(::std::atomic<Type>& counter, Type delta) noexcept {
+        counter.store(counter.load(::std::memory_order_relaxed) + delta, ::std::memory_order_relaxed);
+    }
+public:
+    /** Count one attempt of the calling thread.
+     * @param mode Transactional mode
+    **/
+    static void attempt(Transaction::Mode mode) {
+        bump(local().attempts[static_cast<bool>(mode)], uint_fast64_t{1});
+    }
+    /** Count one abort of the calling thread.
+     * @param mode  Transactional mode
+     * @param ticks Duration of the aborted attempt (in ns)
+    **/
+    static void abort(Transaction::Mode mode, Chrono::Tick ticks) {
+        auto& res = local();
+        bump(res.aborts[static_cast<bool>(mode)], uint_fast64_t{1});
+        bump(res.wasted[static_cast<bool>(mode)], ticks);
+    }
+    /** Sum the counters of all the threads, exact only while none is running transactions.
+     * @param mode Transactional mode
+     * @return Totals so far
+    **/
+    static Totals snapshot(Transaction::Mode mode) {
+        auto i = static_cast<bool>(mode);
+        ::std::unique_lock<decltype(lock)> guard{lock};
+        auto res = retired[i];
+        for (auto local: locals) {
+            res.attempts += local->attempts[i].load(::std::memory_order_relaxed);
+            res.aborts += local->aborts[i].load(::std::memory_order_relaxed);
+            res.wasted += local->wasted[i].load(::std::memory_order_relaxed);
+        }
+        return res;
+    }
+    /** Sum the commits of all the threads, in both modes, while they run.
+     * @return Commits so far, each running attempt counted as one
+    **/
+    static uint_fast64_t commits() {
+        uint_fast64_t res = 0;
+        for (auto mode: {Transaction::Mode::read_write, Transaction::Mode::read_only}) {
+            auto totals = snapshot(mode);
+            res += totals.attempts - totals.aborts;
+        }
+        return res;
+    }
+    /** Count the commits of the calling thread, in both modes.
+     * @return Commits of the calling thread so far, its running attempt counted as one
+    **/
+    static uint_fast64_t own_commits() {
+        auto& res = local();
+        uint_fast64_t count = 0;
+        for (auto i = 0; i < 2; ++i)
+            count += res.attempts[i].load(::std::memory_order_relaxed) - res.aborts[i].load(::std::memory_order_relaxed);
+        return count;
+    }
+};
+
 /** Repeat a given transaction until it commits.
  * @param tm   Transactional memory
  * @param mode Transactional mode
@@ -609,12 +1468,136 @@ public:
  * @return Returned value (or void) when the transaction committed
 **/
 template<class Func> static auto transactional(TransactionalMemory const& tm, Transaction::Mode mode, Func&& func) {
+    FastChrono chrono;
     do {
+        RetryStats::attempt(mode);
+        chrono.start();
         try {
             Transaction tx{tm, mode};
             return func(tx);
         } catch (Exception::TransactionRetry const&) {
+            RetryStats::abort(mode, chrono.delta());
             continue;
         }
     } while (true);
 }
+
+/** Repeat a given transaction until it commits, without exceptions: the closure checks the outcome of each operation itself.
+ * Retries happen in the library if it exports 'tm_run', so an abort costs no unwinding.
+ * @param tm   Transactional memory
+ * @param mode Transactional mode
+ * @param func Transaction closure (TransactionalMemory::TX -> bool), returning false as soon as an operation of 'tm' failed
+ * @return Whether the transaction committed, false only if it could not begin
+**/
+template<class Func> static bool transactional_noexcept(TransactionalMemory const& tm, Transaction::Mode mode, Func&& func) noexcept {
+    return tm.run(static_cast<bool>(mode), [](TransactionalMemory::Shared, TransactionalMemory::TX tx, void* ctx) {
+        return (*static_cast<::std::remove_reference_t<Func>*>(ctx))(tx);
+    }, &func);
+}
+
+/** Coalescing of small independent transactions, queued by any thread and run together by the caller that finds no batch running.
+ * Up to 'limit' queued closures run in one transaction, so they share its fixed cost; a batch that aborts is split in halves, each
+ * retried on its own, down to single closures repeated until they commit. The limit follows the outcomes: halved when a batch had
+ * to be split, grown by one when it committed at once, up to the maximum. Each closure must be independent of the others (it may
+ * run in a transaction with any of them, in any order) and, as with 'transactional', may run several times before committing.
+**/
+class Coalescer final: private NonCopyable {
+public:
+    using Closure = ::std::function<void(Transaction&)>;
+private:
+    /** Closure waiting for its completion.
+    **/
+    struct Request {
+        Closure const* func;       // Closure to run
+        ::std::exception_ptr error; // Exception the closure threw, if any
+        bool done;                  // Whether the closure committed or threw, under 'lock'
+    };
+private:
+    TransactionalMemory const& tm; // Bound transactional memory
+    Transaction::Mode mode;        // Transactional mode of the batches
+    size_t max;                    // Most closures per transaction
+    size_t limit;                  // Closures per transaction for the next batch, under 'lock'
+    ::std::mutex lock;
+    ::std::condition_variable wake; // Signaled when batches complete
+    ::std::vector<Request*> queue;  // Requests not taken by a batch yet, under 'lock'
+    bool running;                   // Whether a caller runs batches, under 'lock'
+public:
+    /** Bind constructor.
+     * @param tm   Transactional memory to bind
+     * @param max  Most closures per transaction
+     * @param mode Transactional mode of the batches
+    **/
+    Coalescer(TransactionalMemory const& tm, size_t max = 16, Transaction::Mode mode = Transaction::Mode::read_write): tm{tm}, mode{mode}, max{max > 0 ? max : 1}, limit{this->max}, running{false} {}
+private:
+    /** Run requests in one transaction, split in halves as long as it aborts.
+     * A closure throwing anything but a retry leaves its exception to its caller: the transaction then commits what ran so far.
+     * @param batch First request
+     * @param count Number of requests
+     * @return Whether all the requests committed in a single attempt
+    **/
+    bool execute(Request** batch, size_t count) {
+        if (count == 0)
+            return true;
+        if (count == 1) {
+            try {
+                transactional(tm, mode, *batch[0]->func);
+            } catch (...) {
+                batch[0]->error = ::std::current_exception();
+            }
+            return true;
+        }
+        FastChrono chrono;
+        size_t i = 0;
+        RetryStats::attempt(mode);
+        chrono.start();
+        try {
+            Transaction tx{tm, mode};
+            for (; i < count; ++i)
+                (*batch[i]->func)(tx);
+            return true;
+        } catch (Exception::TransactionRetry const&) {
+            RetryStats::abort(mode, chrono.delta());
+        } catch (...) {
+            batch[i]->error = ::std::current_exception();
+            execute(batch + i + 1, count - i - 1);
+            return false;
+        }
+        auto half = count / 2;
+        execute(batch, half);
+        execute(batch + half, count - half);
+        return false;
+    }
+public:
+    /** [thread-safe] Run a closure in a transaction shared with other queued closures, returning once that transaction committed.
+     * @param func Transaction closure, rethrowing what it threw to the caller
+    **/
+    void run(Closure const& func) {
+        Request request{&func, nullptr, false};
+        ::std::unique_lock<decltype(lock)> guard{lock};
+        queue.push_back(&request);
+        while (!request.done) {
+            if (running) {
+                wake.wait(guard);
+                continue;
+            }
+            // Lead until the own request completes, then let a waiter take over
+            running = true;
+            while (!request.done) {
+                auto count = ::std::min(limit, queue.size());
+                ::std::vector<Request*> batch{queue.begin(), queue.begin() + count};
+                queue.erase(queue.begin(), queue.begin() + count);
+                guard.unlock();
+                auto at_once = execute(batch.data(), count);
+                guard.lock();
+                limit = at_once ? ::std::min(limit + 1, max) : ::std::max(limit / 2, size_t{1});
+                for (auto taken: batch)
+                    taken->done = true;
+                wake.notify_all();
+            }
+            running = false;
+            wake.notify_all();
+        }
+        if (request.error)
+            ::std::rethrow_exception(request.error);
+    }
+};
@@ -24,11 +24,21 @@
 #pragma once
 
 // External headers
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <map>
+#include <optional>
 #include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 // Internal headers
 #include "common.hpp"
+#include "distribution.hpp"
 
 // -------------------------------------------------------------------------- //
 
@@ -40,12 +50,77 @@ using Uid = uint_fast32_t;
 **/
 using Seed = uint_fast32_t;
 
+/** Arrivals of the transactions of one worker, and their latencies.
+ * In open loop, the transactions arrive on a Poisson schedule and their latency counts from their scheduled arrival (so a late start is not forgiven).
+ * In closed loop, each transaction starts as soon as the previous one ends.
+**/
+class Pacer final {
+private:
+    bool   open;      // Whether the transactions arrive on a schedule
+    ::std::minstd_rand arrivals; // Apart from the worker's engine, so that the transactions are the same as in closed loop
+    ::std::exponential_distribution<double> interarrival; // Time between arrivals (in ns)
+    FastChrono epoch;  // Start of the schedule
+    FastChrono chrono; // Start of the current attempt
+    double scheduled; // Scheduled arrival of the current transaction (in ns since 'epoch')
+public:
+    /** Schedule constructor.
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed loop
+     * @param nbworkers    Number of workers sharing the arrival rate
+     * @param seed         Seed of the worker
+    **/
+    Pacer(double arrival_rate, size_t nbworkers, Seed seed): open{arrival_rate > 0.}, arrivals{seed + 1}, interarrival{open ? arrival_rate / static_cast<double>(nbworkers) / 1000000000. : 1.}, scheduled{0.} {
+        epoch.start();
+    }
+public:
+    /** Tell whether the transactions arrive on a schedule.
+     * @return Whether in open loop
+    **/
+    bool is_open() const noexcept {
+        return open;
+    }
+    /** Wait for the arrival of the next transaction, sleeping if far enough, no-op in closed loop.
+    **/
+    void wait() {
+        if (!open)
+            return;
+        scheduled += interarrival(arrivals);
+        while (true) {
+            auto ahead = scheduled - static_cast<double>(epoch.delta());
+            if (ahead <= 0.)
+                break;
+            if (ahead > 100000.) {
+                ::std::this_thread::sleep_for(::std::chrono::nanoseconds{static_cast<Chrono::Tick>(ahead) - 50000});
+            } else {
+                short_pause();
+            }
+        }
+    }
+    /** Start an attempt of the current transaction.
+    **/
+    void start() noexcept {
+        chrono.start();
+    }
+    /** Get the duration of the current attempt.
+     * @return Time since the last 'start' (in ns)
+    **/
+    Chrono::Tick attempt() noexcept {
+        return chrono.delta();
+    }
+    /** Get the latency of the current transaction, once done.
+     * @return Time since its scheduled arrival in open loop, since the last 'start' otherwise (in ns)
+    **/
+    Chrono::Tick latency() noexcept {
+        return open ? static_cast<Chrono::Tick>(static_cast<double>(epoch.delta()) - scheduled) : chrono.delta();
+    }
+};
+
 /** Workload base class.
 **/
 class Workload {
 protected:
     TransactionalLibrary const& tl;  // Associated transactional library
     TransactionalMemory         tm;  // Built transactional memory to use
+    ::std::atomic<bool>   stopping;  // Whether the ongoing duration-based runs must end
 public:
     /** Deleted copy constructor/assignment.
     **/
@@ -56,11 +131,100 @@ public:
      * @param align   Shared memory region required alignment
      * @param size    Size of the shared memory region to allocate
     **/
-    Workload(TransactionalLibrary const& library, size_t align, size_t size): tl{library}, tm{tl, align, size} {}
+    Workload(TransactionalLibrary const& library, size_t align, size_t size): tl{library}, tm{tl, align, size}, stopping{false} {}
     /** Virtual destructor.
     **/
     virtual ~Workload() {};
 public:
+    /** Return the transactional memory the workload runs on.
+     * @return Bound transactional memory
+    **/
+    auto const& get_tm() const noexcept {
+        return tm;
+    }
+    /** Attach a recorder of the committed transactions on the shared memory, while no worker runs.
+     * @param recorder Recorder to attach, 'nullptr' to detach
+    **/
+    void set_recorder(TraceRecorder* recorder) noexcept {
+        tm.set_recorder(recorder);
+    }
+    /** [thread-safe] Ask the workers to end their duration-based runs, or clear the request before the next runs.
+     * @param value Whether the runs must end
+    **/
+    void set_stopping(bool value) noexcept {
+        stopping.store(value, ::std::memory_order_relaxed);
+    }
+protected:
+    /** [thread-safe] Worker's false negative-free check on two counters in the first words of the shared memory, overwritten.
+     * @param uid       Unique ID (between 0 to n-1)
+     * @param nbworkers Number of concurrent workers
+     * @param barrier   Barrier of the workers
+     * @return Constant null-terminated error message, 'nullptr' for none
+    **/
+    char const* check_counters(Uid uid, size_t nbworkers, Barrier const& barrier) const {
+        constexpr size_t nbtxperwrk = 100;
+        // Second counter, only incremented commutatively, in the next word that can hold it
+        auto hits = reinterpret_cast<uint8_t*>(tm.get_start()) + (tm.get_align() < sizeof(size_t) ? sizeof(size_t) : tm.get_align());
+        barrier.sync(uid);
+        if (uid == 0) { // Initialization
+            auto init_counter = nbtxperwrk * nbworkers;
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                Shared<size_t> counter{tx, tm.get_start()};
+                counter = init_counter;
+                Shared<size_t>{tx, hits} = init_counter;
+            });
+            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                Shared<size_t> counter{tx, tm.get_start()};
+                return counter == init_counter && Shared<size_t>{tx, hits} == init_counter;
+            });
+            if (unlikely(!correct)) {
+                barrier.sync(uid);
+                barrier.sync(uid);
+                return "Violated consistency";
+            }
+        }
+        barrier.sync(uid);
+        for (size_t i = 0; i < nbtxperwrk; ++i) {
+            auto last = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                Shared<size_t> counter{tx, tm.get_start()};
+                return counter.read();
+            });
+            auto correct = transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                Shared<size_t> counter{tx, tm.get_start()};
+                auto value = counter.read();
+                if (unlikely(value > last))
+                    return false;
+                counter = value - 1;
+                return true;
+            });
+            if (unlikely(!correct)) {
+                barrier.sync(uid);
+                return "Violated consistency, isolation or atomicity";
+            }
+        }
+        for (size_t i = 0; i < nbtxperwrk; ++i) {
+            transactional_noexcept(tm, Transaction::Mode::read_write, [&](TransactionalMemory::TX tx) {
+                return tm.add(tx, hits, -1);
+            });
+        }
+        barrier.sync(uid);
+        if (uid == 0) {
+            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                Shared<size_t> counter{tx, tm.get_start()};
+                return counter == 0 && Shared<size_t>{tx, hits} == 0;
+            });
+            if (unlikely(!correct))
+                return "Violated consistency";
+        }
+        return nullptr;
+    }
+public:
+    /** [thread-safe] Worker's share of the loading of the shared memory, before any transaction runs (nothing by default).
+     * The workers all load before any of them calls 'init', so a workload can write its share with 'TransactionalMemory::bulk_write'.
+     * @param Unique ID (between 0 to n-1)
+     * @param Number of workers loading
+    **/
+    virtual void load(Uid, size_t) const {}
     /** Shared memory (re)initialization.
      * @return Constant null-terminated error message, 'nullptr' for none
     **/
@@ -77,18 +241,52 @@ public:
      * @return Constant null-terminated error message, 'nullptr' for none
     **/
     virtual char const* check(Uid, Seed) const = 0;
+    /** Merge the latencies measured by the workers, to call once they are done.
+     * @return Name and latency histogram of each class of transactions run so far, in a fixed order, the main class last (none by default)
+    **/
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        return {};
+    }
+    /** Get the average number of bytes a transaction copies from and to shared memory.
+     * @return Bytes read and written per transaction, 0 when not meaningful (default)
+    **/
+    virtual double get_bytes_per_tx() const {
+        return 0.;
+    }
+    /** Get the quantities the workers sampled over the runs, to call once they are done.
+     * @return Name and samples of each quantity, in sampling order (none by default)
+    **/
+    virtual ::std::vector<::std::pair<char const*, ::std::vector<double>>> get_series() const {
+        return {};
+    }
+    /** Throughput of one phase of a workload changing its mix over time.
+    **/
+    struct Phase {
+        ::std::string name; // Description of the mix
+        double throughput;  // Committed TX per second while the mix ran
+        double readapt_ms;  // Mean time after a change to this mix before the throughput settled (in ms), NaN if it never changed to it
+    };
+    /** Get the throughput of each phase over the runs, to call once the workers are done.
+     * @return Summary of each phase, in schedule order (none by default)
+    **/
+    virtual ::std::vector<Phase> get_phases() const {
+        return {};
+    }
 };
 
 // -------------------------------------------------------------------------- //
 
-/** Bank workload class.
+/** Bank workload class, its accounts in a chain of segments.
 **/
-class WorkloadBank final: public Workload {
+class WorkloadBank: public Workload {
 public:
     /** Account balance class alias.
     **/
     using Balance = intptr_t;
     static_assert(sizeof(Balance) >= sizeof(void*), "Balance class is too small");
+    /** Maximum number of accounts of one transfer, as many as one hint can declare.
+    **/
+    constexpr static size_t max_width = 64;
 private:
     /** Shared segment of accounts class.
     **/
@@ -116,9 +314,20 @@ private:
         constexpr static auto align() noexcept {
             return alignof(Dummy);
         }
+    public:
+        /** Private copy of the fields in front of the accounts, laid out as in shared memory.
+        **/
+        struct Header {
+            size_t  count;  // Number of allocated accounts in this segment
+            Relative<AccountSegment> next; // Next allocated segment, relative to the start of the region
+            Balance parity; // Segment balance correction for when deleting an account
+        };
+        static_assert(sizeof(Header) == offsetof(Dummy, dummy3), "Header does not match the segment layout");
+    private:
+        Transaction& tx; // Associated pending transaction
     public:
         Shared<size_t>         count; // Number of allocated accounts in this segment
-        Shared<AccountSegment*> next; // Next allocated segment
+        Shared<Relative<AccountSegment>> next; // Next allocated segment, relative to the start of the region
         Shared<Balance>       parity; // Segment balance correction for when deleting an account
         Shared<Balance[]>   accounts; // Amount of money on the accounts (undefined if not allocated)
     public:
@@ -130,51 +339,111 @@ private:
          * @param tx      Associated pending transaction
          * @param address Block base address
         **/
-        AccountSegment(Transaction& tx, void* address): count{tx, address}, next{tx, count.after()}, parity{tx, next.after()}, accounts{tx, parity.after()} {}
+        AccountSegment(Transaction& tx, void* address): tx{tx}, count{tx, address}, next{tx, count.after()}, parity{tx, next.after()}, accounts{tx, parity.after()} {}
+    public:
+        /** Read the adjacent header fields with a single transactional read.
+         * @param with_parity Whether to read 'parity' too, or only 'count' and 'next'
+         * @return Private copy of the header ('parity' undefined if not read)
+        **/
+        Header header(bool with_parity = true) const {
+            Header res;
+            tx.read(count.get(), with_parity ? sizeof(Header) : offsetof(Header, parity), &res);
+            return res;
+        }
+        /** Early release of the traversal reads ('count' and 'next'), once two segments behind.
+         * A segment is only unlinked after its successor, and the reads of the last two segments reached are kept, so any unlinking still conflicts.
+        **/
+        void release() const noexcept {
+            count.release();
+            next.release();
+        }
     };
-private:
+public:
+    /** Latency histograms of the transactions, one per type, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerLatencies {
+        Histogram long_tx;  // Long, read-only control transactions
+        Histogram alloc_tx; // Allocation/deallocation transactions
+        Histogram short_tx; // Short transfer transactions
+    };
+protected:
     size_t  nbworkers;     // Number of concurrent workers
-    size_t  nbtxperwrk;    // Number of transactions per worker
+    size_t  nbtxperwrk;    // Number of transactions per worker, 0 for as many as possible until asked to stop
     size_t  nbaccounts;    // Initial number of accounts and number of accounts per segment
     size_t  expnbaccounts; // Expected total number of accounts
     Balance init_balance;  // Initial account balance
     float   prob_long;     // Probability of running a long, read-only control transaction
     float   prob_alloc;    // Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+    AccessPattern access;  // Access pattern of the short transactions over the accounts
+    double  arrival_rate;  // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
     Barrier barrier;       // Barrier for thread synchronization during 'check'
+    mutable ::std::vector<WorkerLatencies> latencies; // Latencies measured by each worker in 'run', retries included
+    mutable ::std::vector<uint8_t> loaded; // Whether each worker bulk-loaded its share in 'load', else 'init' writes everything in transactions
 public:
     /** Bank workload constructor.
      * @param library       Transactional library to use
      * @param nbworkers     Total number of concurrent threads (for both 'run' and 'check')
-     * @param nbtxperwrk    Number of transactions per worker
+     * @param nbtxperwrk    Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
      * @param nbaccounts    Initial number of accounts and number of accounts per segment
      * @param expnbaccounts Initial number of accounts and number of accounts per segment
      * @param init_balance  Initial account balance
      * @param prob_long     Probability of running a long, read-only control transaction
      * @param prob_alloc    Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+     * @param access        Access pattern of the short transactions over the accounts (uniform by default)
+     * @param arrival_rate  Aggregate arrival rate of the transactions (in TX/s), each worker following a Poisson schedule at its share of it, 0 for closed-loop workers (the default)
     **/
-    WorkloadBank(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc): Workload{library, AccountSegment::align(), AccountSegment::size(nbaccounts)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbaccounts{nbaccounts}, expnbaccounts{expnbaccounts}, init_balance{init_balance}, prob_long{prob_long}, prob_alloc{prob_alloc}, barrier(nbworkers) {}
-private:
+    WorkloadBank(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): WorkloadBank{library, AccountSegment::align(), AccountSegment::size(nbaccounts), nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc, access, arrival_rate} {}
+protected:
+    /** Bank workload constructor for another layout of the accounts, same parameters as the public one.
+     * @param align Shared memory region required alignment
+     * @param size  Size of the shared memory region to allocate
+    **/
+    WorkloadBank(TransactionalLibrary const& library, size_t align, size_t size, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc, AccessPattern const& access, double arrival_rate): Workload{library, align, size}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbaccounts{nbaccounts}, expnbaccounts{expnbaccounts}, init_balance{init_balance}, prob_long{prob_long}, prob_alloc{prob_alloc}, access{access}, arrival_rate{arrival_rate}, barrier(nbworkers), latencies(nbworkers), loaded(nbworkers, 0) {}
+protected:
+    /** Bulk-load a worker's share of an array of accounts at the initial balance, see 'load'.
+     * @param uid       Unique ID (between 0 to n-1)
+     * @param nbloaders Number of workers loading
+     * @param accounts  Shared array of 'nbaccounts' accounts
+     * @return Whether the share was written
+    **/
+    bool load_accounts(Uid uid, size_t nbloaders, Balance* accounts) const {
+        auto first = nbaccounts * uid / nbloaders;
+        auto last  = nbaccounts * (uid + 1) / nbloaders;
+        if (first == last)
+            return true;
+        ::std::vector<Balance> balances(last - first, init_balance);
+        return tm.bulk_write(balances.data(), balances.size() * sizeof(Balance), accounts + first);
+    }
+    /** Tell whether every worker bulk-loaded its share in 'load', to call in 'init'.
+     * @return Whether the initial accounts are all written
+    **/
+    bool is_loaded() const noexcept {
+        return ::std::all_of(loaded.begin(), loaded.end(), [](uint8_t done) { return done != 0; });
+    }
     /** Long read-only transaction, summing the balance of each account.
      * @param count Loosely-updated number of accounts
      * @return Whether no inconsistency has been found
     **/
-    bool long_tx(size_t& nbaccounts) const {
+    virtual bool long_tx(size_t& nbaccounts) const {
         return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
             auto count = 0ul;
             auto sum   = Balance{0};
             auto start = tm.get_start();
+            thread_local ::std::vector<Balance> balances;
             while (start) {
                 AccountSegment segment{tx, start};
-                decltype(count) segment_count = segment.count;
+                auto header = segment.header();
+                decltype(count) segment_count = header.count;
                 count += segment_count;
-                sum += segment.parity;
-                for (decltype(count) i = 0; i < segment_count; ++i) {
-                    Balance local = segment.accounts[i];
+                sum += header.parity;
+                balances.resize(segment_count);
+                segment.accounts.read_range(0, segment_count, balances.data());
+                for (auto local: balances) {
                     if (unlikely(local < 0))
                         return false;
                     sum += local;
                 }
-                start = segment.next;
+                start = header.next.decode(tm.get_start());
             }
             nbaccounts = count;
             return sum == static_cast<Balance>(init_balance * count);
@@ -183,16 +452,18 @@ private:
     /** Account (de)allocation transaction, adding accounts with initial balance or removing them.
      * @param trigger Trigger level that will decide whether to allocate or deallocate
     **/
-    void alloc_tx(size_t trigger) const {
+    virtual void alloc_tx(size_t trigger) const {
         return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
             auto count = 0ul;
             void* prev = nullptr;
+            void* prev_prev = nullptr;
             auto start = tm.get_start();
             while (true) {
                 AccountSegment segment{tx, start};
-                decltype(count) segment_count = segment.count;
+                auto header = segment.header(false);
+                decltype(count) segment_count = header.count;
                 count += segment_count;
-                decltype(start) segment_next = segment.next;
+                decltype(start) segment_next = header.next.decode(tm.get_start());
                 if (!segment_next) { // Currently at the last segment
                     if (count > trigger && likely(count > 2)) { // Deallocate
                         --segment_count;
@@ -219,6 +490,9 @@ private:
                     }
                     return;
                 }
+                if (prev_prev)
+                    AccountSegment{tx, prev_prev}.release();
+                prev_prev = prev;
                 prev  = start;
                 start = segment_next;
             }
@@ -229,18 +503,23 @@ private:
      * @param recv_id Index of the receiver account (potentially same as source)
      * @return Whether the parameters were satisfying and the transaction committed on useful work
     **/
-    bool short_tx(size_t send_id, size_t recv_id) const {
+    virtual bool short_tx(size_t send_id, size_t recv_id) const {
         return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
             void* send_ptr = nullptr;
             void* recv_ptr = nullptr;
+            void* prev = nullptr; // Previous segment, if it holds none of the accounts
+            void* prev_prev = nullptr;
             // Get the account pointers in shared memory
             auto start = tm.get_start();
             while (true) {
                 AccountSegment segment{tx, start};
-                size_t segment_count = segment.count;
+                auto header = segment.header(false);
+                size_t segment_count = header.count;
+                auto found = false;
                 if (!send_ptr) {
                     if (send_id < segment_count) {
                         send_ptr = segment.accounts[send_id].get();
+                        found = true;
                         if (recv_ptr)
                             break;
                     } else {
@@ -250,35 +529,65 @@ private:
                 if (!recv_ptr) {
                     if (recv_id < segment_count) {
                         recv_ptr = segment.accounts[recv_id].get();
+                        found = true;
                         if (send_ptr)
                             break;
                     } else {
                         recv_id -= segment_count;
                     }
                 }
-                start = segment.next;
-                if (!start) // Current segment is the last segment
+                decltype(start) segment_next = header.next.decode(tm.get_start());
+                if (!segment_next) // Current segment is the last segment
                     return false; // At least one account does not exist => do nothing
+                if (prev_prev)
+                    AccountSegment{tx, prev_prev}.release();
+                prev_prev = prev;
+                prev  = found ? nullptr : start;
+                start = segment_next;
             }
             // Transfer the money if enough fund
+            void const* const accounts[] = {send_ptr, recv_ptr};
+            tx.hint(accounts, 2, 0b11);
             Shared<Balance> sender{tx, send_ptr};
             Shared<Balance> recver{tx, recv_ptr};
-            auto send_val = sender.read();
+            auto send_val = sender.read_for_update();
             if (send_val > 0) {
                 sender = send_val - 1;
-                recver = recver.read() + 1;
+                recver = recver.read_for_update() + 1;
             }
             return true;
         });
     }
+    /** Draw the number of accounts of the next transfer.
+     * @param engine Random engine of the worker
+     * @return Number of accounts, between 1 and 'max_width' (2 by default, see 'short_tx')
+    **/
+    virtual size_t transfer_width(::std::minstd_rand& engine [[gnu::unused]]) const {
+        return 2;
+    }
+    /** Transfer transaction among some accounts.
+     * @param ids   Indices of the accounts (potentially repeated)
+     * @param width Number of accounts, as drawn by 'transfer_width'
+     * @return Whether the parameters were satisfying and the transaction committed on useful work
+    **/
+    virtual bool transfer_tx(size_t const* ids, size_t width [[gnu::unused]]) const {
+        return short_tx(ids[0], ids[1]);
+    }
 public:
+    virtual void load(Uid uid, size_t nbloaders) const {
+        auto start = reinterpret_cast<uint8_t*>(tm.get_start());
+        AccountSegment::Header header{nbaccounts, {}, 0};
+        loaded[uid] = load_accounts(uid, nbloaders, reinterpret_cast<Balance*>(start + sizeof(header))) && (uid != 0 || tm.bulk_write(&header, sizeof(header), start));
+    }
     virtual char const* init() const {
-        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
-            AccountSegment segment{tx, tm.get_start()};
-            segment.count = nbaccounts;
-            for (size_t i = 0; i < nbaccounts; ++i)
-                segment.accounts[i] = init_balance;
-        });
+        if (!is_loaded()) {
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                AccountSegment segment{tx, tm.get_start()};
+                segment.count = nbaccounts;
+                for (size_t i = 0; i < nbaccounts; ++i)
+                    segment.accounts[i] = init_balance;
+            });
+        }
         auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
             AccountSegment segment{tx, tm.get_start()};
             return segment.accounts[0] == init_balance;
@@ -287,21 +596,46 @@ public:
             return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
         return nullptr;
     }
-    virtual char const* run(Uid uid [[gnu::unused]], Seed seed) const {
+    virtual char const* run(Uid uid, Seed seed) const {
         ::std::minstd_rand engine{seed};
         ::std::bernoulli_distribution long_dist{prob_long};
         ::std::bernoulli_distribution alloc_dist{prob_alloc};
         ::std::gamma_distribution<float> alloc_trigger(expnbaccounts, 1);
         size_t count = nbaccounts;
-        for (size_t cntr = 0; cntr < nbtxperwrk; ++cntr) {
+        auto& local = latencies[uid];
+        ::std::map<size_t, AliasTable> tables; // Account samplers by number of accounts, if not uniform
+        size_t ids[max_width]; // Accounts of the transfer
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
             if (long_dist(engine)) { // Do a long transaction
-                if (unlikely(!long_tx(count)))
+                pacer.start();
+                auto consistent = long_tx(count);
+                local.long_tx.record(pacer.latency());
+                if (unlikely(!consistent))
                     return "Violated isolation or atomicity";
             } else if (alloc_dist(engine)) { // Do an allocation transaction
-                alloc_tx(alloc_trigger(engine));
+                auto trigger = alloc_trigger(engine);
+                pacer.start();
+                alloc_tx(trigger);
+                local.alloc_tx.record(pacer.latency());
             } else { // Do a short transaction
-                ::std::uniform_int_distribution<size_t> account{0, count - 1};
-                while (unlikely(!short_tx(account(engine), account(engine))));
+                ::std::uniform_int_distribution<size_t> uniform{0, count - 1};
+                auto table = access.kind == AccessPattern::Kind::uniform ? nullptr : &tables.try_emplace(count, access, count).first->second;
+                auto account = [&]() { return table ? (*table)(engine) : uniform(engine); };
+                while (true) {
+                    auto width = transfer_width(engine);
+                    for (size_t i = 0; i < width; ++i)
+                        ids[i] = account();
+                    pacer.start();
+                    auto done = transfer_tx(ids, width);
+                    if (!pacer.is_open()) // Else once for the arrival, whatever the number of tries
+                        local.short_tx.record(pacer.attempt());
+                    if (likely(done))
+                        break;
+                }
+                if (pacer.is_open())
+                    local.short_tx.record(pacer.latency());
             }
         }
         { // Last long transaction
@@ -311,53 +645,1391 @@ public:
         }
         return nullptr;
     }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerLatencies res;
+        for (auto const& local: latencies) {
+            res.long_tx.merge(local.long_tx);
+            res.alloc_tx.merge(local.alloc_tx);
+            res.short_tx.merge(local.short_tx);
+        }
+        return {{"long", res.long_tx}, {"alloc", res.alloc_tx}, {"short", res.short_tx}};
+    }
     virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
-        constexpr size_t nbtxperwrk = 100;
-        barrier.sync();
-        if (uid == 0) { // Initialization
-            auto init_counter = nbtxperwrk * nbworkers;
-            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
-                Shared<size_t> counter{tx, tm.get_start()};
-                counter = init_counter;
-            });
-            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
-                Shared<size_t> counter{tx, tm.get_start()};
-                return counter == init_counter;
-            });
-            if (unlikely(!correct)) {
-                barrier.sync();
-                barrier.sync();
-                return "Violated consistency";
-            }
+        return check_counters(uid, nbworkers, barrier);
+    }
+};
+
+/** Bank workload class, its accounts found through a directory instead of a chain walk.
+ * The first segment holds the total number of accounts, the balance correction of the deleted accounts, a directory of fixed capacity with
+ * the address of each array of accounts, then the first array itself. Account 'i' is in array 'i / nbaccounts', so any account is reached in
+ * a constant number of reads.
+**/
+class WorkloadBankIndexed: public WorkloadBank {
+protected:
+    /** Shared index segment class.
+    **/
+    class IndexSegment final {
+    public:
+        /** Get the segment size for a given number of accounts per array and directory capacity.
+         * @param nbaccounts Number of accounts per array
+         * @param capacity   Number of directory entries
+         * @return Segment size (in bytes)
+        **/
+        constexpr static auto size(size_t nbaccounts, size_t capacity) noexcept {
+            return sizeof(size_t) + sizeof(Balance) + capacity * sizeof(Balance*) + nbaccounts * sizeof(Balance);
         }
-        barrier.sync();
-        for (size_t i = 0; i < nbtxperwrk; ++i) {
-            auto last = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
-                Shared<size_t> counter{tx, tm.get_start()};
-                return counter.read();
-            });
-            auto correct = transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
-                Shared<size_t> counter{tx, tm.get_start()};
-                auto value = counter.read();
-                if (unlikely(value > last))
-                    return false;
-                counter = value - 1;
-                return true;
-            });
-            if (unlikely(!correct)) {
-                barrier.sync();
-                return "Violated consistency, isolation or atomicity";
+        /** Get the segment alignment.
+         * @return Segment alignment (in bytes)
+        **/
+        constexpr static auto align() noexcept {
+            return alignof(Balance*) > alignof(size_t) ? alignof(Balance*) : alignof(size_t);
+        }
+    public:
+        Shared<size_t>     count; // Number of allocated accounts
+        Shared<Balance>   parity; // Balance correction for the deleted accounts
+        Shared<Balance*[]> arrays; // Address of each array of accounts, 'nullptr' if not allocated
+        Shared<Balance[]>  first; // First array of accounts
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        IndexSegment(IndexSegment const&) = delete;
+        IndexSegment& operator=(IndexSegment const&) = delete;
+        /** Binding constructor.
+         * @param tx       Associated pending transaction
+         * @param address  Block base address
+         * @param capacity Number of directory entries
+        **/
+        IndexSegment(Transaction& tx, void* address, size_t capacity): count{tx, address}, parity{tx, count.after()}, arrays{tx, parity.after()}, first{tx, arrays.after(capacity)} {}
+    };
+protected:
+    size_t capacity; // Number of directory entries, i.e. maximum number of arrays of accounts
+public:
+    /** Indexed bank workload constructor, same parameters as the chained one.
+     * The directory can hold 4 times the expected number of accounts; allocations beyond do nothing.
+    **/
+    WorkloadBankIndexed(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): WorkloadBank{library, IndexSegment::align(), IndexSegment::size(nbaccounts, directory(nbaccounts, expnbaccounts)), nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc, access, arrival_rate}, capacity{directory(nbaccounts, expnbaccounts)} {}
+private:
+    /** Get the directory capacity.
+     * @param nbaccounts    Number of accounts per array
+     * @param expnbaccounts Expected total number of accounts
+     * @return Number of directory entries
+    **/
+    constexpr static size_t directory(size_t nbaccounts, size_t expnbaccounts) noexcept {
+        auto res = 4 * ((expnbaccounts + nbaccounts - 1) / nbaccounts);
+        return res < 2 ? 2 : res;
+    }
+protected:
+    virtual bool long_tx(size_t& nbaccounts) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            IndexSegment index{tx, tm.get_start(), capacity};
+            size_t count = index.count;
+            auto sum = index.parity.read();
+            thread_local ::std::vector<Balance> balances;
+            for (size_t first = 0; first < count; first += this->nbaccounts) {
+                auto length = count - first < this->nbaccounts ? count - first : this->nbaccounts;
+                balances.resize(length);
+                Shared<Balance[]>{tx, index.arrays[first / this->nbaccounts].read()}.read_range(0, length, balances.data());
+                for (auto local: balances) {
+                    if (unlikely(local < 0))
+                        return false;
+                    sum += local;
+                }
+            }
+            nbaccounts = count;
+            return sum == static_cast<Balance>(init_balance * count);
+        });
+    }
+    virtual void alloc_tx(size_t trigger) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            IndexSegment index{tx, tm.get_start(), capacity};
+            size_t count = index.count;
+            if (count > trigger && likely(count > 2)) { // Deallocate the last account, and its array if it was the only one in it
+                --count;
+                auto array = index.arrays[count / nbaccounts];
+                index.parity = index.parity.read() + Shared<Balance[]>{tx, array.read()}[count % nbaccounts] - init_balance;
+                if (count % nbaccounts == 0)
+                    array.free();
+                index.count = count;
+            } else { // Allocate one account, and its array if needed
+                auto array = index.arrays[count / nbaccounts];
+                if (count % nbaccounts == 0) {
+                    if (unlikely(count / nbaccounts >= capacity)) // Directory full
+                        return;
+                    array.alloc(nbaccounts * sizeof(Balance));
+                }
+                Shared<Balance[]>{tx, array.read()}[count % nbaccounts] = init_balance;
+                index.count = count + 1;
+            }
+        });
+    }
+    virtual bool short_tx(size_t send_id, size_t recv_id) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            IndexSegment index{tx, tm.get_start(), capacity};
+            size_t count = index.count;
+            if (send_id >= count || recv_id >= count) // At least one account does not exist => do nothing
+                return false;
+            auto send_ptr = index.arrays[send_id / nbaccounts].read() + send_id % nbaccounts;
+            auto recv_ptr = index.arrays[recv_id / nbaccounts].read() + recv_id % nbaccounts;
+            void const* const accounts[] = {send_ptr, recv_ptr};
+            tx.hint(accounts, 2, 0b11);
+            Shared<Balance> sender{tx, send_ptr};
+            Shared<Balance> recver{tx, recv_ptr};
+            // Transfer the money if enough fund
+            auto send_val = sender.read_for_update();
+            if (send_val > 0) {
+                sender = send_val - 1;
+                recver = recver.read_for_update() + 1;
             }
+            return true;
+        });
+    }
+public:
+    virtual void load(Uid uid, size_t nbloaders) const {
+        auto start = reinterpret_cast<uint8_t*>(tm.get_start());
+        auto first = reinterpret_cast<Balance*>(start + IndexSegment::size(0, capacity));
+        auto done = load_accounts(uid, nbloaders, first);
+        if (uid == 0 && done) { // Count, correction and directory, in one write
+            ::std::vector<uintptr_t> header(2 + capacity, 0);
+            header[0] = nbaccounts;
+            header[2] = reinterpret_cast<uintptr_t>(first);
+            done = tm.bulk_write(header.data(), header.size() * sizeof(uintptr_t), start);
         }
-        barrier.sync();
-        if (uid == 0) {
-            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
-                Shared<size_t> counter{tx, tm.get_start()};
-                return counter == 0;
+        loaded[uid] = done;
+    }
+    virtual char const* init() const {
+        if (!is_loaded()) {
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                IndexSegment index{tx, tm.get_start(), capacity};
+                index.count = nbaccounts;
+                index.parity = 0;
+                index.arrays[0] = index.first.get();
+                for (size_t i = 1; i < capacity; ++i) // Arrays left by a previous run, if any, are lost
+                    index.arrays[i] = nullptr;
+                for (size_t i = 0; i < nbaccounts; ++i)
+                    index.first[i] = init_balance;
             });
-            if (unlikely(!correct))
-                return "Violated consistency";
         }
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            IndexSegment index{tx, tm.get_start(), capacity};
+            return Shared<Balance[]>{tx, index.arrays[0].read()}[0] == init_balance;
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
         return nullptr;
     }
 };
+
+/** Bank workload class, each transfer moving money among a drawn number of accounts found through the directory.
+ * Each of the k accounts passes one unit to the next one, the last to the first, if it has any: the transaction writes the k accounts (fewer
+ * if some repeat), so the width sweeps the write-set size while the lookups stay constant, and the sum checked by 'long_tx' is preserved.
+**/
+class WorkloadBankMulti final: public WorkloadBankIndexed {
+public:
+    /** Distribution of the number of accounts of a transfer.
+    **/
+    enum class Width {
+        uniform,  // Any number in the range equally likely
+        geometric // Each additional account half as likely, from the least number
+    };
+private:
+    size_t width_min;  // Least number of accounts of a transfer
+    size_t width_max;  // Greatest number of accounts of a transfer, at most 'max_width'
+    Width  width_dist; // Distribution of the number of accounts in between
+public:
+    /** Multi-account bank workload constructor, same parameters as the chained one with the width of the transfers before the access pattern.
+     * @param width_min  Least number of accounts of a transfer
+     * @param width_max  Greatest number of accounts of a transfer, between 'width_min' and 'max_width'
+     * @param width_dist Distribution of the number of accounts in between
+    **/
+    WorkloadBankMulti(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc, size_t width_min, size_t width_max, Width width_dist, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): WorkloadBankIndexed{library, nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc, access, arrival_rate}, width_min{width_min}, width_max{width_max}, width_dist{width_dist} {}
+protected:
+    virtual size_t transfer_width(::std::minstd_rand& engine) const {
+        if (width_dist == Width::uniform)
+            return ::std::uniform_int_distribution<size_t>{width_min, width_max}(engine);
+        ::std::geometric_distribution<size_t> extra{0.5};
+        while (true) { // Truncated by rejection
+            auto res = width_min + extra(engine);
+            if (res <= width_max)
+                return res;
+        }
+    }
+    virtual bool transfer_tx(size_t const* ids, size_t width) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            IndexSegment index{tx, tm.get_start(), capacity};
+            size_t count = index.count;
+            Balance* ptrs[max_width];
+            for (size_t i = 0; i < width; ++i) {
+                if (ids[i] >= count) // At least one account does not exist => do nothing
+                    return false;
+                ptrs[i] = index.arrays[ids[i] / nbaccounts].read() + ids[i] % nbaccounts;
+            }
+            void const* accounts[max_width];
+            for (size_t i = 0; i < width; ++i)
+                accounts[i] = ptrs[i];
+            tx.hint(accounts, width, width < 64 ? (uint64_t{1} << width) - 1 : ~uint64_t{0});
+            // Pass one unit along the ring of accounts, from those with enough fund
+            for (size_t i = 0; i < width; ++i) {
+                Shared<Balance> sender{tx, ptrs[i]};
+                Shared<Balance> recver{tx, ptrs[(i + 1) % width]};
+                auto send_val = sender.read_for_update();
+                if (send_val > 0) {
+                    sender = send_val - 1;
+                    recver = recver.read_for_update() + 1;
+                }
+            }
+            return true;
+        });
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Sorted linked-list set workload class, its nodes allocated and freed by the transactions.
+ * Each transaction looks up, inserts or removes one key: the read sets are long (every node before the key), the write sets short (one
+ * or two links) and every successful update allocates or frees a node. The traversals release the nodes two behind, if asked to.
+**/
+class WorkloadLinkedList final: public Workload {
+public:
+    /** Key class alias.
+    **/
+    using Key = size_t;
+private:
+    /** Shared list node class.
+    **/
+    class ListNode final {
+    private:
+        /** Dummy structure for size and alignment retrieval.
+        **/
+        struct Dummy {
+            Key   dummy0;
+            void* dummy1;
+        };
+    public:
+        /** Get the node size.
+         * @return Node size (in bytes)
+        **/
+        constexpr static auto size() noexcept {
+            return sizeof(Dummy);
+        }
+    public:
+        /** Private copy of the node, laid out as in shared memory.
+        **/
+        struct Header {
+            Key       key;  // Key of the node
+            ListNode* next; // Next node, 'nullptr' for none
+        };
+        static_assert(sizeof(Header) == sizeof(Dummy), "Header does not match the node layout");
+    private:
+        Transaction& tx; // Associated pending transaction
+    public:
+        Shared<Key>        key; // Key of the node
+        Shared<ListNode*> next; // Next node, 'nullptr' for none
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        ListNode(ListNode const&) = delete;
+        ListNode& operator=(ListNode const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Block base address
+        **/
+        ListNode(Transaction& tx, void* address): tx{tx}, key{tx, address}, next{tx, key.after()} {}
+    public:
+        /** Read the whole node with a single transactional read.
+         * @return Private copy of the node
+        **/
+        Header header() const {
+            Header res;
+            tx.read(key.get(), sizeof(Header), &res);
+            return res;
+        }
+        /** Early release of the node, once two nodes behind the traversal.
+         * A removal writes the link to the removed node and the removed node's own link, so any update next to the kept two still conflicts.
+        **/
+        void release() const noexcept {
+            tx.release(key.get(), sizeof(Header));
+        }
+    };
+    /** Shared first segment class.
+    **/
+    class ListRoot final {
+    private:
+        /** Dummy structure for size and alignment retrieval, the two first words for 'check_counters'.
+        **/
+        struct Dummy {
+            size_t dummy0;
+            size_t dummy1;
+            void*  dummy2;
+        };
+    public:
+        /** Get the segment size.
+         * @return Segment size (in bytes)
+        **/
+        constexpr static auto size() noexcept {
+            return sizeof(Dummy);
+        }
+        /** Get the segment alignment.
+         * @return Segment alignment (in bytes)
+        **/
+        constexpr static auto align() noexcept {
+            return alignof(Dummy);
+        }
+    public:
+        Shared<ListNode*> head; // First node, 'nullptr' if empty
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        ListRoot(ListRoot const&) = delete;
+        ListRoot& operator=(ListRoot const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Segment base address
+        **/
+        ListRoot(Transaction& tx, void* address): head{tx, reinterpret_cast<uint8_t*>(address) + offsetof(Dummy, dummy2)} {}
+    };
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram contains_tx; // Lookup transactions
+        Histogram insert_tx;   // Insertion transactions
+        Histogram remove_tx;   // Removal transactions
+        ptrdiff_t delta = 0;   // Successful insertions minus successful removals
+    };
+    /** Position reached by a traversal.
+    **/
+    struct Position {
+        ListNode**       link; // Link to the node reached: the head, or the 'next' of its predecessor
+        ListNode*        node; // Node reached, 'nullptr' for none
+        ListNode::Header header; // Private copy of the node reached (undefined if none)
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    Key    key_range;    // Keys are between 0 and 'key_range - 1'
+    float  prob_update;  // Probability of an insertion or a removal, each equally likely, instead of a lookup
+    bool   release;      // Whether the traversals release the nodes two behind
+    AccessPattern access; // Access pattern over the keys
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Linked-list workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param key_range    Number of keys, half of them initially in the set
+     * @param prob_update  Probability of an insertion or a removal instead of a lookup
+     * @param release      Whether the traversals release the nodes two behind
+     * @param access       Access pattern over the keys
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadLinkedList(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, Key key_range, float prob_update, bool release, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): Workload{library, ListRoot::align(), ListRoot::size()}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, key_range{key_range}, prob_update{prob_update}, release{release}, access{access}, arrival_rate{arrival_rate}, barrier(nbworkers), states(nbworkers) {}
+private:
+    /** Walk the list up to the first node whose key is not lower than a given one.
+     * @param tx  Associated pending transaction
+     * @param key Key to look for
+     * @return Position reached
+    **/
+    Position locate(Transaction& tx, Key key) const {
+        ListRoot root{tx, tm.get_start()};
+        Position res{root.head.get(), root.head.read(), {}};
+        ListNode* behind = nullptr; // Node owning 'res.link', 'nullptr' for the head
+        while (res.node) {
+            ListNode node{tx, res.node};
+            res.header = node.header();
+            if (res.header.key >= key)
+                break;
+            if (release) {
+                if (behind) {
+                    ListNode{tx, behind}.release();
+                } else {
+                    root.head.release();
+                }
+            }
+            behind = res.node;
+            res.link = node.next.get();
+            res.node = res.header.next;
+        }
+        return res;
+    }
+    /** Lookup transaction.
+     * @param key Key to look for
+     * @return Whether the key is in the set
+    **/
+    bool contains_tx(Key key) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto pos = locate(tx, key);
+            return pos.node && pos.header.key == key;
+        });
+    }
+    /** Insertion transaction.
+     * @param key Key to insert
+     * @return Whether the key was not in the set
+    **/
+    bool insert_tx(Key key) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto pos = locate(tx, key);
+            if (pos.node && pos.header.key == key)
+                return false;
+            auto fresh = reinterpret_cast<ListNode*>(tx.alloc(ListNode::size()));
+            ListNode node{tx, fresh};
+            node.key = key;
+            node.next = pos.node;
+            Shared<ListNode*>{tx, pos.link} = fresh;
+            return true;
+        });
+    }
+    /** Removal transaction.
+     * @param key Key to remove
+     * @return Whether the key was in the set
+    **/
+    bool remove_tx(Key key) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto pos = locate(tx, key);
+            if (!pos.node || pos.header.key != key)
+                return false;
+            Shared<ListNode*>{tx, pos.link} = pos.header.next;
+            ListNode{tx, pos.node}.next = nullptr; // So that a concurrent insertion right after the removed node conflicts
+            tx.free(pos.node);
+            return true;
+        });
+    }
+    /** Whole-list transaction, checking the order of the keys.
+     * @param size Set to the number of keys in the set, if consistent
+     * @return Whether no inconsistency has been found
+    **/
+    bool walk_tx(size_t& size) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            size_t count = 0;
+            auto node = ListRoot{tx, tm.get_start()}.head.read();
+            while (node) {
+                auto header = ListNode{tx, node}.header();
+                if (unlikely(header.key >= key_range || (header.next && ListNode{tx, header.next}.key.read() <= header.key)))
+                    return false;
+                ++count;
+                node = header.next;
+            }
+            size = count;
+            return true;
+        });
+    }
+    /** Get the initial number of keys in the set.
+     * @return Initial number of keys
+    **/
+    size_t initial_size() const noexcept {
+        return (key_range + 1) / 2;
+    }
+public:
+    virtual char const* init() const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            ListRoot root{tx, tm.get_start()};
+            for (auto node = root.head.read(); node;) { // Nodes of a previous initialization, if any
+                auto next = ListNode{tx, node}.next.read();
+                tx.free(node);
+                node = next;
+            }
+            ListNode* next = nullptr;
+            for (auto i = initial_size(); i-- > 0;) { // Every even key, from the last
+                auto fresh = reinterpret_cast<ListNode*>(tx.alloc(ListNode::size()));
+                ListNode node{tx, fresh};
+                node.key = 2 * i;
+                node.next = next;
+                next = fresh;
+            }
+            root.head = next;
+        });
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto head = ListRoot{tx, tm.get_start()}.head.read();
+            return head && ListNode{tx, head}.key == 0;
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::bernoulli_distribution update_dist{prob_update};
+        ::std::bernoulli_distribution insert_dist{0.5};
+        ::std::uniform_int_distribution<Key> uniform{0, key_range - 1};
+        auto table = access.kind == AccessPattern::Kind::uniform ? ::std::optional<AliasTable>{} : ::std::optional<AliasTable>{::std::in_place, access, key_range};
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            auto key = table ? static_cast<Key>((*table)(engine)) : uniform(engine);
+            if (update_dist(engine)) {
+                if (insert_dist(engine)) { // Do an insertion
+                    pacer.start();
+                    if (insert_tx(key))
+                        ++local.delta;
+                    local.insert_tx.record(pacer.latency());
+                } else { // Do a removal
+                    pacer.start();
+                    if (remove_tx(key))
+                        --local.delta;
+                    local.remove_tx.record(pacer.latency());
+                }
+            } else { // Do a lookup
+                pacer.start();
+                contains_tx(key);
+                local.contains_tx.record(pacer.latency());
+            }
+        }
+        { // Last whole-list transaction
+            size_t dummy;
+            if (!walk_tx(dummy))
+                return "Violated isolation or atomicity";
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.insert_tx.merge(local.insert_tx);
+            res.remove_tx.merge(local.remove_tx);
+            res.contains_tx.merge(local.contains_tx);
+        }
+        return {{"insert", res.insert_tx}, {"remove", res.remove_tx}, {"lookup", res.contains_tx}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every insertion and removal counted exactly once, before the counters overwrite the first words
+            auto expected = static_cast<ptrdiff_t>(initial_size());
+            for (auto const& local: states)
+                expected += local.delta;
+            size_t size;
+            if (unlikely(!walk_tx(size) || static_cast<ptrdiff_t>(size) != expected))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Hash table workload class, its entries chained in buckets and its table occasionally resized.
+ * Point transactions get, put or delete one key; a rare resize transaction rehashes every entry into a new table, so that the point
+ * transactions run meanwhile against a huge read-write transaction.
+**/
+class WorkloadHashMap final: public Workload {
+public:
+    /** Key and value class aliases.
+    **/
+    using Key   = size_t;
+    using Value = size_t;
+private:
+    /** Shared table entry class.
+    **/
+    class MapEntry final {
+    private:
+        /** Dummy structure for size and alignment retrieval.
+        **/
+        struct Dummy {
+            Key   dummy0;
+            Value dummy1;
+            void* dummy2;
+        };
+    public:
+        /** Get the entry size.
+         * @return Entry size (in bytes)
+        **/
+        constexpr static auto size() noexcept {
+            return sizeof(Dummy);
+        }
+    public:
+        /** Private copy of the entry, laid out as in shared memory.
+        **/
+        struct Header {
+            Key       key;   // Key of the entry
+            Value     value; // Value of the entry
+            MapEntry* next;  // Next entry in the bucket, 'nullptr' for none
+        };
+        static_assert(sizeof(Header) == sizeof(Dummy), "Header does not match the entry layout");
+    private:
+        Transaction& tx; // Associated pending transaction
+    public:
+        Shared<Key>         key; // Key of the entry
+        Shared<Value>     value; // Value of the entry
+        Shared<MapEntry*>  next; // Next entry in the bucket, 'nullptr' for none
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        MapEntry(MapEntry const&) = delete;
+        MapEntry& operator=(MapEntry const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Block base address
+        **/
+        MapEntry(Transaction& tx, void* address): tx{tx}, key{tx, address}, value{tx, key.after()}, next{tx, value.after()} {}
+    public:
+        /** Read the whole entry with a single transactional read.
+         * @return Private copy of the entry
+        **/
+        Header header() const {
+            Header res;
+            tx.read(key.get(), sizeof(Header), &res);
+            return res;
+        }
+    };
+    /** Shared first segment class.
+    **/
+    class MapRoot final {
+    private:
+        /** Dummy structure for size and alignment retrieval, the two first words for 'check_counters'.
+        **/
+        struct Dummy {
+            size_t dummy0;
+            size_t dummy1;
+            size_t dummy2;
+            void*  dummy3;
+        };
+    public:
+        /** Get the segment size.
+         * @return Segment size (in bytes)
+        **/
+        constexpr static auto size() noexcept {
+            return sizeof(Dummy);
+        }
+        /** Get the segment alignment.
+         * @return Segment alignment (in bytes)
+        **/
+        constexpr static auto align() noexcept {
+            return alignof(Dummy);
+        }
+    public:
+        /** Private copy of the table description, laid out as in shared memory.
+        **/
+        struct Header {
+            size_t     nbbuckets; // Number of buckets
+            MapEntry** table;     // Head of each bucket
+        };
+    private:
+        Transaction& tx; // Associated pending transaction
+    public:
+        Shared<size_t>   nbbuckets; // Number of buckets
+        Shared<MapEntry**>   table; // Head of each bucket, allocated
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        MapRoot(MapRoot const&) = delete;
+        MapRoot& operator=(MapRoot const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Segment base address
+        **/
+        MapRoot(Transaction& tx, void* address): tx{tx}, nbbuckets{tx, reinterpret_cast<uint8_t*>(address) + offsetof(Dummy, dummy2)}, table{tx, nbbuckets.after()} {}
+    public:
+        /** Read the table description with a single transactional read.
+         * @return Private copy of the table description
+        **/
+        Header header() const {
+            Header res;
+            tx.read(nbbuckets.get(), sizeof(Header), &res);
+            return res;
+        }
+    };
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram get_tx;    // Lookup transactions
+        Histogram put_tx;    // Insertion/update transactions
+        Histogram delete_tx; // Removal transactions
+        Histogram resize_tx; // Resize transactions
+        ptrdiff_t delta = 0; // Successful insertions minus successful removals
+    };
+    /** Position of a key in its bucket.
+    **/
+    struct Position {
+        MapEntry**       link;   // Link to the entry reached: the bucket head, or the 'next' of its predecessor
+        MapEntry*        entry;  // Entry of the key, 'nullptr' if none
+        MapEntry::Header header; // Private copy of the entry (undefined if none)
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    Key    key_range;    // Keys are between 0 and 'key_range - 1'
+    size_t nbbuckets;    // Initial number of buckets, resizes doubling it up to 8 times as many then going back to it
+    float  prob_update;  // Probability of a put or a delete, each equally likely, instead of a get
+    float  prob_resize;  // Probability of a resize, instead of a point transaction
+    AccessPattern access; // Access pattern over the keys
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Hash table workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param key_range    Number of keys, half of them initially in the table
+     * @param nbbuckets    Initial number of buckets
+     * @param prob_update  Probability of a put or a delete instead of a get
+     * @param prob_resize  Probability of a resize instead of a point transaction
+     * @param access       Access pattern over the keys
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadHashMap(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, Key key_range, size_t nbbuckets, float prob_update, float prob_resize, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): Workload{library, MapRoot::align(), MapRoot::size()}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, key_range{key_range}, nbbuckets{nbbuckets}, prob_update{prob_update}, prob_resize{prob_resize}, access{access}, arrival_rate{arrival_rate}, barrier(nbworkers), states(nbworkers) {}
+private:
+    /** Get the bucket of a key.
+     * @param key       Key to place
+     * @param nbbuckets Number of buckets
+     * @return Bucket index
+    **/
+    constexpr static size_t bucket_of(Key key, size_t nbbuckets) noexcept {
+        return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9e3779b97f4a7c15ull) >> 32) % nbbuckets;
+    }
+    /** Check that a value belongs to a key, every value written for key 'k' being 'k' modulo the key range.
+     * @param key   Key of the entry
+     * @param value Value of the entry
+     * @return Whether the value belongs to the key
+    **/
+    bool is_valid(Key key, Value value) const noexcept {
+        return value % key_range == key;
+    }
+    /** Walk the bucket of a key up to its entry.
+     * @param tx  Associated pending transaction
+     * @param key Key to look for
+     * @return Position reached
+    **/
+    Position locate(Transaction& tx, Key key) const {
+        auto root = MapRoot{tx, tm.get_start()}.header();
+        Shared<MapEntry*[]> table{tx, root.table};
+        Position res{table[bucket_of(key, root.nbbuckets)].get(), nullptr, {}};
+        res.entry = Shared<MapEntry*>{tx, res.link}.read();
+        while (res.entry) {
+            MapEntry entry{tx, res.entry};
+            res.header = entry.header();
+            if (res.header.key == key)
+                break;
+            res.link = entry.next.get();
+            res.entry = res.header.next;
+        }
+        return res;
+    }
+    /** Lookup transaction.
+     * @param key   Key to look for
+     * @param valid Set to whether the value found, if any, belongs to the key
+     * @return Whether the key is in the table
+    **/
+    bool get_tx(Key key, bool& valid) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto pos = locate(tx, key);
+            valid = !pos.entry || is_valid(key, pos.header.value);
+            return pos.entry != nullptr;
+        });
+    }
+    /** Insertion/update transaction.
+     * @param key   Key to insert or update
+     * @param value Value to set
+     * @return Whether the key was not in the table
+    **/
+    bool put_tx(Key key, Value value) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto pos = locate(tx, key);
+            if (pos.entry) {
+                MapEntry{tx, pos.entry}.value = value;
+                return false;
+            }
+            auto fresh = reinterpret_cast<MapEntry*>(tx.alloc(MapEntry::size()));
+            MapEntry entry{tx, fresh};
+            entry.key = key;
+            entry.value = value;
+            entry.next = nullptr;
+            Shared<MapEntry*>{tx, pos.link} = fresh; // Appended at the end of the bucket
+            return true;
+        });
+    }
+    /** Removal transaction.
+     * @param key Key to remove
+     * @return Whether the key was in the table
+    **/
+    bool delete_tx(Key key) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            auto pos = locate(tx, key);
+            if (!pos.entry)
+                return false;
+            Shared<MapEntry*>{tx, pos.link} = pos.header.next;
+            tx.free(pos.entry);
+            return true;
+        });
+    }
+    /** Resize transaction, rehashing every entry into a new table twice as large, or back to the initial size.
+    **/
+    void resize_tx() const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            MapRoot root{tx, tm.get_start()};
+            auto header = root.header();
+            auto count = header.nbbuckets >= 8 * nbbuckets ? nbbuckets : 2 * header.nbbuckets;
+            thread_local ::std::vector<MapEntry*> heads;
+            heads.resize(header.nbbuckets);
+            Shared<MapEntry*[]>{tx, header.table}.read(0, header.nbbuckets, heads.data());
+            thread_local ::std::vector<MapEntry*> rehashed;
+            rehashed.assign(count, nullptr);
+            for (auto head: heads) { // Pushed in front of their new bucket
+                for (auto current = head; current;) {
+                    MapEntry entry{tx, current};
+                    auto old = entry.header();
+                    auto& target = rehashed[bucket_of(old.key, count)];
+                    if (old.next != target)
+                        entry.next = target;
+                    target = current;
+                    current = old.next;
+                }
+            }
+            auto table = reinterpret_cast<MapEntry**>(tx.alloc(count * sizeof(MapEntry*)));
+            tx.write(rehashed.data(), count * sizeof(MapEntry*), table);
+            tx.free(header.table);
+            root.nbbuckets = count;
+            root.table = table;
+        });
+    }
+    /** Whole-table transaction, checking that every entry is in its bucket with a valid value.
+     * @param size Set to the number of keys in the table, if consistent
+     * @return Whether no inconsistency has been found
+    **/
+    bool walk_tx(size_t& size) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto root = MapRoot{tx, tm.get_start()}.header();
+            Shared<MapEntry*[]> table{tx, root.table};
+            size_t count = 0;
+            for (size_t i = 0; i < root.nbbuckets; ++i) {
+                for (auto current = table.read(i); current;) {
+                    auto entry = MapEntry{tx, current}.header();
+                    if (unlikely(entry.key >= key_range || bucket_of(entry.key, root.nbbuckets) != i || !is_valid(entry.key, entry.value)))
+                        return false;
+                    ++count;
+                    current = entry.next;
+                }
+            }
+            size = count;
+            return true;
+        });
+    }
+    /** Get the initial number of keys in the table.
+     * @return Initial number of keys
+    **/
+    size_t initial_size() const noexcept {
+        return (key_range + 1) / 2;
+    }
+public:
+    virtual char const* init() const {
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            MapRoot root{tx, tm.get_start()};
+            auto header = root.header();
+            if (header.table) { // Entries and table of a previous initialization
+                Shared<MapEntry*[]> table{tx, header.table};
+                for (size_t i = 0; i < header.nbbuckets; ++i) {
+                    for (auto current = table.read(i); current;) {
+                        auto next = MapEntry{tx, current}.next.read();
+                        tx.free(current);
+                        current = next;
+                    }
+                }
+                tx.free(header.table);
+            }
+            ::std::vector<MapEntry*> heads(nbbuckets, nullptr);
+            for (size_t i = 0; i < initial_size(); ++i) { // Every even key, with itself as value
+                auto fresh = reinterpret_cast<MapEntry*>(tx.alloc(MapEntry::size()));
+                MapEntry entry{tx, fresh};
+                auto& head = heads[bucket_of(2 * i, nbbuckets)];
+                entry.key = 2 * i;
+                entry.value = 2 * i;
+                entry.next = head;
+                head = fresh;
+            }
+            auto table = reinterpret_cast<MapEntry**>(tx.alloc(nbbuckets * sizeof(MapEntry*)));
+            tx.write(heads.data(), nbbuckets * sizeof(MapEntry*), table);
+            root.nbbuckets = nbbuckets;
+            root.table = table;
+        });
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto root = MapRoot{tx, tm.get_start()}.header();
+            return root.nbbuckets == nbbuckets && root.table != nullptr;
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::bernoulli_distribution resize_dist{prob_resize};
+        ::std::bernoulli_distribution update_dist{prob_update};
+        ::std::bernoulli_distribution put_dist{0.5};
+        ::std::uniform_int_distribution<Key> uniform{0, key_range - 1};
+        ::std::uniform_int_distribution<Value> version{0, 1023};
+        auto table = access.kind == AccessPattern::Kind::uniform ? ::std::optional<AliasTable>{} : ::std::optional<AliasTable>{::std::in_place, access, key_range};
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            if (resize_dist(engine)) { // Do a resize
+                pacer.start();
+                resize_tx();
+                local.resize_tx.record(pacer.latency());
+                continue;
+            }
+            auto key = table ? static_cast<Key>((*table)(engine)) : uniform(engine);
+            if (update_dist(engine)) {
+                if (put_dist(engine)) { // Do an insertion/update
+                    auto value = key + key_range * version(engine);
+                    pacer.start();
+                    if (put_tx(key, value))
+                        ++local.delta;
+                    local.put_tx.record(pacer.latency());
+                } else { // Do a removal
+                    pacer.start();
+                    if (delete_tx(key))
+                        --local.delta;
+                    local.delete_tx.record(pacer.latency());
+                }
+            } else { // Do a lookup
+                bool valid;
+                pacer.start();
+                get_tx(key, valid);
+                local.get_tx.record(pacer.latency());
+                if (unlikely(!valid))
+                    return "Violated isolation or atomicity";
+            }
+        }
+        { // Last whole-table transaction
+            size_t dummy;
+            if (!walk_tx(dummy))
+                return "Violated isolation or atomicity";
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.resize_tx.merge(local.resize_tx);
+            res.put_tx.merge(local.put_tx);
+            res.delete_tx.merge(local.delete_tx);
+            res.get_tx.merge(local.get_tx);
+        }
+        return {{"resize", res.resize_tx}, {"put", res.put_tx}, {"delete", res.delete_tx}, {"get", res.get_tx}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every insertion and removal counted exactly once, before the counters overwrite the first words
+            auto expected = static_cast<ptrdiff_t>(initial_size());
+            for (auto const& local: states)
+                expected += local.delta;
+            size_t size;
+            if (unlikely(!walk_tx(size) || static_cast<ptrdiff_t>(size) != expected))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Skip list set workload class, with lookups, insertions, removals and range scans.
+ * The top levels of the first nodes, and above all the level heads in the first segment, are read by every transaction and written by
+ * the insertions and removals of tall nodes: this hot metadata near the "root" is where stripe-based and value-based engines differ.
+**/
+class WorkloadSkipList final: public Workload {
+public:
+    /** Key class alias.
+    **/
+    using Key = size_t;
+    /** Maximum number of levels, enough for about 2^24 keys.
+    **/
+    constexpr static size_t max_height = 24;
+private:
+    /** Shared skip list node class.
+    **/
+    class SkipNode final {
+    private:
+        /** Dummy structure for size and alignment retrieval.
+        **/
+        struct Dummy {
+            Key    dummy0;
+            size_t dummy1;
+            void*  dummy2[];
+        };
+    public:
+        /** Get the node size for a given height.
+         * @param height Number of levels of the node
+         * @return Node size (in bytes)
+        **/
+        constexpr static auto size(size_t height) noexcept {
+            return sizeof(Dummy) + height * sizeof(void*);
+        }
+    public:
+        /** Private copy of the fields in front of the links, laid out as in shared memory.
+        **/
+        struct Header {
+            Key    key;    // Key of the node
+            size_t height; // Number of levels of the node
+        };
+        static_assert(sizeof(Header) == offsetof(Dummy, dummy2), "Header does not match the node layout");
+    private:
+        Transaction& tx; // Associated pending transaction
+    public:
+        Shared<Key>           key; // Key of the node
+        Shared<size_t>     height; // Number of levels of the node
+        Shared<SkipNode*[]>  next; // Next node at each level, 'nullptr' for none
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        SkipNode(SkipNode const&) = delete;
+        SkipNode& operator=(SkipNode const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Block base address
+        **/
+        SkipNode(Transaction& tx, void* address): tx{tx}, key{tx, address}, height{tx, key.after()}, next{tx, height.after()} {}
+    public:
+        /** Read the fields in front of the links with a single transactional read.
+         * @return Private copy of the fields
+        **/
+        Header header() const {
+            Header res;
+            tx.read(key.get(), sizeof(Header), &res);
+            return res;
+        }
+    };
+    /** Shared first segment class.
+    **/
+    class SkipRoot final {
+    private:
+        /** Dummy structure for size and alignment retrieval, the two first words for 'check_counters'.
+        **/
+        struct Dummy {
+            size_t dummy0;
+            size_t dummy1;
+            void*  dummy2[max_height];
+        };
+    public:
+        /** Get the segment size.
+         * @return Segment size (in bytes)
+        **/
+        constexpr static auto size() noexcept {
+            return sizeof(Dummy);
+        }
+        /** Get the segment alignment.
+         * @return Segment alignment (in bytes)
+        **/
+        constexpr static auto align() noexcept {
+            return alignof(Dummy);
+        }
+    public:
+        Shared<SkipNode*[]> heads; // First node at each level, 'nullptr' for none
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        SkipRoot(SkipRoot const&) = delete;
+        SkipRoot& operator=(SkipRoot const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Segment base address
+        **/
+        SkipRoot(Transaction& tx, void* address): heads{tx, reinterpret_cast<uint8_t*>(address) + offsetof(Dummy, dummy2)} {}
+    };
+    /** Per-worker state, on cache lines of their own.
+    **/
+    struct alignas(64) WorkerState {
+        Histogram scan_tx;     // Range scan transactions
+        Histogram insert_tx;   // Insertion transactions
+        Histogram remove_tx;   // Removal transactions
+        Histogram contains_tx; // Lookup transactions
+        ptrdiff_t delta = 0;   // Successful insertions minus successful removals
+    };
+    /** Position of a key, at every level.
+    **/
+    struct Position {
+        SkipNode** links[max_height]; // Link to the node reached at each level: a head, or the 'next' of its predecessor at that level
+        SkipNode*  nodes[max_height]; // First node whose key is not lower at each level, 'nullptr' for none
+        Key        key;               // Key of the node reached at the lowest level (undefined if none)
+    };
+private:
+    size_t nbworkers;    // Number of concurrent workers
+    size_t nbtxperwrk;   // Number of transactions per worker, 0 for as many as possible until asked to stop
+    Key    key_range;    // Keys are between 0 and 'key_range - 1'
+    float  prob_update;  // Probability of an insertion or a removal, each equally likely, instead of a lookup or a scan
+    float  prob_scan;    // Probability of a range scan, instead of a lookup
+    size_t scan_length;  // Number of keys read by a range scan, at most
+    AccessPattern access; // Access pattern over the keys
+    double arrival_rate; // Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    Barrier barrier;     // Barrier for thread synchronization during 'check'
+    mutable ::std::atomic<bool> built; // Whether a worker already (re)built the initial set
+    mutable ::std::vector<WorkerState> states; // State of each worker
+public:
+    /** Skip list workload constructor.
+     * @param library      Transactional library to use
+     * @param nbworkers    Total number of concurrent threads (for both 'run' and 'check')
+     * @param nbtxperwrk   Number of transactions per worker, 0 for as many as possible until asked to stop (see 'set_stopping')
+     * @param key_range    Number of keys, half of them initially in the set
+     * @param prob_update  Probability of an insertion or a removal instead of a lookup or a scan
+     * @param prob_scan    Probability of a range scan instead of a lookup
+     * @param scan_length  Number of keys read by a range scan, at most
+     * @param access       Access pattern over the keys
+     * @param arrival_rate Aggregate arrival rate of the transactions (in TX/s), 0 for closed-loop workers
+    **/
+    WorkloadSkipList(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, Key key_range, float prob_update, float prob_scan, size_t scan_length, AccessPattern const& access = AccessPattern{}, double arrival_rate = 0.): Workload{library, SkipRoot::align(), SkipRoot::size()}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, key_range{key_range}, prob_update{prob_update}, prob_scan{prob_scan}, scan_length{scan_length}, access{access}, arrival_rate{arrival_rate}, barrier(nbworkers), built{false}, states(nbworkers) {}
+private:
+    /** Draw the height of a new node, each level half as likely as the one below.
+     * @param engine Random engine to use
+     * @return Height, between 1 and 'max_height'
+    **/
+    template<class Engine> static size_t draw_height(Engine& engine) {
+        size_t res = 1;
+        for (auto bits = engine(); res < max_height && (bits & 1); bits >>= 1) // 'minstd_rand' gives 31 bits, more than enough
+            ++res;
+        return res;
+    }
+    /** Descend the levels down to the first node whose key is not lower than a given one.
+     * @param tx  Associated pending transaction
+     * @param key Key to look for
+     * @param pos Position reached
+    **/
+    void locate(Transaction& tx, Key key, Position& pos) const {
+        SkipRoot root{tx, tm.get_start()};
+        SkipNode* heads[max_height];
+        root.heads.read_range(0, max_height, heads);
+        SkipNode* pred = nullptr; // Predecessor at the current level, 'nullptr' for the heads
+        for (auto level = max_height; level-- > 0;) {
+            auto links = pred ? SkipNode{tx, pred}.next.get() : root.heads.get();
+            auto node = pred ? Shared<SkipNode*>{tx, links + level}.read() : heads[level];
+            while (node) {
+                auto header = SkipNode{tx, node}.header();
+                pos.key = header.key;
+                if (header.key >= key)
+                    break;
+                pred = node;
+                links = SkipNode{tx, pred}.next.get();
+                node = Shared<SkipNode*>{tx, links + level}.read();
+            }
+            pos.links[level] = links + level;
+            pos.nodes[level] = node;
+        }
+    }
+    /** Lookup transaction.
+     * @param key Key to look for
+     * @return Whether the key is in the set
+    **/
+    bool contains_tx(Key key) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            Position pos;
+            locate(tx, key, pos);
+            return pos.nodes[0] && pos.key == key;
+        });
+    }
+    /** Insertion transaction.
+     * @param key    Key to insert
+     * @param height Height of the node to insert
+     * @return Whether the key was not in the set
+    **/
+    bool insert_tx(Key key, size_t height) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            Position pos;
+            locate(tx, key, pos);
+            if (pos.nodes[0] && pos.key == key)
+                return false;
+            auto fresh = reinterpret_cast<SkipNode*>(tx.alloc(SkipNode::size(height)));
+            SkipNode node{tx, fresh};
+            node.key = key;
+            node.height = height;
+            for (size_t level = 0; level < height; ++level) {
+                node.next[level] = pos.nodes[level];
+                Shared<SkipNode*>{tx, pos.links[level]} = fresh;
+            }
+            return true;
+        });
+    }
+    /** Removal transaction.
+     * @param key Key to remove
+     * @return Whether the key was in the set
+    **/
+    bool remove_tx(Key key) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            Position pos;
+            locate(tx, key, pos);
+            if (!pos.nodes[0] || pos.key != key)
+                return false;
+            auto victim = pos.nodes[0];
+            SkipNode node{tx, victim};
+            auto height = node.height.read();
+            for (size_t level = 0; level < height; ++level) // The node is the one reached at each of its levels
+                Shared<SkipNode*>{tx, pos.links[level]} = node.next.read(level);
+            tx.free(victim);
+            return true;
+        });
+    }
+    /** Range scan transaction.
+     * @param key First key of the range
+     * @return Whether no inconsistency has been found
+    **/
+    bool scan_tx(Key key) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            Position pos;
+            locate(tx, key, pos);
+            auto node = pos.nodes[0];
+            auto last = key;
+            for (size_t i = 0; node && i < scan_length; ++i) {
+                SkipNode current{tx, node};
+                auto header = current.header();
+                if (unlikely(header.key < last || (i > 0 && header.key == last) || header.key >= key_range))
+                    return false;
+                last = header.key;
+                node = current.next.read(0);
+            }
+            return true;
+        });
+    }
+    /** Whole-set transaction, checking the order of the keys at every level.
+     * @param size Set to the number of keys in the set, if consistent
+     * @return Whether no inconsistency has been found
+    **/
+    bool walk_tx(size_t& size) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            size_t count = 0;
+            auto node = SkipRoot{tx, tm.get_start()}.heads.read(0);
+            while (node) {
+                SkipNode current{tx, node};
+                auto header = current.header();
+                if (unlikely(header.key >= key_range || header.height == 0 || header.height > max_height))
+                    return false;
+                for (size_t level = 0; level < header.height; ++level) {
+                    auto next = current.next.read(level);
+                    if (unlikely((next && SkipNode{tx, next}.key.read() <= header.key)))
+                        return false;
+                }
+                ++count;
+                node = current.next.read(0);
+            }
+            size = count;
+            return true;
+        });
+    }
+    /** Get the initial number of keys in the set.
+     * @return Initial number of keys
+    **/
+    size_t initial_size() const noexcept {
+        return (key_range + 1) / 2;
+    }
+public:
+    virtual char const* init() const {
+        if (built.exchange(true)) // Another worker (re)builds the set, and the workers wait for each other before running
+            return nullptr;
+        transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) { // Nodes of a previous initialization, if any
+            SkipRoot root{tx, tm.get_start()};
+            for (auto node = root.heads.read(0); node;) {
+                auto next = SkipNode{tx, node}.next.read(0);
+                tx.free(node);
+                node = next;
+            }
+            for (size_t level = 0; level < max_height; ++level)
+                root.heads[level] = nullptr;
+        });
+        // Every even key, in ascending order and in batches, so that large sets do not need a huge transaction
+        constexpr size_t batch = 4096;
+        ::std::minstd_rand engine{static_cast<::std::minstd_rand::result_type>(key_range)};
+        SkipNode** tails[max_height]; // Last link at each level
+        transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto heads = SkipRoot{tx, tm.get_start()}.heads.get();
+            for (size_t level = 0; level < max_height; ++level)
+                tails[level] = heads + level;
+        });
+        for (size_t first = 0; first < initial_size(); first += batch) {
+            ::std::vector<size_t> heights;
+            for (auto i = first; i < first + batch && i < initial_size(); ++i)
+                heights.push_back(draw_height(engine));
+            SkipNode** links[max_height];
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                ::std::copy(tails, tails + max_height, links);
+                for (size_t i = 0; i < heights.size(); ++i) {
+                    auto fresh = reinterpret_cast<SkipNode*>(tx.alloc(SkipNode::size(heights[i])));
+                    SkipNode node{tx, fresh};
+                    node.key = 2 * (first + i);
+                    node.height = heights[i];
+                    for (size_t level = 0; level < heights[i]; ++level) {
+                        node.next[level] = nullptr;
+                        Shared<SkipNode*>{tx, links[level]} = fresh;
+                        links[level] = node.next.get() + level;
+                    }
+                }
+            });
+            ::std::copy(links, links + max_height, tails);
+        }
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            auto head = SkipRoot{tx, tm.get_start()}.heads.read(0);
+            return head && SkipNode{tx, head}.key == 0;
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
+    virtual char const* run(Uid uid, Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::bernoulli_distribution update_dist{prob_update};
+        ::std::bernoulli_distribution insert_dist{0.5};
+        ::std::bernoulli_distribution scan_dist{prob_scan};
+        ::std::uniform_int_distribution<Key> uniform{0, key_range - 1};
+        auto table = access.kind == AccessPattern::Kind::uniform ? ::std::optional<AliasTable>{} : ::std::optional<AliasTable>{::std::in_place, access, key_range};
+        auto& local = states[uid];
+        Pacer pacer{arrival_rate, nbworkers, seed};
+        for (size_t cntr = 0; nbtxperwrk > 0 ? cntr < nbtxperwrk : !stopping.load(::std::memory_order_relaxed); ++cntr) {
+            pacer.wait();
+            auto key = table ? static_cast<Key>((*table)(engine)) : uniform(engine);
+            if (update_dist(engine)) {
+                if (insert_dist(engine)) { // Do an insertion
+                    auto height = draw_height(engine);
+                    pacer.start();
+                    if (insert_tx(key, height))
+                        ++local.delta;
+                    local.insert_tx.record(pacer.latency());
+                } else { // Do a removal
+                    pacer.start();
+                    if (remove_tx(key))
+                        --local.delta;
+                    local.remove_tx.record(pacer.latency());
+                }
+            } else if (scan_dist(engine)) { // Do a range scan
+                pacer.start();
+                auto consistent = scan_tx(key);
+                local.scan_tx.record(pacer.latency());
+                if (unlikely(!consistent))
+                    return "Violated isolation or atomicity";
+            } else { // Do a lookup
+                pacer.start();
+                contains_tx(key);
+                local.contains_tx.record(pacer.latency());
+            }
+        }
+        { // Last whole-set transaction
+            size_t dummy;
+            if (!walk_tx(dummy))
+                return "Violated isolation or atomicity";
+        }
+        return nullptr;
+    }
+    virtual ::std::vector<::std::pair<char const*, Histogram>> get_latencies() const {
+        WorkerState res;
+        for (auto const& local: states) {
+            res.scan_tx.merge(local.scan_tx);
+            res.insert_tx.merge(local.insert_tx);
+            res.remove_tx.merge(local.remove_tx);
+            res.contains_tx.merge(local.contains_tx);
+        }
+        return {{"scan", res.scan_tx}, {"insert", res.insert_tx}, {"remove", res.remove_tx}, {"lookup", res.contains_tx}};
+    }
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        char const* error = nullptr;
+        barrier.sync(uid);
+        if (uid == 0) { // Every insertion and removal counted exactly once, before the counters overwrite the first words
+            auto expected = static_cast<ptrdiff_t>(initial_size());
+            for (auto const& local: states)
+                expected += local.delta;
+            size_t size;
+            if (unlikely(!walk_tx(size) || static_cast<ptrdiff_t>(size) != expected))
+                error = "Violated isolation or atomicity";
+        }
+        auto res = check_counters(uid, nbworkers, barrier);
+        return error ? error : res;
+    }
+};
@@ -0,0 +1,163 @@
+/**
+ * @file   tm_ext.h
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Optional extensions of the transaction manager interface (C version).
+ * A library may not export them, look them up with 'dlsym' before use.
+**/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tm.h"
+
+// -------------------------------------------------------------------------- //
+
+struct tm_mode {
+    char const* engine;  // Engine currently running the transactions
+    bool adaptive;       // Whether the region switches engines at runtime
+    double abort_rate;   // Abort rate over the last window (adaptive only)
+    double upper;        // Abort rate above which the optimistic engine is left (adaptive only)
+    uint64_t window;     // Transactions per thread in one window (adaptive only)
+    uint64_t probe;      // Windows spent in the pessimistic engine before trying the optimistic one again (adaptive only)
+    uint64_t switches;   // Engine switches so far
+};
+
+// Reasons of an abort, indices in 'tm_stats::aborts'
+#define TM_ABORT_READ     0 // A read found the location changed since the snapshot
+#define TM_ABORT_LOCK     1 // A lock the transaction needed was held
+#define TM_ABORT_VALIDATE 2 // The read set was invalidated before commit
+#define TM_ABORT_OTHER    3 // Invalid address (e.g. segment freed meanwhile) or out of memory
+#define TM_ABORT_REASONS  4
+
+// Classes of 'tm_begin_class', indices in 'tm_stats::class_commits' and 'tm_stats::class_aborts'
+#define TM_CLASS_INTERACTIVE 0 // Latency-critical, e.g. on a request path; what 'tm_begin' begins
+#define TM_CLASS_BATCH       1 // Background work, yielding to the interactive transactions
+#define TM_CLASSES           2
+
+// Buckets of 'tm_stats::retries': commits after 0, 1, 2-3, 4-7, ... aborts, the last one for 64 and more
+#define TM_RETRY_BUCKETS 8
+
+struct tm_stats {
+    uint64_t commits;
+    uint64_t aborts[TM_ABORT_REASONS];
+    uint64_t reads;  // Calls to 'tm_read'
+    uint64_t writes; // Calls to 'tm_write'
+    uint64_t allocs; // Successful calls to 'tm_alloc'
+    uint64_t frees;  // Successful calls to 'tm_free'
+    uint64_t extensions; // Snapshots moved forward instead of aborting
+    uint64_t irrevocable; // Transactions run in the serial irrevocable mode, among 'commits'
+    uint64_t stripes; // Stripes of the lock table (tl2 and adaptive only)
+    uint64_t resizes; // Times the lock table was resized (tl2 and adaptive only)
+    uint64_t retries[TM_RETRY_BUCKETS]; // Commits by number of aborts of the same transaction before them
+    uint64_t max_retries; // Most aborts before a commit
+    uint64_t processes; // Processes attached to the object of a region shared between processes
+    uint64_t threads;   // Threads they registered with 'tm_register_thread'
+    uint64_t data_bytes;       // Bytes of the live segments, the first one included
+    uint64_t metadata_bytes;   // Bytes held beyond them (segment headers, page map, lock table, descriptors and logs...)
+    uint64_t descriptor_bytes; // Among them, bytes of the descriptors and logs the threads keep for their transactions
+    uint64_t class_commits[TM_CLASSES]; // Commits by class of 'tm_begin_class', among 'commits'
+    uint64_t class_aborts[TM_CLASSES];  // Aborts by class of 'tm_begin_class'
+};
+
+// Start of a copy written by 'tm_checkpoint' or 'tm_checkpoint_delta', followed by 'segments' of 'tm_checkpoint_segment', the first segment first
+#define TM_CHECKPOINT_MAGIC UINT64_C(0x31706b63786d7470)
+struct tm_checkpoint_header {
+    uint64_t magic;    // TM_CHECKPOINT_MAGIC
+    uint64_t align;    // Alignment of the region
+    uint64_t segments; // Number of segments
+    uint64_t delta;    // Whether only the ranges written since the previous copy are included, a segment missing from it was freed
+};
+struct tm_checkpoint_segment {
+    uint64_t address; // Start of the segment in the process, to relocate the pointers it holds
+    uint64_t size;    // Size of the segment
+    uint64_t ranges;  // Number of 'tm_checkpoint_range' that follow, each followed by its content (one covering the whole segment unless 'delta')
+};
+struct tm_checkpoint_range {
+    uint64_t offset; // Start of the range in the segment
+    uint64_t size;   // Length of the content that follows
+};
+
+// Completion handle of 'tm_end_async', to poll or wait for
+typedef uintptr_t tm_commit_t;
+static tm_commit_t const done_commit = 0;                       // Committed, with nothing left to complete
+static tm_commit_t const aborted_commit = ~((tm_commit_t) 0); // Aborted, to retry as after 'tm_end'
+
+// Mark of 'tm_savepoint', to roll a transaction back to with 'tm_rollback_to'
+typedef size_t tm_savepoint_t;
+
+// Most addresses one call of 'tm_hint' declares, one bit each in its write mask
+#define TM_HINT_MAX 64
+
+// Setting of an on/off knob of 'tm_options'
+#define TM_OPTION_DEFAULT 0 // As 'tm_create' does, i.e. from the build and the environment
+#define TM_OPTION_ON      1
+#define TM_OPTION_OFF     2
+
+// Knobs of the region 'tm_create_ex' creates, a zeroed structure creating it as 'tm_create' does
+struct tm_options {
+    char const* engine;    // Engine, as named in 'TM_ENGINE', NULL for the one 'tm_create' picks
+    size_t stripes;        // Stripes of the tl2 lock table, which then keeps that size, as 'TM_STRIPES', 0 for the default
+    char const* hugepages; // Backing of the large segments, as 'TM_HUGEPAGES' ("none", "thp", "2M" or "1G"), NULL for the default
+    int numa;              // Placement of the memory on the NUMA nodes (builds with USE_NUMA), one of 'TM_OPTION_*'
+    size_t versions;       // Values kept per tl2 stripe (builds with USE_MULTIVERSION), 0 for the default
+    int reclaimer;         // Service thread of the region (builds with USE_RECLAIMER), one of 'TM_OPTION_*'
+    char const* path;      // File holding the first segment, as for 'tm_create_persistent', NULL for a volatile region
+    char const* ship;      // File or pipe the commits are shipped to, for a replica to apply with 'tm_apply', NULL for none
+};
+
+// One access of 'tm_read_batch' or 'tm_write_batch'
+struct tm_access {
+    void* address; // Start address in the shared region
+    size_t size;   // Length (in bytes), a positive multiple of the alignment
+    void* buffer;  // Start address in a private region
+};
+
+// -------------------------------------------------------------------------- //
+
+bool tm_mode(shared_t, struct tm_mode*);
+bool tm_stats(shared_t, struct tm_stats*);
+tx_t tm_begin_irrevocable(shared_t);
+bool tm_read_batch(shared_t, tx_t, struct tm_access const*, size_t);
+bool tm_write_batch(shared_t, tx_t, struct tm_access const*, size_t);
+bool tm_read_for_update(shared_t, tx_t, void const*, size_t, void*);
+bool tm_add(shared_t, tx_t, void*, int64_t);
+void tm_release(shared_t, tx_t, void const*, size_t);
+shared_t tm_create_persistent(char const*, size_t, size_t);
+shared_t tm_create_shared(char const*, size_t, size_t);
+bool tm_register_thread(shared_t);
+void tm_unregister_thread(shared_t);
+bool tm_checkpoint(shared_t, int);
+bool tm_checkpoint_delta(shared_t, int);
+bool tm_thread_enter(shared_t);
+void tm_thread_leave(shared_t);
+bool tm_run(shared_t, bool, bool (*)(shared_t, tx_t, void*), void*);
+bool tm_read_word(shared_t, tx_t, void const*, void*);
+bool tm_write_word(shared_t, tx_t, void const*, void*);
+bool tm_direct(shared_t, tx_t);
+tm_commit_t tm_end_async(shared_t, tx_t);
+bool tm_commit_poll(shared_t, tm_commit_t);
+void tm_commit_wait(shared_t, tm_commit_t);
+bool tm_hint(shared_t, tx_t, void const* const*, size_t, uint64_t);
+tx_t tm_begin_snapshot(shared_t);
+size_t tm_compact(shared_t, void (*)(shared_t, tx_t, void*, void*, size_t, void*), void*);
+tx_t tm_begin_class(shared_t, bool, int);
+shared_t tm_create_ex(size_t, size_t, struct tm_options const*);
+bool tm_savepoint(shared_t, tx_t, tm_savepoint_t*);
+bool tm_rollback_to(shared_t, tx_t, tm_savepoint_t);
+tx_t tm_begin_join(shared_t, tx_t);
+bool tm_apply(shared_t, int);
+bool tm_bulk_write(shared_t, void const*, size_t, void*);
+bool tm_read_view(shared_t, tx_t, void const*, size_t, void const**);
+bool tm_write_reserve(shared_t, tx_t, void*, size_t, void**);
+alloc_t tm_realloc(shared_t, tx_t, void*, size_t, size_t, void**);
+bool tm_end_private(shared_t, tx_t);
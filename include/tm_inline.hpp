@@ -0,0 +1,101 @@
+/**
+ * @file   tm_inline.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Optional inline accessors for C++ callers linked with the library (not for
+ * libraries loaded with 'dlopen'). Reads and writes are typed, of a size known
+ * at compile time, and only call the library when the transaction needs it:
+ * they are plain loads and stores while 'tm_direct' allows them, single words
+ * go through 'tm_read_word' and 'tm_write_word', and the rest through
+ * 'tm_read' and 'tm_write'. The optional functions are declared weak, those
+ * the library does not export are never called.
+**/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "tm.hpp"
+#include "tm_ext.hpp"
+
+// -------------------------------------------------------------------------- //
+
+extern "C" {
+    [[gnu::weak]] bool tm_direct(shared_t, tx_t) noexcept;
+    [[gnu::weak]] bool tm_read_word(shared_t, tx_t, void const*, void*) noexcept;
+    [[gnu::weak]] bool tm_write_word(shared_t, tx_t, void const*, void*) noexcept;
+}
+
+namespace stm { // Not 'tm', which would collide with 'struct tm' of <ctime>
+
+/** Transaction handle, with what its accesses may skip, queried once.
+**/
+class Tx final {
+    template<class T> friend bool read(Tx const&, T const*, T&) noexcept;
+    template<class T> friend bool write(Tx const&, T const&, T*) noexcept;
+private:
+    shared_t shared; // Shared memory region
+    tx_t id;         // Transaction from 'tm_begin'
+    bool direct;     // Whether the accesses are plain loads and stores
+    bool word;       // Whether the region has an alignment of 8 bytes, for 'tm_read_word' and 'tm_write_word'
+public:
+    /** Handle constructor, to build right after a successful 'tm_begin'.
+     * @param shared Shared memory region
+     * @param id     Transaction to access the region with
+    **/
+    Tx(shared_t shared, tx_t id) noexcept: shared{shared}, id{id}, direct{tm_direct && tm_direct(shared, id)}, word{tm_align(shared) == sizeof(uint64_t)} {}
+    /** Get the transaction, e.g. for 'tm_end'.
+     * @return Transaction
+    **/
+    tx_t get() const noexcept {
+        return id;
+    }
+};
+
+/** [thread-safe] Read one object in the given transaction.
+ * @param tx     Transaction to use
+ * @param source Object to read (in the shared region), its size a multiple of the alignment of the region
+ * @param target Object receiving the value
+ * @return Whether the whole transaction can continue
+**/
+template<class T> inline bool read(Tx const& tx, T const* source, T& target) noexcept {
+    static_assert(::std::is_trivially_copyable_v<T>, "only trivially copyable objects can be read from the shared region");
+    if (tx.direct) {
+        ::std::memcpy(&target, source, sizeof(T));
+        return true;
+    }
+    if constexpr (sizeof(T) == sizeof(uint64_t)) {
+        if (tm_read_word && tx.word)
+            return tm_read_word(tx.shared, tx.id, source, &target);
+    }
+    return tm_read(tx.shared, tx.id, source, sizeof(T), &target);
+}
+
+/** [thread-safe] Write one object in the given transaction.
+ * @param tx     Transaction to use
+ * @param source Value to write
+ * @param target Object receiving the value (in the shared region), its size a multiple of the alignment of the region
+ * @return Whether the whole transaction can continue
+**/
+template<class T> inline bool write(Tx const& tx, T const& source, T* target) noexcept {
+    static_assert(::std::is_trivially_copyable_v<T>, "only trivially copyable objects can be written to the shared region");
+    if (tx.direct) {
+        ::std::memcpy(target, &source, sizeof(T));
+        return true;
+    }
+    if constexpr (sizeof(T) == sizeof(uint64_t)) {
+        if (tm_write_word && tx.word)
+            return tm_write_word(tx.shared, tx.id, &source, target);
+    }
+    return tm_write(tx.shared, tx.id, &source, sizeof(T), target);
+}
+
+}
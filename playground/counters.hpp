@@ -0,0 +1,148 @@
+/**
+ * @file   counters.hpp
+ * @author Sébastien Rouault <sebastien.rouault@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2018-2019 Sébastien Rouault.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version. Please see https://gnu.org/licenses/gpl.html
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * @section DESCRIPTION
+ *
+ * Shared counter implementations, from one contended cache line to one line
+ * per thread (see 'counters' in runner.cpp). Each counter is incremented by
+ * thread 'id' (from 0 to the number of threads excluded) and read by summing
+ * its shards.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <sched.h>
+#include <vector>
+
+// -------------------------------------------------------------------------- //
+
+/** Get the socket of a CPU, from its package.
+ * @param cpu CPU index
+ * @return Socket index, 0 if unknown
+**/
+static int cpu_socket(int cpu) {
+    char path[96];
+    ::snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    auto file = ::fopen(path, "r");
+    if (!file)
+        return 0;
+    int id = 0;
+    if (::fscanf(file, "%d", &id) != 1 || id < 0)
+        id = 0;
+    ::fclose(file);
+    return id;
+}
+
+/** One atomic counter, every thread incrementing the same cache line.
+**/
+class SharedCounter final {
+private:
+    alignas(64) ::std::atomic<uint64_t> value{0};
+public:
+    SharedCounter(size_t) {}
+    void add(size_t) {
+        value.fetch_add(1, ::std::memory_order_relaxed);
+    }
+    uint64_t read() const {
+        return value.load(::std::memory_order_relaxed);
+    }
+};
+
+/** One counter per thread, packed next to each other: no atomic read-modify-write, but the threads still share (falsely) cache lines.
+**/
+class PackedCounter final {
+private:
+    ::std::unique_ptr<::std::atomic<uint64_t>[]> shards;
+    size_t nbshards;
+public:
+    PackedCounter(size_t nbthreads): shards{new ::std::atomic<uint64_t>[nbthreads]}, nbshards{nbthreads} {
+        for (size_t i = 0; i < nbshards; ++i)
+            shards[i].store(0, ::std::memory_order_relaxed);
+    }
+    void add(size_t id) {
+        shards[id].store(shards[id].load(::std::memory_order_relaxed) + 1, ::std::memory_order_relaxed);
+    }
+    uint64_t read() const {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < nbshards; ++i)
+            sum += shards[i].load(::std::memory_order_relaxed);
+        return sum;
+    }
+};
+
+/** One counter per thread, each on a cache line of its own: increments never contend, reads sum every shard.
+**/
+class ThreadCounter final {
+private:
+    struct alignas(64) Shard {
+        ::std::atomic<uint64_t> value{0};
+    };
+    ::std::vector<Shard> shards;
+public:
+    ThreadCounter(size_t nbthreads): shards(nbthreads) {}
+    void add(size_t id) {
+        auto& value = shards[id].value;
+        value.store(value.load(::std::memory_order_relaxed) + 1, ::std::memory_order_relaxed);
+    }
+    uint64_t read() const {
+        uint64_t sum = 0;
+        for (auto const& shard: shards)
+            sum += shard.value.load(::std::memory_order_relaxed);
+        return sum;
+    }
+};
+
+/** One counter per socket, each on a cache line of its own: the threads of a socket combine their increments on a line that never leaves the socket, reads sum one shard per socket.
+ * The socket of a thread is looked up at its first increment, the threads being assumed not to migrate to another socket (a migrated thread only costs speed).
+**/
+class SocketCounter final {
+private:
+    static constexpr size_t max_sockets = 8;
+    struct alignas(64) Shard {
+        ::std::atomic<uint64_t> value{0};
+    };
+    Shard shards[max_sockets];
+    /** Get the socket of the calling thread, from the package of the CPU it runs on.
+     * @return Socket index, 0 if unknown
+    **/
+    static size_t socket() {
+        static thread_local auto cached = []() -> size_t {
+            auto cpu = ::sched_getcpu();
+            if (cpu < 0)
+                return 0;
+            return static_cast<size_t>(cpu_socket(cpu)) % max_sockets;
+        }();
+        return cached;
+    }
+public:
+    SocketCounter(size_t) {}
+    void add(size_t) {
+        shards[socket()].value.fetch_add(1, ::std::memory_order_relaxed);
+    }
+    uint64_t read() const {
+        uint64_t sum = 0;
+        for (auto const& shard: shards)
+            sum += shard.value.load(::std::memory_order_relaxed);
+        return sum;
+    }
+};
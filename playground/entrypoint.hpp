@@ -23,11 +23,19 @@
 
 #pragma once
 
+// External headers
+#include <atomic>
+#include <cstddef>
+
 // -------------------------------------------------------------------------- //
 
-/** Your lock class.
+/** Adaptive lock: spin for a while, then park on a futex.
+ * The spin budget follows the observed wait times: it grows when spinning got the lock, and shrinks when it had to park anyway.
 **/
 class Lock final {
+private:
+    ::std::atomic<int> state; // 0 if free, 1 if held, 2 if held and some thread may be parked
+    ::std::atomic<int> spins; // Current spin budget, in pauses
 public:
     /** Deleted copy/move constructor/assignment.
     **/
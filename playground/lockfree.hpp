@@ -0,0 +1,376 @@
+/**
+ * @file   lockfree.hpp
+ * @author Sébastien Rouault <sebastien.rouault@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2018-2019 Sébastien Rouault.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version. Please see https://gnu.org/licenses/gpl.html
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * @section DESCRIPTION
+ *
+ * Lock-free Treiber stack and Michael-Scott queue, each with hazard pointer
+ * or epoch-based reclamation of the removed nodes, and a locked baseline of
+ * both (see 'structures' in runner.cpp). Like the counters, every operation
+ * is made by thread 'id' (from 0 to the number of threads excluded).
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// -------------------------------------------------------------------------- //
+// Reclamation
+
+/** Hazard pointers: a thread publishes each node it is about to dereference, and a removed node is only freed once no thread publishes it.
+ * Each thread scans the hazard pointers of every thread once it retired a few times as many nodes as there are hazard pointers, so at most that many nodes per thread wait to be freed.
+ * @param Node Node type, freed with 'delete'
+**/
+template<class Node> class HazardReclaim final {
+public:
+    static constexpr size_t slots = 2; // Hazard pointers per thread
+private:
+    struct alignas(64) Thread {
+        ::std::atomic<Node*> hazards[slots] = {};
+        ::std::vector<Node*> retired; // Removed nodes not freed yet
+        size_t peak = 0;              // Largest number of removed nodes not freed yet
+    };
+    ::std::vector<Thread> threads;
+    size_t threshold; // Number of retired nodes triggering a scan
+    /** Free the retired nodes of one thread that no thread publishes.
+     * @param thread Calling thread
+    **/
+    void scan(Thread& thread) {
+        ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+        ::std::vector<Node*> hazards;
+        hazards.reserve(threads.size() * slots);
+        for (auto const& other: threads) {
+            for (auto const& hazard: other.hazards) {
+                auto node = hazard.load(::std::memory_order_acquire);
+                if (node)
+                    hazards.push_back(node);
+            }
+        }
+        ::std::sort(hazards.begin(), hazards.end());
+        auto kept = ::std::partition(thread.retired.begin(), thread.retired.end(), [&](Node* node) {
+            return ::std::binary_search(hazards.begin(), hazards.end(), node);
+        });
+        for (auto it = kept; it != thread.retired.end(); ++it)
+            delete *it;
+        thread.retired.erase(kept, thread.retired.end());
+    }
+public:
+    HazardReclaim(size_t nbthreads): threads(nbthreads), threshold{::std::max<size_t>(64, 2 * slots * nbthreads)} {}
+    ~HazardReclaim() {
+        for (auto const& thread: threads) {
+            for (auto node: thread.retired)
+                delete node;
+        }
+    }
+    void enter(size_t) {}
+    /** Clear the hazard pointers of a thread, at the end of its operation.
+     * @param id Calling thread
+    **/
+    void leave(size_t id) {
+        for (auto& hazard: threads[id].hazards)
+            hazard.store(nullptr, ::std::memory_order_release);
+    }
+    /** Load a pointer to a node and publish it, until the published node is still the one pointed to.
+     * @param id     Calling thread
+     * @param slot   Hazard pointer to publish it in, below 'slots'
+     * @param source Pointer to load
+     * @return Loaded node, safe to dereference until the slot is overwritten or cleared
+    **/
+    Node* protect(size_t id, size_t slot, ::std::atomic<Node*> const& source) {
+        auto& hazard = threads[id].hazards[slot];
+        auto node = source.load(::std::memory_order_acquire);
+        while (true) {
+            hazard.store(node, ::std::memory_order_seq_cst);
+            auto again = source.load(::std::memory_order_seq_cst);
+            if (again == node)
+                return node;
+            node = again;
+        }
+    }
+    /** Free a removed node once no thread publishes it anymore.
+     * @param id   Calling thread
+     * @param node Node, unreachable from the structure
+    **/
+    void retire(size_t id, Node* node) {
+        auto& thread = threads[id];
+        thread.retired.push_back(node);
+        thread.peak = ::std::max(thread.peak, thread.retired.size());
+        if (thread.retired.size() >= threshold)
+            scan(thread);
+    }
+    /** Get the largest number of nodes a thread waited to free, once the threads are done.
+     * @return Largest number of removed nodes not freed yet
+    **/
+    size_t peak() const {
+        size_t res = 0;
+        for (auto const& thread: threads)
+            res = ::std::max(res, thread.peak);
+        return res;
+    }
+};
+
+/** Epoch-based reclamation: a thread announces the global epoch for the duration of each operation, and a node removed during epoch 'e' is freed once the global epoch reached 'e + 2'.
+ * The global epoch only advances once every thread in an operation announced it, so one thread stalled in an operation keeps every thread from freeing anything.
+ * @param Node Node type, freed with 'delete'
+**/
+template<class Node> class EpochReclaim final {
+private:
+    static constexpr uint64_t quiescent = UINT64_MAX; // Announced outside of operations
+    static constexpr size_t period = 64;               // Number of retired nodes between two attempts to advance the epoch
+    struct Retired {
+        Node* node;
+        uint64_t epoch; // Global epoch when the node was removed
+    };
+    struct alignas(64) Thread {
+        ::std::atomic<uint64_t> epoch{quiescent}; // Announced epoch
+        ::std::vector<Retired> retired;          // Removed nodes not freed yet, by increasing epoch
+        size_t peak = 0;                         // Largest number of removed nodes not freed yet
+    };
+    alignas(64) ::std::atomic<uint64_t> global{0};
+    ::std::vector<Thread> threads;
+    /** Advance the global epoch if every thread in an operation announced it, then free the retired nodes of one thread that no thread can reach.
+     * @param thread Calling thread
+    **/
+    void collect(Thread& thread) {
+        auto epoch = global.load(::std::memory_order_acquire);
+        ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+        auto current = ::std::all_of(threads.begin(), threads.end(), [&](Thread const& other) {
+            auto announced = other.epoch.load(::std::memory_order_acquire);
+            return announced == quiescent || announced == epoch;
+        });
+        if (current && global.compare_exchange_strong(epoch, epoch + 1, ::std::memory_order_acq_rel))
+            ++epoch;
+        auto freed = ::std::find_if(thread.retired.begin(), thread.retired.end(), [&](Retired const& retired) {
+            return retired.epoch + 2 > epoch;
+        });
+        for (auto it = thread.retired.begin(); it != freed; ++it)
+            delete it->node;
+        thread.retired.erase(thread.retired.begin(), freed);
+    }
+public:
+    EpochReclaim(size_t nbthreads): threads(nbthreads) {}
+    ~EpochReclaim() {
+        for (auto const& thread: threads) {
+            for (auto const& retired: thread.retired)
+                delete retired.node;
+        }
+    }
+    /** Announce the global epoch, at the beginning of an operation.
+     * @param id Calling thread
+    **/
+    void enter(size_t id) {
+        threads[id].epoch.store(global.load(::std::memory_order_relaxed), ::std::memory_order_relaxed);
+        ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+    }
+    /** Announce being out of any operation.
+     * @param id Calling thread
+    **/
+    void leave(size_t id) {
+        threads[id].epoch.store(quiescent, ::std::memory_order_release);
+    }
+    /** Load a pointer to a node, safe to dereference until 'leave'.
+     * @param source Pointer to load
+     * @return Loaded node
+    **/
+    Node* protect(size_t, size_t, ::std::atomic<Node*> const& source) {
+        return source.load(::std::memory_order_acquire);
+    }
+    /** Free a removed node once no thread can reach it anymore.
+     * @param id   Calling thread
+     * @param node Node, unreachable from the structure
+    **/
+    void retire(size_t id, Node* node) {
+        auto& thread = threads[id];
+        thread.retired.push_back(Retired{node, global.load(::std::memory_order_acquire)});
+        thread.peak = ::std::max(thread.peak, thread.retired.size());
+        if (thread.retired.size() % period == 0)
+            collect(thread);
+    }
+    /** Get the largest number of nodes a thread waited to free, once the threads are done.
+     * @return Largest number of removed nodes not freed yet
+    **/
+    size_t peak() const {
+        size_t res = 0;
+        for (auto const& thread: threads)
+            res = ::std::max(res, thread.peak);
+        return res;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+// Structures
+
+/** Treiber stack: a singly-linked list whose head is swapped with a compare-and-swap.
+ * Reclamation also rules out ABA, as a node cannot be freed and allocated again while a thread may compare against it.
+ * @param Reclaim Reclamation of the popped nodes
+**/
+template<template<class> class Reclaim> class TreiberStack final {
+private:
+    struct Node {
+        uint64_t value;
+        Node* next; // Set before the node is pushed, never modified after
+    };
+    alignas(64) ::std::atomic<Node*> head{nullptr};
+    Reclaim<Node> reclaim;
+public:
+    static constexpr bool fifo = false;
+    TreiberStack(size_t nbthreads): reclaim{nbthreads} {}
+    ~TreiberStack() {
+        for (auto node = head.load(::std::memory_order_relaxed); node;) {
+            auto next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+    void push(size_t, uint64_t value) {
+        auto node = new Node{value, head.load(::std::memory_order_relaxed)};
+        while (!head.compare_exchange_weak(node->next, node, ::std::memory_order_release, ::std::memory_order_relaxed));
+    }
+    bool pop(size_t id, uint64_t& value) {
+        reclaim.enter(id);
+        while (true) {
+            auto top = reclaim.protect(id, 0, head);
+            if (!top) {
+                reclaim.leave(id);
+                return false;
+            }
+            if (head.compare_exchange_weak(top, top->next, ::std::memory_order_acquire, ::std::memory_order_relaxed)) {
+                value = top->value;
+                reclaim.leave(id);
+                reclaim.retire(id, top);
+                return true;
+            }
+        }
+    }
+    size_t peak() const {
+        return reclaim.peak();
+    }
+};
+
+/** Michael-Scott queue: a singly-linked list starting with a dummy node, dequeuing swaps the head, enqueuing links after the tail then swings the tail, and any thread finding the tail lagging swings it first.
+ * @param Reclaim Reclamation of the dequeued dummy nodes
+**/
+template<template<class> class Reclaim> class MichaelScottQueue final {
+private:
+    struct Node {
+        uint64_t value; // Set before the node is enqueued, never modified after
+        ::std::atomic<Node*> next{nullptr};
+    };
+    alignas(64) ::std::atomic<Node*> head;
+    alignas(64) ::std::atomic<Node*> tail;
+    Reclaim<Node> reclaim;
+public:
+    static constexpr bool fifo = true;
+    MichaelScottQueue(size_t nbthreads): reclaim{nbthreads} {
+        auto dummy = new Node{};
+        head.store(dummy, ::std::memory_order_relaxed);
+        tail.store(dummy, ::std::memory_order_relaxed);
+    }
+    ~MichaelScottQueue() {
+        for (auto node = head.load(::std::memory_order_relaxed); node;) {
+            auto next = node->next.load(::std::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+    void push(size_t id, uint64_t value) {
+        auto node = new Node{value};
+        reclaim.enter(id);
+        while (true) {
+            auto last = reclaim.protect(id, 0, tail);
+            auto next = last->next.load(::std::memory_order_acquire);
+            if (last != tail.load(::std::memory_order_acquire))
+                continue;
+            if (next) { // Lagging tail
+                tail.compare_exchange_weak(last, next, ::std::memory_order_release, ::std::memory_order_relaxed);
+                continue;
+            }
+            if (last->next.compare_exchange_weak(next, node, ::std::memory_order_release, ::std::memory_order_relaxed)) {
+                tail.compare_exchange_strong(last, node, ::std::memory_order_release, ::std::memory_order_relaxed);
+                break;
+            }
+        }
+        reclaim.leave(id);
+    }
+    bool pop(size_t id, uint64_t& value) {
+        reclaim.enter(id);
+        while (true) {
+            auto first = reclaim.protect(id, 0, head);
+            auto last = tail.load(::std::memory_order_acquire);
+            auto next = reclaim.protect(id, 1, first->next);
+            if (first != head.load(::std::memory_order_acquire)) // 'first' may have been freed before 'next' got published
+                continue;
+            if (!next) {
+                reclaim.leave(id);
+                return false;
+            }
+            if (first == last) { // Lagging tail
+                tail.compare_exchange_weak(last, next, ::std::memory_order_release, ::std::memory_order_relaxed);
+                continue;
+            }
+            auto res = next->value; // Before 'next' becomes the dummy node, and may be dequeued and freed in turn
+            if (head.compare_exchange_weak(first, next, ::std::memory_order_acquire, ::std::memory_order_relaxed)) {
+                value = res;
+                reclaim.leave(id);
+                reclaim.retire(id, first);
+                return true;
+            }
+        }
+    }
+    size_t peak() const {
+        return reclaim.peak();
+    }
+};
+
+/** Stack or queue behind a 'std::mutex', the baseline of the lock-free ones.
+ * @param FIFO Whether to pop the oldest value rather than the newest
+**/
+template<bool FIFO> class LockedStructure final {
+private:
+    ::std::mutex lock;
+    ::std::deque<uint64_t> values;
+public:
+    static constexpr bool fifo = FIFO;
+    LockedStructure(size_t) {}
+    void push(size_t, uint64_t value) {
+        ::std::lock_guard<::std::mutex> guard{lock};
+        values.push_back(value);
+    }
+    bool pop(size_t, uint64_t& value) {
+        ::std::lock_guard<::std::mutex> guard{lock};
+        if (values.empty())
+            return false;
+        if (FIFO) {
+            value = values.front();
+            values.pop_front();
+        } else {
+            value = values.back();
+            values.pop_back();
+        }
+        return true;
+    }
+    size_t peak() const {
+        return 0;
+    }
+};
@@ -0,0 +1,120 @@
+/**
+ * @file   locks.hpp
+ * @author Sébastien Rouault <sebastien.rouault@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2018-2019 Sébastien Rouault.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version. Please see https://gnu.org/licenses/gpl.html
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * @section DESCRIPTION
+ *
+ * Classic spin locks to measure your 'Lock' against (see 'bench' in runner.cpp).
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#endif
+
+// -------------------------------------------------------------------------- //
+
+/** Wait a little while spinning, and let another thread run once in a while (so that spinning is bearable with more threads than cores).
+ * @param spins Number of spins so far, incremented
+**/
+static inline void spin_wait(size_t& spins) {
+    if (++spins % 64 == 0) {
+        ::std::this_thread::yield();
+        return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+/** Test-and-test-and-set lock, spinning on a load until the lock looks free.
+**/
+class TTASLock final {
+private:
+    ::std::atomic<bool> held{false};
+public:
+    void lock() {
+        size_t spins = 0;
+        while (held.load(::std::memory_order_relaxed) || held.exchange(true, ::std::memory_order_acquire))
+            spin_wait(spins);
+    }
+    void unlock() {
+        held.store(false, ::std::memory_order_release);
+    }
+};
+
+/** Ticket lock, granting the lock in arrival order.
+**/
+class TicketLock final {
+private:
+    alignas(64) ::std::atomic<size_t> next{0};  // Next ticket to hand out
+    alignas(64) ::std::atomic<size_t> owner{0}; // Ticket holding the lock
+public:
+    void lock() {
+        auto ticket = next.fetch_add(1, ::std::memory_order_relaxed);
+        size_t spins = 0;
+        while (owner.load(::std::memory_order_acquire) != ticket)
+            spin_wait(spins);
+    }
+    void unlock() {
+        owner.store(owner.load(::std::memory_order_relaxed) + 1, ::std::memory_order_release);
+    }
+};
+
+/** MCS lock, each waiter spinning on a node of its own.
+ * A thread holds at most one MCS lock at a time, as its node is thread-local.
+**/
+class MCSLock final {
+private:
+    /** Queue node of a thread.
+    **/
+    struct alignas(64) Node {
+        ::std::atomic<Node*> next;
+        ::std::atomic<bool> waiting;
+    };
+    static inline thread_local Node node;
+    ::std::atomic<Node*> tail{nullptr};
+public:
+    void lock() {
+        node.next.store(nullptr, ::std::memory_order_relaxed);
+        node.waiting.store(true, ::std::memory_order_relaxed);
+        auto prev = tail.exchange(&node, ::std::memory_order_acq_rel);
+        if (!prev)
+            return;
+        prev->next.store(&node, ::std::memory_order_release);
+        size_t spins = 0;
+        while (node.waiting.load(::std::memory_order_acquire))
+            spin_wait(spins);
+    }
+    void unlock() {
+        auto next = node.next.load(::std::memory_order_acquire);
+        if (!next) {
+            auto self = &node;
+            if (tail.compare_exchange_strong(self, nullptr, ::std::memory_order_release, ::std::memory_order_relaxed))
+                return;
+            size_t spins = 0;
+            while (!(next = node.next.load(::std::memory_order_acquire)))
+                spin_wait(spins);
+        }
+        next->waiting.store(false, ::std::memory_order_release);
+    }
+};
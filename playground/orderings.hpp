@@ -0,0 +1,130 @@
+/**
+ * @file   orderings.hpp
+ * @author Sébastien Rouault <sebastien.rouault@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2018-2019 Sébastien Rouault.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version. Please see https://gnu.org/licenses/gpl.html
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * @section DESCRIPTION
+ *
+ * Atomic operations under each memory ordering, with fences and
+ * compare-and-swap next to fetch-and-add (see 'orderings' in runner.cpp).
+ * Each operation is timed in a loop of its own, so that it is inlined there.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// -------------------------------------------------------------------------- //
+
+/** Word every thread operates on, on a cache line of its own.
+**/
+struct alignas(64) OrderingWord {
+    ::std::atomic<uint64_t> value{0};
+};
+
+/** Run one operation in a loop.
+ * @param Operation Operation, called with the word and the iteration
+ * @param word       Word to operate on
+ * @param iterations Number of operations
+ * @return Duration of the loop, in seconds
+**/
+template<class Operation> static double ordering_loop(OrderingWord& word, size_t iterations) {
+    using Clock = ::std::chrono::steady_clock;
+    uint64_t sink = 0; // Sum of the values read, so that loads are kept
+    auto begin = Clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+        sink += Operation{}(word.value, i);
+    auto end = Clock::now();
+    asm volatile("" :: "r"(sink));
+    return ::std::chrono::duration<double>(end - begin).count();
+}
+
+/** Load.
+**/
+template<::std::memory_order Order> struct OrderingLoad {
+    uint64_t operator()(::std::atomic<uint64_t>& value, size_t) const {
+        return value.load(Order);
+    }
+};
+
+/** Store of the iteration.
+**/
+template<::std::memory_order Order> struct OrderingStore {
+    uint64_t operator()(::std::atomic<uint64_t>& value, size_t i) const {
+        value.store(i, Order);
+        return 0;
+    }
+};
+
+/** Relaxed store followed by a fence, the way a fence orders a batch of relaxed accesses.
+**/
+template<::std::memory_order Order> struct OrderingFence {
+    uint64_t operator()(::std::atomic<uint64_t>& value, size_t i) const {
+        value.store(i, ::std::memory_order_relaxed);
+        ::std::atomic_thread_fence(Order);
+        return 0;
+    }
+};
+
+/** Increment with a fetch-and-add.
+**/
+template<::std::memory_order Order> struct OrderingFetchAdd {
+    uint64_t operator()(::std::atomic<uint64_t>& value, size_t) const {
+        return value.fetch_add(1, Order);
+    }
+};
+
+/** Increment with a compare-and-swap loop, retried until it succeeds (the failures are part of its cost under contention).
+**/
+template<::std::memory_order Order> struct OrderingCAS {
+    uint64_t operator()(::std::atomic<uint64_t>& value, size_t) const {
+        auto expected = value.load(::std::memory_order_relaxed);
+        while (!value.compare_exchange_weak(expected, expected + 1, Order, ::std::memory_order_relaxed));
+        return expected;
+    }
+};
+
+/** One measured operation.
+**/
+struct Ordering {
+    char const* name;                     // Name, as given to '--operations'
+    double (*loop)(OrderingWord&, size_t); // Loop running it
+};
+
+/** Every measured operation, in the default order.
+**/
+static Ordering const orderings[] = {
+    {"load-relaxed",      ordering_loop<OrderingLoad<::std::memory_order_relaxed>>},
+    {"load-acquire",      ordering_loop<OrderingLoad<::std::memory_order_acquire>>},
+    {"load-seq_cst",      ordering_loop<OrderingLoad<::std::memory_order_seq_cst>>},
+    {"store-relaxed",     ordering_loop<OrderingStore<::std::memory_order_relaxed>>},
+    {"store-release",     ordering_loop<OrderingStore<::std::memory_order_release>>},
+    {"store-seq_cst",     ordering_loop<OrderingStore<::std::memory_order_seq_cst>>},
+    {"fence-acquire",     ordering_loop<OrderingFence<::std::memory_order_acquire>>},
+    {"fence-release",     ordering_loop<OrderingFence<::std::memory_order_release>>},
+    {"fence-acq_rel",     ordering_loop<OrderingFence<::std::memory_order_acq_rel>>},
+    {"fence-seq_cst",     ordering_loop<OrderingFence<::std::memory_order_seq_cst>>},
+    {"fetch_add-relaxed", ordering_loop<OrderingFetchAdd<::std::memory_order_relaxed>>},
+    {"fetch_add-acq_rel", ordering_loop<OrderingFetchAdd<::std::memory_order_acq_rel>>},
+    {"fetch_add-seq_cst", ordering_loop<OrderingFetchAdd<::std::memory_order_seq_cst>>},
+    {"cas-relaxed",       ordering_loop<OrderingCAS<::std::memory_order_relaxed>>},
+    {"cas-acq_rel",       ordering_loop<OrderingCAS<::std::memory_order_acq_rel>>},
+    {"cas-seq_cst",       ordering_loop<OrderingCAS<::std::memory_order_seq_cst>>},
+};
@@ -19,15 +19,37 @@
  * @section DESCRIPTION
  *
  * Trivial program that call a function in several threads.
+ * With 'bench' as first argument, measures instead the throughput, fairness
+ * and handoff latency of your 'Lock' and of a few classic locks; with
+ * 'counters', the cost of a few shared counter implementations over a sweep
+ * of thread counts; with 'structures', the throughput of lock-free stacks and
+ * queues under hazard pointer and epoch-based reclamation over such a sweep;
+ * with 'orderings', the cost of atomic operations under each memory ordering,
+ * uncontended and contended within a socket and across sockets.
 **/
 
 // External headers
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <sched.h>
+#include <string>
 #include <thread>
+#include <vector>
 
 // Internal headers
+#include "counters.hpp"
 #include "entrypoint.hpp"
+#include "lockfree.hpp"
+#include "locks.hpp"
+#include "orderings.hpp"
 #include "runner.hpp"
 
 // -------------------------------------------------------------------------- //
@@ -54,6 +76,723 @@ static void shared_check() {
     }
 }
 
+// -------------------------------------------------------------------------- //
+// Lock benchmark
+
+/** Benchmark parameters.
+**/
+struct BenchConfig {
+    size_t nbworkers;       // Number of threads
+    size_t iterations = 100000; // Maximum number of acquisitions per thread, the run stops once one thread reached it
+    size_t critical = 0;    // Length of the critical section, in spins
+    size_t noncritical = 0; // Length of the non-critical section, in spins
+};
+
+/** Spin for some time, without touching memory.
+ * @param spins Number of spins
+**/
+static void busy_work(size_t spins) {
+    for (size_t i = 0; i < spins; ++i)
+        asm volatile("" ::: "memory");
+}
+
+/** Measure one lock, and print its throughput, fairness and handoff latency.
+ * @param name   Name of the lock
+ * @param config Benchmark parameters
+ * @return Whether no inconsistency was detected
+**/
+template<class LockType> static bool bench(char const* name, BenchConfig const& config) {
+    using Clock = ::std::chrono::steady_clock;
+    constexpr auto nobody = SIZE_MAX;
+    struct {
+        uint64_t counter = 0;         // Shared counter, protected by the lock
+        size_t owner = nobody;        // Last thread to release the lock
+        Clock::time_point release;    // When that thread released the lock
+    } shared;
+    struct alignas(64) Local {
+        size_t acquisitions = 0;        // Acquisitions of this thread
+        ::std::vector<uint64_t> handoffs; // Delays (in ns) between the release by another thread and the acquisition by this one
+        Clock::time_point begin;        // When this thread started acquiring
+        Clock::time_point end;          // When this thread stopped acquiring
+    };
+    ::std::vector<Local> locals(config.nbworkers);
+    ::std::atomic<uint64_t> check{0};
+    ::std::atomic<size_t> ready{0};
+    ::std::atomic<bool> stop{false};
+    LockType lock;
+    ::std::vector<::std::thread> threads;
+    for (size_t id = 0; id < config.nbworkers; ++id) {
+        threads.emplace_back([&](size_t id) {
+            auto& local = locals[id];
+            local.handoffs.reserve(config.iterations);
+            ready.fetch_add(1, ::std::memory_order_acq_rel);
+            while (ready.load(::std::memory_order_acquire) < config.nbworkers)
+                ::std::this_thread::yield();
+            local.begin = Clock::now();
+            while (local.acquisitions < config.iterations && !stop.load(::std::memory_order_relaxed)) {
+                lock.lock();
+                auto now = Clock::now();
+                if (shared.owner != id && shared.owner != nobody)
+                    local.handoffs.push_back(::std::chrono::duration_cast<::std::chrono::nanoseconds>(now - shared.release).count());
+                busy_work(config.critical);
+                ++shared.counter;
+                check.fetch_add(1, ::std::memory_order_relaxed);
+                shared.owner = id;
+                shared.release = Clock::now();
+                lock.unlock();
+                ++local.acquisitions;
+                busy_work(config.noncritical);
+            }
+            local.end = Clock::now();
+            stop.store(true, ::std::memory_order_relaxed);
+        }, id);
+    }
+    for (auto&& thread: threads)
+        thread.join();
+    // Throughput
+    size_t total = 0;
+    size_t least = SIZE_MAX;
+    size_t most = 0;
+    double squares = 0;
+    ::std::vector<uint64_t> handoffs;
+    auto begin = locals.front().begin;
+    auto end = locals.front().end;
+    for (auto const& local: locals) {
+        begin = ::std::min(begin, local.begin);
+        end = ::std::max(end, local.end);
+        total += local.acquisitions;
+        least = ::std::min(least, local.acquisitions);
+        most = ::std::max(most, local.acquisitions);
+        squares += static_cast<double>(local.acquisitions) * local.acquisitions;
+        handoffs.insert(handoffs.end(), local.handoffs.begin(), local.handoffs.end());
+    }
+    auto seconds = ::std::chrono::duration<double>(end - begin).count();
+    ::std::cout << "⎧ " << name << ::std::endl;
+    ::std::cout << "⎪ Throughput:  " << total / seconds << " acquisitions/s (" << total << " in " << seconds * 1000 << " ms)" << ::std::endl;
+    // Fairness, as the acquisitions of each thread when the first one is done; Jain's index is 1 when they are all equal, 1/n when one thread got them all
+    auto jain = squares > 0 ? static_cast<double>(total) * total / (config.nbworkers * squares) : 1.;
+    ::std::cout << "⎪ Fairness:    Jain's index " << jain << ", min/max " << (most > 0 ? static_cast<double>(least) / most : 1.) << ::std::endl;
+    for (size_t id = 0; id < config.nbworkers; ++id) {
+        auto count = locals[id].acquisitions;
+        auto width = most > 0 ? count * 40 / most : 0;
+        ::std::cout << "⎪   thread " << id << ": " << ::std::string(width, '#') << ::std::string(40 - width, ' ') << " " << count << ::std::endl;
+    }
+    // Handoff latency
+    if (handoffs.empty()) {
+        ::std::cout << "⎪ Handoffs:    none (the lock never went from one thread to another)" << ::std::endl;
+    } else {
+        ::std::sort(handoffs.begin(), handoffs.end());
+        auto at = [&](double quantile) { return handoffs[static_cast<size_t>(quantile * (handoffs.size() - 1))]; };
+        ::std::cout << "⎪ Handoffs:    " << handoffs.size() << " (" << 100. * handoffs.size() / total << "% of the acquisitions), latency (ns) p50 " << at(.5) << ", p90 " << at(.9) << ", p99 " << at(.99) << ", max " << handoffs.back() << ::std::endl;
+    }
+    auto calls = check.load(::std::memory_order_relaxed);
+    auto consistent = shared.counter == calls;
+    ::std::cout << "⎩ " << (consistent ? "No inconsistency detected (" : "Inconsistency detected (") << shared.counter << (consistent ? " == " : " != ") << calls << ")" << ::std::endl;
+    return consistent;
+}
+
+/** Run the lock benchmark.
+ * @param argc      Arguments count, after 'bench'
+ * @param argv      Arguments values, after 'bench'
+ * @param nbworkers Default number of threads
+ * @return Program return code
+**/
+static int bench_main(int argc, char** argv, size_t nbworkers) {
+    BenchConfig config{nbworkers};
+    ::std::string locks = "playground,mutex,ticket,ttas,mcs";
+    for (int i = 0; i < argc; ++i) {
+        auto value = [&]() -> char const* {
+            if (i + 1 >= argc) {
+                ::std::cerr << "Missing value for '" << argv[i] << "'" << ::std::endl;
+                ::std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (::std::strcmp(argv[i], "--threads") == 0) {
+            config.nbworkers = ::std::strtoul(value(), nullptr, 10);
+        } else if (::std::strcmp(argv[i], "--iterations") == 0) {
+            config.iterations = ::std::strtoul(value(), nullptr, 10);
+        } else if (::std::strcmp(argv[i], "--critical") == 0) {
+            config.critical = ::std::strtoul(value(), nullptr, 10);
+        } else if (::std::strcmp(argv[i], "--noncritical") == 0) {
+            config.noncritical = ::std::strtoul(value(), nullptr, 10);
+        } else if (::std::strcmp(argv[i], "--locks") == 0) {
+            locks = value();
+        } else {
+            ::std::cerr << "Usage: " << "bench [--threads <n>] [--iterations <per thread>] [--critical <spins>] [--noncritical <spins>] [--locks <playground,mutex,ticket,ttas,mcs>]" << ::std::endl;
+            return 1;
+        }
+    }
+    if (config.nbworkers == 0 || config.iterations == 0) {
+        ::std::cerr << "Expected at least one thread and one iteration" << ::std::endl;
+        return 1;
+    }
+    ::std::cout << "⎧ #threads:       " << config.nbworkers << ::std::endl;
+    ::std::cout << "⎪ #iterations:    " << config.iterations << " per thread (the run stops once one thread is done)" << ::std::endl;
+    ::std::cout << "⎩ Sections (spins): critical " << config.critical << ", non-critical " << config.noncritical << ::std::endl;
+    auto consistent = true;
+    size_t pos = 0;
+    while (pos <= locks.size()) {
+        auto end = ::std::min(locks.find(',', pos), locks.size());
+        auto name = locks.substr(pos, end - pos);
+        pos = end + 1;
+        if (name == "playground") {
+            consistent &= bench<Lock>("playground (your 'Lock')", config);
+        } else if (name == "mutex") {
+            consistent &= bench<::std::mutex>("std::mutex", config);
+        } else if (name == "ticket") {
+            consistent &= bench<TicketLock>("ticket", config);
+        } else if (name == "ttas") {
+            consistent &= bench<TTASLock>("test-and-test-and-set", config);
+        } else if (name == "mcs") {
+            consistent &= bench<MCSLock>("MCS", config);
+        } else {
+            ::std::cerr << "Unknown lock '" << name << "'" << ::std::endl;
+            return 1;
+        }
+    }
+    return consistent ? 0 : 1;
+}
+
+// -------------------------------------------------------------------------- //
+// Counter benchmark
+
+/** Parse a comma-separated list of thread counts.
+ * @param list  List to parse
+ * @param sweep Thread counts, appended to
+ * @return Whether the list was valid, otherwise an error was printed
+**/
+static bool parse_sweep(char const* list, ::std::vector<size_t>& sweep) {
+    while (*list != '\0') {
+        char* next;
+        sweep.push_back(::std::strtoul(list, &next, 10));
+        list = *next == ',' ? next + 1 : next;
+        if (next == list && *list != '\0') {
+            ::std::cerr << "Invalid thread count list" << ::std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Fill the default sweep of thread counts: powers of two up to the hardware threads, and the hardware threads.
+ * @param nbworkers Number of hardware threads
+ * @param sweep     Thread counts, appended to
+**/
+static void default_sweep(size_t nbworkers, ::std::vector<size_t>& sweep) {
+    for (size_t n = 1; n < nbworkers; n *= 2)
+        sweep.push_back(n);
+    sweep.push_back(nbworkers);
+}
+
+/** Measure one counter with some number of threads.
+ * @param nbthreads  Number of threads
+ * @param increments Number of increments per thread
+ * @param reads      Read the counter every that many increments, 0 for never
+ * @param consistent Set to false if the final count is not the expected one
+ * @return Increments per second, over all the threads
+**/
+template<class Counter> static double measure_counter(size_t nbthreads, size_t increments, size_t reads, bool& consistent) {
+    using Clock = ::std::chrono::steady_clock;
+    struct alignas(64) Local {
+        Clock::time_point begin;
+        Clock::time_point end;
+        uint64_t seen = 0; // Sum of the values read, so that reading is not optimized out
+    };
+    Counter counter{nbthreads};
+    ::std::vector<Local> locals(nbthreads);
+    ::std::atomic<size_t> ready{0};
+    ::std::vector<::std::thread> threads;
+    for (size_t id = 0; id < nbthreads; ++id) {
+        threads.emplace_back([&](size_t id) {
+            auto& local = locals[id];
+            ready.fetch_add(1, ::std::memory_order_acq_rel);
+            while (ready.load(::std::memory_order_acquire) < nbthreads)
+                ::std::this_thread::yield();
+            local.begin = Clock::now();
+            for (size_t i = 1; i <= increments; ++i) {
+                counter.add(id);
+                if (reads > 0 && i % reads == 0)
+                    local.seen += counter.read();
+            }
+            local.end = Clock::now();
+        }, id);
+    }
+    for (auto&& thread: threads)
+        thread.join();
+    auto begin = locals.front().begin;
+    auto end = locals.front().end;
+    for (auto const& local: locals) {
+        begin = ::std::min(begin, local.begin);
+        end = ::std::max(end, local.end);
+    }
+    if (counter.read() != nbthreads * increments)
+        consistent = false;
+    return nbthreads * increments / ::std::chrono::duration<double>(end - begin).count();
+}
+
+/** Run the counter benchmark.
+ * @param argc      Arguments count, after 'counters'
+ * @param argv      Arguments values, after 'counters'
+ * @param nbworkers Largest number of threads of the default sweep
+ * @return Program return code
+**/
+static int counters_main(int argc, char** argv, size_t nbworkers) {
+    ::std::vector<size_t> sweep;
+    size_t increments = 1000000;
+    size_t reads = 0;
+    ::std::string counters = "shared,packed,thread,socket";
+    for (int i = 0; i < argc; ++i) {
+        auto value = [&]() -> char const* {
+            if (i + 1 >= argc) {
+                ::std::cerr << "Missing value for '" << argv[i] << "'" << ::std::endl;
+                ::std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (::std::strcmp(argv[i], "--threads") == 0) {
+            if (!parse_sweep(value(), sweep))
+                return 1;
+        } else if (::std::strcmp(argv[i], "--increments") == 0) {
+            increments = ::std::strtoul(value(), nullptr, 10);
+        } else if (::std::strcmp(argv[i], "--reads") == 0) {
+            reads = ::std::strtoul(value(), nullptr, 10);
+        } else if (::std::strcmp(argv[i], "--counters") == 0) {
+            counters = value();
+        } else {
+            ::std::cerr << "Usage: " << "counters [--threads <n>,<n>,...] [--increments <per thread>] [--reads <every n increments>] [--counters <shared,packed,thread,socket>]" << ::std::endl;
+            return 1;
+        }
+    }
+    if (sweep.empty())
+        default_sweep(nbworkers, sweep);
+    if (increments == 0 || ::std::find(sweep.begin(), sweep.end(), 0) != sweep.end()) {
+        ::std::cerr << "Expected at least one thread and one increment" << ::std::endl;
+        return 1;
+    }
+    ::std::cout << "⎧ #increments:    " << increments << " per thread" << ::std::endl;
+    ::std::cout << "⎩ Reads:          " << (reads > 0 ? "every " + ::std::to_string(reads) + " increments" : ::std::string{"none"}) << ::std::endl;
+    auto consistent = true;
+    size_t pos = 0;
+    while (pos <= counters.size()) {
+        auto end = ::std::min(counters.find(',', pos), counters.size());
+        auto name = counters.substr(pos, end - pos);
+        pos = end + 1;
+        double (*measure)(size_t, size_t, size_t, bool&);
+        char const* description;
+        if (name == "shared") {
+            measure = measure_counter<SharedCounter>;
+            description = "one atomic, one cache line";
+        } else if (name == "packed") {
+            measure = measure_counter<PackedCounter>;
+            description = "one per thread, packed, with false sharing";
+        } else if (name == "thread") {
+            measure = measure_counter<ThreadCounter>;
+            description = "one per thread, one cache line each";
+        } else if (name == "socket") {
+            measure = measure_counter<SocketCounter>;
+            description = "one atomic per socket, one cache line each";
+        } else {
+            ::std::cerr << "Unknown counter '" << name << "'" << ::std::endl;
+            return 1;
+        }
+        ::std::cout << "⎧ " << name << " (" << description << ")" << ::std::endl;
+        double single = 0;
+        for (size_t i = 0; i < sweep.size(); ++i) {
+            auto rate = measure(sweep[i], increments, reads, consistent);
+            if (i == 0)
+                single = rate / sweep[i];
+            ::std::cout << (i + 1 < sweep.size() ? "⎪ " : "⎩ ") << sweep[i] << " thread(s): " << rate << " increments/s, " << 1e9 * sweep[i] / rate << " ns per increment per thread (" << rate / (single * sweep[i]) << "x linear)" << ::std::endl;
+        }
+    }
+    if (!consistent)
+        ::std::cout << "** Inconsistency detected (a counter lost increments) **" << ::std::endl;
+    return consistent ? 0 : 1;
+}
+
+// -------------------------------------------------------------------------- //
+// Lock-free structure benchmark
+
+/** Result of one structure run.
+**/
+struct StructureRun {
+    double rate;  // Operations per second, over all the threads
+    double empty; // Fraction of the pops that found the structure empty
+    size_t peak;  // Largest number of removed nodes a thread waited to free
+};
+
+/** Measure one structure with some number of threads, each alternating a push and a pop.
+ * The values encode the thread that pushed them and the rank of the push, so that a queue can check the values of each thread come out in order.
+ * @param nbthreads  Number of threads
+ * @param operations Number of operations per thread
+ * @param prefill    Number of values pushed before the threads start
+ * @param consistent Set to false if a value was lost or duplicated or, for a queue, popped out of order
+ * @return Result of the run
+**/
+template<class Structure> static StructureRun measure_structure(size_t nbthreads, size_t operations, size_t prefill, bool& consistent) {
+    using Clock = ::std::chrono::steady_clock;
+    struct Order {
+        ::std::vector<uint64_t> last; // Last rank popped from each thread, the prefill being thread 'nbthreads'
+        bool ordered = true;
+        Order(size_t nbthreads): last(nbthreads + 1) {}
+        void see(uint64_t value) {
+            auto& rank = last[value >> 32];
+            if ((value & UINT32_MAX) <= rank)
+                ordered = false;
+            rank = value & UINT32_MAX;
+        }
+    };
+    struct alignas(64) Local {
+        Clock::time_point begin;
+        Clock::time_point end;
+        uint64_t pushed = 0; // Sum of the pushed values
+        uint64_t popped = 0; // Sum of the popped values
+        size_t pops = 0;     // Number of values popped
+        size_t empty = 0;    // Number of pops that found the structure empty
+        Order order;
+        Local(size_t nbthreads): order{nbthreads} {}
+    };
+    auto value = [&](size_t id, uint64_t rank) { return static_cast<uint64_t>(id) << 32 | rank; };
+    Structure structure{nbthreads};
+    uint64_t pushed = 0;
+    for (size_t i = 1; i <= prefill; ++i) {
+        structure.push(0, value(nbthreads, i));
+        pushed += value(nbthreads, i);
+    }
+    ::std::vector<Local> locals(nbthreads, Local{nbthreads});
+    ::std::atomic<size_t> ready{0};
+    ::std::vector<::std::thread> threads;
+    for (size_t id = 0; id < nbthreads; ++id) {
+        threads.emplace_back([&](size_t id) {
+            auto& local = locals[id];
+            ready.fetch_add(1, ::std::memory_order_acq_rel);
+            while (ready.load(::std::memory_order_acquire) < nbthreads)
+                ::std::this_thread::yield();
+            local.begin = Clock::now();
+            for (size_t i = 0; i < operations; ++i) {
+                if (i % 2 == 0) {
+                    local.pushed += value(id, i / 2 + 1);
+                    structure.push(id, value(id, i / 2 + 1));
+                } else {
+                    uint64_t popped;
+                    if (structure.pop(id, popped)) {
+                        local.popped += popped;
+                        ++local.pops;
+                        if (Structure::fifo)
+                            local.order.see(popped);
+                    } else {
+                        ++local.empty;
+                    }
+                }
+            }
+            local.end = Clock::now();
+        }, id);
+    }
+    for (auto&& thread: threads)
+        thread.join();
+    auto begin = locals.front().begin;
+    auto end = locals.front().end;
+    uint64_t popped = 0;
+    size_t pops = 0;
+    size_t empty = 0;
+    for (auto const& local: locals) {
+        begin = ::std::min(begin, local.begin);
+        end = ::std::max(end, local.end);
+        pushed += local.pushed;
+        popped += local.popped;
+        pops += local.pops;
+        empty += local.empty;
+        if (!local.order.ordered)
+            consistent = false;
+    }
+    // Drain what is left, which must be every pushed value that was not popped
+    Order order{nbthreads};
+    size_t left = 0;
+    for (uint64_t remaining; structure.pop(0, remaining); ++left) {
+        popped += remaining;
+        if (Structure::fifo)
+            order.see(remaining);
+    }
+    if (popped != pushed || pops + left != prefill + nbthreads * ((operations + 1) / 2) || !order.ordered)
+        consistent = false;
+    return StructureRun{
+        nbthreads * operations / ::std::chrono::duration<double>(end - begin).count(),
+        pops + empty > 0 ? static_cast<double>(empty) / (pops + empty) : 0.,
+        structure.peak()
+    };
+}
+
+/** Run the lock-free structure benchmark.
+ * @param argc      Arguments count, after 'structures'
+ * @param argv      Arguments values, after 'structures'
+ * @param nbworkers Largest number of threads of the default sweep
+ * @return Program return code
+**/
+static int structures_main(int argc, char** argv, size_t nbworkers) {
+    ::std::vector<size_t> sweep;
+    size_t operations = 1000000;
+    size_t prefill = 1000;
+    ::std::string structures = "stack-mutex,stack-hazard,stack-epoch,queue-mutex,queue-hazard,queue-epoch";
+    for (int i = 0; i < argc; ++i) {
+        auto value = [&]() -> char const* {
+            if (i + 1 >= argc) {
+                ::std::cerr << "Missing value for '" << argv[i] << "'" << ::std::endl;
+                ::std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (::std::strcmp(argv[i], "--threads") == 0) {
+            if (!parse_sweep(value(), sweep))
+                return 1;
+        } else if (::std::strcmp(argv[i], "--operations") == 0) {
+            operations = ::std::strtoul(value(), nullptr, 10);
+        } else if (::std::strcmp(argv[i], "--prefill") == 0) {
+            prefill = ::std::strtoul(value(), nullptr, 10);
+        } else if (::std::strcmp(argv[i], "--structures") == 0) {
+            structures = value();
+        } else {
+            ::std::cerr << "Usage: " << "structures [--threads <n>,<n>,...] [--operations <per thread>] [--prefill <values>] [--structures <stack-mutex,stack-hazard,stack-epoch,queue-mutex,queue-hazard,queue-epoch>]" << ::std::endl;
+            return 1;
+        }
+    }
+    if (sweep.empty())
+        default_sweep(nbworkers, sweep);
+    if (operations == 0 || ::std::find(sweep.begin(), sweep.end(), 0) != sweep.end()) {
+        ::std::cerr << "Expected at least one thread and one operation" << ::std::endl;
+        return 1;
+    }
+    if (operations / 2 >= UINT32_MAX || prefill >= UINT32_MAX) {
+        ::std::cerr << "Expected less than 2^32 pushes per thread" << ::std::endl;
+        return 1;
+    }
+    ::std::cout << "⎧ #operations:    " << operations << " per thread, alternating push and pop" << ::std::endl;
+    ::std::cout << "⎩ Prefill:        " << prefill << " values" << ::std::endl;
+    auto consistent = true;
+    size_t pos = 0;
+    while (pos <= structures.size()) {
+        auto end = ::std::min(structures.find(',', pos), structures.size());
+        auto name = structures.substr(pos, end - pos);
+        pos = end + 1;
+        StructureRun (*measure)(size_t, size_t, size_t, bool&);
+        char const* description;
+        if (name == "stack-mutex") {
+            measure = measure_structure<LockedStructure<false>>;
+            description = "std::deque behind a std::mutex";
+        } else if (name == "stack-hazard") {
+            measure = measure_structure<TreiberStack<HazardReclaim>>;
+            description = "Treiber, hazard pointers";
+        } else if (name == "stack-epoch") {
+            measure = measure_structure<TreiberStack<EpochReclaim>>;
+            description = "Treiber, epoch-based reclamation";
+        } else if (name == "queue-mutex") {
+            measure = measure_structure<LockedStructure<true>>;
+            description = "std::deque behind a std::mutex";
+        } else if (name == "queue-hazard") {
+            measure = measure_structure<MichaelScottQueue<HazardReclaim>>;
+            description = "Michael-Scott, hazard pointers";
+        } else if (name == "queue-epoch") {
+            measure = measure_structure<MichaelScottQueue<EpochReclaim>>;
+            description = "Michael-Scott, epoch-based reclamation";
+        } else {
+            ::std::cerr << "Unknown structure '" << name << "'" << ::std::endl;
+            return 1;
+        }
+        ::std::cout << "⎧ " << name << " (" << description << ")" << ::std::endl;
+        double single = 0;
+        for (size_t i = 0; i < sweep.size(); ++i) {
+            auto run = measure(sweep[i], operations, prefill, consistent);
+            if (i == 0)
+                single = run.rate / sweep[i];
+            ::std::cout << (i + 1 < sweep.size() ? "⎪ " : "⎩ ") << sweep[i] << " thread(s): " << run.rate << " operations/s, " << 1e9 * sweep[i] / run.rate << " ns per operation per thread (" << run.rate / (single * sweep[i]) << "x linear), " << 100. * run.empty << "% empty pops, at most " << run.peak << " nodes waiting to be freed per thread" << ::std::endl;
+        }
+    }
+    if (!consistent)
+        ::std::cout << "** Inconsistency detected (a structure lost, duplicated or reordered values) **" << ::std::endl;
+    return consistent ? 0 : 1;
+}
+
+// -------------------------------------------------------------------------- //
+// Memory ordering benchmark
+
+/** Threads of one placement of the memory ordering benchmark.
+**/
+struct OrderingPlacement {
+    char const* name;        // Name, as given to '--placements'
+    ::std::vector<int> cpus; // CPU each thread is pinned to, empty if the placement is not possible here
+    ::std::string where;     // Description of the CPUs, or why the placement is not possible here
+};
+
+/** Pick the CPUs of each placement, among those the process may run on.
+ * @param nbthreads Number of threads of the contended placements
+ * @return Uncontended, same socket and cross-socket placements
+**/
+static ::std::vector<OrderingPlacement> ordering_placements(size_t nbthreads) {
+    ::std::vector<::std::vector<int>> sockets; // CPUs of each socket
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof set, &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &set))
+                continue;
+            auto socket = static_cast<size_t>(cpu_socket(cpu));
+            if (socket >= sockets.size())
+                sockets.resize(socket + 1);
+            sockets[socket].push_back(cpu);
+        }
+    }
+    sockets.erase(::std::remove_if(sockets.begin(), sockets.end(), [](::std::vector<int> const& cpus) { return cpus.empty(); }), sockets.end());
+    ::std::sort(sockets.begin(), sockets.end(), [](::std::vector<int> const& a, ::std::vector<int> const& b) { return a.size() > b.size(); });
+    auto list = [](::std::vector<int> const& cpus) {
+        ::std::string res;
+        for (auto cpu: cpus)
+            res += (res.empty() ? "" : ",") + ::std::to_string(cpu);
+        return res;
+    };
+    ::std::vector<OrderingPlacement> res;
+    if (sockets.empty()) {
+        res.push_back(OrderingPlacement{"uncontended", {}, "skipped (unable to query the CPUs)"});
+    } else {
+        res.push_back(OrderingPlacement{"uncontended", {sockets[0][0]}, "1 thread, on CPU " + ::std::to_string(sockets[0][0])});
+    }
+    if (sockets.empty() || sockets[0].size() < nbthreads) {
+        res.push_back(OrderingPlacement{"socket", {}, "skipped (fewer than " + ::std::to_string(nbthreads) + " CPUs on one socket)"});
+    } else {
+        ::std::vector<int> cpus(sockets[0].begin(), sockets[0].begin() + nbthreads);
+        res.push_back(OrderingPlacement{"socket", cpus, ::std::to_string(nbthreads) + " threads, on CPUs " + list(cpus)});
+    }
+    if (sockets.size() < 2) {
+        res.push_back(OrderingPlacement{"cross", {}, "skipped (a single socket)"});
+    } else if (sockets[1].size() < nbthreads / 2) {
+        res.push_back(OrderingPlacement{"cross", {}, "skipped (fewer than " + ::std::to_string(nbthreads / 2) + " CPUs on the second socket)"});
+    } else { // Alternating between the two largest sockets
+        ::std::vector<int> cpus;
+        for (size_t i = 0; i < nbthreads; ++i)
+            cpus.push_back(sockets[i % 2][i / 2]);
+        res.push_back(OrderingPlacement{"cross", cpus, ::std::to_string(nbthreads) + " threads, on CPUs " + list(cpus) + ", alternating between two sockets"});
+    }
+    return res;
+}
+
+/** Measure one operation with one placement, every thread operating on the same word.
+ * @param ordering   Operation to measure
+ * @param cpus       CPU each thread is pinned to
+ * @param iterations Number of operations per thread
+ * @return Average time per operation per thread, in ns
+**/
+static double measure_ordering(Ordering const& ordering, ::std::vector<int> const& cpus, size_t iterations) {
+    OrderingWord word;
+    ::std::vector<double> seconds(cpus.size());
+    ::std::atomic<size_t> ready{0};
+    ::std::vector<::std::thread> threads;
+    for (size_t id = 0; id < cpus.size(); ++id) {
+        threads.emplace_back([&](size_t id) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[id], &set);
+            ::sched_setaffinity(0, sizeof set, &set); // The CPU is one the process may run on
+            ready.fetch_add(1, ::std::memory_order_acq_rel);
+            while (ready.load(::std::memory_order_acquire) < cpus.size())
+                ::std::this_thread::yield();
+            seconds[id] = ordering.loop(word, iterations);
+        }, id);
+    }
+    for (auto&& thread: threads)
+        thread.join();
+    double total = 0;
+    for (auto duration: seconds)
+        total += duration;
+    return 1e9 * total / (cpus.size() * iterations);
+}
+
+/** Run the memory ordering benchmark.
+ * @param argc Arguments count, after 'orderings'
+ * @param argv Arguments values, after 'orderings'
+ * @return Program return code
+**/
+static int orderings_main(int argc, char** argv) {
+    size_t nbthreads = 2;
+    size_t iterations = 1000000;
+    ::std::string operations;
+    ::std::string placements = "uncontended,socket,cross";
+    for (int i = 0; i < argc; ++i) {
+        auto value = [&]() -> char const* {
+            if (i + 1 >= argc) {
+                ::std::cerr << "Missing value for '" << argv[i] << "'" << ::std::endl;
+                ::std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (::std::strcmp(argv[i], "--threads") == 0) {
+            nbthreads = ::std::strtoul(value(), nullptr, 10);
+        } else if (::std::strcmp(argv[i], "--iterations") == 0) {
+            iterations = ::std::strtoul(value(), nullptr, 10);
+        } else if (::std::strcmp(argv[i], "--operations") == 0) {
+            operations = value();
+        } else if (::std::strcmp(argv[i], "--placements") == 0) {
+            placements = value();
+        } else {
+            ::std::cerr << "Usage: " << "orderings [--threads <contending>] [--iterations <per thread>] [--operations <load-relaxed,...,cas-seq_cst>] [--placements <uncontended,socket,cross>]" << ::std::endl;
+            return 1;
+        }
+    }
+    if (nbthreads < 2 || iterations == 0) {
+        ::std::cerr << "Expected at least two contending threads and one iteration" << ::std::endl;
+        return 1;
+    }
+    // Operations and placements to measure
+    ::std::vector<Ordering const*> measured;
+    if (operations.empty()) {
+        for (auto const& ordering: orderings)
+            measured.push_back(&ordering);
+    }
+    for (size_t pos = 0; !operations.empty() && pos <= operations.size();) {
+        auto end = ::std::min(operations.find(',', pos), operations.size());
+        auto name = operations.substr(pos, end - pos);
+        pos = end + 1;
+        auto found = ::std::find_if(::std::begin(orderings), ::std::end(orderings), [&](Ordering const& ordering) { return name == ordering.name; });
+        if (found == ::std::end(orderings)) {
+            ::std::cerr << "Unknown operation '" << name << "'" << ::std::endl;
+            return 1;
+        }
+        measured.push_back(found);
+    }
+    auto all = ordering_placements(nbthreads);
+    ::std::vector<OrderingPlacement> used;
+    for (size_t pos = 0; pos <= placements.size();) {
+        auto end = ::std::min(placements.find(',', pos), placements.size());
+        auto name = placements.substr(pos, end - pos);
+        pos = end + 1;
+        auto found = ::std::find_if(all.begin(), all.end(), [&](OrderingPlacement const& placement) { return name == placement.name; });
+        if (found == all.end()) {
+            ::std::cerr << "Unknown placement '" << name << "'" << ::std::endl;
+            return 1;
+        }
+        used.push_back(*found);
+    }
+    ::std::cout << "⎧ #iterations:    " << iterations << " per thread, every thread operating on the same word" << ::std::endl;
+    for (size_t i = 0; i < used.size(); ++i)
+        ::std::cout << (i + 1 < used.size() ? "⎪ " : "⎩ ") << ::std::left << ::std::setw(16) << (::std::string{used[i].name} + ":") << used[i].where << ::std::endl;
+    // Average time per operation per thread, one column per placement
+    ::std::cout << "⎧ " << ::std::left << ::std::setw(20) << "ns per operation";
+    for (auto const& placement: used)
+        ::std::cout << ::std::right << ::std::setw(12) << placement.name;
+    ::std::cout << ::std::endl;
+    for (size_t i = 0; i < measured.size(); ++i) {
+        ::std::cout << (i + 1 < measured.size() ? "⎪ " : "⎩ ") << ::std::left << ::std::setw(20) << measured[i]->name;
+        for (auto const& placement: used) {
+            ::std::cout << ::std::right << ::std::setw(12);
+            if (placement.cpus.empty()) {
+                ::std::cout << "-";
+            } else {
+                ::std::cout << ::std::fixed << ::std::setprecision(2) << measure_ordering(*measured[i], placement.cpus, iterations) << ::std::defaultfloat;
+            }
+            ::std::cout.flush();
+        }
+        ::std::cout << ::std::endl;
+    }
+    return 0;
+}
+
 // -------------------------------------------------------------------------- //
 // Lock + thread launches and management
 
@@ -62,7 +801,7 @@ static void shared_check() {
  * @param argv Arguments values
  * @return Program return code
 **/
-int main(int, char**) {
+int main(int argc, char** argv) {
     auto const nbworkers = []() {
         auto res = ::std::thread::hardware_concurrency();
         if (res == 0) {
@@ -71,6 +810,14 @@ int main(int, char**) {
         }
         return static_cast<size_t>(res);
     }();
+    if (argc > 1 && ::std::strcmp(argv[1], "bench") == 0)
+        return bench_main(argc - 2, argv + 2, nbworkers);
+    if (argc > 1 && ::std::strcmp(argv[1], "counters") == 0)
+        return counters_main(argc - 2, argv + 2, nbworkers);
+    if (argc > 1 && ::std::strcmp(argv[1], "structures") == 0)
+        return structures_main(argc - 2, argv + 2, nbworkers);
+    if (argc > 1 && ::std::strcmp(argv[1], "orderings") == 0)
+        return orderings_main(argc - 2, argv + 2);
     Lock lock;
     ::std::thread threads[nbworkers];
     for (size_t i = 0; i < nbworkers; ++i) {
@@ -21,11 +21,21 @@
  * Lock-based transaction manager implementation used as the reference.
 **/
 
-// Compile-time configuration
+// Compile-time configuration (the lock variant can also be set from the command line, see 'make variants')
 // #define USE_MM_PAUSE
 // #define USE_PTHREAD_LOCK
 // #define USE_TICKET_LOCK
+// #define USE_MCS_LOCK
+// #define USE_CLH_LOCK
+// #define USE_COHORT_LOCK
+// #define USE_DIST_RW_LOCK
+// #define USE_TTAS_LOCK
+// #define USE_FLAT_COMBINING
+// #define USE_ALLOC_CACHE
+// #define USE_RTM_ELISION
+#if !defined(USE_PTHREAD_LOCK) && !defined(USE_TICKET_LOCK) && !defined(USE_MCS_LOCK) && !defined(USE_CLH_LOCK) && !defined(USE_COHORT_LOCK) && !defined(USE_RW_LOCK) && !defined(USE_DIST_RW_LOCK) && !defined(USE_TTAS_LOCK)
 #define USE_RW_LOCK
+#endif
 
 // Requested features
 #define _GNU_SOURCE
@@ -40,14 +50,22 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
+#include <stdio.h>
 #if (defined(__i386__) || defined(__x86_64__)) && defined(USE_MM_PAUSE)
     #include <xmmintrin.h>
-#else
-    #include <sched.h>
+#endif
+#if defined(USE_RTM_ELISION) && !(defined(__i386__) || defined(__x86_64__))
+    #undef USE_RTM_ELISION
+#endif
+#ifdef USE_RTM_ELISION
+    #include <cpuid.h>
+    #include <immintrin.h>
 #endif
 
 // Internal headers
 #include <tm.h>
+#include <tm_ext.h>
 
 // -------------------------------------------------------------------------- //
 
@@ -145,6 +163,45 @@ static inline void pause() {
 #endif
 }
 
+// Bounds of the exponential backoff of the spinning locks (in calls to 'pause')
+#ifndef BACKOFF_MIN
+    #define BACKOFF_MIN 4
+#endif
+#ifndef BACKOFF_MAX
+    #define BACKOFF_MAX 256
+#endif
+
+// Backoff of the ticket lock per thread ahead in the queue (in calls to 'pause')
+#ifndef BACKOFF_TICKET
+    #define BACKOFF_TICKET 8
+#endif
+
+/** State of the jitter generator of the calling thread, 0 until first used.
+**/
+static _Thread_local unsigned long backoff_state;
+
+/** Pause for a random number of times between half and all of the given delay, so that waiters do not retry in lockstep.
+ * Without 'USE_MM_PAUSE', a single 'pause' already leaves the CPU to the other threads, and yielding more only delays the waiter.
+ * @param delay Maximum number of pauses
+**/
+static inline void backoff(unsigned long delay) {
+    if (delay == 0)
+        return;
+#if !((defined(__i386__) || defined(__x86_64__)) && defined(USE_MM_PAUSE))
+    pause();
+    return;
+#endif
+    unsigned long x = backoff_state;
+    if (unlikely(x == 0))
+        x = (unsigned long) (uintptr_t) &backoff_state | 1ul; // Distinct per thread
+    x ^= x << 13; // Xorshift
+    x ^= x >> 7;
+    x ^= x << 17;
+    backoff_state = x;
+    for (unsigned long i = delay - x % (delay / 2 + 1); i > 0; --i)
+        pause();
+}
+
 #if defined(USE_PTHREAD_LOCK)
 
 struct lock_t {
@@ -219,8 +276,17 @@ static void lock_cleanup(struct lock_t* lock as(unused)) {
 **/
 static bool lock_acquire(struct lock_t* lock) {
     unsigned long ticket = atomic_fetch_add_explicit(&(lock->take), 1ul, memory_order_relaxed);
-    while (atomic_load_explicit(&(lock->pass), memory_order_relaxed) != ticket)
-        pause();
+    while (true) {
+        unsigned long pass = atomic_load_explicit(&(lock->pass), memory_order_relaxed);
+        if (pass == ticket)
+            break;
+        unsigned long ahead = ticket - pass - 1;
+        if (ahead == 0) { // Next in line
+            pause();
+        } else { // Away from the lock line while the threads ahead run
+            backoff(ahead < BACKOFF_MAX / BACKOFF_TICKET ? ahead * BACKOFF_TICKET : BACKOFF_MAX);
+        }
+    }
     atomic_thread_fence(memory_order_acquire);
     return true;
 }
@@ -240,6 +306,321 @@ static void lock_release_shared(struct lock_t* lock) {
     lock_release(lock);
 }
 
+#elif defined(USE_MCS_LOCK)
+
+struct mcs_node {
+    _Alignas(64) struct mcs_node* _Atomic next; // Next waiter in the queue, if any
+    atomic_bool locked; // Whether the owner still waits for its predecessor
+};
+
+/** Queue node of the calling thread, a thread holding or waiting for at most one lock at a time.
+**/
+static _Thread_local struct mcs_node mcs_mine;
+
+struct lock_t {
+    struct mcs_node* _Atomic tail; // Last waiter in the queue, NULL if the lock is free
+};
+
+/** Initialize the given lock.
+ * @param lock Lock to initialize
+ * @return Whether the operation is a success
+**/
+static bool lock_init(struct lock_t* lock) {
+    atomic_init(&(lock->tail), NULL);
+    return true;
+}
+
+/** Clean the given lock up.
+ * @param lock Lock to clean up
+**/
+static void lock_cleanup(struct lock_t* lock as(unused)) {
+    return;
+}
+
+/** Wait and acquire the given lock, spinning on the node of the calling thread only.
+ * @param lock Lock to acquire
+ * @return Whether the operation is a success
+**/
+static bool lock_acquire(struct lock_t* lock) {
+    struct mcs_node* node = &mcs_mine;
+    atomic_store_explicit(&(node->next), NULL, memory_order_relaxed);
+    atomic_store_explicit(&(node->locked), true, memory_order_relaxed);
+    struct mcs_node* prev = atomic_exchange_explicit(&(lock->tail), node, memory_order_acq_rel);
+    if (prev) { // Wait for the predecessor to hand the lock over
+        atomic_store_explicit(&(prev->next), node, memory_order_release);
+        while (atomic_load_explicit(&(node->locked), memory_order_acquire))
+            pause();
+    }
+    return true;
+}
+
+/** Release the given lock, handing it over to the next waiter if any.
+ * @param lock Lock to release
+**/
+static void lock_release(struct lock_t* lock) {
+    struct mcs_node* node = &mcs_mine;
+    struct mcs_node* next = atomic_load_explicit(&(node->next), memory_order_acquire);
+    if (!next) {
+        struct mcs_node* expected = node;
+        if (atomic_compare_exchange_strong_explicit(&(lock->tail), &expected, NULL, memory_order_release, memory_order_relaxed))
+            return;
+        while (!(next = atomic_load_explicit(&(node->next), memory_order_acquire))) // Successor between its exchange and its link
+            pause();
+    }
+    atomic_store_explicit(&(next->locked), false, memory_order_release);
+}
+
+static bool lock_acquire_shared(struct lock_t* lock) {
+    return lock_acquire(lock);
+}
+
+static void lock_release_shared(struct lock_t* lock) {
+    lock_release(lock);
+}
+
+#elif defined(USE_CLH_LOCK)
+
+struct clh_node {
+    _Alignas(64) atomic_bool locked; // Whether the owner holds or waits for the lock
+};
+
+/** Queue node owned by the calling thread, the one of its predecessor once it released a lock.
+**/
+static _Thread_local struct clh_node* clh_mine;
+
+/** Node of the calling thread in the queue it holds or waits for, a thread holding or waiting for at most one lock at a time.
+**/
+static _Thread_local struct clh_node* clh_held;
+
+/** Key freeing the node owned by a thread when it exits.
+**/
+static pthread_key_t clh_key;
+static pthread_once_t clh_once = PTHREAD_ONCE_INIT;
+
+/** Create the key freeing the owned nodes.
+**/
+static void clh_key_create() {
+    pthread_key_create(&clh_key, free);
+}
+
+/** Allocate a released queue node.
+ * @return Node, NULL on failure
+**/
+static struct clh_node* clh_node_alloc() {
+    struct clh_node* node = aligned_alloc(_Alignof(struct clh_node), sizeof(struct clh_node));
+    if (unlikely(!node))
+        return NULL;
+    atomic_init(&(node->locked), false);
+    return node;
+}
+
+struct lock_t {
+    struct clh_node* _Atomic tail; // Node of the last thread to take or wait for the lock, released one if the lock is free
+};
+
+/** Initialize the given lock.
+ * @param lock Lock to initialize
+ * @return Whether the operation is a success
+**/
+static bool lock_init(struct lock_t* lock) {
+    struct clh_node* node = clh_node_alloc();
+    if (unlikely(!node))
+        return false;
+    atomic_init(&(lock->tail), node);
+    return true;
+}
+
+/** Clean the given lock up.
+ * @param lock Lock to clean up
+**/
+static void lock_cleanup(struct lock_t* lock) {
+    free(atomic_load_explicit(&(lock->tail), memory_order_relaxed));
+}
+
+/** Wait and acquire the given lock, spinning on the node of the predecessor only.
+ * @param lock Lock to acquire
+ * @return Whether the operation is a success
+**/
+static bool lock_acquire(struct lock_t* lock) {
+    struct clh_node* node = clh_mine;
+    if (unlikely(!node)) {
+        pthread_once(&clh_once, clh_key_create);
+        node = clh_node_alloc();
+        if (unlikely(!node))
+            return false;
+        pthread_setspecific(clh_key, node);
+    }
+    atomic_store_explicit(&(node->locked), true, memory_order_relaxed);
+    struct clh_node* prev = atomic_exchange_explicit(&(lock->tail), node, memory_order_acq_rel);
+    while (atomic_load_explicit(&(prev->locked), memory_order_acquire))
+        pause();
+    clh_held = node;
+    clh_mine = prev; // No other thread uses it past this point
+    pthread_setspecific(clh_key, prev);
+    return true;
+}
+
+/** Release the given lock, the node of the calling thread left for its successor.
+ * @param lock Lock to release
+**/
+static void lock_release(struct lock_t* lock as(unused)) {
+    atomic_store_explicit(&(clh_held->locked), false, memory_order_release);
+}
+
+static bool lock_acquire_shared(struct lock_t* lock) {
+    return lock_acquire(lock);
+}
+
+static void lock_release_shared(struct lock_t* lock) {
+    lock_release(lock);
+}
+
+#elif defined(USE_COHORT_LOCK)
+
+// Number of local locks, the threads running on a socket using the one of its index modulo this number
+#define COHORT_SOCKETS 8
+
+// Maximum number of consecutive handovers of the global lock inside a socket, before it goes to the other sockets
+#define COHORT_PASSES 64
+
+enum cohort_state {
+    cohort_wait,   // Waiting for the predecessor
+    cohort_global, // Handed the local lock along with the global one
+    cohort_local   // Handed the local lock only, to acquire the global one
+};
+
+struct cohort_node {
+    _Alignas(64) struct cohort_node* _Atomic next; // Next waiter on the same socket, if any
+    atomic_int state; // Hand-over state, see 'enum cohort_state'
+};
+
+struct cohort_local {
+    _Alignas(64) struct cohort_node* _Atomic tail; // Last waiter of the socket, NULL if the local lock is free
+    unsigned long passes; // Consecutive handovers of the global lock inside the socket, only accessed by the holder
+};
+
+/** Queue node of the calling thread, a thread holding or waiting for at most one lock at a time.
+**/
+static _Thread_local struct cohort_node cohort_mine;
+
+/** Local lock the calling thread holds.
+**/
+static _Thread_local struct cohort_local* cohort_held;
+
+/** CPU the calling thread last ran on, -1 if unknown, and its socket.
+**/
+static _Thread_local int cohort_cpu = -1;
+static _Thread_local unsigned int cohort_socket_id;
+
+/** Get the socket the calling thread runs on, looked up again only when it migrates to another CPU.
+ * @return Socket index, 0 if unknown
+**/
+static unsigned int cohort_socket() {
+    int cpu = sched_getcpu();
+    if (likely(cpu == cohort_cpu))
+        return cohort_socket_id;
+    cohort_cpu = cpu;
+    cohort_socket_id = 0;
+    if (unlikely(cpu < 0))
+        return 0;
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    FILE* file = fopen(path, "r");
+    if (file) {
+        if (fscanf(file, "%u", &cohort_socket_id) != 1)
+            cohort_socket_id = 0;
+        fclose(file);
+    }
+    return cohort_socket_id;
+}
+
+struct lock_t {
+    _Alignas(64) atomic_bool global; // Whether a socket holds the global lock
+    struct cohort_local locals[COHORT_SOCKETS]; // Local MCS lock of each socket
+};
+
+/** Initialize the given lock.
+ * @param lock Lock to initialize
+ * @return Whether the operation is a success
+**/
+static bool lock_init(struct lock_t* lock) {
+    atomic_init(&(lock->global), false);
+    for (size_t i = 0; i < COHORT_SOCKETS; ++i) {
+        atomic_init(&(lock->locals[i].tail), NULL);
+        lock->locals[i].passes = 0;
+    }
+    return true;
+}
+
+/** Clean the given lock up.
+ * @param lock Lock to clean up
+**/
+static void lock_cleanup(struct lock_t* lock as(unused)) {
+    return;
+}
+
+/** Wait and acquire the local lock of the current socket, then the global lock unless handed over with the local one.
+ * @param lock Lock to acquire
+ * @return Whether the operation is a success
+**/
+static bool lock_acquire(struct lock_t* lock) {
+    struct cohort_local* local = &(lock->locals[cohort_socket() % COHORT_SOCKETS]);
+    struct cohort_node* node = &cohort_mine;
+    atomic_store_explicit(&(node->next), NULL, memory_order_relaxed);
+    atomic_store_explicit(&(node->state), cohort_wait, memory_order_relaxed);
+    cohort_held = local;
+    struct cohort_node* prev = atomic_exchange_explicit(&(local->tail), node, memory_order_acq_rel);
+    if (prev) { // Wait for the predecessor on the node
+        atomic_store_explicit(&(prev->next), node, memory_order_release);
+        int state;
+        while ((state = atomic_load_explicit(&(node->state), memory_order_acquire)) == cohort_wait)
+            pause();
+        if (state == cohort_global)
+            return true;
+    }
+    unsigned long delay = BACKOFF_MIN;
+    bool expected = false;
+    while (unlikely(!atomic_compare_exchange_weak_explicit(&(lock->global), &expected, true, memory_order_acquire, memory_order_relaxed))) {
+        expected = false;
+        backoff(delay);
+        if (delay < BACKOFF_MAX)
+            delay <<= 1;
+    }
+    local->passes = 0;
+    return true;
+}
+
+/** Release the given lock, handing the global lock over to the next waiter of the socket up to the fairness bound.
+ * @param lock Lock to release
+**/
+static void lock_release(struct lock_t* lock) {
+    struct cohort_local* local = cohort_held;
+    struct cohort_node* node = &cohort_mine;
+    struct cohort_node* next = atomic_load_explicit(&(node->next), memory_order_acquire);
+    if (next && local->passes < COHORT_PASSES) {
+        ++local->passes;
+        atomic_store_explicit(&(next->state), cohort_global, memory_order_release);
+        return;
+    }
+    atomic_store_explicit(&(lock->global), false, memory_order_release);
+    if (!next) {
+        struct cohort_node* expected = node;
+        if (atomic_compare_exchange_strong_explicit(&(local->tail), &expected, NULL, memory_order_release, memory_order_relaxed))
+            return;
+        while (!(next = atomic_load_explicit(&(node->next), memory_order_acquire))) // Successor between its exchange and its link
+            pause();
+    }
+    atomic_store_explicit(&(next->state), cohort_local, memory_order_release);
+}
+
+static bool lock_acquire_shared(struct lock_t* lock) {
+    return lock_acquire(lock);
+}
+
+static void lock_release_shared(struct lock_t* lock) {
+    lock_release(lock);
+}
+
 #elif defined(USE_RW_LOCK)
 
 struct lock_t {
@@ -291,6 +672,94 @@ static void lock_release_shared(struct lock_t* lock) {
     pthread_rwlock_unlock(&lock->rwlock);
 }
 
+#elif defined(USE_DIST_RW_LOCK)
+
+// Number of reader indicators, the readers running on a CPU using the one of its index modulo this number
+#define DIST_RW_SLOTS 64
+
+struct dist_rw_slot {
+    _Alignas(64) atomic_ulong readers; // Readers holding the lock through this indicator
+};
+
+/** Indicator the calling thread holds the lock through, a thread holding at most one lock at a time.
+**/
+static _Thread_local struct dist_rw_slot* dist_rw_held;
+
+struct lock_t {
+    _Alignas(64) atomic_bool writer; // Whether a writer holds or waits for the lock
+    struct dist_rw_slot slots[DIST_RW_SLOTS]; // Reader indicators, drained by the writer
+};
+
+/** Initialize the given lock.
+ * @param lock Lock to initialize
+ * @return Whether the operation is a success
+**/
+static bool lock_init(struct lock_t* lock) {
+    atomic_init(&(lock->writer), false);
+    for (size_t i = 0; i < DIST_RW_SLOTS; ++i)
+        atomic_init(&(lock->slots[i].readers), 0ul);
+    return true;
+}
+
+/** Clean the given lock up.
+ * @param lock Lock to clean up
+**/
+static void lock_cleanup(struct lock_t* lock as(unused)) {
+    return;
+}
+
+/** Wait and acquire the given lock, then wait for every reader to leave.
+ * @param lock Lock to acquire
+ * @return Whether the operation is a success
+**/
+static bool lock_acquire(struct lock_t* lock) {
+    bool expected = false;
+    while (unlikely(!atomic_compare_exchange_weak_explicit(&(lock->writer), &expected, true, memory_order_seq_cst, memory_order_relaxed))) {
+        expected = false;
+        while (unlikely(atomic_load_explicit(&(lock->writer), memory_order_relaxed)))
+            pause();
+    }
+    for (size_t i = 0; i < DIST_RW_SLOTS; ++i) { // Readers that saw no writer
+        while (atomic_load_explicit(&(lock->slots[i].readers), memory_order_seq_cst) != 0)
+            pause();
+    }
+    atomic_thread_fence(memory_order_acquire);
+    return true;
+}
+
+/** Release the given lock.
+ * @param lock Lock to release
+**/
+static void lock_release(struct lock_t* lock) {
+    atomic_store_explicit(&(lock->writer), false, memory_order_release);
+}
+
+/** Wait and acquire the given lock in shared mode, touching the indicator of the current CPU only.
+ * @param lock Lock to acquire
+ * @return Whether the operation is a success
+**/
+static bool lock_acquire_shared(struct lock_t* lock) {
+    int cpu = sched_getcpu();
+    struct dist_rw_slot* slot = &(lock->slots[(cpu < 0 ? 0 : (size_t) cpu) % DIST_RW_SLOTS]);
+    while (true) {
+        atomic_fetch_add_explicit(&(slot->readers), 1ul, memory_order_seq_cst);
+        if (likely(!atomic_load_explicit(&(lock->writer), memory_order_seq_cst)))
+            break;
+        atomic_fetch_sub_explicit(&(slot->readers), 1ul, memory_order_relaxed); // Let the writer through
+        while (atomic_load_explicit(&(lock->writer), memory_order_relaxed))
+            pause();
+    }
+    dist_rw_held = slot; // The thread may have migrated since
+    return true;
+}
+
+/** Release the given lock in shared mode.
+ * @param lock Lock to release
+**/
+static void lock_release_shared(struct lock_t* lock as(unused)) {
+    atomic_fetch_sub_explicit(&(dist_rw_held->readers), 1ul, memory_order_release);
+}
+
 #else // Test-and-test-and-set
 
 struct lock_t {
@@ -318,9 +787,13 @@ static void lock_cleanup(struct lock_t* lock as(unused)) {
  * @return Whether the operation is a success
 **/
 static bool lock_acquire(struct lock_t* lock) {
+    unsigned long delay = BACKOFF_MIN;
     bool expected = false;
     while (unlikely(!atomic_compare_exchange_weak_explicit(&(lock->locked), &expected, true, memory_order_acquire, memory_order_relaxed))) {
         expected = false;
+        backoff(delay); // Lost the race, let the winner run before reading the lock line again
+        if (delay < BACKOFF_MAX)
+            delay <<= 1;
         while (unlikely(atomic_load_explicit(&(lock->locked), memory_order_relaxed)))
             pause();
     }
@@ -348,19 +821,270 @@ static void lock_release_shared(struct lock_t* lock) {
 
 static const tx_t read_only_tx  = UINTPTR_MAX - 10;
 static const tx_t read_write_tx = UINTPTR_MAX - 11;
+#ifdef USE_RTM_ELISION
+static const tx_t elided_tx     = UINTPTR_MAX - 12; // Running as a hardware transaction, without the global lock
+#endif
+
+#ifdef USE_FLAT_COMBINING
+
+// Number of publication slots, the threads sharing the one of their index modulo this number
+#define FC_SLOTS 64
+
+enum fc_state {
+    fc_free,    // No transaction published
+    fc_claimed, // Being filled by a thread
+    fc_pending, // Transaction published, to run by the combiner
+    fc_done     // Transaction committed by the combiner
+};
+
+struct fc_slot {
+    _Alignas(64) atomic_int state; // Publication state, see 'enum fc_state'
+    bool (*body)(shared_t, tx_t, void*); // Body of the published transaction
+    void* ctx; // Argument of the body
+};
+
+/** Index of the publication slot of the calling thread, plus one, 0 until first used.
+**/
+static _Thread_local unsigned int fc_index;
+
+/** Number of threads given a slot index so far.
+**/
+static atomic_uint fc_next;
+
+#endif
+
+/** Header at the start of every allocated segment.
+**/
+struct block {
+    struct link link; // Link in the chain of the allocated segments of the region
+#ifdef USE_ALLOC_CACHE
+    size_t bin;       // Size class of the block, 'ALLOC_CACHE_BINS' if allocated outside of the caches
+#endif
+};
+
+#ifdef USE_ALLOC_CACHE
+
+// Alignment of the cached blocks, the regions with a larger one allocating outside of the caches (in bytes)
+#define ALLOC_CACHE_ALIGN 64
+
+// Log2 of the smallest and of the largest cached blocks, the larger ones allocated outside of the caches
+#define ALLOC_CACHE_MIN_LOG2 6
+#define ALLOC_CACHE_MAX_LOG2 16
+#define ALLOC_CACHE_BINS     (ALLOC_CACHE_MAX_LOG2 - ALLOC_CACHE_MIN_LOG2 + 1)
+
+// Maximum number of free blocks kept per thread and size class, the others given back to the system
+#define ALLOC_CACHE_DEPTH 64
+
+/** Free blocks of a thread, by size class, chained through their first word.
+**/
+struct alloc_cache {
+    void*  heads[ALLOC_CACHE_BINS];  // First free block of each class
+    size_t counts[ALLOC_CACHE_BINS]; // Number of free blocks of each class
+};
+
+/** Cache of the calling thread, flushed when it exits.
+**/
+static _Thread_local struct alloc_cache alloc_cache;
+static _Thread_local bool alloc_cache_registered;
+
+/** Key flushing the cache of a thread when it exits.
+**/
+static pthread_key_t alloc_cache_key;
+static pthread_once_t alloc_cache_once = PTHREAD_ONCE_INIT;
+
+/** Give every free block of a cache back to the system.
+ * @param arg Cache to flush
+**/
+static void alloc_cache_flush(void* arg) {
+    struct alloc_cache* cache = (struct alloc_cache*) arg;
+    for (size_t bin = 0; bin < ALLOC_CACHE_BINS; ++bin) {
+        while (cache->heads[bin]) {
+            void* block = cache->heads[bin];
+            cache->heads[bin] = *(void**) block;
+            free(block);
+        }
+        cache->counts[bin] = 0;
+    }
+}
+
+/** Create the key flushing the caches.
+**/
+static void alloc_cache_key_create() {
+    pthread_key_create(&alloc_cache_key, alloc_cache_flush);
+}
+
+/** Allocate a block, from the cache of the calling thread if it has one of the size class.
+ * @param align Alignment of the block (in bytes)
+ * @param size  Size of the block (in bytes)
+ * @return Block, NULL on failure
+**/
+static struct block* block_alloc(size_t align, size_t size) {
+    size_t bin = 0;
+    while (bin < ALLOC_CACHE_BINS && ((size_t) 1 << (bin + ALLOC_CACHE_MIN_LOG2)) < size)
+        ++bin;
+    void* block;
+    if (unlikely(align > ALLOC_CACHE_ALIGN || bin == ALLOC_CACHE_BINS)) { // Not cacheable
+        if (unlikely(posix_memalign(&block, align, size) != 0))
+            return NULL;
+        ((struct block*) block)->bin = ALLOC_CACHE_BINS;
+        return (struct block*) block;
+    }
+    block = alloc_cache.heads[bin];
+    if (likely(block)) {
+        alloc_cache.heads[bin] = *(void**) block;
+        --alloc_cache.counts[bin];
+    } else if (unlikely(posix_memalign(&block, ALLOC_CACHE_ALIGN, (size_t) 1 << (bin + ALLOC_CACHE_MIN_LOG2)) != 0)) {
+        return NULL;
+    }
+    ((struct block*) block)->bin = bin;
+    return (struct block*) block;
+}
+
+/** Free a block, into the cache of the calling thread unless the size class already has enough.
+ * @param block Block to free
+**/
+static void block_free(struct block* block) {
+    size_t bin = block->bin;
+    if (bin == ALLOC_CACHE_BINS || alloc_cache.counts[bin] >= ALLOC_CACHE_DEPTH) {
+        free(block);
+        return;
+    }
+    if (unlikely(!alloc_cache_registered)) { // Flush the cache when the thread exits
+        pthread_once(&alloc_cache_once, alloc_cache_key_create);
+        pthread_setspecific(alloc_cache_key, &alloc_cache);
+        alloc_cache_registered = true;
+    }
+    *(void**) block = alloc_cache.heads[bin];
+    alloc_cache.heads[bin] = block;
+    ++alloc_cache.counts[bin];
+}
+
+#else
+
+/** Allocate a block.
+ * @param align Alignment of the block (in bytes)
+ * @param size  Size of the block (in bytes)
+ * @return Block, NULL on failure
+**/
+static struct block* block_alloc(size_t align, size_t size) {
+    void* block;
+    if (unlikely(posix_memalign(&block, align, size) != 0))
+        return NULL;
+    return (struct block*) block;
+}
+
+/** Free a block.
+ * @param block Block to free
+**/
+static void block_free(struct block* block) {
+    free(block);
+}
+
+#endif
 
 struct region {
     struct lock_t lock; // Global lock
+#ifdef USE_RTM_ELISION
+    _Alignas(64) atomic_ulong holders; // Transactions holding (or about to take) the global lock for real, read by the elided ones
+    bool elide;                        // Whether the processor runs hardware transactions
+#endif
+#ifdef USE_FLAT_COMBINING
+    _Alignas(64) atomic_bool combining; // Whether a thread is the combiner
+    struct fc_slot slots[FC_SLOTS];     // Publication slots
+#endif
     void* start;        // Start of the shared memory region
     struct link allocs; // Allocated shared memory regions
     size_t size;        // Size of the shared memory region (in bytes)
     size_t align;       // Claimed alignment of the shared memory region (in bytes)
     size_t align_alloc; // Actual alignment of the memory allocations (in bytes)
-    size_t delta_alloc; // Space to add at the beginning of the segment for the link chain (in bytes)
+    size_t delta_alloc; // Space to add at the beginning of the segment for its header (in bytes)
 };
 
+#ifdef USE_RTM_ELISION
+
+// Attempts of a transaction as a hardware transaction before it takes the global lock for real
+#ifndef ELISION_RETRIES
+    #define ELISION_RETRIES 3
+#endif
+
+// Code of the explicit abort of a hardware transaction finding the global lock taken
+#define ELISION_LOCKED 0xff
+
+/** Check whether the processor runs hardware transactions, unless 'TM_RTM=0'.
+ * @return Whether the global lock can be elided
+**/
+static bool elision_supported() {
+    char const* env = getenv("TM_RTM");
+    if (env && strcmp(env, "0") == 0)
+        return false;
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 7)
+        return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & bit_RTM) != 0;
+}
+
+/** Start the transaction as a hardware transaction reading the lock holders, so that anybody taking the global lock aborts it.
+ * Once this returns true, an abort (up to '_xend' in 'tm_end') resumes right after '_xbegin' with every store since undone,
+ * the stack of the caller included, so that 'tm_begin' returns again to its caller, which runs the transaction again.
+ * @param region Shared memory region
+ * @return Whether the transaction runs as a hardware transaction, otherwise it must take the global lock
+**/
+__attribute__((target("rtm"))) static bool elision_begin(struct region* region) {
+    for (int attempt = 0; attempt < ELISION_RETRIES; ++attempt) {
+        unsigned int status = _xbegin();
+        if (status == _XBEGIN_STARTED) {
+            if (likely(atomic_load_explicit(&(region->holders), memory_order_relaxed) == 0)) // Subscribe to the lock
+                return true;
+            _xabort(ELISION_LOCKED);
+        }
+        if ((status & _XABORT_EXPLICIT) && _XABORT_CODE(status) == ELISION_LOCKED) { // Let the holders leave rather than join them
+            while (atomic_load_explicit(&(region->holders), memory_order_relaxed) != 0)
+                pause();
+            continue;
+        }
+        if (!(status & _XABORT_RETRY)) // e.g. capacity or system call, would abort again
+            break;
+    }
+    return false;
+}
+
+/** Commit the hardware transaction started by 'elision_begin'.
+**/
+__attribute__((target("rtm"))) static void elision_end() {
+    _xend();
+}
+
+/** Take the global lock for real, after aborting the hardware transactions running and keeping new ones from starting.
+ * @param region Shared memory region
+ * @param is_ro  Whether to take the lock in shared mode
+ * @return Whether the operation is a success
+**/
+static bool elision_acquire(struct region* region, bool is_ro) {
+    atomic_fetch_add_explicit(&(region->holders), 1ul, memory_order_seq_cst);
+    if (likely(is_ro ? lock_acquire_shared(&(region->lock)) : lock_acquire(&(region->lock))))
+        return true;
+    atomic_fetch_sub_explicit(&(region->holders), 1ul, memory_order_release);
+    return false;
+}
+
+/** Release the global lock taken by 'elision_acquire'.
+ * @param region Shared memory region
+ * @param is_ro  Whether the lock was taken in shared mode
+**/
+static void elision_release(struct region* region, bool is_ro) {
+    if (is_ro) {
+        lock_release_shared(&(region->lock));
+    } else {
+        lock_release(&(region->lock));
+    }
+    atomic_fetch_sub_explicit(&(region->holders), 1ul, memory_order_release);
+}
+
+#endif
+
 shared_t tm_create(size_t size, size_t align) {
-    struct region* region = (struct region*) malloc(sizeof(struct region));
+    struct region* region = (struct region*) aligned_alloc(_Alignof(struct region), sizeof(struct region)); // Lock possibly on cache lines of its own
     if (unlikely(!region)) {
         return invalid_shared;
     }
@@ -376,10 +1100,19 @@ shared_t tm_create(size_t size, size_t align) {
     }
     memset(region->start, 0, size);
     link_reset(&(region->allocs));
+#ifdef USE_RTM_ELISION
+    atomic_init(&(region->holders), 0ul);
+    region->elide = elision_supported();
+#endif
+#ifdef USE_FLAT_COMBINING
+    atomic_init(&(region->combining), false);
+    for (size_t i = 0; i < FC_SLOTS; ++i)
+        atomic_init(&(region->slots[i].state), fc_free);
+#endif
     region->size        = size;
     region->align       = align;
     region->align_alloc = align_alloc;
-    region->delta_alloc = (sizeof(struct link) + align_alloc - 1) / align_alloc * align_alloc;
+    region->delta_alloc = (sizeof(struct block) + align_alloc - 1) / align_alloc * align_alloc;
     return region;
 }
 
@@ -391,11 +1124,11 @@ void tm_destroy(shared_t shared) {
         if (alloc == allocs)
             break;
         link_remove(alloc);
-        free(alloc);
+        block_free((struct block*) alloc);
     }
     free(region->start);
-    free(region);
     lock_cleanup(&(region->lock));
+    free(region);
 }
 
 void* tm_start(shared_t shared) {
@@ -411,6 +1144,15 @@ size_t tm_align(shared_t shared) {
 }
 
 tx_t tm_begin(shared_t shared, bool is_ro) {
+#ifdef USE_RTM_ELISION
+    if (((struct region*) shared)->elide) {
+        if (likely(elision_begin((struct region*) shared)))
+            return elided_tx;
+        if (unlikely(!elision_acquire((struct region*) shared, is_ro)))
+            return invalid_tx;
+        return is_ro ? read_only_tx : read_write_tx;
+    }
+#endif
     if (is_ro) {
         if (unlikely(!lock_acquire_shared(&(((struct region*) shared)->lock))))
             return invalid_tx;
@@ -423,6 +1165,16 @@ tx_t tm_begin(shared_t shared, bool is_ro) {
 }
 
 bool tm_end(shared_t shared, tx_t tx) {
+#ifdef USE_RTM_ELISION
+    if (tx == elided_tx) { // Either commits or resumes in 'tm_begin'
+        elision_end();
+        return true;
+    }
+    if (((struct region*) shared)->elide) {
+        elision_release((struct region*) shared, tx == read_only_tx);
+        return true;
+    }
+#endif
     if (tx == read_only_tx) {
         lock_release_shared(&(((struct region*) shared)->lock));
     } else {
@@ -441,11 +1193,20 @@ bool tm_write(shared_t shared as(unused), tx_t tx as(unused), void const* source
     return true;
 }
 
+/** [thread-safe] Whether the transaction may access the shared memory with plain loads and stores until it ends (see 'tm_inline.hpp').
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to query
+ * @return Always true, every transaction holding the global lock
+**/
+bool tm_direct(shared_t shared as(unused), tx_t tx as(unused)) {
+    return true;
+}
+
 alloc_t tm_alloc(shared_t shared, tx_t tx as(unused), size_t size, void** target) {
     size_t align_alloc = ((struct region*) shared)->align_alloc;
     size_t delta_alloc = ((struct region*) shared)->delta_alloc;
-    void* segment;
-    if (unlikely(posix_memalign(&segment, align_alloc, delta_alloc + size) != 0)) // Allocation failed
+    void* segment = block_alloc(align_alloc, delta_alloc + size);
+    if (unlikely(!segment)) // Allocation failed
         return nomem_alloc;
     link_insert((struct link*) segment, &(((struct region*) shared)->allocs));
     segment = (void*) ((uintptr_t) segment + delta_alloc);
@@ -458,6 +1219,69 @@ bool tm_free(shared_t shared, tx_t tx as(unused), void* segment) {
     size_t delta_alloc = ((struct region*) shared)->delta_alloc;
     segment = (void*) ((uintptr_t) segment - delta_alloc);
     link_remove((struct link*) segment);
-    free(segment);
+    block_free((struct block*) segment);
+    return true;
+}
+
+#ifdef USE_FLAT_COMBINING
+
+/** Run every published transaction, as the combiner holding the global lock.
+ * @param region Shared memory region
+**/
+static void fc_combine(struct region* region) {
+    unsigned int used = atomic_load_explicit(&fc_next, memory_order_relaxed); // Slots given to a thread so far
+    for (size_t i = 0; i < FC_SLOTS && i < used; ++i) {
+        struct fc_slot* slot = &(region->slots[i]);
+        if (atomic_load_explicit(&(slot->state), memory_order_acquire) != fc_pending)
+            continue;
+        while (unlikely(!slot->body(region, read_write_tx, slot->ctx))) // Only an allocation may fail, retry as 'tm_begin'/'tm_end' would
+            continue;
+        atomic_store_explicit(&(slot->state), fc_done, memory_order_release);
+    }
+}
+
+/** [thread-safe] Run a transaction until it commits: published in the slot of the calling thread, then run in a batch by whichever
+ * thread takes the global lock first to combine the published transactions.
+ * @param shared Shared memory region
+ * @param is_ro  Whether the transaction is read-only (unused, the combiner holding the lock exclusively)
+ * @param body   Body of the transaction, returning false as soon as one of its operations failed
+ * @param ctx    Argument passed to the body
+ * @return Whether the transaction committed
+**/
+bool tm_run(shared_t shared, bool is_ro as(unused), bool (*body)(shared_t, tx_t, void*), void* ctx) {
+    struct region* region = (struct region*) shared;
+    if (unlikely(fc_index == 0))
+        fc_index = atomic_fetch_add_explicit(&fc_next, 1, memory_order_relaxed) % FC_SLOTS + 1;
+    struct fc_slot* slot = &(region->slots[fc_index - 1]);
+    int expected = fc_free;
+    while (unlikely(!atomic_compare_exchange_weak_explicit(&(slot->state), &expected, fc_claimed, memory_order_acquire, memory_order_relaxed))) { // Slot shared with another thread
+        expected = fc_free;
+        pause();
+    }
+    slot->body = body;
+    slot->ctx  = ctx;
+    atomic_store_explicit(&(slot->state), fc_pending, memory_order_release);
+    while (atomic_load_explicit(&(slot->state), memory_order_acquire) != fc_done) {
+        if (!atomic_load_explicit(&(region->combining), memory_order_relaxed) && !atomic_exchange_explicit(&(region->combining), true, memory_order_acquire)) {
+#ifdef USE_RTM_ELISION
+            if (region->elide) { // Also aborts the elided transactions
+                if (likely(elision_acquire(region, false))) {
+                    fc_combine(region);
+                    elision_release(region, false);
+                }
+            } else
+#endif
+            if (likely(lock_acquire(&(region->lock)))) { // Also excludes the transactions run through 'tm_begin'
+                fc_combine(region);
+                lock_release(&(region->lock));
+            }
+            atomic_store_explicit(&(region->combining), false, memory_order_release);
+            continue;
+        }
+        pause();
+    }
+    atomic_store_explicit(&(slot->state), fc_free, memory_order_release);
     return true;
 }
+
+#endif
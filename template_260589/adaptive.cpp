@@ -0,0 +1,356 @@
+/**
+ * @file   adaptive.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Adaptive engine: runs the transactions with the optimistic 'tl2' engine,
+ * or with the 'pessimistic' one while the abort rate is too high. Each thread
+ * counts the outcomes of its transactions over fixed windows, and the thread
+ * ending a window may switch the region to the other engine. A switch only
+ * happens at a quiescent point: new transactions wait while the switching
+ * thread waits for the running ones to end.
+**/
+
+// External headers
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <sched.h>
+
+// Internal headers
+#include <tm_ext.hpp>
+#include "common.hpp"
+#include "engine.hpp"
+#include "region.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+namespace adaptive {
+
+// Modes, indices in 'state::engines'
+#define MODE_OPTIMISTIC  0
+#define MODE_PESSIMISTIC 1
+
+/** Number of transactions running in the region, spread per thread to avoid contention.
+**/
+struct alignas(CACHE_LINE) indicator {
+    atomic<uint64_t> running;
+};
+
+struct state {
+    atomic<int> mode;        // Engine running the transactions
+    atomic<bool> switching;  // Whether a thread waits for quiescence to switch engines
+    void* engines[2];        // State of each engine, 'region->engine' is the one of the current mode
+    struct indicator indicators[EPOCH_SLOTS];
+    alignas(CACHE_LINE) atomic<uint64_t> rate; // Abort rate of the last window, in per-mille
+    atomic<uint64_t> windows;  // Windows ended since the last switch
+    atomic<uint64_t> switches;
+    uint64_t left_rate; // Abort rate that made the region leave the optimistic engine, in per-mille
+    uint64_t holdoff;   // Windows to wait in the optimistic engine before leaving it again
+};
+
+/** Outcomes of the transactions of the current window of a thread.
+**/
+struct window {
+    struct region* region; // Region the window is about
+    uint64_t commits;
+    uint64_t aborts;
+};
+
+static thread_local struct window window = {NULL, 0, 0};
+
+//================================================================
+//Helper functions
+//================================================================
+
+/** Get the indicator of the calling thread.
+ * @param st Engine state
+ * @return Indicator to update around the transactions of the thread
+**/
+static struct indicator* indicator_of(struct state* st) {
+    return &st->indicators[thread_index()];
+}
+
+/** Switch the region to the other engine, once no transaction runs anymore.
+ * @param region Region to switch
+ * @param st     Engine state
+ * @param from   Mode the decision was taken in
+ * @param rate   Abort rate of the window that triggered the switch, in per-mille
+**/
+static void switch_mode(struct region* region, struct state* st, int from, uint64_t rate) {
+    bool expected = false;
+    if (!st->switching.compare_exchange_strong(expected, true, memory_order_seq_cst)){
+        //somebody else is switching
+        return;
+    }
+    if (st->mode.load(memory_order_relaxed) != from){
+        st->switching.store(false, memory_order_release);
+        return;
+    }
+    for (auto& indicator : st->indicators){
+        while (indicator.running.load(memory_order_seq_cst) != 0){
+            sched_yield();
+        }
+    }
+    int to;
+    if (from == MODE_OPTIMISTIC){
+        st->left_rate = rate;
+        to = MODE_PESSIMISTIC;
+    } else {
+        //the pessimistic engine did not help, stay away from it longer next time
+        if (rate >= st->left_rate){
+            st->holdoff = st->holdoff == 0 ? 1 : 2 * st->holdoff;
+            if (st->holdoff > TM_ADAPTIVE_PROBE){
+                st->holdoff = TM_ADAPTIVE_PROBE;
+            }
+        } else {
+            st->holdoff = 0;
+        }
+        to = MODE_OPTIMISTIC;
+    }
+    region->engine = st->engines[to];
+    st->windows.store(0, memory_order_relaxed);
+    st->switches.fetch_add(1, memory_order_relaxed);
+    st->mode.store(to, memory_order_release);
+    st->switching.store(false, memory_order_release);
+}
+
+/** Account for the outcome of a transaction that just ended, and end the window if full.
+ * @param region    Region the transaction ran on
+ * @param st        Engine state
+ * @param committed Whether the transaction committed
+**/
+static void account(struct region* region, struct state* st, bool committed) {
+    indicator_of(st)->running.fetch_sub(1, memory_order_release);
+    if (unlikely(window.region != region)){
+        window = {region, 0, 0};
+    }
+    if (committed){
+        ++window.commits;
+    } else {
+        ++window.aborts;
+    }
+    if (likely(window.commits + window.aborts < TM_ADAPTIVE_WINDOW)){
+        return;
+    }
+    uint64_t rate = 1000 * window.aborts / (window.commits + window.aborts);
+    window.commits = 0;
+    window.aborts = 0;
+    st->rate.store(rate, memory_order_relaxed);
+    uint64_t windows = st->windows.fetch_add(1, memory_order_relaxed) + 1;
+    int mode = st->mode.load(memory_order_acquire);
+    if (mode == MODE_OPTIMISTIC){
+        if (windows > st->holdoff && rate > (uint64_t) (1000 * TM_ADAPTIVE_UPPER)){
+            switch_mode(region, st, mode, rate);
+        }
+    } else if (rate >= st->left_rate || windows >= TM_ADAPTIVE_PROBE){
+        //no better than the optimistic engine, or time to try it again
+        switch_mode(region, st, mode, rate);
+    }
+}
+
+//================================================================
+// End of Helper functions
+//================================================================
+
+bool create(shared_t shared) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = new (std::nothrow) struct state();
+    if (unlikely(st == NULL)){
+        return false;
+    }
+    if (unlikely(!tl2::create(shared))){
+        delete st;
+        return false;
+    }
+    st->engines[MODE_OPTIMISTIC] = region->engine;
+    if (unlikely(!pessimistic::create(shared))){
+        region->engine = st->engines[MODE_OPTIMISTIC];
+        tl2::destroy(shared);
+        delete st;
+        return false;
+    }
+    st->engines[MODE_PESSIMISTIC] = region->engine;
+    for (auto& indicator : st->indicators){
+        indicator.running.store(0, memory_order_relaxed);
+    }
+    st->mode.store(MODE_OPTIMISTIC, memory_order_relaxed);
+    st->switching.store(false, memory_order_relaxed);
+    st->rate.store(0, memory_order_relaxed);
+    st->windows.store(0, memory_order_relaxed);
+    st->switches.store(0, memory_order_relaxed);
+    st->left_rate = 0;
+    st->holdoff = 0;
+    region->engine = st->engines[MODE_OPTIMISTIC];
+    region->adaptive = st;
+    return true;
+}
+
+void destroy(shared_t shared) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->adaptive;
+    region->engine = st->engines[MODE_OPTIMISTIC];
+    tl2::destroy(shared);
+    region->engine = st->engines[MODE_PESSIMISTIC];
+    pessimistic::destroy(shared);
+    delete st;
+}
+
+tx_t begin(shared_t shared, bool is_ro) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->adaptive;
+    struct indicator* indicator = indicator_of(st);
+    while (true){
+        //announce before checking, so that a switching thread either waits for us or is seen
+        indicator->running.fetch_add(1, memory_order_seq_cst);
+        if (likely(!st->switching.load(memory_order_seq_cst))){
+            break;
+        }
+        indicator->running.fetch_sub(1, memory_order_release);
+        while (st->switching.load(memory_order_acquire)){
+            sched_yield();
+        }
+    }
+    tx_t tx = st->mode.load(memory_order_acquire) == MODE_OPTIMISTIC ? tl2::begin(shared, is_ro) : pessimistic::begin(shared, is_ro);
+    if (unlikely(tx == invalid_tx)){
+        indicator->running.fetch_sub(1, memory_order_release);
+    }
+    return tx;
+}
+
+bool end(shared_t shared, tx_t tx) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->adaptive;
+    bool committed = st->mode.load(memory_order_relaxed) == MODE_OPTIMISTIC ? tl2::end(shared, tx) : pessimistic::end(shared, tx);
+    account(region, st, committed);
+    return committed;
+}
+
+bool read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->adaptive;
+    if (st->mode.load(memory_order_relaxed) == MODE_OPTIMISTIC ? tl2::read(shared, tx, source, size, target) : pessimistic::read(shared, tx, source, size, target)){
+        return true;
+    }
+    account(region, st, false);
+    return false;
+}
+
+bool read_for_update(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->adaptive;
+    if (st->mode.load(memory_order_relaxed) == MODE_OPTIMISTIC ? tl2::read(shared, tx, source, size, target) : pessimistic::read_for_update(shared, tx, source, size, target)){
+        return true;
+    }
+    account(region, st, false);
+    return false;
+}
+
+bool write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->adaptive;
+    if (st->mode.load(memory_order_relaxed) == MODE_OPTIMISTIC ? tl2::write(shared, tx, source, size, target) : pessimistic::write(shared, tx, source, size, target)){
+        return true;
+    }
+    account(region, st, false);
+    return false;
+}
+
+bool add(shared_t shared, tx_t tx, void* target, int64_t delta) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->adaptive;
+    if (st->mode.load(memory_order_relaxed) == MODE_OPTIMISTIC ? tl2::add(shared, tx, target, delta) : pessimistic::add(shared, tx, target, delta)){
+        return true;
+    }
+    account(region, st, false);
+    return false;
+}
+
+bool hint(shared_t shared, tx_t tx, void const* const* addresses, size_t count, uint64_t write_mask) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->adaptive;
+    if (st->mode.load(memory_order_relaxed) == MODE_OPTIMISTIC ? tl2::hint(shared, tx, addresses, count, write_mask) : pessimistic::hint(shared, tx, addresses, count, write_mask)){
+        return true;
+    }
+    account(region, st, false);
+    return false;
+}
+
+void release(shared_t shared, tx_t tx, void const* source, size_t size) noexcept {
+    struct state* st = (struct state*) ((struct region*) shared)->adaptive;
+    if (st->mode.load(memory_order_relaxed) == MODE_OPTIMISTIC){
+        tl2::release(shared, tx, source, size);
+    } else {
+        pessimistic::release(shared, tx, source, size);
+    }
+}
+
+Alloc alloc(shared_t shared, tx_t tx, size_t size, void** target) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->adaptive;
+    Alloc res = st->mode.load(memory_order_relaxed) == MODE_OPTIMISTIC ? tl2::alloc(shared, tx, size, target) : pessimistic::alloc(shared, tx, size, target);
+    if (res == Alloc::abort){
+        account(region, st, false);
+    }
+    return res;
+}
+
+bool dealloc(shared_t shared, tx_t tx, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->adaptive;
+    if (st->mode.load(memory_order_relaxed) == MODE_OPTIMISTIC ? tl2::dealloc(shared, tx, target) : pessimistic::dealloc(shared, tx, target)){
+        return true;
+    }
+    account(region, st, false);
+    return false;
+}
+
+/** Prepare the calling thread for both engines, either may run its transactions.
+ * @param shared Region the thread entered
+**/
+void thread_enter(shared_t shared) noexcept {
+    tl2::thread_enter(shared);
+    pessimistic::thread_enter(shared);
+}
+
+/** Release the state of the calling thread in both engines, and its window.
+ * @param shared Region the thread leaves
+**/
+void thread_leave(shared_t shared) noexcept {
+    tl2::thread_leave(shared);
+    pessimistic::thread_leave(shared);
+    window = {NULL, 0, 0};
+}
+
+/** Describe the current mode of an adaptive region.
+ * @param shared Region created by this engine
+ * @param mode   Description to fill
+**/
+void query(shared_t shared, struct tm_mode* mode) noexcept {
+    struct state* st = (struct state*) ((struct region*) shared)->adaptive;
+    mode->engine = st->mode.load(memory_order_acquire) == MODE_OPTIMISTIC ? "tl2" : "pessimistic";
+    mode->adaptive = true;
+    mode->abort_rate = st->rate.load(memory_order_relaxed) / 1000.;
+    mode->upper = TM_ADAPTIVE_UPPER;
+    mode->window = TM_ADAPTIVE_WINDOW;
+    mode->probe = TM_ADAPTIVE_PROBE;
+    mode->switches = st->switches.load(memory_order_relaxed);
+}
+
+/** Add the statistics of the optimistic engine of an adaptive region.
+ * @param shared Region created by this engine
+ * @param stats  Statistics to complete
+**/
+void stats(shared_t shared, struct tm_stats* stats) noexcept {
+    struct state* st = (struct state*) ((struct region*) shared)->adaptive;
+    tl2::stats(st->engines[MODE_OPTIMISTIC], stats);
+}
+
+}
@@ -0,0 +1,316 @@
+/**
+ * @file   common.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Common helper macros shared by the transaction manager source files.
+**/
+
+#pragma once
+
+// Compile-time configuration
+// #define USE_PESSIMISTIC
+// #define USE_CONFLICT_STATS
+// #define USE_MULTIVERSION
+// #define USE_CM_STATS
+// #define USE_RTM
+// #define USE_SIMD
+// #define USE_TRACE
+// #define USE_PROFILE
+// #define USE_HEATMAP
+// #define USE_NUMA
+// #define USE_NUMA_STATS
+// #define USE_NUMA_SHARDS
+// #define USE_RECLAIMER
+// #define USE_CLWB
+// #define USE_GROUP_COMMIT
+// #define USE_LINE_STRIPES
+// #define USE_ADMISSION
+// #define USE_METRICS
+// #define USE_OPACITY_LOG
+// #define USE_HOT_STRIPES
+// #define USE_EAGER_DOOM
+// #define USE_SNZI
+// #define USE_PACKS
+// #define USE_PREEMPT
+// #define USE_INTENT_LOCKS
+// #define USE_WATCHDOG
+// #define USE_RSEQ
+
+// Engine every region runs, called directly rather than through its entry points (namespace of the engine, e.g. 'norec'),
+// also set by 'make variants' ('TM_ENGINE' then only names it)
+// #define TM_STATIC_ENGINE tl2
+#ifdef TM_STATIC_ENGINE
+    #define TM_STRINGIFY(name) #name
+    #define TM_STRING(name) TM_STRINGIFY(name)
+    #undef TM_ENGINE
+    #define TM_ENGINE TM_STRING(TM_STATIC_ENGINE)
+#endif
+
+// Engine used when 'TM_ENGINE' is not set ('tl2', 'norec', 'pessimistic', 'adaptive', 'dstm' or 'ring'), also set by 'make ENGINE=...'
+#ifndef TM_ENGINE
+    #ifdef USE_PESSIMISTIC
+        #define TM_ENGINE "pessimistic"
+    #else
+        #define TM_ENGINE "tl2"
+    #endif
+#endif
+
+// Log2 of the number of stripes in the lock table when it is not sized for the live segments ('TM_STRIPES' overrides it at runtime)
+#ifndef TM_STRIPES_LOG2
+    #define TM_STRIPES_LOG2 20
+#endif
+
+// Stripes per word of the live segments the lock table is sized for, 0 to keep TM_STRIPES_LOG2
+#ifndef TM_STRIPES_PER_WORD
+    #define TM_STRIPES_PER_WORD 4
+#endif
+
+// Bounds of the log2 of the number of stripes of a lock table sized for the live segments
+#ifndef TM_STRIPES_MIN_LOG2
+    #define TM_STRIPES_MIN_LOG2 12
+#endif
+#ifndef TM_STRIPES_MAX_LOG2
+    #define TM_STRIPES_MAX_LOG2 24
+#endif
+
+// With USE_CONFLICT_STATS, conflicts over which stripes per word double if most were false, up to a bound
+#ifndef TM_STRIPES_WINDOW
+    #define TM_STRIPES_WINDOW 4096
+#endif
+#ifndef TM_STRIPES_PER_WORD_MAX
+    #define TM_STRIPES_PER_WORD_MAX 64
+#endif
+
+// Contention policy used when 'TM_CM' is not set ('none', 'backoff', 'karma', 'greedy', 'polite', 'shrink' or 'priority'),
+// also set by 'make CM=...'
+#ifndef TM_CM
+    #define TM_CM "none"
+#endif
+
+// Version clock of tl2: 1 is incremented by every commit, 4 lets a commit share the increment of a concurrent one,
+// 5 is only advanced by readers finding a newer version (commits use the clock plus one), also set by 'make CLOCK=...'
+#ifndef TM_CLOCK
+    #define TM_CLOCK 1
+#endif
+
+// Number of hardware attempts of a commit before taking the locks, with USE_RTM
+#ifndef TM_RTM_RETRIES
+    #define TM_RTM_RETRIES 3
+#endif
+
+// Number of pauses a tl2 commit spins on a taken stripe before asking the contention manager
+#ifndef TM_LOCK_SPINS
+    #define TM_LOCK_SPINS 64
+#endif
+
+// With USE_SNZI, leaves of the reader indicator of a pessimistic segment lock, each on a line of its own
+#ifndef TM_SNZI_LEAVES
+    #define TM_SNZI_LEAVES 4
+#endif
+
+// With USE_HOT_STRIPES, slots of the tl2 table of stripe heat (a power of 2), conflicts after which the heat of every slot halves,
+// heat from which a stripe is locked at encounter, and pauses a transaction waits on such a lock before aborting
+#ifndef TM_HOT_SLOTS
+    #define TM_HOT_SLOTS 4096
+#endif
+#ifndef TM_HOT_DECAY
+    #define TM_HOT_DECAY 1024
+#endif
+#ifndef TM_HOT_THRESHOLD
+    #define TM_HOT_THRESHOLD 8
+#endif
+#ifndef TM_HOT_SPINS
+    #define TM_HOT_SPINS 256
+#endif
+
+// With USE_EAGER_DOOM, fewest reads of a tl2 transaction that may write between two looks at the clock
+#ifndef TM_DOOM_PERIOD
+    #define TM_DOOM_PERIOD 64
+#endif
+
+// Read-only norec transactions of a thread that log their reads after one aborted for not logging them
+#ifndef TM_RO_LOGGED
+    #define TM_RO_LOGGED 16
+#endif
+
+// Commits the ring engine keeps the write filter of (a power of 2), and bits of each filter (a power of 2, at least 64)
+#ifndef TM_RING_SIZE
+    #define TM_RING_SIZE 1024
+#endif
+#ifndef TM_RING_FILTER_BITS
+    #define TM_RING_FILTER_BITS 2048
+#endif
+
+// Bytes ahead of a sequential tl2 read whose data and stripe lock are prefetched, 0 to never prefetch
+#ifndef TM_PREFETCH_DISTANCE
+    #define TM_PREFETCH_DISTANCE 256
+#endif
+
+// With USE_GROUP_COMMIT, number of pauses the leader of a tl2 commit group waits for more committers, when the previous group had several
+#ifndef TM_GROUP_WINDOW
+    #define TM_GROUP_WINDOW 32
+#endif
+
+// Bytes of buffered writes from which the write-back engines publish a commit with non-temporal stores, 0 to never
+// ('TM_STREAM' overrides it at runtime)
+#ifndef TM_STREAM_BYTES
+    #define TM_STREAM_BYTES 65536
+#endif
+
+// Maximum number of old values kept per stripe in multi-version mode
+#ifndef TM_VERSIONS_DEPTH
+    #define TM_VERSIONS_DEPTH 8
+#endif
+
+// Number of transactions per thread over which the adaptive engine measures the abort rate
+#ifndef TM_ADAPTIVE_WINDOW
+    #define TM_ADAPTIVE_WINDOW 1024
+#endif
+
+// Abort rate above which the adaptive engine leaves 'tl2' for 'pessimistic'
+#ifndef TM_ADAPTIVE_UPPER
+    #define TM_ADAPTIVE_UPPER 0.25
+#endif
+
+// Number of windows the adaptive engine spends in 'pessimistic' before trying 'tl2' again
+#ifndef TM_ADAPTIVE_PROBE
+    #define TM_ADAPTIVE_PROBE 64
+#endif
+
+// With USE_RECLAIMER, longest sleep of the service thread of a region between two reclamations, in microseconds
+#ifndef TM_RECLAIMER_PERIOD
+    #define TM_RECLAIMER_PERIOD 1000
+#endif
+
+// With USE_INTENT_LOCKS, log2 of the number of word locks of the pessimistic engine below the intents on the segments
+#ifndef TM_INTENT_STRIPES_LOG2
+    #define TM_INTENT_STRIPES_LOG2 16
+#endif
+
+// Pessimistic engine: largest number of words written by the previous attempt of a thread for its next one to buffer
+// its writes (redo) rather than logging the old content (undo), 0 to always undo
+#ifndef TM_REDO_WRITES
+    #define TM_REDO_WRITES 64
+#endif
+
+// Pessimistic engine: aborts among the last 32 attempts of a thread from which its transactions with small write sets redo
+#ifndef TM_REDO_ABORTS
+    #define TM_REDO_ABORTS 4
+#endif
+
+// Pessimistic engine: bytes of the undo chunk each thread keeps between its transactions
+#ifndef TM_UNDO_CHUNK
+    #define TM_UNDO_CHUNK 65536
+#endif
+
+// Pessimistic engine: bytes of each chunk an undo log spills to past its first one, mapped and given back when the transaction ends
+#ifndef TM_UNDO_SPILL
+    #define TM_UNDO_SPILL (1 << 20)
+#endif
+
+// With USE_ADMISSION, abort ratio of the read-write transactions above which fewer of them are admitted at once
+#ifndef TM_ADMIT_ABORTS
+    #define TM_ADMIT_ABORTS 0.5
+#endif
+
+// With USE_ADMISSION, number of read-write transactions ended between two adjustments of the admission cap
+#ifndef TM_ADMIT_WINDOW
+    #define TM_ADMIT_WINDOW 1024
+#endif
+
+// With USE_METRICS, milliseconds between two writes of the file named by 'TM_METRICS'
+#ifndef TM_METRICS_PERIOD
+    #define TM_METRICS_PERIOD 1000
+#endif
+
+// Number of consecutive aborts after which a thread runs its transaction in the serial irrevocable mode, 0 to never
+#ifndef TM_IRREVOCABLE_RETRIES
+    #define TM_IRREVOCABLE_RETRIES 32
+#endif
+
+// Log2 of the bytes covered by one bit of the written ranges tracked for 'tm_checkpoint_delta', at least the log2 of the alignment
+#ifndef TM_DIRTY_LOG2
+    #define TM_DIRTY_LOG2 12
+#endif
+
+// Fewest segments 'tm_compact' moves at once, fewer are not worth stopping every transaction for
+#ifndef TM_COMPACT_MIN
+    #define TM_COMPACT_MIN 8
+#endif
+
+// With USE_PACKS, largest segment (in bytes, a power of 2) packed with segments of its size class on shared pages rather than given pages of its own
+#ifndef TM_PACK_MAX
+    #define TM_PACK_MAX 256
+#endif
+
+// With USE_PACKS, pages of one pack of small segments
+#ifndef TM_PACK_PAGES
+    #define TM_PACK_PAGES 16
+#endif
+
+// With USE_PREEMPT, timestamp ticks (cycles on x86, nanoseconds elsewhere) without progress after which the holder of a tl2 stripe is taken as descheduled
+#ifndef TM_PREEMPT_TICKS
+    #define TM_PREEMPT_TICKS 200000
+#endif
+
+// With USE_WATCHDOG, milliseconds between two looks of the watchdog of a region at its transactions
+#ifndef TM_WATCHDOG_PERIOD
+    #define TM_WATCHDOG_PERIOD 100
+#endif
+
+// With USE_WATCHDOG, milliseconds since its first attempt after which a transaction is reported
+#ifndef TM_WATCHDOG_THRESHOLD
+    #define TM_WATCHDOG_THRESHOLD 1000
+#endif
+
+// With USE_WATCHDOG, retries after which a transaction is reported, however long it has run
+#ifndef TM_WATCHDOG_RETRIES
+    #define TM_WATCHDOG_RETRIES 16
+#endif
+
+// Size of a cache line, metadata written by different threads is kept on different lines
+#define CACHE_LINE 64
+
+// -------------------------------------------------------------------------- //
+
+/** Define a proposition as likely true.
+ * @param prop Proposition
+**/
+#undef likely
+#ifdef __GNUC__
+    #define likely(prop) \
+        __builtin_expect((prop) ? 1 : 0, 1)
+#else
+    #define likely(prop) \
+        (prop)
+#endif
+
+/** Define a proposition as likely false.
+ * @param prop Proposition
+**/
+#undef unlikely
+#ifdef __GNUC__
+    #define unlikely(prop) \
+        __builtin_expect((prop) ? 1 : 0, 0)
+#else
+    #define unlikely(prop) \
+        (prop)
+#endif
+
+/** Define one or several attributes.
+ * @param type... Attribute names
+**/
+#undef as
+#ifdef __GNUC__
+    #define as(type...) \
+        __attribute__((type))
+#else
+    #define as(type...)
+    #warning This compiler has no support for GCC attributes
+#endif
@@ -0,0 +1,494 @@
+/**
+ * @file   contention.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Contention manager policies. The library cannot tell a retry from a new
+ * transaction, so the transaction begun by a thread right after an abort is
+ * considered as the retry of the aborted one.
+**/
+
+// External headers
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+
+// Internal headers
+#include "common.hpp"
+#include "contention.hpp"
+#include "watchdog.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Number of waits of 'polite' before aborting
+#define CM_POLITE_TRIES 8
+// Bound on the number of waits of 'karma' and 'greedy'
+#define CM_MAX_WAITS 64
+// Bound on the log2 of the backoff of 'backoff'
+#define CM_MAX_BACKOFF 16
+// Ends of admitted transactions a thread counts before adding them to the window of the region
+#define CM_ADMIT_BATCH 16
+
+/** State of the logical transaction a thread runs, kept across its retries.
+**/
+struct cm_context {
+    uint64_t timestamp; // Ticket of the first attempt
+    uint64_t karma;     // Work lost in the previous attempts
+    size_t aborts;      // Number of previous attempts
+    uint64_t seed;      // Random state for the backoff
+    size_t predicted[CM_PREDICTED]; // Tokens of the words the last aborted attempt was in conflict on, for 'shrink'
+    size_t nb_predicted;
+    size_t held[CM_PREDICTED];      // Tokens taken by the current attempt, in increasing order
+    size_t nb_held;
+    int klass;        // Class of the current attempt, one of 'TM_CLASS_*'
+    bool starving;    // Whether the transaction is interactive and counted among the retrying ones
+    bool admitted;    // Whether the current attempt counts among the admitted ones, with USE_ADMISSION
+    uint32_t ended;   // Admitted attempts ended and not added to the window yet
+    uint32_t aborted; // Among them, the aborted ones
+};
+
+static thread_local struct cm_context context = {};
+
+/** [thread-safe] Wait for a number of pause units, yielding the processor for long waits.
+ * @param units Number of units
+**/
+void cm_pause(size_t units) noexcept {
+    if (units > 64){
+        sched_yield();
+        return;
+    }
+    for (size_t i = 0; i < units; ++i){
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        atomic_signal_fence(memory_order_seq_cst);
+#endif
+    }
+}
+
+/** Get the name of a policy.
+ * @param policy Policy
+ * @return Name, as accepted by 'TM_CM'
+**/
+char const* cm_name(cm_policy policy) noexcept {
+    switch (policy){
+        case cm_policy::none:    return "none";
+        case cm_policy::backoff: return "backoff";
+        case cm_policy::karma:   return "karma";
+        case cm_policy::greedy:  return "greedy";
+        case cm_policy::polite:  return "polite";
+        case cm_policy::shrink:  return "shrink";
+        case cm_policy::priority: return "priority";
+    }
+    return "unknown";
+}
+
+/** Initialize the contention manager of a region, with the policy named by 'TM_CM' (default the one of the build).
+ * @param cm Contention manager to initialize
+**/
+void cm_init(struct contention* cm) noexcept {
+    cm->policy = cm_policy::none;
+    char const* env = getenv("TM_CM");
+    for (int i = 0; i < CM_POLICIES; ++i){
+        if (strcmp(TM_CM, cm_name((cm_policy) i)) == 0){
+            cm->policy = (cm_policy) i;
+        }
+    }
+    if (env != NULL){
+        for (int i = 0; i < CM_POLICIES; ++i){
+            if (strcmp(env, cm_name((cm_policy) i)) == 0){
+                cm->policy = (cm_policy) i;
+            }
+        }
+    }
+    cm->ticket.store(0, memory_order_relaxed);
+    cm->priority.store(0, memory_order_relaxed);
+    for (auto& count : cm->retried){
+        count.store(0, memory_order_relaxed);
+    }
+    cm->max_retries.store(0, memory_order_relaxed);
+    cm->stats.commits.store(0, memory_order_relaxed);
+    cm->stats.aborts.store(0, memory_order_relaxed);
+    cm->stats.waits.store(0, memory_order_relaxed);
+    cm->stats.give_up.store(0, memory_order_relaxed);
+    cm->stats.queued.store(0, memory_order_relaxed);
+    for (auto& token : cm->tokens){
+        token.store(0, memory_order_relaxed);
+    }
+    cm->admit_cap.store(0, memory_order_relaxed);
+    cm->admitted.store(0, memory_order_relaxed);
+    cm->outcomes.store(0, memory_order_relaxed);
+    cm->batch.store(false, memory_order_relaxed);
+    cm->starving.store(0, memory_order_relaxed);
+    cm->batch_commits.store(0, memory_order_relaxed);
+    cm->batch_aborts.store(0, memory_order_relaxed);
+}
+
+/** Report the counters of a region on the standard error, if enabled.
+ * @param cm Contention manager to report
+**/
+void cm_report(struct contention* cm as(unused)) noexcept {
+#ifdef USE_CM_STATS
+    uint64_t commits = cm->stats.commits.load(memory_order_relaxed);
+    uint64_t aborts = cm->stats.aborts.load(memory_order_relaxed);
+    fprintf(stderr, "cm: %s, %lu commits, %lu aborts (%.2f%%), %lu waits, %lu conflicts given up, %lu retries queued\n", cm_name(cm->policy), commits, aborts, commits + aborts > 0 ? 100. * aborts / (commits + aborts) : 0., cm->stats.waits.load(memory_order_relaxed), cm->stats.give_up.load(memory_order_relaxed), cm->stats.queued.load(memory_order_relaxed));
+    if (cm->batch.load(memory_order_relaxed)){
+        uint64_t batch_commits = cm->batch_commits.load(memory_order_relaxed);
+        uint64_t batch_aborts = cm->batch_aborts.load(memory_order_relaxed);
+        fprintf(stderr, "cm: interactive %lu commits, %lu aborts; batch %lu commits, %lu aborts\n", commits - batch_commits, aborts - batch_aborts, batch_commits, batch_aborts);
+    }
+#endif
+}
+
+/** Take the tokens of the words predicted to conflict, waiting for the retries holding them.
+ * Tokens are taken in increasing order and only by threads holding nothing else, so the holders never wait for this one.
+ * @param cm Contention manager of the region
+**/
+static void cm_schedule(struct contention* cm) {
+    size_t* tokens = context.predicted;
+    size_t count = context.nb_predicted;
+    for (size_t i = 1; i < count; ++i){
+        for (size_t j = i; j > 0 && tokens[j - 1] > tokens[j]; --j){
+            size_t tmp = tokens[j];
+            tokens[j] = tokens[j - 1];
+            tokens[j - 1] = tmp;
+        }
+    }
+    //any address of the thread tells the holders apart
+    uintptr_t self = (uintptr_t) &context;
+    bool queued = false;
+    for (size_t i = 0; i < count; ++i){
+        atomic<uintptr_t>& token = cm->tokens[tokens[i]];
+        uintptr_t expected = 0;
+        for (size_t attempt = 0; !token.compare_exchange_weak(expected, self, memory_order_acquire, memory_order_relaxed); ++attempt){
+            expected = 0;
+            queued = true;
+            cm_pause(static_cast<size_t>(1) << (attempt < 7 ? attempt : 7));
+        }
+        context.held[context.nb_held++] = tokens[i];
+    }
+#ifdef USE_CM_STATS
+    if (queued){
+        cm->stats.queued.fetch_add(1, memory_order_relaxed);
+    }
+#else
+    (void) queued;
+#endif
+    context.nb_predicted = 0;
+}
+
+/** Give back the tokens taken by the attempt that just ended.
+ * @param cm Contention manager of the region
+**/
+static inline void cm_unschedule(struct contention* cm) {
+    for (size_t i = 0; i < context.nb_held; ++i){
+        cm->tokens[context.held[i]].store(0, memory_order_release);
+    }
+    context.nb_held = 0;
+}
+
+/** [thread-safe] Note a word an aborting attempt wrote or conflicted on, so that its retry is scheduled after the others using it.
+ * Only used by the 'shrink' policy, and only the first CM_PREDICTED tokens are kept.
+ * @param cm       Contention manager of the region
+ * @param location Word, or any other address standing for what the attempt conflicted on
+**/
+void cm_predict(struct contention* cm, void const* location) noexcept {
+    WATCHDOG_CONFLICT(location);
+    if (cm->policy != cm_policy::shrink || context.nb_predicted == CM_PREDICTED){
+        return;
+    }
+    //multiplicative hash, neighbouring words get unrelated tokens
+    size_t token = ((((uintptr_t) location) >> 3) * UINT64_C(0x9e3779b97f4a7c15)) >> (64 - __builtin_ctz(CM_TOKENS));
+    for (size_t i = 0; i < context.nb_predicted; ++i){
+        if (context.predicted[i] == token){
+            return;
+        }
+    }
+    context.predicted[context.nb_predicted++] = token;
+}
+
+/** [thread-safe] Notify the beginning of a transaction, waiting first if it retries an aborted one.
+ * @param cm Contention manager of the region
+**/
+void cm_begin(struct contention* cm) noexcept {
+    if (context.aborts == 0){
+        if (cm->policy == cm_policy::greedy || cm->policy == cm_policy::priority){
+            //never 0, which stands for no priority
+            context.timestamp = cm->ticket.fetch_add(1, memory_order_relaxed) + 1;
+        }
+        return;
+    }
+    if (cm->policy == cm_policy::priority && context.aborts >= CM_PRIORITY_RETRIES){
+        //the oldest starving transaction gets it
+        uint64_t holder = cm->priority.load(memory_order_relaxed);
+        while ((holder == 0 || context.timestamp < holder) && !cm->priority.compare_exchange_weak(holder, context.timestamp, memory_order_seq_cst, memory_order_relaxed)){}
+        return;
+    }
+    if (cm->policy == cm_policy::backoff){
+        //xorshift, good enough to spread the retries
+        uint64_t x = context.seed == 0 ? (uintptr_t) &context : context.seed;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        context.seed = x;
+        size_t bound = static_cast<size_t>(1) << (context.aborts < CM_MAX_BACKOFF ? context.aborts : CM_MAX_BACKOFF);
+        cm_pause(x % bound);
+    } else if (cm->policy == cm_policy::shrink && context.nb_predicted > 0){
+        cm_schedule(cm);
+    }
+}
+
+/** [thread-safe] Admit a read-write transaction, waiting while the cap of the region is reached.
+ * Called before the engine begins it, so that a waiting thread holds nothing the admitted ones could wait for.
+ * @param cm Contention manager of the region
+**/
+void cm_admit(struct contention* cm) noexcept {
+    if (unlikely(context.admitted)){
+        return;
+    }
+    for (size_t attempt = 0;; ++attempt){
+        uint32_t cap = cm->admit_cap.load(memory_order_relaxed);
+        if (cap == 0){
+            cm->admitted.fetch_add(1, memory_order_relaxed);
+            break;
+        }
+        if (context.klass == TM_CLASS_BATCH){
+            //throttled first
+            cap = cap > 1 ? cap / 2 : 1;
+        }
+        uint32_t running = cm->admitted.load(memory_order_relaxed);
+        if (running < cap && cm->admitted.compare_exchange_weak(running, running + 1, memory_order_relaxed, memory_order_relaxed)){
+            break;
+        }
+        cm_pause(static_cast<size_t>(1) << (attempt < 7 ? attempt : 7));
+    }
+    context.admitted = true;
+}
+
+/** [thread-safe] Give back the place of an admitted transaction that could not begin.
+ * @param cm Contention manager of the region
+**/
+void cm_dismiss(struct contention* cm) noexcept {
+    if (context.admitted){
+        context.admitted = false;
+        cm->admitted.fetch_sub(1, memory_order_relaxed);
+    }
+}
+
+/** [thread-safe] Set the class of the next transaction the calling thread begins, interactive again once it ends.
+ * @param cm    Contention manager of the region
+ * @param klass One of 'TM_CLASS_*'
+**/
+void cm_classify(struct contention* cm, int klass) noexcept {
+    context.klass = klass;
+    if (klass == TM_CLASS_BATCH && unlikely(!cm->batch.load(memory_order_relaxed))){
+        cm->batch.store(true, memory_order_relaxed);
+    }
+}
+
+/** [thread-safe] Get the outcomes of the batch transactions of a region, the others being interactive.
+ * @param cm      Contention manager of the region
+ * @param commits Set to the commits of batch transactions
+ * @param aborts  Set to the aborts of batch transactions
+**/
+void cm_classes(struct contention* cm, uint64_t* commits, uint64_t* aborts) noexcept {
+    *commits = cm->batch_commits.load(memory_order_relaxed);
+    *aborts = cm->batch_aborts.load(memory_order_relaxed);
+}
+
+/** Count the end of a transaction in its class, and make the next one interactive.
+ * @param cm      Contention manager of the region
+ * @param aborted Whether the transaction aborted
+**/
+static inline void cm_class_end(struct contention* cm, bool aborted) {
+    if (unlikely(context.klass == TM_CLASS_BATCH)){
+        (aborted ? cm->batch_aborts : cm->batch_commits).fetch_add(1, memory_order_relaxed);
+        context.klass = TM_CLASS_INTERACTIVE;
+    } else if (aborted && !context.starving && unlikely(cm->batch.load(memory_order_relaxed))){
+        //only tracked once there is batch work to hold back
+        context.starving = true;
+        cm->starving.fetch_add(1, memory_order_relaxed);
+    }
+    if (!aborted && context.starving){
+        context.starving = false;
+        cm->starving.fetch_sub(1, memory_order_relaxed);
+    }
+}
+
+/** Give back the place of an admitted transaction that ended, adjusting the cap once a window of them ended.
+ * @param cm      Contention manager of the region
+ * @param aborted Whether the transaction aborted
+**/
+static inline void cm_admit_end(struct contention* cm, bool aborted) {
+    if (!context.admitted){
+        return;
+    }
+    context.admitted = false;
+    cm->admitted.fetch_sub(1, memory_order_relaxed);
+    ++context.ended;
+    context.aborted += aborted;
+    if (context.ended < CM_ADMIT_BATCH){
+        return;
+    }
+    //batched, so that most ends touch a single shared line
+    uint64_t batch = ((uint64_t) context.aborted << 32) | context.ended;
+    context.ended = 0;
+    context.aborted = 0;
+    uint64_t before = cm->outcomes.fetch_add(batch, memory_order_relaxed);
+    if ((uint32_t) before >= TM_ADMIT_WINDOW || (uint32_t) before + (uint32_t) batch < TM_ADMIT_WINDOW){
+        return;
+    }
+    //the batch that filled the window adjusts the cap, the later ones until the reset count in the window
+    uint64_t window = cm->outcomes.exchange(0, memory_order_relaxed);
+    uint32_t ends = (uint32_t) window;
+    uint32_t aborts = (uint32_t) (window >> 32);
+    uint32_t cap = cm->admit_cap.load(memory_order_relaxed);
+    if (aborts > TM_ADMIT_ABORTS * ends){
+        //halved, from the transactions running if there was no cap
+        uint32_t from = cap == 0 ? cm->admitted.load(memory_order_relaxed) + 1 : cap;
+        cap = from / 2 > 0 ? from / 2 : 1;
+    } else if (cap != 0){
+        cap = cap + 1 >= CM_ADMIT_MAX ? 0 : cap + 1;
+    }
+    cm->admit_cap.store(cap, memory_order_relaxed);
+}
+
+/** [thread-safe] Decide what to do about a lock found taken.
+ * @param cm      Contention manager of the region
+ * @param attempt Number of times the transaction already waited for this lock
+ * @return Whether to wait (this function did) and try again, otherwise abort
+**/
+bool cm_wait(struct contention* cm, size_t attempt) noexcept {
+    size_t tries;
+    if (unlikely(context.klass == TM_CLASS_BATCH)){
+        //the lock may be held by an interactive transaction, which the locks of this one could hold up
+        tries = 0;
+    } else switch (cm->policy){
+        case cm_policy::polite:
+            tries = CM_POLITE_TRIES;
+            break;
+        case cm_policy::karma:
+            tries = context.karma < CM_MAX_WAITS ? context.karma : CM_MAX_WAITS;
+            break;
+        case cm_policy::greedy: {
+            uint64_t age = cm->ticket.load(memory_order_relaxed) - context.timestamp;
+            tries = age < CM_MAX_WAITS ? age : CM_MAX_WAITS;
+            break;
+        }
+        case cm_policy::priority:
+            //wait-die: the others give up right away, so the holder waits for nobody waiting for it
+            tries = cm->priority.load(memory_order_relaxed) == context.timestamp ? CM_PRIORITY_WAITS : 0;
+            break;
+        default:
+            tries = 0;
+            break;
+    }
+    if (attempt >= tries){
+#ifdef USE_CM_STATS
+        cm->stats.give_up.fetch_add(1, memory_order_relaxed);
+#endif
+        return false;
+    }
+#ifdef USE_CM_STATS
+    if (attempt == 0){
+        cm->stats.waits.fetch_add(1, memory_order_relaxed);
+    }
+#endif
+    cm_pause(static_cast<size_t>(1) << (attempt < 7 ? attempt : 7));
+    return true;
+}
+
+/** [thread-safe] Hold back the commit of a writer while another transaction has the priority, or of a batch writer while
+ * interactive transactions retry, for a bounded time.
+ * Called before taking any commit lock, so that the transactions favored never wait for the caller.
+ * @param cm Contention manager of the region
+**/
+void cm_yield(struct contention* cm) noexcept {
+    if (unlikely(context.klass == TM_CLASS_BATCH)){
+        for (size_t attempt = 0; attempt < CM_PRIORITY_WAITS && cm->starving.load(memory_order_acquire) > 0; ++attempt){
+            cm_pause(static_cast<size_t>(1) << (attempt < 7 ? attempt : 7));
+        }
+    }
+    if (cm->policy != cm_policy::priority){
+        return;
+    }
+    for (size_t attempt = 0; attempt < CM_PRIORITY_WAITS; ++attempt){
+        uint64_t holder = cm->priority.load(memory_order_acquire);
+        if (holder == 0 || holder == context.timestamp){
+            return;
+        }
+        cm_pause(static_cast<size_t>(1) << (attempt < 7 ? attempt : 7));
+    }
+}
+
+/** [thread-safe] Get the retry counts of the transactions committed on a region.
+ * @param cm      Contention manager of the region
+ * @param buckets Set to the commits by retry count, CM_RETRY_BUCKETS of them, the first one (no retry) left to the caller
+ * @return Most retries of a committed transaction
+**/
+uint64_t cm_retried(struct contention* cm, uint64_t* buckets) noexcept {
+    for (size_t i = 1; i < CM_RETRY_BUCKETS; ++i){
+        buckets[i] = cm->retried[i].load(memory_order_relaxed);
+    }
+    return cm->max_retries.load(memory_order_relaxed);
+}
+
+/** [thread-safe] Get how many times the logical transaction of the calling thread aborted in a row.
+ * @return Number of previous attempts, 0 if the last transaction committed
+**/
+size_t cm_retries() noexcept {
+    return context.aborts;
+}
+
+/** [thread-safe] Notify the commit of a transaction.
+ * @param cm Contention manager of the region
+**/
+void cm_commit(struct contention* cm) noexcept {
+#ifdef USE_CM_STATS
+    cm->stats.commits.fetch_add(1, memory_order_relaxed);
+#endif
+    cm_unschedule(cm);
+#ifdef USE_ADMISSION
+    cm_admit_end(cm, false);
+#endif
+    cm_class_end(cm, false);
+    context.nb_predicted = 0;
+    if (unlikely(context.aborts > 0)){
+        //commits at the first attempt are left to the caller, so that they touch no shared line
+        size_t bucket = 64 - __builtin_clzl(context.aborts);
+        cm->retried[bucket < CM_RETRY_BUCKETS ? bucket : CM_RETRY_BUCKETS - 1].fetch_add(1, memory_order_relaxed);
+        uint64_t most = cm->max_retries.load(memory_order_relaxed);
+        while (most < context.aborts && !cm->max_retries.compare_exchange_weak(most, context.aborts, memory_order_relaxed)){}
+        if (cm->policy == cm_policy::priority){
+            uint64_t holder = context.timestamp;
+            cm->priority.compare_exchange_strong(holder, 0, memory_order_release, memory_order_relaxed);
+        }
+    }
+    context.aborts = 0;
+    context.karma = 0;
+}
+
+/** [thread-safe] Notify the abort of a transaction.
+ * @param cm   Contention manager of the region
+ * @param work Amount of work lost, e.g. number of accesses
+**/
+void cm_abort(struct contention* cm, size_t work) noexcept {
+#ifdef USE_CM_STATS
+    cm->stats.aborts.fetch_add(1, memory_order_relaxed);
+#endif
+    cm_unschedule(cm);
+#ifdef USE_ADMISSION
+    cm_admit_end(cm, true);
+#endif
+    cm_class_end(cm, true);
+    ++context.aborts;
+    context.karma += work;
+}
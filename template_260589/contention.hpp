@@ -0,0 +1,122 @@
+/**
+ * @file   contention.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Contention manager: decides whether a transaction finding a lock taken
+ * waits for it or aborts, and how long an aborted transaction waits before
+ * being retried. The policy is chosen per region with the 'TM_CM'
+ * environment variable.
+ *
+ * The 'shrink' policy also schedules retries: the engines report the words
+ * an aborted attempt wrote or conflicted on, and the retry first takes the
+ * tokens these words hash to, queueing behind the retry that holds them, so
+ * that transactions predicted to conflict run one after the other.
+ *
+ * The 'priority' policy is wait-die against the oldest starving transaction:
+ * once retried CM_PRIORITY_RETRIES times, a transaction competes for the
+ * priority of the region with its first-attempt timestamp. While it holds it,
+ * the others abort on a conflict instead of waiting, and writers hold their
+ * commit back, so that long transactions end in a bounded number of retries.
+ *
+ * With USE_ADMISSION, whatever the policy, read-write transactions are
+ * admitted at 'tm_begin' while fewer than a cap of them run. There is no cap
+ * until a window of them ends with an abort ratio above TM_ADMIT_ABORTS,
+ * then the cap halves after each such window and grows by one after the
+ * others (AIMD), so that an abort storm runs fewer writers at once instead
+ * of burning the processors on retries. Read-only transactions are never
+ * held back.
+ *
+ * Transactions begun with 'tm_begin_class' as batch work lose to the
+ * interactive ones: they abort rather than wait on a conflict, hold their
+ * commit back (for a bounded time) while interactive transactions retry,
+ * and are admitted under half the cap.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Internal headers
+#include "common.hpp"
+#include <tm_ext.hpp>
+
+// -------------------------------------------------------------------------- //
+
+enum class cm_policy {
+    none,    // Abort on the first conflict, retry right away
+    backoff, // Abort on the first conflict, randomized exponential backoff before the retry
+    karma,   // Wait as many times as the work lost in previous aborts, then abort
+    greedy,  // Wait longer the older the first attempt is, young transactions abort right away
+    polite,  // Wait with exponential pauses a few times, then abort
+    shrink,  // Like 'none', but a retry waits for the retries predicted to conflict with it
+    priority, // The oldest transaction retried a few times wins the conflicts, the others yield to it
+};
+
+#define CM_POLICIES 7
+
+// Retries after which a transaction competes for the priority, for 'priority'
+#define CM_PRIORITY_RETRIES 4
+// Bound on the waits of the transaction with the priority, and of the writers yielding to it
+#define CM_PRIORITY_WAITS 4096
+// Buckets of the retry counts of the commits: 0, 1, 2-3, 4-7, ... and the rest in the last one
+#define CM_RETRY_BUCKETS 8
+
+// Number of scheduling tokens of a region, a power of 2
+#define CM_TOKENS 1024
+// Words predicted to conflict kept per aborted attempt
+#define CM_PREDICTED 8
+// Cap on the admitted read-write transactions above which there is none, with USE_ADMISSION
+#define CM_ADMIT_MAX 1024
+
+/** Counters of one region, only maintained and reported at region destruction with USE_CM_STATS.
+**/
+struct cm_stats {
+    std::atomic<uint64_t> commits;
+    std::atomic<uint64_t> aborts;
+    std::atomic<uint64_t> waits;   // Conflicts for which the transaction waited
+    std::atomic<uint64_t> give_up; // Conflicts that ended up in an abort
+    std::atomic<uint64_t> queued;  // Retries that waited for a token, for 'shrink'
+};
+
+struct contention {
+    cm_policy policy;
+    alignas(CACHE_LINE) std::atomic<uint64_t> ticket; // Timestamps of first attempts, for 'greedy' and 'priority'
+    alignas(CACHE_LINE) std::atomic<uint64_t> priority; // Timestamp of the transaction with the priority, 0 if none, for 'priority'
+    alignas(CACHE_LINE) std::atomic<uint64_t> retried[CM_RETRY_BUCKETS]; // Commits by retry count, the first bucket unused
+    std::atomic<uint64_t> max_retries; // Most retries of a committed transaction
+    alignas(CACHE_LINE) struct cm_stats stats;
+    alignas(CACHE_LINE) std::atomic<uintptr_t> tokens[CM_TOKENS]; // Retry holding each token, 0 if none, for 'shrink'
+    alignas(CACHE_LINE) std::atomic<uint32_t> admit_cap; // Most read-write transactions running at once, 0 for no cap, with USE_ADMISSION
+    alignas(CACHE_LINE) std::atomic<uint32_t> admitted;  // Read-write transactions running
+    alignas(CACHE_LINE) std::atomic<uint64_t> outcomes;  // Of the current window: aborts in the high half, ends in the low one
+    alignas(CACHE_LINE) std::atomic<bool> batch;       // Whether a batch transaction began, interactive retries are only counted after
+    std::atomic<uint64_t> starving;                    // Interactive transactions retrying, the batch commits yield to them
+    alignas(CACHE_LINE) std::atomic<uint64_t> batch_commits; // Commits of batch transactions, the others are interactive
+    std::atomic<uint64_t> batch_aborts;                // Aborts of batch transactions
+};
+
+void cm_init(struct contention*) noexcept;
+void cm_report(struct contention*) noexcept;
+void cm_begin(struct contention*) noexcept;
+void cm_admit(struct contention*) noexcept;
+void cm_dismiss(struct contention*) noexcept;
+void cm_classify(struct contention*, int) noexcept;
+void cm_classes(struct contention*, uint64_t*, uint64_t*) noexcept;
+bool cm_wait(struct contention*, size_t) noexcept;
+void cm_commit(struct contention*) noexcept;
+void cm_abort(struct contention*, size_t) noexcept;
+void cm_predict(struct contention*, void const*) noexcept;
+void cm_yield(struct contention*) noexcept;
+uint64_t cm_retried(struct contention*, uint64_t*) noexcept;
+void cm_pause(size_t) noexcept;
+size_t cm_retries() noexcept;
+char const* cm_name(cm_policy) noexcept;
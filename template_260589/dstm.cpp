@@ -0,0 +1,678 @@
+/**
+ * @file   dstm.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * DSTM-style obstruction-free engine: a table of ownership records (one per
+ * stripe of words), each holding the version of the stripe and, while a
+ * transaction writes it, a pointer to the descriptor of that transaction.
+ * Ownership is taken with a CAS on the first write (encounter time), and the
+ * new values are buffered in the descriptor. The status of a descriptor
+ * (active, committed or aborted) is what the locator of DSTM holds: a
+ * transaction commits with one CAS of its own status, to committing, then
+ * takes a version, validates its reads, writes its values back and releases
+ * its stripes. Memory only changes in that write-back, so that a reader
+ * finding a stripe owned by an active transaction reads its value in place:
+ * the owner was not committing yet, so it takes a version past the snapshot
+ * of the reader, and serializes after it.
+ *
+ * A writer finding a stripe owned by an active transaction waits as the
+ * contention manager tells it (TM_LOCK_SPINS pauses, then 'cm_wait'), then
+ * aborts the owner with a CAS of the owner's status instead of waiting on:
+ * a preempted owner holds nobody up, and takes its stripes back from nobody
+ * either, as those of an aborted owner can be taken over. The only waits
+ * left are for the validation and write-back of a committing owner, a
+ * bounded amount of work that runs no code of the application; a committing
+ * transaction finding another committing aborts rather than wait for it.
+ *
+ * A record owned also holds the index of the write-set entry of the word its
+ * owner last wrote in the stripe, so that reading back a word written, or
+ * writing it again, finds the buffered value with one load rather than a
+ * probe of the write set (left for words sharing a stripe).
+ *
+ * Reads are invisible, checked against a global version clock snapshot and
+ * moved forward as in 'tl2', read-only transactions keep no read set and
+ * abort instead. Descriptors are recycled by their thread and
+ * never freed, parked for the next thread when theirs leaves, so that a
+ * pointer found in a record can always be followed; the status word holds a
+ * serial number of the transaction next to its status, so that an abort
+ * never hits a later transaction of the same descriptor. Durable regions are
+ * not supported, as an owner may be aborted after its writes were logged.
+**/
+
+// External headers
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <sched.h>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "engine.hpp"
+#include "heatmap.hpp"
+#include "profile.hpp"
+#include "region.hpp"
+#include "trace.hpp"
+#include "word.hpp"
+#include "writeset.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+namespace dstm {
+
+// Status of a transaction, in the low bits of the status word and set from active once and for all with a CAS
+#define DSTM_ACTIVE     0
+#define DSTM_COMMITTING 1 // Validating, can no longer be aborted by others
+#define DSTM_COMMITTED  2 // Writing back
+#define DSTM_ABORTED    3
+#define DSTM_STATUS     3
+
+struct transaction;
+
+/** Ownership record of a stripe, never across two lines.
+**/
+struct alignas(32) orec {
+    atomic<struct transaction*> owner; // Transaction writing the stripe, NULL if none
+    atomic<uint64_t> version;          // Version of the last committed write, only changed by its owner once written back
+    atomic<uint32_t> entry;            // Write-set entry of the word the owner last wrote, only meaningful to the owner
+};
+
+struct alignas(CACHE_LINE) state {
+    atomic<uint64_t> clock; // Global version clock
+    struct orec* orecs;
+    size_t mask;  // Stripes minus 1, a power of 2
+    size_t shift; // Log2 of the size of a word
+};
+
+struct read_entry {
+    byte const* location; // Read word in shared memory
+    struct orec* orec;    // Record of its stripe
+    uint64_t version;     // Version of the stripe the value was read at
+};
+
+/** Transaction descriptor, on lines of its own so that the descriptors of different threads never share one.
+**/
+struct alignas(CACHE_LINE) transaction {
+    atomic<uint64_t> status; // Serial number of the transaction shifted by 2, and one of 'DSTM_*', read by those finding a stripe of this one
+    alignas(CACHE_LINE) struct region* region;
+    size_t slot;  // Epoch table slot
+    uint64_t rv;  // Snapshot of the version clock the reads are consistent with
+    bool is_ro;
+    vector<struct read_entry> reads;
+    struct write_set writes;
+    vector<struct orec*> owned; // Records this transaction took, some may have been taken over since
+    vector<struct segment*> allocs;
+    vector<struct segment*> frees;
+};
+
+//================================================================
+//Helper functions
+//================================================================
+
+/** Get the record of the stripe of a word.
+ * @param st       Engine state
+ * @param location Address of the word
+ * @return Record of its stripe
+**/
+static inline struct orec* orec_of(struct state* st, void const* location) {
+    return &st->orecs[(((uintptr_t) location) >> st->shift) & st->mask];
+}
+
+/** Tell whether the calling transaction was aborted by another.
+ * @param trans Transaction
+ * @return Whether it can no longer commit
+**/
+static inline bool killed(struct transaction* trans) {
+    return (trans->status.load(memory_order_relaxed) & DSTM_STATUS) == DSTM_ABORTED;
+}
+
+/** Find the buffered value of a word in a stripe the transaction owns.
+ * @param trans    Transaction owning the stripe
+ * @param orec     Record of the stripe
+ * @param location Address of the word
+ * @return Buffered value, NULL if the word was not written
+**/
+static inline byte* buffered(struct transaction* trans, struct orec* orec, void const* location) {
+    size_t index = orec->entry.load(memory_order_relaxed);
+    auto& entries = trans->writes.entries;
+    if (likely(index < entries.size() && entries[index].location == location)){
+        return trans->writes.data.data() + entries[index].offset;
+    }
+    //another word of the stripe was written last, or none
+    return writeset_lookup(&trans->writes, location);
+}
+
+/** Buffer the new value of a word in a stripe the transaction owns.
+ * @param trans    Transaction owning the stripe
+ * @param orec     Record of the stripe
+ * @param location Address of the word
+ * @param source   New value (in private memory)
+ * @param align    Size of a word
+**/
+static inline void buffer(struct transaction* trans, struct orec* orec, byte* location, byte const* source, size_t align) {
+    byte* value = buffered(trans, orec, location);
+    if (value != NULL){
+        word_copy(value, source, align);
+        return;
+    }
+    orec->entry.store(trans->writes.entries.size(), memory_order_relaxed);
+    writeset_add(&trans->writes, location, source, align);
+}
+
+/** Wait for an active owner as the contention manager tells, then abort it.
+ * @param trans  Transaction finding the stripe owned
+ * @param orec   Record of the stripe
+ * @param owner  Owner of the stripe
+ * @param status Status word of the owner, active
+**/
+static void contend(struct transaction* trans, struct orec* orec, struct transaction* owner, uint64_t status) {
+    for (size_t attempt = 0; owner->status.load(memory_order_acquire) == status && orec->owner.load(memory_order_relaxed) == owner; ++attempt){
+        if (attempt < TM_LOCK_SPINS){
+            cm_pause(1);
+        } else if (!cm_wait(&trans->region->cm, attempt - TM_LOCK_SPINS)){
+            //whether running or preempted, the owner loses its stripes rather than holding this one up
+            owner->status.compare_exchange_strong(status, (status & ~(uint64_t) DSTM_STATUS) | DSTM_ABORTED, memory_order_acq_rel, memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+/** Wait for a committing owner to be done.
+ * @param attempt Number of times the transaction already waited
+**/
+static void settle(size_t attempt) {
+    if (attempt < TM_LOCK_SPINS){
+        cm_pause(1);
+    } else {
+        sched_yield();
+    }
+}
+
+/** Get the version of a stripe as of now.
+ * @param trans   Transaction asking
+ * @param orec    Record of the stripe
+ * @param version Version of the values the stripe holds for this transaction
+ * @return Whether the version is known, otherwise the transaction is committing and so is the owner of the stripe
+**/
+static bool version_of(struct transaction* trans, struct orec* orec, uint64_t* version) {
+    for (size_t attempt = 0;; ++attempt){
+        struct transaction* owner = orec->owner.load(memory_order_acquire);
+        uint64_t status = owner == NULL || owner == trans ? DSTM_ACTIVE : owner->status.load(memory_order_acquire);
+        if ((status & DSTM_STATUS) == DSTM_ACTIVE || (status & DSTM_STATUS) == DSTM_ABORTED){
+            //still in memory, an active owner commits after this transaction
+            *version = orec->version.load(memory_order_acquire);
+            return true;
+        }
+        if ((status & DSTM_STATUS) == DSTM_COMMITTING && (trans->status.load(memory_order_relaxed) & DSTM_STATUS) == DSTM_COMMITTING){
+            //both may be validating against each other
+            return false;
+        }
+        settle(attempt);
+    }
+}
+
+/** Check every stripe read by the transaction is still at the version read.
+ * @param trans Transaction to validate
+ * @return Whether the read set is still valid
+**/
+static bool validate(struct transaction* trans) {
+    PROFILE(PROFILE_LOCK);
+    for (auto const& read : trans->reads){
+        uint64_t version;
+        if (!version_of(trans, read.orec, &version) || version != read.version){
+            HEATMAP(trans->region, NULL, read.location, HEATMAP_NO_STRIPE);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Move the snapshot of the transaction to the current version clock.
+ * @param st    Engine state
+ * @param trans Transaction to extend
+ * @return Whether its read set is still valid at the new snapshot
+**/
+static bool extend(struct state* st, struct transaction* trans) {
+    uint64_t now = st->clock.load(memory_order_acquire);
+    if (!validate(trans)){
+        return false;
+    }
+    trans->rv = now;
+    counter_add(trans->region->counters[trans->slot].extensions, 1);
+    return true;
+}
+
+/** Take ownership of the stripe of a word.
+ * @param trans Transaction about to write the word
+ * @param orec  Record of its stripe
+ * @return Whether the transaction owns the stripe, otherwise it was aborted meanwhile
+**/
+static bool acquire(struct transaction* trans, struct orec* orec) {
+    for (size_t attempt = 0;; ++attempt){
+        struct transaction* owner = orec->owner.load(memory_order_acquire);
+        if (owner == trans){
+            return true;
+        }
+        if (killed(trans)){
+            return false;
+        }
+        if (owner != NULL){
+            uint64_t status = owner->status.load(memory_order_acquire);
+            if ((status & DSTM_STATUS) == DSTM_ACTIVE){
+                contend(trans, orec, owner, status);
+                continue;
+            }
+            if ((status & DSTM_STATUS) != DSTM_ABORTED){
+                //memory must hold its values before this one buffers on top of them
+                settle(attempt);
+                continue;
+            }
+        }
+        //free, or left behind by an aborted owner
+        if (orec->owner.compare_exchange_strong(owner, trans, memory_order_acq_rel, memory_order_relaxed)){
+            trans->owned.push_back(orec);
+            return true;
+        }
+    }
+}
+
+/** Descriptors no thread holds, never freed as other threads may still follow a pointer to one.
+**/
+static mutex parked_lock;
+static vector<struct transaction*> parked;
+
+/** Get a descriptor for the calling thread.
+ * @return Parked or new descriptor, NULL if out of memory
+**/
+static struct transaction* unpark(){
+    {
+        lock_guard<mutex> guard(parked_lock);
+        if (!parked.empty()){
+            struct transaction* trans = parked.back();
+            parked.pop_back();
+            return trans;
+        }
+    }
+    return new (std::nothrow) struct transaction();
+}
+
+/** Give up a descriptor, for another thread to take.
+ * @param trans Descriptor, with no stripe
+**/
+static void park(struct transaction* trans){
+    lock_guard<mutex> guard(parked_lock);
+    parked.push_back(trans);
+}
+
+/** Descriptor kept by each thread between its transactions, so that its vectors keep their capacity.
+**/
+struct keeper {
+    struct transaction* trans = NULL;
+    ~keeper(){
+        if (trans != NULL){
+            park(trans);
+        }
+    }
+};
+static thread_local struct keeper spare;
+
+/** Get the bytes a descriptor holds, the unused capacity of its vectors included.
+ * @param trans Transaction descriptor
+ * @return Size (in bytes)
+**/
+static size_t footprint(struct transaction const* trans){
+    return sizeof(*trans) + trans->reads.capacity() * sizeof(struct read_entry) + writeset_footprint(&trans->writes)
+        + (trans->owned.capacity() + trans->allocs.capacity() + trans->frees.capacity()) * sizeof(void*);
+}
+
+/** Release the epoch slot of the transaction and recycle its descriptor.
+ * @param trans Transaction to finish
+**/
+static void finish(struct transaction* trans){
+    trans->region->counters[trans->slot].descriptor.store(footprint(trans), memory_order_relaxed);
+    epoch_exit(trans->region, trans->slot);
+    trans->reads.clear();
+    writeset_clear(&trans->writes);
+    trans->owned.clear();
+    trans->allocs.clear();
+    trans->frees.clear();
+    if (spare.trans != NULL){
+        park(trans);
+        return;
+    }
+    spare.trans = trans;
+}
+
+/** Undo what a transaction did and release its descriptor.
+ * @param tx     Transaction to abort
+ * @param reason Reason of the abort, one of 'TM_ABORT_*'
+**/
+static void rollback(tx_t tx, int reason){
+    PROFILE(PROFILE_ROLLBACK);
+    struct transaction* trans = (struct transaction*) tx;
+    counter_add(trans->region->counters[trans->slot].aborts[reason], 1);
+    TRACE_REASON(reason);
+    //whether it was active (others may abort it too) or committing
+    trans->status.store(trans->status.load(memory_order_relaxed) | DSTM_ABORTED, memory_order_release);
+    //nothing was written in place, the stripes not taken over yet go back as they were
+    for (auto orec : trans->owned){
+        struct transaction* self = trans;
+        orec->owner.compare_exchange_strong(self, NULL, memory_order_release, memory_order_relaxed);
+    }
+    for (auto seg : trans->allocs){
+        segment_destroy(seg);
+    }
+    //the retry likely writes the same words
+    for (auto const& entry : trans->writes.entries){
+        cm_predict(&trans->region->cm, entry.location);
+    }
+    cm_abort(&trans->region->cm, trans->reads.size() + trans->writes.entries.size());
+    finish(trans);
+}
+
+//================================================================
+// End of Helper functions
+//================================================================
+
+bool create(shared_t shared) noexcept {
+    struct region* region = (struct region*) shared;
+    if (region->persist != NULL || region->ship != NULL){
+        //a transaction may still be aborted by another once its writes are logged
+        return false;
+    }
+    size_t count = static_cast<size_t>(1) << TM_STRIPES_LOG2;
+    if (region->stripes > 0){
+        for (count = 1; count < region->stripes; count <<= 1);
+    }
+    struct state* st = new (std::nothrow) struct state();
+    if (unlikely(st == NULL)){
+        return false;
+    }
+    //calloc'ed pages are zeroed lazily: every stripe free at version 0
+    st->orecs = (struct orec*) calloc(count, sizeof(struct orec));
+    if (unlikely(st->orecs == NULL)){
+        delete st;
+        return false;
+    }
+    st->mask = count - 1;
+    st->shift = __builtin_ctzl(region->align);
+    st->clock.store(0, memory_order_relaxed);
+    region->overhead.fetch_add(count * sizeof(struct orec), memory_order_relaxed);
+    region->engine = st;
+    return true;
+}
+
+void destroy(shared_t shared) noexcept {
+    struct state* st = (struct state*) ((struct region*) shared)->engine;
+    free(st->orecs);
+    delete st;
+}
+
+tx_t begin(shared_t shared, bool is_ro) noexcept {
+    struct region* region = (struct region*) shared;
+    struct transaction* trans = spare.trans;
+    spare.trans = NULL;
+    if (unlikely(trans == NULL)){
+        trans = unpark();
+        if (unlikely(trans == NULL)){
+            return invalid_tx;
+        }
+    }
+    trans->region = region;
+    //a new serial number, so that a CAS meant for the previous transaction fails
+    trans->status.store((trans->status.load(memory_order_relaxed) | DSTM_STATUS) + 1, memory_order_relaxed);
+    cm_begin(&region->cm);
+    trans->is_ro = is_ro;
+    //announce before taking the snapshot, so that what it reaches stays allocated
+    trans->slot = epoch_enter(region);
+    trans->rv = ((struct state*) region->engine)->clock.load(memory_order_acquire);
+    return (tx_t) trans;
+}
+
+bool end(shared_t shared, tx_t tx) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    struct transaction* trans = (struct transaction*) tx;
+
+    //every read was consistent with the snapshot, nothing to publish
+    if (trans->owned.empty() && trans->frees.empty()){
+        for (auto seg : trans->allocs){
+            segment_register(region, seg);
+        }
+        cm_commit(&region->cm);
+        counter_add(region->counters[trans->slot].commits, 1);
+        finish(trans);
+        return true;
+    }
+
+    cm_yield(&region->cm);
+    uint64_t serial = trans->status.load(memory_order_relaxed) & ~(uint64_t) DSTM_STATUS;
+    uint64_t active = serial | DSTM_ACTIVE;
+    if (!trans->status.compare_exchange_strong(active, serial | DSTM_COMMITTING, memory_order_acq_rel, memory_order_relaxed)){
+        rollback(tx, TM_ABORT_LOCK);
+        return false;
+    }
+    //the version is taken once committing: readers that found this transaction active have a lower snapshot, and a
+    //commit with a lower version that wrote a stripe read is seen committing or done
+    uint64_t wv = st->clock.fetch_add(1, memory_order_acq_rel) + 1;
+    if (wv != trans->rv + 1 && !validate(trans)){
+        rollback(tx, TM_ABORT_VALIDATE);
+        return false;
+    }
+    trans->status.store(serial | DSTM_COMMITTED, memory_order_release);
+    writeset_publish(&trans->writes, region->align, region->stream);
+    for (auto seg : trans->allocs){
+        segment_register(region, seg);
+    }
+    for (auto seg : trans->frees){
+        segment_unregister(region, seg);
+        segment_retire(region, seg);
+    }
+    for (auto orec : trans->owned){
+        orec->version.store(wv, memory_order_release);
+        orec->owner.store(NULL, memory_order_release);
+    }
+    cm_commit(&region->cm);
+    counter_add(region->counters[trans->slot].commits, 1);
+    finish(trans);
+    return true;
+}
+
+bool read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    struct transaction* trans = (struct transaction*) tx;
+    size_t align = region->align;
+
+    counter_add(region->counters[trans->slot].reads, 1);
+    if (segment_captured(trans->allocs, source, size)){
+        words_copy(target, source, size, align);
+        return true;
+    }
+    if (unlikely(killed(trans))){
+        rollback(tx, TM_ABORT_LOCK);
+        return false;
+    }
+    for (size_t i = 0; i < size; i += align){
+        byte const* src = (byte const*) source + i;
+        byte* dst = (byte*) target + i;
+        struct orec* orec = orec_of(st, src);
+        uint64_t version;
+        for (size_t attempt = 0;; ++attempt){
+            struct transaction* owner = orec->owner.load(memory_order_acquire);
+            uint64_t status = 0;
+            if (owner == trans){
+                //read-after-write, return the buffered value
+                byte const* value = buffered(trans, orec, src);
+                if (value != NULL){
+                    word_copy(dst, value, align);
+                    break;
+                }
+            } else if (owner != NULL){
+                status = owner->status.load(memory_order_acquire);
+                if ((status & DSTM_STATUS) == DSTM_COMMITTING || (status & DSTM_STATUS) == DSTM_COMMITTED){
+                    settle(attempt);
+                    continue;
+                }
+            }
+            //free, or owned by a transaction not committing: the stripe holds the values of its version
+            version = orec->version.load(memory_order_acquire);
+            word_copy(dst, src, align);
+            atomic_thread_fence(memory_order_acquire);
+            if (orec->owner.load(memory_order_relaxed) != owner || orec->version.load(memory_order_relaxed) != version
+                || (owner != NULL && owner != trans && owner->status.load(memory_order_relaxed) != status)){
+                continue;
+            }
+            if (version > trans->rv){
+                //written since the snapshot, read again once the snapshot is moved past it
+                if (trans->is_ro || !extend(st, trans)){
+                    rollback(tx, TM_ABORT_READ);
+                    return false;
+                }
+                continue;
+            }
+            if (!trans->is_ro){
+                PROFILE(PROFILE_LOG);
+                trans->reads.push_back({src, orec, version});
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+bool write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    size_t align = region->align;
+    struct transaction* trans = (struct transaction*) tx;
+
+    counter_add(region->counters[trans->slot].writes, 1);
+    if (segment_captured(trans->allocs, target, size)){
+        words_copy(target, source, size, align);
+        return true;
+    }
+    for (size_t i = 0; i < size; i += align){
+        byte* dst = (byte*) target + i;
+        struct orec* orec = orec_of(st, dst);
+        if (!acquire(trans, orec)){
+            rollback(tx, TM_ABORT_LOCK);
+            return false;
+        }
+        buffer(trans, orec, dst, (byte const*) source + i, align);
+    }
+    return true;
+}
+
+bool add(shared_t shared, tx_t tx, void* target, int64_t delta) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    struct transaction* trans = (struct transaction*) tx;
+    size_t align = region->align;
+
+    counter_add(region->counters[trans->slot].writes, 1);
+    if (segment_captured(trans->allocs, target, align)){
+        word_add(target, delta);
+        return true;
+    }
+    //once owned, memory holds the latest committed value and nobody else changes it: no read to log
+    struct orec* orec = orec_of(st, target);
+    if (!acquire(trans, orec)){
+        rollback(tx, TM_ABORT_LOCK);
+        return false;
+    }
+    byte* value = buffered(trans, orec, target);
+    if (value == NULL){
+        buffer(trans, orec, (byte*) target, (byte const*) target, align);
+        value = buffered(trans, orec, target);
+    }
+    word_add(value, delta);
+    return true;
+}
+
+void release(shared_t shared, tx_t tx, void const* source, size_t size) noexcept {
+    struct transaction* trans = (struct transaction*) tx;
+    size_t align = ((struct region*) shared)->align;
+
+    for (size_t i = 0; i < size; i += align){
+        byte const* src = (byte const*) source + i;
+        for (size_t j = trans->reads.size(); j-- > 0;){
+            if (trans->reads[j].location == src){
+                trans->reads[j] = trans->reads.back();
+                trans->reads.pop_back();
+                break;
+            }
+        }
+    }
+}
+
+Alloc alloc(shared_t shared, tx_t tx, size_t size, void** target) noexcept {
+    struct segment* seg = segment_create((struct region*) shared, size);
+    if (unlikely(seg == NULL)){
+        return Alloc::nomem;
+    }
+    //private until commit, registered only if the transaction commits
+    struct transaction* trans = (struct transaction*) tx;
+    trans->allocs.push_back(seg);
+    counter_add(trans->region->counters[trans->slot].allocs, 1);
+    *target = (void*) seg->mem;
+    return Alloc::success;
+}
+
+bool dealloc(shared_t shared, tx_t tx, void* target) noexcept {
+    struct transaction* trans = (struct transaction*) tx;
+    for (auto it = trans->allocs.begin(); it != trans->allocs.end(); ++it){
+        //allocated by this very transaction, nobody else can see it
+        if ((*it)->mem == target){
+            segment_destroy(*it);
+            trans->allocs.erase(it);
+            counter_add(trans->region->counters[trans->slot].frees, 1);
+            return true;
+        }
+    }
+    struct segment* seg = segment_find((struct region*) shared, target);
+    if (seg == NULL || seg->mem != target){
+        //not the start of a live segment (e.g. freed concurrently), abort
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    counter_add(trans->region->counters[trans->slot].frees, 1);
+    for (auto other : trans->frees){
+        if (other == seg){
+            return true;
+        }
+    }
+    trans->frees.push_back(seg);
+    return true;
+}
+
+/** Get a descriptor for the calling thread ahead of its first transaction.
+ * @param shared Region the thread entered
+**/
+void thread_enter(shared_t shared as(unused)) noexcept {
+    if (spare.trans == NULL){
+        spare.trans = unpark();
+    }
+}
+
+/** Park the descriptor the calling thread kept between its transactions.
+ * @param shared Region the thread leaves
+**/
+void thread_leave(shared_t shared as(unused)) noexcept {
+    if (spare.trans != NULL){
+        park(spare.trans);
+        spare.trans = NULL;
+    }
+}
+
+}
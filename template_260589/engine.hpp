@@ -0,0 +1,134 @@
+/**
+ * @file   engine.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Interface every transaction engine implements, 'tm.cpp' forwards to the one
+ * the region was created with.
+**/
+
+#pragma once
+
+// Internal headers
+#include <tm.hpp>
+
+// -------------------------------------------------------------------------- //
+
+/** Entry points of one engine, so that the engine can be picked at runtime.
+**/
+struct engine {
+    char const* name;
+    bool  (*create)(shared_t) noexcept;
+    void  (*destroy)(shared_t) noexcept;
+    tx_t  (*begin)(shared_t, bool) noexcept;
+    bool  (*end)(shared_t, tx_t) noexcept;
+    bool  (*read)(shared_t, tx_t, void const*, size_t, void*) noexcept;
+    bool  (*read_for_update)(shared_t, tx_t, void const*, size_t, void*) noexcept; // Read of words the transaction will write
+    bool  (*write)(shared_t, tx_t, void const*, size_t, void*) noexcept;
+    bool  (*add)(shared_t, tx_t, void*, int64_t) noexcept; // Increment of one word, of at least 8 bytes
+    void  (*release)(shared_t, tx_t, void const*, size_t) noexcept; // Early release of words read
+    Alloc (*alloc)(shared_t, tx_t, size_t, void**) noexcept;
+    bool  (*dealloc)(shared_t, tx_t, void*) noexcept;
+    void  (*thread_enter)(shared_t) noexcept; // Preallocation of the state of the calling thread
+    void  (*thread_leave)(shared_t) noexcept; // Release of the state of the calling thread
+    bool  (*end_linearize)(shared_t, tx_t, bool*) noexcept; // 'end' up to the linearization point, setting whether 'end_publish' must complete it (optional, 'nullptr' if 'end' is never split)
+    void  (*end_publish)(shared_t, tx_t) noexcept; // Completion of a transaction linearized by 'end_linearize', from any thread
+    bool  (*hint)(shared_t, tx_t, void const* const*, size_t, uint64_t) noexcept; // Declaration of the words a transaction will access (optional, 'nullptr' if unused)
+    tx_t  (*begin_snapshot)(shared_t) noexcept; // Begin under snapshot isolation (optional, 'nullptr' if the engine only runs serializable transactions)
+    bool  (*savepoint)(shared_t, tx_t, size_t*) noexcept; // Mark of the accesses so far (optional, 'nullptr' if transactions only roll back wholly)
+    bool  (*rollback_to)(shared_t, tx_t, size_t) noexcept; // Partial rollback to a mark, 'nullptr' along with 'savepoint'
+    tx_t  (*begin_join)(shared_t, tx_t) noexcept; // Begin a read-only transaction on the snapshot of another (optional, 'nullptr' if snapshots cannot be shared)
+    bool  (*read_view)(shared_t, tx_t, void const*, size_t, void const**) noexcept; // Read in place, validated at commit (optional, 'nullptr' if every read copies)
+    bool  (*write_reserve)(shared_t, tx_t, void*, size_t, void**) noexcept; // Room in the write set for the caller to fill (optional, 'nullptr' if every write copies)
+};
+
+/** Declare the entry points of one engine.
+ * @param name Namespace of the engine
+**/
+#define ENGINE(name) \
+    namespace name { \
+        bool  create(shared_t) noexcept; \
+        void  destroy(shared_t) noexcept; \
+        tx_t  begin(shared_t, bool) noexcept; \
+        bool  end(shared_t, tx_t) noexcept; \
+        bool  read(shared_t, tx_t, void const*, size_t, void*) noexcept; \
+        bool  write(shared_t, tx_t, void const*, size_t, void*) noexcept; \
+        bool  add(shared_t, tx_t, void*, int64_t) noexcept; \
+        void  release(shared_t, tx_t, void const*, size_t) noexcept; \
+        Alloc alloc(shared_t, tx_t, size_t, void**) noexcept; \
+        bool  dealloc(shared_t, tx_t, void*) noexcept; \
+        void  thread_enter(shared_t) noexcept; \
+        void  thread_leave(shared_t) noexcept; \
+    }
+
+ENGINE(tl2)         // Global version clock, striped versioned locks, commit-time locking
+ENGINE(norec)       // Single sequence lock, value-based validation
+ENGINE(pessimistic) // Per-segment locks taken on access, undo log
+ENGINE(adaptive)    // 'tl2', or 'pessimistic' while the abort rate is high
+ENGINE(dstm)        // Ownership records taken on write, owners aborted rather than waited for
+ENGINE(ring)        // Ring of the write filters of the last commits, no per-word metadata
+
+#undef ENGINE
+
+//only these take write ownership on a read for update, the others lock at commit and read as usual
+namespace pessimistic {
+    bool read_for_update(shared_t, tx_t, void const*, size_t, void*) noexcept;
+}
+namespace adaptive {
+    bool read_for_update(shared_t, tx_t, void const*, size_t, void*) noexcept;
+}
+
+//only these make use of the words declared ahead of the accesses
+namespace tl2 {
+    bool hint(shared_t, tx_t, void const* const*, size_t, uint64_t) noexcept;
+    tx_t begin_snapshot(shared_t) noexcept; // Only this one offers snapshot isolation
+}
+namespace pessimistic {
+    bool hint(shared_t, tx_t, void const* const*, size_t, uint64_t) noexcept;
+}
+namespace adaptive {
+    bool hint(shared_t, tx_t, void const* const*, size_t, uint64_t) noexcept;
+}
+
+//only this one splits a commit, so that the work after its linearization point can be left to another thread
+namespace tl2 {
+    bool end_linearize(shared_t, tx_t, bool*) noexcept;
+    void end_publish(shared_t, tx_t) noexcept;
+}
+
+//only this one rolls a transaction back to a mark rather than wholly
+namespace tl2 {
+    bool savepoint(shared_t, tx_t, size_t*) noexcept;
+    bool rollback_to(shared_t, tx_t, size_t) noexcept;
+}
+
+//only this one has read-only snapshots a handle fully describes, that other threads can read at
+namespace tl2 {
+    tx_t begin_join(shared_t, tx_t) noexcept;
+}
+
+//only this one validates whole stripes at commit, so that a range can be read in place
+namespace tl2 {
+    bool read_view(shared_t, tx_t, void const*, size_t, void const**) noexcept;
+}
+
+//only this one buffers the words of a range contiguously, so that the caller can write them there
+namespace tl2 {
+    bool write_reserve(shared_t, tx_t, void*, size_t, void**) noexcept;
+}
+
+struct tm_mode;
+struct tm_stats;
+
+namespace tl2 {
+    void stats(void*, struct tm_stats*) noexcept;
+}
+namespace adaptive {
+    void query(shared_t, struct tm_mode*) noexcept;
+    void stats(shared_t, struct tm_stats*) noexcept;
+}
@@ -0,0 +1,196 @@
+/**
+ * @file   heatmap.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Conflict heatmap, empty unless built with USE_HEATMAP. Conflicts are
+ * counted in a fixed open-addressing table keyed by word, the report is meant
+ * to run once every thread stopped running transactions.
+**/
+
+// Internal headers
+#include "common.hpp"
+#include "heatmap.hpp"
+
+#ifdef USE_HEATMAP
+
+// External headers
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "region.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Log2 of the number of words (or whole segments) the table can tell apart, the conflicts on the others are dropped
+#ifndef HEATMAP_SLOTS_LOG2
+    #define HEATMAP_SLOTS_LOG2 16
+#endif
+
+// Number of words and of segments in the report
+#ifndef HEATMAP_TOP
+    #define HEATMAP_TOP 10
+#endif
+
+/** Conflicts on one word, or on one whole segment.
+**/
+struct heatmap_entry {
+    atomic<uintptr_t> key;     // Word, or start of the segment memory plus one for the whole segment, 0 for an empty slot
+    atomic<uintptr_t> segment; // Start of the segment memory
+    atomic<size_t> offset;     // Offset of the word in the segment, SIZE_MAX for the whole segment
+    atomic<size_t> stripe;     // Stripe of the first conflict, HEATMAP_NO_STRIPE if none
+    atomic<uint64_t> count;    // Conflicts so far
+};
+
+/** Counts of a region.
+**/
+struct heatmap {
+    atomic<uint64_t> dropped; // Conflicts not counted, the table being full or the location in no segment
+    struct heatmap_entry entries[1ul << HEATMAP_SLOTS_LOG2];
+};
+
+/** Allocate the (zeroed) counts of a region.
+ * @return Counts, NULL if out of memory
+**/
+struct heatmap* heatmap_create() noexcept {
+    return (struct heatmap*) calloc(1, sizeof(struct heatmap));
+}
+
+/** Free the counts of a region.
+ * @param counts Counts to free, may be NULL
+**/
+void heatmap_destroy(struct heatmap* counts) noexcept {
+    free(counts);
+}
+
+/** [thread-safe] Count a conflict.
+ * @param region   Region of the conflict
+ * @param seg      Segment of the conflict, NULL to look it up from the location
+ * @param location Word of the conflict, NULL for the whole segment
+ * @param stripe   Stripe the conflict was detected on, HEATMAP_NO_STRIPE if none
+**/
+void heatmap_note(struct region* region, struct segment* seg, void const* location, size_t stripe) noexcept {
+    struct heatmap* counts = region->heatmap;
+    if (unlikely(counts == NULL)){
+        return;
+    }
+    if (seg == NULL && location != NULL){
+        seg = segment_find(region, location);
+    }
+    if (unlikely(seg == NULL)){
+        counts->dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    uintptr_t key = location != NULL ? (uintptr_t) location : (uintptr_t) seg->mem + 1;
+    size_t mask = (1ul << HEATMAP_SLOTS_LOG2) - 1;
+    size_t slot = (size_t) ((key * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - HEATMAP_SLOTS_LOG2));
+    for (size_t probe = 0; probe <= mask; ++probe, slot = (slot + 1) & mask){
+        struct heatmap_entry& entry = counts->entries[slot];
+        uintptr_t current = entry.key.load(memory_order_acquire);
+        if (current == 0 && entry.key.compare_exchange_strong(current, key, memory_order_acq_rel)){
+            entry.segment.store((uintptr_t) seg->mem, memory_order_relaxed);
+            entry.offset.store(location != NULL ? (size_t) ((std::byte const*) location - seg->mem) : SIZE_MAX, memory_order_relaxed);
+            entry.stripe.store(stripe, memory_order_relaxed);
+            current = key;
+        }
+        if (current == key){
+            entry.count.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+    }
+    counts->dropped.fetch_add(1, memory_order_relaxed);
+}
+
+/** Print the words and segments with the most conflicts, and write every count to the file named by 'TM_HEATMAP' if set.
+ * @param region Region whose conflicts to report, with no transaction running
+**/
+void heatmap_report(struct region* region) noexcept {
+    struct heatmap* counts = region->heatmap;
+    if (counts == NULL){
+        return;
+    }
+    vector<struct heatmap_entry const*> words;
+    map<uintptr_t, uint64_t> segments;
+    uint64_t total = 0;
+    for (auto const& entry : counts->entries){
+        uint64_t count = entry.count.load(memory_order_relaxed);
+        if (count == 0){
+            continue;
+        }
+        words.push_back(&entry);
+        segments[entry.segment.load(memory_order_relaxed)] += count;
+        total += count;
+    }
+    uint64_t dropped = counts->dropped.load(memory_order_relaxed);
+    fprintf(stderr, "heatmap: %lu conflicts on %zu words or segments in %zu segments (%lu dropped)\n", total, words.size(), segments.size(), dropped);
+    if (total == 0){
+        return;
+    }
+    auto describe = [&](uintptr_t segment) {
+        return segment == (uintptr_t) region->start ? " (first)" : "";
+    };
+    sort(words.begin(), words.end(), [](auto a, auto b) { return a->count.load(memory_order_relaxed) > b->count.load(memory_order_relaxed); });
+    for (size_t i = 0; i < words.size() && i < HEATMAP_TOP; ++i){
+        struct heatmap_entry const* entry = words[i];
+        uintptr_t segment = entry->segment.load(memory_order_relaxed);
+        size_t offset = entry->offset.load(memory_order_relaxed);
+        size_t stripe = entry->stripe.load(memory_order_relaxed);
+        uint64_t count = entry->count.load(memory_order_relaxed);
+        fprintf(stderr, "heatmap:   segment %#lx%s, ", segment, describe(segment));
+        if (offset == SIZE_MAX){
+            fprintf(stderr, "whole segment");
+        } else {
+            fprintf(stderr, "offset %zu", offset);
+        }
+        if (stripe != HEATMAP_NO_STRIPE){
+            fprintf(stderr, ", stripe %zu", stripe);
+        }
+        fprintf(stderr, ": %lu conflicts (%.2f%%)\n", count, 100. * count / total);
+    }
+    vector<pair<uintptr_t, uint64_t>> ranked(segments.begin(), segments.end());
+    sort(ranked.begin(), ranked.end(), [](auto const& a, auto const& b) { return a.second > b.second; });
+    fprintf(stderr, "heatmap: top segments\n");
+    for (size_t i = 0; i < ranked.size() && i < HEATMAP_TOP; ++i){
+        fprintf(stderr, "heatmap:   segment %#lx%s: %lu conflicts (%.2f%%)\n", ranked[i].first, describe(ranked[i].first), ranked[i].second, 100. * ranked[i].second / total);
+    }
+    char const* path = getenv("TM_HEATMAP");
+    if (path == NULL){
+        return;
+    }
+    FILE* file = fopen(path, "w");
+    if (file == NULL){
+        fprintf(stderr, "heatmap: cannot open '%s'\n", path);
+        return;
+    }
+    //one line per word or whole segment, the fields not applicable left empty
+    fprintf(file, "segment,offset,stripe,conflicts\n");
+    for (auto entry : words){
+        size_t offset = entry->offset.load(memory_order_relaxed);
+        size_t stripe = entry->stripe.load(memory_order_relaxed);
+        fprintf(file, "%#lx,", entry->segment.load(memory_order_relaxed));
+        if (offset != SIZE_MAX){
+            fprintf(file, "%zu", offset);
+        }
+        fprintf(file, ",");
+        if (stripe != HEATMAP_NO_STRIPE){
+            fprintf(file, "%zu", stripe);
+        }
+        fprintf(file, ",%lu\n", entry->count.load(memory_order_relaxed));
+    }
+    fclose(file);
+}
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file   heatmap.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Conflict heatmap, only compiled in with USE_HEATMAP. Every conflict that
+ * makes a transaction abort is attributed to the word (or the whole segment,
+ * for the segment locks of 'pessimistic') and the stripe it was detected on;
+ * when the region is destroyed, the most conflicting words and segments are
+ * printed and, if 'TM_HEATMAP' names a file, every count is written to it.
+**/
+
+#pragma once
+
+// External headers
+#include <cstddef>
+#include <cstdint>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Stripe of a conflict not detected on a lock table
+#define HEATMAP_NO_STRIPE SIZE_MAX
+
+struct region;
+struct segment;
+
+#ifdef USE_HEATMAP
+
+struct heatmap* heatmap_create() noexcept;
+void heatmap_destroy(struct heatmap*) noexcept;
+void heatmap_note(struct region*, struct segment*, void const*, size_t) noexcept;
+void heatmap_report(struct region*) noexcept;
+
+/** Attribute a conflict.
+ * @param region   Region of the conflict
+ * @param seg      Segment of the conflict, NULL to look it up from the location
+ * @param location Word of the conflict, NULL for the whole segment
+ * @param stripe   Stripe the conflict was detected on, HEATMAP_NO_STRIPE if none
+**/
+#define HEATMAP(region, seg, location, stripe) \
+    heatmap_note((region), (seg), (location), (stripe))
+
+#else
+
+#define HEATMAP(region, seg, location, stripe) \
+    do {} while (0)
+
+#endif
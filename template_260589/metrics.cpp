@@ -0,0 +1,412 @@
+/**
+ * @file   metrics.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Live metrics exporter, empty unless built with USE_METRICS. One service
+ * thread serves every region of the process: it runs while at least one
+ * region is live and 'TM_METRICS' is set, and takes the lock of the list of
+ * regions to render them, so that a region leaving the list is never read
+ * again.
+**/
+
+// Internal headers
+#include "common.hpp"
+#include "metrics.hpp"
+
+#ifdef USE_METRICS
+
+// External headers
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+// Internal headers
+#include <tm_ext.hpp>
+#include "contention.hpp"
+#include "engine.hpp"
+#include "region.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Prefix of a 'TM_METRICS' naming a Unix socket rather than a file
+#define METRICS_SOCKET "unix:"
+
+// Names of the abort reasons and of the classes in the labels
+static char const* const reason_names[TM_ABORT_REASONS] = {"read", "lock", "validate", "other"};
+static char const* const class_names[TM_CLASSES] = {"interactive", "batch"};
+
+/** Commit latencies of one thread, never freed so that they outlive the thread.
+ * Only the thread writes them, the exporter reads them while it runs.
+**/
+struct metrics_thread {
+    struct metrics_thread* next;
+    uint64_t start; // Timestamp of the first attempt of the running transaction, 0 if none
+    atomic<uint64_t> latency[METRICS_BUCKETS]; // Commits by latency bucket
+    atomic<uint64_t> ticks; // Sum of the latencies
+};
+
+/** One run of the service thread, from the first region created to the last one destroyed.
+**/
+struct metrics_run {
+    string path;   // File or socket the metrics go to
+    int listener;  // Listening socket, -1 to write a file
+    int wake[2];   // Pipe whose read end wakes the thread up to stop
+    uint64_t tsc;  // Timestamp and time of the start, to turn timestamps into seconds
+    chrono::steady_clock::time_point time;
+};
+
+static atomic<struct metrics_thread*> all{NULL};
+static thread_local struct metrics_thread* own = NULL;
+static atomic<bool> enabled{false}; // Whether the latencies are measured, i.e. the service thread runs
+
+static mutex regions_lock; // Guards what follows, the service thread holds it while rendering
+static vector<pair<struct region*, uint64_t>> regions; // Live regions and their number in the labels
+static uint64_t next_id = 0;
+static struct metrics_run* run = NULL;
+static pthread_t service;
+
+/** Read the timestamp counter.
+ * @return Current timestamp
+**/
+static inline uint64_t metrics_tsc() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+/** Get the latencies of the calling thread, creating them on first use.
+ * @return Latencies of the thread, NULL if out of memory
+**/
+static struct metrics_thread* own_counters() noexcept {
+    if (likely(own != NULL)){
+        return own;
+    }
+    struct metrics_thread* fresh = (struct metrics_thread*) calloc(1, sizeof(struct metrics_thread));
+    if (unlikely(fresh == NULL)){
+        return NULL;
+    }
+    fresh->next = all.load(memory_order_relaxed);
+    while (!all.compare_exchange_weak(fresh->next, fresh, memory_order_release, memory_order_relaxed));
+    own = fresh;
+    return own;
+}
+
+/** [thread-safe] Start the latency of the transaction the calling thread begins, unless it is the retry of an aborted one.
+**/
+void metrics_begin() noexcept {
+    if (likely(!enabled.load(memory_order_relaxed)) || cm_retries() != 0){
+        return;
+    }
+    struct metrics_thread* counters = own_counters();
+    if (likely(counters != NULL)){
+        counters->start = metrics_tsc();
+    }
+}
+
+/** [thread-safe] Count the latency of the transaction the calling thread committed.
+**/
+void metrics_commit() noexcept {
+    struct metrics_thread* counters = own;
+    if (counters == NULL || counters->start == 0){
+        return;
+    }
+    uint64_t ticks = metrics_tsc() - counters->start;
+    counters->start = 0;
+    uint64_t high = ticks >> METRICS_FIRST_LOG2;
+    size_t bucket = high == 0 ? 0 : 64 - __builtin_clzll(high);
+    if (bucket >= METRICS_BUCKETS){
+        bucket = METRICS_BUCKETS - 1;
+    }
+    //only this thread writes them, no read-modify-write needed
+    counters->latency[bucket].store(counters->latency[bucket].load(memory_order_relaxed) + 1, memory_order_relaxed);
+    counters->ticks.store(counters->ticks.load(memory_order_relaxed) + ticks, memory_order_relaxed);
+}
+
+/** Append formatted text.
+ * @param text   Text to append to
+ * @param format Format, as for 'printf'
+**/
+static void append(string& text, char const* format, ...) as(format(printf, 2, 3));
+static void append(string& text, char const* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0){
+        text.append(line, (size_t) length < sizeof(line) ? (size_t) length : sizeof(line) - 1);
+    }
+}
+
+/** Render the metrics of every live region and the latencies of every thread, in the Prometheus text format.
+ * @param current Run of the service thread
+ * @return Metrics
+**/
+static string render(struct metrics_run* current) {
+    string text;
+    lock_guard<mutex> guard{regions_lock};
+    vector<struct tm_stats> stats(regions.size());
+    for (size_t i = 0; i < regions.size(); ++i){
+        tm_stats(regions[i].first, &stats[i]);
+    }
+    auto family = [&](char const* name, char const* type, char const* help) {
+        append(text, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    };
+    auto labels = [&](size_t i) {
+        append(text, "{region=\"%lu\",engine=\"%s\"", regions[i].second, regions[i].first->ops->name);
+    };
+    auto single = [&](char const* name, char const* type, char const* help, auto value) {
+        family(name, type, help);
+        for (size_t i = 0; i < regions.size(); ++i){
+            append(text, "%s", name);
+            labels(i);
+            append(text, "} %lu\n", (uint64_t) value(i));
+        }
+    };
+    single("tm_commits_total", "counter", "Committed transactions.", [&](size_t i) { return stats[i].commits; });
+    family("tm_aborts_total", "counter", "Aborted transaction attempts, by reason.");
+    for (size_t i = 0; i < regions.size(); ++i){
+        for (int reason = 0; reason < TM_ABORT_REASONS; ++reason){
+            append(text, "tm_aborts_total");
+            labels(i);
+            append(text, ",reason=\"%s\"} %lu\n", reason_names[reason], stats[i].aborts[reason]);
+        }
+    }
+    family("tm_class_commits_total", "counter", "Committed transactions, by class of 'tm_begin_class'.");
+    for (size_t i = 0; i < regions.size(); ++i){
+        for (int klass = 0; klass < TM_CLASSES; ++klass){
+            append(text, "tm_class_commits_total");
+            labels(i);
+            append(text, ",class=\"%s\"} %lu\n", class_names[klass], stats[i].class_commits[klass]);
+        }
+    }
+    single("tm_reads_total", "counter", "Calls to 'tm_read'.", [&](size_t i) { return stats[i].reads; });
+    single("tm_writes_total", "counter", "Calls to 'tm_write'.", [&](size_t i) { return stats[i].writes; });
+    single("tm_allocs_total", "counter", "Successful calls to 'tm_alloc'.", [&](size_t i) { return stats[i].allocs; });
+    single("tm_frees_total", "counter", "Successful calls to 'tm_free'.", [&](size_t i) { return stats[i].frees; });
+    single("tm_irrevocable_total", "counter", "Transactions run in the serial irrevocable mode.", [&](size_t i) { return stats[i].irrevocable; });
+    single("tm_data_bytes", "gauge", "Bytes of the live segments.", [&](size_t i) { return stats[i].data_bytes; });
+    single("tm_metadata_bytes", "gauge", "Bytes held beyond the live segments.", [&](size_t i) { return stats[i].metadata_bytes; });
+    single("tm_log_bytes", "gauge", "Bytes of the descriptors and logs the threads keep for their transactions.", [&](size_t i) { return stats[i].descriptor_bytes; });
+    single("tm_reclaim_pending", "gauge", "Retired objects not reclaimed yet.", [&](size_t i) { return regions[i].first->pending.load(memory_order_relaxed); });
+    single("tm_stripes", "gauge", "Stripes of the lock table.", [&](size_t i) { return stats[i].stripes; });
+    //timestamps to seconds, measured over the whole run for precision
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - current->time).count();
+    double tick = seconds / (double) (metrics_tsc() - current->tsc);
+    uint64_t latency[METRICS_BUCKETS] = {};
+    uint64_t ticks = 0;
+    for (struct metrics_thread* it = all.load(memory_order_acquire); it != NULL; it = it->next){
+        for (size_t b = 0; b < METRICS_BUCKETS; ++b){
+            latency[b] += it->latency[b].load(memory_order_relaxed);
+        }
+        ticks += it->ticks.load(memory_order_relaxed);
+    }
+    family("tm_commit_latency_seconds", "histogram", "Time from the first attempt of a transaction to its commit, in every region.");
+    uint64_t count = 0;
+    for (size_t b = 0; b < METRICS_BUCKETS; ++b){
+        count += latency[b];
+        if (b + 1 < METRICS_BUCKETS){
+            append(text, "tm_commit_latency_seconds_bucket{le=\"%.3g\"} %lu\n", tick * (double) (UINT64_C(1) << (METRICS_FIRST_LOG2 + b)), count);
+        } else {
+            append(text, "tm_commit_latency_seconds_bucket{le=\"+Inf\"} %lu\n", count);
+        }
+    }
+    append(text, "tm_commit_latency_seconds_sum %.9f\ntm_commit_latency_seconds_count %lu\n", tick * (double) ticks, count);
+    return text;
+}
+
+/** Write the metrics into the file of a run, through a temporary file so that readers never see a partial one.
+ * @param current Run of the service thread
+ * @param text    Metrics
+**/
+static void publish(struct metrics_run* current, string const& text) {
+    string temporary = current->path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "w");
+    if (file == NULL){
+        return;
+    }
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    if (fclose(file) == 0 && written){
+        rename(temporary.c_str(), current->path.c_str());
+    }
+}
+
+/** Answer one connection to the socket of a run with the metrics.
+ * @param current Run of the service thread
+**/
+static void serve(struct metrics_run* current) {
+    int client = accept(current->listener, NULL, NULL);
+    if (client < 0){
+        return;
+    }
+    string text = render(current);
+    for (size_t done = 0; done < text.size();){
+        ssize_t sent = send(client, text.data() + done, text.size() - done, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR){
+            continue;
+        }
+        if (sent <= 0){
+            break;
+        }
+        done += sent;
+    }
+    close(client);
+}
+
+/** Service thread, writing the file every TM_METRICS_PERIOD milliseconds or answering the connections to the socket until woken up.
+ * @param arg Run of the thread
+ * @return NULL
+**/
+static void* exporter_run(void* arg) {
+    struct metrics_run* current = (struct metrics_run*) arg;
+    //a first interval to turn timestamps into seconds
+    this_thread::sleep_for(chrono::milliseconds(10));
+    while (true){
+        struct pollfd fds[2] = {{current->wake[0], POLLIN, 0}, {current->listener, POLLIN, 0}};
+        bool socket = current->listener >= 0;
+        int ready = poll(fds, socket ? 2 : 1, socket ? -1 : TM_METRICS_PERIOD);
+        if (ready < 0 && errno != EINTR){
+            break;
+        }
+        if (fds[0].revents != 0){
+            break;
+        }
+        if (!socket){
+            publish(current, render(current));
+        } else if (ready > 0 && fds[1].revents != 0){
+            serve(current);
+        }
+    }
+    return NULL;
+}
+
+/** Release what a run holds.
+ * @param current Run to release
+**/
+static void run_close(struct metrics_run* current) {
+    if (current->listener >= 0){
+        close(current->listener);
+        unlink(current->path.c_str());
+    }
+    close(current->wake[0]);
+    close(current->wake[1]);
+    delete current;
+}
+
+/** Start the service thread, with 'regions_lock' held.
+ * @param target Value of 'TM_METRICS'
+**/
+static void run_start(char const* target) {
+    struct metrics_run* current = new (std::nothrow) struct metrics_run();
+    if (unlikely(current == NULL)){
+        return;
+    }
+    current->listener = -1;
+    if (pipe(current->wake) != 0){
+        delete current;
+        return;
+    }
+    bool socket_path = strncmp(target, METRICS_SOCKET, strlen(METRICS_SOCKET)) == 0;
+    current->path = socket_path ? target + strlen(METRICS_SOCKET) : target;
+    if (socket_path){
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        current->listener = current->path.size() < sizeof(address.sun_path) ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+        if (current->listener >= 0){
+            memcpy(address.sun_path, current->path.c_str(), current->path.size() + 1);
+            unlink(address.sun_path);
+            if (bind(current->listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(current->listener, 16) != 0){
+                close(current->listener);
+                current->listener = -1;
+            }
+        }
+        if (current->listener < 0){
+            fprintf(stderr, "metrics: cannot listen on '%s'\n", current->path.c_str());
+            run_close(current);
+            return;
+        }
+    }
+    current->tsc = metrics_tsc();
+    current->time = chrono::steady_clock::now();
+    if (unlikely(pthread_create(&service, NULL, exporter_run, current) != 0)){
+        run_close(current);
+        return;
+    }
+    run = current;
+    enabled.store(true, memory_order_relaxed);
+}
+
+/** [thread-safe] Export the metrics of a new region, starting the service thread for the first one if 'TM_METRICS' is set.
+ * @param region Region to export
+**/
+void metrics_attach(struct region* region) noexcept {
+    char const* target = getenv("TM_METRICS");
+    if (target == NULL){
+        return;
+    }
+    lock_guard<mutex> guard{regions_lock};
+    regions.emplace_back(region, next_id++);
+    if (run == NULL){
+        run_start(target);
+    }
+}
+
+/** [thread-safe] Stop exporting the metrics of a region about to be destroyed, stopping the service thread after the last one.
+ * @param region Region to stop exporting
+**/
+void metrics_detach(struct region* region) noexcept {
+    struct metrics_run* current = NULL;
+    pthread_t stopped;
+    {
+        lock_guard<mutex> guard{regions_lock};
+        for (auto it = regions.begin(); it != regions.end(); ++it){
+            if (it->first == region){
+                regions.erase(it);
+                break;
+            }
+        }
+        if (!regions.empty() || run == NULL){
+            return;
+        }
+        current = run;
+        stopped = service;
+        run = NULL;
+        enabled.store(false, memory_order_relaxed);
+    }
+    //the thread may wait for the lock to render, so it is joined without it
+    char wake = 0;
+    while (write(current->wake[1], &wake, 1) < 0 && errno == EINTR);
+    pthread_join(stopped, NULL);
+    run_close(current);
+}
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * @file   metrics.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Live metrics exporter, only compiled in with USE_METRICS and only started
+ * if 'TM_METRICS' is set. A service thread of the process renders, in the
+ * Prometheus text format, the statistics of every live region (commits,
+ * aborts by reason, descriptor and log bytes, reclamation backlog...) and the
+ * commit latencies of every thread. 'TM_METRICS' names either a file, written
+ * anew (then renamed into place) every TM_METRICS_PERIOD milliseconds, or,
+ * prefixed with 'unix:', a Unix socket answering each connection with the
+ * metrics of the moment. The exporter only reads counters the transactions
+ * already maintain with relaxed stores on lines of their own, so that
+ * scraping does not slow them down.
+**/
+
+#pragma once
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Buckets of the commit latencies: below 2^METRICS_FIRST_LOG2 timestamp ticks, then each twice the previous one, the rest in the last one
+#define METRICS_BUCKETS    24
+#define METRICS_FIRST_LOG2 8
+
+struct region;
+
+#ifdef USE_METRICS
+
+void metrics_attach(struct region*) noexcept;
+void metrics_detach(struct region*) noexcept;
+void metrics_begin() noexcept;
+void metrics_commit() noexcept;
+
+// Start of the latency of the transaction, on its first attempt
+#define METRICS_BEGIN() \
+    metrics_begin()
+// End of the latency of the transaction, once committed
+#define METRICS_COMMIT() \
+    metrics_commit()
+
+#else
+
+#define METRICS_BEGIN() \
+    do {} while (0)
+#define METRICS_COMMIT() \
+    do {} while (0)
+
+#endif
@@ -0,0 +1,420 @@
+/**
+ * @file   norec.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * NOrec-style engine: one global sequence lock and no per-word metadata.
+ * Reads log the values they returned, and are validated by value whenever
+ * another transaction committed since the snapshot. Writes are buffered and
+ * published in 'tm_end' while holding the sequence lock.
+ *
+ * Read-only transactions log nothing at first: they commit as long as the
+ * sequence lock has not moved since the snapshot, and abort as soon as it
+ * has. After such an abort, the next TM_RO_LOGGED of the thread log their
+ * reads again, so that they can move their snapshot rather than abort.
+**/
+
+// External headers
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <sched.h>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "engine.hpp"
+#include "heatmap.hpp"
+#include "percpu.hpp"
+#include "persist.hpp"
+#include "profile.hpp"
+#include "region.hpp"
+#include "ship.hpp"
+#include "trace.hpp"
+#include "word.hpp"
+#include "writeset.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+namespace norec {
+
+struct alignas(CACHE_LINE) state {
+    atomic<uint64_t> seq; // Sequence lock, odd while a transaction publishes its writes
+};
+
+struct read_entry {
+    byte const* location; // Read word in shared memory
+    size_t offset;        // Offset of the value read in 'values'
+};
+
+/** Transaction descriptor, on lines of its own so that the descriptors of different threads never share one.
+**/
+struct alignas(CACHE_LINE) transaction {
+    struct region* region;
+    size_t slot;       // Epoch table slot
+    uint64_t snapshot; // Value of the sequence lock the reads are consistent with
+    bool is_ro;
+    bool logged; // Whether the reads are logged, to validate them by value
+    vector<struct read_entry> reads;
+    vector<byte> values;
+    struct write_set writes;
+    vector<struct segment*> allocs;
+    vector<struct segment*> frees;
+};
+
+//================================================================
+//Helper functions
+//================================================================
+
+/** Wait for the sequence lock to be free.
+ * @param st Engine state
+ * @return Value of the free sequence lock
+**/
+static uint64_t wait_free(struct state* st) {
+    uint64_t time = st->seq.load(memory_order_acquire);
+    while (time & 1){
+        sched_yield();
+        time = st->seq.load(memory_order_acquire);
+    }
+    return time;
+}
+
+/** Check every value read by the transaction is still in memory, and move its snapshot forward.
+ * @param st    Engine state
+ * @param trans Transaction to validate
+ * @return Whether the read set is still valid
+**/
+static bool validate(struct state* st, struct transaction* trans) {
+    PROFILE(PROFILE_LOCK);
+    size_t align = trans->region->align;
+    while (true){
+        uint64_t time = wait_free(st);
+        for (auto const& read : trans->reads){
+            if (!word_equal(read.location, trans->values.data() + read.offset, align)){
+                HEATMAP(trans->region, NULL, read.location, HEATMAP_NO_STRIPE);
+                return false;
+            }
+        }
+        atomic_thread_fence(memory_order_acquire);
+        //nobody published meanwhile, the values were all there at 'time'
+        if (st->seq.load(memory_order_relaxed) == time){
+            trans->snapshot = time;
+            counter_add(trans->region->counters[trans->slot].extensions, 1);
+            return true;
+        }
+    }
+}
+
+/** Descriptor kept between transactions by each thread, or by each CPU with USE_RSEQ, so that its vectors keep their capacity.
+**/
+static percpu_spare<struct transaction> spare;
+
+/** Read-only transactions of the thread left to log their reads, see TM_RO_LOGGED.
+**/
+static thread_local size_t ro_logged = 0;
+
+/** Get the bytes a descriptor holds, the unused capacity of its vectors included.
+ * @param trans Transaction descriptor
+ * @return Size (in bytes)
+**/
+static size_t footprint(struct transaction const* trans){
+    return sizeof(*trans) + trans->reads.capacity() * sizeof(struct read_entry) + trans->values.capacity() + writeset_footprint(&trans->writes)
+        + (trans->allocs.capacity() + trans->frees.capacity()) * sizeof(struct segment*);
+}
+
+/** Release the epoch slot of the transaction and recycle its descriptor.
+ * @param trans Transaction to finish
+**/
+static void finish(struct transaction* trans){
+    trans->region->counters[trans->slot].descriptor.store(footprint(trans), memory_order_relaxed);
+    epoch_exit(trans->region, trans->slot);
+    trans->reads.clear();
+    trans->values.clear();
+    writeset_clear(&trans->writes);
+    trans->allocs.clear();
+    trans->frees.clear();
+    if (!spare.keep(trans)){
+        delete trans;
+    }
+}
+
+/** Undo what a transaction did and release its descriptor.
+ * @param tx     Transaction to abort
+ * @param reason Reason of the abort, one of 'TM_ABORT_*'
+**/
+static void rollback(tx_t tx, int reason){
+    PROFILE(PROFILE_ROLLBACK);
+    struct transaction* trans = (struct transaction*) tx;
+    counter_add(trans->region->counters[trans->slot].aborts[reason], 1);
+    TRACE_REASON(reason);
+    //rolling back allocs, nothing was published
+    for (auto seg : trans->allocs){
+        segment_destroy(seg);
+    }
+    //the retry likely writes the same words
+    for (auto const& entry : trans->writes.entries){
+        cm_predict(&trans->region->cm, entry.location);
+    }
+    cm_abort(&trans->region->cm, trans->reads.size() + trans->writes.entries.size());
+    finish(trans);
+}
+
+//================================================================
+// End of Helper functions
+//================================================================
+
+bool create(shared_t shared) noexcept {
+    struct state* st = new (std::nothrow) struct state();
+    if (unlikely(st == NULL)){
+        return false;
+    }
+    st->seq.store(0, memory_order_relaxed);
+    ((struct region*) shared)->engine = st;
+    return true;
+}
+
+void destroy(shared_t shared) noexcept {
+    delete (struct state*) ((struct region*) shared)->engine;
+}
+
+tx_t begin(shared_t shared, bool is_ro) noexcept {
+    struct region* region = (struct region*) shared;
+    struct transaction* trans = spare.take();
+    if (unlikely(trans == NULL)){
+        trans = new (std::nothrow) struct transaction();
+        if (unlikely(trans == NULL)){
+            return invalid_tx;
+        }
+    }
+    trans->region = region;
+    cm_begin(&region->cm);
+    trans->is_ro = is_ro;
+    trans->logged = !is_ro || ro_logged > 0;
+    if (is_ro && ro_logged > 0){
+        --ro_logged;
+    }
+    //announce before taking the snapshot, so that what it reaches stays allocated
+    trans->slot = epoch_enter(region);
+    trans->snapshot = wait_free((struct state*) region->engine);
+    return (tx_t) trans;
+}
+
+bool end(shared_t shared, tx_t tx) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    struct transaction* trans = (struct transaction*) tx;
+
+    //every read was consistent with the snapshot, nothing to publish
+    if (trans->is_ro || (trans->writes.entries.empty() && trans->frees.empty())){
+        for (auto seg : trans->allocs){
+            segment_register(region, seg);
+        }
+        cm_commit(&region->cm);
+        counter_add(region->counters[trans->slot].commits, 1);
+        finish(trans);
+        return true;
+    }
+
+    //take the sequence lock, provided the reads are still valid
+    cm_yield(&region->cm);
+    uint64_t time = trans->snapshot;
+    while (!st->seq.compare_exchange_strong(time, time + 1, memory_order_acquire, memory_order_relaxed)){
+        if (!validate(st, trans)){
+            rollback(tx, TM_ABORT_VALIDATE);
+            return false;
+        }
+        time = trans->snapshot;
+    }
+
+    //nobody else publishes until the sequence lock is released, the log follows the commit order
+    if (unlikely(region->persist != NULL) && !persist_commit(region, &trans->writes)){
+        st->seq.store(time, memory_order_release);
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    if (unlikely(region->ship != NULL)){
+        ship_commit(region, &trans->writes);
+    }
+    writeset_publish(&trans->writes, region->align, region->stream);
+    for (auto seg : trans->allocs){
+        segment_register(region, seg);
+    }
+    for (auto seg : trans->frees){
+        segment_unregister(region, seg);
+        segment_retire(region, seg);
+    }
+    st->seq.store(time + 2, memory_order_release);
+    cm_commit(&region->cm);
+    counter_add(region->counters[trans->slot].commits, 1);
+    finish(trans);
+    return true;
+}
+
+bool read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    struct transaction* trans = (struct transaction*) tx;
+    size_t align = region->align;
+
+    counter_add(region->counters[trans->slot].reads, 1);
+    if (segment_captured(trans->allocs, source, size)){
+        words_copy(target, source, size, align);
+        return true;
+    }
+    for (size_t i = 0; i < size; i += align){
+        byte const* src = (byte const*) source + i;
+        byte* dst = (byte*) target + i;
+        struct write_entry* written = NULL;
+        if (!trans->is_ro){
+            //read-after-write, return the buffered value
+            written = writeset_find(&trans->writes, src);
+            if (written != NULL && !written->delta){
+                word_copy(dst, trans->writes.data.data() + written->offset, align);
+                continue;
+            }
+        }
+        word_copy(dst, src, align);
+        atomic_thread_fence(memory_order_acquire);
+        if (!trans->logged){
+            //nothing to validate by value, only a snapshot still current keeps the reads consistent
+            if (unlikely(st->seq.load(memory_order_relaxed) != trans->snapshot)){
+                ro_logged = TM_RO_LOGGED;
+                rollback(tx, TM_ABORT_READ);
+                return false;
+            }
+            continue;
+        }
+        //somebody committed, the value is only good if the snapshot can be moved forward
+        while (st->seq.load(memory_order_relaxed) != trans->snapshot){
+            if (!validate(st, trans)){
+                rollback(tx, TM_ABORT_READ);
+                return false;
+            }
+            word_copy(dst, src, align);
+            atomic_thread_fence(memory_order_acquire);
+        }
+        {
+            PROFILE(PROFILE_LOG);
+            trans->reads.push_back({src, trans->values.size()});
+            trans->values.insert(trans->values.end(), dst, dst + align);
+        }
+        if (written != NULL){
+            //incremented before, the increment now depends on the value read
+            writeset_fold(&trans->writes, written, dst, align);
+        }
+    }
+    return true;
+}
+
+bool write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    size_t align = region->align;
+    struct transaction* trans = (struct transaction*) tx;
+
+    counter_add(region->counters[trans->slot].writes, 1);
+    if (segment_captured(trans->allocs, target, size)){
+        words_copy(target, source, size, align);
+        return true;
+    }
+    for (size_t i = 0; i < size; i += align){
+        writeset_add(&trans->writes, (byte*) target + i, (byte const*) source + i, align);
+    }
+    return true;
+}
+
+bool add(shared_t shared, tx_t tx, void* target, int64_t delta) noexcept {
+    struct region* region = (struct region*) shared;
+    struct transaction* trans = (struct transaction*) tx;
+
+    //no read, the increment applies to the value in memory at commit, under the sequence lock
+    counter_add(region->counters[trans->slot].writes, 1);
+    if (segment_captured(trans->allocs, target, region->align)){
+        word_add(target, delta);
+        return true;
+    }
+    writeset_add_delta(&trans->writes, (byte*) target, delta, region->align);
+    return true;
+}
+
+void release(shared_t shared, tx_t tx, void const* source, size_t size) noexcept {
+    struct transaction* trans = (struct transaction*) tx;
+    size_t align = ((struct region*) shared)->align;
+
+    for (size_t i = 0; i < size; i += align){
+        byte const* src = (byte const*) source + i;
+        //the logged value stays in 'values', unreferenced
+        for (size_t j = trans->reads.size(); j-- > 0;){
+            if (trans->reads[j].location == src){
+                trans->reads[j] = trans->reads.back();
+                trans->reads.pop_back();
+                break;
+            }
+        }
+    }
+}
+
+Alloc alloc(shared_t shared, tx_t tx, size_t size, void** target) noexcept {
+    struct segment* seg = segment_create((struct region*) shared, size);
+    if (unlikely(seg == NULL)){
+        return Alloc::nomem;
+    }
+    //private until commit, registered only if the transaction commits
+    struct transaction* trans = (struct transaction*) tx;
+    trans->allocs.push_back(seg);
+    counter_add(trans->region->counters[trans->slot].allocs, 1);
+    *target = (void*) seg->mem;
+    return Alloc::success;
+}
+
+bool dealloc(shared_t shared, tx_t tx, void* target) noexcept {
+    struct transaction* trans = (struct transaction*) tx;
+    for (auto it = trans->allocs.begin(); it != trans->allocs.end(); ++it){
+        //allocated by this very transaction, nobody else can see it
+        if ((*it)->mem == target){
+            segment_destroy(*it);
+            trans->allocs.erase(it);
+            counter_add(trans->region->counters[trans->slot].frees, 1);
+            return true;
+        }
+    }
+    struct segment* seg = segment_find((struct region*) shared, target);
+    if (seg == NULL || seg->mem != target){
+        //not the start of a live segment (e.g. freed concurrently), abort
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    counter_add(trans->region->counters[trans->slot].frees, 1);
+    for (auto other : trans->frees){
+        if (other == seg){
+            return true;
+        }
+    }
+    trans->frees.push_back(seg);
+    return true;
+}
+
+/** Allocate the descriptor of the calling thread ahead of its first transaction, on its NUMA node.
+ * @param shared Region the thread entered
+**/
+void thread_enter(shared_t shared as(unused)) noexcept {
+    spare.prepare();
+}
+
+/** Free the descriptor the calling thread kept between its transactions.
+ * @param shared Region the thread leaves
+**/
+void thread_leave(shared_t shared as(unused)) noexcept {
+    spare.drop();
+}
+
+}
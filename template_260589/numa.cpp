@@ -0,0 +1,125 @@
+/**
+ * @file   numa.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * NUMA placement helpers, empty unless built with USE_NUMA.
+**/
+
+// Internal headers
+#include "numa.hpp"
+
+#ifdef USE_NUMA
+
+// External headers
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Memory policies of 'mbind', as in <numaif.h>
+#define NUMA_MPOL_BIND       2
+#define NUMA_MPOL_INTERLEAVE 3
+
+// Number of calls to 'numa_node' between two lookups of the node of the thread
+#define NUMA_NODE_REFRESH 1024
+
+/** Count the nodes of the machine, once.
+ * @return Number of nodes to place on, 1 if placement is disabled
+**/
+size_t numa_nodes() noexcept {
+    static size_t const nodes = []() -> size_t {
+        char const* env = getenv("TM_NUMA");
+        if (env != NULL && strcmp(env, "0") == 0){
+            return 1;
+        }
+        //e.g. "0-1", the last number is the highest node
+        FILE* file = fopen("/sys/devices/system/node/online", "r");
+        if (file == NULL){
+            return 1;
+        }
+        char line[256];
+        size_t count = 1;
+        if (fgets(line, sizeof(line), file) != NULL){
+            char const* last = line;
+            for (char const* c = line; *c != '\0'; ++c){
+                if (*c == '-' || *c == ','){
+                    last = c + 1;
+                }
+            }
+            count = (size_t) strtoul(last, NULL, 10) + 1;
+        }
+        fclose(file);
+        return count < NUMA_MAX_NODES ? count : NUMA_MAX_NODES;
+    }();
+    return nodes;
+}
+
+/** [thread-safe] Get the node the calling thread runs on, looked up again every now and then.
+ * @return Node, less than 'numa_nodes()'
+**/
+size_t numa_node() noexcept {
+    thread_local size_t node = 0;
+    thread_local size_t countdown = 0;
+    if (unlikely(countdown == 0)){
+        unsigned int cpu, current;
+        if (numa_nodes() > 1 && getcpu(&cpu, &current) == 0){
+            node = current % numa_nodes();
+        }
+        countdown = NUMA_NODE_REFRESH;
+    }
+    --countdown;
+    return node;
+}
+
+/** Apply a memory policy to the whole pages of a range, before they are first touched.
+ * @param addr   Start of the range
+ * @param size   Size of the range (in bytes)
+ * @param policy One of 'NUMA_MPOL_*'
+ * @param mask   Bit mask of the nodes
+**/
+static void numa_policy(void* addr, size_t size, int policy, unsigned long mask) noexcept {
+    uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t) addr + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t) addr + size) & ~(page - 1);
+    if (end <= start){
+        return;
+    }
+    //best effort, the memory is simply left where the kernel puts it on failure
+    syscall(SYS_mbind, (void*) start, end - start, policy, &mask, sizeof(mask) * 8, 0);
+}
+
+/** Spread the pages of a range over every node, for memory every thread accesses.
+ * @param addr Start of the range
+ * @param size Size of the range (in bytes)
+**/
+void numa_interleave(void* addr, size_t size) noexcept {
+    if (numa_nodes() > 1){
+        numa_policy(addr, size, NUMA_MPOL_INTERLEAVE, (1ul << numa_nodes()) - 1);
+    }
+}
+
+/** Place the pages of a range on one node.
+ * @param addr Start of the range
+ * @param size Size of the range (in bytes)
+ * @param node Node to place the pages on
+**/
+void numa_bind(void* addr, size_t size, size_t node) noexcept {
+    if (numa_nodes() > 1){
+        numa_policy(addr, size, NUMA_MPOL_BIND, 1ul << node);
+    }
+}
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * @file   numa.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * NUMA placement helpers, only active with USE_NUMA on a machine with more
+ * than one node ('TM_NUMA=0' disables them at runtime). Memory is placed
+ * with the 'mbind' system call, so that no library is needed.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Maximum number of nodes told apart, further nodes are folded onto these
+#define NUMA_MAX_NODES 8
+
+/** Accesses of one region by locality of the segment, only counted with USE_NUMA_STATS.
+**/
+struct numa_stats {
+    std::atomic<uint64_t> local;       // Segment placed on the node of the accessing thread
+    std::atomic<uint64_t> remote;      // Segment placed on another node
+    std::atomic<uint64_t> interleaved; // Segment spread over every node
+};
+
+#ifdef USE_NUMA
+
+size_t numa_nodes() noexcept;
+size_t numa_node() noexcept;
+void numa_interleave(void*, size_t) noexcept;
+void numa_bind(void*, size_t, size_t) noexcept;
+
+#else
+
+static inline size_t numa_nodes() noexcept {
+    return 1;
+}
+static inline size_t numa_node() noexcept {
+    return 0;
+}
+static inline void numa_interleave(void*, size_t) noexcept {}
+static inline void numa_bind(void*, size_t, size_t) noexcept {}
+
+#endif
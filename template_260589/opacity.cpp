@@ -0,0 +1,145 @@
+/**
+ * @file   opacity.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Sampled opacity log, empty unless built with USE_OPACITY_LOG. A log is only
+ * written by its thread and stops taking samples once full, the dump is meant
+ * to run once every thread stopped running transactions.
+**/
+
+// Internal headers
+#include "common.hpp"
+#include "opacity.hpp"
+
+#ifdef USE_OPACITY_LOG
+
+// External headers
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// One transaction in that many is sampled on average, per thread
+#ifndef OPACITY_SAMPLE_RATE
+    #define OPACITY_SAMPLE_RATE 64
+#endif
+
+// Log2 of the number of records kept per thread
+#ifndef OPACITY_LOG_LOG2
+    #define OPACITY_LOG_LOG2 18
+#endif
+
+// Room a sample is expected to need, none taken with less left
+#define OPACITY_ROOM 256
+
+/** Records of one thread, never freed so that they outlive the thread.
+**/
+struct opacity_buffer {
+    struct opacity_buffer* next;
+    uint64_t thread;
+    uint64_t random;          // State of the sampling generator
+    uint64_t samples;         // Number of samples taken
+    atomic<uint64_t> dropped; // Samples not taken for lack of room
+    atomic<uint64_t> head;    // Number of records written
+    struct opacity_record records[1ul << OPACITY_LOG_LOG2];
+};
+
+static atomic<struct opacity_buffer*> buffers{NULL};
+static atomic<uint64_t> threads{0};
+static thread_local struct opacity_buffer* own = NULL;
+
+/** Get the log of the calling thread, creating it on first use.
+ * @return Log of the thread, NULL if out of memory
+**/
+static struct opacity_buffer* own_log() {
+    if (likely(own != NULL)){
+        return own;
+    }
+    struct opacity_buffer* fresh = (struct opacity_buffer*) calloc(1, sizeof(struct opacity_buffer));
+    if (unlikely(fresh == NULL)){
+        return NULL;
+    }
+    fresh->thread = threads.fetch_add(1, memory_order_relaxed);
+    //distinct sequences per thread, never zero
+    fresh->random = (fresh->thread + 1) * UINT64_C(0x9e3779b97f4a7c15);
+    fresh->next = buffers.load(memory_order_relaxed);
+    while (!buffers.compare_exchange_weak(fresh->next, fresh, memory_order_release, memory_order_relaxed));
+    own = fresh;
+    return own;
+}
+
+/** [thread-safe] Decide whether a beginning transaction of the calling thread is sampled, see 'OPACITY_SAMPLE'.
+ * @param rv Snapshot at begin
+ * @return Identifier of the sample, 0 if not sampled
+**/
+uint64_t opacity_sample(uint64_t rv) noexcept {
+    struct opacity_buffer* log = own_log();
+    if (unlikely(log == NULL)){
+        return 0;
+    }
+    //random rather than periodic, so as not to lock step with the workload
+    log->random ^= log->random << 13;
+    log->random ^= log->random >> 7;
+    log->random ^= log->random << 17;
+    if (log->random % OPACITY_SAMPLE_RATE != 0){
+        return 0;
+    }
+    if (log->head.load(memory_order_relaxed) + OPACITY_ROOM > (1ul << OPACITY_LOG_LOG2)){
+        log->dropped.store(log->dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        return 0;
+    }
+    uint64_t tx = ((log->thread + 1) << 40) | ++log->samples;
+    opacity_log(tx, OPACITY_BEGIN, NULL, rv);
+    return tx;
+}
+
+/** [thread-safe] Append an event to the log of the calling thread, see 'OPACITY'.
+ * @param tx      Identifier of the sample
+ * @param event   One of 'OPACITY_*'
+ * @param address Shared memory word of the event, if any
+ * @param version Event-specific version
+**/
+void opacity_log(uint64_t tx, uint64_t event, void const* address, uint64_t version) noexcept {
+    struct opacity_buffer* log = own_log();
+    if (unlikely(log == NULL)){
+        return;
+    }
+    uint64_t head = log->head.load(memory_order_relaxed);
+    if (unlikely(head >= (1ul << OPACITY_LOG_LOG2))){
+        //an incomplete sample is left out by the checker
+        return;
+    }
+    log->records[head] = {tx, (uint64_t) (uintptr_t) address, version, event};
+    log->head.store(head + 1, memory_order_release);
+}
+
+/** Write the records of every thread to a file.
+ * @param path Path of the file to (over)write
+**/
+void opacity_dump(char const* path) noexcept {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL){
+        fprintf(stderr, "opacity: cannot open '%s'\n", path);
+        return;
+    }
+    struct opacity_header header = {OPACITY_MAGIC, sizeof(struct opacity_record)};
+    fwrite(&header, sizeof(header), 1, file);
+    for (struct opacity_buffer* it = buffers.load(memory_order_acquire); it != NULL; it = it->next){
+        uint64_t head = it->head.load(memory_order_acquire);
+        struct opacity_chunk chunk = {it->thread, head, it->dropped.load(memory_order_relaxed)};
+        fwrite(&chunk, sizeof(chunk), 1, file);
+        fwrite(it->records, sizeof(struct opacity_record), head, file);
+    }
+    fclose(file);
+}
+
+#endif
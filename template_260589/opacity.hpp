@@ -0,0 +1,96 @@
+/**
+ * @file   opacity.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Sampled opacity log, only compiled in with USE_OPACITY_LOG. One transaction
+ * in OPACITY_SAMPLE_RATE per thread records the versions it read, its snapshot and
+ * what it wrote at which version; the logs are written to the file named by
+ * 'TM_OPACITY' when a region is destroyed, and 'tools/opacity_check' looks
+ * for a read some sampled commit overwrote before the snapshot of the reader.
+ * Only tl2 records, the other engines having no version per word.
+**/
+
+#pragma once
+
+// External headers
+#include <cstdint>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Events, stored in 'opacity_record::event'
+#define OPACITY_BEGIN  0 // 'version' is the snapshot at begin
+#define OPACITY_READ   1 // 'version' is the one of the word read
+#define OPACITY_WRITE  2 // 'version' is the write version of the commit
+#define OPACITY_COMMIT 3 // 'version' is the snapshot every read belongs to
+#define OPACITY_ABORT  4 // 'version' is the snapshot every read belongs to
+
+// Magic number at the start of an opacity log file
+#define OPACITY_MAGIC UINT64_C(0x31544341504f4d54) // "TMOPACT1"
+
+/** One event, as written in the log file.
+**/
+struct opacity_record {
+    uint64_t tx;      // Sampled transaction, unique over the threads
+    uint64_t address; // Shared memory word read or written
+    uint64_t version;
+    uint64_t event;
+};
+
+/** Log file header, followed by the chunks of every thread.
+**/
+struct opacity_header {
+    uint64_t magic;
+    uint64_t record_size; // Size of 'struct opacity_record'
+};
+
+/** Header of the records of one thread, in order.
+**/
+struct opacity_chunk {
+    uint64_t thread;  // Thread number, in order of first sample
+    uint64_t count;   // Number of records that follow
+    uint64_t dropped; // Samples not taken once the log of the thread was full
+};
+
+#ifdef USE_OPACITY_LOG
+
+uint64_t opacity_sample(uint64_t) noexcept;
+void opacity_log(uint64_t, uint64_t, void const*, uint64_t) noexcept;
+void opacity_dump(char const*) noexcept;
+
+/** Decide whether a beginning transaction is sampled, recording its snapshot if so.
+ * @param rv Snapshot at begin
+ * @return Identifier of the sample, 0 if not sampled
+**/
+#define OPACITY_SAMPLE(rv) \
+    opacity_sample((rv))
+
+/** Record an event of a sampled transaction.
+ * @param tx      Identifier of the sample, nothing recorded if 0
+ * @param event   One of 'OPACITY_*'
+ * @param address Shared memory word of the event, if any
+ * @param version Event-specific version
+**/
+#define OPACITY(tx, event, address, version) \
+    do { \
+        if (unlikely((tx) != 0)){ \
+            opacity_log((tx), (event), (address), (version)); \
+        } \
+    } while (0)
+
+#else
+
+#define OPACITY_SAMPLE(rv) \
+    ((void) (rv), UINT64_C(0))
+#define OPACITY(tx, event, address, version) \
+    do {} while (0)
+
+#endif
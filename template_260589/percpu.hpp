@@ -0,0 +1,158 @@
+/**
+ * @file   percpu.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Per-CPU slots, with USE_RSEQ. The CPU a thread runs on is read from the
+ * restartable sequences area the C library registers for every thread (a
+ * plain load, no system call), so that caches and counters are indexed by
+ * CPU rather than by thread: their memory does not grow with the threads, and
+ * short-lived threads find what the previous ones left on their CPU. A thread
+ * can be preempted or migrated while it uses the slot of a CPU, so the slots
+ * are only ever taken with an atomic exchange or a try-lock, the rare thread
+ * that misses going the slow way instead of restarting. Without the area
+ * (older C library or kernel, or 'glibc.pthread.rseq=0'), or on a CPU past
+ * PERCPU_MAX, 'percpu_cpu' is -1 and the callers keep their thread-local
+ * storage.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#if defined(USE_RSEQ) && __has_include(<sys/rseq.h>)
+    #include <sys/rseq.h>
+    #define PERCPU_RSEQ
+#endif
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// CPUs with slots of their own, the threads on further CPUs use thread-local storage
+#define PERCPU_MAX 256
+
+/** Get the CPU the calling thread runs on, which may change right after.
+ * @return CPU, -1 if unknown or past PERCPU_MAX
+**/
+static inline int percpu_cpu() noexcept {
+#ifdef PERCPU_RSEQ
+    if (unlikely(__rseq_size == 0)){
+        return -1;
+    }
+    struct rseq const* area = (struct rseq const*) ((char const*) __builtin_thread_pointer() + __rseq_offset);
+    //'RSEQ_CPU_ID_UNINITIALIZED' is past the bound too
+    uint32_t cpu = __atomic_load_n(&area->cpu_id, __ATOMIC_RELAXED);
+    return cpu < PERCPU_MAX ? (int) cpu : -1;
+#else
+    return -1;
+#endif
+}
+
+/** Object kept between two uses, e.g. a transaction descriptor, per CPU with USE_RSEQ and per thread otherwise.
+ * @param Type Kept object, default-constructible
+**/
+template<class Type> class percpu_spare {
+private:
+    struct alignas(CACHE_LINE) slot {
+        std::atomic<Type*> object;
+    };
+    static thread_local std::unique_ptr<Type> own; // Object of the calling thread, when its CPU is unknown
+#ifdef PERCPU_RSEQ
+    struct slot slots[PERCPU_MAX] = {};
+#endif
+public:
+#ifdef PERCPU_RSEQ
+    ~percpu_spare() {
+        for (auto& slot : slots){
+            delete slot.object.load(std::memory_order_relaxed);
+        }
+    }
+#endif
+    /** [thread-safe] Take the object kept on the CPU of the calling thread, or by the thread.
+     * @return Kept object, NULL if none
+    **/
+    Type* take() noexcept {
+#ifdef PERCPU_RSEQ
+        int cpu = percpu_cpu();
+        if (cpu >= 0){
+            Type* object = slots[cpu].object.exchange(NULL, std::memory_order_acquire);
+            if (object != NULL){
+                return object;
+            }
+        }
+#endif
+        return own.release();
+    }
+    /** [thread-safe] Keep an object on the CPU of the calling thread, or for the thread.
+     * @param object Object to keep
+     * @return Whether it was kept, otherwise one already was and the caller still owns it
+    **/
+    bool keep(Type* object) noexcept {
+#ifdef PERCPU_RSEQ
+        int cpu = percpu_cpu();
+        if (cpu >= 0){
+            Type* expected = NULL;
+            if (slots[cpu].object.compare_exchange_strong(expected, object, std::memory_order_release, std::memory_order_relaxed)){
+                return true;
+            }
+        }
+#endif
+        if (own != nullptr){
+            return false;
+        }
+        own.reset(object);
+        return true;
+    }
+    /** [thread-safe] Create the object of the calling thread ahead of its first use, unless its CPU already keeps one.
+    **/
+    void prepare() noexcept {
+#ifdef PERCPU_RSEQ
+        int cpu = percpu_cpu();
+        if (cpu >= 0 && slots[cpu].object.load(std::memory_order_relaxed) != NULL){
+            return;
+        }
+#endif
+        if (own == nullptr){
+            own.reset(new (std::nothrow) Type());
+        }
+    }
+    /** [thread-safe] Free the object of the calling thread, those of the CPUs staying for the next threads.
+    **/
+    void drop() noexcept {
+        own.reset();
+    }
+};
+
+template<class Type> thread_local std::unique_ptr<Type> percpu_spare<Type>::own;
+
+/** Lock of a per-CPU slot, only ever tried: a thread failing to take it goes the slow way.
+**/
+struct alignas(CACHE_LINE) percpu_lock {
+    std::atomic<bool> taken;
+};
+
+/** [thread-safe] Try to take a per-CPU lock.
+ * @param lock Lock to take
+ * @return Whether it was taken
+**/
+static inline bool percpu_try(struct percpu_lock* lock) noexcept {
+    return !lock->taken.load(std::memory_order_relaxed) && !lock->taken.exchange(true, std::memory_order_acquire);
+}
+
+/** [thread-safe] Release a per-CPU lock.
+ * @param lock Lock to release
+**/
+static inline void percpu_release(struct percpu_lock* lock) noexcept {
+    lock->taken.store(false, std::memory_order_release);
+}
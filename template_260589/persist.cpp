@@ -0,0 +1,336 @@
+/**
+ * @file   persist.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * File mapping, redo log, recovery and checkpoints of the durable regions.
+ * The file holds a header page, then the block of the first segment (its
+ * header, rebuilt at each opening, and its memory), then the log.
+**/
+
+// External headers
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef USE_CLWB
+#include <immintrin.h>
+#endif
+
+// Internal headers
+#include "common.hpp"
+#include "persist.hpp"
+#include "region.hpp"
+#include "word.hpp"
+#include "writeset.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Tells the files of durable regions apart
+#define PERSIST_MAGIC UINT64_C(0x31786d74786d7470)
+
+/** First page of the file.
+**/
+struct persist_header {
+    uint64_t magic;
+    uint64_t size;       // Size of the first segment
+    uint64_t align;      // Alignment of the region
+    uint64_t log_size;   // Size of the log
+    uint64_t generation; // Generation of the groups in the log, the older ones are in the segment already
+};
+
+/** Group of redo records of one commit, the records follow it.
+ * Each record is the offset of a word in the segment, then its new content, padded to 8 bytes.
+**/
+struct persist_group {
+    uint64_t generation; // Generation of the log when the group was written
+    uint64_t size;       // Length of the records
+    uint64_t checksum;   // Of the fields above and of the records, a torn group does not match
+};
+
+//================================================================
+//Helper functions
+//================================================================
+
+/** Get the length of one redo record.
+ * @param align Size of a word
+ * @return Length of a record, a multiple of 8
+**/
+static inline size_t record_size(size_t align) {
+    return (sizeof(uint64_t) + align + 7) & ~static_cast<size_t>(7);
+}
+
+/** Compute the checksum of a group, FNV-1a over its fields and records.
+ * @param group Group with 'generation' and 'size' set, followed by its records
+ * @return Checksum
+**/
+static uint64_t group_checksum(struct persist_group const* group) {
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    auto mix = [&hash](byte const* bytes, size_t length) {
+        for (size_t i = 0; i < length; ++i){
+            hash = (hash ^ (uint64_t) bytes[i]) * UINT64_C(0x100000001b3);
+        }
+    };
+    mix((byte const*) &group->generation, sizeof(group->generation));
+    mix((byte const*) &group->size, sizeof(group->size));
+    mix((byte const*) (group + 1), group->size);
+    return hash;
+}
+
+/** Make a range of the mapping durable.
+ * @param addr Start of the range
+ * @param size Length of the range
+**/
+#ifdef USE_CLWB
+__attribute__((target("clwb"))) static void persist_flush(void const* addr, size_t size) {
+    for (uintptr_t line = ((uintptr_t) addr) & ~(uintptr_t) (CACHE_LINE - 1); line < (uintptr_t) addr + size; line += CACHE_LINE){
+        _mm_clwb((void*) line);
+    }
+    _mm_sfence();
+}
+#else
+static void persist_flush(void const* addr, size_t size) {
+    uintptr_t page = static_cast<uintptr_t>(1) << SEGMENT_PAGE_LOG2;
+    uintptr_t start = ((uintptr_t) addr) & ~(page - 1);
+    msync((void*) start, (uintptr_t) addr + size - start, MS_SYNC);
+}
+#endif
+
+/** Flush the segment and start a new log generation, with no commit running.
+ * @param p Durable backing
+**/
+static void checkpoint(struct persist* p) {
+    persist_flush(p->data, p->data_size);
+    //the groups of the previous generation stop being replayed, the segment holds their writes
+    ++p->header->generation;
+    persist_flush(p->header, sizeof(struct persist_header));
+    p->reserved.store(0, memory_order_relaxed);
+    p->durable.store(0, memory_order_relaxed);
+    p->full.store(false, memory_order_relaxed);
+}
+
+/** Replay the complete groups of the current generation, in log order.
+ * @param p     Durable backing, just mapped
+ * @param align Size of a word
+**/
+static void recover(struct persist* p, size_t align) {
+    size_t record = record_size(align);
+    size_t offset = 0;
+    while (offset + sizeof(struct persist_group) <= p->log_size){
+        struct persist_group const* group = (struct persist_group const*) (p->log + offset);
+        size_t room = p->log_size - offset - sizeof(struct persist_group);
+        //commits are durable in log order, the first invalid group ends the log
+        if (group->generation != p->header->generation || group->size == 0 || group->size > room || group->size % record != 0 || group->checksum != group_checksum(group)){
+            break;
+        }
+        for (byte const* rec = (byte const*) (group + 1); rec < (byte const*) (group + 1) + group->size; rec += record){
+            uint64_t location;
+            memcpy(&location, rec, sizeof(location));
+            if (location + align <= p->data_size){
+                memcpy(p->data + location, rec + sizeof(location), align);
+            }
+        }
+        offset += sizeof(struct persist_group) + group->size;
+    }
+}
+
+//================================================================
+// End of Helper functions
+//================================================================
+
+/** Map the first segment of a region from a file, creating the file or recovering its content.
+ * @param region Region being created, with its alignment set
+ * @param path   File holding the region
+ * @param size   Size of the first segment, the one of the file if it exists
+ * @return First segment, not registered yet, NULL on failure (e.g. a file of another size or alignment)
+**/
+struct segment* persist_open(struct region* region, char const* path, size_t size) noexcept {
+    size_t page = static_cast<size_t>(1) << SEGMENT_PAGE_LOG2;
+    size_t align = region->align < sizeof(void*) ? sizeof(void*) : region->align;
+    //the memory follows its header in a page-aligned block
+    if (unlikely(align > page)){
+        return NULL;
+    }
+    size_t header = (sizeof(struct segment) + align - 1) & ~(align - 1);
+    size_t block = (header + size + page - 1) & ~(page - 1);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (unlikely(fd < 0)){
+        return NULL;
+    }
+    struct stat info;
+    struct persist_header existing;
+    bool fresh = fstat(fd, &info) == 0 && info.st_size == 0;
+    size_t log_size = TM_PERSIST_LOG;
+    if (fresh){
+        char const* env = getenv("TM_PERSIST_LOG");
+        if (env != NULL && strtoul(env, NULL, 0) > 0){
+            log_size = strtoul(env, NULL, 0);
+        }
+        log_size = (log_size + page - 1) & ~(page - 1);
+    } else if (pread(fd, &existing, sizeof(existing), 0) != (ssize_t) sizeof(existing) || existing.magic != PERSIST_MAGIC || existing.size != size || existing.align != region->align){
+        close(fd);
+        return NULL;
+    } else {
+        log_size = existing.log_size;
+    }
+    size_t map_size = page + block + log_size;
+    if (unlikely(fresh ? ftruncate(fd, map_size) != 0 : (size_t) info.st_size != map_size)){
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (unlikely(map == MAP_FAILED)){
+        close(fd);
+        return NULL;
+    }
+    struct persist* p = new (std::nothrow) struct persist();
+    struct segment* seg = p == NULL ? NULL : segment_adopt(region, (byte*) map + page, (byte*) map + page + header, size);
+    if (unlikely(seg == NULL)){
+        delete p;
+        munmap(map, map_size);
+        close(fd);
+        return NULL;
+    }
+    p->fd = fd;
+    p->map = (byte*) map;
+    p->map_size = map_size;
+    p->header = (struct persist_header*) map;
+    p->data = seg->mem;
+    p->data_size = size;
+    p->log = (byte*) map + page + block;
+    p->log_size = log_size;
+    if (fresh){
+        //the file is zeroed, only the header is needed
+        p->header->magic = PERSIST_MAGIC;
+        p->header->size = size;
+        p->header->align = region->align;
+        p->header->log_size = log_size;
+        p->header->generation = 1;
+        persist_flush(p->header, sizeof(struct persist_header));
+        p->reserved.store(0, memory_order_relaxed);
+        p->durable.store(0, memory_order_relaxed);
+        p->full.store(false, memory_order_relaxed);
+    } else {
+        recover(p, region->align);
+        checkpoint(p);
+    }
+    region->persist = p;
+    return seg;
+}
+
+/** Checkpoint and unmap the file of a region, with no running transaction and the first segment destroyed.
+ * @param region Durable region
+**/
+void persist_close(struct region* region) noexcept {
+    struct persist* p = region->persist;
+    checkpoint(p);
+    munmap(p->map, p->map_size);
+    close(p->fd);
+    delete p;
+    region->persist = NULL;
+}
+
+/** [thread-safe] Make the writes of committing transactions durable, before they are published in place, with a single log group.
+ * The transactions must hold what keeps the written words from changing, e.g. their locks, and write disjoint words.
+ * @param region Durable region
+ * @param sets   Write sets about to be published, words outside of the first segment are not logged
+ * @param count  Number of write sets
+ * @return Whether the writes are durable, otherwise the log is full and the transactions must abort
+**/
+bool persist_commit_batch(struct region* region, struct write_set* const* sets, size_t count) noexcept {
+    struct persist* p = region->persist;
+    size_t align = region->align;
+    size_t record = record_size(align);
+    size_t logged = 0;
+    for (size_t i = 0; i < count; ++i){
+        for (auto const& entry : sets[i]->entries){
+            if (entry.location >= p->data && entry.location < p->data + p->data_size){
+                ++logged;
+            }
+        }
+    }
+    if (logged == 0){
+        return true;
+    }
+    size_t need = sizeof(struct persist_group) + logged * record;
+    size_t start = p->reserved.load(memory_order_relaxed);
+    do {
+        if (unlikely(start + need > p->log_size)){
+            //retried after the next checkpoint
+            p->full.store(true, memory_order_relaxed);
+            return false;
+        }
+    } while (!p->reserved.compare_exchange_weak(start, start + need, memory_order_relaxed, memory_order_relaxed));
+    struct persist_group* group = (struct persist_group*) (p->log + start);
+    byte* rec = (byte*) (group + 1);
+    for (size_t i = 0; i < count; ++i){
+        struct write_set* ws = sets[i];
+        for (auto const& entry : ws->entries){
+            if (entry.location < p->data || entry.location >= p->data + p->data_size){
+                continue;
+            }
+            uint64_t location = entry.location - p->data;
+            memset(rec, 0, record);
+            memcpy(rec, &location, sizeof(location));
+            if (entry.delta){
+                //the new content is the one in place plus the increment
+                int64_t delta;
+                memcpy(&delta, ws->data.data() + entry.offset, sizeof(delta));
+                word_copy(rec + sizeof(location), entry.location, align);
+                word_add(rec + sizeof(location), delta);
+            } else {
+                word_copy(rec + sizeof(location), ws->data.data() + entry.offset, align);
+            }
+            rec += record;
+        }
+    }
+    group->generation = p->header->generation;
+    group->size = logged * record;
+    group->checksum = group_checksum(group);
+    persist_flush(group, need);
+    //durable in log order, so that recovery finds every acknowledged commit before the first invalid group
+    while (p->durable.load(memory_order_acquire) != start){
+        sched_yield();
+    }
+    p->durable.store(start + need, memory_order_release);
+    return true;
+}
+
+/** [thread-safe] Make the writes of a committing transaction durable, before they are published in place.
+ * The transaction must hold what keeps the written words from changing, e.g. their locks.
+ * @param region Durable region
+ * @param ws     Write set about to be published, words outside of the first segment are not logged
+ * @return Whether the writes are durable, otherwise the log is full and the transaction must abort
+**/
+bool persist_commit(struct region* region, struct write_set* ws) noexcept {
+    return persist_commit_batch(region, &ws, 1);
+}
+
+/** [thread-safe] Checkpoint a durable region if its log is half full or a commit found it full, unless the region is quiesced by another thread.
+ * @param region Durable region, in which the caller runs no transaction
+**/
+void persist_checkpoint(struct region* region) noexcept {
+    struct persist* p = region->persist;
+    if (likely(!p->full.load(memory_order_relaxed) && p->reserved.load(memory_order_relaxed) < p->log_size / 2)){
+        return;
+    }
+    if (!region_quiesce(region, false)){
+        return;
+    }
+    //every transaction ended, so every reserved group is durable
+    checkpoint(p);
+    region_resume(region);
+}
@@ -0,0 +1,64 @@
+/**
+ * @file   persist.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Durable regions, created by 'tm_create_persistent': the first segment is
+ * mapped from a file, and every commit appends the words it writes there to
+ * a redo log in the same file, flushed before the writes are published in
+ * place (with 'msync', or 'clwb' with USE_CLWB on a DAX mapping). A commit
+ * returns once its log group and every group before it are durable, so the
+ * log is a prefix of complete groups. Opening the file again replays that
+ * prefix, the log being only as long as the writes since the last
+ * checkpoint; checkpoints flush the segment and start a new log generation,
+ * whenever the log is half full. Segments allocated by transactions are not
+ * durable.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Default size of the redo log of a durable region, in bytes ('TM_PERSIST_LOG' overrides it when the file is created)
+#ifndef TM_PERSIST_LOG
+    #define TM_PERSIST_LOG (64ul << 20)
+#endif
+
+/** Durable backing of the first segment of a region.
+**/
+struct persist {
+    int fd;
+    std::byte* map;           // Whole file mapping
+    size_t map_size;
+    struct persist_header* header; // Start of the file
+    std::byte* data;          // Memory of the first segment, in the file
+    size_t data_size;
+    std::byte* log;           // Redo log, in the file
+    size_t log_size;
+    alignas(CACHE_LINE) std::atomic<size_t> reserved; // Bytes of the log handed out to committing transactions
+    alignas(CACHE_LINE) std::atomic<size_t> durable;  // Bytes of the log made durable, whole groups only
+    std::atomic<bool> full;   // Whether a commit found no room left, the next checkpoint lets it retry
+};
+
+struct region;
+struct segment;
+struct write_set;
+
+struct segment* persist_open(struct region*, char const*, size_t) noexcept;
+void persist_close(struct region*) noexcept;
+bool persist_commit(struct region*, struct write_set*) noexcept;
+bool persist_commit_batch(struct region*, struct write_set* const*, size_t) noexcept;
+void persist_checkpoint(struct region*) noexcept;
@@ -0,0 +1,1134 @@
+/**
+ * @file   pessimistic.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Pessimistic engine: every accessed segment is locked on first access and
+ * writes are performed in place, old content being kept in an undo log.
+ * Reads take the segment lock shared, so that readers of a segment run in
+ * parallel; a later write of the segment upgrades it to exclusive. With
+ * USE_SNZI, the readers of a segment are counted in a scalable non-zero
+ * indicator rather than in the one word of a 'shared_mutex' (see 'snzi.hpp').
+ *
+ * Transactions that abort often and write little buffer their writes
+ * instead (redo), and publish them at commit: their aborts undo nothing, and
+ * the segments they write only look dirty to invisible readers at commit.
+ * The choice is made at each attempt from the recent outcomes of the thread
+ * and the number of words written by its previous attempt, so that a retry
+ * switches to redo (see TM_REDO_WRITES and TM_REDO_ABORTS).
+ *
+ * The undo log of a thread is a chain of chunks: the first one is kept
+ * between its transactions, a transaction outgrowing it spills to mapped
+ * chunks (see TM_UNDO_CHUNK and TM_UNDO_SPILL), so that growing never copies
+ * the records and the memory of a huge transaction goes back to the system.
+ *
+ * With USE_INTENT_LOCKS, locking is hierarchical. Reads and writes of words
+ * take the segment lock shared, as an intent: the intents of readers and
+ * writers never conflict with each other. Below the intents, the words
+ * themselves are locked through a table of TM_INTENT_STRIPES_LOG2 versioned
+ * stripes, shared to read and exclusive to write. Only a transaction holding
+ * a whole segment, i.e. freeing it, takes the segment lock exclusive, and so
+ * conflicts only with the transactions using that segment, while ordinary
+ * transactions on disjoint words of one segment run in parallel. Writers mark
+ * their stripes rather than the segment, and read-only transactions check the
+ * version of every stripe they read.
+**/
+
+// External headers
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <shared_mutex>
+#include <sys/mman.h>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "engine.hpp"
+#include "heatmap.hpp"
+#include "percpu.hpp"
+#include "persist.hpp"
+#include "profile.hpp"
+#include "region.hpp"
+#include "ship.hpp"
+#include "trace.hpp"
+#include "word.hpp"
+#include "writeset.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+namespace pessimistic {
+
+/** Engine state, segment versions are even and taken from this clock, odd while being written.
+**/
+struct alignas(CACHE_LINE) state {
+    atomic<uint64_t> clock;
+#ifdef USE_INTENT_LOCKS
+    atomic<uint64_t>* stripes; // Word locks below the intents, see 'stripe_of'
+#endif
+};
+
+#ifdef USE_INTENT_LOCKS
+// Stripe lock word: writer in the lowest bit, readers in the next STRIPE_READER_BITS bits, even version of the last commit above
+#define STRIPE_WRITER      UINT64_C(1)
+#define STRIPE_READER      UINT64_C(2)
+#define STRIPE_READER_BITS 16
+#define STRIPE_READERS     (((UINT64_C(1) << STRIPE_READER_BITS) - 1) << 1)
+#define STRIPE_SHIFT       (STRIPE_READER_BITS + 1)
+
+static_assert(EPOCH_SLOTS < (1 << STRIPE_READER_BITS), "every running transaction may read a stripe");
+
+/** Stripe held by a transaction.
+**/
+struct held_stripe {
+    atomic<uint64_t>* stripe;
+    bool exclusive;
+    uint64_t word; // Lock word to restore on abort, when held exclusive
+};
+#endif
+
+/** Undo record, the old content follows it in the arena.
+**/
+struct log{
+    size_t size;
+    void* location;
+    struct log* prev; // Previous record, NULL for the first one
+};
+
+/** Chunk of the undo arena, its records follow it.
+**/
+struct chunk {
+    struct chunk* next; // Next chunk, NULL for the last one
+    size_t size;        // Bytes for records
+    size_t mapped;      // Length of the mapping holding the chunk, 0 for the first chunk (allocated)
+};
+
+/** Per-thread bump arena holding the undo records of the running transaction, reset on commit and abort.
+ * A thread runs one transaction at a time, so the records of a transaction are all in the chain.
+**/
+struct arena {
+    struct chunk* first;   // Chunk kept between transactions
+    struct chunk* current; // Chunk records are added to
+    size_t used;           // Bytes used in 'current'
+    ~arena() { ::free(first); }
+};
+
+static thread_local struct arena undo = {NULL, NULL, 0};
+
+/** Recent history of the transactions of a thread, to pick the logging of the next one.
+**/
+struct history {
+    uint32_t outcomes; // Last attempts, newest in the lowest bit, set for an abort
+    size_t written;    // Words written by the last attempt
+};
+
+static thread_local struct history history = {0, 0};
+
+// Mode a segment lock is held in by a transaction
+#define HELD_SHARED    0 // Taken by a read, still in 'read_locks' only
+#define HELD_EXCLUSIVE 1 // Taken by a write, alloc or free, or upgraded
+#define HELD_RELEASED  2 // Shared lock given up by a failed upgrade, not held anymore
+
+/** Lock in the set of locks held by a transaction.
+**/
+struct held_lock {
+    void const* lock;   // Segment lock, or stripe with USE_INTENT_LOCKS, NULL for an empty slot
+    int mode;           // One of 'HELD_*'
+    uint64_t version;   // Version of the segment when the lock was taken shared, index in 'stripes' for a stripe
+};
+
+/** Transaction descriptor, on lines of its own so that the descriptors of different threads never share one.
+**/
+struct alignas(CACHE_LINE) transaction {
+    struct log* logs; // Last undo record in the arena, NULL if none
+    vector<struct segment*> to_free;
+    vector<segment_lock*> to_free_locks;
+    vector<struct segment*> new_segments;
+    vector<segment_lock*> new_seg_locks;
+    struct region* region;
+    size_t slot; // Epoch table slot
+    uint64_t rv; // Clock snapshot at begin
+    vector<segment_lock*> locks;
+    vector<segment_lock*> read_locks; // Taken shared, possibly upgraded since
+    vector<struct held_lock> held;    // Open-addressing set of every lock above
+    size_t nb_held;
+    vector<pair<struct segment*, uint64_t>> dirty; // Segments marked as being written, with their previous version
+    bool redo;      // Whether writes are buffered in 'writes' and published at commit, rather than done in place
+    size_t written; // Words written so far
+    struct write_set writes; // Buffered writes, in redo mode
+    vector<struct segment*> redo_segments; // Segments written in redo mode, marked dirty at commit
+#ifdef USE_INTENT_LOCKS
+    vector<struct held_stripe> stripes; // Stripes held, each once
+    size_t owned; // Stripes held exclusive, stamped with a new version at commit
+#endif
+};
+
+//================================================================
+//Helper functions
+//================================================================
+
+/** Get a chunk for the undo arena.
+ * @param size   Bytes for records
+ * @param mapped Whether to map it, rather than allocate it
+ * @return Chunk, NULL if there was not enough memory
+**/
+static struct chunk* chunk_new(size_t size, bool mapped){
+    struct chunk* c;
+    size_t length = 0;
+    if (mapped){
+        size_t page = static_cast<size_t>(1) << SEGMENT_PAGE_LOG2;
+        length = (sizeof(struct chunk) + size + page - 1) & ~(page - 1);
+        void* map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        c = map == MAP_FAILED ? NULL : (struct chunk*) map;
+        size = length - sizeof(struct chunk);
+    } else {
+        c = (struct chunk*) malloc(sizeof(struct chunk) + size);
+    }
+    if (unlikely(c == NULL)){
+        return NULL;
+    }
+    c->next = NULL;
+    c->size = size;
+    c->mapped = length;
+    return c;
+}
+
+/** Empty the undo arena of the thread, giving back the chunks it spilled to.
+**/
+static void arena_reset(){
+    if (undo.first != NULL && undo.first->next != NULL){
+        for (struct chunk* c = undo.first->next; c != NULL;){
+            struct chunk* next = c->next;
+            munmap(c, c->mapped);
+            c = next;
+        }
+        undo.first->next = NULL;
+    }
+    undo.current = undo.first;
+    undo.used = 0;
+}
+
+/** Get the bytes the undo arena of the thread holds.
+ * @return Size (in bytes)
+**/
+static size_t arena_footprint(){
+    size_t size = 0;
+    for (struct chunk* c = undo.first; c != NULL; c = c->next){
+        size += sizeof(struct chunk) + c->size;
+    }
+    return size;
+}
+
+/** Descriptor kept between transactions by each thread, or by each CPU with USE_RSEQ, so that its vectors keep their capacity.
+**/
+static percpu_spare<struct transaction> spare;
+
+/** Get the bytes a descriptor holds, the unused capacity of its vectors and the undo arena of the thread included.
+ * @param trans Transaction descriptor
+ * @return Size (in bytes)
+**/
+static size_t footprint(struct transaction const* trans){
+    return sizeof(*trans) + arena_footprint() + writeset_footprint(&trans->writes)
+        + (trans->to_free.capacity() + trans->new_segments.capacity() + trans->redo_segments.capacity()) * sizeof(struct segment*)
+        + (trans->to_free_locks.capacity() + trans->new_seg_locks.capacity() + trans->locks.capacity() + trans->read_locks.capacity()) * sizeof(segment_lock*)
+        + trans->held.capacity() * sizeof(struct held_lock) + trans->dirty.capacity() * sizeof(pair<struct segment*, uint64_t>)
+#ifdef USE_INTENT_LOCKS
+        + trans->stripes.capacity() * sizeof(struct held_stripe)
+#endif
+        ;
+}
+
+/** Release the epoch slot of the transaction and recycle its descriptor.
+ * @param trans Transaction to finish
+**/
+static void finish(struct transaction* trans){
+    trans->region->counters[trans->slot].descriptor.store(footprint(trans), memory_order_relaxed);
+    epoch_exit(trans->region, trans->slot);
+    trans->to_free.clear();
+    trans->to_free_locks.clear();
+    trans->new_segments.clear();
+    trans->new_seg_locks.clear();
+    trans->locks.clear();
+    trans->read_locks.clear();
+    if (trans->nb_held > 0){
+        fill(trans->held.begin(), trans->held.end(), held_lock{nullptr, HELD_SHARED, 0});
+        trans->nb_held = 0;
+    }
+    trans->dirty.clear();
+    writeset_clear(&trans->writes);
+    trans->redo_segments.clear();
+#ifdef USE_INTENT_LOCKS
+    trans->stripes.clear();
+    trans->owned = 0;
+#endif
+    if (!spare.keep(trans)){
+        delete trans;
+    }
+}
+
+/** Record the outcome of an attempt, for the choice of the logging of the next ones.
+ * @param trans   Transaction ending
+ * @param aborted Whether it aborted
+**/
+static inline void history_note(struct transaction* trans, bool aborted){
+    history.outcomes = (history.outcomes << 1) | (aborted ? 1 : 0);
+    history.written = trans->written;
+}
+
+/** Choose the logging of a transaction beginning.
+ * @return Whether it redoes, otherwise it undoes
+**/
+static inline bool history_redo(){
+    //aborts are then cheap, and small write sets are cheap to buffer and look up
+    return TM_REDO_WRITES > 0 && history.written <= TM_REDO_WRITES && (cm_retries() > 0 || __builtin_popcount(history.outcomes) >= TM_REDO_ABORTS);
+}
+
+/** Apply the buffered writes of a redo transaction to words just copied from memory.
+ * @param trans  Transaction in redo mode
+ * @param source Source start address (in the shared region)
+ * @param size   Length copied (in bytes)
+ * @param target Target start address (in a private region)
+**/
+static void redo_overlay(struct transaction* trans, void const* source, size_t size, void* target){
+    size_t align = trans->region->align;
+    for (size_t i = 0; i < size; i += align){
+        struct write_entry* written = writeset_find(&trans->writes, (byte const*) source + i);
+        if (written == NULL){
+            continue;
+        }
+        if (written->delta){
+            //the segment is held exclusively, the value copied is the one the increment applies to
+            writeset_fold(&trans->writes, written, (byte*) target + i, align);
+        } else {
+            word_copy((byte*) target + i, trans->writes.data.data() + written->offset, align);
+        }
+    }
+}
+void free_segments(tx_t tx, vector<segment*> to_free){
+    struct transaction* trans = (struct transaction*) tx;
+    for(auto seg_to_free : to_free){
+        segment_unregister(trans->region, seg_to_free);
+        segment_retire(trans->region, seg_to_free);
+    }
+    return;
+}
+
+/** Append an undo record for a location about to be overwritten.
+ * @param trans    Transaction writing
+ * @param location Location about to be overwritten
+ * @param size     Number of bytes about to be overwritten
+ * @return Whether there was enough memory
+**/
+static bool log_push(struct transaction* trans, void* location, size_t size){
+    PROFILE(PROFILE_LOG);
+    //keep the next record aligned
+    size_t need = sizeof(struct log) + ((size + alignof(struct log) - 1) & ~(alignof(struct log) - 1));
+    if (unlikely(undo.current == NULL || undo.used + need > undo.current->size)){
+        struct chunk* c;
+        if (undo.current == NULL){
+            c = undo.first = chunk_new(need > TM_UNDO_CHUNK ? need : TM_UNDO_CHUNK, false);
+        } else {
+            //records never move, they are linked across chunks
+            c = undo.current->next = chunk_new(need > TM_UNDO_SPILL ? need : TM_UNDO_SPILL, true);
+        }
+        if (unlikely(c == NULL)){
+            return false;
+        }
+        undo.current = c;
+        undo.used = 0;
+    }
+    struct log* change = (struct log*) ((byte*) (undo.current + 1) + undo.used);
+    change->size = size;
+    change->location = location;
+    change->prev = trans->logs;
+    words_copy(change + 1, location, size, trans->region->align);
+    trans->logs = change;
+    undo.used += need;
+    return true;
+}
+
+/** Get the first slot to probe for a lock in the set of held locks.
+ * @param trans Transaction with a non-empty set
+ * @param lock  Lock to look for
+ * @return Slot in the set
+**/
+static inline size_t held_slot(struct transaction* trans, void const* lock){
+    //Fibonacci hashing, the set size is a power of 2
+    return (size_t) ((((uintptr_t) lock) * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - __builtin_ctzl(trans->held.size())));
+}
+
+/** Remember a lock the transaction just acquired, growing the set if half full.
+ * @param trans   Transaction that acquired the lock
+ * @param lock    Lock acquired
+ * @param mode    Mode the lock is held in, one of 'HELD_*'
+ * @param version Version of the segment, for a lock held shared (index in 'stripes' for a stripe)
+**/
+static void add_lock(struct transaction* trans, void const* lock, int mode, uint64_t version = 0){
+    if (unlikely(2 * (trans->nb_held + 1) > trans->held.size())){
+        vector<struct held_lock> old(trans->held.size() < 16 ? 32 : 2 * trans->held.size(), held_lock{nullptr, HELD_SHARED, 0});
+        old.swap(trans->held);
+        trans->nb_held = 0;
+        for (auto& candidate : old){
+            if (candidate.lock != nullptr){
+                add_lock(trans, candidate.lock, candidate.mode, candidate.version);
+            }
+        }
+    }
+    size_t slot = held_slot(trans, lock);
+    while (trans->held[slot].lock != nullptr){
+        slot = (slot + 1) & (trans->held.size() - 1);
+    }
+    trans->held[slot] = {lock, mode, version};
+    ++trans->nb_held;
+}
+
+/** Find a lock in the set of locks held by the transaction, in constant time.
+ * @param trans Transaction to check
+ * @param lock  Lock to look for
+ * @return Entry of the lock, NULL if the transaction never took it
+**/
+static struct held_lock* find_lock(struct transaction* trans, void const* lock){
+    if (trans->nb_held == 0){
+        return NULL;
+    }
+    for (size_t slot = held_slot(trans, lock); trans->held[slot].lock != nullptr; slot = (slot + 1) & (trans->held.size() - 1)){
+        if (trans->held[slot].lock == lock){
+            return &trans->held[slot];
+        }
+    }
+    return NULL;
+}
+
+/** Release the locks taken by reads that are still held shared, the upgraded ones are in 'locks'.
+ * @param trans Transaction releasing its locks
+**/
+static void unlock_reads(struct transaction* trans){
+    for (auto lock : trans->read_locks) {
+        if (find_lock(trans, lock)->mode == HELD_SHARED){
+            lock->unlock_shared();
+        }
+    }
+}
+
+#ifdef USE_INTENT_LOCKS
+/** Get the stripe locking a word.
+ * @param region Region of the word
+ * @param addr   Address of the word
+ * @return Stripe of the word
+**/
+static inline atomic<uint64_t>* stripe_of(struct region* region, void const* addr){
+    struct state* st = (struct state*) region->engine;
+    return st->stripes + ((((uintptr_t) addr) >> __builtin_ctzl(region->align)) & ((UINT64_C(1) << TM_INTENT_STRIPES_LOG2) - 1));
+}
+
+/** Release the stripes held by the transaction, the exclusive ones with a new version or the one they had.
+ * @param trans Transaction releasing its stripes, after its writes were published or undone
+ * @param wv    Version the transaction committed at, 0 if it aborted
+**/
+static void unlock_stripes(struct transaction* trans, uint64_t wv){
+    for (auto const& held : trans->stripes){
+        if (!held.exclusive){
+            held.stripe->fetch_sub(STRIPE_READER, memory_order_release);
+        } else {
+            held.stripe->store(wv == 0 ? held.word : wv << STRIPE_SHIFT, memory_order_release);
+        }
+    }
+}
+#endif
+
+void rollback(tx_t tx, int reason){
+    PROFILE(PROFILE_ROLLBACK);
+    struct transaction* trans = (struct transaction*) tx;
+    counter_add(trans->region->counters[trans->slot].aborts[reason], 1);
+    TRACE_REASON(reason);
+    //the retry likely writes the same segments
+    for (auto lock : trans->locks){
+        cm_predict(&trans->region->cm, lock);
+    }
+    cm_abort(&trans->region->cm, trans->nb_held);
+    history_note(trans, true);
+    //if aborting, all the locks are taken
+    //rolling back writes, newest first
+    for (struct log* change = trans->logs; change != NULL; change = change->prev){
+        words_copy(change->location, change + 1, change->size, trans->region->align);
+    }
+    arena_reset();
+    //rolling back free
+    for(auto segment : trans->to_free){
+        segment->freed = false;
+    }
+    //rolling back allocs
+    free_segments(tx, trans->new_segments);
+    //restoring the versions, the content is back to what they described
+    for (auto& entry : trans->dirty){
+        entry.first->version.store(entry.second, memory_order_release);
+    }
+
+    for (auto lock : trans->locks) {
+       lock->unlock();
+    }
+    for (auto lock : trans->to_free_locks) {
+       lock->unlock();
+    }
+    for (auto lock : trans->new_seg_locks){
+        lock->unlock();
+    }
+#ifdef USE_INTENT_LOCKS
+    //the content is back to what the versions described
+    unlock_stripes(trans, 0);
+#endif
+
+    //unlocking
+    unlock_reads(trans);
+    finish(trans);
+    return;
+}
+
+/** Mark a segment the transaction holds exclusively as being written, so that invisible readers stay away.
+ * @param trans Transaction holding the segment lock
+ * @param seg   Segment about to be modified
+**/
+static void mark_dirty(struct transaction* trans, struct segment* seg){
+    uint64_t version = seg->version.load(memory_order_relaxed);
+    if (version & 1){
+        //already marked by this transaction, the only one that can hold the lock
+        return;
+    }
+    trans->dirty.emplace_back(seg, version);
+    seg->version.store(version | 1, memory_order_relaxed);
+    //the mark must be visible before the content changes
+    atomic_thread_fence(memory_order_release);
+}
+
+/** Try to lock a segment lock exclusively, waiting as long as the contention manager says.
+ * @param trans Transaction locking
+ * @param lock  Lock to take
+ * @return Whether the lock is now held
+**/
+static bool lock_waiting(struct transaction* trans, segment_lock* lock){
+    for (size_t attempt = 0; !lock->try_lock(); ++attempt){
+        if (!cm_wait(&trans->region->cm, attempt)){
+            cm_predict(&trans->region->cm, lock);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Make the transaction hold a segment lock exclusively, upgrading it if held shared.
+ * A segment lock cannot be upgraded in place: the shared lock is released, the
+ * exclusive one taken, and the upgrade only succeeds if no writer committed on
+ * the segment in between, i.e. its version is the one seen under the shared lock.
+ * @param tx  Transaction locking
+ * @param seg Segment to lock
+ * @param to  Vector to remember a newly taken lock in
+ * @return Whether the lock is now held exclusively, otherwise the transaction was rolled back
+**/
+static bool lock_exclusive(tx_t tx, struct segment* seg, vector<segment_lock*>& to){
+    PROFILE(PROFILE_LOCK);
+    struct transaction* trans = (struct transaction*) tx;
+    struct held_lock* held = find_lock(trans, &seg->lock);
+    if (held == NULL){
+        if (trans->nb_held == 0){
+            //holding nothing yet, it can wait for the transaction with the priority
+            cm_yield(&trans->region->cm);
+        }
+        if (!lock_waiting(trans, &seg->lock)){
+            HEATMAP(trans->region, seg, NULL, HEATMAP_NO_STRIPE);
+            rollback(tx, TM_ABORT_LOCK);
+            return false;
+        }
+        to.push_back(&seg->lock);
+        add_lock(trans, &seg->lock, HELD_EXCLUSIVE);
+        return true;
+    }
+    if (likely(held->mode == HELD_EXCLUSIVE)){
+        return true;
+    }
+    //shared, upgrade it
+    seg->lock.unlock_shared();
+    if (!lock_waiting(trans, &seg->lock)){
+        held->mode = HELD_RELEASED;
+        HEATMAP(trans->region, seg, NULL, HEATMAP_NO_STRIPE);
+        rollback(tx, TM_ABORT_LOCK);
+        return false;
+    }
+    held->mode = HELD_EXCLUSIVE;
+    to.push_back(&seg->lock);
+    if (seg->version.load(memory_order_relaxed) != held->version){
+        //a writer got in between, what this transaction read is gone
+        HEATMAP(trans->region, seg, NULL, HEATMAP_NO_STRIPE);
+        rollback(tx, TM_ABORT_VALIDATE);
+        return false;
+    }
+    return true;
+}
+
+/** Make the transaction hold a segment lock, shared unless it holds it already.
+ * @param tx  Transaction locking
+ * @param seg Segment to lock
+ * @return Whether the lock is now held, otherwise the transaction was rolled back
+**/
+static bool lock_shared(tx_t tx, struct segment* seg){
+    PROFILE(PROFILE_LOCK);
+    struct transaction* trans = (struct transaction*) tx;
+    if (find_lock(trans, &seg->lock) != NULL){
+        return true;
+    }
+    //shared, other readers of the segment can go on
+    for (size_t attempt = 0; !seg->lock.try_lock_shared(); ++attempt){
+        if (!cm_wait(&trans->region->cm, attempt)){
+            cm_predict(&trans->region->cm, &seg->lock);
+            HEATMAP(trans->region, seg, NULL, HEATMAP_NO_STRIPE);
+            rollback(tx, TM_ABORT_LOCK);
+            return false;
+        }
+    }
+    //writers hold the lock exclusively, the version is stable until released
+    trans->read_locks.push_back(&seg->lock);
+    add_lock(trans, &seg->lock, HELD_SHARED, seg->version.load(memory_order_relaxed));
+    return true;
+}
+
+#ifdef USE_INTENT_LOCKS
+/** Make the transaction hold a stripe, shared or exclusive, upgrading it in place if it is the only reader.
+ * @param tx        Transaction locking, holding an intent on the segment of the word
+ * @param addr      Word to lock
+ * @param exclusive Whether to lock it to write
+ * @return Whether the stripe is now held, otherwise the transaction was rolled back
+**/
+static bool lock_stripe(tx_t tx, void const* addr, bool exclusive){
+    struct transaction* trans = (struct transaction*) tx;
+    atomic<uint64_t>* stripe = stripe_of(trans->region, addr);
+    struct held_lock* held = find_lock(trans, stripe);
+    if (held != NULL && (held->mode == HELD_EXCLUSIVE || !exclusive)){
+        return true;
+    }
+    //the reader this transaction counts for, on an upgrade
+    uint64_t mine = held != NULL ? STRIPE_READER : 0;
+    uint64_t word = stripe->load(memory_order_relaxed);
+    for (size_t attempt = 0; ; ++attempt){
+        if (!(word & STRIPE_WRITER) && (!exclusive || (word & STRIPE_READERS) == mine)){
+            if (stripe->compare_exchange_weak(word, exclusive ? (word - mine) | STRIPE_WRITER : word + STRIPE_READER, memory_order_acquire, memory_order_relaxed)){
+                break;
+            }
+            continue;
+        }
+        if (!cm_wait(&trans->region->cm, attempt)){
+            cm_predict(&trans->region->cm, stripe);
+            rollback(tx, TM_ABORT_LOCK);
+            return false;
+        }
+        word = stripe->load(memory_order_relaxed);
+    }
+    if (exclusive){
+        ++trans->owned;
+    }
+    if (held != NULL){
+        held->mode = HELD_EXCLUSIVE;
+        trans->stripes[held->version].exclusive = true;
+        trans->stripes[held->version].word = word - mine;
+        return true;
+    }
+    trans->stripes.push_back({stripe, exclusive, word});
+    add_lock(trans, stripe, exclusive ? HELD_EXCLUSIVE : HELD_SHARED, trans->stripes.size() - 1);
+    return true;
+}
+
+/** Make the transaction hold the words of a range: an intent on their segment, then their stripes.
+ * A transaction holding the whole segment needs no stripe, and marks the segment itself when writing it.
+ * @param tx        Transaction locking
+ * @param seg       Segment of the range
+ * @param addr      Start of the range
+ * @param size      Length of the range (in bytes)
+ * @param exclusive Whether to lock the words to write
+ * @param whole     Set if the transaction holds the whole segment
+ * @return Whether the words are now held, otherwise the transaction was rolled back
+**/
+static bool lock_words(tx_t tx, struct segment* seg, void const* addr, size_t size, bool exclusive, bool* whole){
+    struct transaction* trans = (struct transaction*) tx;
+    if (!lock_shared(tx, seg)){
+        return false;
+    }
+    *whole = find_lock(trans, &seg->lock)->mode == HELD_EXCLUSIVE;
+    if (*whole){
+        return true;
+    }
+    for (size_t i = 0; i < size; i += trans->region->align){
+        if (!lock_stripe(tx, (byte const*) addr + i, exclusive)){
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+//================================================================
+// End of Helper functions
+//================================================================
+
+bool create(shared_t shared) noexcept {
+    struct state* st = new (std::nothrow) struct state();
+    if (unlikely(st == NULL)){
+        return false;
+    }
+    st->clock.store(0, memory_order_relaxed);
+#ifdef USE_INTENT_LOCKS
+    st->stripes = (atomic<uint64_t>*) calloc(UINT64_C(1) << TM_INTENT_STRIPES_LOG2, sizeof(atomic<uint64_t>));
+    if (unlikely(st->stripes == NULL)){
+        delete st;
+        return false;
+    }
+#endif
+    ((struct region*) shared)->engine = st;
+    return true;
+}
+
+void destroy(shared_t shared) noexcept {
+    struct state* st = (struct state*) ((struct region*) shared)->engine;
+#ifdef USE_INTENT_LOCKS
+    ::free(st->stripes);
+#endif
+    delete st;
+}
+
+tx_t begin(shared_t shared, bool is_ro) noexcept {
+    struct region* region = (struct region*) shared;
+    if (is_ro){
+        //no descriptor, only the snapshot: reads only see segments older than it
+        cm_begin(&region->cm);
+        size_t slot = epoch_enter(region);
+        return ro_tx(((struct state*) region->engine)->clock.load(memory_order_acquire), slot);
+    }
+    struct transaction* tx = spare.take();
+    if(unlikely(tx == NULL)){
+        tx = new (std::nothrow) struct transaction();
+        if(unlikely(tx == NULL)){
+           return invalid_tx;
+        }
+    }
+    tx->region = region;
+    cm_begin(&tx->region->cm);
+    tx->logs = NULL;
+    tx->nb_held = 0;
+    tx->written = 0;
+    //a durable or shipped region logs the writes before they reach memory
+    tx->redo = region->persist != NULL || region->ship != NULL || history_redo();
+    tx->slot = epoch_enter(tx->region);
+    tx->rv = ((struct state*) tx->region->engine)->clock.load(memory_order_acquire);
+    return (tx_t) tx;
+}
+
+bool end(shared_t shared, tx_t tx) noexcept {
+    if (is_ro_tx(tx)){
+        struct region* region = (struct region*) shared;
+        cm_commit(&region->cm);
+        counter_add(region->counters[ro_tx_slot(tx)].commits, 1);
+        epoch_exit(region, ro_tx_slot(tx));
+        return true;
+    }
+    struct transaction* trans = (struct transaction*) tx;
+    //the written segments are locked, the log follows the commit order
+    if (unlikely(trans->region->persist != NULL) && !persist_commit(trans->region, &trans->writes)){
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    if (unlikely(trans->region->ship != NULL)){
+        ship_commit(trans->region, &trans->writes);
+    }
+    if (trans->redo && !trans->writes.entries.empty()){
+        for (auto seg : trans->redo_segments){
+            mark_dirty(trans, seg);
+        }
+        writeset_publish(&trans->writes, trans->region->align, trans->region->stream);
+    }
+    //publish the new versions while every lock is still held
+    uint64_t wv = 0;
+#ifdef USE_INTENT_LOCKS
+    bool stamped = !trans->dirty.empty() || trans->owned > 0;
+#else
+    bool stamped = !trans->dirty.empty();
+#endif
+    if (stamped){
+        wv = ((struct state*) ((struct region*) shared)->engine)->clock.fetch_add(1, memory_order_acq_rel) + 1;
+        for (auto& entry : trans->dirty){
+            entry.first->version.store(wv << 1, memory_order_release);
+        }
+    }
+#ifdef USE_INTENT_LOCKS
+    unlock_stripes(trans, wv);
+#endif
+    //unreachable before anybody else may lock them
+    free_segments(tx, trans->to_free);
+    unlock_reads(trans);
+    for (auto lock : trans->locks) {
+       lock->unlock();
+    }
+    for (auto lock : trans->new_seg_locks){
+        lock->unlock();
+    }
+    for (auto lock : trans->to_free_locks){
+        lock->unlock();
+    }
+    arena_reset();
+    cm_commit(&trans->region->cm);
+    history_note(trans, false);
+    counter_add(trans->region->counters[trans->slot].commits, 1);
+    finish(trans);
+    return true;
+}
+
+/** Read without taking any lock nor writing any shared metadata, the segment must not have changed since begin.
+ * With USE_INTENT_LOCKS, neither must the stripes of the words read, which writers mark instead of the segment.
+ * @param region Region of the segment
+ * @param rv     Snapshot of the read-only transaction
+ * @param seg    Segment to read on
+ * @param source Source start address (in the segment)
+ * @param size   Length to copy (in bytes)
+ * @param target Target start address (in a private region)
+ * @return Whether the read is consistent with the snapshot
+**/
+static bool read_invisible(struct region* region, uint64_t rv, struct segment* seg, void const* source, size_t size, void* target){
+    size_t align = region->align;
+    uint64_t version = seg->version.load(memory_order_acquire);
+    if ((version & 1) || (version >> 1) > rv){
+        return false;
+    }
+#ifdef USE_INTENT_LOCKS
+    for (size_t i = 0; i < size; i += align){
+        atomic<uint64_t>* stripe = stripe_of(region, (byte const*) source + i);
+        //the readers come and go, the writer bit and the version tell whether the word changed
+        uint64_t pre = stripe->load(memory_order_acquire) & ~STRIPE_READERS;
+        if ((pre & STRIPE_WRITER) || (pre >> STRIPE_SHIFT) > rv){
+            return false;
+        }
+        word_copy((byte*) target + i, (byte const*) source + i, align);
+        atomic_thread_fence(memory_order_acquire);
+        if ((stripe->load(memory_order_relaxed) & ~STRIPE_READERS) != pre){
+            return false;
+        }
+    }
+#else
+    words_copy(target, source, size, align);
+#endif
+    atomic_thread_fence(memory_order_acquire);
+    return seg->version.load(memory_order_relaxed) == version;
+}
+
+bool read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    if (is_ro_tx(tx)){
+        struct region* region = (struct region*) shared;
+        size_t slot = ro_tx_slot(tx);
+        counter_add(region->counters[slot].reads, 1);
+        struct segment* seg = segment_find(region, source);
+        //a missing segment was freed after the snapshot
+        if (unlikely(seg == NULL || !read_invisible(region, ro_tx_rv(tx), seg, source, size, target))){
+            if (seg != NULL){
+                HEATMAP(region, seg, NULL, HEATMAP_NO_STRIPE);
+            }
+            counter_add(region->counters[slot].aborts[TM_ABORT_READ], 1);
+            TRACE_REASON(TM_ABORT_READ);
+            cm_abort(&region->cm, 0);
+            epoch_exit(region, slot);
+            return false;
+        }
+        return true;
+    }
+    struct transaction* trans = (struct transaction*) tx;
+    counter_add(trans->region->counters[trans->slot].reads, 1);
+    if (segment_captured(trans->new_segments, source, size)){
+        words_copy(target, source, size, trans->region->align);
+        return true;
+    }
+    //find segment to read on
+    struct segment* seg = segment_find((struct region*) shared, source);
+    if (unlikely(seg == NULL)){
+        printf("Not found for read\n");
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+#ifdef USE_INTENT_LOCKS
+    bool whole;
+    if (!lock_words(tx, seg, source, size, false, &whole)){
+        return false;
+    }
+#else
+    if (!lock_shared(tx, seg)){
+        return false;
+    }
+#endif
+    //copy the memory
+    words_copy(target, source, size, trans->region->align);
+    if (trans->redo && !trans->writes.entries.empty()){
+        redo_overlay(trans, source, size, target);
+    }
+    return true;
+}
+
+bool read_for_update(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    if (is_ro_tx(tx)){
+        //cannot write anyway
+        return read(shared, tx, source, size, target);
+    }
+    struct transaction* trans = (struct transaction*) tx;
+    counter_add(trans->region->counters[trans->slot].reads, 1);
+    if (segment_captured(trans->new_segments, source, size)){
+        words_copy(target, source, size, trans->region->align);
+        return true;
+    }
+    struct segment* seg = segment_find((struct region*) shared, source);
+    if (unlikely(seg == NULL)){
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    //exclusive right away, the write that follows needs no upgrade
+#ifdef USE_INTENT_LOCKS
+    bool whole;
+    if (!lock_words(tx, seg, source, size, true, &whole)){
+        return false;
+    }
+#else
+    if (!lock_exclusive(tx, seg, trans->locks)){
+        return false;
+    }
+#endif
+    words_copy(target, source, size, trans->region->align);
+    if (trans->redo && !trans->writes.entries.empty()){
+        redo_overlay(trans, source, size, target);
+    }
+    return true;
+}
+
+bool hint(shared_t shared, tx_t tx, void const* const* addresses, size_t count, uint64_t write_mask) noexcept {
+    if (is_ro_tx(tx)){
+        //locks nothing anyway
+        return true;
+    }
+#ifdef USE_INTENT_LOCKS
+    //each word with an intent on its segment, in one global order of the stripes
+    struct region* region = (struct region*) shared;
+    size_t order[TM_HINT_MAX];
+    for (size_t i = 0; i < count; ++i){
+        order[i] = i;
+    }
+    sort(order, order + count, [&](size_t a, size_t b){ return stripe_of(region, addresses[a]) < stripe_of(region, addresses[b]); });
+    for (size_t j = 0; j < count; ++j){
+        size_t i = order[j];
+        struct segment* seg = segment_find(region, addresses[i]);
+        if (unlikely(seg == NULL)){
+            rollback(tx, TM_ABORT_OTHER);
+            return false;
+        }
+        bool whole;
+        if (!lock_words(tx, seg, addresses[i], region->align, (write_mask >> i) & 1, &whole)){
+            return false;
+        }
+    }
+    return true;
+#else
+    //each segment once, exclusive if any of its words will be written
+    pair<struct segment*, bool> segs[TM_HINT_MAX];
+    size_t nb_segs = 0;
+    for (size_t i = 0; i < count; ++i){
+        struct segment* seg = segment_find((struct region*) shared, addresses[i]);
+        if (unlikely(seg == NULL)){
+            rollback(tx, TM_ABORT_OTHER);
+            return false;
+        }
+        bool written = (write_mask >> i) & 1;
+        size_t j = 0;
+        while (j < nb_segs && segs[j].first != seg){
+            ++j;
+        }
+        if (j == nb_segs){
+            segs[nb_segs++] = {seg, written};
+        } else {
+            segs[j].second |= written;
+        }
+    }
+    //in one global order, so that hinted transactions never wait for each other in a cycle, and take write ownership upfront
+    sort(segs, segs + nb_segs, [](auto const& a, auto const& b){ return less<struct segment*>()(a.first, b.first); });
+    struct transaction* trans = (struct transaction*) tx;
+    for (size_t j = 0; j < nb_segs; ++j){
+        if (!(segs[j].second ? lock_exclusive(tx, segs[j].first, trans->locks) : lock_shared(tx, segs[j].first))){
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+bool write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct transaction* trans = (struct transaction*) tx;
+    counter_add(trans->region->counters[trans->slot].writes, 1);
+    //held exclusively since its allocation, and freed if the transaction aborts
+    if (segment_captured(trans->new_segments, target, size)){
+        words_copy(target, source, size, trans->region->align);
+        return true;
+    }
+
+    //find segment to write on
+    struct segment* seg = segment_find((struct region*) shared, target);
+    if (unlikely(seg == NULL)){
+        //if the address is not in the given region, abort the transaction
+        printf("Not found for write\n");
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+
+    //maybe i have it already, possibly only shared
+    bool whole = true;
+#ifdef USE_INTENT_LOCKS
+    if (!lock_words(tx, seg, target, size, true, &whole)){
+        return false;
+    }
+#else
+    if (!lock_exclusive(tx, seg, trans->locks)){
+        return false;
+    }
+#endif
+    size_t align = trans->region->align;
+    trans->written += size / align;
+    if (trans->redo){
+        //held exclusively until commit, nobody else can see the buffered content is not in place
+        if (whole){
+            trans->redo_segments.push_back(seg);
+        }
+        for (size_t i = 0; i < size; i += align){
+            writeset_add(&trans->writes, (byte*) target + i, (byte const*) source + i, align);
+        }
+        return true;
+    }
+    if (whole){
+        mark_dirty(trans, seg);
+    }
+
+    //remember the old content
+    if (unlikely(!log_push(trans, target, size))){
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    //copy the memory
+    words_copy(target, source, size, trans->region->align);
+    return true;
+}
+
+bool add(shared_t shared, tx_t tx, void* target, int64_t delta) noexcept {
+    struct transaction* trans = (struct transaction*) tx;
+    counter_add(trans->region->counters[trans->slot].writes, 1);
+    if (segment_captured(trans->new_segments, target, trans->region->align)){
+        word_add(target, delta);
+        return true;
+    }
+
+    struct segment* seg = segment_find((struct region*) shared, target);
+    if (unlikely(seg == NULL)){
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    //in place like any write, the segment lock is needed anyway
+    bool whole = true;
+#ifdef USE_INTENT_LOCKS
+    if (!lock_words(tx, seg, target, trans->region->align, true, &whole)){
+        return false;
+    }
+#else
+    if (!lock_exclusive(tx, seg, trans->locks)){
+        return false;
+    }
+#endif
+    ++trans->written;
+    if (trans->redo){
+        if (whole){
+            trans->redo_segments.push_back(seg);
+        }
+        writeset_add_delta(&trans->writes, (byte*) target, delta, trans->region->align);
+        return true;
+    }
+    if (whole){
+        mark_dirty(trans, seg);
+    }
+    if (unlikely(!log_push(trans, target, trans->region->align))){
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    word_add(target, delta);
+    return true;
+}
+
+void release(shared_t shared as(unused), tx_t tx as(unused), void const* source as(unused), size_t size as(unused)) noexcept {
+    //the segment lock covers every word read in the segment, it is kept until the end
+}
+
+Alloc alloc(shared_t shared, tx_t tx, size_t size, void** target) noexcept {
+    struct region* region = (struct region*) shared;
+
+    struct segment* seg = segment_create(region, size);
+    if (unlikely(seg == NULL)) {
+        return Alloc::nomem;
+    }
+    *target = (void *) seg->mem;
+    seg->lock.lock();
+    ((struct transaction*) tx)->new_seg_locks.push_back(&seg->lock);
+    add_lock((struct transaction*) tx, &seg->lock, HELD_EXCLUSIVE);
+    ((struct transaction*) tx)->new_segments.push_back(seg);
+    counter_add(region->counters[((struct transaction*) tx)->slot].allocs, 1);
+
+    segment_register(region, seg);
+    return Alloc::success;
+}
+
+bool dealloc(shared_t shared, tx_t tx, void* target) noexcept {
+    //find segment to free
+    struct segment* seg = segment_find((struct region*) shared, target);
+    if (unlikely(seg == NULL || seg->mem != target)){
+        //if the address is not the start of a segment in the given region, abort the transaction
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    struct transaction* trans = (struct transaction*) tx;
+    //maybe i have it already, else if cannot lock it, abort
+    if (!lock_exclusive(tx, seg, trans->to_free_locks)){
+        return false;
+    }
+    counter_add(trans->region->counters[trans->slot].frees, 1);
+    if (seg->freed){
+        //already freed by this transaction
+        return true;
+    }
+    mark_dirty(trans, seg);
+    seg->freed = true;
+    trans->to_free.push_back(seg);
+    return true;
+}
+
+/** Allocate the descriptor of the calling thread ahead of its first transaction, on its NUMA node.
+ * @param shared Region the thread entered
+**/
+void thread_enter(shared_t shared as(unused)) noexcept {
+    spare.prepare();
+}
+
+/** Free the descriptor and the undo arena the calling thread kept between its transactions.
+ * @param shared Region the thread leaves
+**/
+void thread_leave(shared_t shared as(unused)) noexcept {
+    spare.drop();
+    arena_reset();
+    ::free(undo.first);
+    undo = {NULL, NULL, 0};
+}
+
+}
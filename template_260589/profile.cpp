@@ -0,0 +1,151 @@
+/**
+ * @file   profile.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Per-thread cycle counters of the profiler, see profile.hpp, or per-CPU ones
+ * with USE_RSEQ so that many short-lived threads do not leave a record each.
+**/
+
+// Internal headers
+#include "profile.hpp"
+
+#ifdef USE_PROFILE
+
+// External headers
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+// Internal headers
+#include "percpu.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Names of the sections in the report
+static char const* const section_names[PROFILE_SECTIONS] = {"begin", "read", "write", "alloc", "free", "end", "rollback", "lookup", "lock", "log"};
+
+/** Counters of one thread, or one CPU, never freed so that they outlive the thread.
+ * Only the thread writes the counters of a thread, the threads running on a CPU add to those of the CPU; the report reads them while they run.
+**/
+struct profile_counters {
+    struct profile_counters* next;
+    uint64_t thread; // Thread, or CPU if 'cpu'
+    bool cpu;
+    atomic<uint64_t> cycles[PROFILE_SECTIONS];
+    atomic<uint64_t> calls[PROFILE_SECTIONS];
+    uint64_t reported_cycles[PROFILE_SECTIONS]; // Counts at the previous report, only accessed under 'report_lock'
+    uint64_t reported_calls[PROFILE_SECTIONS];
+};
+
+static atomic<struct profile_counters*> all{NULL};
+static atomic<uint64_t> threads{0};
+static thread_local struct profile_counters* own = NULL;
+static mutex report_lock;
+#ifdef USE_RSEQ
+static atomic<struct profile_counters*> cpus[PERCPU_MAX];
+#endif
+
+/** Create counters and add them to the report.
+ * @param id  Thread or CPU
+ * @param cpu Whether they are of a CPU
+ * @return Counters, NULL if out of memory
+**/
+static struct profile_counters* new_counters(uint64_t id, bool cpu) {
+    struct profile_counters* fresh = (struct profile_counters*) calloc(1, sizeof(struct profile_counters));
+    if (unlikely(fresh == NULL)){
+        return NULL;
+    }
+    fresh->thread = id;
+    fresh->cpu = cpu;
+    fresh->next = all.load(memory_order_relaxed);
+    while (!all.compare_exchange_weak(fresh->next, fresh, memory_order_release, memory_order_relaxed));
+    return fresh;
+}
+
+/** Get the counters of the calling thread, creating them on first use.
+ * @return Counters of the thread, NULL if out of memory
+**/
+static struct profile_counters* own_counters() {
+    if (likely(own != NULL)){
+        return own;
+    }
+    own = new_counters(threads.fetch_add(1, memory_order_relaxed), false);
+    return own;
+}
+
+#ifdef USE_RSEQ
+/** Get the counters of a CPU, creating them on first use.
+ * @param cpu CPU
+ * @return Counters of the CPU, NULL if out of memory
+**/
+static struct profile_counters* cpu_counters(int cpu) {
+    struct profile_counters* counters = cpus[cpu].load(memory_order_acquire);
+    if (likely(counters != NULL)){
+        return counters;
+    }
+    //racing threads each publish a record, the one claiming the CPU first gets the calls, the others stay empty
+    counters = new_counters((uint64_t) cpu, true);
+    struct profile_counters* expected = NULL;
+    if (counters != NULL && !cpus[cpu].compare_exchange_strong(expected, counters, memory_order_acq_rel, memory_order_acquire)){
+        return expected;
+    }
+    return counters;
+}
+#endif
+
+/** [thread-safe] Add one call to a section, for the calling thread.
+ * @param section One of 'PROFILE_*'
+ * @param cycles  Cycles the call took
+**/
+void profile_add(int section, uint64_t cycles) noexcept {
+#ifdef USE_RSEQ
+    int cpu = percpu_cpu();
+    if (cpu >= 0){
+        struct profile_counters* counters = cpu_counters(cpu);
+        if (likely(counters != NULL)){
+            //shared with the threads preempting this one on the CPU, uncontended otherwise
+            counters->cycles[section].fetch_add(cycles, memory_order_relaxed);
+            counters->calls[section].fetch_add(1, memory_order_relaxed);
+        }
+        return;
+    }
+#endif
+    struct profile_counters* counters = own_counters();
+    if (unlikely(counters == NULL)){
+        return;
+    }
+    //only this thread writes them, no read-modify-write needed
+    counters->cycles[section].store(counters->cycles[section].load(memory_order_relaxed) + cycles, memory_order_relaxed);
+    counters->calls[section].store(counters->calls[section].load(memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+/** [thread-safe] Print, for every thread and section, the calls and cycles since the previous report to the standard error.
+**/
+void profile_report() noexcept {
+    lock_guard<mutex> guard{report_lock};
+    for (struct profile_counters* it = all.load(memory_order_acquire); it != NULL; it = it->next){
+        for (int i = 0; i < PROFILE_SECTIONS; ++i){
+            uint64_t cycles = it->cycles[i].load(memory_order_relaxed);
+            uint64_t calls = it->calls[i].load(memory_order_relaxed);
+            uint64_t new_cycles = cycles - it->reported_cycles[i];
+            uint64_t new_calls = calls - it->reported_calls[i];
+            it->reported_cycles[i] = cycles;
+            it->reported_calls[i] = calls;
+            if (new_calls == 0){
+                continue;
+            }
+            fprintf(stderr, "profile: %s %lu, %-8s %12lu calls %16lu cycles (%.1f per call)\n", it->cpu ? "cpu" : "thread", it->thread, section_names[i], new_calls, new_cycles, (double) new_cycles / new_calls);
+        }
+    }
+}
+
+#endif
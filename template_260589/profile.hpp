@@ -0,0 +1,86 @@
+/**
+ * @file   profile.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Per-call cycle profiler, only compiled in with USE_PROFILE. Every thread
+ * adds the timestamp counter cycles and the calls of each section to counters
+ * of its own (or of its CPU, with USE_RSEQ), and 'tm_destroy' prints those of
+ * every thread since the previous report. Sections nest: the cycles of
+ * 'tm_read' include those of the segment lookups, lock checks and log appends
+ * it made.
+**/
+
+#pragma once
+
+// External headers
+#include <cstdint>
+#include <ctime>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Sections, each counted on its own
+#define PROFILE_BEGIN    0 // 'tm_begin'
+#define PROFILE_READ     1 // 'tm_read'
+#define PROFILE_WRITE    2 // 'tm_write'
+#define PROFILE_ALLOC    3 // 'tm_alloc'
+#define PROFILE_FREE     4 // 'tm_free'
+#define PROFILE_END      5 // 'tm_end'
+#define PROFILE_ROLLBACK 6 // Rollback of an aborted transaction by the engine
+#define PROFILE_LOOKUP   7 // 'segment_find'
+#define PROFILE_LOCK     8 // Lock acquisition and validation by the engine (values for 'norec')
+#define PROFILE_LOG      9 // Appends to the read and write logs, growing them included
+#define PROFILE_SECTIONS 10
+
+#ifdef USE_PROFILE
+
+void profile_add(int, uint64_t) noexcept;
+void profile_report() noexcept;
+
+/** Read the timestamp counter.
+ * @return Current timestamp
+**/
+static inline uint64_t profile_tsc() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+/** Cycles of the enclosing block, added to its section when the block exits.
+**/
+struct profile_scope {
+    int section;
+    uint64_t start;
+    profile_scope(int section) noexcept: section{section}, start{profile_tsc()} {}
+    ~profile_scope() {
+        profile_add(section, profile_tsc() - start);
+    }
+};
+
+/** Count the rest of the enclosing block in a section, at most once per block.
+ * @param section One of 'PROFILE_*'
+**/
+#define PROFILE(section) \
+    struct profile_scope profile_guard{(section)}
+
+#else
+
+#define PROFILE(section) \
+    do {} while (0)
+
+#endif
@@ -0,0 +1,244 @@
+/**
+ * @file   region.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Shared memory region and segment bookkeeping, common to every engine.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <vector>
+
+// Internal headers
+#include <tm.hpp>
+#include <tm_ext.hpp>
+#include "common.hpp"
+#include "contention.hpp"
+#include "numa.hpp"
+#ifdef USE_SNZI
+#include "snzi.hpp"
+#endif
+
+// -------------------------------------------------------------------------- //
+
+// Segments are laid out on whole pages, so that every page belongs to at most one segment
+#define SEGMENT_PAGE_LOG2 12
+// Two-level page map covering a 48-bit address space
+#define PAGEMAP_LEAF_LOG2 18
+#define PAGEMAP_ROOT_LOG2 (48 - SEGMENT_PAGE_LOG2 - PAGEMAP_LEAF_LOG2)
+
+// Origin of the block of a segment
+#define BLOCK_HEAP    0 // Aligned allocation of the C library
+#define BLOCK_SLAB    1 // Heap block recycled through the slabs
+#define BLOCK_MAPPED  2 // Anonymous mapping, for blocks too large for the slabs
+#define BLOCK_FOREIGN 3 // Owned by something else, e.g. the file mapping of a durable region
+#define BLOCK_ARENA   4 // Part of an arena of segments moved together by 'tm_compact', unmapped with the last of them
+#define BLOCK_PACKED  5 // Slot of a pack of small segments sharing their pages, with USE_PACKS
+
+// Maximum number of transactions simultaneously announced in the epoch table
+#define EPOCH_SLOTS 128
+// Number of retired objects above which exiting transactions try to reclaim them
+#define EPOCH_BATCH 32
+
+// Handle of the serial irrevocable transaction, neither an aligned descriptor nor a read-only handle
+#define IRREVOCABLE_TX ((tx_t) 2)
+// Counters of the serial irrevocable transaction, which holds no epoch slot
+#define IRREVOCABLE_SLOT EPOCH_SLOTS
+
+/** Object waiting for every transaction that may still access it to exit.
+**/
+struct retired {
+    struct retired* next;
+    uint64_t epoch;               // Epoch at which the object was retired
+    void (*destroy)(void*);       // Called on 'object' once reclaimed
+    void* object;
+};
+
+struct segment_arena;
+struct segment_pack;
+
+/** Lock of a segment in the pessimistic engine, see 'snzi.hpp'.
+**/
+#ifdef USE_SNZI
+using segment_lock = struct snzi_lock;
+#else
+using segment_lock = std::shared_mutex;
+#endif
+
+/** Segment header, stored right in front of the segment memory, or among the headers of its pack (see 'USE_PACKS').
+ * The fields every lookup reads never change, the ones the pessimistic engine writes are on lines of their own.
+**/
+struct segment {
+    std::byte* mem;
+    size_t size;
+    int node; // NUMA node the memory was placed on, -1 if spread over every node
+    size_t block; // Size of the block holding the header and the memory
+    int source;   // Where the block goes back to, one of 'BLOCK_*'
+    struct segment_arena* arena; // Arena holding the block (only 'BLOCK_ARENA')
+    struct segment_pack* pack;   // Pack holding the slot (only 'BLOCK_PACKED')
+    std::atomic<uint64_t>* dirty; // Ranges of TM_DIRTY_LOG2 bytes written since the last checkpoint, one bit each, after the memory (NULL if foreign)
+    alignas(CACHE_LINE) segment_lock lock; // Segment lock (only used by the pessimistic engine)
+    bool freed;
+    struct retired retired;
+    alignas(CACHE_LINE) std::atomic<uint64_t> version; // Segment version (only used by the pessimistic engine)
+};
+
+using pagemap_leaf = std::atomic<struct segment*>;
+
+/** One announcement of the epoch table, 0 when unused.
+**/
+struct alignas(CACHE_LINE) epoch_slot {
+    std::atomic<uint64_t> epoch;
+    std::atomic<uint64_t> exits; // Transactions that withdrew from the slot, so that 'tm_end_private' tells them from later ones
+};
+
+/** Counters of the transactions announced in one epoch slot, see 'counter_add'.
+**/
+struct alignas(CACHE_LINE) tx_counters {
+    std::atomic<uint64_t> commits;
+    std::atomic<uint64_t> aborts[TM_ABORT_REASONS];
+    std::atomic<uint64_t> reads;
+    std::atomic<uint64_t> writes;
+    std::atomic<uint64_t> allocs;
+    std::atomic<uint64_t> frees;
+    std::atomic<uint64_t> extensions;
+    std::atomic<uint64_t> irrevocable;
+    std::atomic<uint64_t> descriptor; // Bytes of the descriptor and logs kept by the thread of the slot, set as its transactions end
+};
+
+struct engine;
+
+/** Shared memory region, the fields set at creation come first and the ones written concurrently each get their own lines.
+**/
+struct region {
+    void* start;
+    size_t size;
+    size_t align;
+    struct engine const* ops; // Engine the region was created with
+    void* engine;   // Engine-specific state, owned by the engine
+    void* adaptive; // State of the adaptive engine, which switches 'engine' between the states of its engines
+    std::atomic<pagemap_leaf*>* pagemap[NUMA_MAX_NODES]; // Page number to owning segment, this is the segment registry
+    size_t replicas; // Number of copies of the page map, one per NUMA node so that lookups stay local
+    bool placed;     // Whether the memory is placed on the NUMA nodes, otherwise the kernel places it
+    int hugepages;   // Backing of the mapped blocks of the segments, see 'TM_HUGEPAGES'
+    size_t stripes;  // Stripes of the tl2 lock table, which then keeps that size, 0 to size it for the live segments
+    size_t versions; // Values kept per tl2 stripe, with USE_MULTIVERSION
+    size_t stream;   // Bytes of buffered writes from which commits publish with non-temporal stores, 0 for never, see 'TM_STREAM'
+    alignas(CACHE_LINE) std::atomic<uint64_t> epoch; // Global epoch, incremented whenever an object is retired
+    alignas(CACHE_LINE) std::atomic<struct retired*> retired; // Objects some transaction may still access, e.g. unregistered segments
+    std::atomic<size_t> pending; // Number of objects in 'retired', reclaimed by batches
+    alignas(CACHE_LINE) struct contention cm;
+    alignas(CACHE_LINE) struct numa_stats numa;
+    alignas(CACHE_LINE) std::atomic<bool> serial; // Whether the region is quiesced (see 'region_quiesce'), or a thread waits for it
+    std::atomic<size_t> live; // Bytes of the registered segments, for engines sizing their metadata
+    std::atomic<size_t> overhead; // Bytes of the page map and of the segment blocks beyond their memory, for 'tm_stats'
+    std::atomic<bool> tracking; // Whether writes mark the 'dirty' bits, i.e. they are complete since the last checkpoint
+#ifdef USE_RECLAIMER
+    struct reclaimer* reclaimer; // Service thread reclaiming the retired objects, NULL if it could not start
+#endif
+#ifdef USE_HEATMAP
+    struct heatmap* heatmap; // Conflicts by word and segment, NULL if out of memory
+#endif
+#ifdef USE_WATCHDOG
+    struct watchdog* watchdog; // Service thread reporting the starving transactions, NULL if off or it could not start
+#endif
+#ifdef USE_PACKS
+    struct segment_packs* packs; // Packs of the small segments by size class, NULL if out of memory
+#endif
+    struct persist* persist; // File backing the first segment, NULL for a volatile region
+    struct shm* shm; // Object holding the first segment and the tl2 lock table, NULL for a region private to the process
+    struct ship* ship; // Stream of the commits to a replica, NULL if not shipped
+    alignas(CACHE_LINE) std::atomic<uint64_t> members[EPOCH_SLOTS / 64]; // Dense thread indices taken by 'tm_thread_enter', one bit each
+    struct epoch_slot slots[EPOCH_SLOTS];
+    struct tx_counters counters[EPOCH_SLOTS + 1]; // Statistics, summed up by 'tm_stats', the last ones for 'IRREVOCABLE_SLOT'
+};
+
+struct segment* segment_create(struct region*, size_t) noexcept;
+struct segment* segment_adopt(struct region*, std::byte*, std::byte*, size_t) noexcept;
+void segment_destroy(struct segment*) noexcept;
+void segment_register(struct region*, struct segment*) noexcept;
+void segment_unregister(struct region*, struct segment*) noexcept;
+void segment_retire(struct region*, struct segment*) noexcept;
+struct segment* segment_find(struct region*, void const*) noexcept;
+#ifdef USE_NUMA_SHARDS
+int segment_node(struct region*, void const*) noexcept;
+#endif
+void epoch_retire(struct region*, struct retired*) noexcept;
+size_t epoch_enter(struct region*) noexcept;
+void epoch_exit(struct region*, size_t) noexcept;
+size_t thread_index() noexcept;
+bool region_quiesce(struct region*, bool) noexcept;
+void region_resume(struct region*) noexcept;
+
+/** Tell whether a range lies in one of the segments a transaction allocated, which no other transaction can reach before it commits.
+ * Engines access such a range in place, with neither locks nor logs: an abort destroys the segment with whatever it holds.
+ * @param allocs Segments allocated by the transaction
+ * @param addr   Start of the range
+ * @param size   Length of the range (in bytes)
+ * @param from   Index of the first segment to consider, the earlier ones being accessed as any other
+ * @return Whether the range is private to the transaction
+**/
+static inline bool segment_captured(std::vector<struct segment*> const& allocs, void const* addr, size_t size, size_t from = 0) noexcept {
+    for (size_t i = from; i < allocs.size(); ++i){
+        struct segment* seg = allocs[i];
+        if ((std::byte const*) addr >= seg->mem && (std::byte const*) addr + size <= seg->mem + seg->size){
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Build the handle of a read-only transaction, which has no descriptor: the handle holds its snapshot and epoch slot.
+ * Descriptors are aligned, so the lowest bit tells the two kinds of handles apart.
+ * @param rv   Snapshot of the transaction
+ * @param slot Epoch slot of the transaction
+ * @return Handle
+**/
+static inline tx_t ro_tx(uint64_t rv, size_t slot) noexcept {
+    static_assert(EPOCH_SLOTS <= 128, "the slot of a read-only transaction is stored on 7 bits");
+    return (tx_t) ((rv << 8) | (slot << 1) | 1);
+}
+
+/** Tell whether a handle is the one of a read-only transaction.
+ * @param tx Transaction handle
+ * @return Whether the handle was built by 'ro_tx'
+**/
+static inline bool is_ro_tx(tx_t tx) noexcept {
+    return (tx & 1) != 0;
+}
+
+/** Get the snapshot of a read-only transaction.
+ * @param tx Handle built by 'ro_tx'
+ * @return Snapshot
+**/
+static inline uint64_t ro_tx_rv(tx_t tx) noexcept {
+    return (uint64_t) tx >> 8;
+}
+
+/** Get the epoch slot of a read-only transaction.
+ * @param tx Handle built by 'ro_tx'
+ * @return Epoch slot
+**/
+static inline size_t ro_tx_slot(tx_t tx) noexcept {
+    return (size_t) (tx >> 1) & 127;
+}
+
+/** Add to a counter of the epoch slot of a running transaction.
+ * Only the transaction holding the slot writes its counters, so no atomic read-modify-write is needed.
+ * @param counter Counter of 'region->counters[slot]' to update
+ * @param value   Value to add
+**/
+static inline void counter_add(std::atomic<uint64_t>& counter, uint64_t value) noexcept {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
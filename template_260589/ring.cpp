@@ -0,0 +1,467 @@
+/**
+ * @file   ring.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * RingSTM-style engine: no per-word metadata, but a ring holding the write
+ * filter of each of the last TM_RING_SIZE commits, a Bloom filter of the
+ * words it wrote. A transaction only keeps the filter of the words it read;
+ * whenever another transaction committed since its snapshot, it ANDs its
+ * filter with the ones of the commits in between, and moves its snapshot
+ * forward if none intersects. Writes are buffered and published in 'tm_end'
+ * while holding a sequence lock, as with 'norec', after the commit wrote its
+ * filter in the ring.
+ *
+ * Read-only transactions validate the same way, so that neither logs a word
+ * it read: a read costs setting one bit, and a validation a few filter ANDs
+ * per commit, whatever the read set. In exchange the filters make for false
+ * conflicts once read sets hold a good part of TM_RING_FILTER_BITS words, and
+ * a transaction that fell behind by more than TM_RING_SIZE commits aborts.
+**/
+
+// External headers
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <sched.h>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "engine.hpp"
+#include "percpu.hpp"
+#include "persist.hpp"
+#include "profile.hpp"
+#include "region.hpp"
+#include "ship.hpp"
+#include "trace.hpp"
+#include "word.hpp"
+#include "writeset.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+namespace ring {
+
+static_assert((TM_RING_SIZE & (TM_RING_SIZE - 1)) == 0, "TM_RING_SIZE must be a power of 2");
+static_assert(TM_RING_FILTER_BITS >= 64 && (TM_RING_FILTER_BITS & (TM_RING_FILTER_BITS - 1)) == 0, "TM_RING_FILTER_BITS must be a power of 2, at least 64");
+
+// Words of a filter
+#define FILTER_WORDS (TM_RING_FILTER_BITS / 64)
+
+/** Bloom filter of words of the shared memory, one bit per word.
+**/
+struct filter {
+    uint64_t bits[FILTER_WORDS];
+};
+
+/** Write filter of one commit in the ring, never across two lines.
+**/
+struct alignas(CACHE_LINE) entry {
+    atomic<uint64_t> stamp; // Timestamp of the commit the filter is of, 0 while a later commit rewrites it
+    struct filter writes;
+};
+
+struct alignas(CACHE_LINE) state {
+    atomic<uint64_t> seq; // Sequence lock, twice the timestamp of the last commit, plus one while a commit publishes its writes
+    size_t shift;         // Log2 of the alignment, the bits of a word address that tell nothing
+    struct entry* ring;   // Write filters of the last commits, the one of timestamp 't' at 't' modulo TM_RING_SIZE
+};
+
+/** Transaction descriptor, on lines of its own so that the descriptors of different threads never share one.
+**/
+struct alignas(CACHE_LINE) transaction {
+    struct region* region;
+    size_t slot;       // Epoch table slot
+    uint64_t snapshot; // Value of the sequence lock the reads are consistent with
+    bool is_ro;
+    struct filter reads; // Words read
+    struct write_set writes;
+    vector<struct segment*> allocs;
+    vector<struct segment*> frees;
+};
+
+//================================================================
+//Helper functions
+//================================================================
+
+/** Get the bit of a word in the filters.
+ * @param st   Engine state
+ * @param addr Word in the shared memory
+ * @return Index of the bit
+**/
+static inline size_t filter_bit(struct state* st, void const* addr) {
+    uint64_t word = (uintptr_t) addr >> st->shift;
+    //the multiplication mixes the low bits into the high ones, consecutive words spread over the filter
+    return (word * UINT64_C(0x9e3779b97f4a7c15)) >> (64 - __builtin_ctzl(TM_RING_FILTER_BITS));
+}
+
+/** Add a word to a filter.
+ * @param st     Engine state
+ * @param filter Filter to add to
+ * @param addr   Word in the shared memory
+**/
+static inline void filter_add(struct state* st, struct filter* filter, void const* addr) {
+    size_t bit = filter_bit(st, addr);
+    filter->bits[bit / 64] |= UINT64_C(1) << (bit % 64);
+}
+
+/** Check a filter has no bit in common with the write filter of a commit in the ring.
+ * @param st     Engine state
+ * @param stamp  Timestamp of the commit, published already
+ * @param filter Filter to check
+ * @return Whether the filters are disjoint, false too if a later commit took the entry over
+**/
+static bool filter_disjoint(struct state* st, uint64_t stamp, struct filter const* filter) {
+    struct entry& entry = st->ring[stamp & (TM_RING_SIZE - 1)];
+    if (entry.stamp.load(memory_order_acquire) != stamp){
+        return false;
+    }
+    //one AND per word, which the compiler turns into vector ones
+    uint64_t common = 0;
+    for (size_t i = 0; i < FILTER_WORDS; ++i){
+        common |= entry.writes.bits[i] & filter->bits[i];
+    }
+    atomic_thread_fence(memory_order_acquire);
+    //what was ANDed is the filter of that commit only if the entry still holds it
+    return common == 0 && entry.stamp.load(memory_order_relaxed) == stamp;
+}
+
+/** Wait for the sequence lock to be free.
+ * @param st Engine state
+ * @return Value of the free sequence lock
+**/
+static uint64_t wait_free(struct state* st) {
+    uint64_t time = st->seq.load(memory_order_acquire);
+    while (time & 1){
+        sched_yield();
+        time = st->seq.load(memory_order_acquire);
+    }
+    return time;
+}
+
+/** Check none of the commits since the snapshot of the transaction wrote a word it read, and move its snapshot forward.
+ * @param st    Engine state
+ * @param trans Transaction to validate
+ * @return Whether the read set is still valid
+**/
+static bool validate(struct state* st, struct transaction* trans) {
+    PROFILE(PROFILE_LOCK);
+    //the filters of the commits up to a free sequence lock are all in the ring
+    uint64_t time = wait_free(st);
+    for (uint64_t stamp = trans->snapshot / 2 + 1; stamp <= time / 2; ++stamp){
+        if (!filter_disjoint(st, stamp, &trans->reads)){
+            return false;
+        }
+    }
+    trans->snapshot = time;
+    counter_add(trans->region->counters[trans->slot].extensions, 1);
+    return true;
+}
+
+/** Write the write filter of a commit holding the sequence lock in its entry of the ring.
+ * @param st    Engine state
+ * @param trans Transaction committing
+ * @param stamp Timestamp of the commit
+**/
+static void ring_publish(struct state* st, struct transaction* trans, uint64_t stamp) {
+    struct entry& entry = st->ring[stamp & (TM_RING_SIZE - 1)];
+    //readers still ANDing the filter of the commit TM_RING_SIZE earlier see it change
+    entry.stamp.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memset(entry.writes.bits, 0, sizeof(entry.writes.bits));
+    for (auto const& written : trans->writes.entries){
+        filter_add(st, &entry.writes, written.location);
+    }
+    entry.stamp.store(stamp, memory_order_release);
+}
+
+/** Descriptor kept between transactions by each thread, or by each CPU with USE_RSEQ, so that its vectors keep their capacity.
+**/
+static percpu_spare<struct transaction> spare;
+
+/** Get the bytes a descriptor holds, the unused capacity of its vectors included.
+ * @param trans Transaction descriptor
+ * @return Size (in bytes)
+**/
+static size_t footprint(struct transaction const* trans){
+    return sizeof(*trans) + writeset_footprint(&trans->writes) + (trans->allocs.capacity() + trans->frees.capacity()) * sizeof(struct segment*);
+}
+
+/** Release the epoch slot of the transaction and recycle its descriptor.
+ * @param trans Transaction to finish
+**/
+static void finish(struct transaction* trans){
+    trans->region->counters[trans->slot].descriptor.store(footprint(trans), memory_order_relaxed);
+    epoch_exit(trans->region, trans->slot);
+    memset(trans->reads.bits, 0, sizeof(trans->reads.bits));
+    writeset_clear(&trans->writes);
+    trans->allocs.clear();
+    trans->frees.clear();
+    if (!spare.keep(trans)){
+        delete trans;
+    }
+}
+
+/** Undo what a transaction did and release its descriptor.
+ * @param tx     Transaction to abort
+ * @param reason Reason of the abort, one of 'TM_ABORT_*'
+**/
+static void rollback(tx_t tx, int reason){
+    PROFILE(PROFILE_ROLLBACK);
+    struct transaction* trans = (struct transaction*) tx;
+    counter_add(trans->region->counters[trans->slot].aborts[reason], 1);
+    TRACE_REASON(reason);
+    //rolling back allocs, nothing was published
+    for (auto seg : trans->allocs){
+        segment_destroy(seg);
+    }
+    //the retry likely writes the same words
+    for (auto const& entry : trans->writes.entries){
+        cm_predict(&trans->region->cm, entry.location);
+    }
+    cm_abort(&trans->region->cm, trans->writes.entries.size());
+    finish(trans);
+}
+
+//================================================================
+// End of Helper functions
+//================================================================
+
+bool create(shared_t shared) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = new (std::nothrow) struct state();
+    if (unlikely(st == NULL)){
+        return false;
+    }
+    st->ring = new (std::nothrow) struct entry[TM_RING_SIZE]();
+    if (unlikely(st->ring == NULL)){
+        delete st;
+        return false;
+    }
+    st->seq.store(0, memory_order_relaxed);
+    st->shift = __builtin_ctzl(region->align);
+    region->engine = st;
+    return true;
+}
+
+void destroy(shared_t shared) noexcept {
+    struct state* st = (struct state*) ((struct region*) shared)->engine;
+    delete[] st->ring;
+    delete st;
+}
+
+tx_t begin(shared_t shared, bool is_ro) noexcept {
+    struct region* region = (struct region*) shared;
+    struct transaction* trans = spare.take();
+    if (unlikely(trans == NULL)){
+        trans = new (std::nothrow) struct transaction();
+        if (unlikely(trans == NULL)){
+            return invalid_tx;
+        }
+    }
+    trans->region = region;
+    cm_begin(&region->cm);
+    trans->is_ro = is_ro;
+    //announce before taking the snapshot, so that what it reaches stays allocated
+    trans->slot = epoch_enter(region);
+    trans->snapshot = wait_free((struct state*) region->engine);
+    return (tx_t) trans;
+}
+
+bool end(shared_t shared, tx_t tx) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    struct transaction* trans = (struct transaction*) tx;
+
+    //every read was consistent with the snapshot, nothing to publish
+    if (trans->is_ro || (trans->writes.entries.empty() && trans->frees.empty())){
+        for (auto seg : trans->allocs){
+            segment_register(region, seg);
+        }
+        cm_commit(&region->cm);
+        counter_add(region->counters[trans->slot].commits, 1);
+        finish(trans);
+        return true;
+    }
+
+    //take the sequence lock, provided the reads are still valid
+    cm_yield(&region->cm);
+    uint64_t time = trans->snapshot;
+    while (!st->seq.compare_exchange_strong(time, time + 1, memory_order_acquire, memory_order_relaxed)){
+        if (!validate(st, trans)){
+            rollback(tx, TM_ABORT_VALIDATE);
+            return false;
+        }
+        time = trans->snapshot;
+    }
+
+    //nobody else publishes until the sequence lock is released, the log follows the commit order
+    if (unlikely(region->persist != NULL) && !persist_commit(region, &trans->writes)){
+        st->seq.store(time, memory_order_release);
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    if (unlikely(region->ship != NULL)){
+        ship_commit(region, &trans->writes);
+    }
+    ring_publish(st, trans, time / 2 + 1);
+    writeset_publish(&trans->writes, region->align, region->stream);
+    for (auto seg : trans->allocs){
+        segment_register(region, seg);
+    }
+    for (auto seg : trans->frees){
+        segment_unregister(region, seg);
+        segment_retire(region, seg);
+    }
+    st->seq.store(time + 2, memory_order_release);
+    cm_commit(&region->cm);
+    counter_add(region->counters[trans->slot].commits, 1);
+    finish(trans);
+    return true;
+}
+
+bool read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    struct transaction* trans = (struct transaction*) tx;
+    size_t align = region->align;
+
+    counter_add(region->counters[trans->slot].reads, 1);
+    if (segment_captured(trans->allocs, source, size)){
+        words_copy(target, source, size, align);
+        return true;
+    }
+    for (size_t i = 0; i < size; i += align){
+        byte const* src = (byte const*) source + i;
+        byte* dst = (byte*) target + i;
+        struct write_entry* written = NULL;
+        if (!trans->is_ro){
+            //read-after-write, return the buffered value
+            written = writeset_find(&trans->writes, src);
+            if (written != NULL && !written->delta){
+                word_copy(dst, trans->writes.data.data() + written->offset, align);
+                continue;
+            }
+        }
+        {
+            PROFILE(PROFILE_LOG);
+            filter_add(st, &trans->reads, src);
+        }
+        word_copy(dst, src, align);
+        atomic_thread_fence(memory_order_acquire);
+        //somebody committed, the value is only good if the snapshot can be moved forward
+        while (st->seq.load(memory_order_relaxed) != trans->snapshot){
+            if (!validate(st, trans)){
+                rollback(tx, TM_ABORT_READ);
+                return false;
+            }
+            word_copy(dst, src, align);
+            atomic_thread_fence(memory_order_acquire);
+        }
+        if (written != NULL){
+            //incremented before, the increment now depends on the value read
+            writeset_fold(&trans->writes, written, dst, align);
+        }
+    }
+    return true;
+}
+
+bool write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    size_t align = region->align;
+    struct transaction* trans = (struct transaction*) tx;
+
+    counter_add(region->counters[trans->slot].writes, 1);
+    if (segment_captured(trans->allocs, target, size)){
+        words_copy(target, source, size, align);
+        return true;
+    }
+    for (size_t i = 0; i < size; i += align){
+        writeset_add(&trans->writes, (byte*) target + i, (byte const*) source + i, align);
+    }
+    return true;
+}
+
+bool add(shared_t shared, tx_t tx, void* target, int64_t delta) noexcept {
+    struct region* region = (struct region*) shared;
+    struct transaction* trans = (struct transaction*) tx;
+
+    //no read, the increment applies to the value in memory at commit, under the sequence lock
+    counter_add(region->counters[trans->slot].writes, 1);
+    if (segment_captured(trans->allocs, target, region->align)){
+        word_add(target, delta);
+        return true;
+    }
+    writeset_add_delta(&trans->writes, (byte*) target, delta, region->align);
+    return true;
+}
+
+void release(shared_t shared as(unused), tx_t tx as(unused), void const* source as(unused), size_t size as(unused)) noexcept {
+    //a filter cannot forget a word, other words may share its bit
+}
+
+Alloc alloc(shared_t shared, tx_t tx, size_t size, void** target) noexcept {
+    struct segment* seg = segment_create((struct region*) shared, size);
+    if (unlikely(seg == NULL)){
+        return Alloc::nomem;
+    }
+    //private until commit, registered only if the transaction commits
+    struct transaction* trans = (struct transaction*) tx;
+    trans->allocs.push_back(seg);
+    counter_add(trans->region->counters[trans->slot].allocs, 1);
+    *target = (void*) seg->mem;
+    return Alloc::success;
+}
+
+bool dealloc(shared_t shared, tx_t tx, void* target) noexcept {
+    struct transaction* trans = (struct transaction*) tx;
+    for (auto it = trans->allocs.begin(); it != trans->allocs.end(); ++it){
+        //allocated by this very transaction, nobody else can see it
+        if ((*it)->mem == target){
+            segment_destroy(*it);
+            trans->allocs.erase(it);
+            counter_add(trans->region->counters[trans->slot].frees, 1);
+            return true;
+        }
+    }
+    struct segment* seg = segment_find((struct region*) shared, target);
+    if (seg == NULL || seg->mem != target){
+        //not the start of a live segment (e.g. freed concurrently), abort
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    counter_add(trans->region->counters[trans->slot].frees, 1);
+    for (auto other : trans->frees){
+        if (other == seg){
+            return true;
+        }
+    }
+    trans->frees.push_back(seg);
+    return true;
+}
+
+/** Allocate the descriptor of the calling thread ahead of its first transaction, on its NUMA node.
+ * @param shared Region the thread entered
+**/
+void thread_enter(shared_t shared as(unused)) noexcept {
+    spare.prepare();
+}
+
+/** Free the descriptor the calling thread kept between its transactions.
+ * @param shared Region the thread leaves
+**/
+void thread_leave(shared_t shared as(unused)) noexcept {
+    spare.drop();
+}
+
+}
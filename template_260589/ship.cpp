@@ -0,0 +1,281 @@
+/**
+ * @file   ship.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Commit buffer and shipper thread of the regions shipped to a replica, and
+ * the replay of a stream on the replica.
+**/
+
+// External headers
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <unistd.h>
+
+// Internal headers
+#include "common.hpp"
+#include "region.hpp"
+#include "ship.hpp"
+#include "word.hpp"
+#include "writeset.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+/** Write a whole buffer, however many calls it takes.
+ * @param fd   Descriptor to write to
+ * @param src  Start of the buffer
+ * @param size Length of the buffer
+ * @return Whether everything was written
+**/
+static bool write_all(int fd, byte const* src, size_t size) {
+    while (size > 0){
+        ssize_t done = write(fd, src, size);
+        if (done < 0 && errno == EINTR){
+            continue;
+        }
+        if (done <= 0){
+            return false;
+        }
+        src += done;
+        size -= done;
+    }
+    return true;
+}
+
+/** Read a whole buffer, however many calls it takes.
+ * @param fd   Descriptor to read from
+ * @param dst  Start of the buffer
+ * @param size Length of the buffer
+ * @return Whether everything was read, false at the end of the stream or on error
+**/
+static bool read_all(int fd, byte* dst, size_t size) {
+    while (size > 0){
+        ssize_t done = read(fd, dst, size);
+        if (done < 0 && errno == EINTR){
+            continue;
+        }
+        if (done <= 0){
+            return false;
+        }
+        dst += done;
+        size -= done;
+    }
+    return true;
+}
+
+/** Body of the shipper thread: write the pending records every period, until the region is destroyed.
+ * @param arg Region shipped
+ * @return NULL
+**/
+static void* ship_run(void* arg) {
+    struct ship* s = ((struct region*) arg)->ship;
+    //a replica gone fails the writes instead of killing the process
+    sigset_t pipe;
+    sigemptyset(&pipe);
+    sigaddset(&pipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe, NULL);
+    bool broken = false;
+    unique_lock<mutex> guard(s->lock);
+    while (true){
+        s->wake.wait_for(guard, chrono::microseconds(TM_SHIP_PERIOD), [s] { return s->stop; });
+        s->batch.swap(s->pending);
+        bool stop = s->stop;
+        bool lost = s->lost;
+        guard.unlock();
+        if (lost && !broken){
+            //the replica has to stop here
+            struct ship_record gap = {0, SHIP_GAP, 0};
+            s->batch.insert(s->batch.end(), (byte const*) &gap, (byte const*) (&gap + 1));
+        }
+        if (!broken && !s->batch.empty()){
+            broken = !write_all(s->fd, s->batch.data(), s->batch.size()) || lost;
+        }
+        s->batch.clear();
+        guard.lock();
+        if (broken){
+            //nothing more is worth buffering
+            s->lost = true;
+        }
+        if (stop){
+            break;
+        }
+    }
+    return NULL;
+}
+
+/** Start shipping the commits of a region, its first segment created.
+ * @param region Region to ship
+ * @param path   File (truncated) or pipe to write the stream to, a pipe waiting for the replica to open it
+ * @return Whether the shipper started
+**/
+bool ship_open(struct region* region, char const* path) noexcept {
+    struct ship* s = new (std::nothrow) struct ship();
+    if (unlikely(s == NULL)){
+        return false;
+    }
+    s->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (unlikely(s->fd < 0)){
+        delete s;
+        return false;
+    }
+    s->data = (byte*) region->start;
+    s->data_size = region->size;
+    s->timestamp = 0;
+    s->lost = false;
+    s->stop = false;
+    region->ship = s;
+    if (unlikely(pthread_create(&s->thread, NULL, ship_run, region) != 0)){
+        close(s->fd);
+        delete s;
+        region->ship = NULL;
+        return false;
+    }
+    return true;
+}
+
+/** Ship the last commits, then stop the shipper of a region with no running transaction.
+ * @param region Region shipped
+**/
+void ship_close(struct region* region) noexcept {
+    struct ship* s = region->ship;
+    {
+        lock_guard<mutex> guard(s->lock);
+        s->stop = true;
+        s->wake.notify_one();
+    }
+    pthread_join(s->thread, NULL);
+    close(s->fd);
+    delete s;
+    region->ship = NULL;
+}
+
+/** [thread-safe] Append the records of committing transactions, before their writes are published in place.
+ * The transactions must hold what keeps the written words from changing, e.g. their locks, and write disjoint words.
+ * @param region Shipped region
+ * @param sets   Write sets about to be published, words outside of the first segment are not shipped
+ * @param count  Number of write sets
+**/
+void ship_commit_batch(struct region* region, struct write_set* const* sets, size_t count) noexcept {
+    struct ship* s = region->ship;
+    size_t align = region->align;
+    //built before taking the lock, which only covers the copy
+    static thread_local vector<byte> records;
+    records.clear();
+    for (size_t i = 0; i < count; ++i){
+        struct write_set* ws = sets[i];
+        struct ship_record header = {0, 0, (uint32_t) align};
+        size_t start = records.size();
+        records.insert(records.end(), (byte const*) &header, (byte const*) (&header + 1));
+        for (auto const& entry : ws->entries){
+            if (entry.location < s->data || entry.location >= s->data + s->data_size){
+                continue;
+            }
+            uint64_t offset = entry.location - s->data;
+            records.insert(records.end(), (byte const*) &offset, (byte const*) (&offset + 1));
+            size_t at = records.size();
+            records.resize(at + align);
+            if (entry.delta){
+                //the new content is the one in place plus the increment
+                int64_t delta;
+                memcpy(&delta, ws->data.data() + entry.offset, sizeof(delta));
+                word_copy(records.data() + at, entry.location, align);
+                word_add(records.data() + at, delta);
+            } else {
+                word_copy(records.data() + at, ws->data.data() + entry.offset, align);
+            }
+            ++header.words;
+        }
+        if (header.words == 0){
+            records.resize(start);
+            continue;
+        }
+        memcpy(records.data() + start, &header, sizeof(header));
+    }
+    if (records.empty()){
+        return;
+    }
+    lock_guard<mutex> guard(s->lock);
+    if (unlikely(s->lost || s->pending.size() + records.size() > TM_SHIP_BUFFER)){
+        s->lost = true;
+        return;
+    }
+    //timestamps in the order of the buffer, i.e. the commit order
+    size_t start = s->pending.size();
+    s->pending.insert(s->pending.end(), records.begin(), records.end());
+    for (size_t at = start; at < s->pending.size();){
+        struct ship_record header;
+        memcpy(&header, s->pending.data() + at, sizeof(header));
+        header.timestamp = ++s->timestamp;
+        memcpy(s->pending.data() + at, &header, sizeof(header));
+        at += sizeof(header) + header.words * (sizeof(uint64_t) + align);
+    }
+}
+
+/** [thread-safe] Append the records of a committing transaction, before its writes are published in place.
+ * The transaction must hold what keeps the written words from changing, e.g. its locks.
+ * @param region Shipped region
+ * @param ws     Write set about to be published, words outside of the first segment are not shipped
+**/
+void ship_commit(struct region* region, struct write_set* ws) noexcept {
+    ship_commit_batch(region, &ws, 1);
+}
+
+/** Apply a stream of commits to a replica, one transaction per commit, until the stream ends.
+ * @param region Replica, whose first segment has the size and alignment of the one of the shipped region
+ * @param fd     Descriptor to read the stream from
+ * @return Whether the stream ended with every commit applied, false after a gap or an invalid record
+**/
+bool ship_apply(struct region* region, int fd) noexcept {
+    shared_t shared = (shared_t) region;
+    size_t align = region->align;
+    vector<byte> words;
+    uint64_t expected = 1;
+    struct ship_record header;
+    while (read_all(fd, (byte*) &header, sizeof(header))){
+        if (header.words == SHIP_GAP || header.align != align || header.timestamp != expected){
+            return false;
+        }
+        ++expected;
+        size_t record = sizeof(uint64_t) + align;
+        words.resize(header.words * record);
+        if (!read_all(fd, words.data(), words.size())){
+            return false;
+        }
+        for (size_t i = 0; i < header.words; ++i){
+            uint64_t offset;
+            memcpy(&offset, words.data() + i * record, sizeof(offset));
+            if (offset % align != 0 || offset >= region->size){
+                return false;
+            }
+        }
+        //the readers of the replica see every commit wholly or not at all
+        while (true){
+            tx_t tx = tm_begin(shared, false);
+            if (unlikely(tx == invalid_tx)){
+                return false;
+            }
+            bool done = true;
+            for (size_t i = 0; i < header.words && done; ++i){
+                uint64_t offset;
+                memcpy(&offset, words.data() + i * record, sizeof(offset));
+                done = tm_write(shared, tx, words.data() + i * record + sizeof(offset), align, (byte*) region->start + offset);
+            }
+            if (done && tm_end(shared, tx)){
+                break;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file   ship.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Shipping of the commits of a region to a replica ('tm_options::ship'):
+ * every commit appends the words it writes in the first segment to a buffer
+ * of the region, where the records from the durable log of 'persist.hpp' are
+ * taken, and a shipper thread writes the buffer to a file, pipe or socket in
+ * batches every TM_SHIP_PERIOD microseconds. A commit only copies its words,
+ * it never waits for the shipper nor for the replica. The records are
+ * appended in the commit order, each tagged with its timestamp, so that a
+ * replica applying them one by one ('tm_apply') goes through the same states
+ * as the region, and its read-only transactions read one of them. Segments
+ * allocated by transactions are not shipped. Once TM_SHIP_BUFFER bytes wait
+ * for the shipper, the stream ends with a gap: the replica stops there, and
+ * must be copied anew.
+**/
+
+#pragma once
+
+// External headers
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <pthread.h>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Bytes of records waiting for the shipper beyond which the stream ends
+#ifndef TM_SHIP_BUFFER
+    #define TM_SHIP_BUFFER (64ul << 20)
+#endif
+// Period of the shipper, in microseconds, i.e. the longest a commit waits to be shipped
+#ifndef TM_SHIP_PERIOD
+    #define TM_SHIP_PERIOD 1000
+#endif
+
+// Words of the record ending a stream that lost commits
+#define SHIP_GAP UINT32_MAX
+
+/** Header of the record of one commit, followed by 'words' times the offset of a word in the first segment (8 bytes) and its new content.
+**/
+struct ship_record {
+    uint64_t timestamp; // Commit timestamp, from 1 in the commit order
+    uint32_t words;     // Words written in the first segment, SHIP_GAP if commits were lost before this record
+    uint32_t align;     // Size of a word
+};
+
+/** Stream of the commits of a region.
+**/
+struct ship {
+    int fd;
+    std::byte* data;     // First segment
+    size_t data_size;
+    pthread_t thread;
+    std::mutex lock;
+    std::condition_variable wake; // Signaled to stop
+    std::vector<std::byte> pending; // Records the shipper did not take yet, under 'lock'
+    std::vector<std::byte> batch;   // Records being written by the shipper
+    uint64_t timestamp;  // Timestamp of the last commit, under 'lock'
+    bool lost;           // Whether a commit found no room left, under 'lock'
+    bool stop;           // Whether the region is being destroyed, under 'lock'
+};
+
+struct region;
+struct write_set;
+
+bool ship_open(struct region*, char const*) noexcept;
+void ship_close(struct region*) noexcept;
+void ship_commit(struct region*, struct write_set*) noexcept;
+void ship_commit_batch(struct region*, struct write_set* const*, size_t) noexcept;
+bool ship_apply(struct region*, int) noexcept;
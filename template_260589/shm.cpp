@@ -0,0 +1,294 @@
+/**
+ * @file   shm.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Creation, attachment and process table of the shared objects of the regions
+ * shared between processes. The object holds a header page (layout, clock and
+ * process table), then the lock table, then the memory of the first segment,
+ * each on whole pages. A process maps the segment memory right after a private
+ * page holding its own segment header.
+**/
+
+// External headers
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <new>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Internal headers
+#include "common.hpp"
+#include "region.hpp"
+#include "shm.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Set last by the creator, once the object is ready to be attached
+#define SHM_MAGIC UINT64_C(0x31786d7473686d74)
+// Attempts of an attaching process waiting for the creator to finish ('sched_yield' in between)
+#define SHM_WAITS 100000
+
+/** Start of a shared object, only offsets from its start.
+**/
+struct shm_header {
+    atomic<uint64_t> magic;
+    uint64_t size;       // Size of the first segment
+    uint64_t align;      // Alignment of the region
+    uint64_t stripes;    // Number of stripes of the lock table, a power of 2
+    uint64_t locks;      // Offset of the lock table
+    uint64_t data;       // Offset of the first segment
+    alignas(CACHE_LINE) atomic<uint64_t> clock; // Global version clock of tl2
+    alignas(CACHE_LINE) struct shm_process processes[SHM_PROCESSES];
+};
+
+//================================================================
+//Helper functions
+//================================================================
+
+/** Get the number of stripes of the lock table of a new object, which keeps its size.
+ * @return Number of stripes, 'TM_STRIPES' rounded up to a power of 2, or 1 << TM_STRIPES_LOG2
+**/
+static size_t stripe_count() {
+    char const* env = getenv("TM_STRIPES");
+    size_t wanted = env != NULL ? strtoul(env, NULL, 0) : 0;
+    if (wanted == 0){
+        return static_cast<size_t>(1) << TM_STRIPES_LOG2;
+    }
+    size_t count = 1;
+    while (count < wanted){
+        count <<= 1;
+    }
+    return count;
+}
+
+/** Create and lay out a new shared object, its name taken.
+ * @param fd    Descriptor of the empty object
+ * @param size  Size of the first segment
+ * @param align Alignment of the region
+ * @return Whether the object could be laid out
+**/
+static bool object_init(int fd, size_t size, size_t align) {
+    size_t page = static_cast<size_t>(1) << SEGMENT_PAGE_LOG2;
+    size_t stripes = stripe_count();
+    size_t header = (sizeof(struct shm_header) + page - 1) & ~(page - 1);
+    size_t locks = (stripes * sizeof(atomic<uint64_t>) + page - 1) & ~(page - 1);
+    size_t data = (size + page - 1) & ~(page - 1);
+    //the new object is zeroed, so are the clock, the locks and the process table
+    if (ftruncate(fd, header + locks + data) != 0){
+        return false;
+    }
+    void* map = mmap(NULL, header, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED){
+        return false;
+    }
+    struct shm_header* head = (struct shm_header*) map;
+    head->size = size;
+    head->align = align;
+    head->stripes = stripes;
+    head->locks = header;
+    head->data = header + locks;
+    head->magic.store(SHM_MAGIC, memory_order_release);
+    munmap(map, header);
+    return true;
+}
+
+/** Take an entry of the process table for this process, freeing the ones of dead processes.
+ * @param head Header of the object
+ * @return Entry, NULL if the table is full
+**/
+static struct shm_process* process_claim(struct shm_header* head) {
+    int32_t self = (int32_t) getpid();
+    for (auto& process : head->processes){
+        int32_t pid = process.pid.load(memory_order_acquire);
+        if (pid != 0 && kill(pid, 0) != 0 && errno == ESRCH){
+            //exited without detaching
+            if (process.pid.compare_exchange_strong(pid, 0, memory_order_acq_rel)){
+                process.threads.store(0, memory_order_relaxed);
+            }
+        }
+    }
+    for (auto& process : head->processes){
+        int32_t free = 0;
+        if (process.pid.compare_exchange_strong(free, self, memory_order_acq_rel)){
+            process.threads.store(0, memory_order_relaxed);
+            return &process;
+        }
+    }
+    return NULL;
+}
+
+//================================================================
+// End of Helper functions
+//================================================================
+
+/** Map the first segment of a region from a shared object, creating the object if it does not exist.
+ * @param region Region being created, with its alignment set
+ * @param name   Name of the object, as for 'shm_open'
+ * @param size   Size of the first segment, must match the object if it exists
+ * @return First segment, not registered yet, NULL on failure (e.g. an object of another size or alignment)
+**/
+struct segment* shm_attach(struct region* region, char const* name, size_t size) noexcept {
+    size_t page = static_cast<size_t>(1) << SEGMENT_PAGE_LOG2;
+    //the memory starts a page, which every alignment up to the page size divides
+    if (unlikely(region->align > page || sizeof(struct segment) > page)){
+        return NULL;
+    }
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0){
+        if (!object_init(fd, size, region->align)){
+            close(fd);
+            shm_unlink(name);
+            return NULL;
+        }
+    } else if (errno != EEXIST || (fd = shm_open(name, O_RDWR, 0600)) < 0){
+        return NULL;
+    }
+    //the creator may still be laying the object out
+    struct stat info;
+    size_t header = (sizeof(struct shm_header) + page - 1) & ~(page - 1);
+    for (size_t i = 0; fstat(fd, &info) == 0 && (size_t) info.st_size < header; ++i){
+        if (i == SHM_WAITS){
+            close(fd);
+            return NULL;
+        }
+        sched_yield();
+    }
+    void* map = mmap(NULL, header, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (unlikely(map == MAP_FAILED)){
+        close(fd);
+        return NULL;
+    }
+    struct shm_header* head = (struct shm_header*) map;
+    for (size_t i = 0; head->magic.load(memory_order_acquire) != SHM_MAGIC; ++i){
+        if (i == SHM_WAITS){
+            munmap(map, header);
+            close(fd);
+            return NULL;
+        }
+        sched_yield();
+    }
+    //the header and the lock table come before the segment memory
+    size_t mapped = head->data;
+    bool valid = head->size == size && head->align == region->align;
+    munmap(map, header);
+    if (!valid){
+        close(fd);
+        return NULL;
+    }
+    //a private page for the segment header, right before the segment memory
+    size_t data = (size + page - 1) & ~(page - 1);
+    struct shm* shm = new (std::nothrow) struct shm();
+    map = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    void* block = mmap(NULL, page + data, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bool mapped_all = shm != NULL && map != MAP_FAILED && block != MAP_FAILED
+        && mmap((byte*) block + page, data, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, mapped) != MAP_FAILED;
+    struct shm_process* self = mapped_all ? process_claim((struct shm_header*) map) : NULL;
+    struct segment* seg = self != NULL ? segment_adopt(region, (byte*) block, (byte*) block + page, size) : NULL;
+    if (unlikely(seg == NULL)){
+        if (self != NULL){
+            self->pid.store(0, memory_order_release);
+        }
+        if (block != MAP_FAILED){
+            munmap(block, page + data);
+        }
+        if (map != MAP_FAILED){
+            munmap(map, mapped);
+        }
+        delete shm;
+        close(fd);
+        return NULL;
+    }
+    shm->fd = fd;
+    shm->header = (struct shm_header*) map;
+    shm->header_size = mapped;
+    shm->block = (byte*) block;
+    shm->block_size = page + data;
+    shm->self = self;
+    region->shm = shm;
+    return seg;
+}
+
+/** Unmap the shared object of a region and leave its process table, with no running transaction and the first segment destroyed.
+ * The object stays, 'shm_unlink' removes it once no process uses it anymore.
+ * @param region Shared region
+**/
+void shm_detach(struct region* region) noexcept {
+    struct shm* shm = region->shm;
+    shm->self->threads.store(0, memory_order_relaxed);
+    shm->self->pid.store(0, memory_order_release);
+    munmap(shm->block, shm->block_size);
+    munmap(shm->header, shm->header_size);
+    close(shm->fd);
+    delete shm;
+    region->shm = NULL;
+}
+
+/** Get the clock of the tl2 engine, shared by every process.
+ * @param region Shared region
+ * @return Clock in the object
+**/
+atomic<uint64_t>* shm_clock(struct region* region) noexcept {
+    return &region->shm->header->clock;
+}
+
+/** Get the lock table of the tl2 engine, shared by every process.
+ * @param region  Shared region
+ * @param stripes Set to the number of stripes, a power of 2
+ * @return First lock
+**/
+atomic<uint64_t>* shm_locks(struct region* region, size_t* stripes) noexcept {
+    struct shm_header* head = region->shm->header;
+    *stripes = head->stripes;
+    return (atomic<uint64_t>*) ((byte*) head + head->locks);
+}
+
+/** [thread-safe] Count the calling thread among the ones of its process using the region.
+ * @param region Shared region
+ * @return Whether the thread was counted, i.e. the region is shared
+**/
+bool shm_register_thread(struct region* region) noexcept {
+    if (region->shm == NULL){
+        return false;
+    }
+    region->shm->self->threads.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+/** [thread-safe] Stop counting the calling thread, registered before.
+ * @param region Shared region
+**/
+void shm_unregister_thread(struct region* region) noexcept {
+    if (region->shm != NULL){
+        region->shm->self->threads.fetch_sub(1, memory_order_relaxed);
+    }
+}
+
+/** [thread-safe] Count the processes attached to the object of a region, and their registered threads.
+ * @param region    Shared region
+ * @param processes Set to the number of attached processes
+ * @param threads   Set to the number of registered threads
+**/
+void shm_count(struct region* region, uint64_t* processes, uint64_t* threads) noexcept {
+    *processes = 0;
+    *threads = 0;
+    for (auto const& process : region->shm->header->processes){
+        if (process.pid.load(memory_order_acquire) != 0){
+            ++*processes;
+            *threads += process.threads.load(memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * @file   shm.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Regions shared between processes, created by 'tm_create_shared': the first
+ * segment, the tl2 clock and the tl2 lock table live in one POSIX shared
+ * memory object, mapped at a different address in each process. The object
+ * only holds offsets, and locks are indexed by the offset of a word in the
+ * segment, so that every process maps a word to the same stripe. Everything
+ * else (page map, epochs, contention manager, statistics) is private to each
+ * process, which also keeps an entry in the process table of the object with
+ * the number of its threads registered by 'tm_register_thread'.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Entries of the process table of a shared object, i.e. most processes attached at once
+#define SHM_PROCESSES 64
+
+/** Process attached to a shared object.
+**/
+struct shm_process {
+    std::atomic<int32_t> pid;      // 0 when the entry is free
+    std::atomic<uint32_t> threads; // Threads of the process registered with 'tm_register_thread'
+};
+
+/** Mapping of a shared object in this process.
+**/
+struct shm {
+    int fd;
+    struct shm_header* header; // Start of the object, mapped with the lock table
+    size_t header_size;        // Length of that mapping
+    std::byte* block;          // Private page holding the segment header, followed by the mapped segment memory
+    size_t block_size;
+    struct shm_process* self;  // Entry of this process in the process table
+};
+
+struct region;
+struct segment;
+
+struct segment* shm_attach(struct region*, char const*, size_t) noexcept;
+void shm_detach(struct region*) noexcept;
+std::atomic<uint64_t>* shm_clock(struct region*) noexcept;
+std::atomic<uint64_t>* shm_locks(struct region*, size_t*) noexcept;
+bool shm_register_thread(struct region*) noexcept;
+void shm_unregister_thread(struct region*) noexcept;
+void shm_count(struct region*, uint64_t*, uint64_t*) noexcept;
@@ -0,0 +1,87 @@
+/**
+ * @file   simd.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Load-time selection of the vector kernels, empty unless built with
+ * USE_SIMD. On x86 each entry point is an 'ifunc': the dynamic loader calls
+ * its resolver once, before any constructor, and binds the entry point to the
+ * variant it returns, so that calls cost no more than those to any other
+ * function of the library. Elsewhere the entry points run the scalar variants.
+**/
+
+// Internal headers
+#include "common.hpp"
+#include "simd.hpp"
+
+#ifdef USE_SIMD
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+#if defined(__x86_64__) || defined(__i386__)
+
+using skip_reads_t = size_t (*)(void const*, size_t, size_t, uint64_t) noexcept;
+using skip_range_t = size_t (*)(atomic<uint64_t> const*, size_t, uint64_t) noexcept;
+
+extern "C" {
+
+/** Pick the variant of 'simd_skip_reads', when the library is loaded.
+ * @return Best variant the processor supports
+**/
+static skip_reads_t simd_resolve_reads() {
+    switch (simd_level()){
+        case SIMD_AVX512: return simd_skip_reads_avx512;
+        case SIMD_AVX2:   return simd_skip_reads_avx2;
+        default:          return simd_skip_reads_scalar;
+    }
+}
+
+/** Pick the variant of 'simd_skip_range', when the library is loaded.
+ * @return Best variant the processor supports
+**/
+static skip_range_t simd_resolve_range() {
+    switch (simd_level()){
+        case SIMD_AVX512: return simd_skip_range_avx512;
+        case SIMD_AVX2:   return simd_skip_range_avx2;
+        default:          return simd_skip_range_scalar;
+    }
+}
+
+}
+
+size_t simd_skip_reads(void const*, size_t, size_t, uint64_t) noexcept __attribute__((ifunc("simd_resolve_reads")));
+size_t simd_skip_range(atomic<uint64_t> const*, size_t, uint64_t) noexcept __attribute__((ifunc("simd_resolve_range")));
+
+#else
+
+/** Skip the entries of single stripes that are unlocked and not newer than the snapshot.
+ * @param reads  First entry to check
+ * @param stride Size of an entry
+ * @param count  Number of entries from the first one
+ * @param rv     Snapshot
+ * @return Number of entries skipped, the next one (if any) must be checked one by one
+**/
+size_t simd_skip_reads(void const* reads, size_t stride, size_t count, uint64_t rv) noexcept {
+    return simd_skip_reads_scalar(reads, stride, count, rv);
+}
+
+/** Skip the stripes of a range that are unlocked and not newer than the snapshot.
+ * @param locks First stripe of the range
+ * @param count Number of stripes in the range
+ * @param rv    Snapshot
+ * @return Number of stripes skipped, the next one (if any) must be checked one by one
+**/
+size_t simd_skip_range(atomic<uint64_t> const* locks, size_t count, uint64_t rv) noexcept {
+    return simd_skip_range_scalar(locks, count, rv);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,235 @@
+/**
+ * @file   simd.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Vector kernels checking lock words against a snapshot, for the validation
+ * of 'tl2' with USE_SIMD. Each kernel comes in a scalar, an AVX2 and an
+ * AVX-512 variant, all compiled into the library whatever the build machine;
+ * 'simd_skip_reads' and 'simd_skip_range' are bound to the best variant the
+ * processor supports once, when the library is loaded (an 'ifunc' resolver),
+ * so that one build runs on every host without paying for the lowest common
+ * denominator. The variants stay visible for the microbenchmark in 'tools'.
+ *
+ * A lock word holds a version shifted by one, and the lock in the lowest bit.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#endif
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Variants of the kernels, in increasing order of preference
+#define SIMD_SCALAR 0
+#define SIMD_AVX2   1
+#define SIMD_AVX512 2
+#define SIMD_LEVELS 3
+
+/** Start of an entry of a read set: 'count' consecutive lock words from 'lock'; the entries may hold more after it.
+**/
+struct simd_read {
+    std::atomic<uint64_t> const* lock;
+    uint32_t count;
+};
+
+size_t simd_skip_reads(void const*, size_t, size_t, uint64_t) noexcept;
+size_t simd_skip_range(std::atomic<uint64_t> const*, size_t, uint64_t) noexcept;
+
+/** Get the best variant of the kernels the processor supports.
+ * @return One of 'SIMD_*'
+**/
+static inline int simd_level() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    //may run before the constructors, from the resolver
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")){
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")){
+        return SIMD_AVX2;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+/** Get an entry of a read set.
+ * @param reads  First entry
+ * @param stride Size of an entry
+ * @param i      Index of the entry
+ * @return Entry
+**/
+static inline struct simd_read const* simd_at(void const* reads, size_t stride, size_t i) noexcept {
+    return (struct simd_read const*) ((char const*) reads + i * stride);
+}
+
+/** Tell whether a lock word is locked or newer than a snapshot.
+ * @param word Lock word
+ * @param rv   Snapshot
+ * @return Whether the stripe must be checked closer
+**/
+static inline bool simd_stale(uint64_t word, uint64_t rv) noexcept {
+    return (word & 1) != 0 || (word >> 1) > rv;
+}
+
+/** Skip the entries of single stripes that are unlocked and not newer than the snapshot, one at a time.
+ * @param reads  First entry to check
+ * @param stride Size of an entry
+ * @param count  Number of entries from the first one
+ * @param rv     Snapshot
+ * @return Number of entries skipped, the next one (if any) is a range or must be checked closer
+**/
+static inline size_t simd_skip_reads_scalar(void const* reads, size_t stride, size_t count, uint64_t rv) noexcept {
+    size_t i = 0;
+    for (; i < count; ++i){
+        struct simd_read const* read = simd_at(reads, stride, i);
+        if (read->count != 1 || simd_stale(read->lock->load(std::memory_order_acquire), rv)){
+            break;
+        }
+    }
+    return i;
+}
+
+/** Skip the stripes of a range that are unlocked and not newer than the snapshot, one at a time.
+ * @param locks First stripe of the range
+ * @param count Number of stripes in the range
+ * @param rv    Snapshot
+ * @return Number of stripes skipped, the next one (if any) must be checked closer
+**/
+static inline size_t simd_skip_range_scalar(std::atomic<uint64_t> const* locks, size_t count, uint64_t rv) noexcept {
+    size_t i = 0;
+    for (; i < count && !simd_stale(locks[i].load(std::memory_order_acquire), rv); ++i);
+    return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/** Skip the entries of single stripes that are unlocked and not newer than the snapshot, four at a time.
+ * @param reads  First entry to check
+ * @param stride Size of an entry
+ * @param count  Number of entries from the first one
+ * @param rv     Snapshot
+ * @return Number of entries skipped, the next one (if any) must be checked one by one
+**/
+__attribute__((target("avx2"))) static inline size_t simd_skip_reads_avx2(void const* reads, size_t stride, size_t count, uint64_t rv) noexcept {
+    //versions use 63 bits, the signed comparison is right
+    __m256i const snapshot = _mm256_set1_epi64x((long long) rv);
+    __m256i const locked = _mm256_set1_epi64x(1);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4){
+        struct simd_read const* a = simd_at(reads, stride, i);
+        struct simd_read const* b = simd_at(reads, stride, i + 1);
+        struct simd_read const* c = simd_at(reads, stride, i + 2);
+        struct simd_read const* d = simd_at(reads, stride, i + 3);
+        if ((a->count | b->count | c->count | d->count) != 1){
+            //ranges take contiguous loads
+            break;
+        }
+        __m256i addrs = _mm256_set_epi64x((long long) d->lock, (long long) c->lock, (long long) b->lock, (long long) a->lock);
+        __m256i words = _mm256_i64gather_epi64((long long const*) NULL, addrs, 1);
+        __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_srli_epi64(words, 1), snapshot), _mm256_cmpeq_epi64(_mm256_and_si256(words, locked), locked));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(bad));
+        if (mask != 0){
+            i += __builtin_ctz(mask);
+            break;
+        }
+    }
+    //the plain loads above are ordered before what the caller reads next
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return i;
+}
+
+/** Skip the stripes of a range that are unlocked and not newer than the snapshot, four at a time.
+ * @param locks First stripe of the range
+ * @param count Number of stripes in the range
+ * @param rv    Snapshot
+ * @return Number of stripes skipped, the next one (if any) must be checked one by one
+**/
+__attribute__((target("avx2"))) static inline size_t simd_skip_range_avx2(std::atomic<uint64_t> const* locks, size_t count, uint64_t rv) noexcept {
+    __m256i const snapshot = _mm256_set1_epi64x((long long) rv);
+    __m256i const locked = _mm256_set1_epi64x(1);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4){
+        __m256i words = _mm256_loadu_si256((__m256i const*) (locks + i));
+        __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_srli_epi64(words, 1), snapshot), _mm256_cmpeq_epi64(_mm256_and_si256(words, locked), locked));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(bad));
+        if (mask != 0){
+            i += __builtin_ctz(mask);
+            break;
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return i;
+}
+
+/** Skip the entries of single stripes that are unlocked and not newer than the snapshot, eight at a time.
+ * @param reads  First entry to check
+ * @param stride Size of an entry
+ * @param count  Number of entries from the first one
+ * @param rv     Snapshot
+ * @return Number of entries skipped, the next one (if any) must be checked one by one
+**/
+__attribute__((target("avx512f"))) static inline size_t simd_skip_reads_avx512(void const* reads, size_t stride, size_t count, uint64_t rv) noexcept {
+    //newer than the snapshot: above its version shifted with the lock bit set
+    __m512i const bound = _mm512_set1_epi64((long long) (rv << 1 | 1));
+    __m512i const locked = _mm512_set1_epi64(1);
+    __m512i const low = _mm512_set1_epi64(UINT32_MAX);
+    __m512i const offsets = _mm512_set_epi64(7 * stride, 6 * stride, 5 * stride, 4 * stride, 3 * stride, 2 * stride, stride, 0);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8){
+        //the entries and their counts in two strided gathers, then the lock words they point to
+        char const* first = (char const*) simd_at(reads, stride, i);
+        __m512i pointers = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xff, offsets, first, 1);
+        __m512i counts = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xff, offsets, first + offsetof(struct simd_read, count), 1);
+        if (_mm512_cmpneq_epu64_mask(_mm512_and_si512(counts, low), locked) != 0){
+            break;
+        }
+        __m512i words = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xff, pointers, NULL, 1);
+        __mmask8 bad = _mm512_cmpgt_epu64_mask(words, bound) | _mm512_test_epi64_mask(words, locked);
+        if (bad != 0){
+            i += __builtin_ctz(bad);
+            break;
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return i;
+}
+
+/** Skip the stripes of a range that are unlocked and not newer than the snapshot, eight at a time.
+ * @param locks First stripe of the range
+ * @param count Number of stripes in the range
+ * @param rv    Snapshot
+ * @return Number of stripes skipped, the next one (if any) must be checked one by one
+**/
+__attribute__((target("avx512f"))) static inline size_t simd_skip_range_avx512(std::atomic<uint64_t> const* locks, size_t count, uint64_t rv) noexcept {
+    //newer than the snapshot: above its version shifted with the lock bit set
+    __m512i const bound = _mm512_set1_epi64((long long) (rv << 1 | 1));
+    __m512i const locked = _mm512_set1_epi64(1);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8){
+        __m512i words = _mm512_loadu_si512((void const*) (locks + i));
+        __mmask8 bad = _mm512_cmpgt_epu64_mask(words, bound) | _mm512_test_epi64_mask(words, locked);
+        if (bad != 0){
+            i += __builtin_ctz(bad);
+            break;
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return i;
+}
+
+#endif
@@ -0,0 +1,291 @@
+/**
+ * @file   slab.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Per-thread caches, or per-CPU caches with USE_RSEQ, and shared pool of
+ * recycled segment blocks.
+**/
+
+// External headers
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+// Internal headers
+#include "common.hpp"
+#include "percpu.hpp"
+#include "region.hpp"
+#include "slab.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+/** Recycled block, the header lives in the block itself.
+**/
+struct slab_block {
+    struct slab_block* next;
+    int node; // NUMA node the block was placed on
+};
+
+/** Blocks of one class shared by every thread.
+**/
+struct alignas(CACHE_LINE) slab_list {
+    mutex lock;
+    struct slab_block* head;
+    atomic<size_t> count; // Also read without the lock, to skip empty lists
+};
+
+/** Blocks of each class kept by one thread, or one CPU.
+**/
+struct slab_cache {
+    struct slab_block* heads[SLAB_CLASSES];
+    size_t counts[SLAB_CLASSES];
+};
+
+/** Cache of one CPU, with USE_RSEQ.
+**/
+struct alignas(CACHE_LINE) slab_cpu {
+    struct percpu_lock lock; // Held by the thread using the cache, a thread finding it taken uses its own
+    struct slab_cache cache;
+};
+
+/** Free a chain of blocks.
+ * @param head First block of the chain
+**/
+static void slab_release(struct slab_block* head) {
+    while (head != NULL){
+        struct slab_block* next = head->next;
+        free(head);
+        head = next;
+    }
+}
+
+/** Shared pool, and caches of the CPUs with USE_RSEQ, the blocks are given back to the system at exit.
+**/
+static struct slab_pool {
+    struct slab_list lists[SLAB_CLASSES];
+#ifdef USE_RSEQ
+    struct slab_cpu cpus[PERCPU_MAX];
+#endif
+    ~slab_pool() {
+        for (auto& list : lists){
+            slab_release(list.head);
+        }
+#ifdef USE_RSEQ
+        for (auto& cpu : cpus){
+            for (auto head : cpu.cache.heads){
+                slab_release(head);
+            }
+        }
+#endif
+    }
+} pool;
+
+/** Cache of one thread, given to the shared pool when the thread exits.
+**/
+static thread_local struct slab_own {
+    struct slab_cache cache;
+    ~slab_own() {
+        slab_flush();
+    }
+} own;
+
+//================================================================
+//Helper functions
+//================================================================
+
+/** Get the class of a block.
+ * @param size Size of the block, a multiple of the page size
+ * @return Class, SLAB_CLASSES if blocks of this size are not recycled
+**/
+static inline size_t slab_class(size_t size) {
+    size_t pages = size >> SEGMENT_PAGE_LOG2;
+    return pages <= SLAB_CLASSES ? pages - 1 : SLAB_CLASSES;
+}
+
+/** Take the cache of the CPU of the calling thread with USE_RSEQ, or use the one of the thread.
+ * @param held Set to the lock to release with 'slab_untake', NULL if none
+ * @return Cache to use
+**/
+static inline struct slab_cache* slab_take(struct percpu_lock** held) {
+    *held = NULL;
+#ifdef USE_RSEQ
+    int cpu = percpu_cpu();
+    //a thread preempted or migrated while using the cache of a CPU keeps it, the next ones on that CPU use their own
+    if (cpu >= 0 && percpu_try(&pool.cpus[cpu].lock)){
+        *held = &pool.cpus[cpu].lock;
+        return &pool.cpus[cpu].cache;
+    }
+#endif
+    return &own.cache;
+}
+
+/** Release the cache taken with 'slab_take'.
+ * @param held Lock it set, NULL if none
+**/
+static inline void slab_untake(struct percpu_lock* held) {
+    if (held != NULL){
+        percpu_release(held);
+    }
+}
+
+/** Move half the blocks of one class of a cache to the pool.
+ * @param cache Cache holding more than SLAB_CACHED / 2 blocks of the class
+ * @param index Class
+ * @return Whether the pool took them, otherwise the cache is unchanged
+**/
+static bool slab_spill(struct slab_cache* cache, size_t index) {
+    struct slab_block* first = cache->heads[index];
+    struct slab_block* last = first;
+    for (size_t i = 1; i < SLAB_CACHED / 2; ++i){
+        last = last->next;
+    }
+    struct slab_list& list = pool.lists[index];
+    lock_guard<mutex> guard(list.lock);
+    if (list.count.load(memory_order_relaxed) >= SLAB_POOLED){
+        return false;
+    }
+    cache->heads[index] = last->next;
+    cache->counts[index] -= SLAB_CACHED / 2;
+    last->next = list.head;
+    list.head = first;
+    list.count.store(list.count.load(memory_order_relaxed) + SLAB_CACHED / 2, memory_order_relaxed);
+    return true;
+}
+
+/** Move up to half a cache of blocks of one class from the pool to an empty cache.
+ * @param cache Cache to refill
+ * @param index Class
+**/
+static void slab_refill(struct slab_cache* cache, size_t index) {
+    struct slab_list& list = pool.lists[index];
+    lock_guard<mutex> guard(list.lock);
+    for (size_t i = 0; i < SLAB_CACHED / 2 && list.head != NULL; ++i){
+        struct slab_block* block = list.head;
+        list.head = block->next;
+        list.count.store(list.count.load(memory_order_relaxed) - 1, memory_order_relaxed);
+        block->next = cache->heads[index];
+        cache->heads[index] = block;
+        ++cache->counts[index];
+    }
+}
+
+/** Take a block of one class from a cache, refilling it from the pool if empty.
+ * @param cache Cache to take from
+ * @param index Class
+ * @param node  Set to the NUMA node the block was placed on
+ * @return Block, NULL if none
+**/
+static void* slab_pop(struct slab_cache* cache, size_t index, int* node) {
+    if (cache->heads[index] == NULL){
+        //unlocked peek, a block missed here is only found by the next allocation
+        if (pool.lists[index].count.load(memory_order_relaxed) == 0){
+            return NULL;
+        }
+        slab_refill(cache, index);
+        if (cache->heads[index] == NULL){
+            return NULL;
+        }
+    }
+    struct slab_block* block = cache->heads[index];
+    cache->heads[index] = block->next;
+    --cache->counts[index];
+    *node = block->node;
+    return block;
+}
+
+/** Keep a block of one class in a cache, spilling half of it to the pool if full.
+ * @param cache Cache to keep it in
+ * @param block Block to keep
+ * @param index Class
+ * @param node  NUMA node the block was placed on
+ * @return Whether the block was kept
+**/
+static bool slab_push(struct slab_cache* cache, void* block, size_t index, int node) {
+    if (cache->counts[index] >= SLAB_CACHED && !slab_spill(cache, index)){
+        return false;
+    }
+    struct slab_block* recycled = (struct slab_block*) block;
+    recycled->next = cache->heads[index];
+    recycled->node = node;
+    cache->heads[index] = recycled;
+    ++cache->counts[index];
+    return true;
+}
+
+//================================================================
+// End of Helper functions
+//================================================================
+
+/** [thread-safe] Take a recycled block.
+ * @param size Size of the block, a multiple of the page size
+ * @param node Set to the NUMA node the block was placed on
+ * @return Page-aligned block, with arbitrary content, NULL if none of this size is available
+**/
+void* slab_alloc(size_t size, int* node) noexcept {
+    size_t index = slab_class(size);
+    if (unlikely(index == SLAB_CLASSES)){
+        return NULL;
+    }
+    struct percpu_lock* held;
+    struct slab_cache* cache = slab_take(&held);
+    void* block = slab_pop(cache, index, node);
+    //the thread may keep blocks of its own, e.g. from before it ran on a known CPU
+    if (block == NULL && cache != &own.cache){
+        block = slab_pop(&own.cache, index, node);
+    }
+    slab_untake(held);
+    return block;
+}
+
+/** [thread-safe] Move every block of the thread cache to the pool, freeing those it cannot take.
+ * Threads that free blocks for the others, e.g. a reclaiming service thread, make them available this way;
+ * the caches of the CPUs are shared already.
+**/
+void slab_flush() noexcept {
+    struct slab_cache& cache = own.cache;
+    for (size_t i = 0; i < SLAB_CLASSES; ++i){
+        if (cache.heads[i] == NULL){
+            continue;
+        }
+        struct slab_list& list = pool.lists[i];
+        lock_guard<mutex> guard(list.lock);
+        while (cache.heads[i] != NULL){
+            struct slab_block* next = cache.heads[i]->next;
+            if (list.count.load(memory_order_relaxed) < SLAB_POOLED){
+                cache.heads[i]->next = list.head;
+                list.head = cache.heads[i];
+                list.count.store(list.count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+            } else {
+                free(cache.heads[i]);
+            }
+            cache.heads[i] = next;
+        }
+        cache.counts[i] = 0;
+    }
+}
+
+/** [thread-safe] Keep a block that is not used anymore, for a later 'slab_alloc'.
+ * @param block Page-aligned block
+ * @param size  Size of the block, a multiple of the page size
+ * @param node  NUMA node the block was placed on
+ * @return Whether the block was kept, otherwise the caller must free it
+**/
+bool slab_free(void* block, size_t size, int node) noexcept {
+    size_t index = slab_class(size);
+    if (index == SLAB_CLASSES){
+        return false;
+    }
+    struct percpu_lock* held;
+    struct slab_cache* cache = slab_take(&held);
+    bool kept = slab_push(cache, block, index, node);
+    slab_untake(held);
+    return kept;
+}
@@ -0,0 +1,34 @@
+/**
+ * @file   slab.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Recycling of the page-aligned blocks holding the segments. Freed blocks of
+ * up to SLAB_CLASSES pages are kept by size class, first in a cache of the
+ * freeing thread (or of its CPU, with USE_RSEQ), then in a pool shared by
+ * every thread, so that segments allocated and freed over and over do not go
+ * through the system allocator.
+**/
+
+#pragma once
+
+// External headers
+#include <cstddef>
+
+// -------------------------------------------------------------------------- //
+
+// Largest recycled block, in pages; size classes are whole numbers of pages
+#define SLAB_CLASSES 16
+// Blocks of each class a thread keeps for itself, half of them move to the pool when exceeded
+#define SLAB_CACHED 32
+// Blocks of each class the shared pool keeps, further ones go back to the system
+#define SLAB_POOLED 1024
+
+void* slab_alloc(size_t, int*) noexcept;
+bool slab_free(void*, size_t, int) noexcept;
+void slab_flush() noexcept;
@@ -0,0 +1,163 @@
+/**
+ * @file   snzi.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Segment lock of the pessimistic engine with USE_SNZI: a writer flag and a
+ * scalable non-zero indicator (SNZI) of the readers, so that readers of the
+ * same segment do not all increment one counter. Threads are spread over
+ * TM_SNZI_LEAVES leaf counters, each on a line of its own; a leaf only
+ * reaches the root when its count goes from 0 to 1 or back, and writers
+ * only ask the root whether any reader holds the lock.
+ *
+ * The leaves follow Ellen, Lev, Luchangco and Moir, "SNZI: Scalable NonZero
+ * Indicators" (PODC 2007): a leaf going from 0 passes through an intermediate
+ * state, in which any arriving reader may announce it at the root, and the
+ * announcements that lost the race are taken back.
+**/
+
+#pragma once
+
+// External headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Internal headers
+#include "common.hpp"
+#include "contention.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Leaf of the indicator: version in the high 32 bits, twice the readers in the low ones (1 while announced half-way).
+**/
+struct alignas(CACHE_LINE) snzi_leaf {
+    std::atomic<uint64_t> word{0};
+};
+
+/** Reader-writer lock with the interface of 'std::shared_mutex' the pessimistic engine uses, none of its calls blocking but 'lock'.
+**/
+struct snzi_lock {
+    alignas(CACHE_LINE) std::atomic<uint32_t> writer{0}; // Whether a writer holds or is taking the lock
+    alignas(CACHE_LINE) std::atomic<uint64_t> root{0};   // Leaves with readers, non-zero while any reader holds the lock
+    struct snzi_leaf leaves[TM_SNZI_LEAVES];
+
+    /** Get the leaf of the calling thread, the same for all its locks.
+     * @return Index of the leaf
+    **/
+    static size_t leaf_of() noexcept {
+        static std::atomic<size_t> next{0};
+        static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % TM_SNZI_LEAVES;
+        return index;
+    }
+
+    /** Count a reader in a leaf, announcing the leaf at the root if it had none.
+     * @param leaf Leaf of the reader
+    **/
+    void arrive(struct snzi_leaf& leaf) noexcept {
+        size_t undo = 0;
+        while (true){
+            uint64_t word = leaf.word.load();
+            uint64_t count = word & UINT32_MAX;
+            if (count >= 2){
+                //already announced, the root does not change
+                if (leaf.word.compare_exchange_weak(word, word + 2)){
+                    break;
+                }
+                continue;
+            }
+            bool mine = false;
+            if (count == 0){
+                uint64_t half = (((word >> 32) + 1) << 32) | 1;
+                if (!leaf.word.compare_exchange_weak(word, half)){
+                    continue;
+                }
+                word = half;
+                mine = true;
+            }
+            //half-way, by this reader or another one: whoever moves it to 1 counts on an announcement at the root
+            root.fetch_add(1);
+            uint64_t expected = word;
+            if (!leaf.word.compare_exchange_strong(expected, (word & ~(uint64_t) UINT32_MAX) | 2)){
+                ++undo;
+            }
+            if (mine){
+                break;
+            }
+        }
+        //announcements of the readers whose move to 1 another one made
+        for (; undo > 0; --undo){
+            root.fetch_sub(1);
+        }
+    }
+
+    /** Count a reader out of its leaf, withdrawing the leaf from the root if it was the last one.
+     * @param leaf Leaf of the reader
+    **/
+    void depart(struct snzi_leaf& leaf) noexcept {
+        uint64_t word = leaf.word.load();
+        while (!leaf.word.compare_exchange_weak(word, word - 2));
+        if ((word & UINT32_MAX) == 2){
+            root.fetch_sub(1);
+        }
+    }
+
+    /** Take the lock shared, unless a writer holds it.
+     * @return Whether the lock is now held shared
+    **/
+    bool try_lock_shared() noexcept {
+        struct snzi_leaf& leaf = leaves[leaf_of()];
+        arrive(leaf);
+        //either the writer sees this reader at the root, or this reader sees the writer
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (writer.load(std::memory_order_relaxed) != 0){
+            depart(leaf);
+            return false;
+        }
+        return true;
+    }
+
+    /** Release the lock held shared, from the thread that took it.
+    **/
+    void unlock_shared() noexcept {
+        depart(leaves[leaf_of()]);
+    }
+
+    /** Take the lock exclusive, waiting a little for the readers to leave, while new ones stay away.
+     * @return Whether the lock is now held exclusive
+    **/
+    bool try_lock() noexcept {
+        uint32_t expected = 0;
+        if (writer.load(std::memory_order_relaxed) != 0 || !writer.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed)){
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (size_t attempt = 0; root.load(std::memory_order_acquire) != 0; ++attempt){
+            if (attempt >= TM_LOCK_SPINS){
+                writer.store(0, std::memory_order_release);
+                return false;
+            }
+            cm_pause(1);
+        }
+        return true;
+    }
+
+    /** Take the lock exclusive, only for a lock nobody else can reach yet.
+    **/
+    void lock() noexcept {
+        while (!try_lock()){
+            cm_pause(1);
+        }
+    }
+
+    /** Release the lock held exclusive.
+    **/
+    void unlock() noexcept {
+        writer.store(0, std::memory_order_release);
+    }
+};
@@ -0,0 +1,2429 @@
+/**
+ * @file   tl2.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * TL2-style engine: a global version clock and a table of versioned locks
+ * indexed by word address. Reads are invisible and validated against the
+ * clock snapshot taken at begin, moved forward when the read set is still
+ * valid (instead of aborting), writes are buffered and only published in
+ * 'tm_end', which is also the only place where locks are taken. They are
+ * taken in stripe order, so that committers may wait for each other without
+ * ever waiting in a cycle. The read set holds ranges of consecutive stripes:
+ * a scan is one entry however long, and a stripe read again soon after
+ * (e.g. a segment header) is not logged twice. Writes to the segments the
+ * transaction allocated go in place, so that a commit with nothing else to
+ * publish neither locks a stripe nor reads the clock for a write version.
+ *
+ * With USE_MULTIVERSION, every stripe also keeps a bounded chain of the values
+ * it overwrote, so that read-only transactions read their snapshot instead of
+ * aborting when a word changed after they began.
+ *
+ * With USE_RTM, and when the processor supports it, a commit is first tried
+ * as one hardware transaction that checks the lock words of its read and
+ * write sets instead of taking them: software commits locking any of those
+ * stripes abort it, and it bumps the versions software readers check.
+ *
+ * With USE_SIMD, commit-time validation gathers and checks the lock words of
+ * the read set several at a time (loads them, within a range), only looking
+ * closer at the ones locked or too recent; the AVX2 or AVX-512 kernels are
+ * picked when the library is loaded, see 'simd.hpp'.
+ *
+ * The lock table is sized for the live segments, TM_STRIPES_PER_WORD stripes
+ * per word, and replaced by one of the right size at a quiescent point once
+ * allocations or frees moved the live size too far from it; with
+ * USE_CONFLICT_STATS, stripes per word also double whenever most conflicts
+ * turn out to be false ones.
+ *
+ * With USE_LINE_STRIPES, a stripe covers a whole cache line of data instead of
+ * one word: the words of a line share one version word, and a line of the
+ * lock table covers 8 lines of data, so that a scan misses on the table 8
+ * times less often and the table, sized per line, is 8 times smaller. Words
+ * of the same line then conflict with each other, as their line already
+ * bounces between the cores writing them.
+ *
+ * With USE_NUMA_SHARDS (and USE_NUMA), the lock table is split in one slice
+ * per node, placed on that node, and the stripes of a segment are taken in
+ * the slice of the node the segment was allocated on: a transaction on the
+ * segments of its node only reaches lock lines of its node. Stripes of the
+ * first segment, spread over every node, are hashed over the whole table.
+ *
+ * With USE_HOT_STRIPES, the conflicts of each stripe heat a slot of a small
+ * table, and the heat of every slot halves each TM_HOT_DECAY conflicts. Once
+ * a stripe is hot, transactions that may write lock it when they reach it
+ * instead of at commit: shared to read it, where the writers can see them,
+ * exclusive to write it (upfront for the words 'tm_hint' says they write).
+ * They then wait for each other a little rather than all reading the stripe
+ * and all but one aborting at commit. The waits are bounded, the lock being
+ * a mere scheduling device: the stripe locks and the validation still decide
+ * every commit. Cold stripes, and read-only transactions, stay invisible.
+ *
+ * With USE_EAGER_DOOM, a transaction that may write looks at the clock every
+ * so many reads, and when commits happened since its snapshot validates its
+ * read set right away, moving the snapshot forward or aborting: one doomed by
+ * a commit over a word it read stops within a few reads instead of running to
+ * its commit. The next look comes after at least as many reads as the read set
+ * holds entries, so that the validations cost a constant per read. Read-only
+ * transactions need none, as every word they read is as of their snapshot.
+ *
+ * With USE_PREEMPT, a committing transaction records in a beacon of its epoch
+ * slot when it last made progress (each stripe it locks, then its validation),
+ * and every stripe records the slot that locked it last. A transaction
+ * finding a stripe locked by a holder silent for TM_PREEMPT_TICKS takes it as
+ * descheduled while holding its locks: rather than spinning on a CPU the
+ * holder may need to finish, it gives the CPU away at each of its waits,
+ * which stay bounded by the contention manager as before. Threads waiting on
+ * a holder preempted mid-commit then let it run again instead of burning
+ * their time slices on its stripes.
+ *
+ * 'tm_read_view' reads a range in place instead of copying it: its stripes
+ * are checked against the snapshot, then logged as for a read, so that the
+ * validation at commit fails if any changed before the transaction ended.
+ * Read-only transactions keep their views aside and check their stripes in
+ * 'tm_end' instead. A range the transaction wrote, and any range under
+ * snapshot isolation (nothing is validated) or in an opacity sample (every
+ * word is logged as read), is not viewed; with USE_MULTIVERSION neither is one
+ * newer than a read-only snapshot, whose values only the history keeps.
+ *
+ * 'tm_write_reserve' buffers the words of a range next to each other in the
+ * write set, and lends that room for the caller to build the new content in,
+ * instead of copying it from a private buffer. Ranges with a word already
+ * written, and any range while a savepoint is held, are left to 'tm_write'.
+ *
+ * In a region shared between processes, the clock and a fixed-size lock
+ * table live in the shared object, and stripes are indexed by the offset of
+ * a word in the first segment rather than by its address.
+ *
+ * TM_CLOCK picks how the global clock moves. With 1 every writing commit
+ * increments it. With 4 a commit whose increment fails takes the version of
+ * the commit that succeeded, which began after this one held its locks, so
+ * fewer increments fight for the line. With 5 commits do not write the clock
+ * at all, writing versions above it, and readers finding such a version push
+ * the clock up to it before moving their snapshot; read-only transactions
+ * then abort once after each commit they overlap, and USE_MULTIVERSION is
+ * ignored.
+ *
+ * Transactions begun with 'tm_begin_snapshot' run under snapshot isolation:
+ * they commit unless another transaction committed to a stripe they write
+ * since their snapshot, whatever happened to what they read. With
+ * USE_MULTIVERSION they announce their snapshot like read-only transactions
+ * and read the older values of the stripes written since, without a read
+ * set; otherwise their snapshot moves forward as that of the others.
+ *
+ * With USE_GROUP_COMMIT (and TM_CLOCK 1), committers holding their locks
+ * gather in groups: the first to arrive leads, waits TM_GROUP_WINDOW pauses
+ * for more when the previous group had several, then takes one version for
+ * the whole group, validates every read set and, for a durable region, logs
+ * every write set in one flushed group, before telling each its outcome.
+ *
+ * A transaction that may write can take savepoints ('tm_savepoint') and roll
+ * back to one ('tm_rollback_to'): the read and write sets are truncated to
+ * their size at the mark, the buffered words the transaction overwrote since
+ * restored from an undo log, the segments allocated since destroyed, and the
+ * rest of the read set revalidated as for an extension. While a mark is held,
+ * a read that cannot continue only fails the transaction, which then waits
+ * for the caller to roll it back or end it, and only the segments allocated
+ * since the latest mark are written in place. Commit-time failures still
+ * abort the whole transaction.
+ *
+ * The handle of a read-only transaction holds its whole snapshot, so that
+ * other threads can begin read-only transactions at the same snapshot
+ * ('tm_begin_join') and split a long scan between them.
+ *
+ * With USE_OPACITY_LOG, sampled transactions log the version of every word
+ * they read from the stripes, their final snapshot and, for a commit, the
+ * words written at its write version (see 'opacity.hpp'). Reads of a
+ * snapshot-isolated transaction and of a joined one are not logged, nor is a
+ * transaction that released words or rolled back to a savepoint.
+**/
+
+// External headers
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <sched.h>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "engine.hpp"
+#include "heatmap.hpp"
+#include "percpu.hpp"
+#include "persist.hpp"
+#include "profile.hpp"
+#include "numa.hpp"
+#include "opacity.hpp"
+#include "region.hpp"
+#include "ship.hpp"
+#include "shm.hpp"
+#include "simd.hpp"
+#include "trace.hpp"
+#include "word.hpp"
+#include "writeset.hpp"
+
+// A clock behind the versions makes old values look current to snapshots taken after the commit
+#if defined(USE_MULTIVERSION) && TM_CLOCK == 5
+    #undef USE_MULTIVERSION
+#endif
+// Hardware commits cannot keep the old values, nor keep the versions of a stripe growing without the clock
+#if defined(USE_RTM) && (defined(USE_MULTIVERSION) || TM_CLOCK == 5)
+    #undef USE_RTM
+#endif
+#ifdef USE_RTM
+    #include <cpuid.h>
+#endif
+#ifdef USE_RTM
+    #include <immintrin.h>
+#endif
+#if defined(USE_PREEMPT) && (defined(__x86_64__) || defined(__i386__))
+    #include <x86intrin.h>
+#endif
+#if TM_CLOCK != 1 && TM_CLOCK != 4 && TM_CLOCK != 5
+    #error TM_CLOCK must be 1, 4 or 5
+#endif
+// Without placement, every node is as far from the table
+#if defined(USE_NUMA_SHARDS) && !defined(USE_NUMA)
+    #undef USE_NUMA_SHARDS
+#endif
+// The other clocks already let concurrent commits share a version
+#if defined(USE_GROUP_COMMIT) && TM_CLOCK != 1
+    #undef USE_GROUP_COMMIT
+#endif
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+namespace tl2 {
+
+/** Versioned lock word: lowest bit set while locked, version in the other bits.
+**/
+using vlock = atomic<uint64_t>;
+
+#ifdef USE_MULTIVERSION
+/** Value of a word before a commit overwrote it, the content follows the structure.
+**/
+struct version {
+    byte* location;              // Overwritten word
+    uint64_t since;              // The value was current from at most this version...
+    uint64_t until;              // ...up to this one, excluded
+    atomic<struct version*> next; // Older value on the same stripe
+    struct retired retired;
+};
+
+/** Read version plus one of the read-only transaction announced in one epoch slot, 0 if none.
+**/
+struct alignas(CACHE_LINE) snapshot {
+    atomic<uint64_t> rv;
+};
+#endif
+
+#ifdef USE_PREEMPT
+/** Last progress of the commit of the transaction announced in one epoch slot, 0 while it holds no stripe.
+**/
+struct alignas(CACHE_LINE) beacon {
+    atomic<uint64_t> tick;
+};
+#endif
+
+/** Lock table and the per-stripe tables next to it, replaced together when resized.
+**/
+struct table {
+    size_t bits;  // Log2 of the number of stripes
+    size_t mask;  // Number of stripes minus one
+    vlock* locks; // Versioned locks
+    size_t slices_log2; // Log2 of the slices of the table, one per node with USE_NUMA_SHARDS, 0 otherwise
+    bool external; // Whether the locks belong to the shared object of the region
+#ifdef USE_MULTIVERSION
+    atomic<struct version*>* history; // Overwritten values of each stripe, newest first
+#endif
+#ifdef USE_CONFLICT_STATS
+    atomic<uintptr_t>* owners; // Last word locked through each stripe
+#endif
+#ifdef USE_PREEMPT
+    atomic<uint8_t>* holders; // Epoch slot of the transaction that locked each stripe last
+#endif
+};
+
+#ifdef USE_HOT_STRIPES
+// Writer bit of the visible lock of a hot slot, the other bits counting its readers
+#define HOT_WRITER (UINT32_C(1) << 31)
+
+/** Slot of the heat table, shared by the stripes of the same index modulo TM_HOT_SLOTS.
+**/
+struct hot {
+    atomic<uint64_t> heat;   // Conflicts (low 16 bits) as of the decay period in the other bits
+    atomic<uint32_t> owners; // HOT_WRITER if locked exclusive, the number of readers otherwise
+};
+#endif
+
+#ifdef USE_GROUP_COMMIT
+// Outcomes of a group member besides the reasons of an abort
+#define GROUP_PENDING   -2
+#define GROUP_COMMITTED -1
+
+/** Committer in a group, on the stack of its thread until the leader of the group decided its outcome.
+**/
+struct member {
+    struct transaction* trans;
+    struct member* next;  // Next member, that arrived earlier
+    int result;           // Outcome so far, only seen by the leader
+    atomic<int> outcome;  // GROUP_PENDING until decided, then GROUP_COMMITTED or the reason of the abort
+};
+#endif
+
+/** Engine state, the clock is on a line of its own and the rest is only written at creation, at quiescent points, or with the stats.
+**/
+struct state {
+    alignas(CACHE_LINE) atomic<uint64_t> own_clock; // Global version clock of a region private to the process
+    alignas(CACHE_LINE) atomic<uint64_t>* clock; // Global version clock, 'own_clock' or the one of the shared object
+    uintptr_t base; // Address the stripes are indexed from, the first segment of a region shared between processes (0 otherwise)
+    size_t shift; // Log2 of the bytes a stripe covers, the word size or the cache line ('stripe_shift')
+#ifdef USE_NUMA_SHARDS
+    struct region* region; // Region of the engine, to find the node of a segment
+#endif
+    struct table table;
+    bool fixed;             // Whether the table keeps its size ('TM_STRIPES' or TM_STRIPES_PER_WORD 0)
+    atomic<size_t> per_word; // Stripes per live word the table is sized for
+    atomic<uint64_t> resizes; // Number of times the table was replaced
+#ifdef USE_RTM
+    bool rtm;               // Whether hardware commits are available
+#endif
+#ifdef USE_MULTIVERSION
+    struct snapshot snapshots[EPOCH_SLOTS];
+    alignas(CACHE_LINE) atomic<uint64_t> horizon; // No read-only transaction reads older than this version
+#endif
+#ifdef USE_GROUP_COMMIT
+    alignas(CACHE_LINE) atomic<struct member*> group; // Members of the group being gathered, the latest first, NULL if none
+    atomic<size_t> last_group; // Number of members of the last group
+#endif
+#ifdef USE_CONFLICT_STATS
+    alignas(CACHE_LINE) atomic<uint64_t> conflicts; // Number of conflicts detected on a stripe
+    atomic<uint64_t> false_conflicts; // Among them, conflicts on a stripe locked for another word
+    atomic<uint64_t> seen_conflicts;  // Conflicts when 'per_word' was last reconsidered
+    atomic<uint64_t> seen_false;      // False conflicts at that time
+#endif
+#ifdef USE_HOT_STRIPES
+    struct hot* hots; // Heat table, TM_HOT_SLOTS slots
+    alignas(CACHE_LINE) atomic<uint64_t> hot_conflicts; // Conflicts so far, the decay period being this over TM_HOT_DECAY
+#endif
+#ifdef USE_PREEMPT
+    struct beacon beacons[EPOCH_SLOTS];
+#endif
+};
+
+/** Range of consecutive stripes read, sequential reads extend the last range and reads of a stripe in it fold into it.
+**/
+struct read_entry {
+    vlock* lock;    // First stripe
+    uint32_t count; // Number of stripes from the first one
+    uint32_t words; // Number of reads folded in, 'count' when each stripe was read once
+#ifdef USE_CONFLICT_STATS
+    void const* location; // Read word, to tell false conflicts apart
+#endif
+};
+static_assert(offsetof(struct read_entry, lock) == offsetof(struct simd_read, lock) && offsetof(struct read_entry, count) == offsetof(struct simd_read, count), "read entries must start as the ones of the vector kernels");
+
+/** Sizes of the logs of a transaction when it took a savepoint.
+**/
+struct savepoint {
+    size_t reads;   // Read entries
+    uint32_t count; // Stripes of the last read entry, which later reads may extend
+    uint32_t words; // Reads folded in the last read entry
+    size_t writes;  // Write entries
+    size_t data;    // Bytes of buffered content
+    size_t undo;    // Undo entries
+    size_t allocs;  // Segments allocated
+    size_t dropped; // Segments allocated before a savepoint then freed
+    size_t frees;   // Segments freed
+};
+
+/** Buffered word the transaction overwrote while it held a savepoint taken after the word was first written, its content in 'undo_data'.
+**/
+struct undo_entry {
+    size_t entry; // Position in the write entries
+    bool delta;   // Whether it was an increment
+};
+
+/** Transaction descriptor, on lines of its own so that the descriptors of different threads never share one.
+**/
+struct alignas(CACHE_LINE) transaction {
+    struct region* region;
+    size_t slot; // Epoch table slot
+    uint64_t rv; // Read version, i.e. clock snapshot at begin
+    uint64_t wv; // Write version, once the commit is linearized
+    vector<struct read_entry> reads;
+    struct write_set writes;
+    vector<pair<vlock*, void const*>> stripes; // Stripes to lock at commit, with a word of each
+    vector<pair<vlock*, uint64_t>> locked; // Locks held at commit in stripe order, with their value before acquisition
+    vector<struct segment*> allocs;
+    vector<struct segment*> frees;
+    byte const* read_end; // End of the last read, to tell sequential reads
+    bool isolated; // Whether it runs under snapshot isolation, see 'tm_begin_snapshot'
+    vector<struct savepoint> marks; // Savepoints held, oldest first
+    vector<struct undo_entry> undo; // Buffered words overwritten since a later savepoint
+    vector<byte> undo_data;         // Their previous content, one word per undo entry
+    vector<struct segment*> dropped; // Segments allocated before the latest savepoint then freed, destroyed at commit
+    int failed; // Reason of the failure of an access while a savepoint is held, -1 if none
+#ifdef USE_EAGER_DOOM
+    size_t doom_reads; // Reads left before the next look at the clock
+#endif
+#ifdef USE_HOT_STRIPES
+    vector<pair<uint32_t, bool>> hot; // Hot slots locked, and whether exclusive
+#endif
+    uint64_t sample; // Identifier of its sample with USE_OPACITY_LOG, 0 if not sampled
+};
+
+/** End of the last read of the read-only transaction of the thread, see 'prefetch_ahead'.
+**/
+static thread_local byte const* ro_read_end = NULL;
+
+/** Range a read-only transaction viewed in place, see 'tm_read_view'.
+**/
+struct ro_view {
+    size_t slot;        // Epoch slot of the transaction
+    void const* source; // Start of the range
+    size_t size;        // Length of the range
+};
+
+/** Ranges the read-only transactions of the thread viewed, to check in 'tm_end'.
+**/
+static thread_local vector<struct ro_view> ro_views;
+
+#ifdef USE_OPACITY_LOG
+/** Sampled read-only transaction of the thread, with the identifier of its sample.
+**/
+static thread_local tx_t ro_sampled = invalid_tx;
+static thread_local uint64_t ro_sample = 0;
+#endif
+
+/** Get the sample of a read-only transaction, see USE_OPACITY_LOG.
+ * @param tx Handle of the transaction
+ * @return Identifier of its sample, 0 if not sampled
+**/
+static inline uint64_t ro_sample_of(tx_t tx as(unused)){
+#ifdef USE_OPACITY_LOG
+    return tx == ro_sampled ? ro_sample : 0;
+#else
+    return 0;
+#endif
+}
+
+//================================================================
+//Helper functions
+//================================================================
+static inline bool is_locked(uint64_t word) {
+    return (word & 1) != 0;
+}
+
+static inline uint64_t version_of(uint64_t word) {
+    return word >> 1;
+}
+
+static inline vlock* lock_of(struct state* st, void const* addr) {
+    //fold the high bits in, malloc arenas are aligned on large powers of 2 and would alias
+    uintptr_t word = ((uintptr_t) addr - st->base) >> st->shift;
+    uintptr_t stripe = (word ^ (word >> st->table.bits)) & st->table.mask;
+#ifdef USE_NUMA_SHARDS
+    if (st->table.slices_log2 > 0){
+        int node = segment_node(st->region, addr);
+        if (node >= 0){
+            //in the slice placed on the node of the segment
+            size_t slice_bits = st->table.bits - st->table.slices_log2;
+            stripe = (((uintptr_t) node & ((1ul << st->table.slices_log2) - 1)) << slice_bits) | (stripe & ((1ul << slice_bits) - 1));
+        }
+    }
+#endif
+    return st->table.locks + stripe;
+}
+
+#ifdef USE_HOT_STRIPES
+/** Get the slot of the heat table of a stripe.
+ * @param st   Engine state
+ * @param lock Stripe
+ * @return Index of the slot
+**/
+static inline uint32_t hot_slot(struct state* st, vlock* lock) {
+    return (uint32_t) ((size_t) (lock - st->table.locks) & (TM_HOT_SLOTS - 1));
+}
+
+/** Get the conflicts of a slot left after decay.
+ * @param heat   Heat word of the slot
+ * @param period Current decay period
+ * @return Decayed count of conflicts
+**/
+static inline uint64_t hot_decayed(uint64_t heat, uint64_t period) {
+    uint64_t last = heat >> 16;
+    //a racing conflict may have moved the slot to a later period
+    uint64_t age = period > last ? period - last : 0;
+    return age < 16 ? (heat & 0xffff) >> age : 0;
+}
+
+/** Heat the slot of a stripe on which a conflict was detected.
+ * @param st   Engine state
+ * @param lock Stripe of the conflict
+**/
+static inline void hot_heat(struct state* st, vlock* lock) {
+    uint64_t period = st->hot_conflicts.fetch_add(1, memory_order_relaxed) / TM_HOT_DECAY;
+    auto& heat = st->hots[hot_slot(st, lock)].heat;
+    uint64_t word = heat.load(memory_order_relaxed);
+    uint64_t next;
+    do {
+        next = (period << 16) | min<uint64_t>(hot_decayed(word, period) + 1, 0xffff);
+    } while (!heat.compare_exchange_weak(word, next, memory_order_relaxed, memory_order_relaxed));
+}
+
+/** Check whether a slot is hot.
+ * @param st   Engine state
+ * @param slot Slot of the heat table
+ * @return Whether its stripes are locked at encounter
+**/
+static inline bool hot_is(struct state* st, uint32_t slot) {
+    uint64_t heat = st->hots[slot].heat.load(memory_order_relaxed);
+    //most slots never get near, without a look at the shared period
+    if ((heat & 0xffff) < TM_HOT_THRESHOLD){
+        return false;
+    }
+    return hot_decayed(heat, st->hot_conflicts.load(memory_order_relaxed) / TM_HOT_DECAY) >= TM_HOT_THRESHOLD;
+}
+#endif
+
+/** Prefetch the data and the stripe lock TM_PREFETCH_DISTANCE bytes past a read continuing the previous one, once per cache line.
+ * A scan then waits on neither the data line nor the lock table line of each word it reaches.
+ * @param st     Engine state
+ * @param end    End of the previous read of the transaction, set to the end of this one
+ * @param source Start of this read
+ * @param size   Length of this read
+**/
+static inline void prefetch_ahead(struct state* st as(unused), byte const*& end, void const* source, size_t size) {
+#if TM_PREFETCH_DISTANCE > 0
+    byte const* start = (byte const*) source;
+    if (start == end){
+        byte const* ahead = start + size + TM_PREFETCH_DISTANCE;
+        //only when the window enters a new line
+        if (((uintptr_t) ahead & (CACHE_LINE - 1)) < size){
+            __builtin_prefetch(ahead, 0);
+#ifdef USE_NUMA_SHARDS
+            //the page map entry of a page past the segment may be left by a destroyed one, whose node cannot be read
+            bool known = ((uintptr_t) ahead >> SEGMENT_PAGE_LOG2) == ((uintptr_t) start >> SEGMENT_PAGE_LOG2);
+#else
+            bool known = true;
+#endif
+            if (known){
+                __builtin_prefetch(lock_of(st, ahead), 0);
+            }
+        }
+    }
+    end = start + size;
+#else
+    (void) end;
+    (void) source;
+    (void) size;
+#endif
+}
+
+/** Account for a conflict detected on the stripe of a word, about to abort the transaction.
+ * @param region   Region of the engine
+ * @param st       Engine state
+ * @param lock     Stripe on which the conflict was detected
+ * @param location Word the transaction was accessing
+**/
+static inline void conflict(struct region* region, struct state* st as(unused), vlock* lock as(unused), void const* location) {
+    cm_predict(&region->cm, location);
+    HEATMAP(region, NULL, location, (size_t) (lock - st->table.locks));
+#ifdef USE_HOT_STRIPES
+    hot_heat(st, lock);
+#endif
+#ifdef USE_CONFLICT_STATS
+    st->conflicts.fetch_add(1, memory_order_relaxed);
+    if (st->table.owners[lock - st->table.locks].load(memory_order_relaxed) != (uintptr_t) location){
+        st->false_conflicts.fetch_add(1, memory_order_relaxed);
+    }
+#endif
+}
+
+/** Get the log2 of the bytes of data one stripe covers.
+ * @param region Region the lock table is for
+ * @return Log2 of the alignment, or with USE_LINE_STRIPES of the cache line if larger
+**/
+static size_t stripe_shift(struct region* region) {
+    size_t shift = __builtin_ctzl(region->align);
+#ifdef USE_LINE_STRIPES
+    if (shift < (size_t) __builtin_ctzl(CACHE_LINE)){
+        //segment memory starts on a line, so the stripes match the lines of the processor
+        shift = __builtin_ctzl(CACHE_LINE);
+    }
+#endif
+    return shift;
+}
+
+/** Get the log2 of the number of stripes fitting the live segments of a region.
+ * @param region   Region the lock table is for
+ * @param per_word Stripes per live word (per live line with USE_LINE_STRIPES)
+ * @return Log2 of the number of stripes
+**/
+static size_t stripe_bits(struct region* region, size_t per_word) {
+    size_t wanted = (region->live.load(memory_order_relaxed) >> stripe_shift(region)) * per_word;
+    size_t bits = TM_STRIPES_MIN_LOG2;
+    while (bits < TM_STRIPES_MAX_LOG2 && (static_cast<size_t>(1) << bits) < wanted){
+        ++bits;
+    }
+    return bits;
+}
+
+/** Get the number of stripes of the initial lock table.
+ * @param region Region the lock table is for
+ * @param fixed  Set to whether the table must keep that size
+ * @return Number of stripes, a power of 2
+**/
+static size_t stripe_count(struct region* region, bool* fixed) {
+    if (region->stripes > 0){
+        //round up to the next power of 2
+        size_t count = 1;
+        while (count < region->stripes){
+            count <<= 1;
+        }
+        *fixed = true;
+        return count;
+    }
+    *fixed = TM_STRIPES_PER_WORD == 0;
+    return static_cast<size_t>(1) << (*fixed ? TM_STRIPES_LOG2 : stripe_bits(region, TM_STRIPES_PER_WORD));
+}
+
+/** Allocate a lock table and its per-stripe tables, all zeroed.
+ * @param region     Region the table is for
+ * @param table      Table to fill
+ * @param nb_stripes Number of stripes, a power of 2
+ * @param locks      Locks of the shared object of the region, NULL to allocate them
+ * @return Whether there was enough memory, otherwise nothing was allocated
+**/
+static bool table_create(struct region* region, struct table* table, size_t nb_stripes, vlock* locks) {
+    table->external = locks != NULL;
+    //calloc'ed pages are zeroed lazily, no need to touch the whole table
+    table->locks = table->external ? locks : (vlock*) calloc(nb_stripes, sizeof(vlock));
+    if (unlikely(table->locks == NULL)){
+        return false;
+    }
+    table->bits = __builtin_ctzl(nb_stripes);
+    table->mask = nb_stripes - 1;
+    table->slices_log2 = 0;
+#ifdef USE_NUMA_SHARDS
+    while (!table->external && region->placed && (2ul << table->slices_log2) <= numa_nodes() && table->slices_log2 < table->bits){
+        ++table->slices_log2;
+    }
+    if (table->slices_log2 > 0){
+        size_t slice = nb_stripes >> table->slices_log2;
+        for (size_t node = 0; node < (1ul << table->slices_log2); ++node){
+            numa_bind(table->locks + node * slice, slice * sizeof(vlock), node);
+        }
+    } else
+#endif
+    if (!table->external && region->placed){
+        //every thread takes locks anywhere in the table
+        numa_interleave(table->locks, nb_stripes * sizeof(vlock));
+    }
+#ifdef USE_CONFLICT_STATS
+    table->owners = (atomic<uintptr_t>*) calloc(nb_stripes, sizeof(atomic<uintptr_t>));
+    if (unlikely(table->owners == NULL)){
+        if (!table->external){
+            ::free(table->locks);
+        }
+        return false;
+    }
+#endif
+#ifdef USE_MULTIVERSION
+    table->history = (atomic<struct version*>*) calloc(nb_stripes, sizeof(atomic<struct version*>));
+    if (unlikely(table->history == NULL)){
+#ifdef USE_CONFLICT_STATS
+        ::free(table->owners);
+#endif
+        if (!table->external){
+            ::free(table->locks);
+        }
+        return false;
+    }
+#endif
+#ifdef USE_PREEMPT
+    table->holders = (atomic<uint8_t>*) calloc(nb_stripes, sizeof(atomic<uint8_t>));
+    if (unlikely(table->holders == NULL)){
+#ifdef USE_MULTIVERSION
+        ::free(table->history);
+#endif
+#ifdef USE_CONFLICT_STATS
+        ::free(table->owners);
+#endif
+        if (!table->external){
+            ::free(table->locks);
+        }
+        return false;
+    }
+#endif
+    return true;
+}
+
+/** Find whether the transaction holds the given lock.
+ * @param trans Transaction to search
+ * @param lock  Lock to look for
+ * @return Lock entry, NULL if the lock is not held
+**/
+static pair<vlock*, uint64_t>* held(struct transaction* trans, vlock* lock) {
+    //taken in stripe order
+    auto entry = lower_bound(trans->locked.begin(), trans->locked.end(), lock, [](pair<vlock*, uint64_t> const& held, vlock* lock) { return held.first < lock; });
+    if (entry == trans->locked.end() || entry->first != lock){
+        return NULL;
+    }
+    return &*entry;
+}
+
+// Number of recent ranges a read looks for its stripe in
+#define READ_FOLD_WINDOW 4
+
+/** Add a stripe read to the read set, folding it into a recent range holding it or extending the last range.
+ * With conflict statistics, every read keeps its own entry (and its word).
+ * @param trans    Transaction reading
+ * @param lock     Stripe read
+ * @param location Word read
+**/
+static inline void read_log(struct transaction* trans, vlock* lock, void const* location as(unused)) {
+#ifdef USE_CONFLICT_STATS
+    trans->reads.push_back({lock, 1, 1, location});
+#else
+    size_t size = trans->reads.size();
+    if (size > 0){
+        auto& last = trans->reads[size - 1];
+        if (lock == last.lock + last.count && last.count < UINT32_MAX){
+            ++last.count;
+            ++last.words;
+            return;
+        }
+        //e.g. a segment header or a stripe covering several words
+        for (size_t j = size; j-- > 0 && size - j <= READ_FOLD_WINDOW;){
+            auto& read = trans->reads[j];
+            if (lock >= read.lock && lock < read.lock + read.count){
+                if (read.words < UINT32_MAX){
+                    ++read.words;
+                }
+                return;
+            }
+        }
+    }
+    trans->reads.push_back({lock, 1, 1});
+#endif
+}
+
+#ifdef USE_PREEMPT
+/** Read the timestamp the beacons hold.
+ * @return Current timestamp
+**/
+static inline uint64_t beacon_now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+/** Record that the commit of a transaction made progress, or that it holds no stripe anymore.
+ * @param st    Engine state
+ * @param trans Transaction committing
+ * @param done  Whether the transaction released its stripes
+**/
+static inline void beacon_beat(struct state* st, struct transaction* trans, bool done = false) {
+    st->beacons[trans->slot].tick.store(done ? 0 : beacon_now(), memory_order_relaxed);
+}
+#endif
+
+/** Tell whether to keep waiting for a locked stripe, see 'cm_wait'.
+ * With USE_PREEMPT, a holder silent for too long is taken as descheduled, and the CPU is given away before the wait.
+ * @param region  Region of the stripe
+ * @param st      Engine state
+ * @param lock    Stripe found locked
+ * @param attempt Number of waits so far
+ * @return Whether the stripe may be read again
+**/
+static inline bool lock_wait(struct region* region, struct state* st as(unused), vlock* lock as(unused), size_t attempt) {
+#ifdef USE_PREEMPT
+    //the holder recorded may have released the stripe already, which only costs a yield
+    uint64_t tick = st->beacons[st->table.holders[lock - st->table.locks].load(memory_order_relaxed)].tick.load(memory_order_relaxed);
+    if (tick != 0 && beacon_now() > tick + TM_PREEMPT_TICKS){
+        sched_yield();
+    }
+#endif
+    return cm_wait(&region->cm, attempt);
+}
+
+/** Try to acquire a lock for the commit of the transaction, spinning a little while it is taken.
+ * Locks are acquired in stripe order, so the holder never waits for this transaction.
+ * @param st       Engine state
+ * @param trans    Transaction committing
+ * @param lock     Stripe to lock, after every one the transaction holds
+ * @param location Word of the stripe the transaction writes
+ * @return Whether the lock is now held by the transaction
+**/
+static bool acquire(struct state* st, struct transaction* trans, vlock* lock, void const* location) {
+    PROFILE(PROFILE_LOCK);
+    uint64_t word = lock->load(memory_order_relaxed);
+    for (size_t attempt = 0; is_locked(word) || !lock->compare_exchange_strong(word, word | 1, memory_order_acquire, memory_order_relaxed); ++attempt){
+        if (attempt < TM_LOCK_SPINS){
+            cm_pause(1);
+        } else if (!lock_wait(trans->region, st, lock, attempt - TM_LOCK_SPINS)){
+            conflict(trans->region, st, lock, location);
+            return false;
+        }
+        word = lock->load(memory_order_relaxed);
+    }
+#ifdef USE_CONFLICT_STATS
+    st->table.owners[lock - st->table.locks].store((uintptr_t) location, memory_order_relaxed);
+#endif
+#ifdef USE_PREEMPT
+    st->table.holders[lock - st->table.locks].store((uint8_t) trans->slot, memory_order_relaxed);
+    beacon_beat(st, trans);
+#endif
+    trans->locked.emplace_back(lock, word);
+    return true;
+}
+
+#ifdef USE_HOT_STRIPES
+/** Lock the slot of a stripe the transaction reaches if it is hot, waiting a little while it is locked for the other kind of access.
+ * Transactions may wait for each other in a cycle, hence the bounded wait.
+ * @param st        Engine state
+ * @param trans     Transaction reaching the stripe
+ * @param slot      Slot of the stripe in the heat table
+ * @param exclusive Whether to lock it to write, upgrading the shared lock the transaction may hold
+ * @return Whether the transaction may go on
+**/
+static bool hot_lock(struct state* st, struct transaction* trans, uint32_t slot, bool exclusive) {
+    if (!hot_is(st, slot)){
+        return true;
+    }
+    pair<uint32_t, bool>* entry = NULL;
+    for (auto& held : trans->hot){
+        if (held.first == slot){
+            if (held.second || !exclusive){
+                return true;
+            }
+            entry = &held;
+            break;
+        }
+    }
+    auto& owners = st->hots[slot].owners;
+    //an upgrade waits to be the only reader left
+    uint32_t idle = entry != NULL ? 1 : 0;
+    uint32_t word = owners.load(memory_order_relaxed);
+    for (size_t attempt = 0; !(exclusive ? word == idle : (word & HOT_WRITER) == 0) || !owners.compare_exchange_weak(word, exclusive ? HOT_WRITER : word + 1, memory_order_acquire, memory_order_relaxed); ++attempt){
+        if (attempt >= TM_HOT_SPINS){
+            return false;
+        }
+        cm_pause(1);
+        word = owners.load(memory_order_relaxed);
+    }
+    if (entry != NULL){
+        entry->second = true;
+    } else {
+        trans->hot.emplace_back(slot, exclusive);
+    }
+    return true;
+}
+
+/** Release the hot slots the transaction locked.
+ * @param st    Engine state
+ * @param trans Transaction ending
+**/
+static void hot_unlock(struct state* st, struct transaction* trans) {
+    for (auto const& held : trans->hot){
+        if (held.second){
+            st->hots[held.first].owners.store(0, memory_order_release);
+        } else {
+            st->hots[held.first].owners.fetch_sub(1, memory_order_release);
+        }
+    }
+    trans->hot.clear();
+}
+#endif
+
+/** Check every read of the transaction still reflects its snapshot.
+ * @param st    Engine state
+ * @param trans Transaction to validate, with its write locks held
+ * @return Whether the read set is still valid
+**/
+static bool validate(struct state* st as(unused), struct transaction* trans) {
+    PROFILE(PROFILE_LOCK);
+    size_t count = trans->reads.size();
+    for (size_t i = 0; i < count; ++i){
+#ifdef USE_SIMD
+        i += simd_skip_reads(trans->reads.data() + i, sizeof(struct read_entry), count - i, trans->rv);
+        if (i == count){
+            break;
+        }
+#endif
+        auto const& read = trans->reads[i];
+        size_t k = 0;
+#ifdef USE_SIMD
+        k = simd_skip_range(read.lock, read.count, trans->rv);
+#endif
+        for (; k < read.count; ++k){
+            uint64_t word = read.lock[k].load(memory_order_acquire);
+            if (is_locked(word)){
+                auto entry = held(trans, read.lock + k);
+                if (entry == NULL){
+#ifdef USE_CONFLICT_STATS
+                    conflict(trans->region, st, read.lock + k, read.location);
+#endif
+                    return false;
+                }
+                word = entry->second;
+            }
+            if (version_of(word) > trans->rv){
+#ifdef USE_CONFLICT_STATS
+                conflict(trans->region, st, read.lock + k, read.location);
+#endif
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/** Make the clock reach a version some commit wrote, with TM_CLOCK 5 (where commits do not advance it).
+ * @param st      Engine state
+ * @param version Version found on a stripe
+**/
+static inline void clock_advance(struct state* st as(unused), uint64_t version as(unused)) {
+#if TM_CLOCK == 5
+    uint64_t now = st->clock->load(memory_order_relaxed);
+    while (now < version && !st->clock->compare_exchange_weak(now, version, memory_order_seq_cst, memory_order_relaxed));
+    //before looking at the locks again: a commit locking a stripe after that sees the clock advanced
+    atomic_thread_fence(memory_order_seq_cst);
+#endif
+}
+
+/** Get the write version of a committing transaction, with its locks held.
+ * @param st    Engine state
+ * @param trans Transaction committing
+ * @param alone Set to whether nobody committed since the snapshot, so that the read set needs no validation
+ * @return Write version
+**/
+static inline uint64_t commit_version(struct state* st, struct transaction* trans, bool* alone) {
+#if TM_CLOCK == 4
+    uint64_t now = st->clock->load(memory_order_acquire);
+    if (st->clock->compare_exchange_strong(now, now + 1, memory_order_acq_rel, memory_order_acquire)){
+        *alone = (now == trans->rv);
+        return now + 1;
+    }
+    //'now' is the version of a commit that incremented after this one took its locks, share it
+    *alone = false;
+    return now;
+#elif TM_CLOCK == 5
+    //readers push the clock up before checking the locks, this one checks the clock after taking them
+    atomic_thread_fence(memory_order_seq_cst);
+    uint64_t wv = st->clock->load(memory_order_relaxed) + 1;
+    //commits since the clock last moved reuse its successor, the versions of a stripe must still grow
+    for (auto const& entry : trans->locked){
+        if (version_of(entry.second) >= wv){
+            wv = version_of(entry.second) + 1;
+        }
+    }
+    *alone = false;
+    return wv;
+#else
+    uint64_t wv = st->clock->fetch_add(1, memory_order_acq_rel) + 1;
+    *alone = (wv == trans->rv + 1);
+    return wv;
+#endif
+}
+
+/** Check that nobody committed to the stripes a snapshot-isolated transaction locked since its snapshot, the only conflicts it aborts on.
+ * @param trans Transaction holding the locks of its write set
+ * @return Whether the transaction can commit
+**/
+static bool validate_writes(struct transaction* trans) {
+    for (auto const& entry : trans->locked){
+        if (version_of(entry.second) > trans->rv){
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef USE_GROUP_COMMIT
+/** Take a write version and validate as a group with the committers arriving meanwhile, see USE_GROUP_COMMIT.
+ * @param region Region of the engine
+ * @param st     Engine state
+ * @param trans  Transaction committing, with its locks held
+ * @return GROUP_COMMITTED with the write version in 'trans->wv', or the reason of the abort
+**/
+static int group_commit(struct region* region, struct state* st, struct transaction* trans) {
+    struct member self;
+    self.trans = trans;
+    self.outcome.store(GROUP_PENDING, memory_order_relaxed);
+    self.next = st->group.load(memory_order_relaxed);
+    while (!st->group.compare_exchange_weak(self.next, &self, memory_order_release, memory_order_relaxed));
+    if (self.next != NULL){
+        //the leader decides, then this member may leave
+        for (size_t spins = 0; self.outcome.load(memory_order_acquire) == GROUP_PENDING; ++spins){
+            cm_pause(spins < TM_LOCK_SPINS ? 1 : SIZE_MAX);
+        }
+        return self.outcome.load(memory_order_relaxed);
+    }
+    if (st->last_group.load(memory_order_relaxed) > 1){
+        cm_pause(TM_GROUP_WINDOW);
+    }
+    struct member* members = st->group.exchange(NULL, memory_order_acquire);
+    size_t size = 0;
+    for (struct member* m = members; m != NULL; m = m->next){
+        ++size;
+    }
+    st->last_group.store(size, memory_order_relaxed);
+    uint64_t wv = st->clock->fetch_add(1, memory_order_acq_rel) + 1;
+    //the members write in the same version, so none can skip validation but one alone since its snapshot
+    static thread_local vector<struct write_set*> logged;
+    logged.clear();
+    for (struct member* m = members; m != NULL; m = m->next){
+        m->trans->wv = wv;
+        bool valid = (size == 1 && wv == m->trans->rv + 1) || (m->trans->isolated ? validate_writes(m->trans) : validate(st, m->trans));
+        m->result = valid ? GROUP_COMMITTED : TM_ABORT_VALIDATE;
+        if (valid){
+            logged.push_back(&m->trans->writes);
+        }
+    }
+    //last step that can fail, the logged transactions are replayed by recovery
+    if (unlikely(region->persist != NULL) && !logged.empty() && !persist_commit_batch(region, logged.data(), logged.size())){
+        for (struct member* m = members; m != NULL; m = m->next){
+            if (m->result == GROUP_COMMITTED){
+                m->result = TM_ABORT_OTHER;
+            }
+        }
+        logged.clear();
+    }
+    if (unlikely(region->ship != NULL) && !logged.empty()){
+        ship_commit_batch(region, logged.data(), logged.size());
+    }
+    int result = self.result;
+    for (struct member* m = members; m != NULL;){
+        //read before the outcome, after which the member may leave
+        struct member* next = m->next;
+        if (m != &self){
+            m->outcome.store(m->result, memory_order_release);
+        }
+        m = next;
+    }
+    return result;
+}
+#endif
+
+/** Move the snapshot of a transaction to the current clock, if every read so far is still valid.
+ * @param st      Engine state
+ * @param trans   Transaction that read a word newer than its snapshot, with no lock held
+ * @param version Version of that word
+ * @return Whether the snapshot was moved
+**/
+static bool extend(struct state* st, struct transaction* trans, uint64_t version) {
+    clock_advance(st, version);
+    //sampled first: the reads still valid after this are valid at this version
+    uint64_t now = st->clock->load(memory_order_acquire);
+    if (!validate(st, trans)){
+        return false;
+    }
+    trans->rv = now;
+    counter_add(trans->region->counters[trans->slot].extensions, 1);
+    return true;
+}
+
+#ifdef USE_MULTIVERSION
+/** Free a chain of old values.
+ * @param chain First value of the chain
+**/
+static void versions_free(void* chain) {
+    struct version* node = (struct version*) chain;
+    while (node != NULL){
+        struct version* next = node->next.load(memory_order_relaxed);
+        ::free(node);
+        node = next;
+    }
+}
+
+/** Recompute the oldest version some read-only transaction may still read.
+ * @param st Engine state
+**/
+static void horizon_update(struct state* st) {
+    //sample the clock first: a reader missed by the scan announced itself later, hence reads a newer version
+    uint64_t horizon = st->clock->load(memory_order_seq_cst);
+    for (size_t i = 0; i < EPOCH_SLOTS; ++i){
+        uint64_t snapshot = st->snapshots[i].rv.load(memory_order_seq_cst);
+        if (snapshot != 0 && snapshot - 1 < horizon){
+            horizon = snapshot - 1;
+        }
+    }
+    st->horizon.store(horizon, memory_order_relaxed);
+}
+
+/** Keep the current value of a word the transaction is about to overwrite, with its stripe locked.
+ * @param st      Engine state
+ * @param trans   Transaction committing
+ * @param entry   Write about to be published
+ * @param align   Size of a word
+ * @param wv      Write version of the transaction
+ * @param garbage Chain receiving the values nobody needs anymore
+**/
+static void history_push(struct state* st, struct transaction* trans, struct write_entry const& entry, size_t align, uint64_t wv, struct version** garbage) {
+    struct version* node = (struct version*) malloc(sizeof(struct version) + align);
+    if (unlikely(node == NULL)){
+        //readers of this word will abort instead
+        return;
+    }
+    vlock* lock = lock_of(st, entry.location);
+    atomic<struct version*>& head = st->table.history[lock - st->table.locks];
+    node->location = entry.location;
+    //the stripe version bounds the one of the word
+    node->since = version_of(held(trans, lock)->second);
+    node->until = wv;
+    node->next.store(head.load(memory_order_relaxed), memory_order_relaxed);
+    word_copy(node + 1, entry.location, align);
+    //values are ordered by decreasing 'until', cut the chain at the first one too old or too deep
+    uint64_t horizon = st->horizon.load(memory_order_relaxed);
+    struct version* last = node;
+    for (size_t depth = 1; ; ++depth){
+        struct version* next = last->next.load(memory_order_relaxed);
+        if (next == NULL){
+            break;
+        }
+        if (depth >= trans->region->versions || next->until <= horizon){
+            last->next.store(NULL, memory_order_relaxed);
+            //readers may still walk the cut part, it is reclaimed with the epochs
+            struct version* tail = next;
+            while (tail->next.load(memory_order_relaxed) != NULL){
+                tail = tail->next.load(memory_order_relaxed);
+            }
+            tail->next.store(*garbage, memory_order_relaxed);
+            *garbage = next;
+            break;
+        }
+        last = next;
+    }
+    head.store(node, memory_order_release);
+}
+
+/** Read the value a word had at the snapshot of a read-only transaction.
+ * @param st    Engine state
+ * @param rv    Snapshot of the read-only transaction
+ * @param src   Word in shared memory
+ * @param dst   Word in private memory
+ * @param align Size of a word
+ * @return Whether the value was still kept
+**/
+static bool history_read(struct state* st, uint64_t rv, byte const* src, byte* dst, size_t align) {
+    vlock* lock = lock_of(st, src);
+    //a committer pushes the old values before releasing the stripe, wait for it (shortly)
+    uint64_t word = lock->load(memory_order_acquire);
+    for (int i = 0; is_locked(word) && i < 16; ++i){
+        sched_yield();
+        word = lock->load(memory_order_acquire);
+    }
+    if (is_locked(word)){
+        return false;
+    }
+    if (version_of(word) <= rv){
+        //the committer aborted, or was reading only
+        word_copy(dst, src, align);
+        atomic_thread_fence(memory_order_acquire);
+        return lock->load(memory_order_relaxed) == word;
+    }
+    //the oldest value overwritten after the snapshot is the one that was current then
+    struct version* found = NULL;
+    struct version* node = st->table.history[lock - st->table.locks].load(memory_order_acquire);
+    while (node != NULL && node->until > rv){
+        if (node->location == src){
+            found = node;
+        }
+        node = node->next.load(memory_order_acquire);
+    }
+    if (found == NULL || found->since > rv){
+        return false;
+    }
+    word_copy(dst, found + 1, align);
+    return true;
+}
+#endif
+
+/** Free a lock table and its per-stripe tables, with no transaction running.
+ * @param table Table to free
+**/
+static void table_destroy(struct table* table) {
+#ifdef USE_CONFLICT_STATS
+    ::free(table->owners);
+#endif
+#ifdef USE_PREEMPT
+    ::free(table->holders);
+#endif
+#ifdef USE_MULTIVERSION
+    for (size_t i = 0; i <= table->mask; ++i){
+        versions_free(table->history[i].load(memory_order_relaxed));
+    }
+    ::free(table->history);
+#endif
+    if (!table->external){
+        ::free(table->locks);
+    }
+}
+
+/** Replace the lock table by one of another size, unless another thread quiesces the region.
+ * @param region Region of the engine, in which the caller runs no transaction
+ * @param st     Engine state
+ * @param bits   Log2 of the number of stripes of the new table
+**/
+static void resize(struct region* region, struct state* st, size_t bits) {
+    if (!region_quiesce(region, false)){
+        //checked again after the next allocation or free
+        return;
+    }
+    //nobody runs, every word is as good as never written: fresh stripes at version 0 are older than any snapshot
+    struct table fresh;
+    if (bits != st->table.bits && table_create(region, &fresh, static_cast<size_t>(1) << bits, NULL)){
+        table_destroy(&st->table);
+        st->table = fresh;
+        st->resizes.fetch_add(1, memory_order_relaxed);
+    }
+    region_resume(region);
+}
+
+/** Resize the lock table if it drifted too far from the live size, or if most conflicts were false ones.
+ * @param region Region of the engine, in which the caller runs no transaction
+ * @param st     Engine state
+ * @param live   Whether the caller just changed the live size
+**/
+static void table_check(struct region* region, struct state* st, bool live) {
+    if (st->fixed){
+        return;
+    }
+    size_t per_word = st->per_word.load(memory_order_relaxed);
+    //a factor of 4 off, so that live sizes around a power of 2 do not resize back and forth
+    size_t slack = 2;
+#ifdef USE_CONFLICT_STATS
+    uint64_t conflicts = st->conflicts.load(memory_order_relaxed);
+    uint64_t seen = st->seen_conflicts.load(memory_order_relaxed);
+    if (conflicts - seen >= TM_STRIPES_WINDOW && st->seen_conflicts.compare_exchange_strong(seen, conflicts, memory_order_relaxed)){
+        uint64_t false_conflicts = st->false_conflicts.load(memory_order_relaxed);
+        uint64_t seen_false = st->seen_false.exchange(false_conflicts, memory_order_relaxed);
+        //words sharing stripes, give them more
+        if (2 * (false_conflicts - seen_false) > conflicts - seen && per_word < TM_STRIPES_PER_WORD_MAX){
+            per_word *= 2;
+            st->per_word.store(per_word, memory_order_relaxed);
+            live = true;
+            slack = 1;
+        }
+    }
+#endif
+    if (!live){
+        return;
+    }
+    size_t bits = stripe_bits(region, per_word);
+    if (bits >= st->table.bits + slack || bits + slack <= st->table.bits){
+        resize(region, st, bits);
+    }
+}
+
+#ifdef USE_RTM
+/** Check whether the processor supports restricted transactional memory, unless 'TM_RTM=0'.
+ * @return Whether hardware commits can be used
+**/
+static bool rtm_supported() {
+    char const* env = getenv("TM_RTM");
+    if (env != NULL && strcmp(env, "0") == 0){
+        return false;
+    }
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 7){
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & bit_RTM) != 0;
+}
+
+/** Try to commit the transaction as one hardware transaction.
+ * @param st    Engine state
+ * @param trans Transaction to commit, with writes and no free
+ * @param align Size of a word
+ * @return Whether the transaction committed, otherwise nothing happened
+**/
+__attribute__((target("rtm"))) static bool commit_rtm(struct state* st, struct transaction* trans, size_t align) {
+    for (int attempt = 0; attempt < TM_RTM_RETRIES; ++attempt){
+        unsigned int status = _xbegin();
+        if (status == _XBEGIN_STARTED){
+            //reading the lock words subscribes to them
+            for (auto const& read : trans->reads){
+                for (uint32_t k = 0; k < read.count; ++k){
+                    uint64_t word = read.lock[k].load(memory_order_relaxed);
+                    if (is_locked(word) || version_of(word) > trans->rv){
+                        _xabort(0xff);
+                    }
+                }
+            }
+            for (auto const& entry : trans->writes.entries){
+                if (is_locked(lock_of(st, entry.location)->load(memory_order_relaxed))){
+                    _xabort(0xfe);
+                }
+            }
+            uint64_t wv = st->clock->load(memory_order_relaxed) + 1;
+            st->clock->store(wv, memory_order_relaxed);
+            for (auto const& entry : trans->writes.entries){
+                writeset_publish_entry(&trans->writes, entry, align);
+                lock_of(st, entry.location)->store(wv << 1, memory_order_relaxed);
+            }
+            _xend();
+            return true;
+        }
+        //a read set no longer valid will not get better, and the others will not either if the hardware says so
+        if ((status & _XABORT_EXPLICIT) || !(status & _XABORT_RETRY)){
+            break;
+        }
+    }
+    return false;
+}
+#endif
+
+/** Descriptor kept between transactions by each thread, or by each CPU with USE_RSEQ, so that its vectors keep their capacity.
+**/
+static percpu_spare<struct transaction> spare;
+
+/** Get the bytes a descriptor holds, the unused capacity of its vectors included.
+ * @param trans Transaction descriptor
+ * @return Size (in bytes)
+**/
+static size_t footprint(struct transaction const* trans){
+    return sizeof(*trans) + trans->reads.capacity() * sizeof(struct read_entry) + writeset_footprint(&trans->writes)
+        + trans->stripes.capacity() * sizeof(pair<vlock*, void const*>) + trans->locked.capacity() * sizeof(pair<vlock*, uint64_t>)
+        + (trans->allocs.capacity() + trans->frees.capacity() + trans->dropped.capacity()) * sizeof(struct segment*)
+        + trans->marks.capacity() * sizeof(struct savepoint) + trans->undo.capacity() * sizeof(struct undo_entry) + trans->undo_data.capacity()
+#ifdef USE_HOT_STRIPES
+        + trans->hot.capacity() * sizeof(pair<uint32_t, bool>)
+#endif
+        ;
+}
+
+/** Release what the transaction holds in the region and recycle its descriptor.
+ * @param trans Transaction to finish
+**/
+static void finish(struct transaction* trans){
+#ifdef USE_HOT_STRIPES
+    hot_unlock((struct state*) trans->region->engine, trans);
+#endif
+    trans->region->counters[trans->slot].descriptor.store(footprint(trans), memory_order_relaxed);
+#ifdef USE_MULTIVERSION
+    if (trans->isolated){
+        ((struct state*) trans->region->engine)->snapshots[trans->slot].rv.store(0, memory_order_release);
+    }
+#endif
+    epoch_exit(trans->region, trans->slot);
+    trans->reads.clear();
+    writeset_clear(&trans->writes);
+    trans->stripes.clear();
+    trans->locked.clear();
+    trans->allocs.clear();
+    trans->frees.clear();
+    trans->marks.clear();
+    trans->undo.clear();
+    trans->undo_data.clear();
+    trans->dropped.clear();
+    if (!spare.keep(trans)){
+        delete trans;
+    }
+}
+
+/** Withdraw a read-only transaction, which holds nothing but its epoch slot.
+ * @param region Region the transaction ran on
+ * @param st     Engine state
+ * @param slot   Epoch slot of the transaction
+**/
+static void finish_ro(struct region* region, struct state* st as(unused), size_t slot){
+    if (unlikely(!ro_views.empty())){
+        ro_views.erase(remove_if(ro_views.begin(), ro_views.end(), [slot](struct ro_view const& view){ return view.slot == slot; }), ro_views.end());
+    }
+#ifdef USE_MULTIVERSION
+    st->snapshots[slot].rv.store(0, memory_order_release);
+#endif
+    epoch_exit(region, slot);
+}
+
+/** Abort a read-only transaction.
+ * @param region Region the transaction ran on
+ * @param st     Engine state
+ * @param tx     Handle of the transaction
+ * @param reason Reason of the abort, one of 'TM_ABORT_*'
+**/
+static void rollback_ro(struct region* region, struct state* st, tx_t tx, int reason){
+    PROFILE(PROFILE_ROLLBACK);
+    counter_add(region->counters[ro_tx_slot(tx)].aborts[reason], 1);
+    TRACE_REASON(reason);
+    OPACITY(ro_sample_of(tx), OPACITY_ABORT, NULL, ro_tx_rv(tx));
+    cm_abort(&region->cm, 0);
+    finish_ro(region, st, ro_tx_slot(tx));
+}
+
+/** Read in a read-only transaction: no read set, the snapshot is enough.
+ * @param region Region to read from
+ * @param st     Engine state
+ * @param tx     Handle of the transaction
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes)
+ * @param target Target start address (in a private region)
+ * @return Whether the transaction can continue
+**/
+static bool read_ro(struct region* region, struct state* st, tx_t tx, void const* source, size_t size, void* target){
+    size_t align = region->align;
+    uint64_t rv = ro_tx_rv(tx);
+    uint64_t sample as(unused) = ro_sample_of(tx);
+    counter_add(region->counters[ro_tx_slot(tx)].reads, 1);
+    prefetch_ahead(st, ro_read_end, source, size);
+    for (size_t i = 0; i < size; i += align){
+        byte const* src = (byte const*) source + i;
+        byte* dst = (byte*) target + i;
+        vlock* lock = lock_of(st, src);
+        uint64_t pre = lock->load(memory_order_acquire);
+        for (size_t attempt = 0; is_locked(pre) && lock_wait(region, st, lock, attempt); ++attempt){
+            pre = lock->load(memory_order_acquire);
+        }
+        word_copy(dst, src, align);
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t post = lock->load(memory_order_relaxed);
+        if (is_locked(pre) || pre != post || version_of(pre) > rv){
+#ifdef USE_MULTIVERSION
+            if (history_read(st, rv, src, dst, align)){
+                continue;
+            }
+#endif
+            conflict(region, st, lock, src);
+            //the retry snapshot must include that version
+            clock_advance(st, version_of(post));
+            rollback_ro(region, st, tx, TM_ABORT_READ);
+            return false;
+        }
+        OPACITY(sample, OPACITY_READ, src, version_of(pre));
+    }
+    return true;
+}
+
+/** Get the start of the stripe of a word, the stripes of a range following each other every '1 << st->shift' bytes.
+ * @param st   Engine state
+ * @param addr Word address
+ * @return Start of the stripe
+**/
+static inline byte const* stripe_start(struct state* st, void const* addr){
+    return (byte const*) (st->base + ((((uintptr_t) addr - st->base) >> st->shift) << st->shift));
+}
+
+/** Check the ranges a read-only transaction viewed in place still reflect its snapshot.
+ * @param st Engine state
+ * @param tx Handle of the transaction
+ * @return Whether no stripe of its views is locked or newer than its snapshot
+**/
+static bool ro_views_valid(struct state* st, tx_t tx){
+    size_t slot = ro_tx_slot(tx);
+    uint64_t rv = ro_tx_rv(tx);
+    size_t step = (size_t) 1 << st->shift;
+    for (auto const& view : ro_views){
+        if (view.slot != slot){
+            continue;
+        }
+        byte const* end = (byte const*) view.source + view.size;
+        for (byte const* at = stripe_start(st, view.source); at < end; at += step){
+            uint64_t word = lock_of(st, at)->load(memory_order_acquire);
+            if (is_locked(word) || version_of(word) > rv){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/** View a range in place in a read-only transaction, its stripes checked now and again in 'tm_end'.
+ * @param region Region to read from
+ * @param st     Engine state
+ * @param tx     Handle of the transaction
+ * @param source Source start address (in the shared region)
+ * @param size   Length to view (in bytes)
+ * @param view   Receives the start of the view, NULL if the range must be read instead
+ * @return Whether the transaction can continue
+**/
+static bool read_view_ro(struct region* region, struct state* st, tx_t tx, void const* source, size_t size, void const** view){
+    if (ro_sample_of(tx) != 0){
+        return true;
+    }
+    uint64_t rv = ro_tx_rv(tx);
+    size_t step = (size_t) 1 << st->shift;
+    byte const* end = (byte const*) source + size;
+    for (byte const* at = stripe_start(st, source); at < end; at += step){
+        vlock* lock = lock_of(st, at);
+        uint64_t word = lock->load(memory_order_acquire);
+        for (size_t attempt = 0; is_locked(word) && lock_wait(region, st, lock, attempt); ++attempt){
+            word = lock->load(memory_order_acquire);
+        }
+        if (is_locked(word) || version_of(word) > rv){
+#ifdef USE_MULTIVERSION
+            if (!is_locked(word)){
+                //only the history holds the values of the snapshot
+                return true;
+            }
+#endif
+            conflict(region, st, lock, at < source ? source : at);
+            clock_advance(st, version_of(word));
+            rollback_ro(region, st, tx, TM_ABORT_READ);
+            return false;
+        }
+    }
+    counter_add(region->counters[ro_tx_slot(tx)].reads, 1);
+    ro_views.push_back({ro_tx_slot(tx), source, size});
+    *view = source;
+    return true;
+}
+
+/** Undo what a transaction did and release its descriptor.
+ * @param tx     Transaction to abort
+ * @param reason Reason of the abort, one of 'TM_ABORT_*'
+**/
+static void rollback(tx_t tx, int reason){
+    PROFILE(PROFILE_ROLLBACK);
+    struct transaction* trans = (struct transaction*) tx;
+    counter_add(trans->region->counters[trans->slot].aborts[reason], 1);
+    TRACE_REASON(reason);
+    OPACITY(trans->sample, OPACITY_ABORT, NULL, trans->rv);
+    //releasing the locks with their previous version
+    for (auto& entry : trans->locked){
+        entry.first->store(entry.second, memory_order_release);
+    }
+#ifdef USE_PREEMPT
+    if (!trans->locked.empty()){
+        beacon_beat((struct state*) trans->region->engine, trans, true);
+    }
+#endif
+    //rolling back allocs
+    for (auto seg : trans->allocs){
+        segment_destroy(seg);
+    }
+    //the retry likely writes the same words
+    for (auto const& entry : trans->writes.entries){
+        cm_predict(&trans->region->cm, entry.location);
+    }
+    cm_abort(&trans->region->cm, trans->reads.size() + trans->writes.entries.size());
+    finish(trans);
+}
+
+/** Abort a transaction after an access that cannot continue, or only fail it while it holds a savepoint.
+ * @param tx     Transaction that cannot continue
+ * @param reason Reason of the abort, one of 'TM_ABORT_*'
+**/
+static void fail(tx_t tx, int reason){
+    struct transaction* trans = (struct transaction*) tx;
+    if (trans->marks.empty()){
+        rollback(tx, reason);
+        return;
+    }
+    //counted once rolled back or ended
+    TRACE_REASON(reason);
+    trans->failed = reason;
+}
+
+/** Get the index of the first segment written in place, those allocated since the latest savepoint.
+ * @param trans Transaction descriptor
+ * @return Index in the allocated segments
+**/
+static inline size_t captured_from(struct transaction const* trans){
+    return trans->marks.empty() ? 0 : trans->marks.back().allocs;
+}
+
+/** Save the buffered content of a word about to change, if it was written before the latest savepoint.
+ * @param trans Transaction holding the word in its write set
+ * @param entry Entry of the word, NULL if not written yet
+ * @param align Size of a word
+**/
+static inline void undo_log(struct transaction* trans, struct write_entry const* entry, size_t align){
+    if (entry == NULL || trans->marks.empty()){
+        return;
+    }
+    size_t at = entry - trans->writes.entries.data();
+    if (at >= trans->marks.back().writes){
+        //added since, dropped as a whole
+        return;
+    }
+    byte const* buffered = trans->writes.data.data() + entry->offset;
+    trans->undo.push_back({at, entry->delta});
+    trans->undo_data.insert(trans->undo_data.end(), buffered, buffered + align);
+}
+
+//================================================================
+// End of Helper functions
+//================================================================
+
+bool create(shared_t shared) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = new (std::nothrow) struct state();
+    if (unlikely(st == NULL)){
+        return false;
+    }
+    if (region->shm != NULL){
+        //every process indexes the table of the object alike, by offset in the first segment
+        size_t stripes;
+        vlock* locks = shm_locks(region, &stripes);
+        if (unlikely(!table_create(region, &st->table, stripes, locks))){
+            delete st;
+            return false;
+        }
+        st->fixed = true;
+        st->clock = shm_clock(region);
+        st->base = (uintptr_t) region->start;
+    } else {
+        if (unlikely(!table_create(region, &st->table, stripe_count(region, &st->fixed), NULL))){
+            delete st;
+            return false;
+        }
+        st->clock = &st->own_clock;
+        st->base = 0;
+    }
+    st->per_word.store(TM_STRIPES_PER_WORD, memory_order_relaxed);
+    st->resizes.store(0, memory_order_relaxed);
+#ifdef USE_CONFLICT_STATS
+    st->conflicts.store(0, memory_order_relaxed);
+    st->false_conflicts.store(0, memory_order_relaxed);
+    st->seen_conflicts.store(0, memory_order_relaxed);
+    st->seen_false.store(0, memory_order_relaxed);
+#endif
+#ifdef USE_HOT_STRIPES
+    st->hots = new (std::nothrow) struct hot[TM_HOT_SLOTS]();
+    if (unlikely(st->hots == NULL)){
+        table_destroy(&st->table);
+        delete st;
+        return false;
+    }
+    st->hot_conflicts.store(0, memory_order_relaxed);
+#endif
+#ifdef USE_MULTIVERSION
+    for (auto& snapshot : st->snapshots){
+        snapshot.rv.store(0, memory_order_relaxed);
+    }
+    st->horizon.store(0, memory_order_relaxed);
+#endif
+#ifdef USE_RTM
+    st->rtm = rtm_supported();
+#endif
+    st->own_clock.store(0, memory_order_relaxed);
+    st->shift = stripe_shift(region);
+#ifdef USE_NUMA_SHARDS
+    st->region = region;
+#endif
+    region->engine = st;
+    return true;
+}
+
+void destroy(shared_t shared) noexcept {
+    struct state* st = (struct state*) ((struct region*) shared)->engine;
+#ifdef USE_CONFLICT_STATS
+    uint64_t conflicts = st->conflicts.load(memory_order_relaxed);
+    uint64_t false_conflicts = st->false_conflicts.load(memory_order_relaxed);
+    fprintf(stderr, "tl2: %zu stripes, %lu conflicts, %lu false conflicts (%.2f%%)\n", st->table.mask + 1, conflicts, false_conflicts, conflicts > 0 ? 100. * false_conflicts / conflicts : 0.);
+#endif
+#ifdef USE_HOT_STRIPES
+    delete[] st->hots;
+#endif
+    table_destroy(&st->table);
+    delete st;
+}
+
+/** Add the lock table of an engine state to statistics, the chains of old values of the multi-version mode not being counted.
+ * @param engine Engine state
+ * @param stats  Statistics to complete
+**/
+void stats(void* engine, struct tm_stats* stats) noexcept {
+    struct state* st = (struct state*) engine;
+    stats->stripes = st->table.mask + 1;
+    stats->resizes = st->resizes.load(memory_order_relaxed);
+    size_t per_stripe = sizeof(vlock);
+#ifdef USE_MULTIVERSION
+    per_stripe += sizeof(atomic<struct version*>);
+#endif
+#ifdef USE_CONFLICT_STATS
+    per_stripe += sizeof(atomic<uintptr_t>);
+#endif
+    stats->metadata_bytes += sizeof(*st) + (st->table.mask + 1) * per_stripe;
+#ifdef USE_HOT_STRIPES
+    stats->metadata_bytes += TM_HOT_SLOTS * sizeof(struct hot);
+#endif
+}
+
+/** Begin a transaction that may write.
+ * @param region   Region to begin on
+ * @param st       Engine state
+ * @param isolated Whether it runs under snapshot isolation
+ * @return Transaction, 'invalid_tx' if out of memory
+**/
+static tx_t begin_rw(struct region* region, struct state* st as(unused), bool isolated) {
+    struct transaction* trans = spare.take();
+    if (unlikely(trans == NULL)){
+        trans = new (std::nothrow) struct transaction();
+        if (unlikely(trans == NULL)){
+            return invalid_tx;
+        }
+    }
+    trans->region = region;
+    trans->read_end = NULL;
+    trans->isolated = isolated;
+    trans->failed = -1;
+#ifdef USE_EAGER_DOOM
+    trans->doom_reads = TM_DOOM_PERIOD;
+#endif
+    cm_begin(&region->cm);
+    //announce before sampling the clock, so that what the snapshot reaches stays allocated
+    trans->slot = epoch_enter(region);
+#ifdef USE_MULTIVERSION
+    if (isolated){
+        //as a read-only transaction, the values this snapshot needs are kept
+        st->snapshots[trans->slot].rv.store(st->clock->load(memory_order_seq_cst) + 1, memory_order_seq_cst);
+    }
+#endif
+    trans->rv = st->clock->load(memory_order_seq_cst);
+    trans->sample = OPACITY_SAMPLE(trans->rv);
+    return (tx_t) trans;
+}
+
+tx_t begin(shared_t shared, bool is_ro) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    if (is_ro){
+        cm_begin(&region->cm);
+        //announce before sampling the clock, so that what the snapshot reaches stays allocated
+        size_t slot = epoch_enter(region);
+#ifdef USE_MULTIVERSION
+        //announced before sampling again, so that the values this snapshot needs are kept
+        st->snapshots[slot].rv.store(st->clock->load(memory_order_seq_cst) + 1, memory_order_seq_cst);
+#endif
+        tx_t tx = ro_tx(st->clock->load(memory_order_seq_cst), slot);
+#ifdef USE_OPACITY_LOG
+        ro_sample = OPACITY_SAMPLE(ro_tx_rv(tx));
+        ro_sampled = ro_sample != 0 ? tx : invalid_tx;
+#endif
+        return tx;
+    }
+    return begin_rw(region, st, false);
+}
+
+tx_t begin_snapshot(shared_t shared) noexcept {
+    struct region* region = (struct region*) shared;
+    return begin_rw(region, (struct state*) region->engine, true);
+}
+
+/** Begin a read-only transaction at the snapshot of another, see 'tm_begin_join'.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Read-only transaction to join, still running
+ * @return Transaction, 'invalid_tx' if the joined one may write, its snapshot moving with its read set
+**/
+tx_t begin_join(shared_t shared, tx_t tx) noexcept {
+    if (!is_ro_tx(tx)){
+        return invalid_tx;
+    }
+    struct region* region = (struct region*) shared;
+    struct state* st as(unused) = (struct state*) region->engine;
+    uint64_t rv = ro_tx_rv(tx);
+    cm_begin(&region->cm);
+    //what the snapshot reaches is kept by the joined transaction until this one announced itself
+    size_t slot = epoch_enter(region);
+#ifdef USE_MULTIVERSION
+    st->snapshots[slot].rv.store(rv + 1, memory_order_seq_cst);
+#endif
+    return ro_tx(rv, slot);
+}
+
+/** Publish the writes of a linearized transaction, and release its locks with its write version.
+ * @param region Region the transaction runs on
+ * @param st     Engine state
+ * @param trans  Transaction holding the locks of its write set
+**/
+static void publish(struct region* region, struct state* st as(unused), struct transaction* trans) {
+    uint64_t wv = trans->wv;
+#ifdef USE_MULTIVERSION
+    if ((wv & 31) == 0){
+        horizon_update(st);
+    }
+    struct version* garbage = NULL;
+    for (auto const& entry : trans->writes.entries){
+        history_push(st, trans, entry, region->align, wv, &garbage);
+    }
+    if (garbage != NULL){
+        garbage->retired.destroy = versions_free;
+        garbage->retired.object = garbage;
+        epoch_retire(region, &garbage->retired);
+    }
+#endif
+#ifdef USE_PREEMPT
+    //the write-back of a large write set takes a while
+    beacon_beat(st, trans);
+#endif
+    writeset_publish(&trans->writes, region->align, region->stream);
+    for (auto& entry : trans->locked){
+        entry.first->store(wv << 1, memory_order_release);
+    }
+#ifdef USE_PREEMPT
+    beacon_beat(st, trans, true);
+#endif
+#ifdef USE_OPACITY_LOG
+    if (unlikely(trans->sample != 0)){
+        for (auto const& entry : trans->writes.entries){
+            opacity_log(trans->sample, OPACITY_WRITE, entry.location, wv);
+        }
+        //the reads were validated at that snapshot, not necessarily up to the write version
+        opacity_log(trans->sample, OPACITY_COMMIT, NULL, trans->rv);
+    }
+#endif
+}
+
+bool end(shared_t shared, tx_t tx) noexcept {
+    bool pending;
+    if (!end_linearize(shared, tx, &pending)){
+        return false;
+    }
+    if (pending){
+        end_publish(shared, tx);
+    }
+    return true;
+}
+
+/** Commit a transaction up to its linearization point: locked write set, write version taken and read set validated.
+ * Transactions that allocated or freed segments, and those with nothing left to do, end at once.
+ * @param shared  Shared memory region associated with the transaction
+ * @param tx      Transaction to commit
+ * @param pending Set if the transaction still has to be ended with 'end_publish', from any thread
+ * @return Whether the transaction committed
+**/
+bool end_linearize(shared_t shared, tx_t tx, bool* pending) noexcept {
+    *pending = false;
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    if (is_ro_tx(tx)){
+        //every read was consistent with the snapshot
+        if (unlikely(!ro_views.empty()) && !ro_views_valid(st, tx)){
+            rollback_ro(region, st, tx, TM_ABORT_VALIDATE);
+            return false;
+        }
+        OPACITY(ro_sample_of(tx), OPACITY_COMMIT, NULL, ro_tx_rv(tx));
+        cm_commit(&region->cm);
+        counter_add(region->counters[ro_tx_slot(tx)].commits, 1);
+        finish_ro(region, st, ro_tx_slot(tx));
+        return true;
+    }
+    struct transaction* trans = (struct transaction*) tx;
+    if (unlikely(trans->failed >= 0)){
+        //never rolled back to a savepoint
+        rollback(tx, trans->failed);
+        return false;
+    }
+    //the lock table is sized for the live segments
+    bool live = !trans->allocs.empty() || !trans->frees.empty();
+    for (auto seg : trans->dropped){
+        trans->allocs.erase(find(trans->allocs.begin(), trans->allocs.end(), seg));
+        segment_destroy(seg);
+    }
+
+    //every read was consistent with the snapshot, nothing to publish
+    if (trans->writes.entries.empty() && trans->frees.empty()){
+        for (auto seg : trans->allocs){
+            segment_register(region, seg);
+        }
+        OPACITY(trans->sample, OPACITY_COMMIT, NULL, trans->rv);
+        cm_commit(&region->cm);
+        counter_add(region->counters[trans->slot].commits, 1);
+        finish(trans);
+        table_check(region, st, live);
+        return true;
+    }
+
+    //before any lock, the transaction with the priority must never wait for this one
+    cm_yield(&region->cm);
+#ifdef USE_RTM
+    //a hardware transaction cannot log nor ship its writes before publishing them
+    if (st->rtm && trans->frees.empty() && region->persist == NULL && region->ship == NULL && commit_rtm(st, trans, region->align)){
+        for (auto seg : trans->allocs){
+            segment_register(region, seg);
+        }
+        cm_commit(&region->cm);
+        counter_add(region->counters[trans->slot].commits, 1);
+        finish(trans);
+        table_check(region, st, live);
+        return true;
+    }
+#endif
+
+    //lock the write set, and the whole content of freed segments, in stripe order
+    for (auto const& entry : trans->writes.entries){
+        trans->stripes.emplace_back(lock_of(st, entry.location), entry.location);
+    }
+    for (auto seg : trans->frees){
+        size_t words = seg->size / region->align;
+        if (words > st->table.mask + 1){
+            words = st->table.mask + 1;
+        }
+        for (size_t i = 0; i < words; ++i){
+            trans->stripes.emplace_back(lock_of(st, seg->mem + i * region->align), seg->mem + i * region->align);
+        }
+    }
+    sort(trans->stripes.begin(), trans->stripes.end(), [](pair<vlock*, void const*> const& a, pair<vlock*, void const*> const& b) { return a.first < b.first; });
+    for (size_t i = 0; i < trans->stripes.size(); ++i){
+        //two words on the same stripe
+        if (i > 0 && trans->stripes[i].first == trans->stripes[i - 1].first){
+            continue;
+        }
+        if (!acquire(st, trans, trans->stripes[i].first, trans->stripes[i].second)){
+            rollback(tx, TM_ABORT_LOCK);
+            return false;
+        }
+    }
+
+#ifdef USE_GROUP_COMMIT
+    int outcome = group_commit(region, st, trans);
+    if (outcome != GROUP_COMMITTED){
+        rollback(tx, outcome);
+        return false;
+    }
+#else
+    //get the write version, validate unless nobody committed since begin
+    bool alone;
+    uint64_t wv = commit_version(st, trans, &alone);
+    if (!alone && !(trans->isolated ? validate_writes(trans) : validate(st, trans))){
+        rollback(tx, TM_ABORT_VALIDATE);
+        return false;
+    }
+    //last step that can fail, a logged transaction is replayed by recovery
+    if (unlikely(region->persist != NULL) && !persist_commit(region, &trans->writes)){
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    if (unlikely(region->ship != NULL)){
+        ship_commit(region, &trans->writes);
+    }
+    trans->wv = wv;
+#endif
+
+    if (!live){
+        //the rest cannot fail, and touches nothing of the calling thread
+        cm_commit(&region->cm);
+        *pending = true;
+        return true;
+    }
+    publish(region, st, trans);
+
+    for (auto seg : trans->allocs){
+        segment_register(region, seg);
+    }
+    for (auto seg : trans->frees){
+        segment_unregister(region, seg);
+        segment_retire(region, seg);
+    }
+    cm_commit(&region->cm);
+    counter_add(region->counters[trans->slot].commits, 1);
+    finish(trans);
+    table_check(region, st, live);
+    return true;
+}
+
+/** End a transaction linearized by 'end_linearize': publish its writes, release its locks and recycle it.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to end, from any thread
+**/
+void end_publish(shared_t shared, tx_t tx) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    struct transaction* trans = (struct transaction*) tx;
+    publish(region, st, trans);
+    counter_add(region->counters[trans->slot].commits, 1);
+    finish(trans);
+    table_check(region, st, false);
+}
+
+bool read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    if (is_ro_tx(tx)){
+        return read_ro(region, st, tx, source, size, target);
+    }
+    struct transaction* trans = (struct transaction*) tx;
+    size_t align = region->align;
+
+    if (unlikely(trans->failed >= 0)){
+        return false;
+    }
+    counter_add(region->counters[trans->slot].reads, 1);
+    if (segment_captured(trans->allocs, source, size, captured_from(trans))){
+        words_copy(target, source, size, align);
+        return true;
+    }
+    prefetch_ahead(st, trans->read_end, source, size);
+    for (size_t i = 0; i < size; i += align){
+        byte const* src = (byte const*) source + i;
+        byte* dst = (byte*) target + i;
+        //read-after-write, return the buffered value
+        struct write_entry* written = writeset_find(&trans->writes, src);
+        if (written != NULL && !written->delta){
+            word_copy(dst, trans->writes.data.data() + written->offset, align);
+            continue;
+        }
+        vlock* lock = lock_of(st, src);
+#ifdef USE_HOT_STRIPES
+        if (!hot_lock(st, trans, hot_slot(st, lock), false)){
+            conflict(region, st, lock, src);
+            fail(tx, TM_ABORT_LOCK);
+            return false;
+        }
+#endif
+        uint64_t pre = lock->load(memory_order_acquire);
+        for (size_t attempt = 0; is_locked(pre) && lock_wait(region, st, lock, attempt); ++attempt){
+            pre = lock->load(memory_order_acquire);
+        }
+        word_copy(dst, src, align);
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t post = lock->load(memory_order_relaxed);
+#ifdef USE_MULTIVERSION
+        if (trans->isolated){
+            //the snapshot never moves, nothing to validate later
+            if ((is_locked(pre) || pre != post || version_of(pre) > trans->rv) && !history_read(st, trans->rv, src, dst, align)){
+                conflict(region, st, lock, src);
+                fail(tx, TM_ABORT_READ);
+                return false;
+            }
+            if (written != NULL){
+                undo_log(trans, written, align);
+                writeset_fold(&trans->writes, written, dst, align);
+            }
+            continue;
+        }
+#endif
+        if (is_locked(pre) || pre != post || (version_of(pre) > trans->rv && (!extend(st, trans, version_of(pre)) || version_of(pre) > trans->rv))){
+            conflict(region, st, lock, src);
+            fail(tx, TM_ABORT_READ);
+            return false;
+        }
+        {
+            PROFILE(PROFILE_LOG);
+            read_log(trans, lock, src);
+        }
+#ifdef USE_EAGER_DOOM
+        if (unlikely(--trans->doom_reads == 0)){
+            trans->doom_reads = max<size_t>(TM_DOOM_PERIOD, trans->reads.size());
+            //doomed if a commit since the snapshot wrote a word already read
+            if (st->clock->load(memory_order_relaxed) != trans->rv && !extend(st, trans, 0)){
+                fail(tx, TM_ABORT_VALIDATE);
+                return false;
+            }
+        }
+#endif
+        OPACITY(trans->sample, OPACITY_READ, src, version_of(pre));
+        if (written != NULL){
+            //incremented before, the increment now depends on the value read
+            undo_log(trans, written, align);
+            writeset_fold(&trans->writes, written, dst, align);
+        }
+    }
+    return true;
+}
+
+bool read_view(shared_t shared, tx_t tx, void const* source, size_t size, void const** view) noexcept {
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    *view = NULL;
+    if (is_ro_tx(tx)){
+        return read_view_ro(region, st, tx, source, size, view);
+    }
+    struct transaction* trans = (struct transaction*) tx;
+    size_t align = region->align;
+
+    if (unlikely(trans->failed >= 0)){
+        return false;
+    }
+    if (segment_captured(trans->allocs, source, size, captured_from(trans))){
+        counter_add(region->counters[trans->slot].reads, 1);
+        *view = source;
+        return true;
+    }
+    //nothing validates a snapshot read, and a sample logs every word
+    if (trans->isolated || trans->sample != 0){
+        return true;
+    }
+    //the shared memory does not show the buffered writes
+    if (!trans->writes.entries.empty()){
+        for (size_t i = 0; i < size; i += align){
+            if (writeset_find(&trans->writes, (byte const*) source + i) != NULL){
+                return true;
+            }
+        }
+    }
+    counter_add(region->counters[trans->slot].reads, 1);
+    size_t step = (size_t) 1 << st->shift;
+    byte const* end = (byte const*) source + size;
+    for (byte const* at = stripe_start(st, source); at < end; at += step){
+        byte const* src = at < source ? (byte const*) source : at;
+        vlock* lock = lock_of(st, src);
+#ifdef USE_HOT_STRIPES
+        if (!hot_lock(st, trans, hot_slot(st, lock), false)){
+            conflict(region, st, lock, src);
+            fail(tx, TM_ABORT_LOCK);
+            return false;
+        }
+#endif
+        uint64_t word = lock->load(memory_order_acquire);
+        for (size_t attempt = 0; is_locked(word) && lock_wait(region, st, lock, attempt); ++attempt){
+            word = lock->load(memory_order_acquire);
+        }
+        if (is_locked(word) || (version_of(word) > trans->rv && (!extend(st, trans, version_of(word)) || version_of(word) > trans->rv))){
+            conflict(region, st, lock, src);
+            fail(tx, TM_ABORT_READ);
+            return false;
+        }
+        //validated with the reads at commit, which fails if the view changed meanwhile
+        read_log(trans, lock, src);
+    }
+    *view = source;
+    return true;
+}
+
+bool write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    size_t align = region->align;
+    struct transaction* trans = (struct transaction*) tx;
+
+    counter_add(region->counters[trans->slot].writes, 1);
+    if (segment_captured(trans->allocs, target, size, captured_from(trans))){
+        words_copy(target, source, size, align);
+        return true;
+    }
+    for (size_t i = 0; i < size; i += align){
+        byte const* src = (byte const*) source + i;
+#ifdef USE_HOT_STRIPES
+        struct state* st = (struct state*) region->engine;
+        vlock* lock = lock_of(st, (byte*) target + i);
+        if (!hot_lock(st, trans, hot_slot(st, lock), true)){
+            conflict(region, st, lock, (byte*) target + i);
+            fail(tx, TM_ABORT_LOCK);
+            return false;
+        }
+#endif
+        if (unlikely(!trans->marks.empty())){
+            undo_log(trans, writeset_find(&trans->writes, (byte*) target + i), align);
+        }
+        writeset_add(&trans->writes, (byte*) target + i, src, align);
+    }
+    return true;
+}
+
+bool write_reserve(shared_t shared, tx_t tx, void* target, size_t size, void** buffer) noexcept {
+    struct region* region = (struct region*) shared;
+    size_t align = region->align;
+    struct transaction* trans = (struct transaction*) tx;
+    *buffer = NULL;
+
+    if (segment_captured(trans->allocs, target, size, captured_from(trans))){
+        counter_add(region->counters[trans->slot].writes, 1);
+        *buffer = target;
+        return true;
+    }
+    //a savepoint needs the previous content of each word rewritten
+    if (unlikely(!trans->marks.empty())){
+        return true;
+    }
+#ifdef USE_HOT_STRIPES
+    struct state* st = (struct state*) region->engine;
+    for (size_t i = 0; i < size; i += align){
+        vlock* lock = lock_of(st, (byte*) target + i);
+        if (!hot_lock(st, trans, hot_slot(st, lock), true)){
+            conflict(region, st, lock, (byte*) target + i);
+            fail(tx, TM_ABORT_LOCK);
+            return false;
+        }
+    }
+#endif
+    *buffer = writeset_reserve(&trans->writes, (byte*) target, size, align);
+    if (*buffer != NULL){
+        counter_add(region->counters[trans->slot].writes, 1);
+    }
+    return true;
+}
+
+bool add(shared_t shared, tx_t tx, void* target, int64_t delta) noexcept {
+    struct region* region = (struct region*) shared;
+    struct transaction* trans = (struct transaction*) tx;
+
+    //no read, the increment applies to the value the stripe lock protects at commit
+    counter_add(region->counters[trans->slot].writes, 1);
+    if (segment_captured(trans->allocs, target, region->align, captured_from(trans))){
+        word_add(target, delta);
+        return true;
+    }
+#ifdef USE_HOT_STRIPES
+    struct state* st = (struct state*) region->engine;
+    vlock* lock = lock_of(st, target);
+    if (!hot_lock(st, trans, hot_slot(st, lock), true)){
+        conflict(region, st, lock, target);
+        fail(tx, TM_ABORT_LOCK);
+        return false;
+    }
+#endif
+    if (unlikely(!trans->marks.empty())){
+        undo_log(trans, writeset_find(&trans->writes, target), region->align);
+    }
+    writeset_add_delta(&trans->writes, (byte*) target, delta, region->align);
+    return true;
+}
+
+bool hint(shared_t shared, tx_t tx as(unused), void const* const* addresses, size_t count, uint64_t write_mask) noexcept {
+    struct state* st = (struct state*) ((struct region*) shared)->engine;
+    //stripes are only locked at commit, warm them and the words for the accesses to come
+    for (size_t i = 0; i < count; ++i){
+        if ((write_mask >> i) & 1){
+            __builtin_prefetch(lock_of(st, addresses[i]), 1);
+            __builtin_prefetch(addresses[i], 1);
+        } else {
+            __builtin_prefetch(lock_of(st, addresses[i]), 0);
+            __builtin_prefetch(addresses[i], 0);
+        }
+    }
+#ifdef USE_HOT_STRIPES
+    struct transaction* trans = (struct transaction*) tx;
+    if (is_ro_tx(tx) || trans->failed >= 0){
+        return true;
+    }
+    //the hot stripes to write locked exclusive upfront, in slot order so that hinted transactions wait in no cycle
+    pair<uint32_t, size_t> slots[TM_HINT_MAX];
+    size_t nb_slots = 0;
+    for (size_t i = 0; i < count; ++i){
+        if ((write_mask >> i) & 1){
+            slots[nb_slots++] = {hot_slot(st, lock_of(st, addresses[i])), i};
+        }
+    }
+    sort(slots, slots + nb_slots);
+    for (size_t j = 0; j < nb_slots; ++j){
+        if (!hot_lock(st, trans, slots[j].first, true)){
+            conflict(trans->region, st, lock_of(st, addresses[slots[j].second]), addresses[slots[j].second]);
+            fail(tx, TM_ABORT_LOCK);
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+void release(shared_t shared, tx_t tx, void const* source, size_t size) noexcept {
+    if (is_ro_tx(tx)){
+        //no read set, nothing to drop
+        return;
+    }
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    struct transaction* trans = (struct transaction*) tx;
+    size_t align = region->align;
+
+    if (!trans->marks.empty()){
+        //a savepoint restores the read set by size
+        return;
+    }
+    //the words released may change before the snapshot, the sample cannot be checked
+    trans->sample = 0;
+    for (size_t i = 0; i < size; i += align){
+        vlock* lock = lock_of(st, (byte const*) source + i);
+        //recent reads are the likely ones
+        for (size_t j = trans->reads.size(); j-- > 0;){
+            auto& read = trans->reads[j];
+            if (lock < read.lock || lock >= read.lock + read.count){
+                continue;
+            }
+            if (read.words != read.count){
+                //another read of the range may be on this stripe, keep it
+                break;
+            }
+            uint32_t at = (uint32_t) (lock - read.lock);
+            if (read.count == 1){
+                read = trans->reads.back();
+                trans->reads.pop_back();
+            } else if (at == 0){
+                ++read.lock;
+                --read.count;
+                --read.words;
+            } else if (at == read.count - 1){
+                --read.count;
+                --read.words;
+            } else {
+                //split around the stripe
+                struct read_entry tail = read;
+                tail.lock = lock + 1;
+                tail.count = tail.words = read.count - at - 1;
+                read.count = read.words = at;
+                trans->reads.push_back(tail);
+            }
+            break;
+        }
+    }
+}
+
+Alloc alloc(shared_t shared, tx_t tx, size_t size, void** target) noexcept {
+    //the other processes could not reach a segment of this one
+    if (unlikely(((struct region*) shared)->shm != NULL)){
+        return Alloc::nomem;
+    }
+    struct segment* seg = segment_create((struct region*) shared, size);
+    if (unlikely(seg == NULL)){
+        return Alloc::nomem;
+    }
+    //private until commit, registered only if the transaction commits
+    struct transaction* trans = (struct transaction*) tx;
+    trans->allocs.push_back(seg);
+    counter_add(trans->region->counters[trans->slot].allocs, 1);
+    *target = (void*) seg->mem;
+    return Alloc::success;
+}
+
+bool dealloc(shared_t shared, tx_t tx, void* target) noexcept {
+    struct transaction* trans = (struct transaction*) tx;
+    for (auto it = trans->allocs.begin(); it != trans->allocs.end(); ++it){
+        //allocated by this very transaction, nobody else can see it
+        if ((*it)->mem == target){
+            if ((size_t) (it - trans->allocs.begin()) < captured_from(trans)){
+                //a rollback to the savepoint must find it again
+                trans->dropped.push_back(*it);
+                counter_add(trans->region->counters[trans->slot].frees, 1);
+                return true;
+            }
+            segment_destroy(*it);
+            trans->allocs.erase(it);
+            counter_add(trans->region->counters[trans->slot].frees, 1);
+            return true;
+        }
+    }
+    struct segment* seg = segment_find((struct region*) shared, target);
+    if (seg == NULL || seg->mem != target){
+        //not the start of a live segment (e.g. freed concurrently), abort
+        fail(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    counter_add(trans->region->counters[trans->slot].frees, 1);
+    for (auto other : trans->frees){
+        if (other == seg){
+            return true;
+        }
+    }
+    trans->frees.push_back(seg);
+    return true;
+}
+
+/** Mark the accesses of a transaction so far, see 'tm_savepoint'.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to mark
+ * @param mark   Receives the index of the mark
+ * @return Whether the mark was taken, not for read-only transactions nor for isolated snapshots that never move
+**/
+bool savepoint(shared_t shared as(unused), tx_t tx, size_t* mark) noexcept {
+    if (is_ro_tx(tx)){
+        //no logs to mark, and nothing to gain from a partial retry
+        return false;
+    }
+    struct transaction* trans = (struct transaction*) tx;
+    if (trans->failed >= 0){
+        return false;
+    }
+#ifdef USE_MULTIVERSION
+    if (trans->isolated){
+        //the snapshot never moves, a retry would read the same values
+        return false;
+    }
+#endif
+    struct savepoint point;
+    point.reads = trans->reads.size();
+    point.count = point.reads > 0 ? trans->reads.back().count : 0;
+    point.words = point.reads > 0 ? trans->reads.back().words : 0;
+    point.writes = trans->writes.entries.size();
+    point.data = trans->writes.data.size();
+    point.undo = trans->undo.size();
+    point.allocs = trans->allocs.size();
+    point.dropped = trans->dropped.size();
+    point.frees = trans->frees.size();
+    *mark = trans->marks.size();
+    trans->marks.push_back(point);
+    return true;
+}
+
+/** Undo the accesses of a transaction since a mark and move its snapshot forward, see 'tm_rollback_to'.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction holding the mark
+ * @param mark   Index of the mark
+ * @return Whether the transaction can continue, otherwise it was aborted
+**/
+bool rollback_to(shared_t shared, tx_t tx, size_t mark) noexcept {
+    if (is_ro_tx(tx)){
+        return false;
+    }
+    struct region* region = (struct region*) shared;
+    struct state* st = (struct state*) region->engine;
+    struct transaction* trans = (struct transaction*) tx;
+    if (unlikely(mark >= trans->marks.size())){
+        rollback(tx, TM_ABORT_OTHER);
+        return false;
+    }
+    PROFILE(PROFILE_ROLLBACK);
+    //the reads undone may have changed before the snapshot moved
+    trans->sample = 0;
+    struct savepoint const point = trans->marks[mark];
+    size_t align = region->align;
+    //buffered words back to their content at the mark, latest change first
+    for (size_t i = trans->undo.size(); i-- > point.undo;){
+        struct write_entry& entry = trans->writes.entries[trans->undo[i].entry];
+        entry.delta = trans->undo[i].delta;
+        word_copy(trans->writes.data.data() + entry.offset, trans->undo_data.data() + i * align, align);
+    }
+    trans->undo.resize(point.undo);
+    trans->undo_data.resize(point.undo * align);
+    writeset_truncate(&trans->writes, point.writes, point.data);
+    trans->reads.resize(point.reads);
+    if (point.reads > 0){
+        trans->reads.back().count = point.count;
+        trans->reads.back().words = point.words;
+    }
+    trans->read_end = NULL;
+    for (size_t i = point.allocs; i < trans->allocs.size(); ++i){
+        segment_destroy(trans->allocs[i]);
+    }
+    trans->allocs.resize(point.allocs);
+    trans->dropped.resize(point.dropped);
+    trans->frees.resize(point.frees);
+    trans->marks.resize(mark + 1);
+    if (trans->failed >= 0){
+        counter_add(region->counters[trans->slot].aborts[trans->failed], 1);
+        trans->failed = -1;
+    }
+    //what the transaction read before the mark must hold at the snapshot the retry reads at
+    if (!extend(st, trans, 0)){
+        rollback(tx, TM_ABORT_VALIDATE);
+        return false;
+    }
+    return true;
+}
+
+/** Allocate the descriptor of the calling thread ahead of its first transaction, on its NUMA node.
+ * @param shared Region the thread entered
+**/
+void thread_enter(shared_t shared as(unused)) noexcept {
+    spare.prepare();
+}
+
+/** Free the descriptor the calling thread kept between its transactions.
+ * @param shared Region the thread leaves
+**/
+void thread_leave(shared_t shared as(unused)) noexcept {
+    spare.drop();
+}
+
+}
@@ -21,421 +21,1975 @@
 #endif
 
 // External headers
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <vector>
 #include <shared_mutex>
 #include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 // Internal headers
 #include <tm.hpp>
+#include <tm_ext.hpp>
+#include "common.hpp"
+#include "engine.hpp"
+#include "heatmap.hpp"
+#include "metrics.hpp"
+#include "numa.hpp"
+#include "opacity.hpp"
+#include "persist.hpp"
+#include "profile.hpp"
+#include "region.hpp"
+#include "ship.hpp"
+#include "shm.hpp"
+#include "slab.hpp"
+#include "trace.hpp"
+#include "watchdog.hpp"
+#include "word.hpp"
 
 #include <iostream>
 using namespace std;
 
-// -------------------------------------------------------------------------- //
+/** Entry points of a given engine.
+ * @param name            Namespace of the engine
+ * @param read_for_update Read of words about to be written, 'name::read' if the engine has no better one
+ * @param end_linearize   First half of a split 'end', 'nullptr' if the engine does not split it
+ * @param end_publish     Second half of a split 'end', 'nullptr' if the engine does not split it
+ * @param hint            Declaration of the words a transaction will access, 'nullptr' if the engine has no use for it
+ * @param begin_snapshot  Begin under snapshot isolation, 'nullptr' if the engine does not offer it
+ * @param savepoint       Mark of the accesses of a transaction, 'nullptr' if the engine only rolls back wholly
+ * @param rollback_to     Partial rollback to a mark, 'nullptr' if the engine only rolls back wholly
+ * @param begin_join      Begin a read-only transaction on the snapshot of another, 'nullptr' if the engine cannot share one
+ * @param read_view       Read in place validated at commit, 'nullptr' if every read of the engine copies
+ * @param write_reserve   Room in the write set for the caller to fill, 'nullptr' if every write of the engine copies
+**/
+#define ENGINE(name, read_for_update, end_linearize, end_publish, hint, begin_snapshot, savepoint, rollback_to, begin_join, read_view, write_reserve) \
+    { #name, name::create, name::destroy, name::begin, name::end, name::read, read_for_update, name::write, name::add, name::release, name::alloc, name::dealloc, name::thread_enter, name::thread_leave, end_linearize, end_publish, hint, begin_snapshot, savepoint, rollback_to, begin_join, read_view, write_reserve }
+
+static struct engine const engines[] = {
+    ENGINE(tl2, tl2::read, tl2::end_linearize, tl2::end_publish, tl2::hint, tl2::begin_snapshot, tl2::savepoint, tl2::rollback_to, tl2::begin_join, tl2::read_view, tl2::write_reserve),
+    ENGINE(norec, norec::read, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr),
+    ENGINE(pessimistic, pessimistic::read_for_update, nullptr, nullptr, pessimistic::hint, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr),
+    ENGINE(adaptive, adaptive::read_for_update, nullptr, nullptr, adaptive::hint, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr),
+    ENGINE(dstm, dstm::read, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr),
+    ENGINE(ring, ring::read, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr),
+};
 
-/** Define a proposition as likely true.
- * @param prop Proposition
+#undef ENGINE
+
+/** Entry point of the engine of a region, called directly when the build pins the engine.
+ * @param shared Region, of type 'shared_t' or 'struct region*'
+ * @param op     Entry point, one every engine defines under that name
 **/
-#undef likely
-#ifdef __GNUC__
-    #define likely(prop) \
-        __builtin_expect((prop) ? 1 : 0, 1)
+#ifdef TM_STATIC_ENGINE
+    #define ENGINE_CALL(shared, op) TM_STATIC_ENGINE::op
 #else
-    #define likely(prop) \
-        (prop)
+    #define ENGINE_CALL(shared, op) ((struct region*) (shared))->ops->op
 #endif
 
-/** Define a proposition as likely false.
- * @param prop Proposition
+/** Get the engine a new region uses, named by its options, 'TM_ENGINE' or else by the build.
+ * @param wanted Engine named by the options of the region, NULL for none
+ * @return Engine to use, NULL if the options name an unknown engine
 **/
-#undef unlikely
-#ifdef __GNUC__
-    #define unlikely(prop) \
-        __builtin_expect((prop) ? 1 : 0, 0)
+static struct engine const* engine_select(char const* wanted) noexcept {
+#ifdef TM_STATIC_ENGINE
+    //no other engine can run, as 'ENGINE_CALL' bypasses the entry points
+    struct engine const* fixed = NULL;
+    for (auto const& candidate : engines){
+        if (strcmp(candidate.name, TM_ENGINE) == 0){
+            fixed = &candidate;
+        }
+    }
+    if (wanted != NULL && strcmp(wanted, TM_ENGINE) != 0){
+        return NULL;
+    }
+    char const* name = getenv("TM_ENGINE");
+    if (name != NULL && strcmp(name, TM_ENGINE) != 0){
+        fprintf(stderr, "tm: engine '%s' not built in, using '%s'\n", name, TM_ENGINE);
+    }
+    return fixed;
 #else
-    #define unlikely(prop) \
-        (prop)
+    if (wanted != NULL) {
+        for (auto const& candidate : engines){
+            if (strcmp(candidate.name, wanted) == 0){
+                return &candidate;
+            }
+        }
+        return NULL;
+    }
+    char const* name = getenv("TM_ENGINE");
+    struct engine const* fallback = &engines[0];
+    for (auto const& candidate : engines){
+        if (strcmp(candidate.name, TM_ENGINE) == 0){
+            fallback = &candidate;
+        }
+        if (name != NULL && strcmp(candidate.name, name) == 0){
+            return &candidate;
+        }
+    }
+    if (name != NULL){
+        fprintf(stderr, "tm: unknown engine '%s', using '%s'\n", name, fallback->name);
+    }
+    return fallback;
 #endif
+}
+
+#ifdef USE_NUMA_STATS
+
+/** Accesses of the running transaction of the thread, added to the region when it ends.
+**/
+static thread_local struct {
+    uint64_t local;
+    uint64_t remote;
+    uint64_t interleaved;
+} accesses = {0, 0, 0};
+
+/** Count an access by the locality of the segment accessed.
+ * @param region Region accessed
+ * @param addr   Address accessed
+**/
+static void numa_count(struct region* region, void const* addr) noexcept {
+    struct segment* seg = segment_find(region, addr);
+    if (seg == NULL) {
+        return;
+    }
+    if (seg->node < 0) {
+        ++accesses.interleaved;
+    } else if ((size_t) seg->node == numa_node()) {
+        ++accesses.local;
+    } else {
+        ++accesses.remote;
+    }
+}
 
-/** Define one or several attributes.
- * @param type... Attribute names
+/** Add the accesses of the transaction that just ended to the region.
+ * @param region Region the transaction ran on
 **/
-#undef as
-#ifdef __GNUC__
-    #define as(type...) \
-        __attribute__((type))
+static void numa_flush(struct region* region) noexcept {
+    region->numa.local.fetch_add(accesses.local, memory_order_relaxed);
+    region->numa.remote.fetch_add(accesses.remote, memory_order_relaxed);
+    region->numa.interleaved.fetch_add(accesses.interleaved, memory_order_relaxed);
+    accesses = {0, 0, 0};
+}
+
+#define NUMA_COUNT(region, addr) \
+    numa_count((region), (addr))
+#define NUMA_FLUSH(region) \
+    numa_flush(region)
+
 #else
-    #define as(type...)
-    #warning This compiler has no support for GCC attributes
+
+#define NUMA_COUNT(region, addr) \
+    do {} while (0)
+#define NUMA_FLUSH(region) \
+    do {} while (0)
+
 #endif
 
 // -------------------------------------------------------------------------- //
 
-struct segment {
-    shared_mutex lock;
-    byte* mem;
-    size_t size;
-    bool freed;
-};
+/** Get the page map entry of the given page.
+ * @param region  Region to search
+ * @param replica Copy of the page map to search
+ * @param page    Page number
+ * @param create  Whether to allocate the leaf if missing
+ * @return Page map entry, NULL if the leaf is missing
+**/
+static pagemap_leaf* pagemap_entry(struct region* region, size_t replica, uintptr_t page, bool create) noexcept {
+    std::atomic<pagemap_leaf*>& root = region->pagemap[replica][(page >> PAGEMAP_LEAF_LOG2) & ((1ul << PAGEMAP_ROOT_LOG2) - 1)];
+    pagemap_leaf* leaf = root.load(memory_order_acquire);
+    if (unlikely(leaf == NULL)) {
+        if (!create) {
+            return NULL;
+        }
+        pagemap_leaf* fresh = (pagemap_leaf*) calloc(1ul << PAGEMAP_LEAF_LOG2, sizeof(pagemap_leaf));
+        if (unlikely(fresh == NULL)) {
+            return NULL;
+        }
+        if (region->replicas > 1) {
+            numa_bind(fresh, (1ul << PAGEMAP_LEAF_LOG2) * sizeof(pagemap_leaf), replica);
+        }
+        //another thread may have installed the leaf meanwhile
+        if (root.compare_exchange_strong(leaf, fresh, memory_order_acq_rel)) {
+            leaf = fresh;
+            region->overhead.fetch_add((1ul << PAGEMAP_LEAF_LOG2) * sizeof(pagemap_leaf), memory_order_relaxed);
+        } else {
+            free(fresh);
+        }
+    }
+    return leaf + (page & ((1ul << PAGEMAP_LEAF_LOG2) - 1));
+}
 
-struct region {
-    void* start;
-    vector<struct segment*> segments;
-    size_t size;
-    size_t align;
-};
+/** Free the page map of a region.
+ * @param region Region whose page map is freed
+**/
+static void pagemap_destroy(struct region* region) noexcept {
+    for (size_t r = 0; r < region->replicas; ++r){
+        if (region->pagemap[r] == NULL) {
+            continue;
+        }
+        for (size_t i = 0; i < (1ul << PAGEMAP_ROOT_LOG2); ++i){
+            free(region->pagemap[r][i].load(memory_order_relaxed));
+        }
+        free(region->pagemap[r]);
+    }
+}
+
+// Low bit of the page map entries of a segment created but not registered, or unregistered but not destroyed yet (only with USE_NUMA_SHARDS)
+#define PAGEMAP_UNREGISTERED 1
+
+/** Get the page map entry of a segment that is not registered, which 'segment_find' skips.
+ * With USE_NUMA_SHARDS the segment stays there from its creation to its destruction, so that its node is known all along.
+ * @param seg Segment that is not registered
+ * @return Entry to store
+**/
+static inline struct segment* pagemap_unregistered(struct segment* seg as(unused)) noexcept {
+#ifdef USE_NUMA_SHARDS
+    return (struct segment*) ((uintptr_t) seg | PAGEMAP_UNREGISTERED);
+#else
+    return NULL;
+#endif
+}
+
+#ifdef USE_PACKS
+
+// Second bit of the page map entries of the pages of a pack, which hold the pack rather than a segment
+#define PAGEMAP_PACKED 2
+// Number of size classes of the packs, the class 'c' holding segments of up to '8 << c' bytes
+#define PACK_CLASSES (__builtin_ctzl(TM_PACK_MAX) - 2)
+// Most slots of a pack, bounding its bitmaps
+#define PACK_SLOTS ((TM_PACK_PAGES << SEGMENT_PAGE_LOG2) / sizeof(struct segment))
 
-struct log{
-    size_t size;
-    void* location;
-    void* old_data;
-    struct log* next;
+static_assert((TM_PACK_MAX & (TM_PACK_MAX - 1)) == 0 && TM_PACK_MAX >= 8, "the largest packed segment is a power of 2 of at least a word");
+
+/** Pages of small segments of one size class: this record on the first page, the headers of the slots, their dirty bits,
+ * then the memory of every slot side by side, so that small segments allocated together share lines and pages.
+ * Every page maps to the pack, which is kept until the region is destroyed: a lookup never reaches a freed pack.
+**/
+struct segment_pack {
+    struct segment_packs* packs; // Packs of the region
+    size_t klass;    // Size class of the pack
+    size_t shift;    // Log2 of the size of a slot
+    size_t capacity; // Number of slots
+    struct segment* headers; // Headers of the slots
+    std::atomic<uint64_t>* dirty; // Dirty bits of the slots, 'dirty_words' of a slot each
+    std::byte* mem;  // Memory of the first slot, the others follow
+    struct segment_pack* partial; // Next pack of the class with a free slot, under the lock of the class
+    struct segment_pack* next;    // Next pack of the class, under the lock of the class
+    size_t used;     // Slots allocated, under the lock of the class
+    uint64_t taken[(PACK_SLOTS + 63) / 64]; // Allocated slots, one bit each, under the lock of the class
+    alignas(CACHE_LINE) std::atomic<uint64_t> listed[(PACK_SLOTS + 63) / 64]; // Registered slots, the ones 'segment_find' returns
 };
 
-struct transaction {
-    struct log* logs;
-    vector<struct segment*> to_free;
-    vector<shared_mutex*> to_free_locks;
-    vector<struct segment*> new_segments;
-    vector<shared_mutex*> new_seg_locks;
-    struct region* region;
-    bool is_ro;
-    vector<shared_mutex*> locks;
-    vector<shared_mutex*> read_locks;
+/** Packs of the small segments of a region, by size class.
+**/
+struct segment_packs {
+    struct alignas(CACHE_LINE) {
+        mutex lock;
+        struct segment_pack* partial; // Packs with a free slot, the one allocated from first
+        struct segment_pack* all;     // Every pack of the class
+    } classes[PACK_CLASSES];
 };
 
-/** Create (i.e. allocate + init) a new shared memory region, with one first non-free-able allocated segment of the requested size and alignment.
- * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
- * @param align Alignment (in bytes, must be a power of 2) that the shared memory region must support
- * @return Opaque shared memory region handle, 'invalid_shared' on failure
+/** Mark the slot of a packed segment registered or not.
+ * @param seg    Segment in a pack
+ * @param listed Whether the segment is now registered
 **/
-shared_t tm_create(size_t size, size_t align) noexcept{
-    struct region* region = new (std::nothrow) struct region();
-    if (unlikely(region == NULL)) {
-        return invalid_shared;
+static void pack_list(struct segment* seg, bool listed) noexcept {
+    struct segment_pack* pack = seg->pack;
+    size_t slot = seg - pack->headers;
+    if (listed) {
+        //the header is visible to whoever sees the bit
+        pack->listed[slot / 64].fetch_or(1ul << (slot % 64), memory_order_release);
+    } else {
+        pack->listed[slot / 64].fetch_and(~(1ul << (slot % 64)), memory_order_release);
     }
+}
 
-    struct segment* seg = new (std::nothrow) struct segment();
-    if (unlikely(seg == NULL)) {
-        delete region;
-        return invalid_shared;
+/** Find the registered segment of a pack containing the given address.
+ * @param pack Pack whose pages hold the address
+ * @param addr Address to look for
+ * @return Segment containing the address, NULL if none
+**/
+static inline struct segment* pack_find(struct segment_pack* pack, void const* addr) noexcept {
+    if (unlikely((std::byte const*) addr < pack->mem)) {
+        return NULL;
     }
-
-    if (unlikely(posix_memalign(&(region->start), align, size) != 0)){
-        delete seg;
-        delete region;
-        return invalid_shared;
+    size_t slot = ((std::byte const*) addr - pack->mem) >> pack->shift;
+    if (unlikely(slot >= pack->capacity || !(pack->listed[slot / 64].load(memory_order_acquire) & (1ul << (slot % 64))))) {
+        return NULL;
     }
+    struct segment* seg = pack->headers + slot;
+    //the end of the slot may lie past the end of the segment
+    return addr < seg->mem + seg->size ? seg : NULL;
+}
 
-    memset(region->start, 0, size);
-    region->align = align;
-    region->size = size;
-    seg->mem = (byte*) region->start;
-    seg->size = size;
-    seg->freed = false;
-    region->segments.push_back(seg);
+#endif
 
-    return region;
-}
-/** Destroy (i.e. clean-up + free) a given shared memory region.
- * @param shared Shared memory region to destroy, with no running transaction
+/** Set the page map entries of every page of a segment, in every replica.
+ * @param region Region to update
+ * @param seg    Segment whose pages are updated
+ * @param owner  Segment to store, NULL to clear
 **/
-void tm_destroy(shared_t shared ) noexcept {
-    struct region* region = (struct region*) shared;
-    for (auto seg : region->segments){
-        free(seg->mem);
-        delete seg;
+static void pagemap_set(struct region* region, struct segment* seg, struct segment* owner) noexcept {
+#ifdef USE_PACKS
+    if (seg->source == BLOCK_PACKED) {
+        //the pages map to the pack, which tells its registered slots apart
+        pack_list(seg, owner == seg);
+        return;
+    }
+#endif
+    uintptr_t last = ((uintptr_t) (seg->mem + seg->size - 1)) >> SEGMENT_PAGE_LOG2;
+    for (size_t r = 0; r < region->replicas; ++r){
+        for (uintptr_t page = ((uintptr_t) seg) >> SEGMENT_PAGE_LOG2; page <= last; ++page){
+            //leaves were allocated by 'segment_create'
+            pagemap_entry(region, r, page, false)->store(owner, memory_order_release);
+        }
     }
-    delete region;
 }
 
-/** [thread-safe] Return the start address of the first allocated segment in the shared memory region.
- * @param shared Shared memory region to query
- * @return Start address of the first allocated segment
+// Backing of the mapped blocks, set by 'TM_HUGEPAGES'
+#define HUGEPAGES_NONE 0 // Base pages (default)
+#define HUGEPAGES_THP  1 // Transparent huge pages, 'thp'
+#define HUGEPAGES_2M   2 // Explicit 2 MiB pages, '2M'
+#define HUGEPAGES_1G   3 // Explicit 1 GiB pages, '1G'
+
+/** Parse a backing of the mapped blocks.
+ * @param name Backing, as in 'TM_HUGEPAGES'
+ * @return One of 'HUGEPAGES_*', -1 if unknown
 **/
-void* tm_start(shared_t shared) noexcept {
-    return ((struct region*) shared)->start;
+static int hugepages_parse(char const* name) noexcept {
+    if (strcmp(name, "none") == 0) {
+        return HUGEPAGES_NONE;
+    }
+    if (strcmp(name, "thp") == 0) {
+        return HUGEPAGES_THP;
+    }
+    if (strcmp(name, "2M") == 0) {
+        return HUGEPAGES_2M;
+    }
+    if (strcmp(name, "1G") == 0) {
+        return HUGEPAGES_1G;
+    }
+    return -1;
 }
 
-/** [thread-safe] Return the size (in bytes) of the first allocated segment of the shared memory region.
- * @param shared Shared memory region to query
- * @return First allocated segment size
+/** Get how the mapped blocks are backed by default, once.
+ * @return One of 'HUGEPAGES_*'
 **/
-size_t tm_size(shared_t shared) noexcept {
-    return ((struct region*) shared)->size;
+static int hugepages_mode() noexcept {
+    static int const mode = []() {
+        char const* env = getenv("TM_HUGEPAGES");
+        int parsed = env == NULL ? -1 : hugepages_parse(env);
+        return parsed < 0 ? HUGEPAGES_NONE : parsed;
+    }();
+    return mode;
 }
 
-/** [thread-safe] Return the alignment (in bytes) of the memory accesses on the given shared memory region.
- * @param shared Shared memory region to query
- * @return Alignment used globally
+/** Map fresh anonymous pages, with the given alignment.
+ * @param size  Size of the mapping, a multiple of the page size
+ * @param align Alignment of the mapping, at least the page size
+ * @param flags Additional flags of 'mmap'
+ * @return Mapping, NULL on failure
 **/
-size_t tm_align(shared_t shared) noexcept {
-    return ((struct region*) shared)->align;
+static void* block_mmap(size_t size, size_t align, int flags) noexcept {
+    size_t page = 1ul << SEGMENT_PAGE_LOG2;
+    size_t extra = align > page ? align : 0;
+    void* map = mmap(NULL, size + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (unlikely(map == MAP_FAILED)){
+        return NULL;
+    }
+    if (extra == 0){
+        return map;
+    }
+    //keep the aligned part only
+    uintptr_t start = ((uintptr_t) map + align - 1) & ~(align - 1);
+    if (start > (uintptr_t) map){
+        munmap(map, start - (uintptr_t) map);
+    }
+    uintptr_t end = (uintptr_t) map + size + extra;
+    if (end > start + size){
+        munmap((void*) (start + size), end - (start + size));
+    }
+    return (void*) start;
 }
 
-//================================================================
-//Helper functions
-//================================================================
-void free_segments(tx_t tx, vector<segment*> to_free){
-    struct transaction* trans = (struct transaction*) tx;
-    int index = 0;
-    for(auto seg : trans->region->segments){
-        for(auto seg_to_free : to_free){
-            //find segment to free
-            if(seg == seg_to_free){
-                trans->region->segments.erase(trans->region->segments.begin() + index);
-                free(seg->mem);
-                delete seg;
+/** Map fresh zeroed pages for a block too large for the slabs, on huge pages if the region asks for them and possible.
+ * @param region Region the block is for
+ * @param size   Size of the block, a multiple of the page size, rounded up to the huge page size if explicit huge pages are used
+ * @param align  Alignment of the block, at least the page size
+ * @return Block, NULL on failure
+**/
+static void* block_map(struct region* region, size_t* size, size_t align) noexcept {
+    int mode = region->hugepages;
+    if (mode == HUGEPAGES_2M || mode == HUGEPAGES_1G) {
+        int shift = mode == HUGEPAGES_2M ? 21 : 30;
+        size_t huge = 1ul << shift;
+        if (*size >= huge && align <= huge) {
+            //huge mappings are aligned on their page size
+            size_t rounded = (*size + huge - 1) & ~(huge - 1);
+            void* map = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+            if (map != MAP_FAILED) {
+                *size = rounded;
+                return map;
             }
         }
-        ++index;
+        //no huge page reserved, let the kernel do what it can
+        mode = HUGEPAGES_THP;
     }
-    return;
+    size_t huge = 1ul << 21;
+    if (mode == HUGEPAGES_THP && *size >= huge) {
+        //transparent huge pages only back aligned ranges
+        void* block = block_mmap(*size, align > huge ? align : huge, 0);
+        if (block != NULL) {
+            madvise(block, *size, MADV_HUGEPAGE);
+        }
+        return block;
+    }
+    return block_mmap(*size, align, 0);
 }
 
-void rollback(tx_t tx){
-    struct transaction* trans = (struct transaction*) tx;
-    //if aborting, all the locks are taken
-    if (!trans->is_ro){
-        //rolling back writes
-        struct log* change = trans->logs;
-        struct log* tmp;
-        while(change != NULL){
-            memcpy(change->location, change->old_data, change->size);
-            free(change->old_data);
-            tmp = change->next;
-            delete change;
-            change = tmp;
-        }
-        //rolling back free
-        for(auto segment : trans->to_free){
-            segment->freed = false;
-        }
-        //rolling back allocs
-        free_segments(tx, trans->new_segments);
+/** Get the number of words of the dirty bits of a segment.
+ * @param size Size of the segment (in bytes)
+ * @return Number of 64-bit words, one bit per TM_DIRTY_LOG2 bytes
+**/
+static inline size_t dirty_words(size_t size) noexcept {
+    size_t ranges = (size + (1ul << TM_DIRTY_LOG2) - 1) >> TM_DIRTY_LOG2;
+    return (ranges + 63) / 64;
+}
 
-        for (auto lock : trans->locks) {
-           lock->unlock();
-        }
-        for (auto lock : trans->to_free_locks) {
-           lock->unlock();
-        }
-    }
+/** Mapping holding the blocks of the segments moved by one 'tm_compact', on its first page followed by the blocks.
+**/
+struct segment_arena {
+    atomic<size_t> segments; // Segments not destroyed yet, the last one unmaps the arena
+    size_t size; // Size of the mapping (in bytes)
+};
 
-    //unlocking
-    for (auto lock : trans->read_locks) {
-       lock->unlock();
+/** Get the layout of the block of a segment: the header, the memory, then its dirty bits, on whole pages.
+ * @param region Region the segment belongs to
+ * @param size   Size of the segment (in bytes)
+ * @param header Receives the size of the header, i.e. the offset of the memory in the block (NULL to ignore)
+ * @param bitmap Receives the offset of the dirty bits from the memory (NULL to ignore)
+ * @return Size of the block (in bytes)
+**/
+static size_t segment_layout(struct region* region, size_t size, size_t* header, size_t* bitmap) noexcept {
+    size_t align = region->align < sizeof(void*) ? sizeof(void*) : region->align;
+    size_t page = 1ul << SEGMENT_PAGE_LOG2;
+    size_t head = (sizeof(struct segment) + align - 1) & ~(align - 1);
+    //the dirty bits follow the memory, the header keeps it aligned on a word
+    size_t bits = (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    if (header != NULL) {
+        *header = head;
     }
-    delete trans;
-    return;
+    if (bitmap != NULL) {
+        *bitmap = bits;
+    }
+    return (head + bits + dirty_words(size) * sizeof(uint64_t) + page - 1) & ~(page - 1);
 }
 
-bool check_lock(tx_t tx, shared_mutex* lock){
-    struct transaction * trans = (struct transaction*) tx;
-    for(auto candidate : trans->read_locks){
-       if (candidate == lock) {
-            return true;
-       }
+/** Make sure the page map can hold the pages of a block, so that registering a segment there cannot fail.
+ * @param region Region to update
+ * @param block  Start of the block
+ * @param size   Size of the block (in bytes)
+ * @return Whether every replica can hold the pages
+**/
+static bool pagemap_reserve(struct region* region, void const* block, size_t size) noexcept {
+    for (size_t r = 0; r < region->replicas; ++r){
+        for (uintptr_t p = ((uintptr_t) block) >> SEGMENT_PAGE_LOG2; p <= ((uintptr_t) block + size - 1) >> SEGMENT_PAGE_LOG2; ++p){
+            if (unlikely(pagemap_entry(region, r, p, true) == NULL)) {
+                return false;
+            }
+        }
     }
-    if (trans->is_ro){
-        return false;
+    return true;
+}
+
+#ifdef USE_PACKS
+/** Create an empty pack of a size class, every page of which maps to it.
+ * @param region Region the pack belongs to
+ * @param klass  Size class of the pack
+ * @return New pack, NULL on failure
+**/
+static struct segment_pack* pack_create(struct region* region, size_t klass) noexcept {
+    size_t total = TM_PACK_PAGES << SEGMENT_PAGE_LOG2;
+    void* block;
+    if (unlikely(posix_memalign(&block, 1ul << SEGMENT_PAGE_LOG2, total) != 0)) {
+        return NULL;
     }
-    for(auto candidate : trans->locks){
-       if (candidate == lock) {
-            return true;
-       }
+    if (unlikely(!pagemap_reserve(region, block, total))) {
+        free(block);
+        return NULL;
     }
-    for(auto candidate : trans->new_seg_locks){
-       if (candidate == lock) {
-            return true;
-       }
+    if (region->placed) {
+        //the slots are allocated by every thread
+        numa_interleave(block, total);
     }
-    for(auto candidate : trans->to_free_locks){
-       if (candidate == lock) {
-            return true;
-       }
+    struct segment_pack* pack = new (block) struct segment_pack();
+    size_t object = 8ul << klass;
+    size_t words = dirty_words(object);
+    size_t align = region->align > CACHE_LINE ? region->align : CACHE_LINE;
+    size_t head = (sizeof(struct segment_pack) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+    size_t capacity = (total - head - align) / (sizeof(struct segment) + words * sizeof(uint64_t) + object);
+    pack->packs = region->packs;
+    pack->klass = klass;
+    pack->shift = klass + 3;
+    pack->capacity = capacity < PACK_SLOTS ? capacity : PACK_SLOTS;
+    pack->headers = (struct segment*) ((std::byte*) block + head);
+    pack->dirty = (std::atomic<uint64_t>*) (pack->headers + pack->capacity);
+    pack->mem = (std::byte*) (((uintptr_t) (pack->dirty + pack->capacity * words) + align - 1) & ~(align - 1));
+    pack->used = 0;
+    for (size_t r = 0; r < region->replicas; ++r){
+        for (uintptr_t page = ((uintptr_t) block) >> SEGMENT_PAGE_LOG2; page < ((uintptr_t) block + total) >> SEGMENT_PAGE_LOG2; ++page){
+            pagemap_entry(region, r, page, false)->store((struct segment*) ((uintptr_t) pack | PAGEMAP_PACKED), memory_order_release);
+        }
     }
-    return false;
+    return pack;
+}
 
+/** Allocate a new zeroed segment in a slot of a pack, not registered in the region yet.
+ * @param region Region the segment will belong to, with packs
+ * @param size   Size of the segment (in bytes), at most TM_PACK_MAX
+ * @return New segment, NULL on failure
+**/
+static struct segment* pack_alloc(struct region* region, size_t size) noexcept {
+    size_t klass = size <= 8 ? 0 : 64 - __builtin_clzl(size - 1) - 3;
+    auto& cls = region->packs->classes[klass];
+    struct segment_pack* pack;
+    size_t slot = 0;
+    {
+        lock_guard<mutex> guard(cls.lock);
+        pack = cls.partial;
+        if (pack == NULL) {
+            pack = pack_create(region, klass);
+            if (unlikely(pack == NULL)) {
+                return NULL;
+            }
+            pack->next = cls.all;
+            cls.all = pack;
+            pack->partial = NULL;
+            cls.partial = pack;
+        }
+        while (pack->taken[slot / 64] == UINT64_MAX){
+            slot += 64;
+        }
+        slot += __builtin_ctzl(~pack->taken[slot / 64]);
+        pack->taken[slot / 64] |= 1ul << (slot % 64);
+        if (++pack->used == pack->capacity) {
+            cls.partial = pack->partial;
+        }
+    }
+    size_t words = dirty_words(1ul << pack->shift);
+    struct segment* seg = new (pack->headers + slot) struct segment();
+    seg->mem = pack->mem + (slot << pack->shift);
+    seg->size = size;
+    seg->dirty = pack->dirty + slot * words;
+    for (size_t i = 0; i < words; ++i){
+        seg->dirty[i].store(UINT64_MAX, memory_order_relaxed);
+    }
+    seg->version.store(0, memory_order_relaxed);
+    seg->freed = false;
+    seg->node = -1;
+    //its share of the pack
+    seg->block = sizeof(struct segment) + words * sizeof(uint64_t) + (1ul << pack->shift);
+    seg->source = BLOCK_PACKED;
+    seg->arena = NULL;
+    seg->pack = pack;
+    memset(seg->mem, 0, size);
+    return seg;
 }
 
-//================================================================
-// End of Helper functions
-//================================================================
+/** Give the slot of a destroyed segment back to its pack.
+ * @param pack Pack holding the slot
+ * @param seg  Header of the destroyed segment
+**/
+static void pack_free(struct segment_pack* pack, struct segment* seg) noexcept {
+    size_t slot = seg - pack->headers;
+    auto& cls = pack->packs->classes[pack->klass];
+    lock_guard<mutex> guard(cls.lock);
+    pack->taken[slot / 64] &= ~(1ul << (slot % 64));
+    if (pack->used-- == pack->capacity) {
+        pack->partial = cls.partial;
+        cls.partial = pack;
+    }
+}
 
-/** [thread-safe] Begin a new transaction on the given shared memory region.
- * @param shared Shared memory region to start a transaction on
- * @param is_ro  Whether the transaction is read-only
- * @return Opaque transaction ID, 'invalid_tx' on failure
+/** Free the packs of a region, once every segment they hold was destroyed.
+ * @param region Region whose packs are freed
 **/
-tx_t tm_begin(shared_t shared, bool is_ro) noexcept {
-    struct transaction* tx = new (std::nothrow) struct transaction();
-    if(unlikely(tx == NULL)){
-       return invalid_tx;
+static void packs_destroy(struct region* region) noexcept {
+    if (region->packs == NULL) {
+        return;
+    }
+    for (auto& cls : region->packs->classes) {
+        while (cls.all != NULL){
+            struct segment_pack* next = cls.all->next;
+            cls.all->~segment_pack();
+            free(cls.all);
+            cls.all = next;
+        }
     }
-    tx->region = (struct region*) shared;
-    tx->is_ro = is_ro;
-    tx->logs = NULL;
-    return (tx_t) tx;
+    delete region->packs;
 }
+#endif
 
-/** [thread-safe] End the given transaction.
- * @param shared Shared memory region associated with the transaction
- * @param tx     Transaction to end
- * @return Whether the whole transaction committed
+/** Build the header of a segment at the start of its block, laid out by 'segment_layout', with every range dirty.
+ * The memory is left as is.
+ * @param region Region the segment will belong to
+ * @param block  Block of the segment, reserved in the page map
+ * @param size   Size of the segment (in bytes)
+ * @param total  Size of the block (in bytes)
+ * @param node   NUMA node the block was placed on, -1 if spread over every node
+ * @param source Where the block goes back to, one of 'BLOCK_*'
+ * @return New segment
 **/
-bool tm_end(shared_t shared as(unused), tx_t tx) noexcept {
-    struct transaction* trans = (struct transaction*) tx;
-    for (auto lock : trans->read_locks) {
-       lock->unlock();
+static struct segment* segment_init(struct region* region, void* block, size_t size, size_t total, int node, int source) noexcept {
+    size_t header;
+    size_t bitmap;
+    segment_layout(region, size, &header, &bitmap);
+    struct segment* seg = new (block) struct segment();
+    seg->mem = (std::byte*) block + header;
+    seg->size = size;
+    //every range of a new segment is missing from the last checkpoint
+    seg->dirty = (std::atomic<uint64_t>*) (seg->mem + bitmap);
+    for (size_t i = 0; i < dirty_words(size); ++i){
+        seg->dirty[i].store(UINT64_MAX, memory_order_relaxed);
     }
-    if (!trans ->is_ro){
-        free_segments(tx, trans->to_free);
+    seg->version.store(0, memory_order_relaxed);
+    seg->freed = false;
+    seg->node = node;
+    seg->block = total;
+    seg->source = source;
+    seg->arena = NULL;
+#ifdef USE_NUMA_SHARDS
+    pagemap_set(region, seg, pagemap_unregistered(seg));
+#endif
+    return seg;
+}
 
-        for (auto lock : trans->locks) {
-           lock->unlock();
+/** Allocate a new zeroed segment, not registered in the region yet.
+ * The header lives right in front of the memory, and the whole segment spans pages of its own.
+ * Blocks of freed segments of the same size are reused when available, larger blocks are fresh mappings,
+ * which the kernel zeroes page by page on first touch instead of them being cleared here ('TM_HUGEPAGES'
+ * backs them with huge pages). With USE_PACKS, segments of up to TM_PACK_MAX bytes take a slot of a pack instead.
+ * @param region Region the segment will belong to
+ * @param size   Size of the segment (in bytes)
+ * @return New segment, NULL on failure
+**/
+struct segment* segment_create(struct region* region, size_t size) noexcept {
+#ifdef USE_PACKS
+    //small segments share the pages of a pack, the first one is placed differently
+    if (size <= TM_PACK_MAX && region->start != NULL && region->packs != NULL) {
+        struct segment* seg = pack_alloc(region, size);
+        if (likely(seg != NULL)) {
+            return seg;
         }
-        for (auto lock : trans->new_seg_locks){
-            lock->unlock();
+    }
+#endif
+    size_t align = region->align < sizeof(void*) ? sizeof(void*) : region->align;
+    size_t page = 1ul << SEGMENT_PAGE_LOG2;
+    size_t total = segment_layout(region, size, NULL, NULL);
+    //recycled blocks are only page-aligned, and the first segment is placed differently
+    bool recycle = align <= page && region->start != NULL;
+    int node = -1;
+    void* block = recycle ? slab_alloc(total, &node) : NULL;
+    bool fresh = block == NULL;
+    int source = recycle ? BLOCK_SLAB : BLOCK_HEAP;
+    if (fresh && total > (SLAB_CLASSES << SEGMENT_PAGE_LOG2)){
+        block = block_map(region, &total, align < page ? page : align);
+        if (unlikely(block == NULL)){
+            return NULL;
         }
-
-        struct log* change = trans->logs;
-        struct log* tmp;
-        while(change != NULL){
-            free(change->old_data);
-            tmp = change->next;
-            delete change;
-            change = tmp;
+        source = BLOCK_MAPPED;
+    } else if (fresh && unlikely(posix_memalign(&block, align < page ? page : align, total) != 0)){
+        return NULL;
+    }
+    if (unlikely(!pagemap_reserve(region, block, total))) {
+        if (source == BLOCK_MAPPED) {
+            munmap(block, total);
+        } else {
+            free(block);
         }
+        return NULL;
     }
-    delete trans;
-    return true;
+    if (!region->placed) {
+        //left where the kernel puts it
+    } else if (region->start == NULL) {
+        //the first segment is accessed by every thread, spread it before the first touch
+        numa_interleave(block, total);
+    } else if (fresh) {
+        node = (int) numa_node();
+        if (source == BLOCK_MAPPED) {
+            //the pages are first touched by whichever thread accesses them
+            numa_bind(block, total, node);
+        }
+        //heap blocks are placed on the node of the allocating thread when cleared below
+    }
+    struct segment* seg = segment_init(region, block, size, total, node, source);
+    if (source != BLOCK_MAPPED) {
+        memset(seg->mem, 0, size);
+    }
+    return seg;
 }
 
-/** [thread-safe] Read operation in the given transaction, source in the shared region and target in a private region.
- * @param shared Shared memory region associated with the transaction
- * @param tx     Transaction to use
- * @param source Source start address (in the shared region)
- * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
- * @param target Target start address (in a private region)
- * @return Whether the whole transaction can continue
+/** Build a segment over memory the region does not own, e.g. part of a file mapping.
+ * The memory keeps its content, and neither it nor the header are freed when the segment is destroyed.
+ * @param region Region the segment will belong to
+ * @param block  Room for the header, before the memory and with no page of another segment in between
+ * @param mem    Memory of the segment, aligned for the region
+ * @param size   Size of the segment (in bytes)
+ * @return New segment, NULL on failure
 **/
-bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
-    struct region* region = (struct region*) shared;
-    for(auto seg : region->segments){
-        //find segment to read on
-        if(source >= seg->mem && source < seg->mem + seg->size){
-
-            if (!check_lock(tx,&seg->lock)){
-                if(!seg->lock.try_lock()){
-                    rollback(tx);
-                    return false;
-                } else {
-                //if locked, remember which one
-                ((struct transaction*) tx)->read_locks.push_back(&seg->lock);
+struct segment* segment_adopt(struct region* region, std::byte* block, std::byte* mem, size_t size) noexcept {
+    //make sure the page map can hold the segment, so that registering cannot fail
+    if (unlikely(!pagemap_reserve(region, block, mem + size - block))) {
+        return NULL;
+    }
+    struct segment* seg = new (block) struct segment();
+    seg->mem = mem;
+    seg->size = size;
+    seg->dirty = NULL;
+    seg->version.store(0, memory_order_relaxed);
+    seg->freed = false;
+    seg->node = -1;
+    seg->block = mem + size - block;
+    seg->source = BLOCK_FOREIGN;
+    seg->arena = NULL;
+#ifdef USE_NUMA_SHARDS
+    pagemap_set(region, seg, pagemap_unregistered(seg));
+#endif
+    return seg;
+}
 
-                }
-            }
-            //copy the memory
-            memcpy(target, source, size);
-            return true;
+/** Free a segment and its memory, it must not be registered anymore.
+ * @param seg Segment to destroy
+**/
+void segment_destroy(struct segment* seg) noexcept {
+    size_t block = seg->block;
+    int source = seg->source;
+    int node = seg->node;
+    struct segment_arena* arena = seg->arena;
+    struct segment_pack* pack as(unused) = seg->pack;
+    seg->~segment();
+    if (source == BLOCK_FOREIGN) {
+        return;
+    }
+#ifdef USE_PACKS
+    if (source == BLOCK_PACKED) {
+        pack_free(pack, seg);
+        return;
+    }
+#endif
+    if (source == BLOCK_ARENA) {
+        if (arena->segments.fetch_sub(1, memory_order_acq_rel) == 1) {
+            munmap(arena, arena->size);
         }
+        return;
+    }
+    if (source == BLOCK_MAPPED) {
+        munmap(seg, block);
+    } else if (source == BLOCK_HEAP || !slab_free(seg, block, node)) {
+        free(seg);
     }
-    printf("Not found for read\n");
-    rollback(tx);
-    return false;
 }
 
-/** [thread-safe] Write operation in the given transaction, source in a private region and target in the shared region.
- * @param shared Shared memory region associated with the transaction
- * @param tx     Transaction to use
- * @param source Source start address (in a private region)
- * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
- * @param target Target start address (in the shared region)
- * @return Whether the whole transaction can continue
+/** [thread-safe] Make a segment visible in the region.
+ * @param region Region to update
+ * @param seg    Segment to add
 **/
-bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
-    struct region* reg = (struct region*) shared;
-    struct transaction* trans = (struct transaction*) tx;
-
-    for(auto const& seg : reg->segments){
-
-        //find segment to write on
-        if(target >= seg->mem && target < seg->mem + seg->size){
-
-            //mabe i have it already
-            if (!check_lock(tx,&seg->lock)){
-                //no, try to lock it then
-                if(!seg->lock.try_lock()){
-                    //didn't work, aborting
-                    rollback(tx);
-                    return false;
-                } else {
-                    //i could lock, it is new, remember it
-                    trans->locks.push_back(&seg->lock);
-                }
-            }
+void segment_register(struct region* region, struct segment* seg) noexcept {
+    pagemap_set(region, seg, seg);
+    region->live.fetch_add(seg->size, memory_order_relaxed);
+    region->overhead.fetch_add(seg->block - seg->size, memory_order_relaxed);
+}
 
-            //prepare the log
-            struct log* change = new (std::nothrow) struct log();
-            if (unlikely(change == NULL)){
-                rollback(tx);
-                return false;
-            }
-            change->old_data = malloc(sizeof(byte) * size);
-            if (unlikely(change->old_data == NULL)){
-                rollback(tx);
-                return false;
+/** [thread-safe] Remove a segment from the region, it must then be retired.
+ * @param region Region to update
+ * @param seg    Segment to remove
+**/
+void segment_unregister(struct region* region, struct segment* seg) noexcept {
+    pagemap_set(region, seg, pagemap_unregistered(seg));
+    region->live.fetch_sub(seg->size, memory_order_relaxed);
+    region->overhead.fetch_sub(seg->block - seg->size, memory_order_relaxed);
+}
+
+/** [thread-safe] Destroy an object once no running transaction can access it anymore.
+ * @param region  Region the object belongs to
+ * @param retired Reclamation entry of the object, with 'destroy' and 'object' set
+**/
+void epoch_retire(struct region* region, struct retired* retired) noexcept {
+    //transactions announced from now on cannot reach the object
+    retired->epoch = region->epoch.fetch_add(1, memory_order_seq_cst);
+    //counted first, so that a reclaimer never accounts for more objects than counted
+    region->pending.fetch_add(1, memory_order_relaxed);
+    retired->next = region->retired.load(memory_order_relaxed);
+    while (!region->retired.compare_exchange_weak(retired->next, retired, memory_order_release, memory_order_relaxed));
+}
+
+/** [thread-safe] Destroy an unregistered segment once no running transaction can access it anymore.
+ * @param region Region the segment belonged to
+ * @param seg    Segment to retire
+**/
+void segment_retire(struct region* region, struct segment* seg) noexcept {
+    seg->retired.destroy = [](void* object) { segment_destroy((struct segment*) object); };
+    seg->retired.object = seg;
+    epoch_retire(region, &seg->retired);
+}
+
+/** Destroy the retired objects that no announced transaction may still access.
+ * @param region Region to clean up
+ * @param force  Whether to reclaim even if fewer than a batch of objects are pending
+**/
+static void epoch_reclaim(struct region* region, bool force) noexcept {
+    //scanning the epoch table is only worth it for a whole batch
+    if (likely(region->pending.load(memory_order_relaxed) < (force ? 1 : EPOCH_BATCH))) {
+        return;
+    }
+    //take the whole list, concurrent reclaimers get disjoint lists
+    struct retired* retired = region->retired.exchange(NULL, memory_order_acquire);
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = 0; i < EPOCH_SLOTS; ++i){
+        uint64_t epoch = region->slots[i].epoch.load(memory_order_seq_cst);
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+    struct retired* kept = NULL;
+    struct retired* last = NULL;
+    size_t reclaimed = 0;
+    while (retired != NULL){
+        struct retired* next = retired->next;
+        if (retired->epoch < oldest) {
+            retired->destroy(retired->object);
+            ++reclaimed;
+        } else {
+            //still reachable, keep it for later
+            retired->next = kept;
+            kept = retired;
+            if (last == NULL) {
+                last = retired;
             }
-            memcpy(change->old_data, target, size);
-            change->size = size;
-            change->location = target;
-            change->next = trans->logs;
-
-            //remember the log
-            trans->logs = change;
-            //copy the memory
-            memcpy(target, source, size);
-            return true;
         }
+        retired = next;
     }
-    //if the address is not in the given region, abort the transaction
-    printf("Not found for write\n");
-    rollback(tx);
-    return false;
+    if (kept != NULL) {
+        //put the reachable ones back at once
+        last->next = region->retired.load(memory_order_relaxed);
+        while (!region->retired.compare_exchange_weak(last->next, kept, memory_order_release, memory_order_relaxed));
+    }
+    region->pending.fetch_sub(reclaimed, memory_order_relaxed);
 }
 
-/** [thread-safe] Memory allocation in the given transaction.
- * @param shared Shared memory region associated with the transaction
- * @param tx     Transaction to use
- * @param size   Allocation requested size (in bytes), must be a positive multiple of the alignment
- * @param target Pointer in private memory receiving the address of the first byte of the newly allocated, aligned segment
- * @return Whether the whole transaction can continue (success/nomem), or not (abort_alloc)
+#ifdef USE_RECLAIMER
+/** Service thread of a region, destroying the retired objects in place of the threads exiting transactions.
 **/
-Alloc tm_alloc(shared_t shared, tx_t tx as(unused), size_t size, void** target) noexcept {
-    struct region* region = (struct region*) shared;
+struct reclaimer {
+    pthread_t thread;
+    mutex lock;
+    condition_variable wake; // Signaled when a batch or a commit is pending, or to stop
+    atomic<bool> signaled;   // Whether 'wake' was signaled since the last reclamation, to signal once per batch
+    bool stop;               // Whether the region is being destroyed, under 'lock'
+    struct commit* commits;  // Commits left by 'tm_end_async' to complete, the latest first, under 'lock'
+};
 
-    struct segment* seg = new (std::nothrow) struct segment();
-    if (unlikely(seg == NULL)) {
-        return Alloc::nomem;
-    }
+/** Commit linearized by 'tm_end_async', completed by the service thread, then freed by whoever sees it done.
+**/
+struct commit {
+    tx_t tx;            // Transaction to complete with 'end_publish'
+    atomic<bool> done;  // Whether it was completed
+    struct commit* next;
+};
 
-    if (unlikely(posix_memalign((void**) &(seg->mem), region->align, size) != 0)){
-        delete seg;
-        return Alloc::nomem;
+/** Complete the commits left by 'tm_end_async', in the order they were left.
+ * @param region  Region of the commits
+ * @param commits Commits, the latest first
+**/
+static void commits_complete(struct region* region, struct commit* commits) noexcept {
+    struct commit* ordered = NULL;
+    while (commits != NULL){
+        struct commit* next = commits->next;
+        commits->next = ordered;
+        ordered = commits;
+        commits = next;
     }
-    memset(seg->mem, 0, size);
-    *target = (void *) seg->mem;
-    seg->size = size;
-    seg->freed = false;
-    seg->lock.lock();
-    ((struct transaction*) tx)->new_seg_locks.push_back(&seg->lock);
-    ((struct transaction*) tx)->new_segments.push_back(seg);
+    while (ordered != NULL){
+        //read before 'done', after which the handle may be freed
+        struct commit* next = ordered->next;
+        region->ops->end_publish(region, ordered->tx);
+        ordered->done.store(true, memory_order_release);
+        ordered = next;
+    }
+}
 
-    region->segments.push_back(seg);
-    return Alloc::success;
+/** Reclaim the retired objects of a region whenever a batch is pending, or periodically, until stopped.
+ * @param arg Region to serve
+ * @return NULL
+**/
+static void* reclaimer_run(void* arg) {
+    struct region* region = (struct region*) arg;
+    struct reclaimer* reclaimer = region->reclaimer;
+    unique_lock<mutex> guard(reclaimer->lock);
+    while (true){
+        reclaimer->wake.wait_for(guard, chrono::microseconds(TM_RECLAIMER_PERIOD), [reclaimer] { return reclaimer->stop || reclaimer->commits != NULL || reclaimer->signaled.load(memory_order_relaxed); });
+        reclaimer->signaled.store(false, memory_order_relaxed);
+        struct commit* commits = reclaimer->commits;
+        reclaimer->commits = NULL;
+        //the commits left before the region is destroyed still complete
+        bool stop = reclaimer->stop && commits == NULL;
+        guard.unlock();
+        commits_complete(region, commits);
+        //objects pending less than a batch are not left behind for long
+        epoch_reclaim(region, true);
+        //the blocks of the destroyed segments are for the allocating threads
+        slab_flush();
+        guard.lock();
+        if (stop){
+            break;
+        }
+    }
+    return NULL;
+}
+
+/** [thread-safe] Let the service thread of a region know that a batch of objects is pending.
+ * @param region Region with a service thread
+**/
+static inline void reclaimer_wake(struct region* region) noexcept {
+    struct reclaimer* reclaimer = region->reclaimer;
+    if (likely(region->pending.load(memory_order_relaxed) < EPOCH_BATCH) || reclaimer->signaled.exchange(true, memory_order_relaxed)){
+        return;
+    }
+    lock_guard<mutex> guard(reclaimer->lock);
+    reclaimer->wake.notify_one();
+}
+
+/** Start the service thread of a region, the threads exiting transactions reclaim in its place if it cannot start.
+ * @param region Region to serve
+**/
+static void reclaimer_start(struct region* region) noexcept {
+    region->reclaimer = new (std::nothrow) struct reclaimer();
+    if (unlikely(region->reclaimer == NULL)){
+        return;
+    }
+    region->reclaimer->signaled.store(false, memory_order_relaxed);
+    region->reclaimer->stop = false;
+    region->reclaimer->commits = NULL;
+    if (unlikely(pthread_create(&region->reclaimer->thread, NULL, reclaimer_run, region) != 0)){
+        delete region->reclaimer;
+        region->reclaimer = NULL;
+    }
+}
+
+/** Stop and join the service thread of a region, with no running transaction.
+ * @param region Region served
+**/
+static void reclaimer_stop(struct region* region) noexcept {
+    struct reclaimer* reclaimer = region->reclaimer;
+    if (reclaimer == NULL){
+        return;
+    }
+    {
+        lock_guard<mutex> guard(reclaimer->lock);
+        reclaimer->stop = true;
+        reclaimer->wake.notify_one();
+    }
+    pthread_join(reclaimer->thread, NULL);
+    delete reclaimer;
+    region->reclaimer = NULL;
+}
+#endif
+
+// Epoch slot the calling thread tries first, its dense index once it called 'tm_thread_enter' (SIZE_MAX until known)
+static thread_local size_t thread_hint = SIZE_MAX;
+// Dense index the calling thread took with 'tm_thread_enter', SIZE_MAX if none
+static thread_local size_t thread_member = SIZE_MAX;
+
+/** [thread-safe] Get the index of the calling thread in the per-thread tables of the regions, less than EPOCH_SLOTS.
+ * Dense and unique among the threads that called 'tm_thread_enter', handed out round-robin to the others.
+ * @return Index of the thread
+**/
+size_t thread_index() noexcept {
+    static atomic<size_t> threads{0};
+    if (unlikely(thread_hint == SIZE_MAX)) {
+        thread_hint = threads.fetch_add(1, memory_order_relaxed) % EPOCH_SLOTS;
+    }
+    return thread_hint;
+}
+
+/** [thread-safe] Announce a transaction, objects retired from now on stay valid until it exits.
+ * @param region Region the transaction runs on
+ * @return Slot to pass to 'epoch_exit'
+**/
+size_t epoch_enter(struct region* region) noexcept {
+    size_t hint = thread_index();
+    for (size_t i = hint;; ++i){
+        struct epoch_slot& slot = region->slots[i % EPOCH_SLOTS];
+        uint64_t expected = 0;
+        //the epoch is never 0, so a used slot never looks free
+        if (slot.epoch.load(memory_order_relaxed) == 0 && slot.epoch.compare_exchange_strong(expected, region->epoch.load(memory_order_seq_cst), memory_order_seq_cst)) {
+            //announced before checking, so that an irrevocable transaction either waits for this one or is seen
+            if (unlikely(region->serial.load(memory_order_seq_cst))) {
+                slot.epoch.store(0, memory_order_release);
+                while (region->serial.load(memory_order_acquire)) {
+                    sched_yield();
+                }
+                continue;
+            }
+            //a thread with a dense index keeps it, the others stick to the slot they found free
+            if (thread_member == SIZE_MAX) {
+                thread_hint = i % EPOCH_SLOTS;
+            }
+            WATCHDOG_ENTER(region, i % EPOCH_SLOTS);
+            return i % EPOCH_SLOTS;
+        }
+        if (unlikely(i % EPOCH_SLOTS == (hint + EPOCH_SLOTS - 1) % EPOCH_SLOTS)) {
+            //every slot is taken
+            sched_yield();
+        }
+    }
+}
+
+/** [thread-safe] Withdraw the announcement of a transaction.
+ * @param region Region the transaction ran on
+ * @param slot   Slot returned by 'epoch_enter'
+**/
+void epoch_exit(struct region* region, size_t slot) noexcept {
+    //only the holder of the slot writes its count
+    WATCHDOG_EXIT(region, slot);
+    counter_add(region->slots[slot].exits, 1);
+    region->slots[slot].epoch.store(0, memory_order_release);
+#ifdef USE_RECLAIMER
+    if (likely(region->reclaimer != NULL)){
+        reclaimer_wake(region);
+        return;
+    }
+#endif
+    epoch_reclaim(region, false);
+}
+
+/** [thread-safe] Wait for every transaction of the region to end, new ones wait in 'epoch_enter' until 'region_resume'.
+ * The caller must not hold an epoch slot.
+ * @param region Region to quiesce
+ * @param wait   Whether to wait for another thread quiescing the region, otherwise give up
+ * @return Whether the caller quiesced the region
+**/
+bool region_quiesce(struct region* region, bool wait) noexcept {
+    bool expected = false;
+    while (!region->serial.compare_exchange_weak(expected, true, memory_order_seq_cst)) {
+        if (!wait && expected) {
+            return false;
+        }
+        expected = false;
+        sched_yield();
+    }
+    //every transaction holds an epoch slot, new ones back off
+    for (auto& slot : region->slots) {
+        while (slot.epoch.load(memory_order_seq_cst) != 0) {
+            sched_yield();
+        }
+    }
+    return true;
+}
+
+/** [thread-safe] Let the transactions of a region quiesced by the caller run again.
+ * @param region Region to resume
+**/
+void region_resume(struct region* region) noexcept {
+    region->serial.store(false, memory_order_release);
+}
+
+/** [thread-safe] Find the segment containing the given address, in constant time.
+ * @param region Region to search
+ * @param addr   Address to look for
+ * @return Segment containing the address, NULL if none
+**/
+struct segment* segment_find(struct region* region, void const* addr) noexcept {
+    PROFILE(PROFILE_LOOKUP);
+    pagemap_leaf* entry = pagemap_entry(region, region->replicas > 1 ? numa_node() : 0, ((uintptr_t) addr) >> SEGMENT_PAGE_LOG2, false);
+    if (unlikely(entry == NULL)) {
+        return NULL;
+    }
+    struct segment* seg = entry->load(memory_order_acquire);
+#ifdef USE_PACKS
+    if ((uintptr_t) seg & PAGEMAP_PACKED) {
+        return pack_find((struct segment_pack*) ((uintptr_t) seg & ~(uintptr_t) PAGEMAP_PACKED), addr);
+    }
+#endif
+    //the first page also holds the header
+    if (unlikely(seg == NULL || ((uintptr_t) seg & PAGEMAP_UNREGISTERED) || addr < seg->mem || addr >= seg->mem + seg->size)) {
+        return NULL;
+    }
+    return seg;
+}
+
+#ifdef USE_NUMA_SHARDS
+/** [thread-safe] Find the node the segment containing the given address was placed on, registered or not, until it is destroyed.
+ * @param region Region to search
+ * @param addr   Address to look for
+ * @return Node of the segment, -1 if it is spread over every node or if there is none
+**/
+int segment_node(struct region* region, void const* addr) noexcept {
+    //every replica holds the same entries, the first one saves looking up the node of the thread
+    pagemap_leaf* entry = pagemap_entry(region, 0, ((uintptr_t) addr) >> SEGMENT_PAGE_LOG2, false);
+    if (unlikely(entry == NULL)) {
+        return -1;
+    }
+    uintptr_t seg = (uintptr_t) entry->load(memory_order_acquire);
+#ifdef USE_PACKS
+    if (seg & PAGEMAP_PACKED) {
+        //packs are spread over every node
+        return -1;
+    }
+#endif
+    seg &= ~(uintptr_t) PAGEMAP_UNREGISTERED;
+    return seg == 0 ? -1 : ((struct segment*) seg)->node;
+}
+#endif
+
+/** Call a function on every live segment of a region, with no concurrent registration.
+ * @param region Region to walk
+ * @param func   Function taking a segment, which may destroy it
+**/
+template<class Func> static void segments_for_each(struct region* region, Func&& func) noexcept {
+    //every live segment is found on the page holding its header
+    for (size_t i = 0; i < (1ul << PAGEMAP_ROOT_LOG2); ++i){
+        pagemap_leaf* leaf = region->pagemap[0][i].load(memory_order_relaxed);
+        if (leaf == NULL) {
+            continue;
+        }
+        for (size_t j = 0; j < (1ul << PAGEMAP_LEAF_LOG2); ++j){
+            struct segment* seg = leaf[j].load(memory_order_relaxed);
+#ifdef USE_PACKS
+            if ((uintptr_t) seg & PAGEMAP_PACKED) {
+                //the registered slots of a pack, from its first page
+                struct segment_pack* pack = (struct segment_pack*) ((uintptr_t) seg & ~(uintptr_t) PAGEMAP_PACKED);
+                if (((uintptr_t) pack) >> SEGMENT_PAGE_LOG2 == ((i << PAGEMAP_LEAF_LOG2) | j)) {
+                    for (size_t slot = 0; slot < pack->capacity; ++slot){
+                        if (pack->listed[slot / 64].load(memory_order_relaxed) & (1ul << (slot % 64))) {
+                            func(pack->headers + slot);
+                        }
+                    }
+                }
+                continue;
+            }
+#endif
+            if (seg != NULL && !((uintptr_t) seg & PAGEMAP_UNREGISTERED) && ((uintptr_t) seg) >> SEGMENT_PAGE_LOG2 == ((i << PAGEMAP_LEAF_LOG2) | j)) {
+                func(seg);
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------------------------- //
+
+/** Create a new shared memory region, volatile, durable or shared between processes.
+ * @param size    Size of the first shared segment of memory (in bytes), must be a positive multiple of the alignment
+ * @param align   Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @param path    File holding the first segment, NULL unless durable
+ * @param name    Shared memory object holding the first segment, NULL unless shared between processes
+ * @param options Knobs of the region, NULL for the defaults
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure (e.g. unknown engine or backing in the options)
+**/
+static shared_t region_create(size_t size, size_t align, char const* path, char const* name, struct tm_options const* options) noexcept {
+    static struct tm_options const defaults = {};
+    if (options == NULL) {
+        options = &defaults;
+    }
+    int hugepages = options->hugepages == NULL ? hugepages_mode() : hugepages_parse(options->hugepages);
+    if (unlikely(hugepages < 0)) {
+        return invalid_shared;
+    }
+    struct region* region = new (std::nothrow) struct region();
+    if (unlikely(region == NULL)) {
+        return invalid_shared;
+    }
+    region->hugepages = hugepages;
+    region->stripes = options->stripes;
+    if (region->stripes == 0) {
+        char const* env = getenv("TM_STRIPES");
+        region->stripes = env != NULL ? strtoul(env, NULL, 0) : 0;
+    }
+    region->versions = options->versions > 0 ? options->versions : TM_VERSIONS_DEPTH;
+    char const* stream = getenv("TM_STREAM");
+    region->stream = stream != NULL ? strtoul(stream, NULL, 0) : TM_STREAM_BYTES;
+    region->start = NULL;
+    region->align = align;
+    region->size = size;
+    region->epoch.store(1, memory_order_relaxed);
+    region->retired.store(NULL, memory_order_relaxed);
+    region->pending.store(0, memory_order_relaxed);
+    region->serial.store(false, memory_order_relaxed);
+    region->live.store(0, memory_order_relaxed);
+    region->overhead.store(0, memory_order_relaxed);
+    region->tracking.store(false, memory_order_relaxed);
+    for (auto& members : region->members){
+        members.store(0, memory_order_relaxed);
+    }
+    region->adaptive = NULL;
+    region->persist = NULL;
+    region->shm = NULL;
+    region->ship = NULL;
+    for (auto& counters : region->counters){
+        counters.commits.store(0, memory_order_relaxed);
+        for (auto& aborts : counters.aborts){
+            aborts.store(0, memory_order_relaxed);
+        }
+        counters.reads.store(0, memory_order_relaxed);
+        counters.writes.store(0, memory_order_relaxed);
+        counters.allocs.store(0, memory_order_relaxed);
+        counters.frees.store(0, memory_order_relaxed);
+        counters.extensions.store(0, memory_order_relaxed);
+        counters.irrevocable.store(0, memory_order_relaxed);
+        counters.descriptor.store(0, memory_order_relaxed);
+    }
+    cm_init(&region->cm);
+    region->numa.local.store(0, memory_order_relaxed);
+    region->numa.remote.store(0, memory_order_relaxed);
+    region->numa.interleaved.store(0, memory_order_relaxed);
+    region->placed = options->numa != TM_OPTION_OFF;
+    region->replicas = region->placed ? numa_nodes() : 1;
+    for (size_t r = 0; r < region->replicas; ++r){
+        region->pagemap[r] = (std::atomic<pagemap_leaf*>*) calloc(1ul << PAGEMAP_ROOT_LOG2, sizeof(std::atomic<pagemap_leaf*>));
+        if (unlikely(region->pagemap[r] == NULL)) {
+            pagemap_destroy(region);
+            delete region;
+            return invalid_shared;
+        }
+        region->overhead.fetch_add((1ul << PAGEMAP_ROOT_LOG2) * sizeof(std::atomic<pagemap_leaf*>), memory_order_relaxed);
+    }
+
+    struct segment* seg = path != NULL ? persist_open(region, path, size) : name != NULL ? shm_attach(region, name, size) : segment_create(region, size);
+    if (unlikely(seg == NULL)) {
+        pagemap_destroy(region);
+        delete region;
+        return invalid_shared;
+    }
+    region->start = seg->mem;
+    segment_register(region, seg);
+    if (options->ship != NULL && unlikely(!ship_open(region, options->ship))) {
+        segment_destroy(seg);
+        if (region->persist != NULL) {
+            persist_close(region);
+        }
+        if (region->shm != NULL) {
+            shm_detach(region);
+        }
+        pagemap_destroy(region);
+        delete region;
+        return invalid_shared;
+    }
+
+    //every process must run the same engine, whose state lives in the object
+    region->ops = region->shm != NULL ? &engines[0] : engine_select(options->engine);
+#ifdef TM_STATIC_ENGINE
+    if (region->ops != NULL && strcmp(region->ops->name, TM_ENGINE) != 0) {
+        //shared regions run tl2, which the build left out
+        region->ops = NULL;
+    }
+#endif
+    if (unlikely(region->ops == NULL || !region->ops->create(region))) {
+        if (region->ship != NULL) {
+            ship_close(region);
+        }
+        segment_destroy(seg);
+        if (region->persist != NULL) {
+            persist_close(region);
+        }
+        if (region->shm != NULL) {
+            shm_detach(region);
+        }
+        pagemap_destroy(region);
+        delete region;
+        return invalid_shared;
+    }
+#ifdef USE_RECLAIMER
+    region->reclaimer = NULL;
+    if (options->reclaimer != TM_OPTION_OFF) {
+        reclaimer_start(region);
+    }
+#endif
+#ifdef USE_HEATMAP
+    region->heatmap = heatmap_create();
+#endif
+#ifdef USE_WATCHDOG
+    watchdog_start(region);
+#endif
+#ifdef USE_PACKS
+    region->packs = new (std::nothrow) struct segment_packs();
+#endif
+#ifdef USE_METRICS
+    metrics_attach(region);
+#endif
+    return region;
+}
+
+/** Create (i.e. allocate + init) a new shared memory region, with one first non-free-able allocated segment of the requested size and alignment.
+ * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_create(size_t size, size_t align) noexcept{
+    return region_create(size, align, NULL, NULL, NULL);
+}
+
+/** Create or reopen a durable shared memory region, whose first segment lives in a file.
+ * Every commit is durable once 'tm_end' returns, and reopening the file after a crash recovers them all.
+ * Segments allocated by transactions are not durable, and the region has no serial irrevocable mode.
+ * @param path  File holding the region, created if it does not exist
+ * @param size  Size of the first shared segment of memory (in bytes), must be a positive multiple of the alignment and match the file if it exists
+ * @param align Alignment (in bytes, must be a power of 2 at most the page size) that the shared memory region must support, must match the file if it exists
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_create_persistent(char const* path, size_t size, size_t align) noexcept {
+    return region_create(size, align, path, NULL, NULL);
+}
+
+/** Create a region shared between processes, or attach to it if another process created it.
+ * Its first segment lives in a POSIX shared memory object, as do the clock and the lock table of the 'tl2' engine, which such regions always run.
+ * Segments allocated by transactions would be private to the process: 'tm_alloc' fails with 'nomem'. The region has no serial irrevocable mode.
+ * The object stays once every process destroyed its region, remove it with 'shm_unlink'.
+ * @param name  Name of the object, as for 'shm_open'
+ * @param size  Size of the first shared segment of memory (in bytes), must be a positive multiple of the alignment and match the object if it exists
+ * @param align Alignment (in bytes, must be a power of 2 at most the page size) that the shared memory region must support, must match the object if it exists
+ * @return Opaque shared memory region handle, private to the process, 'invalid_shared' on failure
+**/
+shared_t tm_create_shared(char const* name, size_t size, size_t align) noexcept {
+    return region_create(size, align, NULL, name, NULL);
+}
+
+/** Create a new shared memory region with the given knobs, e.g. to pick the engine per region without rebuilding the library.
+ * @param size    Size of the first shared segment of memory (in bytes), must be a positive multiple of the alignment
+ * @param align   Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @param options Knobs of the region, NULL (or zeroed) to create it as 'tm_create' does; a durable region with a 'path' as 'tm_create_persistent' does
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure (e.g. unknown engine or backing)
+**/
+shared_t tm_create_ex(size_t size, size_t align, struct tm_options const* options) noexcept {
+    return region_create(size, align, options != NULL ? options->path : NULL, NULL, options);
+}
+/** Destroy (i.e. clean-up + free) a given shared memory region.
+ * @param shared Shared memory region to destroy, with no running transaction
+**/
+void tm_destroy(shared_t shared ) noexcept {
+    struct region* region = (struct region*) shared;
+#ifdef USE_METRICS
+    metrics_detach(region);
+#endif
+#ifdef USE_WATCHDOG
+    watchdog_stop(region);
+#endif
+#ifdef USE_RECLAIMER
+    //the objects it did not reclaim yet are reclaimed below
+    reclaimer_stop(region);
+#endif
+    region->ops->destroy(region);
+    cm_report(&region->cm);
+#ifdef USE_NUMA_STATS
+    uint64_t local = region->numa.local.load(memory_order_relaxed);
+    uint64_t remote = region->numa.remote.load(memory_order_relaxed);
+    uint64_t interleaved = region->numa.interleaved.load(memory_order_relaxed);
+    uint64_t total = local + remote + interleaved;
+    fprintf(stderr, "numa: %zu nodes, %lu local, %lu remote, %lu interleaved accesses (%.2f%% local, %.2f%% remote)\n", region->replicas, local, remote, interleaved, total > 0 ? 100. * local / total : 0., total > 0 ? 100. * remote / total : 0.);
+#endif
+#ifdef USE_PROFILE
+    profile_report();
+#endif
+#ifdef USE_TRACE
+    char const* trace_path = getenv("TM_TRACE");
+    if (trace_path != NULL){
+        trace_dump(trace_path);
+    }
+#endif
+#ifdef USE_OPACITY_LOG
+    char const* opacity_path = getenv("TM_OPACITY");
+    if (opacity_path != NULL){
+        opacity_dump(opacity_path);
+    }
+#endif
+#ifdef USE_HEATMAP
+    heatmap_report(region);
+    heatmap_destroy(region->heatmap);
+#endif
+    if (region->ship != NULL) {
+        ship_close(region);
+    }
+    segments_for_each(region, [](struct segment* seg) { segment_destroy(seg); });
+    epoch_reclaim(region, true);
+#ifdef USE_PACKS
+    packs_destroy(region);
+#endif
+    if (region->persist != NULL) {
+        persist_close(region);
+    }
+    if (region->shm != NULL) {
+        shm_detach(region);
+    }
+    pagemap_destroy(region);
+    delete region;
+}
+
+/** [thread-safe] Return the start address of the first allocated segment in the shared memory region.
+ * @param shared Shared memory region to query
+ * @return Start address of the first allocated segment
+**/
+void* tm_start(shared_t shared) noexcept {
+    return ((struct region*) shared)->start;
+}
+
+/** [thread-safe] Return the size (in bytes) of the first allocated segment of the shared memory region.
+ * @param shared Shared memory region to query
+ * @return First allocated segment size
+**/
+size_t tm_size(shared_t shared) noexcept {
+    return ((struct region*) shared)->size;
+}
+
+/** [thread-safe] Return the alignment (in bytes) of the memory accesses on the given shared memory region.
+ * @param shared Shared memory region to query
+ * @return Alignment used globally
+**/
+size_t tm_align(shared_t shared) noexcept {
+    return ((struct region*) shared)->align;
+}
+
+// -------------------------------------------------------------------------- //
+
+/** [thread-safe] Mark the ranges a transaction writes as dirty, once a checkpoint started the tracking.
+ * Marked when written rather than at commit: no transaction runs across a checkpoint, and an abort only makes the next delta larger.
+ * @param region Region written
+ * @param target Start address of the write (in the shared region)
+ * @param size   Length of the write (in bytes)
+**/
+static inline void dirty_mark(struct region* region, void const* target, size_t size) noexcept {
+    if (likely(!region->tracking.load(memory_order_relaxed))) {
+        return;
+    }
+    struct segment* seg = segment_find(region, target);
+    //the engine aborts the transaction
+    if (unlikely(seg == NULL)) {
+        return;
+    }
+    size_t first = ((std::byte const*) target - seg->mem) >> TM_DIRTY_LOG2;
+    size_t last = ((std::byte const*) target + size - 1 - seg->mem) >> TM_DIRTY_LOG2;
+    for (size_t i = first; i <= last; ++i){
+        std::atomic<uint64_t>& word = seg->dirty[i / 64];
+        uint64_t bit = UINT64_C(1) << (i % 64);
+        //most writes hit a range already dirty, only read its line then
+        if ((word.load(memory_order_relaxed) & bit) == 0) {
+            word.fetch_or(bit, memory_order_relaxed);
+        }
+    }
+}
+
+/** Tell whether a region can run the serial irrevocable transaction.
+ * Its writes would skip the redo log of a durable or shipped region, and quiescing only stops the transactions of this process.
+ * @param region Region to check
+ * @return Whether the region is volatile, not shipped and private to the process
+**/
+static inline bool irrevocable_allowed(struct region* region) noexcept {
+    return region->persist == NULL && region->shm == NULL && region->ship == NULL;
+}
+
+/** [thread-safe] Begin the serial irrevocable transaction, once every other transaction ended.
+ * It accesses the memory directly and cannot abort, new transactions wait for it to end.
+ * @param region Region to run the transaction on
+ * @return 'IRREVOCABLE_TX'
+**/
+static tx_t irrevocable_begin(struct region* region) noexcept {
+    //before quiescing, the retries holding the tokens it may wait for must be able to end
+    cm_begin(&region->cm);
+    region_quiesce(region, true);
+    return IRREVOCABLE_TX;
+}
+
+/** End the serial irrevocable transaction, letting the other transactions run again.
+ * @param region Region the transaction ran on
+**/
+static void irrevocable_end(struct region* region) noexcept {
+    cm_commit(&region->cm);
+    counter_add(region->counters[IRREVOCABLE_SLOT].commits, 1);
+    counter_add(region->counters[IRREVOCABLE_SLOT].irrevocable, 1);
+    region_resume(region);
+}
+
+/** Allocate a segment in the serial irrevocable transaction, visible right away.
+ * @param region Region to allocate in
+ * @param size   Size of the segment (in bytes)
+ * @param target Receives the address of the segment
+ * @return Whether the segment was allocated (success/nomem)
+**/
+static Alloc irrevocable_alloc(struct region* region, size_t size, void** target) noexcept {
+    struct segment* seg = segment_create(region, size);
+    if (unlikely(seg == NULL)) {
+        return Alloc::nomem;
+    }
+    segment_register(region, seg);
+    counter_add(region->counters[IRREVOCABLE_SLOT].allocs, 1);
+    *target = seg->mem;
+    return Alloc::success;
+}
+
+/** Free a segment in the serial irrevocable transaction.
+ * @param region Region to free in
+ * @param target Start of the segment
+**/
+static void irrevocable_free(struct region* region, void* target) noexcept {
+    struct segment* seg = segment_find(region, target);
+    //the transaction cannot abort, freeing anything else than a segment does nothing
+    if (unlikely(seg == NULL || seg->mem != target)) {
+        return;
+    }
+    segment_unregister(region, seg);
+    segment_retire(region, seg);
+    counter_add(region->counters[IRREVOCABLE_SLOT].frees, 1);
+}
+
+/** [thread-safe] Begin a new transaction on the given shared memory region.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin(shared_t shared, bool is_ro) noexcept {
+    PROFILE(PROFILE_BEGIN);
+    METRICS_BEGIN();
+    //the previous attempts will not get any luckier
+    if (((TM_IRREVOCABLE_RETRIES > 0 && unlikely(cm_retries() >= TM_IRREVOCABLE_RETRIES)) || unlikely(WATCHDOG_ESCALATED((struct region*) shared))) && irrevocable_allowed((struct region*) shared)) {
+        return tm_begin_irrevocable(shared);
+    }
+#ifdef USE_ADMISSION
+    if (!is_ro) {
+        cm_admit(&((struct region*) shared)->cm);
+    }
+#endif
+    tx_t tx = ENGINE_CALL(shared, begin)(shared, is_ro);
+#ifdef USE_ADMISSION
+    if (unlikely(tx == invalid_tx)) {
+        cm_dismiss(&((struct region*) shared)->cm);
+    }
+#endif
+    TRACE(TRACE_BEGIN, tx, NULL, is_ro);
+    return tx;
+}
+
+/** [thread-safe] Begin a new transaction that may write, under snapshot isolation: it reads a snapshot of the region and only
+ * aborts at commit if another transaction committed to a word it writes meanwhile, so that write skew is possible.
+ * Engines that do not offer it run a serializable transaction instead, which is also a valid snapshot-isolated one.
+ * @param shared Shared memory region to start a transaction on
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin_snapshot(shared_t shared) noexcept {
+    struct region* region = (struct region*) shared;
+    if (region->ops->begin_snapshot == nullptr) {
+        return tm_begin(shared, false);
+    }
+    METRICS_BEGIN();
+    //the previous attempts will not get any luckier
+    if (((TM_IRREVOCABLE_RETRIES > 0 && unlikely(cm_retries() >= TM_IRREVOCABLE_RETRIES)) || unlikely(WATCHDOG_ESCALATED(region))) && irrevocable_allowed(region)) {
+        return tm_begin_irrevocable(shared);
+    }
+#ifdef USE_ADMISSION
+    cm_admit(&region->cm);
+#endif
+    tx_t tx = region->ops->begin_snapshot(shared);
+#ifdef USE_ADMISSION
+    if (unlikely(tx == invalid_tx)) {
+        cm_dismiss(&region->cm);
+    }
+#endif
+    TRACE(TRACE_BEGIN, tx, NULL, false);
+    return tx;
+}
+
+/** [thread-safe] Begin a read-only transaction on the calling thread that reads the snapshot of another, still running.
+ * Several threads can so split one read-only scan, e.g. a range of segments each, and combine what they read: the scan is
+ * consistent if every one of these transactions and the one they joined commit. Each must end before the joined one does.
+ * @param shared Shared memory region the joined transaction runs on
+ * @param tx     Read-only transaction to join, from any thread
+ * @return Opaque transaction ID, 'invalid_tx' if the engine (or this kind of transaction) cannot share its snapshot
+**/
+tx_t tm_begin_join(shared_t shared, tx_t tx) noexcept {
+    struct region* region = (struct region*) shared;
+    if (unlikely(tx == IRREVOCABLE_TX) || region->ops->begin_join == nullptr) {
+        return invalid_tx;
+    }
+    METRICS_BEGIN();
+    tx_t joined = region->ops->begin_join(shared, tx);
+    TRACE(TRACE_BEGIN, joined, NULL, true);
+    return joined;
+}
+
+/** Apply the commits shipped by another region ('tm_options::ship') to a replica, until the stream ends.
+ * The replica must start with the content the shipped region had when it was created, e.g. both freshly created, and
+ * the same size and alignment. Each commit is applied as one transaction, so that the read-only transactions of the
+ * replica, from any thread meanwhile, read a state the shipped region went through.
+ * @param shared Replica, written by nothing else
+ * @param fd     Descriptor of the file or pipe the stream is read from
+ * @return Whether the stream ended with every commit applied, false if commits were lost or the stream is invalid
+**/
+bool tm_apply(shared_t shared, int fd) noexcept {
+    return ship_apply((struct region*) shared, fd);
+}
+
+/** [thread-safe] End the given transaction.
+ * Every engine writes the segments a transaction allocated in place, so a transaction that wrote nothing else (e.g. one
+ * initializing new segments before publishing them) commits without taking any lock nor moving the clock of the region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to end
+ * @return Whether the whole transaction committed
+**/
+bool tm_end(shared_t shared, tx_t tx) noexcept {
+    PROFILE(PROFILE_END);
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        irrevocable_end((struct region*) shared);
+        TRACE(TRACE_COMMIT, tx, NULL, 0);
+        METRICS_COMMIT();
+        return true;
+    }
+    bool committed = ENGINE_CALL(shared, end)(shared, tx);
+    NUMA_FLUSH((struct region*) shared);
+    if (unlikely(((struct region*) shared)->persist != NULL)) {
+        persist_checkpoint((struct region*) shared);
+    }
+    if (committed){
+        TRACE(TRACE_COMMIT, tx, NULL, 0);
+        METRICS_COMMIT();
+    } else {
+        TRACE(TRACE_ABORT, tx, NULL, trace_reason);
+    }
+    return committed;
+}
+
+/** [thread-safe] End the given transaction, then wait for every transaction that was running when it committed to end.
+ * For a transaction privatizing memory, e.g. unlinking a node the caller then accesses directly: transactions that could still
+ * see the node (optimistic readers, or writers still writing back) all started before the commit, and only them are waited for.
+ * The wait is bounded by their length, later transactions never extending it, and other committers never wait. Memory freed by
+ * 'tm_free' needs none of this, it is only reclaimed once the transactions that could access it exited.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to end
+ * @return Whether the whole transaction committed, and so whether the caller waited
+**/
+bool tm_end_private(shared_t shared, tx_t tx) noexcept {
+    if (!tm_end(shared, tx)) {
+        return false;
+    }
+    struct region* region = (struct region*) shared;
+    //snapshot of the announced transactions, the count read first so that one exiting in between is not mistaken for a later one
+    uint64_t exits[EPOCH_SLOTS];
+    bool waits[EPOCH_SLOTS];
+    for (size_t i = 0; i < EPOCH_SLOTS; ++i) {
+        exits[i] = region->slots[i].exits.load(memory_order_acquire);
+        waits[i] = region->slots[i].epoch.load(memory_order_seq_cst) != 0;
+    }
+    for (size_t i = 0; i < EPOCH_SLOTS; ++i) {
+        for (size_t attempt = 0; waits[i] && region->slots[i].exits.load(memory_order_acquire) == exits[i]; ++attempt) {
+            if (attempt < TM_LOCK_SPINS) {
+                cm_pause(1);
+            } else {
+                sched_yield();
+            }
+        }
+    }
+    return true;
+}
+
+/** [thread-safe] End the given transaction, returning once its commit is linearized: the write-back and the release of its locks
+ * are left to the service thread of the region (only with USE_RECLAIMER and an engine that splits its commits, 'tl2'), to poll
+ * or wait for. Other transactions keep conflicting with its writes until then, so that it is as if it had fully committed.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to end
+ * @return 'aborted_commit' if the transaction aborted, 'done_commit' if it fully committed, otherwise a handle for 'tm_commit_poll' or 'tm_commit_wait'
+**/
+tm_commit_t tm_end_async(shared_t shared, tx_t tx) noexcept {
+#ifdef USE_RECLAIMER
+    struct region* region = (struct region*) shared;
+    if (region->ops->end_linearize != nullptr && region->reclaimer != NULL && region->persist == NULL && likely(tx != IRREVOCABLE_TX)) {
+        struct commit* commit = new (std::nothrow) struct commit();
+        if (likely(commit != NULL)) {
+            bool pending;
+            bool committed = region->ops->end_linearize(shared, tx, &pending);
+            NUMA_FLUSH(region);
+            if (!committed){
+                TRACE(TRACE_ABORT, tx, NULL, trace_reason);
+                delete commit;
+                return aborted_commit;
+            }
+            TRACE(TRACE_COMMIT, tx, NULL, 0);
+            METRICS_COMMIT();
+            if (!pending){
+                delete commit;
+                return done_commit;
+            }
+            commit->tx = tx;
+            commit->done.store(false, memory_order_relaxed);
+            struct reclaimer* reclaimer = region->reclaimer;
+            lock_guard<mutex> guard(reclaimer->lock);
+            commit->next = reclaimer->commits;
+            reclaimer->commits = commit;
+            reclaimer->wake.notify_one();
+            return (tm_commit_t) commit;
+        }
+    }
+#endif
+    return tm_end(shared, tx) ? done_commit : aborted_commit;
+}
+
+/** [thread-safe] Check whether a commit left by 'tm_end_async' completed, the handle being invalid once it did.
+ * @param shared Shared memory region associated with the transaction
+ * @param commit Handle from 'tm_end_async'
+ * @return Whether the commit completed (or aborted)
+**/
+bool tm_commit_poll(shared_t shared as(unused), tm_commit_t commit) noexcept {
+    if (commit == done_commit || commit == aborted_commit) {
+        return true;
+    }
+#ifdef USE_RECLAIMER
+    if (!((struct commit*) commit)->done.load(memory_order_acquire)) {
+        return false;
+    }
+    delete (struct commit*) commit;
+#endif
+    return true;
+}
+
+/** [thread-safe] Wait for a commit left by 'tm_end_async' to complete, the handle being invalid after.
+ * @param shared Shared memory region associated with the transaction
+ * @param commit Handle from 'tm_end_async'
+**/
+void tm_commit_wait(shared_t shared, tm_commit_t commit) noexcept {
+    while (!tm_commit_poll(shared, commit)) {
+        sched_yield();
+    }
+}
+
+/** [thread-safe] Read operation in the given transaction, source in the shared region and target in a private region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in a private region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    PROFILE(PROFILE_READ);
+    TRACE(TRACE_READ, tx, source, size);
+    NUMA_COUNT((struct region*) shared, source);
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        counter_add(((struct region*) shared)->counters[IRREVOCABLE_SLOT].reads, 1);
+        words_copy(target, source, size, ((struct region*) shared)->align);
+        return true;
+    }
+    if (unlikely(!ENGINE_CALL(shared, read)(shared, tx, source, size, target))){
+        TRACE(TRACE_ABORT, tx, source, trace_reason);
+        NUMA_FLUSH((struct region*) shared);
+        return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Write operation in the given transaction, source in a private region and target in the shared region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in a private region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in the shared region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    PROFILE(PROFILE_WRITE);
+    TRACE(TRACE_WRITE, tx, target, size);
+    NUMA_COUNT((struct region*) shared, target);
+    dirty_mark((struct region*) shared, target, size);
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        counter_add(((struct region*) shared)->counters[IRREVOCABLE_SLOT].writes, 1);
+        words_copy(target, source, size, ((struct region*) shared)->align);
+        return true;
+    }
+    if (unlikely(!ENGINE_CALL(shared, write)(shared, tx, source, size, target))){
+        TRACE(TRACE_ABORT, tx, target, trace_reason);
+        NUMA_FLUSH((struct region*) shared);
+        return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Write operation in the given transaction without a copy: get room for the new content, to fill in place.
+ * The room is the buffer the engine publishes at commit (or the range itself where the transaction writes in place): the
+ * caller must fill all of it before its next call on the transaction, after which the room may move.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Target start address (in the shared region)
+ * @param size   Length to write (in bytes), must be a positive multiple of the alignment
+ * @param buffer Receives the start of the room, NULL if the engine cannot lend one (e.g. the transaction wrote to the range already), to write with 'tm_write' instead
+ * @return Whether the whole transaction can continue
+**/
+bool tm_write_reserve(shared_t shared, tx_t tx, void* target, size_t size, void** buffer) noexcept {
+    struct region* region = (struct region*) shared;
+    PROFILE(PROFILE_WRITE);
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        counter_add(region->counters[IRREVOCABLE_SLOT].writes, 1);
+        *buffer = target;
+    } else if (region->ops->write_reserve == nullptr) {
+        *buffer = NULL;
+        return true;
+    } else if (unlikely(!region->ops->write_reserve(shared, tx, target, size, buffer))){
+        TRACE(TRACE_ABORT, tx, target, trace_reason);
+        NUMA_FLUSH(region);
+        return false;
+    }
+    //traced once lent, the fallback to 'tm_write' traces its own
+    if (*buffer != NULL) {
+        TRACE(TRACE_WRITE, tx, target, size);
+        NUMA_COUNT(region, target);
+        dirty_mark(region, target, size);
+    }
+    return true;
+}
+
+/** [thread-safe] Declare words the given transaction is about to access, best called right after 'tm_begin'.
+ * The engine may prefetch their metadata or lock them in a canonical order; the transaction must still read and write them.
+ * @param shared     Shared memory region associated with the transaction
+ * @param tx         Transaction to use
+ * @param addresses  Start addresses of the words (in the shared region), one word of the alignment each
+ * @param count      Number of addresses, a hint of more than TM_HINT_MAX is ignored
+ * @param write_mask Bit 'i' set if the word at 'addresses[i]' will be written
+ * @return Whether the whole transaction can continue
+**/
+bool tm_hint(shared_t shared, tx_t tx, void const* const* addresses, size_t count, uint64_t write_mask) noexcept {
+    struct region* region = (struct region*) shared;
+    if (unlikely(tx == IRREVOCABLE_TX) || region->ops->hint == nullptr || count == 0 || count > TM_HINT_MAX) {
+        //nothing can conflict, or nothing to gain
+        return true;
+    }
+    if (unlikely(!region->ops->hint(shared, tx, addresses, count, write_mask))){
+        TRACE(TRACE_ABORT, tx, addresses[0], trace_reason);
+        NUMA_FLUSH(region);
+        return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Mark the accesses the given transaction made so far, to roll back to with 'tm_rollback_to'.
+ * While the transaction holds a mark, an access that cannot continue leaves it alive: every further access fails until the
+ * transaction is rolled back to a mark, and 'tm_end' aborts it. Early releases are ignored while a mark is held.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to mark, that may write
+ * @param mark   Receives the mark, the marks of a transaction are numbered from 0 in the order they were taken
+ * @return Whether the mark was taken, false if the engine (or this kind of transaction) only rolls back wholly
+**/
+bool tm_savepoint(shared_t shared, tx_t tx, tm_savepoint_t* mark) noexcept {
+    struct region* region = (struct region*) shared;
+    if (unlikely(tx == IRREVOCABLE_TX) || region->ops->savepoint == nullptr) {
+        return false;
+    }
+    return region->ops->savepoint(shared, tx, mark);
+}
+
+/** [thread-safe] Undo the accesses the given transaction made since a mark, dropping the later marks, and revalidate the rest.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction holding the mark
+ * @param mark   Mark returned by 'tm_savepoint', still held
+ * @return Whether the transaction can continue from the mark, otherwise it aborted as a whole
+**/
+bool tm_rollback_to(shared_t shared, tx_t tx, tm_savepoint_t mark) noexcept {
+    struct region* region = (struct region*) shared;
+    if (unlikely(tx == IRREVOCABLE_TX) || region->ops->rollback_to == nullptr) {
+        //no mark was ever taken
+        return false;
+    }
+    if (unlikely(!region->ops->rollback_to(shared, tx, mark))){
+        TRACE(TRACE_ABORT, tx, NULL, trace_reason);
+        NUMA_FLUSH(region);
+        return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Whether the transaction may access the shared memory with plain loads and stores until it ends (see 'tm_inline.hpp').
+ * Only an irrevocable transaction may, when no access has to be traced, counted per node or marked dirty for a checkpoint;
+ * its direct accesses are then not counted in 'tm_stats'.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to query
+ * @return Whether the transaction may skip 'tm_read' and 'tm_write'
+**/
+bool tm_direct(shared_t shared, tx_t tx) noexcept {
+#if defined(USE_TRACE) || defined(USE_NUMA)
+    (void) shared;
+    (void) tx;
+    return false;
+#else
+    struct region* region = (struct region*) shared;
+    return tx == IRREVOCABLE_TX && region->persist == NULL && !region->tracking.load(memory_order_relaxed);
+#endif
+}
+
+/** [thread-safe] Read of one 8-byte word in the given transaction, as 'tm_read' with a constant size.
+ * @param shared Shared memory region associated with the transaction, of an alignment of 8 bytes
+ * @param tx     Transaction to use
+ * @param source Word to read (in the shared region)
+ * @param target Word receiving the value (in a private region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_read_word(shared_t shared, tx_t tx, void const* source, void* target) noexcept {
+    TRACE(TRACE_READ, tx, source, sizeof(uint64_t));
+    NUMA_COUNT((struct region*) shared, source);
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        counter_add(((struct region*) shared)->counters[IRREVOCABLE_SLOT].reads, 1);
+        memcpy(target, source, sizeof(uint64_t));
+        return true;
+    }
+    if (unlikely(!ENGINE_CALL(shared, read)(shared, tx, source, sizeof(uint64_t), target))){
+        TRACE(TRACE_ABORT, tx, source, trace_reason);
+        NUMA_FLUSH((struct region*) shared);
+        return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Write of one 8-byte word in the given transaction, as 'tm_write' with a constant size.
+ * @param shared Shared memory region associated with the transaction, of an alignment of 8 bytes
+ * @param tx     Transaction to use
+ * @param source Word to write (in a private region)
+ * @param target Word receiving the value (in the shared region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_write_word(shared_t shared, tx_t tx, void const* source, void* target) noexcept {
+    TRACE(TRACE_WRITE, tx, target, sizeof(uint64_t));
+    NUMA_COUNT((struct region*) shared, target);
+    dirty_mark((struct region*) shared, target, sizeof(uint64_t));
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        counter_add(((struct region*) shared)->counters[IRREVOCABLE_SLOT].writes, 1);
+        memcpy(target, source, sizeof(uint64_t));
+        return true;
+    }
+    if (unlikely(!ENGINE_CALL(shared, write)(shared, tx, source, sizeof(uint64_t), target))){
+        TRACE(TRACE_ABORT, tx, target, trace_reason);
+        NUMA_FLUSH((struct region*) shared);
+        return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Memory allocation in the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param size   Allocation requested size (in bytes), must be a positive multiple of the alignment
+ * @param target Pointer in private memory receiving the address of the first byte of the newly allocated, aligned segment
+ * @return Whether the whole transaction can continue (success/nomem), or not (abort_alloc)
+**/
+Alloc tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) noexcept {
+    PROFILE(PROFILE_ALLOC);
+    Alloc res = unlikely(tx == IRREVOCABLE_TX) ? irrevocable_alloc((struct region*) shared, size, target) : ENGINE_CALL(shared, alloc)(shared, tx, size, target);
+    if (res == Alloc::success){
+        TRACE(TRACE_ALLOC, tx, *target, size);
+    } else if (res == Alloc::abort){
+        TRACE(TRACE_ABORT, tx, NULL, trace_reason);
+        NUMA_FLUSH((struct region*) shared);
+    }
+    return res;
 }
 
 /** [thread-safe] Memory freeing in the given transaction.
@@ -445,23 +1999,648 @@ Alloc tm_alloc(shared_t shared, tx_t tx as(unused), size_t size, void** target)
  * @return Whether the whole transaction can continue
 **/
 bool tm_free(shared_t shared, tx_t tx, void* target) noexcept {
+    PROFILE(PROFILE_FREE);
+    TRACE(TRACE_FREE, tx, target, 0);
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        irrevocable_free((struct region*) shared, target);
+        return true;
+    }
+    if (unlikely(!ENGINE_CALL(shared, dealloc)(shared, tx, target))){
+        TRACE(TRACE_ABORT, tx, target, trace_reason);
+        NUMA_FLUSH((struct region*) shared);
+        return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Memory resizing in the given transaction, in place when the segment is large enough, else by moving it.
+ * A segment keeps the size it was allocated with: shrunk, then grown back up to that size, it stays where it is, with its
+ * content, so that the transactions reading it meanwhile are unaffected. Grown further, it moves to a new segment: the
+ * content is copied with a single read straight into the new segment (which the transaction writes in place, so nothing
+ * is logged) and the old one is freed, so the pointers to it must be updated. The blocks of large segments are not moved
+ * with 'mremap' instead, as the old one must stay readable by the other transactions until this one commits.
+ * Bytes past the previous size hold zeros, or what the segment held there before it was shrunk.
+ * @param shared   Shared memory region associated with the transaction
+ * @param tx       Transaction to use
+ * @param segment  Address of the first byte of the previously allocated segment to resize
+ * @param old_size Size of the segment, as last allocated or resized
+ * @param size     New size, a positive multiple of the alignment
+ * @param target   Pointer in private memory receiving the address of the first byte of the resized segment
+ * @return Whether the whole transaction can continue (success/nomem), or not (abort_alloc)
+**/
+Alloc tm_realloc(shared_t shared, tx_t tx, void* segment, size_t old_size, size_t size, void** target) noexcept {
     struct region* region = (struct region*) shared;
-    for(auto seg : region->segments){
-        //find segment to free
-        if(target == seg->mem){
-            //if cannot lock it, abort
-            if(!seg->lock.try_lock()){
-                if (!check_lock(tx,&seg->lock)){
-                    rollback(tx);
-                    return false;
-                }
-            }
-            ((struct transaction*) tx)->to_free_locks.push_back(&seg->lock);
-            seg->freed = true;
+    if (size <= old_size) {
+        *target = segment;
+        return Alloc::success;
+    }
+    //the ones allocated by the transaction are not registered yet, they move
+    struct segment* seg = segment_find(region, segment);
+    if (seg != NULL && seg->mem == segment && size <= seg->size) {
+        *target = segment;
+        return Alloc::success;
+    }
+    Alloc res = tm_alloc(shared, tx, size, target);
+    if (res != Alloc::success) {
+        return res;
+    }
+    if (unlikely(!tm_read(shared, tx, segment, old_size, *target) || !tm_free(shared, tx, segment))) {
+        return Alloc::abort;
+    }
+    return Alloc::success;
+}
+
+// -------------------------------------------------------------------------- //
+
+/** [thread-safe] Begin a transaction in the serial irrevocable mode: it waits for every other transaction of the region to end,
+ * then runs alone and cannot abort. Meant for transactions too large to ever commit otherwise, or that must not be retried.
+ * Where it is not available (see 'irrevocable_allowed'), this begins a regular read-write transaction instead.
+ * @param shared Shared memory region to start the transaction on
+ * @return Opaque transaction ID, to use as any other
+**/
+tx_t tm_begin_irrevocable(shared_t shared) noexcept {
+    if (unlikely(!irrevocable_allowed((struct region*) shared))) {
+        return tm_begin(shared, false);
+    }
+    tx_t tx = irrevocable_begin((struct region*) shared);
+    TRACE(TRACE_BEGIN, tx, NULL, 0);
+    return tx;
+}
+
+/** [thread-safe] Read several ranges in the given transaction, as many 'tm_read' would but with a single call.
+ * @param shared   Shared memory region associated with the transaction
+ * @param tx       Transaction to use
+ * @param accesses Ranges to read, from 'address' (in the shared region) to 'buffer' (in a private region)
+ * @param count    Number of ranges
+ * @return Whether the whole transaction can continue
+**/
+bool tm_read_batch(shared_t shared, tx_t tx, struct tm_access const* accesses, size_t count) noexcept {
+    struct region* region = (struct region*) shared;
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        counter_add(region->counters[IRREVOCABLE_SLOT].reads, count);
+        for (size_t i = 0; i < count; ++i) {
+            words_copy(accesses[i].buffer, accesses[i].address, accesses[i].size, region->align);
+        }
+        return true;
+    }
+    //one dispatch for the whole batch
+    auto read = ENGINE_CALL(region, read);
+    for (size_t i = 0; i < count; ++i) {
+        TRACE(TRACE_READ, tx, accesses[i].address, accesses[i].size);
+        NUMA_COUNT(region, accesses[i].address);
+        if (unlikely(!read(shared, tx, accesses[i].address, accesses[i].size, accesses[i].buffer))) {
+            TRACE(TRACE_ABORT, tx, accesses[i].address, trace_reason);
+            NUMA_FLUSH(region);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** [thread-safe] Write several ranges in the given transaction, as many 'tm_write' would but with a single call.
+ * @param shared   Shared memory region associated with the transaction
+ * @param tx       Transaction to use
+ * @param accesses Ranges to write, from 'buffer' (in a private region) to 'address' (in the shared region)
+ * @param count    Number of ranges
+ * @return Whether the whole transaction can continue
+**/
+bool tm_write_batch(shared_t shared, tx_t tx, struct tm_access const* accesses, size_t count) noexcept {
+    struct region* region = (struct region*) shared;
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        counter_add(region->counters[IRREVOCABLE_SLOT].writes, count);
+        for (size_t i = 0; i < count; ++i) {
+            dirty_mark(region, accesses[i].address, accesses[i].size);
+            words_copy(accesses[i].address, accesses[i].buffer, accesses[i].size, region->align);
+        }
+        return true;
+    }
+    auto write = ENGINE_CALL(region, write);
+    for (size_t i = 0; i < count; ++i) {
+        TRACE(TRACE_WRITE, tx, accesses[i].address, accesses[i].size);
+        NUMA_COUNT(region, accesses[i].address);
+        dirty_mark(region, accesses[i].address, accesses[i].size);
+        if (unlikely(!write(shared, tx, accesses[i].buffer, accesses[i].size, accesses[i].address))) {
+            TRACE(TRACE_ABORT, tx, accesses[i].address, trace_reason);
+            NUMA_FLUSH(region);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** [thread-safe] Read operation in the given transaction, of words it is about to write.
+ * Engines that lock before commit take write ownership here, so the following 'tm_write' cannot conflict.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in a private region)
+ * @return Whether the whole transaction can continue
+**/
+bool tm_read_for_update(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept {
+    TRACE(TRACE_READ, tx, source, size);
+    NUMA_COUNT((struct region*) shared, source);
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        counter_add(((struct region*) shared)->counters[IRREVOCABLE_SLOT].reads, 1);
+        words_copy(target, source, size, ((struct region*) shared)->align);
+        return true;
+    }
+    if (unlikely(!((struct region*) shared)->ops->read_for_update(shared, tx, source, size, target))){
+        TRACE(TRACE_ABORT, tx, source, trace_reason);
+        NUMA_FLUSH((struct region*) shared);
+        return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Read operation in the given transaction without a copy: get the range in place, for large read-only blocks.
+ * The view is only valid until the transaction ends, and is not opaque: its content may change meanwhile, in which case
+ * 'tm_end' fails. Use what it shows only once the transaction committed, or in a way a torn content cannot harm.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to view (in bytes), must be a positive multiple of the alignment
+ * @param view   Receives the start of the view, NULL if the range cannot be viewed (e.g. the transaction wrote to it), to read with 'tm_read' instead
+ * @return Whether the whole transaction can continue
+**/
+bool tm_read_view(shared_t shared, tx_t tx, void const* source, size_t size, void const** view) noexcept {
+    struct region* region = (struct region*) shared;
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        counter_add(region->counters[IRREVOCABLE_SLOT].reads, 1);
+        *view = source;
+    } else if (region->ops->read_view == nullptr) {
+        *view = NULL;
+        return true;
+    } else if (unlikely(!region->ops->read_view(shared, tx, source, size, view))){
+        TRACE(TRACE_ABORT, tx, source, trace_reason);
+        NUMA_FLUSH(region);
+        return false;
+    }
+    //traced once viewed, the fallback to 'tm_read' traces its own
+    if (*view != NULL) {
+        TRACE(TRACE_READ, tx, source, size);
+        NUMA_COUNT(region, source);
+    }
+    return true;
+}
+
+/** [thread-safe] Add to a 64-bit integer in the given transaction, commutatively with the other increments.
+ * Write-back engines apply the increment at commit, without reading the integer, so increments do not conflict.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Integer to increment (in the shared region), aligned on a word
+ * @param delta  Increment, wrapping around
+ * @return Whether the whole transaction can continue
+**/
+bool tm_add(shared_t shared, tx_t tx, void* target, int64_t delta) noexcept {
+    struct region* region = (struct region*) shared;
+    TRACE(TRACE_WRITE, tx, target, sizeof(uint64_t));
+    NUMA_COUNT(region, target);
+    dirty_mark(region, target, sizeof(uint64_t));
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        counter_add(region->counters[IRREVOCABLE_SLOT].writes, 1);
+        word_add(target, delta);
+        return true;
+    }
+    bool success;
+    if (likely(region->align >= sizeof(uint64_t))){
+        success = ENGINE_CALL(region, add)(shared, tx, target, delta);
+    } else {
+        //the integer spans several words, read and write them
+        uint64_t value;
+        success = ENGINE_CALL(region, read)(shared, tx, target, sizeof(value), &value);
+        if (likely(success)){
+            value += (uint64_t) delta;
+            success = ENGINE_CALL(region, write)(shared, tx, &value, sizeof(value), target);
+        }
+    }
+    if (unlikely(!success)){
+        TRACE(TRACE_ABORT, tx, target, trace_reason);
+        NUMA_FLUSH(region);
+        return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Early release: the given transaction does not depend anymore on words it read, e.g. when traversing a list.
+ * Conflicts on these words stop aborting the transaction; engines locking what is read keep their locks.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Start address of the words read (in the shared region)
+ * @param size   Length (in bytes), must be a positive multiple of the alignment
+**/
+void tm_release(shared_t shared, tx_t tx, void const* source, size_t size) noexcept {
+    if (unlikely(tx == IRREVOCABLE_TX)) {
+        //nothing can conflict
+        return;
+    }
+    ENGINE_CALL(shared, release)(shared, tx, source, size);
+}
+
+/** [thread-safe] Run a transaction until it commits, retrying within the library: an abort costs the caller no unwinding.
+ * Each retry goes through 'tm_begin', so the contention manager paces it and may run it in the serial irrevocable mode.
+ * @param shared Shared memory region to run the transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param body   Body of the transaction, returning false as soon as one of its operations failed (the transaction is then over)
+ * @param ctx    Argument passed to the body
+ * @return Whether the transaction committed, false only if it could not begin
+**/
+bool tm_run(shared_t shared, bool is_ro, bool (*body)(shared_t, tx_t, void*), void* ctx) noexcept {
+    while (true) {
+        tx_t tx = tm_begin(shared, is_ro);
+        if (unlikely(tx == invalid_tx)) {
+            return false;
+        }
+        if (likely(body(shared, tx, ctx) && tm_end(shared, tx))) {
             return true;
         }
     }
-    //if the address is not in the given region, abort the transaction
-    rollback(tx);
-    return false;
+}
+
+/** [thread-safe] Describe the engine currently running the transactions of the given shared memory region.
+ * @param shared Shared memory region to query
+ * @param mode   Description to fill
+ * @return Whether the description was filled
+**/
+bool tm_mode(shared_t shared, struct tm_mode* mode) noexcept {
+    struct region* region = (struct region*) shared;
+    if (region->adaptive != NULL){
+        adaptive::query(shared, mode);
+        return true;
+    }
+    mode->engine = region->ops->name;
+    mode->adaptive = false;
+    mode->abort_rate = 0;
+    mode->upper = 0;
+    mode->window = 0;
+    mode->probe = 0;
+    mode->switches = 0;
+    return true;
+}
+
+/** [thread-safe] Sum up the statistics of the transactions run so far on the given shared memory region.
+ * @param shared Shared memory region to query
+ * @param stats  Statistics to fill
+ * @return Whether the statistics were filled
+**/
+bool tm_stats(shared_t shared, struct tm_stats* stats) noexcept {
+    struct region* region = (struct region*) shared;
+    memset(stats, 0, sizeof(*stats));
+    //counters of running transactions may be slightly behind
+    for (auto const& counters : region->counters){
+        stats->commits += counters.commits.load(memory_order_relaxed);
+        for (int i = 0; i < TM_ABORT_REASONS; ++i){
+            stats->aborts[i] += counters.aborts[i].load(memory_order_relaxed);
+        }
+        stats->reads += counters.reads.load(memory_order_relaxed);
+        stats->writes += counters.writes.load(memory_order_relaxed);
+        stats->allocs += counters.allocs.load(memory_order_relaxed);
+        stats->frees += counters.frees.load(memory_order_relaxed);
+        stats->extensions += counters.extensions.load(memory_order_relaxed);
+        stats->irrevocable += counters.irrevocable.load(memory_order_relaxed);
+        stats->descriptor_bytes += counters.descriptor.load(memory_order_relaxed);
+    }
+    stats->data_bytes = region->live.load(memory_order_relaxed);
+    stats->metadata_bytes = sizeof(struct region) + region->overhead.load(memory_order_relaxed) + stats->descriptor_bytes;
+    static_assert(TM_RETRY_BUCKETS == CM_RETRY_BUCKETS, "Retry buckets of the interface and of the contention manager differ");
+    stats->max_retries = cm_retried(&region->cm, stats->retries);
+    stats->retries[0] = stats->commits;
+    for (size_t i = 1; i < TM_RETRY_BUCKETS; ++i){
+        //counted apart from 'commits', a concurrent commit may be in one and not yet in the other
+        stats->retries[0] -= stats->retries[i] < stats->retries[0] ? stats->retries[i] : stats->retries[0];
+    }
+    if (region->shm != NULL){
+        shm_count(region, &stats->processes, &stats->threads);
+    }
+    uint64_t aborts = 0;
+    for (int i = 0; i < TM_ABORT_REASONS; ++i){
+        aborts += stats->aborts[i];
+    }
+    cm_classes(&region->cm, &stats->class_commits[TM_CLASS_BATCH], &stats->class_aborts[TM_CLASS_BATCH]);
+    stats->class_commits[TM_CLASS_INTERACTIVE] = stats->commits - (stats->class_commits[TM_CLASS_BATCH] < stats->commits ? stats->class_commits[TM_CLASS_BATCH] : stats->commits);
+    stats->class_aborts[TM_CLASS_INTERACTIVE] = aborts - (stats->class_aborts[TM_CLASS_BATCH] < aborts ? stats->class_aborts[TM_CLASS_BATCH] : aborts);
+    if (region->adaptive != NULL){
+        adaptive::stats(shared, stats);
+    } else if (strcmp(region->ops->name, "tl2") == 0){
+        tl2::stats(region->engine, stats);
+    }
+    return true;
+}
+
+/** [thread-safe] Register the calling thread as a user of a region shared between processes, counted in 'tm_stats' by every process.
+ * Optional, transactions run the same without it; to call once per thread, before its first transaction.
+ * @param shared Shared memory region
+ * @return Whether the thread was registered, i.e. the region is shared between processes
+**/
+bool tm_register_thread(shared_t shared) noexcept {
+    return shm_register_thread((struct region*) shared);
+}
+
+/** [thread-safe] Unregister the calling thread, after its last transaction.
+ * @param shared Shared memory region the thread registered with
+**/
+void tm_unregister_thread(shared_t shared) noexcept {
+    shm_unregister_thread((struct region*) shared);
+}
+
+/** [thread-safe] Register the calling thread with a region before its first transaction, for its per-thread state to be ready.
+ * The thread takes the lowest free dense index, so that the first EPOCH_SLOTS threads each get their own epoch slot and
+ * counters, and the engine allocates its descriptors from this thread, hence on its NUMA node. Optional, as is 'tm_register_thread'.
+ * @param shared Shared memory region
+ * @return Whether the thread got a dense index, otherwise its transactions share the slots as without this call
+**/
+bool tm_thread_enter(shared_t shared) noexcept {
+    struct region* region = (struct region*) shared;
+    if (thread_member == SIZE_MAX) {
+        for (size_t i = 0; i < EPOCH_SLOTS; ++i){
+            uint64_t bit = UINT64_C(1) << (i % 64);
+            if ((region->members[i / 64].load(memory_order_relaxed) & bit) == 0 && (region->members[i / 64].fetch_or(bit, memory_order_relaxed) & bit) == 0) {
+                thread_member = i;
+                thread_hint = i;
+                break;
+            }
+        }
+    }
+    ENGINE_CALL(region, thread_enter)(shared);
+    return thread_member != SIZE_MAX;
+}
+
+/** [thread-safe] Release the per-thread state of the calling thread, after its last transaction on the region.
+ * Its descriptors are freed and its cached segment blocks go to the other threads, rather than at thread exit.
+ * @param shared Shared memory region the thread entered
+**/
+void tm_thread_leave(shared_t shared) noexcept {
+    struct region* region = (struct region*) shared;
+    ENGINE_CALL(region, thread_leave)(shared);
+    slab_flush();
+    if (thread_member != SIZE_MAX) {
+        region->members[thread_member / 64].fetch_and(~(UINT64_C(1) << (thread_member % 64)), memory_order_relaxed);
+        thread_member = SIZE_MAX;
+        thread_hint = SIZE_MAX;
+    }
+}
+
+/** Write a whole buffer to a file descriptor, async-signal-safe.
+ * @param fd     File descriptor
+ * @param buffer Data to write
+ * @param size   Length of the data
+ * @return Whether everything was written
+**/
+static bool write_all(int fd, void const* buffer, size_t size) noexcept {
+    while (size > 0) {
+        ssize_t written = write(fd, buffer, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        buffer = (char const*) buffer + written;
+        size -= (size_t) written;
+    }
+    return true;
+}
+
+/** Call a function on every range of a segment a checkpoint writes, as maximal runs of dirty ranges.
+ * @param seg   Segment to copy
+ * @param delta Whether to include only the ranges written since the last checkpoint
+ * @param func  Function taking the offset and the size of a range
+**/
+template<class Func> static void checkpoint_ranges(struct segment* seg, bool delta, Func&& func) noexcept {
+    if (!delta) {
+        func(0, seg->size);
+        return;
+    }
+    size_t count = (seg->size + (1ul << TM_DIRTY_LOG2) - 1) >> TM_DIRTY_LOG2;
+    for (size_t i = 0; i < count;){
+        if ((seg->dirty[i / 64].load(memory_order_relaxed) & (UINT64_C(1) << (i % 64))) == 0) {
+            ++i;
+            continue;
+        }
+        size_t first = i;
+        while (i < count && (seg->dirty[i / 64].load(memory_order_relaxed) & (UINT64_C(1) << (i % 64))) != 0) {
+            ++i;
+        }
+        size_t end = i << TM_DIRTY_LOG2;
+        func(first << TM_DIRTY_LOG2, (end < seg->size ? end : seg->size) - (first << TM_DIRTY_LOG2));
+    }
+}
+
+/** Write one segment of a checkpoint.
+ * @param seg   Segment to copy
+ * @param delta Whether to include only the ranges written since the last checkpoint
+ * @param fd    File descriptor to write to
+ * @return Whether everything was written
+**/
+static bool checkpoint_segment(struct segment* seg, bool delta, int fd) noexcept {
+    struct tm_checkpoint_segment record = {(uint64_t) (uintptr_t) seg->mem, seg->size, 0};
+    checkpoint_ranges(seg, delta, [&record](size_t, size_t) { ++record.ranges; });
+    bool written = write_all(fd, &record, sizeof(record));
+    checkpoint_ranges(seg, delta, [&](size_t offset, size_t size) {
+        struct tm_checkpoint_range range = {offset, size};
+        written = written && write_all(fd, &range, sizeof(range)) && write_all(fd, seg->mem + offset, size);
+    });
+    return written;
+}
+
+/** Write the content of a region, as a child process sees it right after 'fork'.
+ * Only the calling thread exists there, so it neither allocates nor locks anything.
+ * @param region Region, frozen in the image of the child
+ * @param delta  Whether to include only the ranges written since the last checkpoint
+ * @param fd     File descriptor to write to
+ * @return Whether everything was written
+**/
+static bool checkpoint_write(struct region* region, bool delta, int fd) noexcept {
+    struct tm_checkpoint_header header = {TM_CHECKPOINT_MAGIC, region->align, 0, delta};
+    segments_for_each(region, [&header](struct segment*) { ++header.segments; });
+    if (!write_all(fd, &header, sizeof(header))) {
+        return false;
+    }
+    //the first segment first, the others in address order
+    struct segment* first = segment_find(region, region->start);
+    bool written = checkpoint_segment(first, delta, fd);
+    segments_for_each(region, [&](struct segment* seg) {
+        written = written && (seg == first || checkpoint_segment(seg, delta, fd));
+    });
+    return written;
+}
+
+/** Write a consistent copy of a region from a child process, see 'tm_checkpoint' and 'tm_checkpoint_delta'.
+ * The dirty bits restart empty with the copy, and are trusted again only once the copy was written.
+ * @param region Region to copy, in which the calling thread runs no transaction
+ * @param delta  Whether to include only the ranges written since the last checkpoint, if they are known
+ * @param fd     File descriptor to write to
+ * @return Whether the whole copy was written
+**/
+static bool checkpoint(struct region* region, bool delta, int fd) noexcept {
+    if (region->persist != NULL || region->shm != NULL) {
+        return false;
+    }
+    //no commit runs, the image of the child is a state between two of them
+    region_quiesce(region, true);
+    delta = delta && region->tracking.load(memory_order_relaxed);
+    pid_t child = fork();
+    if (child == 0) {
+        _exit(checkpoint_write(region, delta, fd) ? 0 : 1);
+    }
+    if (child > 0) {
+        segments_for_each(region, [](struct segment* seg) {
+            for (size_t i = 0; i < dirty_words(seg->size); ++i){
+                seg->dirty[i].store(0, memory_order_relaxed);
+            }
+        });
+        region->tracking.store(true, memory_order_relaxed);
+    }
+    region_resume(region);
+    if (child < 0) {
+        return false;
+    }
+    int status;
+    while (waitpid(child, &status, 0) < 0) {
+        if (errno != EINTR) {
+            status = -1;
+            break;
+        }
+    }
+    if (status != 0) {
+        //what the copy missed is lost, the next delta copies everything
+        region->tracking.store(false, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+/** [thread-safe] Write a consistent copy of every live segment of a region to a file descriptor, while transactions keep running.
+ * New transactions wait only until every running one ended and the process forked: the copy is then written by the child,
+ * from its copy-on-write image, and no transaction is aborted. The format is described with 'tm_checkpoint_header'.
+ * Only for volatile regions private to the process: the memory of the others is shared with the child, not copied.
+ * @param shared Shared memory region, in which the calling thread runs no transaction
+ * @param fd     File descriptor to write to, e.g. a file or a pipe
+ * @return Whether the whole copy was written
+**/
+bool tm_checkpoint(shared_t shared, int fd) noexcept {
+    return checkpoint((struct region*) shared, false, fd);
+}
+
+/** [thread-safe] Write the ranges of a region written since the previous checkpoint, as 'tm_checkpoint' does for the whole region.
+ * Ranges of TM_DIRTY_LOG2 bytes are tracked from the first checkpoint on; without a previous successful one, the copy is
+ * a full one ('delta' is 0 in its header). Each copy is relative to the previous one: take them from one thread at a time.
+ * @param shared Shared memory region, in which the calling thread runs no transaction
+ * @param fd     File descriptor to write to, e.g. a file or a pipe
+ * @return Whether the whole copy was written
+**/
+bool tm_checkpoint_delta(shared_t shared, int fd) noexcept {
+    return checkpoint((struct region*) shared, true, fd);
+}
+
+/** [thread-safe] Move the segments allocated by transactions into one contiguous arena, restoring the locality of a region
+ * fragmented by a long churn of allocations and frees. The first segment, fixed by contract, stays where it is.
+ * It runs as the serial irrevocable transaction, but gives up instead of waiting if another thread is quiescing the region:
+ * meant to be called every now and then by a background thread. For each moved segment, 'relocate' updates every reference to
+ * it through the given transaction, e.g. with 'tm_read' and 'tm_write'; the old memory stays readable until they all ran.
+ * Only for volatile regions private to the process (see 'tm_begin_irrevocable'), and an alignment of at most a page.
+ * @param shared   Shared memory region, in which the calling thread runs no transaction
+ * @param relocate Called with the region, the transaction, the old and new start of a moved segment, its size and 'ctx'
+ * @param ctx      Argument passed to 'relocate'
+ * @return Number of segments moved, 0 if fewer than TM_COMPACT_MIN could be
+**/
+size_t tm_compact(shared_t shared, void (*relocate)(shared_t, tx_t, void*, void*, size_t, void*), void* ctx) noexcept {
+    struct region* region = (struct region*) shared;
+    size_t page = 1ul << SEGMENT_PAGE_LOG2;
+    if (unlikely(!irrevocable_allowed(region) || region->align > page || relocate == NULL)) {
+        return 0;
+    }
+    if (!region_quiesce(region, false)) {
+        return 0;
+    }
+    vector<struct segment*> moved;
+    size_t total = page;
+    segments_for_each(region, [&](struct segment* seg) {
+        //packed segments already share their pages
+        if (seg->mem != region->start && seg->source != BLOCK_FOREIGN && seg->source != BLOCK_PACKED) {
+            moved.push_back(seg);
+            total += segment_layout(region, seg->size, NULL, NULL);
+        }
+    });
+    void* map = moved.size() < TM_COMPACT_MIN ? NULL : block_map(region, &total, page);
+    if (map == NULL || unlikely(!pagemap_reserve(region, map, total))) {
+        if (map != NULL) {
+            munmap(map, total);
+        }
+        region_resume(region);
+        return 0;
+    }
+    //the moved segments come from every thread
+    if (region->placed) {
+        numa_interleave(map, total);
+    }
+    struct segment_arena* arena = new (map) struct segment_arena();
+    arena->segments.store(moved.size(), memory_order_relaxed);
+    arena->size = total;
+    //in address order, which is the order 'segments_for_each' walks them
+    vector<struct segment*> fresh;
+    std::byte* block = (std::byte*) map + page;
+    for (struct segment* old : moved){
+        size_t size = segment_layout(region, old->size, NULL, NULL);
+        struct segment* seg = segment_init(region, block, old->size, size, -1, BLOCK_ARENA);
+        seg->arena = arena;
+        memcpy(seg->mem, old->mem, old->size);
+        segment_unregister(region, old);
+        segment_register(region, seg);
+        fresh.push_back(seg);
+        block += size;
+    }
+    for (size_t i = 0; i < moved.size(); ++i){
+        relocate(shared, IRREVOCABLE_TX, moved[i]->mem, fresh[i]->mem, moved[i]->size, ctx);
+    }
+    //no transaction ran since they were unregistered
+    for (struct segment* old : moved){
+        segment_destroy(old);
+    }
+    counter_add(region->counters[IRREVOCABLE_SLOT].commits, 1);
+    counter_add(region->counters[IRREVOCABLE_SLOT].irrevocable, 1);
+    region_resume(region);
+    return moved.size();
+}
+
+/** [thread-safe] Begin a new transaction of the given class: batch transactions yield to the interactive ones in conflicts,
+ * at commit and under admission control, so that background work (e.g. rebalancing) stays off the way of latency-critical work.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param klass  Class of the transaction, one of 'TM_CLASS_*'
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+**/
+tx_t tm_begin_class(shared_t shared, bool is_ro, int klass) noexcept {
+    struct region* region = (struct region*) shared;
+    if (unlikely(klass < 0 || klass >= TM_CLASSES)) {
+        return invalid_tx;
+    }
+    cm_classify(&region->cm, klass);
+    tx_t tx = tm_begin(shared, is_ro);
+    if (unlikely(tx == invalid_tx)) {
+        //never ended, the next one is interactive again
+        cm_classify(&region->cm, TM_CLASS_INTERACTIVE);
+    }
+    return tx;
+}
+
+/** [thread-safe] Write directly to the shared memory outside of any transaction, to load a region before it is used.
+ * Only valid while no transaction runs on the region, e.g. between its creation and the first 'tm_begin'; several threads may load
+ * disjoint ranges concurrently, and must synchronize with the threads that then begin transactions. The writes are marked dirty for
+ * the next checkpoint but not counted in 'tm_stats'. Not available where the irrevocable transaction is not (see 'irrevocable_allowed'),
+ * as the writes would skip the redo log of a durable or shipped region.
+ * @param shared Shared memory region to write to
+ * @param source Source start address (in a private region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in the shared region)
+ * @return Whether the memory was written, else the caller must write it in transactions
+**/
+bool tm_bulk_write(shared_t shared, void const* source, size_t size, void* target) noexcept {
+    struct region* region = (struct region*) shared;
+    if (unlikely(!irrevocable_allowed(region))) {
+        return false;
+    }
+    dirty_mark(region, target, size);
+    words_copy(target, source, size, region->align);
+    return true;
 }
@@ -0,0 +1,168 @@
+/**
+ * @file   layout_bench.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Compare the cache-line layout of the metadata against a packed layout:
+ * lookups reading a segment header while another thread writes its version,
+ * and threads each bumping their own counters. Cache misses are read from
+ * the hardware counters when the kernel exposes them.
+**/
+
+// External headers
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <shared_mutex>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Internal headers
+#include "../region.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Operations per thread and per measure
+#define BENCH_OPS 20000000
+
+/** Segment header as it was laid out before, every field packed together.
+**/
+struct packed_segment {
+    std::shared_mutex lock;
+    std::atomic<uint64_t> version;
+    std::byte* mem;
+    size_t size;
+    bool freed;
+};
+
+/** Per-thread counters as they would be without padding.
+**/
+struct packed_counters {
+    std::atomic<uint64_t> commits;
+};
+
+/** Open a counter of the cache misses of the whole process, on every processor.
+ * @return File descriptor, -1 if not available
+**/
+static int misses_open() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/** Run one measure.
+ * @param name    Name of the measure
+ * @param threads Number of threads
+ * @param body    Function run by every thread, given its index
+**/
+template<class Body> static void measure(char const* name, size_t threads, Body body) {
+    int fd = misses_open();
+    if (fd >= 0){
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (size_t i = 0; i < threads; ++i){
+        workers.emplace_back(body, i);
+    }
+    for (auto& worker : workers){
+        worker.join();
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    printf("%-28s %10.1f ms", name, ms);
+    if (fd >= 0){
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t misses = 0;
+        if (read(fd, &misses, sizeof(misses)) == sizeof(misses)){
+            printf(" %14" PRIu64 " cache misses", misses);
+        }
+        close(fd);
+    } else {
+        printf("    (cache misses not available)");
+    }
+    printf("\n");
+}
+
+/** Readers load the fields of a segment lookup while thread 0 keeps writing the version.
+ * @param name    Name of the measure
+ * @param threads Number of threads
+ * @param seg     Segment header to use
+**/
+template<class Segment> static void lookups(char const* name, size_t threads, Segment* seg) {
+    atomic<bool> stop{false};
+    measure(name, threads, [&](size_t index) {
+        if (index == 0){
+            while (!stop.load(memory_order_relaxed)){
+                seg->version.fetch_add(2, memory_order_release);
+            }
+            return;
+        }
+        uintptr_t sum = 0;
+        for (size_t i = 0; i < BENCH_OPS; ++i){
+            sum += (uintptr_t) *(std::byte* volatile*) &seg->mem + *(size_t volatile*) &seg->size;
+        }
+        if (sum == 1){
+            printf("unlikely\n");
+        }
+        if (index == 1){
+            stop.store(true, memory_order_relaxed);
+        }
+    });
+}
+
+/** Every thread bumps its own counter, as 'counter_add' does.
+ * @param name     Name of the measure
+ * @param threads  Number of threads
+ * @param counters One counter per thread
+**/
+template<class Counters> static void counters(char const* name, size_t threads, Counters* counters) {
+    measure(name, threads, [&](size_t index) {
+        for (size_t i = 0; i < BENCH_OPS; ++i){
+            counter_add(counters[index].commits, 1);
+        }
+    });
+}
+
+int main(int argc, char** argv) {
+    size_t threads = argc > 1 ? strtoul(argv[1], NULL, 10) : thread::hardware_concurrency();
+    if (threads < 2){
+        threads = 2;
+    }
+    printf("%zu threads, %d operations per thread\n", threads, BENCH_OPS);
+
+    auto packed = new struct packed_segment();
+    auto padded = new struct segment();
+    lookups("lookups, packed header", threads, packed);
+    lookups("lookups, padded header", threads, padded);
+    delete packed;
+    delete padded;
+
+    auto packed_table = new struct packed_counters[threads]();
+    auto padded_table = new struct tx_counters[threads]();
+    counters("counters, packed", threads, packed_table);
+    counters("counters, padded", threads, padded_table);
+    delete[] packed_table;
+    delete[] padded_table;
+    return 0;
+}
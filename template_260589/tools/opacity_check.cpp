@@ -0,0 +1,153 @@
+/**
+ * @file   opacity_check.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Check an opacity log written by a library built with USE_OPACITY_LOG. Every
+ * word a sampled transaction read, committed or aborted, must be the latest
+ * version at its final snapshot: no sampled commit may have written it at a
+ * version after the one read and up to that snapshot. Only the commits that
+ * were sampled too are known, so a violation is found with a probability of
+ * about the sampling rate, and more runs find more. Samples the log lost the
+ * end of are left out. Prints the first violations, then a summary; exits
+ * with 2 if any was found.
+**/
+
+// External headers
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "../opacity.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Number of violations printed in full
+#define SHOWN 20
+
+/** What the log holds of one sampled transaction.
+**/
+struct sample {
+    bool begun = false;
+    int end = -1;          // OPACITY_COMMIT or OPACITY_ABORT once ended
+    uint64_t snapshot = 0; // Final snapshot
+    vector<pair<uint64_t, uint64_t>> reads; // Word, version read
+};
+
+int main(int argc, char** argv) {
+    if (argc != 2){
+        fprintf(stderr, "Usage: %s <opacity log file>\n", argc > 0 ? argv[0] : "opacity_check");
+        return 1;
+    }
+    FILE* file = fopen(argv[1], "rb");
+    if (file == NULL){
+        fprintf(stderr, "cannot open '%s'\n", argv[1]);
+        return 1;
+    }
+    struct opacity_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != OPACITY_MAGIC || header.record_size != sizeof(struct opacity_record)){
+        fprintf(stderr, "'%s' is not an opacity log of this version\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+    unordered_map<uint64_t, struct sample> samples;
+    unordered_map<uint64_t, vector<pair<uint64_t, uint64_t>>> writes; // Word, to the write versions and writers of the sampled commits
+    uint64_t threads = 0;
+    uint64_t dropped = 0;
+    struct opacity_chunk chunk;
+    while (fread(&chunk, sizeof(chunk), 1, file) == 1){
+        ++threads;
+        dropped += chunk.dropped;
+        for (uint64_t i = 0; i < chunk.count; ++i){
+            struct opacity_record record;
+            if (fread(&record, sizeof(record), 1, file) != 1){
+                fprintf(stderr, "truncated opacity log\n");
+                fclose(file);
+                return 1;
+            }
+            struct sample& tx = samples[record.tx];
+            switch (record.event){
+                case OPACITY_BEGIN:
+                    tx.begun = true;
+                    break;
+                case OPACITY_READ:
+                    tx.reads.emplace_back(record.address, record.version);
+                    break;
+                case OPACITY_WRITE:
+                    writes[record.address].emplace_back(record.version, record.tx);
+                    break;
+                case OPACITY_COMMIT:
+                case OPACITY_ABORT:
+                    tx.end = (int) record.event;
+                    tx.snapshot = record.version;
+                    break;
+            }
+        }
+    }
+    fclose(file);
+    //the write version only counts once the commit completed
+    for (auto& entry : writes){
+        auto& list = entry.second;
+        list.erase(remove_if(list.begin(), list.end(), [&](pair<uint64_t, uint64_t> const& write) {
+            auto it = samples.find(write.second);
+            return it == samples.end() || it->second.end != OPACITY_COMMIT;
+        }), list.end());
+        sort(list.begin(), list.end());
+    }
+    uint64_t complete = 0, commits = 0, reads = 0, violations = 0;
+    for (auto const& entry : samples){
+        struct sample const& tx = entry.second;
+        if (!tx.begun || tx.end < 0){
+            continue;
+        }
+        ++complete;
+        commits += (tx.end == OPACITY_COMMIT);
+        for (auto const& read : tx.reads){
+            ++reads;
+            uint64_t overwritten = 0; // Version of a commit that overwrote the word before the snapshot, 0 if none
+            uint64_t writer = 0;
+            if (read.second > tx.snapshot){
+                overwritten = read.second;
+            } else {
+                auto found = writes.find(read.first);
+                if (found != writes.end()){
+                    auto const& list = found->second;
+                    //first write after the version read, not from the reader itself
+                    for (auto it = upper_bound(list.begin(), list.end(), make_pair(read.second, UINT64_MAX)); it != list.end() && it->first <= tx.snapshot; ++it){
+                        if (it->second != entry.first){
+                            overwritten = it->first;
+                            writer = it->second;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (overwritten == 0){
+                continue;
+            }
+            if (++violations <= SHOWN){
+                if (writer == 0){
+                    printf("tx %#" PRIx64 " (%s at %" PRIu64 ") read %#" PRIx64 " at version %" PRIu64 ", after its snapshot\n",
+                        entry.first, tx.end == OPACITY_COMMIT ? "committed" : "aborted", tx.snapshot, read.first, read.second);
+                } else {
+                    printf("tx %#" PRIx64 " (%s at %" PRIu64 ") read %#" PRIx64 " at version %" PRIu64 ", overwritten by tx %#" PRIx64 " at version %" PRIu64 "\n",
+                        entry.first, tx.end == OPACITY_COMMIT ? "committed" : "aborted", tx.snapshot, read.first, read.second, writer, overwritten);
+                }
+            }
+        }
+    }
+    printf("%" PRIu64 " threads, %zu samples (%" PRIu64 " complete, %" PRIu64 " committed, %" PRIu64 " not taken for lack of room), %" PRIu64 " reads checked, %" PRIu64 " violations\n",
+        threads, samples.size(), complete, commits, dropped, reads, violations);
+    return violations > 0 ? 2 : 0;
+}
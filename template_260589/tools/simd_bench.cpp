@@ -0,0 +1,104 @@
+/**
+ * @file   simd_bench.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Compare the variants of the validation kernels of 'simd.hpp' on the host:
+ * read sets of single stripes scattered over a lock table (gathers), and
+ * ranges of consecutive stripes (contiguous loads), every stripe valid so
+ * that each kernel goes through the whole set. The variants the processor
+ * does not support are skipped, and the one the library picks is marked.
+**/
+
+// External headers
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Internal headers
+#include "../simd.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Stripes of the lock table
+#define BENCH_STRIPES (1 << 20)
+// Lock words checked per variant and per measure
+#define BENCH_CHECKS 200000000
+
+/** Read entry as 'tl2' lays it out.
+**/
+struct bench_read {
+    atomic<uint64_t>* lock;
+    uint32_t count;
+    uint32_t words;
+};
+
+using reads_kernel = size_t (*)(void const*, size_t, size_t, uint64_t) noexcept;
+using range_kernel = size_t (*)(atomic<uint64_t> const*, size_t, uint64_t) noexcept;
+
+// Names and variants, by level
+static char const* const names[SIMD_LEVELS] = {"scalar", "avx2", "avx512"};
+#if defined(__x86_64__) || defined(__i386__)
+static reads_kernel const reads_kernels[SIMD_LEVELS] = {simd_skip_reads_scalar, simd_skip_reads_avx2, simd_skip_reads_avx512};
+static range_kernel const range_kernels[SIMD_LEVELS] = {simd_skip_range_scalar, simd_skip_range_avx2, simd_skip_range_avx512};
+#else
+static reads_kernel const reads_kernels[SIMD_LEVELS] = {simd_skip_reads_scalar, NULL, NULL};
+static range_kernel const range_kernels[SIMD_LEVELS] = {simd_skip_range_scalar, NULL, NULL};
+#endif
+
+/** Time one variant over a set.
+ * @param label   Name of the set
+ * @param level   Variant, one of 'SIMD_*'
+ * @param best    Variant the library picks
+ * @param size    Entries or stripes per set
+ * @param kernel  Check of the whole set, returning how many it skipped
+**/
+template<class Kernel> static void measure(char const* label, int level, int best, size_t size, Kernel kernel) {
+    size_t rounds = BENCH_CHECKS / size;
+    size_t skipped = 0;
+    auto start = chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r){
+        skipped += kernel();
+    }
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    //vector variants leave the tail to the caller, as 'validate' checks it one by one
+    printf("%-8s %-7s %6zu per set %8.3f ns per stripe, %5.1f%% skipped%s\n", label, names[level], size, ns / (rounds * size), 100. * skipped / (rounds * size), level == best ? "  <- picked" : "");
+}
+
+int main(int argc, char** argv) {
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 64;
+    if (size == 0){
+        size = 64;
+    }
+    int best = simd_level();
+    uint64_t rv = 1000;
+    vector<atomic<uint64_t>> locks(BENCH_STRIPES);
+    for (size_t i = 0; i < locks.size(); ++i){
+        locks[i].store((uint64_t) (i % rv) << 1, memory_order_relaxed);
+    }
+    vector<struct bench_read> reads(size);
+    uint64_t seed = 88172645463325252ull;
+    for (auto& read : reads){
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        read = {&locks[seed % BENCH_STRIPES], 1, 1};
+    }
+    for (int level = 0; level <= best; ++level){
+        measure("scatter", level, best, size, [&]() { return reads_kernels[level](reads.data(), sizeof(struct bench_read), size, rv); });
+    }
+    for (int level = 0; level <= best; ++level){
+        measure("range", level, best, size, [&]() { return range_kernels[level](locks.data(), size, rv); });
+    }
+    return 0;
+}
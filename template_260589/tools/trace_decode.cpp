@@ -0,0 +1,94 @@
+/**
+ * @file   trace_decode.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Print a trace file written by a library built with USE_TRACE, one event
+ * per line, then how many transactions aborted for each reason. Commits and
+ * aborts show the number of cycles since the beginning of the transaction.
+**/
+
+// External headers
+#include <cinttypes>
+#include <cstdio>
+
+// Internal headers
+#include <tm_ext.hpp>
+#include "../trace.hpp"
+
+// -------------------------------------------------------------------------- //
+
+static char const* const events[] = {"begin", "read", "write", "alloc", "free", "abort", "commit"};
+static char const* const reasons[TM_ABORT_REASONS] = {"read", "lock", "validate", "other"};
+
+int main(int argc, char** argv) {
+    if (argc != 2){
+        fprintf(stderr, "Usage: %s <trace file>\n", argc > 0 ? argv[0] : "trace_decode");
+        return 1;
+    }
+    FILE* file = fopen(argv[1], "rb");
+    if (file == NULL){
+        fprintf(stderr, "cannot open '%s'\n", argv[1]);
+        return 1;
+    }
+    struct trace_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != TRACE_MAGIC || header.record_size != sizeof(struct trace_record)){
+        fprintf(stderr, "'%s' is not a trace file of this version\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+    uint64_t aborts[TM_ABORT_REASONS] = {0};
+    uint64_t commits = 0;
+    struct trace_chunk chunk;
+    while (fread(&chunk, sizeof(chunk), 1, file) == 1){
+        uint64_t begin = 0; // Timestamp of the last begin of the thread
+        for (uint64_t i = 0; i < chunk.count; ++i){
+            struct trace_record record;
+            if (fread(&record, sizeof(record), 1, file) != 1){
+                fprintf(stderr, "truncated trace file\n");
+                fclose(file);
+                return 1;
+            }
+            char const* event = record.event < sizeof(events) / sizeof(*events) ? events[record.event] : "?";
+            printf("%3" PRIu64 " %20" PRIu64 " tx %#18" PRIx64 " %-6s", chunk.thread, record.tsc, record.tx, event);
+            switch (record.event){
+                case TRACE_BEGIN:
+                    begin = record.tsc;
+                    printf(" %s", record.info ? "ro" : "rw");
+                    break;
+                case TRACE_READ:
+                case TRACE_WRITE:
+                case TRACE_ALLOC:
+                    printf(" %#" PRIx64 " (%" PRIu32 " bytes)", record.address, record.info);
+                    break;
+                case TRACE_FREE:
+                    printf(" %#" PRIx64, record.address);
+                    break;
+                case TRACE_ABORT:
+                    if (record.info < TM_ABORT_REASONS){
+                        ++aborts[record.info];
+                        printf(" %s", reasons[record.info]);
+                    }
+                    printf(" at %#" PRIx64 " after %" PRIu64 " cycles", record.address, record.tsc - begin);
+                    break;
+                case TRACE_COMMIT:
+                    ++commits;
+                    printf(" after %" PRIu64 " cycles", record.tsc - begin);
+                    break;
+            }
+            printf("\n");
+        }
+    }
+    fclose(file);
+    printf("%" PRIu64 " commits, aborts:", commits);
+    for (int i = 0; i < TM_ABORT_REASONS; ++i){
+        printf(" %" PRIu64 " %s", aborts[i], reasons[i]);
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file   trace.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Transaction event tracer, empty unless built with USE_TRACE. A ring is
+ * only written by its thread, the dump is meant to run once every thread
+ * stopped running transactions.
+**/
+
+// Internal headers
+#include "common.hpp"
+#include "trace.hpp"
+
+#ifdef USE_TRACE
+
+// External headers
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+// Log2 of the number of records kept per thread, the oldest are overwritten
+#ifndef TRACE_RING_LOG2
+    #define TRACE_RING_LOG2 16
+#endif
+
+/** Records of one thread, never freed so that they outlive the thread.
+**/
+struct trace_ring {
+    struct trace_ring* next;
+    uint64_t thread;
+    atomic<uint64_t> head; // Number of records ever written
+    struct trace_record records[1ul << TRACE_RING_LOG2];
+};
+
+static atomic<struct trace_ring*> rings{NULL};
+static atomic<uint64_t> threads{0};
+static thread_local struct trace_ring* ring = NULL;
+
+thread_local uint32_t trace_reason = 0;
+
+/** Read the timestamp counter.
+ * @return Current timestamp
+**/
+static inline uint64_t trace_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+/** Get the ring of the calling thread, creating it on first use.
+ * @return Ring of the thread, NULL if out of memory
+**/
+static struct trace_ring* own_ring() {
+    if (likely(ring != NULL)){
+        return ring;
+    }
+    struct trace_ring* fresh = (struct trace_ring*) calloc(1, sizeof(struct trace_ring));
+    if (unlikely(fresh == NULL)){
+        return NULL;
+    }
+    fresh->thread = threads.fetch_add(1, memory_order_relaxed);
+    fresh->next = rings.load(memory_order_relaxed);
+    while (!rings.compare_exchange_weak(fresh->next, fresh, memory_order_release, memory_order_relaxed));
+    ring = fresh;
+    return ring;
+}
+
+/** [thread-safe] Append an event to the ring of the calling thread.
+ * @param event   One of 'TRACE_*'
+ * @param tx      Transaction of the event
+ * @param address Shared memory address of the event, if any
+ * @param info    Event-specific information
+**/
+void trace(uint32_t event, uint64_t tx, void const* address, uint32_t info) noexcept {
+    struct trace_ring* own = own_ring();
+    if (unlikely(own == NULL)){
+        return;
+    }
+    uint64_t head = own->head.load(memory_order_relaxed);
+    own->records[head & ((1ul << TRACE_RING_LOG2) - 1)] = {trace_tsc(), tx, (uint64_t) (uintptr_t) address, event, info};
+    own->head.store(head + 1, memory_order_release);
+}
+
+/** Write the records of every thread to a file.
+ * @param path Path of the file to (over)write
+**/
+void trace_dump(char const* path) noexcept {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL){
+        fprintf(stderr, "trace: cannot open '%s'\n", path);
+        return;
+    }
+    struct trace_header header = {TRACE_MAGIC, sizeof(struct trace_record)};
+    fwrite(&header, sizeof(header), 1, file);
+    for (struct trace_ring* it = rings.load(memory_order_acquire); it != NULL; it = it->next){
+        uint64_t head = it->head.load(memory_order_acquire);
+        uint64_t count = head < (1ul << TRACE_RING_LOG2) ? head : (1ul << TRACE_RING_LOG2);
+        struct trace_chunk chunk = {it->thread, count};
+        fwrite(&chunk, sizeof(chunk), 1, file);
+        for (uint64_t i = head - count; i < head; ++i){
+            fwrite(&it->records[i & ((1ul << TRACE_RING_LOG2) - 1)], sizeof(struct trace_record), 1, file);
+        }
+    }
+    fclose(file);
+}
+
+#endif
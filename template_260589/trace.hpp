@@ -0,0 +1,92 @@
+/**
+ * @file   trace.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Transaction event tracer, only compiled in with USE_TRACE. Every thread
+ * appends fixed-size records to a ring buffer of its own, the rings are
+ * written to the file named by 'TM_TRACE' when a region is destroyed, and
+ * 'tools/trace_decode' prints them.
+**/
+
+#pragma once
+
+// External headers
+#include <cstdint>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Events, stored in 'trace_record::event'
+#define TRACE_BEGIN  0 // 'info' is whether the transaction is read-only
+#define TRACE_READ   1 // 'info' is the size read
+#define TRACE_WRITE  2 // 'info' is the size written
+#define TRACE_ALLOC  3 // 'info' is the size allocated
+#define TRACE_FREE   4
+#define TRACE_ABORT  5 // 'info' is the reason, one of 'TM_ABORT_*'
+#define TRACE_COMMIT 6
+
+// Magic number at the start of a trace file
+#define TRACE_MAGIC UINT64_C(0x3145434152544d54) // "TMTRACE1"
+
+/** One event, as written in the trace file.
+**/
+struct trace_record {
+    uint64_t tsc;     // Timestamp counter of the event
+    uint64_t tx;      // Transaction of the event
+    uint64_t address; // Shared memory address accessed, or that triggered the abort
+    uint32_t event;
+    uint32_t info;
+};
+
+/** Trace file header, followed by the chunks of every thread.
+**/
+struct trace_header {
+    uint64_t magic;
+    uint64_t record_size; // Size of 'struct trace_record'
+};
+
+/** Header of the records of one thread, oldest first.
+**/
+struct trace_chunk {
+    uint64_t thread; // Thread number, in order of first event
+    uint64_t count;  // Number of records that follow
+};
+
+#ifdef USE_TRACE
+
+extern thread_local uint32_t trace_reason;
+
+void trace(uint32_t, uint64_t, void const*, uint32_t) noexcept;
+void trace_dump(char const*) noexcept;
+
+/** Record an event.
+ * @param event   One of 'TRACE_*'
+ * @param tx      Transaction of the event
+ * @param address Shared memory address of the event, if any
+ * @param info    Event-specific information
+**/
+#define TRACE(event, tx, address, info) \
+    trace((event), (uint64_t) (tx), (address), (info))
+
+/** Remember why the running transaction of the thread aborts, for its 'TRACE_ABORT' record.
+ * @param reason One of 'TM_ABORT_*'
+**/
+#define TRACE_REASON(reason) \
+    (trace_reason = (reason))
+
+#else
+
+#define TRACE(event, tx, address, info) \
+    do {} while (0)
+#define TRACE_REASON(reason) \
+    do {} while (0)
+
+#endif
@@ -0,0 +1,247 @@
+/**
+ * @file   watchdog.cpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Starvation watchdog, empty unless built with USE_WATCHDOG. Each epoch slot
+ * has a record, written by the transaction holding the slot as it enters and
+ * read by the service thread of the region without any lock: a report may mix
+ * two attempts, which is fine for a diagnostic.
+**/
+
+// Internal headers
+#include "common.hpp"
+#include "watchdog.hpp"
+
+#ifdef USE_WATCHDOG
+
+// External headers
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <pthread.h>
+
+// Internal headers
+#include "contention.hpp"
+#include "region.hpp"
+
+using namespace std;
+
+// -------------------------------------------------------------------------- //
+
+/** What the watchdog knows of the transaction holding an epoch slot, only written by it.
+**/
+struct alignas(CACHE_LINE) watch_slot {
+    atomic<uint64_t> first;   // Time of the first attempt of the transaction (in nanoseconds), 0 if the slot is free
+    atomic<uint64_t> reads;   // Reads counted in the slot before the current attempt
+    atomic<uint64_t> writes;  // Writes counted in the slot before the current attempt
+    atomic<uintptr_t> conflicts[WATCHDOG_CONFLICTS]; // Words the previous attempt conflicted on, 0 for none
+    atomic<uint32_t> retries; // Previous attempts
+    atomic<bool> escalate;    // Whether the next retry is to run irrevocable, set by the watchdog
+};
+
+/** Service thread of a region and the records of its epoch slots.
+**/
+struct watchdog {
+    pthread_t thread;
+    mutex lock;
+    condition_variable wake; // Signaled to stop
+    bool stop;               // Whether the region is being destroyed, under 'lock'
+    bool escalate;           // Whether reported transactions retry irrevocable
+    uint64_t reported[EPOCH_SLOTS]; // First attempt of the last transaction reported per slot, only used by the thread
+    struct watch_slot slots[EPOCH_SLOTS];
+};
+
+/** Transaction of the calling thread, as it goes from one attempt to the next.
+**/
+struct watched {
+    uint64_t first;      // Time of the first attempt (in nanoseconds)
+    uintptr_t conflicts[WATCHDOG_CONFLICTS]; // Words the last aborted attempt conflicted on
+    size_t nb_conflicts;
+    struct region* region; // Region and epoch slot of the last attempt, NULL if none
+    size_t slot;
+};
+
+static thread_local struct watched watched = {};
+
+/** Get the time, in nanoseconds from an arbitrary but fixed point, never 0.
+ * @return Time
+**/
+static inline uint64_t watchdog_now() noexcept {
+    return (uint64_t) chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count() | 1;
+}
+
+/** Report a transaction that starves or runs for too long, and ask its next retry to run irrevocable if enabled.
+ * @param region Region of the transaction
+ * @param i      Epoch slot of the transaction
+ * @param first  Time of its first attempt
+ * @param now    Time of the check
+**/
+static void watchdog_report(struct region* region, size_t i, uint64_t first, uint64_t now) noexcept {
+    struct watchdog* dog = region->watchdog;
+    struct watch_slot& rec = dog->slots[i];
+    //the counters are only written by the holder of the slot, each read is some value they had
+    uint64_t reads = region->counters[i].reads.load(memory_order_relaxed) - rec.reads.load(memory_order_relaxed);
+    uint64_t writes = region->counters[i].writes.load(memory_order_relaxed) - rec.writes.load(memory_order_relaxed);
+    char conflicts[WATCHDOG_CONFLICTS * 20 + 8] = "nothing recorded";
+    size_t length = 0;
+    for (size_t j = 0; j < WATCHDOG_CONFLICTS; ++j){
+        uintptr_t word = rec.conflicts[j].load(memory_order_relaxed);
+        if (word != 0){
+            length += snprintf(conflicts + length, sizeof(conflicts) - length, "%s%#lx", length > 0 ? " " : "", (unsigned long) word);
+        }
+    }
+    bool escalate = dog->escalate && region->persist == NULL && region->shm == NULL && region->ship == NULL;
+    if (escalate){
+        rec.escalate.store(true, memory_order_release);
+    }
+    uint32_t retries = rec.retries.load(memory_order_relaxed);
+    fprintf(stderr, "watchdog: transaction of slot %zu at %.1f ms, %u retries, %lu reads and %lu writes in this attempt%s%s%s\n",
+        i, (now - first) / 1e6, retries, reads, writes, retries > 0 ? ", previous attempt conflicted on " : "", retries > 0 ? conflicts : "", escalate ? ", next retry irrevocable" : "");
+}
+
+/** Look at the announced transactions of a region every TM_WATCHDOG_PERIOD milliseconds, until stopped.
+ * @param arg Region to watch
+ * @return NULL
+**/
+static void* watchdog_run(void* arg) {
+    struct region* region = (struct region*) arg;
+    struct watchdog* dog = region->watchdog;
+    unique_lock<mutex> guard(dog->lock);
+    while (!dog->wake.wait_for(guard, chrono::milliseconds(TM_WATCHDOG_PERIOD), [dog] { return dog->stop; })){
+        guard.unlock();
+        uint64_t now = watchdog_now();
+        for (size_t i = 0; i < EPOCH_SLOTS; ++i){
+            uint64_t first = dog->slots[i].first.load(memory_order_acquire);
+            if (first == 0 || first == dog->reported[i] || region->slots[i].epoch.load(memory_order_relaxed) == 0){
+                continue;
+            }
+            if (now - first < (uint64_t) TM_WATCHDOG_THRESHOLD * 1000000 && dog->slots[i].retries.load(memory_order_relaxed) < TM_WATCHDOG_RETRIES){
+                continue;
+            }
+            dog->reported[i] = first;
+            watchdog_report(region, i, first, now);
+        }
+        guard.lock();
+    }
+    return NULL;
+}
+
+/** Start the watchdog of a region, unless 'TM_WATCHDOG' is 'off', none if it cannot start.
+ * @param region Region to watch
+**/
+void watchdog_start(struct region* region) noexcept {
+    region->watchdog = NULL;
+    char const* env = getenv("TM_WATCHDOG");
+    if (env != NULL && strcmp(env, "off") == 0){
+        return;
+    }
+    struct watchdog* dog = new (std::nothrow) struct watchdog();
+    if (unlikely(dog == NULL)){
+        return;
+    }
+    dog->stop = false;
+    dog->escalate = env != NULL && strcmp(env, "escalate") == 0;
+    region->watchdog = dog;
+    if (unlikely(pthread_create(&dog->thread, NULL, watchdog_run, region) != 0)){
+        region->watchdog = NULL;
+        delete dog;
+    }
+}
+
+/** Stop and join the watchdog of a region, with no running transaction.
+ * @param region Region watched
+**/
+void watchdog_stop(struct region* region) noexcept {
+    struct watchdog* dog = region->watchdog;
+    if (dog == NULL){
+        return;
+    }
+    {
+        lock_guard<mutex> guard(dog->lock);
+        dog->stop = true;
+        dog->wake.notify_one();
+    }
+    pthread_join(dog->thread, NULL);
+    delete dog;
+    region->watchdog = NULL;
+}
+
+/** [thread-safe] Publish the attempt of the calling thread that just took an epoch slot.
+ * @param region Region of the attempt
+ * @param slot   Epoch slot taken
+**/
+void watchdog_enter(struct region* region, size_t slot) noexcept {
+    struct watchdog* dog = region->watchdog;
+    if (dog == NULL){
+        return;
+    }
+    size_t retries = cm_retries();
+    if (retries == 0 || watched.first == 0){
+        watched.first = watchdog_now();
+        watched.nb_conflicts = 0;
+    }
+    struct watch_slot& rec = dog->slots[slot];
+    rec.reads.store(region->counters[slot].reads.load(memory_order_relaxed), memory_order_relaxed);
+    rec.writes.store(region->counters[slot].writes.load(memory_order_relaxed), memory_order_relaxed);
+    for (size_t i = 0; i < WATCHDOG_CONFLICTS; ++i){
+        rec.conflicts[i].store(i < watched.nb_conflicts ? watched.conflicts[i] : 0, memory_order_relaxed);
+    }
+    rec.retries.store((uint32_t) retries, memory_order_relaxed);
+    rec.escalate.store(false, memory_order_relaxed);
+    rec.first.store(watched.first, memory_order_release);
+    watched.nb_conflicts = 0;
+    watched.region = region;
+    watched.slot = slot;
+}
+
+/** [thread-safe] Withdraw the attempt of the calling thread from its epoch slot.
+ * @param region Region of the attempt
+ * @param slot   Epoch slot released
+**/
+void watchdog_exit(struct region* region, size_t slot) noexcept {
+    struct watchdog* dog = region->watchdog;
+    if (dog == NULL){
+        return;
+    }
+    dog->slots[slot].first.store(0, memory_order_relaxed);
+}
+
+/** [thread-safe] Note a word, or a lock, the aborting attempt of the calling thread conflicted on.
+ * @param location Address of the word or lock
+**/
+void watchdog_conflict(void const* location) noexcept {
+    if (watched.nb_conflicts == WATCHDOG_CONFLICTS){
+        return;
+    }
+    for (size_t i = 0; i < watched.nb_conflicts; ++i){
+        if (watched.conflicts[i] == (uintptr_t) location){
+            return;
+        }
+    }
+    watched.conflicts[watched.nb_conflicts++] = (uintptr_t) location;
+}
+
+/** [thread-safe] Tell whether the watchdog asked the retry the calling thread begins to run irrevocable.
+ * @param region Region the retry runs on
+ * @return Whether to run the retry irrevocable
+**/
+bool watchdog_escalated(struct region* region) noexcept {
+    if (region->watchdog == NULL || watched.region != region || cm_retries() == 0){
+        return false;
+    }
+    //the flag stays on the record of the aborted attempt, the next one clears it
+    return region->watchdog->slots[watched.slot].escalate.exchange(false, memory_order_acquire);
+}
+
+#endif
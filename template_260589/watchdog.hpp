@@ -0,0 +1,73 @@
+/**
+ * @file   watchdog.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Starvation watchdog, only compiled in with USE_WATCHDOG and only started if
+ * 'TM_WATCHDOG' is not 'off'. A service thread per region wakes up every
+ * TM_WATCHDOG_PERIOD milliseconds and looks at the transactions announced in
+ * the epoch table: one whose first attempt began more than
+ * TM_WATCHDOG_THRESHOLD milliseconds ago, or that was retried
+ * TM_WATCHDOG_RETRIES times, is reported once on the standard error, with its
+ * retries, the reads and writes of its current attempt and the words (or the
+ * locks) its previous attempt conflicted on. With 'TM_WATCHDOG=escalate', the
+ * next retry of a reported transaction runs in the serial irrevocable mode,
+ * as if it reached TM_IRREVOCABLE_RETRIES. Transactions only publish what
+ * they already know, with relaxed stores on one line per epoch slot.
+**/
+
+#pragma once
+
+// External headers
+#include <cstddef>
+#include <cstdint>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Conflicting words of the previous attempt kept per transaction
+#define WATCHDOG_CONFLICTS 4
+
+struct region;
+
+#ifdef USE_WATCHDOG
+
+void watchdog_start(struct region*) noexcept;
+void watchdog_stop(struct region*) noexcept;
+void watchdog_enter(struct region*, size_t) noexcept;
+void watchdog_exit(struct region*, size_t) noexcept;
+void watchdog_conflict(void const*) noexcept;
+bool watchdog_escalated(struct region*) noexcept;
+
+// Announcement of an attempt in an epoch slot
+#define WATCHDOG_ENTER(region, slot) \
+    watchdog_enter((region), (slot))
+// Withdrawal of the attempt from its epoch slot
+#define WATCHDOG_EXIT(region, slot) \
+    watchdog_exit((region), (slot))
+// Word, or lock, the aborting attempt conflicted on
+#define WATCHDOG_CONFLICT(location) \
+    watchdog_conflict((location))
+// Whether the watchdog asked the retry of the calling thread to run irrevocable
+#define WATCHDOG_ESCALATED(region) \
+    watchdog_escalated((region))
+
+#else
+
+#define WATCHDOG_ENTER(region, slot) \
+    do {} while (0)
+#define WATCHDOG_EXIT(region, slot) \
+    do {} while (0)
+#define WATCHDOG_CONFLICT(location) \
+    do {} while (0)
+#define WATCHDOG_ESCALATED(region) \
+    false
+
+#endif
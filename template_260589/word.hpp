@@ -0,0 +1,136 @@
+/**
+ * @file   word.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Copy and comparison of words of shared memory. The word size is only known
+ * at runtime, but is nearly always 8 or 16 bytes; for these the copies are a
+ * couple of moves instead of a call to 'memcpy'. Increments apply to the first
+ * 64 bits of a word, for words of at least 8 bytes. Large ranges can also be
+ * copied with non-temporal stores, which leave the caches of the writer alone.
+**/
+
+#pragma once
+
+// External headers
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+    #include <immintrin.h>
+#endif
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Copy one word.
+ * @param dst   Word to write
+ * @param src   Word to read
+ * @param align Size of a word
+**/
+static inline void word_copy(void* dst, void const* src, size_t align) {
+    //constant sizes, the compiler emits plain moves
+    if (likely(align == 8)){
+        memcpy(dst, src, 8);
+    } else if (align == 16){
+        memcpy(dst, src, 16);
+    } else {
+        memcpy(dst, src, align);
+    }
+}
+
+/** Copy a range of whole words.
+ * @param dst   First word to write
+ * @param src   First word to read
+ * @param size  Length to copy, a multiple of the word size
+ * @param align Size of a word
+**/
+static inline void words_copy(void* dst, void const* src, size_t size, size_t align) {
+    if (likely(size == align)){
+        word_copy(dst, src, align);
+    } else {
+        memcpy(dst, src, size);
+    }
+}
+
+/** Add to the 64-bit integer at the start of a word.
+ * @param word  Word to update, of at least 8 bytes
+ * @param delta Increment, wrapping around
+**/
+static inline void word_add(void* word, int64_t delta) {
+    uint64_t value;
+    memcpy(&value, word, sizeof(value));
+    value += (uint64_t) delta;
+    memcpy(word, &value, sizeof(value));
+}
+
+/** Compare two words.
+ * @param a     First word
+ * @param b     Second word
+ * @param align Size of a word
+ * @return Whether both words hold the same bytes
+**/
+static inline bool word_equal(void const* a, void const* b, size_t align) {
+    if (likely(align == 8)){
+        uint64_t x, y;
+        memcpy(&x, a, 8);
+        memcpy(&y, b, 8);
+        return x == y;
+    }
+    if (align == 16){
+        uint64_t x[2], y[2];
+        memcpy(x, a, 16);
+        memcpy(y, b, 16);
+        return ((x[0] ^ y[0]) | (x[1] ^ y[1])) == 0;
+    }
+    return memcmp(a, b, align) == 0;
+}
+
+/** Copy a range of whole words with non-temporal stores, to order with 'words_stream_fence' before publishing it.
+ * @param dst   First word to write
+ * @param src   First word to read
+ * @param size  Length to copy, a multiple of the word size
+ * @param align Size of a word, at least 8 bytes
+**/
+static inline void words_stream(void* dst, void const* src, size_t size, size_t align) {
+#if defined(__x86_64__)
+    char* to = (char*) dst;
+    char const* from = (char const*) src;
+    char* end = to + size;
+    //8-byte stores up to the first 16-byte boundary and after the last one, 16-byte stores in between
+    while (((uintptr_t) to & 15) != 0 && to < end){
+        long long word;
+        memcpy(&word, from, 8);
+        _mm_stream_si64((long long*) to, word);
+        to += 8;
+        from += 8;
+    }
+    for (; to + 16 <= end; to += 16, from += 16){
+        _mm_stream_si128((__m128i*) to, _mm_loadu_si128((__m128i const*) from));
+    }
+    for (; to < end; to += 8, from += 8){
+        long long word;
+        memcpy(&word, from, 8);
+        _mm_stream_si64((long long*) to, word);
+    }
+#else
+    words_copy(dst, src, size, align);
+#endif
+    (void) align;
+}
+
+/** Order the non-temporal stores of the calling thread before its next stores, e.g. the release of its locks.
+**/
+static inline void words_stream_fence() {
+#if defined(__x86_64__)
+    _mm_sfence();
+#endif
+}
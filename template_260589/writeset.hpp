@@ -0,0 +1,290 @@
+/**
+ * @file   writeset.hpp
+ * @author Simon Wicky <simon.wicky@epfl.ch>
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Write set of the write-back engines: the words written by a transaction,
+ * buffered until commit, with constant-time read-after-write lookups. A word
+ * can also be buffered as an increment, applied to whatever the word holds at
+ * commit, so that concurrent increments of one word do not conflict. A large
+ * write set is published with non-temporal stores, so that the committing
+ * thread does not fill its caches with lines other threads read next.
+**/
+
+#pragma once
+
+// External headers
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Internal headers
+#include "profile.hpp"
+#include "word.hpp"
+
+// -------------------------------------------------------------------------- //
+
+// Write sets up to this size are scanned, larger ones are indexed
+#define WRITES_SCANNED 16
+
+// Shortest run of consecutive buffered words published with non-temporal stores, shorter ones would leave lines partly written
+#define WRITES_STREAMED 64
+
+struct write_entry {
+    std::byte* location; // Written word in shared memory
+    size_t offset;       // Offset of the buffered content in 'data'
+    bool delta;          // Whether the buffered content is an increment (see 'word_add') rather than the new content
+};
+
+struct write_set {
+    std::vector<struct write_entry> entries;
+    std::vector<size_t> index; // Open-addressing table of 1 + position in 'entries' (0 if empty), only for large write sets
+    std::vector<std::byte> data;
+};
+
+/** Get the first slot to probe for a word in the write set index.
+ * @param ws       Write set with an index
+ * @param location Address of the word in shared memory
+ * @return Slot in the index
+**/
+static inline size_t writeset_slot(struct write_set* ws, void const* location) {
+    //Fibonacci hashing, the index size is a power of 2
+    return (size_t) ((((uintptr_t) location) * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - __builtin_ctzl(ws->index.size())));
+}
+
+/** Index the last entries of the write set, rebuilding the index if too loaded.
+ * @param ws    Write set that just got new entries
+ * @param added Number of new entries, at the end
+**/
+static inline void writeset_index(struct write_set* ws, size_t added = 1) {
+    size_t count = ws->entries.size();
+    if (count <= WRITES_SCANNED){
+        return;
+    }
+    size_t first = count - added;
+    if (2 * count > ws->index.size()){
+        size_t size = 4 * WRITES_SCANNED;
+        while (size < 4 * count){
+            size <<= 1;
+        }
+        ws->index.assign(size, 0);
+        first = 0;
+    }
+    for (size_t i = first; i < count; ++i){
+        size_t slot = writeset_slot(ws, ws->entries[i].location);
+        while (ws->index[slot] != 0){
+            slot = (slot + 1) & (ws->index.size() - 1);
+        }
+        ws->index[slot] = i + 1;
+    }
+}
+
+/** Find the entry of a word.
+ * @param ws       Write set to search
+ * @param location Address of the word in shared memory
+ * @return Entry of the word, NULL if the word was not written
+**/
+static inline struct write_entry* writeset_find(struct write_set* ws, void const* location) {
+    if (ws->index.empty()){
+        for (auto it = ws->entries.rbegin(); it != ws->entries.rend(); ++it){
+            if (it->location == location){
+                return &*it;
+            }
+        }
+        return NULL;
+    }
+    for (size_t slot = writeset_slot(ws, location); ws->index[slot] != 0; slot = (slot + 1) & (ws->index.size() - 1)){
+        struct write_entry* entry = &ws->entries[ws->index[slot] - 1];
+        if (entry->location == location){
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/** Find the buffered copy of a word.
+ * @param ws       Write set to search
+ * @param location Address of the word in shared memory
+ * @return Buffered content, NULL if the word was not written, or only incremented
+**/
+static inline std::byte* writeset_lookup(struct write_set* ws, void const* location) {
+    struct write_entry* entry = writeset_find(ws, location);
+    return entry == NULL || entry->delta ? NULL : ws->data.data() + entry->offset;
+}
+
+/** Buffer the new content of a word.
+ * @param ws       Write set to update
+ * @param location Address of the word in shared memory
+ * @param source   New content (in private memory)
+ * @param align    Size of a word
+**/
+static inline void writeset_add(struct write_set* ws, std::byte* location, std::byte const* source, size_t align) {
+    PROFILE(PROFILE_LOG);
+    struct write_entry* entry = writeset_find(ws, location);
+    if (entry != NULL){
+        //overwrites any pending increment
+        word_copy(ws->data.data() + entry->offset, source, align);
+        entry->delta = false;
+        return;
+    }
+    ws->entries.push_back({location, ws->data.size(), false});
+    ws->data.insert(ws->data.end(), source, source + align);
+    writeset_index(ws);
+}
+
+/** Buffer the new content of consecutive words contiguously, for the caller to write.
+ * @param ws       Write set to update
+ * @param location Address of the first word in shared memory
+ * @param size     Length of the range (in bytes), a multiple of the word size
+ * @param align    Size of a word
+ * @return Buffered content of the range, valid until the write set next grows, NULL if a word of the range was already written
+**/
+static inline std::byte* writeset_reserve(struct write_set* ws, std::byte* location, size_t size, size_t align) {
+    PROFILE(PROFILE_LOG);
+    if (!ws->entries.empty()){
+        for (size_t i = 0; i < size; i += align){
+            if (writeset_find(ws, location + i) != NULL){
+                return NULL;
+            }
+        }
+    }
+    size_t offset = ws->data.size();
+    for (size_t i = 0; i < size; i += align){
+        ws->entries.push_back({location + i, offset + i, false});
+    }
+    //one rebuild at most, however many words
+    writeset_index(ws, size / align);
+    ws->data.resize(offset + size);
+    return ws->data.data() + offset;
+}
+
+/** Buffer an increment of a word.
+ * @param ws       Write set to update
+ * @param location Address of the word in shared memory
+ * @param delta    Increment, see 'word_add'
+ * @param align    Size of a word, at least 8 bytes
+**/
+static inline void writeset_add_delta(struct write_set* ws, std::byte* location, int64_t delta, size_t align) {
+    PROFILE(PROFILE_LOG);
+    struct write_entry* entry = writeset_find(ws, location);
+    if (entry != NULL){
+        //either the new content or the pending increment, both just add up
+        word_add(ws->data.data() + entry->offset, delta);
+        return;
+    }
+    ws->entries.push_back({location, ws->data.size(), true});
+    ws->data.resize(ws->data.size() + align, std::byte{0});
+    word_add(ws->data.data() + ws->entries.back().offset, delta);
+    writeset_index(ws);
+}
+
+/** Turn a pending increment into the new content of the word, once the transaction read it.
+ * @param ws    Write set holding the entry
+ * @param entry Entry of the word, with an increment
+ * @param value Content read from the word (in private memory), receives the incremented content
+ * @param align Size of a word
+**/
+static inline void writeset_fold(struct write_set* ws, struct write_entry* entry, std::byte* value, size_t align) {
+    std::byte* buffered = ws->data.data() + entry->offset;
+    int64_t delta;
+    memcpy(&delta, buffered, sizeof(delta));
+    word_add(value, delta);
+    word_copy(buffered, value, align);
+    entry->delta = false;
+}
+
+/** Copy one buffered word, or apply its increment, to shared memory.
+ * @param ws    Write set holding the entry
+ * @param entry Entry to publish
+ * @param align Size of a word
+**/
+static inline void writeset_publish_entry(struct write_set* ws, struct write_entry const& entry, size_t align) {
+    std::byte const* buffered = ws->data.data() + entry.offset;
+    if (unlikely(entry.delta)){
+        int64_t delta;
+        memcpy(&delta, buffered, sizeof(delta));
+        word_add(entry.location, delta);
+    } else {
+        word_copy(entry.location, buffered, align);
+    }
+}
+
+/** Copy every buffered word to shared memory, with non-temporal stores for the long runs of consecutive words.
+ * @param ws    Write set to publish
+ * @param align Size of a word
+**/
+static inline void writeset_stream(struct write_set* ws, size_t align) {
+    size_t count = ws->entries.size();
+    size_t i = 0;
+    while (i < count){
+        struct write_entry const& first = ws->entries[i];
+        //entries of consecutive words buffered contiguously, e.g. by 'writeset_reserve'
+        size_t j = i + 1;
+        if (!first.delta){
+            while (j < count && !ws->entries[j].delta && ws->entries[j].location == first.location + (j - i) * align && ws->entries[j].offset == first.offset + (j - i) * align){
+                ++j;
+            }
+        }
+        size_t size = (j - i) * align;
+        if (size >= WRITES_STREAMED){
+            words_stream(first.location, ws->data.data() + first.offset, size, align);
+        } else {
+            for (size_t k = i; k < j; ++k){
+                writeset_publish_entry(ws, ws->entries[k], align);
+            }
+        }
+        i = j;
+    }
+    words_stream_fence();
+}
+
+/** Copy every buffered word to shared memory.
+ * @param ws     Write set to publish
+ * @param align  Size of a word
+ * @param stream Bytes of buffered content from which to publish with non-temporal stores, 0 for never
+**/
+static inline void writeset_publish(struct write_set* ws, size_t align, size_t stream = 0) {
+    if (stream != 0 && ws->data.size() >= stream && align >= 8){
+        writeset_stream(ws, align);
+        return;
+    }
+    for (auto const& entry : ws->entries){
+        writeset_publish_entry(ws, entry, align);
+    }
+}
+
+/** Get the bytes a write set holds, its unused capacity included.
+ * @param ws Write set to measure
+ * @return Size (in bytes)
+**/
+static inline size_t writeset_footprint(struct write_set const* ws) {
+    return ws->entries.capacity() * sizeof(struct write_entry) + ws->index.capacity() * sizeof(size_t) + ws->data.capacity();
+}
+
+/** Drop the entries added after a given size, e.g. to roll back to a savepoint.
+ * @param ws      Write set to truncate
+ * @param entries Number of entries to keep
+ * @param data    Bytes of buffered content to keep, those of the kept entries
+**/
+static inline void writeset_truncate(struct write_set* ws, size_t entries, size_t data) {
+    ws->entries.resize(entries);
+    ws->data.resize(data);
+    //rebuilt from scratch, if still large enough to be indexed
+    ws->index.clear();
+    writeset_index(ws);
+}
+
+/** Empty the write set, keeping its capacity.
+ * @param ws Write set to clear
+**/
+static inline void writeset_clear(struct write_set* ws) {
+    ws->entries.clear();
+    ws->index.clear();
+    ws->data.clear();
+}